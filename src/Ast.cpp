@@ -22,18 +22,45 @@ void* ast_dup(const void* src, size_t size) {
 Typespec* typespec_new(TypespecKind kind) {
     Typespec* t = (Typespec*)ast_alloc(sizeof(Typespec));
     t->kind = kind;
+    t->id = Global::next_typespec_id++;
     return t;
 }
 
+//*FNV-1a steps, children are hashed when they are built so a node's hash costs O(1)
+Internal u64 typespec_hash_mix(u64 hash, u64 val) {
+    for (int i = 0; i < 8; i++) {
+        hash = (hash ^ ((val >> (i * 8)) & 0xff)) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+Internal u64 typespec_hash_start(TypespecKind kind) {
+    return typespec_hash_mix(0xcbf29ce484222325ull, (u64)kind);
+}
+
+Internal u64 typespec_hash_child(u64 hash, Typespec* child) {
+    return hash && child->hash ? typespec_hash_mix(hash, child->hash) : 0;
+}
+
+Typespec* typespec_error() {
+    return typespec_new(TypespecKind::ERR);
+}
+
 Typespec* typespec_name(const char* name) {
     Typespec* t = typespec_new(TypespecKind::NAME);
     t->name = name;
+    //*hashed by content rather than by the interned pointer so the hash survives the ast cache
+    t->hash = typespec_hash_start(TypespecKind::NAME);
+    for (const char* c = name; *c; c++) {
+        t->hash = (t->hash ^ (u8)*c) * 0x100000001b3ull;
+    }
     return t;
 }
 
 Typespec* typespec_ptr(Typespec* elem) {
     Typespec* t = typespec_new(TypespecKind::PTR);
     t->ptr.elem = elem;
+    t->hash = typespec_hash_child(typespec_hash_start(TypespecKind::PTR), elem);
     return t;
 }
 
@@ -41,6 +68,10 @@ Typespec* typespec_array(Typespec* elem, Expr* size) {
     Typespec* t = typespec_new(TypespecKind::ARRAY);
     t->array.elem = elem;
     t->array.size = size;
+    t->hash = typespec_hash_child(typespec_hash_start(TypespecKind::ARRAY), elem);
+    if (size) {
+        t->hash = size->kind == ExprKind::INT ? typespec_hash_mix(t->hash, (u64)size->int_val) : 0;
+    }
     return t;
 }
 
@@ -49,15 +80,27 @@ Typespec* typespec_func(Typespec** args, size_t num_args, Typespec* ret) {
     t->func.args = (Typespec**)ast_dup(args, num_args * sizeof(Typespec*));
     t->func.num_args = num_args;
     t->func.ret = ret;
+    t->hash = typespec_hash_mix(typespec_hash_start(TypespecKind::FUNC), num_args);
+    for (size_t i = 0; i < num_args; i++) {
+        t->hash = typespec_hash_child(t->hash, args[i]);
+    }
+    if (ret) {
+        t->hash = typespec_hash_child(t->hash, ret);
+    }
     return t;
 }
 
 Expr* expr_new(ExprKind kind) {
     Expr* e = (Expr*)ast_alloc(sizeof(Expr));
     e->kind = kind;
+    e->id = Global::next_expr_id++;
     return e;
 }
 
+Expr* expr_error() {
+    return expr_new(ExprKind::ERR);
+}
+
 Expr* expr_int(i64 int_val) {
     Expr* e = expr_new(ExprKind::INT);
     e->int_val = int_val;
@@ -160,6 +203,10 @@ Stmt* stmt_new(StmtKind kind) {
     return s;
 }
 
+Stmt* stmt_error() {
+    return stmt_new(StmtKind::ERR);
+}
+
 Stmt* stmt_decl(Decl* decl) {
     Stmt* s = stmt_new(StmtKind::DECL);
     s->decl = decl;
@@ -255,6 +302,10 @@ Internal Decl* decl_new(DeclKind kind, const char* name) {
     return d;
 }
 
+Decl* decl_error() {
+    return decl_new(DeclKind::ERR, nullptr);
+}
+
 Decl* decl_enum(const char* name, EnumItem* items, size_t num_items) {
     Decl* d = decl_new(DeclKind::ENUM, name);
     d->enum_decl.items = (EnumItem*)ast_dup(items, num_items * sizeof(EnumItem));
@@ -294,6 +345,12 @@ Decl* decl_func(const char* name, FuncParam* params, size_t num_params, Typespec
     return d;
 }
 
+Decl* decl_func_lazy(const char* name, FuncParam* params, size_t num_params, Typespec* ret_type, LazyBody body) {
+    Decl* d = decl_func(name, params, num_params, ret_type, StmtBlock{});
+    d->func.lazy_body = (LazyBody*)ast_dup(&body, sizeof(LazyBody));
+    return d;
+}
+
 Decl* decl_const(const char* name, Expr* expr) {
     Decl* d = decl_new(DeclKind::CONST, name);
     d->const_decl.expr = expr;
@@ -11,6 +11,7 @@ struct Typespec;
 
 enum class TypespecKind {
     NONE,
+    ERR,
     NAME,
     FUNC,
     ARRAY,
@@ -19,6 +20,10 @@ enum class TypespecKind {
 
 struct Typespec {
     TypespecKind kind;
+    u32 id; //*dense index into Global::typespec_types, see resolve_typespec
+    //*hash of the spelling, equal spellings hash equal. 0 when the spelling has an array size that is not a literal,
+    //*such typespecs are only memoized per node
+    u64 hash;
     union {
         const char* name;
         struct {
@@ -38,6 +43,8 @@ struct Typespec {
 
 Typespec* typespec_new(TypespecKind kind);
 
+Typespec* typespec_error();
+
 Typespec* typespec_name(const char* name);
 
 Typespec* typespec_ptr(Typespec* elem);
@@ -48,6 +55,7 @@ Typespec* typespec_func(Typespec** args, size_t num_args, Typespec* ret);
 
 enum class ExprKind {
     NONE,
+    ERR,
     INT,
     FLOAT,
     STR,
@@ -66,6 +74,7 @@ enum class ExprKind {
 
 struct Expr {
     ExprKind kind;
+    u32 id; //*dense index into the side tables the resolver fills, see expr_type
     union {
         i64 int_val;
         f64 float_val;
@@ -115,6 +124,8 @@ struct Expr {
 
 Expr* expr_new(ExprKind kind);
 
+Expr* expr_error();
+
 Expr* expr_int(i64 int_val);
 
 Expr* expr_float(f64 float_val);
@@ -145,6 +156,7 @@ Expr* expr_sizeof_type(Typespec* type);
 
 enum class StmtKind {
     NONE,
+    ERR,
     DECL,
     RETURN,
     BREAK,
@@ -218,6 +230,8 @@ struct Stmt {
     };
 };
 
+Stmt* stmt_error();
+
 Stmt* stmt_decl(Decl* decl);
 
 Stmt* stmt_return(Expr* expr);
@@ -246,6 +260,7 @@ Stmt* stmt_expr(Expr* expr);
 
 enum class DeclKind {
     NONE,
+    ERR,
     ENUM,
     STRUCT,
     UNION,
@@ -266,6 +281,14 @@ struct AggregateItem {
     Typespec* type;
 };
 
+//*brace-matched source span of a function body that has not been parsed yet
+struct LazyBody {
+    const char* start;
+    const char* end;
+    const char* stream_start;
+    const char* stream_name;
+};
+
 struct EnumItem {
     const char* name;
     Expr* init;
@@ -288,6 +311,7 @@ struct Decl {
             size_t num_params;
             Typespec* ret_type;
             StmtBlock block;
+            LazyBody* lazy_body; //*non-null until the body is materialized
         } func;
         struct {
             Typespec* type;
@@ -302,6 +326,8 @@ struct Decl {
     };
 };
 
+Decl* decl_error();
+
 Decl* decl_enum(const char* name, EnumItem* items, size_t num_items);
 
 Decl* decl_aggregate(DeclKind kind, const char* name, AggregateItem* items, size_t num_items);
@@ -312,6 +338,8 @@ Decl* decl_var(const char* name, Typespec* type, Expr* expr);
 
 Decl* decl_func(const char* name, FuncParam* params, size_t num_params, Typespec* ret_type, StmtBlock block);
 
+Decl* decl_func_lazy(const char* name, FuncParam* params, size_t num_params, Typespec* ret_type, LazyBody body);
+
 Decl* decl_const(const char* name, Expr* expr);
 
 Decl* decl_typedef(const char* name, Typespec* type);
\ No newline at end of file
@@ -0,0 +1,881 @@
+#include "AstCache.hpp"
+#include "Globals.hpp"
+#include "Parse.hpp"
+#include "Resolve.hpp"
+#include <cassert>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <direct.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//*bump when the layout of the AST nodes or of the image changes
+Internal constexpr u32 AST_CACHE_VERSION = 3;
+Internal constexpr u32 AST_CACHE_MAGIC = 0x54534153; //*"SAST"
+
+//*images are only valid for the node layout they were written with
+Internal constexpr u32 AST_CACHE_LAYOUT = (u32)(sizeof(Typespec) | sizeof(Expr) << 8 | sizeof(Stmt) << 16 | sizeof(Decl) << 24);
+
+//*every offset is relative to the start of the image, 0 is the null pointer since the header lives there
+struct AstCacheHeader {
+    u32 magic;
+    u32 version;
+    u32 ptr_size;
+    u32 layout;
+    u64 size;
+    u64 decls;
+    u64 num_decls;
+    u64 ptr_relocs;
+    u64 num_ptr_relocs;
+    u64 name_relocs;
+    u64 num_name_relocs;
+    u64 names;
+    u64 num_names;
+    u64 exprs;
+    u64 num_exprs;
+    u64 typespecs;
+    u64 num_typespecs;
+};
+
+//*an image is built in one growable buffer. pointer fields hold the offset of their target and are listed in
+//*ptr_relocs, name fields hold an index into the name table and are listed in name_relocs. every Expr node is
+//*listed in exprs and every Typespec node in typespecs, their ids belong to the writing process and are replaced on load.
+struct AstWriter {
+    std::vector<u8> buf;
+    std::vector<u32> ptr_relocs;
+    std::vector<u32> name_relocs;
+    std::vector<u32> exprs;
+    std::vector<u32> typespecs;
+    std::vector<const char*> names;
+    std::unordered_map<const char*, u64> name_indices;
+
+    u64 alloc(size_t size) {
+        u64 offset = (buf.size() + 7) & ~(u64)7;
+        buf.resize(offset + size);
+        return offset;
+    }
+
+    template<typename T>
+    T* at(u64 offset) {
+        return (T*)(buf.data() + offset);
+    }
+
+    //*copies a node into the image, the caller patches its pointer fields afterwards
+    template<typename T>
+    u64 copy(const T* node) {
+        u64 offset = alloc(sizeof(T));
+        memcpy(buf.data() + offset, node, sizeof(T));
+        return offset;
+    }
+
+    //*fields must be re-fetched with at() after any write, a write can move the buffer
+    void ptr(void* field, u64 target) {
+        *(uintptr_t*)field = (uintptr_t)target;
+        if (target) {
+            ptr_relocs.push_back((u32)((u8*)field - buf.data()));
+        }
+    }
+
+    void name(const char** field, const char* name) {
+        if (!name) {
+            *(uintptr_t*)field = 0;
+            return;
+        }
+
+        auto it = name_indices.find(name);
+        u64 index = 0;
+        if (it == name_indices.end()) {
+            names.push_back(name);
+            index = names.size();
+            name_indices[name] = index;
+        }
+        else {
+            index = it->second;
+        }
+
+        *(uintptr_t*)field = (uintptr_t)index;
+        name_relocs.push_back((u32)((u8*)field - buf.data()));
+    }
+};
+
+Internal u64 write_expr(AstWriter* w, Expr* expr);
+Internal u64 write_stmt(AstWriter* w, Stmt* stmt);
+Internal u64 write_decl(AstWriter* w, Decl* decl);
+Internal u64 write_typespec(AstWriter* w, Typespec* type);
+
+Internal u64 write_expr_list(AstWriter* w, Expr** exprs, size_t num_exprs) {
+    if (!exprs) {
+        return 0;
+    }
+
+    u64 list = w->alloc(num_exprs * sizeof(Expr*));
+    for (size_t i = 0; i < num_exprs; i++) {
+        u64 expr = write_expr(w, exprs[i]);
+        w->ptr(w->at<Expr*>(list) + i, expr);
+    }
+
+    return list;
+}
+
+Internal u64 write_typespec(AstWriter* w, Typespec* type) {
+    if (!type) {
+        return 0;
+    }
+
+    u64 t = w->copy(type);
+    w->at<Typespec>(t)->id = 0;
+    w->typespecs.push_back((u32)t);
+    switch (type->kind) {
+        case TypespecKind::NAME: {
+            w->name(&w->at<Typespec>(t)->name, type->name);
+            break;
+        }
+        case TypespecKind::FUNC: {
+            u64 args = 0;
+            if (type->func.args) {
+                args = w->alloc(type->func.num_args * sizeof(Typespec*));
+                for (size_t i = 0; i < type->func.num_args; i++) {
+                    u64 arg = write_typespec(w, type->func.args[i]);
+                    w->ptr(w->at<Typespec*>(args) + i, arg);
+                }
+            }
+            w->ptr(&w->at<Typespec>(t)->func.args, args);
+            u64 ret = write_typespec(w, type->func.ret);
+            w->ptr(&w->at<Typespec>(t)->func.ret, ret);
+            break;
+        }
+        case TypespecKind::ARRAY: {
+            u64 elem = write_typespec(w, type->array.elem);
+            w->ptr(&w->at<Typespec>(t)->array.elem, elem);
+            u64 size = write_expr(w, type->array.size);
+            w->ptr(&w->at<Typespec>(t)->array.size, size);
+            break;
+        }
+        case TypespecKind::PTR: {
+            u64 elem = write_typespec(w, type->ptr.elem);
+            w->ptr(&w->at<Typespec>(t)->ptr.elem, elem);
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+
+    return t;
+}
+
+Internal u64 write_expr(AstWriter* w, Expr* expr) {
+    if (!expr) {
+        return 0;
+    }
+
+    u64 e = w->copy(expr);
+    w->at<Expr>(e)->id = 0;
+    w->exprs.push_back((u32)e);
+    switch (expr->kind) {
+        case ExprKind::STR: {
+            //*string literals share the name table, they come back interned
+            w->name(&w->at<Expr>(e)->str_val, Global::string_table.add(expr->str_val));
+            break;
+        }
+        case ExprKind::NAME: {
+            w->name(&w->at<Expr>(e)->name, expr->name);
+            break;
+        }
+        case ExprKind::SIZEOF_EXPR: {
+            u64 sizeof_expr = write_expr(w, expr->sizeof_expr);
+            w->ptr(&w->at<Expr>(e)->sizeof_expr, sizeof_expr);
+            break;
+        }
+        case ExprKind::SIZEOF_TYPE: {
+            u64 sizeof_type = write_typespec(w, expr->sizeof_type);
+            w->ptr(&w->at<Expr>(e)->sizeof_type, sizeof_type);
+            break;
+        }
+        case ExprKind::COMPOUND: {
+            u64 type = write_typespec(w, expr->compound.type);
+            w->ptr(&w->at<Expr>(e)->compound.type, type);
+            u64 args = write_expr_list(w, expr->compound.args, expr->compound.num_args);
+            w->ptr(&w->at<Expr>(e)->compound.args, args);
+            break;
+        }
+        case ExprKind::CAST: {
+            u64 type = write_typespec(w, expr->cast.type);
+            w->ptr(&w->at<Expr>(e)->cast.type, type);
+            u64 operand = write_expr(w, expr->cast.expr);
+            w->ptr(&w->at<Expr>(e)->cast.expr, operand);
+            break;
+        }
+        case ExprKind::UNARY: {
+            u64 operand = write_expr(w, expr->unary.expr);
+            w->ptr(&w->at<Expr>(e)->unary.expr, operand);
+            break;
+        }
+        case ExprKind::BINARY: {
+            u64 left = write_expr(w, expr->binary.left);
+            w->ptr(&w->at<Expr>(e)->binary.left, left);
+            u64 right = write_expr(w, expr->binary.right);
+            w->ptr(&w->at<Expr>(e)->binary.right, right);
+            break;
+        }
+        case ExprKind::TERNARY: {
+            u64 cond = write_expr(w, expr->ternary.cond);
+            w->ptr(&w->at<Expr>(e)->ternary.cond, cond);
+            u64 then_expr = write_expr(w, expr->ternary.then_expr);
+            w->ptr(&w->at<Expr>(e)->ternary.then_expr, then_expr);
+            u64 else_expr = write_expr(w, expr->ternary.else_expr);
+            w->ptr(&w->at<Expr>(e)->ternary.else_expr, else_expr);
+            break;
+        }
+        case ExprKind::CALL: {
+            u64 func = write_expr(w, expr->call.expr);
+            w->ptr(&w->at<Expr>(e)->call.expr, func);
+            u64 args = write_expr_list(w, expr->call.args, expr->call.num_args);
+            w->ptr(&w->at<Expr>(e)->call.args, args);
+            break;
+        }
+        case ExprKind::INDEX: {
+            u64 operand = write_expr(w, expr->index.expr);
+            w->ptr(&w->at<Expr>(e)->index.expr, operand);
+            u64 index = write_expr(w, expr->index.index);
+            w->ptr(&w->at<Expr>(e)->index.index, index);
+            break;
+        }
+        case ExprKind::FIELD: {
+            u64 operand = write_expr(w, expr->field.expr);
+            w->ptr(&w->at<Expr>(e)->field.expr, operand);
+            w->name(&w->at<Expr>(e)->field.name, expr->field.name);
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+
+    return e;
+}
+
+//*writes the statements of a block and returns the offset of its Stmt* array, the caller patches block.stmts
+Internal u64 write_stmt_block(AstWriter* w, StmtBlock block) {
+    if (!block.stmts) {
+        return 0;
+    }
+
+    u64 stmts = w->alloc(block.num_stmts * sizeof(Stmt*));
+    for (size_t i = 0; i < block.num_stmts; i++) {
+        u64 stmt = write_stmt(w, block.stmts[i]);
+        w->ptr(w->at<Stmt*>(stmts) + i, stmt);
+    }
+
+    return stmts;
+}
+
+Internal u64 write_stmt(AstWriter* w, Stmt* stmt) {
+    if (!stmt) {
+        return 0;
+    }
+
+    u64 s = w->copy(stmt);
+    switch (stmt->kind) {
+        case StmtKind::RETURN:
+        case StmtKind::EXPR: {
+            u64 expr = write_expr(w, stmt->expr);
+            w->ptr(&w->at<Stmt>(s)->expr, expr);
+            break;
+        }
+        case StmtKind::DECL: {
+            u64 decl = write_decl(w, stmt->decl);
+            w->ptr(&w->at<Stmt>(s)->decl, decl);
+            break;
+        }
+        case StmtKind::BLOCK: {
+            u64 stmts = write_stmt_block(w, stmt->block);
+            w->ptr(&w->at<Stmt>(s)->block.stmts, stmts);
+            break;
+        }
+        case StmtKind::IF: {
+            u64 cond = write_expr(w, stmt->if_stmt.cond);
+            w->ptr(&w->at<Stmt>(s)->if_stmt.cond, cond);
+            u64 then_stmts = write_stmt_block(w, stmt->if_stmt.then_block);
+            w->ptr(&w->at<Stmt>(s)->if_stmt.then_block.stmts, then_stmts);
+
+            u64 elseifs = 0;
+            if (stmt->if_stmt.elseifs) {
+                elseifs = w->alloc(stmt->if_stmt.num_elseifs * sizeof(ElseIf));
+                for (size_t i = 0; i < stmt->if_stmt.num_elseifs; i++) {
+                    ElseIf* elseif = stmt->if_stmt.elseifs + i;
+                    *(w->at<ElseIf>(elseifs) + i) = *elseif;
+                    u64 elseif_cond = write_expr(w, elseif->cond);
+                    w->ptr(&(w->at<ElseIf>(elseifs) + i)->cond, elseif_cond);
+                    u64 elseif_stmts = write_stmt_block(w, elseif->block);
+                    w->ptr(&(w->at<ElseIf>(elseifs) + i)->block.stmts, elseif_stmts);
+                }
+            }
+            w->ptr(&w->at<Stmt>(s)->if_stmt.elseifs, elseifs);
+
+            u64 else_stmts = write_stmt_block(w, stmt->if_stmt.else_block);
+            w->ptr(&w->at<Stmt>(s)->if_stmt.else_block.stmts, else_stmts);
+            break;
+        }
+        case StmtKind::WHILE:
+        case StmtKind::DO_WHILE: {
+            u64 cond = write_expr(w, stmt->while_stmt.cond);
+            w->ptr(&w->at<Stmt>(s)->while_stmt.cond, cond);
+            u64 stmts = write_stmt_block(w, stmt->while_stmt.block);
+            w->ptr(&w->at<Stmt>(s)->while_stmt.block.stmts, stmts);
+            break;
+        }
+        case StmtKind::FOR: {
+            u64 init = write_stmt(w, stmt->for_stmt.init);
+            w->ptr(&w->at<Stmt>(s)->for_stmt.init, init);
+            u64 cond = write_expr(w, stmt->for_stmt.cond);
+            w->ptr(&w->at<Stmt>(s)->for_stmt.cond, cond);
+            u64 next = write_stmt(w, stmt->for_stmt.next);
+            w->ptr(&w->at<Stmt>(s)->for_stmt.next, next);
+            u64 stmts = write_stmt_block(w, stmt->for_stmt.block);
+            w->ptr(&w->at<Stmt>(s)->for_stmt.block.stmts, stmts);
+            break;
+        }
+        case StmtKind::SWITCH: {
+            u64 expr = write_expr(w, stmt->switch_stmt.expr);
+            w->ptr(&w->at<Stmt>(s)->switch_stmt.expr, expr);
+
+            u64 cases = 0;
+            if (stmt->switch_stmt.cases) {
+                cases = w->alloc(stmt->switch_stmt.num_cases * sizeof(SwitchCase));
+                for (size_t i = 0; i < stmt->switch_stmt.num_cases; i++) {
+                    SwitchCase* switch_case = stmt->switch_stmt.cases + i;
+                    *(w->at<SwitchCase>(cases) + i) = *switch_case;
+                    u64 exprs = write_expr_list(w, switch_case->exprs, switch_case->num_exprs);
+                    w->ptr(&(w->at<SwitchCase>(cases) + i)->exprs, exprs);
+                    u64 stmts = write_stmt_block(w, switch_case->block);
+                    w->ptr(&(w->at<SwitchCase>(cases) + i)->block.stmts, stmts);
+                }
+            }
+            w->ptr(&w->at<Stmt>(s)->switch_stmt.cases, cases);
+            break;
+        }
+        case StmtKind::ASSIGN: {
+            u64 left = write_expr(w, stmt->assign.left);
+            w->ptr(&w->at<Stmt>(s)->assign.left, left);
+            u64 right = write_expr(w, stmt->assign.right);
+            w->ptr(&w->at<Stmt>(s)->assign.right, right);
+            break;
+        }
+        case StmtKind::INIT: {
+            w->name(&w->at<Stmt>(s)->init.name, stmt->init.name);
+            u64 expr = write_expr(w, stmt->init.expr);
+            w->ptr(&w->at<Stmt>(s)->init.expr, expr);
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+
+    return s;
+}
+
+Internal u64 write_decl(AstWriter* w, Decl* decl) {
+    if (!decl) {
+        return 0;
+    }
+
+    if (decl->kind == DeclKind::FUNC) {
+        materialize_func_body(decl);
+    }
+
+    u64 d = w->copy(decl);
+    w->name(&w->at<Decl>(d)->name, decl->name);
+    switch (decl->kind) {
+        case DeclKind::ENUM: {
+            u64 items = 0;
+            if (decl->enum_decl.items) {
+                items = w->alloc(decl->enum_decl.num_items * sizeof(EnumItem));
+                for (size_t i = 0; i < decl->enum_decl.num_items; i++) {
+                    EnumItem* item = decl->enum_decl.items + i;
+                    *(w->at<EnumItem>(items) + i) = *item;
+                    w->name(&(w->at<EnumItem>(items) + i)->name, item->name);
+                    u64 init = write_expr(w, item->init);
+                    w->ptr(&(w->at<EnumItem>(items) + i)->init, init);
+                }
+            }
+            w->ptr(&w->at<Decl>(d)->enum_decl.items, items);
+            break;
+        }
+        case DeclKind::STRUCT:
+        case DeclKind::UNION: {
+            u64 items = 0;
+            if (decl->aggregate.items) {
+                items = w->alloc(decl->aggregate.num_items * sizeof(AggregateItem));
+                for (size_t i = 0; i < decl->aggregate.num_items; i++) {
+                    AggregateItem* item = decl->aggregate.items + i;
+                    *(w->at<AggregateItem>(items) + i) = *item;
+                    u64 names = w->alloc(item->num_names * sizeof(const char*));
+                    for (size_t j = 0; j < item->num_names; j++) {
+                        w->name(w->at<const char*>(names) + j, item->names[j]);
+                    }
+                    w->ptr(&(w->at<AggregateItem>(items) + i)->names, names);
+                    u64 type = write_typespec(w, item->type);
+                    w->ptr(&(w->at<AggregateItem>(items) + i)->type, type);
+                }
+            }
+            w->ptr(&w->at<Decl>(d)->aggregate.items, items);
+            break;
+        }
+        case DeclKind::FUNC: {
+            u64 params = 0;
+            if (decl->func.params) {
+                params = w->alloc(decl->func.num_params * sizeof(FuncParam));
+                for (size_t i = 0; i < decl->func.num_params; i++) {
+                    FuncParam* param = decl->func.params + i;
+                    *(w->at<FuncParam>(params) + i) = *param;
+                    w->name(&(w->at<FuncParam>(params) + i)->name, param->name);
+                    u64 type = write_typespec(w, param->type);
+                    w->ptr(&(w->at<FuncParam>(params) + i)->type, type);
+                }
+            }
+            w->ptr(&w->at<Decl>(d)->func.params, params);
+            u64 ret_type = write_typespec(w, decl->func.ret_type);
+            w->ptr(&w->at<Decl>(d)->func.ret_type, ret_type);
+            u64 stmts = write_stmt_block(w, decl->func.block);
+            w->ptr(&w->at<Decl>(d)->func.block.stmts, stmts);
+            w->ptr(&w->at<Decl>(d)->func.lazy_body, 0);
+            break;
+        }
+        case DeclKind::TYPEDEF: {
+            u64 type = write_typespec(w, decl->typedef_decl.type);
+            w->ptr(&w->at<Decl>(d)->typedef_decl.type, type);
+            break;
+        }
+        case DeclKind::VAR: {
+            u64 type = write_typespec(w, decl->var.type);
+            w->ptr(&w->at<Decl>(d)->var.type, type);
+            u64 expr = write_expr(w, decl->var.expr);
+            w->ptr(&w->at<Decl>(d)->var.expr, expr);
+            break;
+        }
+        case DeclKind::CONST: {
+            u64 expr = write_expr(w, decl->const_decl.expr);
+            w->ptr(&w->at<Decl>(d)->const_decl.expr, expr);
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+
+    return d;
+}
+
+//*relocations are 32 bit, images over 4GB come back empty and are never stored
+std::vector<u8> ast_cache_serialize(const std::vector<Decl*>& decls) {
+    AstWriter w;
+    w.alloc(sizeof(AstCacheHeader));
+
+    u64 decl_list = w.alloc(decls.size() * sizeof(Decl*));
+    for (size_t i = 0; i < decls.size(); i++) {
+        u64 decl = write_decl(&w, decls[i]);
+        w.ptr(w.at<Decl*>(decl_list) + i, decl);
+    }
+
+    //*name table: offsets of NUL terminated strings, the strings follow the table
+    u64 names = w.alloc(w.names.size() * sizeof(u64));
+    for (size_t i = 0; i < w.names.size(); i++) {
+        size_t len = strlen(w.names[i]);
+        u64 str = w.alloc(len + 1);
+        memcpy(w.buf.data() + str, w.names[i], len + 1);
+        w.at<u64>(names)[i] = str;
+    }
+
+    u64 ptr_relocs = w.alloc(w.ptr_relocs.size() * sizeof(u32));
+    memcpy(w.buf.data() + ptr_relocs, w.ptr_relocs.data(), w.ptr_relocs.size() * sizeof(u32));
+    u64 name_relocs = w.alloc(w.name_relocs.size() * sizeof(u32));
+    memcpy(w.buf.data() + name_relocs, w.name_relocs.data(), w.name_relocs.size() * sizeof(u32));
+    u64 exprs = w.alloc(w.exprs.size() * sizeof(u32));
+    memcpy(w.buf.data() + exprs, w.exprs.data(), w.exprs.size() * sizeof(u32));
+    u64 typespecs = w.alloc(w.typespecs.size() * sizeof(u32));
+    memcpy(w.buf.data() + typespecs, w.typespecs.data(), w.typespecs.size() * sizeof(u32));
+
+    if (w.buf.size() > UINT32_MAX) {
+        return std::vector<u8>();
+    }
+
+    AstCacheHeader* header = w.at<AstCacheHeader>(0);
+    header->magic = AST_CACHE_MAGIC;
+    header->version = AST_CACHE_VERSION;
+    header->ptr_size = sizeof(void*);
+    header->layout = AST_CACHE_LAYOUT;
+    header->size = w.buf.size();
+    header->decls = decl_list;
+    header->num_decls = decls.size();
+    header->ptr_relocs = ptr_relocs;
+    header->num_ptr_relocs = w.ptr_relocs.size();
+    header->name_relocs = name_relocs;
+    header->num_name_relocs = w.name_relocs.size();
+    header->names = names;
+    header->num_names = w.names.size();
+    header->exprs = exprs;
+    header->num_exprs = w.exprs.size();
+    header->typespecs = typespecs;
+    header->num_typespecs = w.typespecs.size();
+
+    return w.buf;
+}
+
+//*FNV-1a over the format version and the source text
+u64 ast_cache_key(const char* src) {
+    u64 hash = 0xcbf29ce484222325ull;
+    u32 version = AST_CACHE_VERSION ^ AST_CACHE_LAYOUT;
+    for (size_t i = 0; i < sizeof(version); i++) {
+        hash = (hash ^ ((u8*)&version)[i]) * 0x100000001b3ull;
+    }
+
+    for (const char* it = src; *it; it++) {
+        hash = (hash ^ (u8)*it) * 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+Internal std::string ast_cache_path(const char* dir, const char* src) {
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.sast", (unsigned long long)ast_cache_key(src));
+    return std::string(dir) + name;
+}
+
+//*maps the whole file copy-on-write so the relocation pass can patch it in place, the mapping lives as long as the AST
+Internal u8* map_file(const char* path, size_t* size) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+
+    LARGE_INTEGER file_size;
+    HANDLE mapping = nullptr;
+    u8* ptr = nullptr;
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+        mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    }
+    if (mapping) {
+        ptr = (u8*)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+        CloseHandle(mapping);
+    }
+    CloseHandle(file);
+
+    *size = ptr ? (size_t)file_size.QuadPart : 0;
+    return ptr;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat st;
+    void* ptr = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        ptr = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+
+    if (ptr == MAP_FAILED) {
+        return nullptr;
+    }
+
+    *size = (size_t)st.st_size;
+    return (u8*)ptr;
+#endif
+}
+
+Internal void unmap_file(u8* ptr, size_t size) {
+#ifdef _WIN32
+    UnmapViewOfFile(ptr);
+#else
+    munmap(ptr, size);
+#endif
+}
+
+Internal bool is_valid_range(AstCacheHeader* header, u64 offset, u64 count, u64 elem_size) {
+    return offset <= header->size && count <= (header->size - offset) / elem_size;
+}
+
+Internal bool is_valid_field(AstCacheHeader* header, u64 offset, u64 field_size, u64 align) {
+    return field_size <= header->size && offset <= header->size - field_size && offset % align == 0;
+}
+
+//*every table entry must stay inside the image, so a truncated or corrupt image misses before anything is patched
+Internal bool is_valid_entries(u8* base) {
+    AstCacheHeader* header = (AstCacheHeader*)base;
+    u64* names = (u64*)(base + header->names);
+    for (u64 i = 0; i < header->num_names; i++) {
+        if (names[i] >= header->size || !memchr(base + names[i], 0, header->size - names[i])) {
+            return false;
+        }
+    }
+    u32* ptr_relocs = (u32*)(base + header->ptr_relocs);
+    for (u64 i = 0; i < header->num_ptr_relocs; i++) {
+        if (!is_valid_field(header, ptr_relocs[i], sizeof(uintptr_t), alignof(uintptr_t)) || *(uintptr_t*)(base + ptr_relocs[i]) >= header->size) {
+            return false;
+        }
+    }
+    u32* name_relocs = (u32*)(base + header->name_relocs);
+    for (u64 i = 0; i < header->num_name_relocs; i++) {
+        if (!is_valid_field(header, name_relocs[i], sizeof(uintptr_t), alignof(uintptr_t))) {
+            return false;
+        }
+        uintptr_t index = *(uintptr_t*)(base + name_relocs[i]);
+        if (index < 1 || index > header->num_names) {
+            return false;
+        }
+    }
+    u32* exprs = (u32*)(base + header->exprs);
+    for (u64 i = 0; i < header->num_exprs; i++) {
+        if (!is_valid_field(header, exprs[i], sizeof(Expr), alignof(Expr))) {
+            return false;
+        }
+    }
+    u32* typespecs = (u32*)(base + header->typespecs);
+    for (u64 i = 0; i < header->num_typespecs; i++) {
+        if (!is_valid_field(header, typespecs[i], sizeof(Typespec), alignof(Typespec))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool ast_cache_load(const char* dir, const char* src, std::vector<Decl*>* decls) {
+    size_t size = 0;
+    u8* base = map_file(ast_cache_path(dir, src).c_str(), &size);
+    if (!base) {
+        return false;
+    }
+
+    AstCacheHeader* header = (AstCacheHeader*)base;
+    bool valid = size >= sizeof(AstCacheHeader) && header->magic == AST_CACHE_MAGIC && header->version == AST_CACHE_VERSION
+        && header->ptr_size == sizeof(void*) && header->layout == AST_CACHE_LAYOUT && header->size == size
+        && is_valid_range(header, header->decls, header->num_decls, sizeof(Decl*))
+        && is_valid_range(header, header->ptr_relocs, header->num_ptr_relocs, sizeof(u32))
+        && is_valid_range(header, header->name_relocs, header->num_name_relocs, sizeof(u32))
+        && is_valid_range(header, header->names, header->num_names, sizeof(u64))
+        && is_valid_range(header, header->exprs, header->num_exprs, sizeof(u32))
+        && is_valid_range(header, header->typespecs, header->num_typespecs, sizeof(u32))
+        && is_valid_entries(base);
+    if (!valid) {
+        unmap_file(base, size);
+        return false;
+    }
+
+    //*intern the name table once, name fields then resolve with an index
+    std::vector<const char*> names;
+    names.reserve(header->num_names);
+    for (u64* it = (u64*)(base + header->names); it != (u64*)(base + header->names) + header->num_names; it++) {
+        names.push_back(Global::string_table.add((const char*)base + *it));
+    }
+
+    for (u32* it = (u32*)(base + header->ptr_relocs); it != (u32*)(base + header->ptr_relocs) + header->num_ptr_relocs; it++) {
+        *(uintptr_t*)(base + *it) += (uintptr_t)base;
+    }
+    for (u32* it = (u32*)(base + header->name_relocs); it != (u32*)(base + header->name_relocs) + header->num_name_relocs; it++) {
+        uintptr_t* field = (uintptr_t*)(base + *it);
+        *field = (uintptr_t)names[*field - 1];
+    }
+    for (u32* it = (u32*)(base + header->exprs); it != (u32*)(base + header->exprs) + header->num_exprs; it++) {
+        ((Expr*)(base + *it))->id = Global::next_expr_id++;
+    }
+    for (u32* it = (u32*)(base + header->typespecs); it != (u32*)(base + header->typespecs) + header->num_typespecs; it++) {
+        ((Typespec*)(base + *it))->id = Global::next_typespec_id++;
+    }
+
+    Decl** decl_list = (Decl**)(base + header->decls);
+    decls->assign(decl_list, decl_list + header->num_decls);
+    return true;
+}
+
+Internal void make_dir(const char* dir) {
+#ifdef _WIN32
+    _mkdir(dir);
+#else
+    mkdir(dir, 0755);
+#endif
+}
+
+bool ast_cache_store(const char* dir, const char* src, const std::vector<Decl*>& decls) {
+    std::vector<u8> image = ast_cache_serialize(decls);
+    if (image.empty()) {
+        return false;
+    }
+
+    make_dir(dir);
+
+    //*write to a temporary and rename so a concurrent reader never maps a partial image
+    std::string path = ast_cache_path(dir, src);
+    std::string tmp_path = path + ".tmp";
+    FILE* file = fopen(tmp_path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+
+    bool written = fwrite(image.data(), 1, image.size(), file) == image.size();
+    written = fclose(file) == 0 && written;
+    remove(path.c_str());
+    if (!written || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        remove(tmp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+void ast_cache_remove(const char* dir, const char* src) {
+    remove(ast_cache_path(dir, src).c_str());
+}
+
+std::vector<Decl*> parse_file_cached(const char* dir, const char* name, const char* src) {
+    std::vector<Decl*> decls;
+    if (ast_cache_load(dir, src, &decls)) {
+        return decls;
+    }
+
+    size_t num_diagnostics = Global::diagnostics.size();
+    decls = parse_file(name, src);
+    if (Global::diagnostics.size() == num_diagnostics) {
+        ast_cache_store(dir, src, decls);
+    }
+
+    return decls;
+}
+
+Internal void ast_cache_test_write(const char* dir, const char* src, const std::vector<u8>& image) {
+    FILE* file = fopen(ast_cache_path(dir, src).c_str(), "wb");
+    assert(file);
+    fwrite(image.data(), 1, image.size(), file);
+    fclose(file);
+}
+
+void ast_cache_test() {
+    const char* src =
+        "const n = sizeof(:int*[16])\n"
+        "var x = b == 1 ? 1+2 : 3-4\n"
+        "func fact(n: int): int { p := 1; for (i := 1; i <= n; i++) { p *= i; } return p; }\n"
+        "func f(x: int): bool { switch(x) { case 0: case 1: return true; case 2: default: return false; } }\n"
+        "func g(v: Vector*) { if (v.x) { print(\"x\", v[0]); } else if (2) { return; } else { do { v.y--; } while (1); } }\n"
+        "enum Color { RED = 3, GREEN, BLUE = 0 }\n"
+        "struct Vector { x, y: float; }\n"
+        "union IntOrFloat { i: int; f: float; }\n"
+        "typedef T = (func(int, Vector):int)[16]\n"
+        "var v: Vector = (:Vector){1.0, -1.0}\n";
+
+    std::vector<Decl*> parsed = parse_file("cache_test.sorin", src);
+    assert(Global::diagnostics.empty());
+    std::vector<u8> image = ast_cache_serialize(parsed);
+
+    const char* dir = AST_CACHE_DIR;
+    remove(ast_cache_path(dir, src).c_str());
+    std::vector<Decl*> loaded;
+    assert(!ast_cache_load(dir, src, &loaded));
+    assert(ast_cache_store(dir, src, parsed));
+    assert(ast_cache_load(dir, src, &loaded));
+
+    //*the loaded graph serializes to the same image, so it has the same shape and names
+    assert(loaded.size() == parsed.size() && loaded[0] != parsed[0]);
+    assert(ast_cache_serialize(loaded) == image);
+    assert(loaded[2]->kind == DeclKind::FUNC && loaded[2]->name == parsed[2]->name);
+    assert(loaded[2]->func.params[0].type->name == Global::string_table.add("int"));
+    assert(loaded[8]->typedef_decl.type->array.elem->func.num_args == 2);
+
+    //*loaded expressions get ids of their own, the resolver's side tables never alias the parsed tree's
+    assert(loaded[0]->const_decl.expr->id != parsed[0]->const_decl.expr->id);
+    assert(loaded[0]->const_decl.expr->id < Global::next_expr_id);
+    Typespec* loaded_type = loaded[8]->typedef_decl.type;
+    assert(loaded_type->id != parsed[8]->typedef_decl.type->id && loaded_type->id < Global::next_typespec_id);
+    assert(loaded_type->hash == parsed[8]->typedef_decl.type->hash && loaded_type->hash != 0);
+
+    //*a different source misses
+    std::vector<Decl*> other;
+    assert(!ast_cache_load(dir, "const n = 1", &other));
+
+    //*corrupt entries miss too, the relocation pass never writes outside the image
+    AstCacheHeader* header = (AstCacheHeader*)image.data();
+    u32 ptr_reloc = *(u32*)(image.data() + header->ptr_relocs);
+    u32 name_reloc = *(u32*)(image.data() + header->name_relocs);
+    for (int i = 0; i < 6; i++) {
+        std::vector<u8> corrupt = image;
+        u8* base = corrupt.data();
+        switch (i) {
+            case 0: {
+                *(u32*)(base + header->ptr_relocs) = (u32)header->size;
+                break;
+            }
+            case 1: {
+                *(uintptr_t*)(base + ptr_reloc) = (uintptr_t)header->size;
+                break;
+            }
+            case 2: {
+                *(uintptr_t*)(base + name_reloc) = (uintptr_t)header->num_names + 1;
+                break;
+            }
+            case 3: {
+                *(uintptr_t*)(base + name_reloc) = 0;
+                break;
+            }
+            case 4: {
+                *(u64*)(base + header->names) = header->size;
+                break;
+            }
+            default: {
+                *(u32*)(base + header->exprs) = (u32)header->size - 1;
+                break;
+            }
+        }
+        ast_cache_test_write(dir, src, corrupt);
+        assert(!ast_cache_load(dir, src, &other));
+    }
+
+    //*so does a truncated image
+    std::vector<u8> truncated(image.begin(), image.end() - 1);
+    ((AstCacheHeader*)truncated.data())->size = truncated.size();
+    ast_cache_test_write(dir, src, truncated);
+    assert(!ast_cache_load(dir, src, &other));
+
+    //*and a name string that is not terminated inside the image
+    std::vector<u8> unterminated = image;
+    u64 last_name = *((u64*)(unterminated.data() + header->names) + header->num_names - 1);
+    unterminated.resize(last_name + 1);
+    unterminated[last_name] = 'x';
+    AstCacheHeader* short_header = (AstCacheHeader*)unterminated.data();
+    short_header->size = unterminated.size();
+    short_header->ptr_relocs = short_header->name_relocs = short_header->exprs = short_header->typespecs = 0;
+    short_header->num_ptr_relocs = short_header->num_name_relocs = short_header->num_exprs = short_header->num_typespecs = 0;
+    ast_cache_test_write(dir, src, unterminated);
+    assert(!ast_cache_load(dir, src, &other));
+    remove(ast_cache_path(dir, src).c_str());
+
+    //*the driver's loader stores the file on the first load and resolves the cached AST on the next
+    const char* package_src = "struct Pair { a, b: int; }\nfunc sum(p: Pair*): int { return p.a + p.b; }\n";
+    FILE* file = fopen("cache_test.sorin", "wb");
+    assert(file);
+    fputs(package_src, file);
+    fclose(file);
+    remove(ast_cache_path(dir, package_src).c_str());
+    Global::ast_cache_dir = dir;
+    assert(load_package_file("cache_test.sorin") && ast_cache_load(dir, package_src, &other));
+    assert(load_package_file("cache_test.sorin"));
+    Sym* sum = sym_get(Global::string_table.add("sum"));
+    assert(sum && sum->state == SymState::RESOLVED && sum->type->func.ret == Global::type_int);
+    Global::ast_cache_dir = nullptr;
+    remove("cache_test.sorin");
+    remove(ast_cache_path(dir, package_src).c_str());
+    reset_syms();
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <vector>
+#include "Ast.hpp"
+
+//*files parsed through parse_file_cached are stored as flat, position independent images keyed by a hash of their
+//*contents and the format version. a warm load is one mmap plus a relocation pass, no lexing or parsing.
+constexpr const char* AST_CACHE_DIR = ".sorin-cache";
+
+u64 ast_cache_key(const char* src);
+bool ast_cache_load(const char* dir, const char* src, std::vector<Decl*>* decls);
+bool ast_cache_store(const char* dir, const char* src, const std::vector<Decl*>& decls);
+void ast_cache_remove(const char* dir, const char* src);
+std::vector<u8> ast_cache_serialize(const std::vector<Decl*>& decls);
+
+std::vector<Decl*> parse_file_cached(const char* dir, const char* name, const char* src);
+
+void ast_cache_test();
@@ -0,0 +1,1492 @@
+#include "Bench.hpp"
+#include "Globals.hpp"
+#include "Lex.hpp"
+#include "Parse.hpp"
+#include "AstCache.hpp"
+#include "Visit.hpp"
+#include "Resolve.hpp"
+#include "Gen.hpp"
+#include "Ir.hpp"
+#include "Opt.hpp"
+#include "Vm.hpp"
+#include "Jit.hpp"
+#include "Riscv.hpp"
+#include "Elf.hpp"
+#include <chrono>
+#include <thread>
+#include <string>
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#endif
+
+typedef void(*BenchFunc)();
+
+struct Bench {
+    const char* name;
+    BenchFunc func;
+};
+
+struct BenchTimer {
+    std::chrono::high_resolution_clock::time_point start;
+
+    BenchTimer() : start(std::chrono::high_resolution_clock::now()) {}
+
+    f64 elapsed_ns() const {
+        return (f64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+};
+
+//*deterministic xorshift so every run benchmarks the same input
+GlobalVariable u64 bench_rng_state = 0x9E3779B97F4A7C15ull;
+
+Internal u64 bench_rng() {
+    bench_rng_state ^= bench_rng_state << 13;
+    bench_rng_state ^= bench_rng_state >> 7;
+    bench_rng_state ^= bench_rng_state << 17;
+    return bench_rng_state;
+}
+
+//*appends a random expression with the given number of binary operators, returns the number of nodes generated
+Internal size_t bench_gen_expr(std::string& out, int num_ops) {
+    LocalPersist const char* ops[] = { "*", "/", "%", "&", "<<", ">>", "+", "-", "^", "|", "==", "<", ">", "<=", ">=", "&&" };
+    LocalPersist const char* operands[] = { "a", "b", "c", "d", "x", "y", "1", "2", "42", "1024" };
+
+    size_t nodes = 0;
+    for (int i = 0; i <= num_ops; i++) {
+        if (i != 0) {
+            out += " ";
+            out += ops[bench_rng() % (sizeof(ops) / sizeof(*ops))];
+            out += " ";
+            nodes++;
+        }
+
+        if (bench_rng() % 4 == 0) {
+            out += "-";
+            nodes++;
+        }
+
+        out += operands[bench_rng() % (sizeof(operands) / sizeof(*operands))];
+        nodes++;
+    }
+
+    return nodes;
+}
+
+//*a counter of the branch misses of this thread in user space, -1 where the host has none to give: not Linux, no
+//*hardware counters, or a perf_event_paranoid that forbids them
+Internal int bench_branch_misses_open() {
+#ifdef __linux__
+    perf_event_attr attr = {};
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    return -1;
+#endif
+}
+
+Internal void bench_counter_start(int fd) {
+#ifdef __linux__
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#else
+    (void)fd;
+#endif
+}
+
+Internal u64 bench_counter_stop(int fd) {
+    u64 count = 0;
+#ifdef __linux__
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd, &count, sizeof(count)) != (ssize_t)sizeof(count)) {
+        count = 0;
+    }
+#else
+    (void)fd;
+#endif
+    return count;
+}
+
+//*one parser over the generated input, best of iterations
+struct BenchParseExpr {
+    f64 ns;
+    u64 calls;
+    u64 branch_misses;
+};
+
+Internal BenchParseExpr bench_parse_expr_run(const std::string& src, bool descent_chain, int branch_misses_fd, int iterations) {
+    BenchParseExpr best = {};
+    Global::parse_descent_chain = descent_chain;
+    for (int i = 0; i < iterations; i++) {
+        Global::parse_binary_calls = 0;
+        if (branch_misses_fd >= 0) {
+            bench_counter_start(branch_misses_fd);
+        }
+        BenchTimer timer;
+        init_stream(src.c_str());
+        Expr* expr = parse_expr();
+        f64 ns = timer.elapsed_ns();
+        u64 branch_misses = branch_misses_fd >= 0 ? bench_counter_stop(branch_misses_fd) : 0;
+        if (!expr || !is_token_eof()) {
+            fatal("bench_parse_expr: failed to parse generated input");
+        }
+        if (i == 0 || ns < best.ns) {
+            best.ns = ns;
+        }
+        if (i == 0 || branch_misses < best.branch_misses) {
+            best.branch_misses = branch_misses;
+        }
+        best.calls = Global::parse_binary_calls;
+    }
+    Global::parse_descent_chain = false;
+    return best;
+}
+
+//*precedence climbing against the descent chain it replaced, on the same expression-dense input
+Internal void bench_parse_expr() {
+    const int num_exprs = 20000;
+    const int ops_per_expr = 24;
+    const int iterations = 10;
+
+    std::string src;
+    size_t nodes = 0;
+    for (int i = 0; i < num_exprs; i++) {
+        src += "(";
+        nodes += bench_gen_expr(src, ops_per_expr);
+        src += ") + ";
+        nodes++;
+    }
+    src += "0";
+    nodes++;
+
+    int branch_misses_fd = bench_branch_misses_open();
+    printf("parse_expr: %zu nodes, %zu bytes, best of %d%s\n", nodes, src.size(), iterations,
+        branch_misses_fd >= 0 ? "" : ", no branch miss counter on this host");
+    const char* names[] = { "precedence climbing", "descent chain" };
+    for (int chain = 0; chain < 2; chain++) {
+        BenchParseExpr run = bench_parse_expr_run(src, chain != 0, branch_misses_fd, iterations);
+        printf("parse_expr: %-19s %.3f ms, %.2f ns/node, %.2f calls/node", names[chain], run.ns / 1e6, run.ns / (f64)nodes,
+            (f64)run.calls / (f64)nodes);
+        if (branch_misses_fd >= 0) {
+            printf(", %.3f branch misses/node", (f64)run.branch_misses / (f64)nodes);
+        }
+        printf("\n");
+    }
+#ifdef __linux__
+    if (branch_misses_fd >= 0) {
+        close(branch_misses_fd);
+    }
+#endif
+}
+
+//*best time of parse_file over the generated source, with function bodies parsed eagerly or lazily
+Internal f64 bench_parse_file_ns(const char* src, bool lazy, int iterations) {
+    f64 best_ns = 0;
+    for (int i = 0; i < iterations; i++) {
+        Global::lazy_func_bodies = lazy;
+        BenchTimer timer;
+        std::vector<Decl*> decls = parse_file("bench", src);
+        f64 ns = timer.elapsed_ns();
+        Global::lazy_func_bodies = false;
+
+        if (decls.empty() || !Global::diagnostics.empty()) {
+            fatal("bench_parse_lazy: failed to parse generated input");
+        }
+        if (i == 0 || ns < best_ns) {
+            best_ns = ns;
+        }
+    }
+
+    return best_ns;
+}
+
+//*a package-sized source of functions with statement and expression heavy bodies
+Internal std::string bench_gen_funcs(int num_funcs, int stmts_per_func) {
+    std::string src;
+    for (int i = 0; i < num_funcs; i++) {
+        src += "func f" + std::to_string(i) + "(a: int, b: int*, c: Vector): int {\n";
+        for (int j = 0; j < stmts_per_func; j++) {
+            src += "    x := ";
+            bench_gen_expr(src, 6);
+            src += ";\n    if (x < 10) { y = x << 2; } else { y = b[x] - c.x; }\n";
+        }
+        src += "    return x;\n}\n";
+    }
+
+    return src;
+}
+
+Internal void bench_parse_lazy() {
+    const int num_funcs = 2000;
+    const int iterations = 5;
+    std::string src = bench_gen_funcs(num_funcs, 16);
+
+    f64 eager_ns = bench_parse_file_ns(src.c_str(), false, iterations);
+    f64 lazy_ns = bench_parse_file_ns(src.c_str(), true, iterations);
+
+    printf("parse_lazy: %d funcs, %zu bytes, eager: %.3f ms, signatures only: %.3f ms, %.1fx\n",
+        num_funcs, src.size(), eager_ns / 1e6, lazy_ns / 1e6, eager_ns / lazy_ns);
+}
+
+Internal void bench_ast_cache() {
+    const int num_funcs = 2000;
+    std::string src = bench_gen_funcs(num_funcs, 16);
+
+    BenchTimer parse_timer;
+    std::vector<Decl*> decls = parse_file("bench", src.c_str());
+    f64 parse_ns = parse_timer.elapsed_ns();
+
+    BenchTimer store_timer;
+    if (!ast_cache_store(AST_CACHE_DIR, src.c_str(), decls)) {
+        fatal("bench_ast_cache: failed to write %s", AST_CACHE_DIR);
+    }
+    f64 store_ns = store_timer.elapsed_ns();
+
+    //*the key hashes the whole source, so it is part of the warm cost
+    BenchTimer load_timer;
+    std::vector<Decl*> loaded;
+    if (!ast_cache_load(AST_CACHE_DIR, src.c_str(), &loaded) || loaded.size() != decls.size()) {
+        fatal("bench_ast_cache: failed to load the cached image");
+    }
+    f64 load_ns = load_timer.elapsed_ns();
+    //*the image is tens of MB and keyed by a source no real build has
+    ast_cache_remove(AST_CACHE_DIR, src.c_str());
+
+    printf("ast_cache: %d funcs, %zu bytes, parse: %.3f ms, store: %.3f ms, warm load: %.3f ms, %.1fx\n",
+        num_funcs, src.size(), parse_ns / 1e6, store_ns / 1e6, load_ns / 1e6, parse_ns / load_ns);
+}
+
+Internal bool bench_count_pre(void* ctx, AstNode node) {
+    (*(size_t*)ctx)++;
+    return true;
+}
+
+Internal void bench_count_post(void* ctx, AstNode node) {
+    (*(size_t*)ctx)++;
+}
+
+Internal f64 bench_walk_ns(Expr* root, bool recursive, size_t expected_events) {
+    size_t events = 0;
+    AstVisitor visitor = { &events, bench_count_pre, bench_count_post };
+    BenchTimer timer;
+    if (recursive) {
+        ast_walk_recursive(&visitor, ast_node(root));
+    }
+    else {
+        ast_walk(&visitor, ast_node(root));
+    }
+    f64 ns = timer.elapsed_ns();
+
+    if (events != expected_events) {
+        fatal("bench_visit: walk saw %zu events, expected %zu", events, expected_events);
+    }
+    return ns;
+}
+
+//*left-nested chain ((0 + 1) + 2) + ..., as deep as it is long
+Internal Expr* bench_gen_chain(int depth) {
+    Expr* chain = expr_int(0);
+    for (int i = 1; i <= depth; i++) {
+        chain = expr_binary(TokenKind::ADD, chain, expr_int(i));
+    }
+    return chain;
+}
+
+Internal void bench_visit() {
+    //*the recursive reference overflows a default stack long before 1M levels, so it is compared on a shallower chain
+    const int deep = 1000000;
+    const int shallow = 10000;
+
+    Expr* deep_chain = bench_gen_chain(deep);
+    size_t deep_nodes = 2 * (size_t)deep + 1;
+    f64 deep_ns = bench_walk_ns(deep_chain, false, 2 * deep_nodes);
+
+    Expr* shallow_chain = bench_gen_chain(shallow);
+    size_t shallow_nodes = 2 * (size_t)shallow + 1;
+    f64 iterative_ns = bench_walk_ns(shallow_chain, false, 2 * shallow_nodes);
+    f64 recursive_ns = bench_walk_ns(shallow_chain, true, 2 * shallow_nodes);
+
+    printf("visit: depth %d iterative: %.3f ms, %.2f ns/node\n", deep, deep_ns / 1e6, deep_ns / (f64)deep_nodes);
+    printf("visit: depth %d iterative: %.2f ns/node, recursive: %.2f ns/node\n",
+        shallow, iterative_ns / (f64)shallow_nodes, recursive_ns / (f64)shallow_nodes);
+}
+
+//*one function with thousands of locals in nested blocks, every initializer reads an earlier local and a global
+Internal std::string bench_gen_locals(int num_globals, int num_locals) {
+    std::string src;
+    for (int i = 0; i < num_globals; i++) {
+        src += "const g" + std::to_string(i) + " = " + std::to_string(i) + "\n";
+    }
+
+    src += "func big(a: int): int {\n    v0 := a;\n";
+    for (int i = 1; i < num_locals; i++) {
+        std::string local = "v" + std::to_string(bench_rng() % i);
+        std::string global = "g" + std::to_string(bench_rng() % num_globals);
+        src += "    v" + std::to_string(i) + " := " + local + " + " + global + ";\n";
+        if (i % 64 == 0) {
+            src += "    { v" + std::to_string(i) + " := " + local + "; v" + std::to_string(i) + "++; }\n";
+        }
+    }
+    src += "    return v" + std::to_string(num_locals - 1) + ";\n}\n";
+
+    return src;
+}
+
+Internal void bench_resolve_locals() {
+    const int num_globals = 1000;
+    const int num_locals = 5000;
+    const int iterations = 5;
+    std::string src = bench_gen_locals(num_globals, num_locals);
+
+    f64 best_ns = 0;
+    for (int i = 0; i < iterations; i++) {
+        reset_syms();
+        std::vector<Decl*> decls = parse_file("bench", src.c_str());
+        if (!Global::diagnostics.empty()) {
+            fatal("bench_resolve_locals: failed to parse generated input");
+        }
+
+        BenchTimer timer;
+        resolve_package(decls);
+        f64 ns = timer.elapsed_ns();
+        if (i == 0 || ns < best_ns) {
+            best_ns = ns;
+        }
+    }
+    reset_syms();
+
+    printf("resolve_locals: %d globals, %d locals, best of %d: %.3f ms\n", num_globals, num_locals, iterations, best_ns / 1e6);
+}
+
+//*functions of long mixed int/float/char arithmetic, every operator goes through the usual arithmetic conversions
+Internal std::string bench_gen_arith(int num_funcs, int stmts_per_func, int ops_per_expr) {
+    LocalPersist const char* ops[] = { "+", "-", "*", "<", "==", "&&" };
+    LocalPersist const char* operands[] = { "a", "b", "c", "x", "1", "2.5", "x" };
+
+    std::string src;
+    for (int i = 0; i < num_funcs; i++) {
+        src += "func f" + std::to_string(i) + "(a: int, b: float, c: char): float {\n    x := a;\n";
+        for (int j = 0; j < stmts_per_func; j++) {
+            src += "    x = ";
+            for (int k = 0; k <= ops_per_expr; k++) {
+                if (k != 0) {
+                    src += std::string(" ") + ops[bench_rng() % (sizeof(ops) / sizeof(*ops))] + " ";
+                }
+                src += operands[bench_rng() % (sizeof(operands) / sizeof(*operands))];
+            }
+            src += ";\n";
+        }
+        src += "    return x;\n}\n";
+    }
+
+    return src;
+}
+
+Internal void bench_resolve_arith() {
+    const int num_funcs = 500;
+    const int iterations = 5;
+    std::string src = bench_gen_arith(num_funcs, 16, 24);
+
+    f64 best_ns = 0;
+    size_t num_exprs = 0;
+    for (int i = 0; i < iterations; i++) {
+        reset_syms();
+        u32 first_expr = Global::next_expr_id;
+        std::vector<Decl*> decls = parse_file("bench", src.c_str());
+        if (!Global::diagnostics.empty()) {
+            fatal("bench_resolve_arith: failed to parse generated input");
+        }
+        num_exprs = Global::next_expr_id - first_expr;
+
+        BenchTimer timer;
+        resolve_package(decls);
+        f64 ns = timer.elapsed_ns();
+        if (i == 0 || ns < best_ns) {
+            best_ns = ns;
+        }
+    }
+    reset_syms();
+
+    printf("resolve_arith: %d funcs, %zu exprs, best of %d: %.3f ms, %.2f ns/expr\n",
+        num_funcs, num_exprs, iterations, best_ns / 1e6, best_ns / (f64)num_exprs);
+}
+
+//*many aggregates whose fields build distinct pointer, array and function types
+Internal std::string bench_gen_types(int num_structs) {
+    std::string src;
+    for (int i = 0; i < num_structs; i++) {
+        std::string other = "S" + std::to_string(bench_rng() % num_structs);
+        src += "struct S" + std::to_string(i) + " { next: S" + std::to_string(i) + "*; other: " + other + "**; ";
+        src += "items: int[" + std::to_string(i + 1) + "]; ";
+        src += "cb: func(" + other + "*, S" + std::to_string(i) + "*): float; }\n";
+    }
+
+    return src;
+}
+
+Internal void bench_resolve_types() {
+    const int num_structs = 4000;
+    const int iterations = 5;
+    std::string src = bench_gen_types(num_structs);
+
+    f64 best_ns = 0;
+    for (int i = 0; i < iterations; i++) {
+        reset_syms();
+        std::vector<Decl*> decls = parse_file("bench", src.c_str());
+        if (!Global::diagnostics.empty()) {
+            fatal("bench_resolve_types: failed to parse generated input");
+        }
+
+        BenchTimer timer;
+        resolve_package(decls);
+        f64 ns = timer.elapsed_ns();
+        if (i == 0 || ns < best_ns) {
+            best_ns = ns;
+        }
+    }
+    reset_syms();
+
+    printf("resolve_types: %d structs, best of %d: %.3f ms\n", num_structs, iterations, best_ns / 1e6);
+}
+
+//*a handful of spellings repeated in every signature and body, like real code spells int* and Vector[16] everywhere
+Internal std::string bench_gen_typespecs(int num_funcs) {
+    std::string src = "struct Vector { x, y, z: float; }\ntypedef Callback = func(Vector*, int): float\n";
+    for (int i = 0; i < num_funcs; i++) {
+        src += "func f" + std::to_string(i) + "(v: Vector*, vs: Vector[16]*, cb: func(Vector*, int): float, p: int**, ";
+        src += "h: func(func(int*, float): Vector**, Vector[4][4]): Callback*): int {\n";
+        src += "    var a: Vector[16]* = vs\n";
+        src += "    var b: func(Vector*, int): float = cb\n";
+        src += "    var c: func(func(int*, float): Vector**, Vector[4][4]): Callback* = h\n";
+        src += "    return sizeof(:Vector[4][4]) + sizeof(:func(int*, float): Vector**) + sizeof(:int**);\n";
+        src += "}\n";
+    }
+
+    return src;
+}
+
+Internal void bench_resolve_typespecs() {
+    const int num_funcs = 20000;
+    const int iterations = 5;
+    std::string src = bench_gen_typespecs(num_funcs);
+
+    f64 best_ns = 0;
+    u32 num_typespecs = 0;
+    for (int i = 0; i < iterations; i++) {
+        reset_syms();
+        u32 first_typespec = Global::next_typespec_id;
+        std::vector<Decl*> decls = parse_file("bench", src.c_str());
+        if (!Global::diagnostics.empty()) {
+            fatal("bench_resolve_typespecs: failed to parse generated input");
+        }
+        num_typespecs = Global::next_typespec_id - first_typespec;
+
+        BenchTimer timer;
+        resolve_package(decls);
+        f64 ns = timer.elapsed_ns();
+        if (i == 0 || ns < best_ns) {
+            best_ns = ns;
+        }
+    }
+    reset_syms();
+
+    printf("resolve_typespecs: %u typespecs, best of %d: %.3f ms (%.1f ns/typespec)\n", num_typespecs, iterations, best_ns / 1e6, best_ns / num_typespecs);
+}
+
+//*a dense switch over 0..255 and a sparse one over multiples of 1009, each case a different little expression
+Internal std::string bench_gen_switches(int num_cases, int iterations) {
+    std::string src;
+    const char* names[] = { "dense", "sparse" };
+    for (int f = 0; f < 2; f++) {
+        src += "func " + std::string(names[f]) + "(x: int): int {\n    switch (x) {\n";
+        for (int i = 0; i < num_cases; i++) {
+            int key = f == 0 ? i : i * 1009;
+            src += "    case " + std::to_string(key) + ": return x * " + std::to_string(i % 13 + 2) + " + " + std::to_string(i) + ";\n";
+        }
+        src += "    }\n    return 7;\n}\n";
+    }
+
+    //*half the sparse lookups miss
+    src += "func main(): int {\n";
+    src += "    var s: uint = 12345\n";
+    src += "    var sum: uint = 0\n";
+    src += "    for (i := 0; i < " + std::to_string(iterations) + "; i++) {\n";
+    src += "        s = s * 1664525 + 1013904223;\n";
+    src += "        sum += dense(s >> 24) + sparse((((s >> 8) & 255) * 1009) + ((s >> 4) & 1));\n";
+    src += "    }\n";
+    src += "    return sum & 127;\n";
+    src += "}\n";
+    return src;
+}
+
+//*compiles the generated C with the host compiler in $CC and returns the run time, negative when it could not be built
+Internal f64 bench_run_c(const std::string& c, const char* name, const char* flags, int* status) {
+    std::string c_path = std::string(name) + ".c";
+    FILE* file = fopen(c_path.c_str(), "wb");
+    if (!file) {
+        return -1;
+    }
+    fwrite(c.data(), 1, c.size(), file);
+    fclose(file);
+
+    const char* cc = getenv("CC");
+#ifdef _WIN32
+    std::string exe_path = std::string(name) + ".exe";
+#else
+    std::string exe_path = "./" + std::string(name);
+#endif
+    std::string compile = std::string(cc ? cc : "cc") + " " + flags + " -o " + exe_path + " " + c_path;
+    bool built = system(compile.c_str()) == 0;
+    remove(c_path.c_str());
+    if (!built) {
+        return -1;
+    }
+
+    BenchTimer timer;
+    *status = system(exe_path.c_str());
+    f64 ns = timer.elapsed_ns();
+    remove(exe_path.c_str());
+    return ns;
+}
+
+Internal void bench_switch_dispatch() {
+    const int num_cases = 256;
+    const int iterations = 20000000;
+    std::string src = bench_gen_switches(num_cases, iterations);
+
+    reset_syms();
+    std::vector<Decl*> decls = parse_file("bench", src.c_str());
+    if (!Global::diagnostics.empty()) {
+        fatal("bench_switch_dispatch: failed to parse generated input");
+    }
+    resolve_package(decls);
+
+    Global::gen_linear_switches = true;
+    std::string linear = gen_package();
+    Global::gen_linear_switches = false;
+    std::string planned = gen_package();
+    reset_syms();
+
+    int linear_status = 0;
+    int planned_status = 0;
+    f64 linear_ns = bench_run_c(linear, "sorin_bench_switch_linear", "-O1", &linear_status);
+    f64 planned_ns = bench_run_c(planned, "sorin_bench_switch_planned", "-O1", &planned_status);
+    if (linear_ns < 0 || planned_ns < 0) {
+        printf("switch_dispatch: skipped, the generated C could not be compiled with $CC -O1\n");
+        return;
+    }
+    if (linear_status != planned_status) {
+        fatal("switch_dispatch: linear and planned switches disagree");
+    }
+
+    printf("switch_dispatch: %d lookups in 2 switches of %d cases, linear %.3f ms, planned %.3f ms (%.2fx)\n",
+           iterations, num_cases, linear_ns / 1e6, planned_ns / 1e6, linear_ns / planned_ns);
+}
+
+Internal bool bench_count_binary(void* ctx, AstNode node) {
+    if (node.kind == AstNodeKind::EXPR && node.expr->kind == ExprKind::BINARY) {
+        (*(size_t*)ctx)++;
+    }
+    return true;
+}
+
+//*lowering cost, then one pass that counts the binary operators of every body, once walking the AST and once
+//*scanning the IR. the IR count is lower, && becomes branches
+Internal void bench_ir_lower() {
+    const int num_funcs = 500;
+    const int iterations = 5;
+    std::string src = bench_gen_arith(num_funcs, 16, 24);
+
+    reset_syms();
+    std::vector<Decl*> decls = parse_file("bench", src.c_str());
+    if (!Global::diagnostics.empty()) {
+        fatal("bench_ir_lower: failed to parse generated input");
+    }
+    resolve_package(decls);
+
+    f64 lower_ns = 0;
+    for (int i = 0; i < iterations; i++) {
+        BenchTimer timer;
+        ir_lower_package();
+        f64 ns = timer.elapsed_ns();
+        lower_ns = i == 0 || ns < lower_ns ? ns : lower_ns;
+    }
+
+    size_t num_insts = 0;
+    std::string error;
+    for (IrFunc* it : Global::ir_funcs) {
+        num_insts += it->num_insts;
+        if (!ir_verify(it, &error)) {
+            fatal("bench_ir_lower: %s: %s", it->sym->name, error.c_str());
+        }
+    }
+
+    f64 ast_ns = 0;
+    size_t ast_count = 0;
+    for (int i = 0; i < iterations; i++) {
+        ast_count = 0;
+        AstVisitor visitor = { &ast_count, bench_count_binary, nullptr };
+        BenchTimer timer;
+        for (Sym* it : Global::syms) {
+            if (it->kind == SymKind::FUNC) {
+                ast_walk(&visitor, ast_node(it->decl));
+            }
+        }
+        f64 ns = timer.elapsed_ns();
+        ast_ns = i == 0 || ns < ast_ns ? ns : ast_ns;
+    }
+
+    f64 ir_ns = 0;
+    size_t ir_count = 0;
+    for (int i = 0; i < iterations; i++) {
+        ir_count = 0;
+        BenchTimer timer;
+        for (IrFunc* it : Global::ir_funcs) {
+            for (IrInst* inst = it->insts; inst != it->insts + it->num_insts; inst++) {
+                ir_count += inst->op >= IrOp::ADD && inst->op <= IrOp::GE;
+            }
+        }
+        f64 ns = timer.elapsed_ns();
+        ir_ns = i == 0 || ns < ir_ns ? ns : ir_ns;
+    }
+    reset_syms();
+
+    printf("ir_lower: %d funcs, %zu insts, lower: %.3f ms, pass over the AST: %.3f ms (%zu ops), over the IR: %.3f ms (%zu ops), %.1fx\n",
+        num_funcs, num_insts, lower_ns / 1e6, ast_ns / 1e6, ast_count, ir_ns / 1e6, ir_count, ast_ns / ir_ns);
+}
+
+struct BenchProgram {
+    const char* name;
+    const char* src;
+};
+
+//*each program returns a checksum as its exit status
+GlobalVariable BenchProgram bench_opt_programs[] = {
+    { "fact",
+      "func fact(n: int): int { p := 1; for (i := 2; i <= n; i++) { p *= i; } return p; }\n"
+      "func main(): int {\n"
+      "    base := 12;\n"
+      "    var s: uint = 0\n"
+      "    for (k := 0; k < 3000000; k++) { s += fact(k & 15) + fact(base) * (base - 11); }\n"
+      "    return s & 127;\n"
+      "}\n" },
+    { "loops",
+      "var data: int[1024]\n"
+      "func kernel(scale: int): int {\n"
+      "    s := 0;\n"
+      "    for (i := 0; i < 1024; i++) {\n"
+      "        if (scale > 2) { s += data[i] * scale + data[i] * scale + (i + 0) * 1; } else { s -= data[i]; }\n"
+      "    }\n"
+      "    return s;\n"
+      "}\n"
+      "func main(): int {\n"
+      "    for (i := 0; i < 1024; i++) { data[i] = i * 7 % 13; }\n"
+      "    s := 0;\n"
+      "    for (k := 0; k < 20000; k++) { s += kernel(3); }\n"
+      "    return s & 127;\n"
+      "}\n" },
+    { "switch",
+      "var code: int[64]\n"
+      "func run(steps: int): int {\n"
+      "    acc := 0;\n"
+      "    pc := 0;\n"
+      "    mode := 1;\n"
+      "    for (i := 0; i < steps; i++) {\n"
+      "        op := code[pc];\n"
+      "        switch (op) {\n"
+      "        case 0: acc += 1 * mode;\n"
+      "        case 1: acc *= 3;\n"
+      "        case 2: acc -= 7 * mode;\n"
+      "        case 3: acc ^= pc;\n"
+      "        case 4 case 5: acc += op * mode;\n"
+      "        default: acc = acc + 0;\n"
+      "        }\n"
+      "        pc = (pc + mode) & 63;\n"
+      "    }\n"
+      "    return acc;\n"
+      "}\n"
+      "func main(): int {\n"
+      "    for (i := 0; i < 64; i++) { code[i] = i * 5 % 7; }\n"
+      "    return run(50000000) & 127;\n"
+      "}\n" },
+};
+
+//*C is generated from the IR of the program optimized with each pass mask and built with $CC -O0, so that the C compiler
+//*does not redo the work of the passes. false when the C could not be built
+Internal bool bench_compare_passes(const char* bench, const BenchProgram& program, const u32 passes[2]) {
+    reset_syms();
+    std::vector<Decl*> decls = parse_file("bench", program.src);
+    if (!Global::diagnostics.empty()) {
+        fatal("%s: failed to parse %s", bench, program.name);
+    }
+    resolve_package(decls);
+
+    std::string c[2];
+    size_t num_insts[2] = {};
+    for (int optimized = 0; optimized < 2; optimized++) {
+        ir_lower_package();
+        Global::ir_passes = passes[optimized];
+        ir_optimize_package();
+        Global::ir_passes = 0xFFFFFFFF;
+        for (IrFunc* it : Global::ir_funcs) {
+            num_insts[optimized] += it->num_insts - 1;
+        }
+        Global::gen_from_ir = true;
+        c[optimized] = gen_package();
+        Global::gen_from_ir = false;
+    }
+    reset_syms();
+
+    //*best of three, the runs are short enough for scheduling noise to show
+    int status[2] = {};
+    f64 ns[2] = {};
+    for (int run = 0; run < 3; run++) {
+        for (int optimized = 0; optimized < 2; optimized++) {
+            std::string name = std::string("sorin_bench_") + bench + "_" + program.name + (optimized ? "_on" : "_off");
+            f64 run_ns = bench_run_c(c[optimized], name.c_str(), "-O0", &status[optimized]);
+            ns[optimized] = run == 0 || run_ns < ns[optimized] ? run_ns : ns[optimized];
+        }
+    }
+    if (ns[0] < 0 || ns[1] < 0) {
+        printf("%s: skipped, the generated C could not be compiled with $CC -O0\n", bench);
+        return false;
+    }
+    if (status[0] != status[1]) {
+        fatal("%s: %s gives a different result when optimized", bench, program.name);
+    }
+
+    printf("%s: %-6s %4zu -> %4zu insts, %5zu -> %5zu bytes of C, run %.3f ms -> %.3f ms (%.2fx)\n", bench, program.name, num_insts[0], num_insts[1],
+           c[0].size(), c[1].size(), ns[0] / 1e6, ns[1] / 1e6, ns[0] / ns[1]);
+    return true;
+}
+
+Internal void bench_print_pass_ns(const char* bench, int first, int last) {
+    printf("%s: pass time", bench);
+    for (int pass = first; pass <= last; pass++) {
+        printf(" %s %.3f ms", ir_pass_name((IrPass)pass), Global::ir_pass_ns[pass] / 1e6);
+    }
+    printf("\n");
+}
+
+//*the IR as lowered against the IR through every pass
+Internal void bench_ir_opt() {
+    const u32 passes[2] = { 0, 0xFFFFFFFF };
+    Global::ir_pass_ns.clear();
+    for (BenchProgram& program : bench_opt_programs) {
+        if (!bench_compare_passes("ir_opt", program, passes)) {
+            return;
+        }
+    }
+    bench_print_pass_ns("ir_opt", 0, (int)IrPass::SIZE_OF_ENUM - 1);
+}
+
+//*array kernels, each returns a checksum as its exit status
+GlobalVariable BenchProgram bench_loop_programs[] = {
+    { "sum",
+      "var data: int[4096]\n"
+      "func sum(n: int): int { s := 0; for (i := 0; i < n; i++) { s += data[i]; } return s; }\n"
+      "func main(): int {\n"
+      "    for (i := 0; i < 4096; i++) { data[i] = i * 7 % 13; }\n"
+      "    s := 0;\n"
+      "    for (k := 0; k < 20000; k++) { s += sum(4096); }\n"
+      "    return s & 127;\n"
+      "}\n" },
+    { "saxpy",
+      "var x: int[4096]\n"
+      "var y: int[4096]\n"
+      "func saxpy(a: int, b: int, n: int) { for (i := 0; i < n; i++) { y[i] = (a * b * x[i] + y[i]) & 1023; } }\n"
+      "func main(): int {\n"
+      "    for (i := 0; i < 4096; i++) { x[i] = i % 17; y[i] = i % 5; }\n"
+      "    for (k := 0; k < 10000; k++) { saxpy(k & 7, 3, 4096); }\n"
+      "    return (y[1] + y[4095]) & 127;\n"
+      "}\n" },
+    { "matmul",
+      "var a: int[48][48]\n"
+      "var b: int[48][48]\n"
+      "var c: int[48][48]\n"
+      "func matmul() {\n"
+      "    for (i := 0; i < 48; i++) {\n"
+      "        for (j := 0; j < 48; j++) {\n"
+      "            s := 0;\n"
+      "            for (k := 0; k < 48; k++) { s += a[i][k] * b[k][j]; }\n"
+      "            c[i][j] = s;\n"
+      "        }\n"
+      "    }\n"
+      "}\n"
+      "func main(): int {\n"
+      "    for (i := 0; i < 48; i++) { for (j := 0; j < 48; j++) { a[i][j] = (i + j) % 7; b[i][j] = (i * j) % 5; } }\n"
+      "    for (k := 0; k < 300; k++) { matmul(); }\n"
+      "    s := 0;\n"
+      "    for (i := 0; i < 48; i++) { for (j := 0; j < 48; j++) { s += c[i][j] * (i + 1) + j; } }\n"
+      "    return s & 127;\n"
+      "}\n" },
+    { "filter",
+      "var taps: int[4]\n"
+      "var input: int[4096]\n"
+      "var output: int[4096]\n"
+      "func filter(n: int) {\n"
+      "    for (i := 0; i < n - 4; i++) {\n"
+      "        s := 0;\n"
+      "        for (t := 0; t < 4; t++) { s += taps[t] * input[i + t]; }\n"
+      "        output[i] = s >> 4;\n"
+      "    }\n"
+      "}\n"
+      "func main(): int {\n"
+      "    taps[0] = 1; taps[1] = 7; taps[2] = 7; taps[3] = 1;\n"
+      "    for (i := 0; i < 4096; i++) { input[i] = i * 13 % 256; }\n"
+      "    for (k := 0; k < 5000; k++) { filter(4096); }\n"
+      "    return (output[5] + output[4000]) & 127;\n"
+      "}\n" },
+};
+
+//*the scalar passes alone against the scalar passes with the loop passes
+Internal void bench_loop_opt() {
+    const u32 loop_passes = 1u << (int)IrPass::LICM | 1u << (int)IrPass::STRENGTH_REDUCE | 1u << (int)IrPass::UNROLL;
+    const u32 vectorize = 1u << (int)IrPass::VECTORIZE;
+    const u32 passes[2] = { 0xFFFFFFFF & ~loop_passes & ~vectorize, 0xFFFFFFFF & ~vectorize };
+    Global::ir_pass_ns.clear();
+    for (BenchProgram& program : bench_loop_programs) {
+        if (!bench_compare_passes("loop_opt", program, passes)) {
+            return;
+        }
+    }
+    bench_print_pass_ns("loop_opt", (int)IrPass::LICM, (int)IrPass::UNROLL);
+}
+
+//*kernels the vectorizer takes, over global arrays and over pointers that need the check for overlap
+GlobalVariable BenchProgram bench_vector_programs[] = {
+    { "imap",
+      "var a: int[4096]\n"
+      "var b: int[4096]\n"
+      "var c: int[4096]\n"
+      "func imap(d: int, n: int) { for (i := 0; i < n; i++) { a[i] = b[i] * c[i] + d; } }\n"
+      "func main(): int {\n"
+      "    for (i := 0; i < 4096; i++) { b[i] = i % 17; c[i] = i % 5; }\n"
+      "    for (k := 0; k < 10000; k++) { imap(k & 7, 4093); }\n"
+      "    return (a[1] + a[4092]) & 127;\n"
+      "}\n" },
+    { "fmap",
+      "var a: float[4096]\n"
+      "var b: float[4096]\n"
+      "var c: float[4096]\n"
+      "func fmap(d: float, n: int) { for (i := 0; i < n; i++) { a[i] = b[i] * c[i] + d; } }\n"
+      "func main(): int {\n"
+      "    for (i := 0; i < 4096; i++) { b[i] = i % 17; c[i] = i % 5; }\n"
+      "    for (k := 0; k < 10000; k++) { fmap(k & 7, 4093); }\n"
+      "    return (a[1] < a[4092]) + (a[7] > 11.0) * 2;\n"
+      "}\n" },
+    { "sum",
+      "var data: int[4096]\n"
+      "func sum(n: int): int { s := 0; for (i := 0; i < n; i++) { s += data[i] ^ 5; } return s; }\n"
+      "func main(): int {\n"
+      "    for (i := 0; i < 4096; i++) { data[i] = i * 7 % 13; }\n"
+      "    s := 0;\n"
+      "    for (k := 0; k < 20000; k++) { s += sum(4096); }\n"
+      "    return s & 127;\n"
+      "}\n" },
+    { "ptrs",
+      "var x: int[4100]\n"
+      "var y: int[4100]\n"
+      "func add(p: int*, q: int*, n: int) { for (i := 0; i < n; i++) { p[i] = p[i] + (q[i] >> 1); } }\n"
+      "func main(): int {\n"
+      "    for (i := 0; i < 4100; i++) { x[i] = i % 17; y[i] = i % 5; }\n"
+      "    for (k := 0; k < 5000; k++) { add(&y[0], &x[0], 4096); add(&x[4], &x[0], 4096); }\n"
+      "    return (x[4099] + y[4095]) & 127;\n"
+      "}\n" },
+};
+
+//*the other passes alone against the other passes with the vectorizer
+Internal void bench_vectorize() {
+    const u32 vectorize = 1u << (int)IrPass::VECTORIZE;
+    const u32 passes[2] = { 0xFFFFFFFF & ~vectorize, 0xFFFFFFFF };
+    Global::ir_pass_ns.clear();
+    for (BenchProgram& program : bench_vector_programs) {
+        if (!bench_compare_passes("vectorize", program, passes)) {
+            return;
+        }
+    }
+    bench_print_pass_ns("vectorize", (int)IrPass::VECTORIZE, (int)IrPass::VECTORIZE);
+}
+
+GlobalVariable BenchProgram bench_vm_programs[] = {
+    { "fib",
+      "func fib(n: int): int { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }\n"
+      "func main(): int { return fib(30) & 127; }\n" },
+    { "loops",
+      "func mix(n: int): int {\n"
+      "    s := 0;\n"
+      "    for (i := 0; i < n; i++) {\n"
+      "        for (j := 0; j < 64 + (i & 31); j++) { s += (i ^ j) * 3; s &= 0xFFFFFF; }\n"
+      "    }\n"
+      "    return s;\n"
+      "}\n"
+      "func main(): int { return mix(200000) & 127; }\n" },
+    { "sums",
+      "var data: int[4096]\n"
+      "var wide: llong[4096]\n"
+      "func sum(n: int): int { s := 0; for (i := 0; i < n; i++) { s += data[i]; } return s; }\n"
+      "func wide_sum(n: int): llong { var s: llong = 0\n for (i := 0; i < n; i++) { s += wide[i] - data[i]; } return s; }\n"
+      "func main(): int {\n"
+      "    for (i := 0; i < 4096; i++) { data[i] = i * 7 % 13; wide[i] = i * 3; }\n"
+      "    var s: llong = 0\n"
+      "    for (k := 0; k < 2000; k++) { s += sum(4096) + wide_sum(4096); }\n"
+      "    return s & 127;\n"
+      "}\n" },
+};
+
+//*best of three runs of main, false when the program failed
+Internal bool bench_vm_time(VmProgram* program, f64* ns, int* status) {
+    VmFunc* main_func = vm_find_func(program, "main");
+    for (int run = 0; run < 3; run++) {
+        u64 result = 0;
+        BenchTimer timer;
+        if (!vm_call(program, main_func, nullptr, &result, false)) {
+            return false;
+        }
+        f64 run_ns = timer.elapsed_ns();
+        *ns = run == 0 || run_ns < *ns ? run_ns : *ns;
+        *status = (int)result;
+    }
+    return true;
+}
+
+//*the VM without superinstructions and with them, each run with one switch over the opcodes and with threaded
+//*dispatch. the instructions run are counted in a separate run so that counting is not timed
+Internal void bench_vm_dispatch() {
+    for (BenchProgram& program : bench_vm_programs) {
+        reset_syms();
+        std::vector<Decl*> decls = parse_file("bench", program.src);
+        if (!Global::diagnostics.empty()) {
+            fatal("vm_dispatch: failed to parse %s", program.name);
+        }
+        resolve_package(decls);
+
+        int expected = -1;
+        for (int fused = 0; fused < 2; fused++) {
+            Global::vm_superinstructions = fused != 0;
+            VmProgram vm = {};
+            vm_compile_package(&vm);
+            u64 result = 0;
+            if (!vm_call(&vm, vm_find_func(&vm, "main"), nullptr, &result, true)) {
+                fatal("vm_dispatch: %s failed: %s", program.name, vm.error.c_str());
+            }
+            size_t code_size = 0;
+            for (VmFunc& it : vm.funcs) {
+                code_size += it.code.size();
+            }
+
+            f64 ns[2] = {};
+            for (int threaded = 0; threaded < 2; threaded++) {
+                Global::vm_switch_dispatch = threaded == 0;
+                int status = 0;
+                if (!bench_vm_time(&vm, &ns[threaded], &status)) {
+                    fatal("vm_dispatch: %s failed: %s", program.name, vm.error.c_str());
+                }
+                if (status != (int)result || (expected >= 0 && status != expected)) {
+                    fatal("vm_dispatch: %s gives a different result", program.name);
+                }
+                expected = status;
+            }
+            printf("vm_dispatch: %-5s %-8s %4zu insts of code, %6.2fM run, switch %7.2f ms %.2f ns/inst, threaded %7.2f ms %.2f ns/inst (%.2fx)\n",
+                   program.name, fused ? "fused" : "unfused", code_size, vm.steps / 1e6, ns[0] / 1e6, ns[0] / vm.steps, ns[1] / 1e6,
+                   ns[1] / vm.steps, ns[0] / ns[1]);
+            vm_free(&vm);
+        }
+        Global::vm_superinstructions = true;
+        Global::vm_switch_dispatch = false;
+        reset_syms();
+    }
+}
+
+//*the time to compile a package and to run its main, in the VM and as machine code from the JIT
+Internal void bench_jit() {
+    if (!jit_is_supported()) {
+        printf("jit: skipped, the host is not x86-64\n");
+        return;
+    }
+    for (BenchProgram& program : bench_vm_programs) {
+        reset_syms();
+        std::vector<Decl*> decls = parse_file("bench", program.src);
+        if (!Global::diagnostics.empty()) {
+            fatal("jit: failed to parse %s", program.name);
+        }
+        resolve_package(decls);
+
+        BenchTimer vm_timer;
+        VmProgram vm = {};
+        vm_compile_package(&vm);
+        f64 vm_compile_ns = vm_timer.elapsed_ns();
+        f64 vm_ns = 0;
+        int vm_status = 0;
+        if (!bench_vm_time(&vm, &vm_ns, &vm_status)) {
+            fatal("jit: %s failed in the VM: %s", program.name, vm.error.c_str());
+        }
+        vm_free(&vm);
+
+        BenchTimer jit_timer;
+        JitProgram jit = {};
+        jit_compile_package(&jit);
+        f64 jit_compile_ns = jit_timer.elapsed_ns();
+        u64 (*main_func)() = (u64 (*)())(uintptr_t)jit_find_func(&jit, "main");
+        f64 jit_ns = 0;
+        for (int run = 0; run < 3; run++) {
+            BenchTimer timer;
+            int status = (int)main_func();
+            f64 run_ns = timer.elapsed_ns();
+            jit_ns = run == 0 || run_ns < jit_ns ? run_ns : jit_ns;
+            if (status != vm_status) {
+                fatal("jit: %s gives a different result than the VM", program.name);
+            }
+        }
+        printf("jit: %-5s compile vm %6.3f ms jit %6.3f ms (%zu bytes of code), run vm %8.2f ms jit %8.2f ms (%.2fx)\n",
+               program.name, vm_compile_ns / 1e6, jit_compile_ns / 1e6, jit.code_bytes, vm_ns / 1e6, jit_ns / 1e6, vm_ns / jit_ns);
+        jit_free(&jit);
+        reset_syms();
+    }
+}
+
+//*the size of the RV64 code of each program and the instructions its main runs in the simulator, next to the VM's
+Internal void bench_rv64() {
+    for (BenchProgram& program : bench_vm_programs) {
+        reset_syms();
+        std::vector<Decl*> decls = parse_file("bench", program.src);
+        if (!Global::diagnostics.empty()) {
+            fatal("rv64: failed to parse %s", program.name);
+        }
+        resolve_package(decls);
+
+        VmProgram vm = {};
+        vm_compile_package(&vm);
+        f64 vm_ns = 0;
+        int vm_status = 0;
+        if (!bench_vm_time(&vm, &vm_ns, &vm_status)) {
+            fatal("rv64: %s failed in the VM: %s", program.name, vm.error.c_str());
+        }
+        vm_free(&vm);
+
+        BenchTimer compile_timer;
+        RvProgram rv = {};
+        rv_compile_package(&rv);
+        f64 compile_ns = compile_timer.elapsed_ns();
+        u64 init_steps = rv.steps;
+        BenchTimer run_timer;
+        u64 result = 0;
+        if (!rv_call(&rv, "main", nullptr, &result)) {
+            fatal("rv64: %s failed in the simulator: %s", program.name, rv.error.c_str());
+        }
+        f64 run_ns = run_timer.elapsed_ns();
+        if ((int)result != vm_status) {
+            fatal("rv64: %s gives a different result than the VM", program.name);
+        }
+        u64 steps = rv.steps - init_steps;
+        printf("rv64: %-5s compile %6.3f ms, %6u bytes of code, %8.2fM insts simulated in %8.2f ms (%.2f ns/inst), vm %8.2f ms\n",
+               program.name, compile_ns / 1e6, rv.code_bytes, steps / 1e6, run_ns / 1e6, run_ns / steps, vm_ns / 1e6);
+        reset_syms();
+    }
+}
+
+//*the machine code of each program with every value in its stack slot and with allocated registers: the run time
+//*of main from the JIT, and the code size and the instructions main runs as RV64 code
+Internal void bench_regalloc() {
+    for (BenchProgram& program : bench_vm_programs) {
+        reset_syms();
+        std::vector<Decl*> decls = parse_file("bench", program.src);
+        if (!Global::diagnostics.empty()) {
+            fatal("regalloc: failed to parse %s", program.name);
+        }
+        resolve_package(decls);
+
+        f64 jit_ns[2] = {};
+        u32 rv_bytes[2] = {};
+        u64 rv_steps[2] = {};
+        int expected = 0;
+        for (int allocated = 0; allocated < 2; allocated++) {
+            Global::native_regalloc = allocated != 0;
+            RvProgram rv = {};
+            rv_compile_package(&rv);
+            u64 init_steps = rv.steps;
+            u64 result = 0;
+            if (!rv_call(&rv, "main", nullptr, &result)) {
+                fatal("regalloc: %s failed in the simulator: %s", program.name, rv.error.c_str());
+            }
+            if (allocated && (int)result != expected) {
+                fatal("regalloc: %s gives a different result with registers", program.name);
+            }
+            expected = (int)result;
+            rv_bytes[allocated] = rv.code_bytes;
+            rv_steps[allocated] = rv.steps - init_steps;
+            if (!jit_is_supported()) {
+                continue;
+            }
+            JitProgram jit = {};
+            jit_compile_package(&jit);
+            u64 (*main_func)() = (u64 (*)())(uintptr_t)jit_find_func(&jit, "main");
+            for (int run = 0; run < 3; run++) {
+                BenchTimer timer;
+                int status = (int)main_func();
+                f64 run_ns = timer.elapsed_ns();
+                jit_ns[allocated] = run == 0 || run_ns < jit_ns[allocated] ? run_ns : jit_ns[allocated];
+                if (status != expected) {
+                    fatal("regalloc: %s gives a different result from the JIT", program.name);
+                }
+            }
+            jit_free(&jit);
+        }
+        Global::native_regalloc = true;
+        printf("regalloc: %-5s jit %8.2f ms -> %8.2f ms (%.2fx), rv64 %6u -> %6u bytes of code, %8.2fM -> %8.2fM insts (%.2fx)\n",
+               program.name, jit_ns[0] / 1e6, jit_ns[1] / 1e6, jit_ns[1] > 0 ? jit_ns[0] / jit_ns[1] : 0.0, rv_bytes[0], rv_bytes[1],
+               rv_steps[0] / 1e6, rv_steps[1] / 1e6, (f64)rv_steps[0] / rv_steps[1]);
+        reset_syms();
+    }
+}
+
+//*the time gen_package takes with more threads generating the function bodies, the output has to stay the same
+Internal void bench_gen_parallel() {
+    const int num_funcs = 2000;
+    const int iterations = 3;
+    std::string src = bench_gen_arith(num_funcs, 16, 24);
+
+    reset_syms();
+    std::vector<Decl*> decls = parse_file("bench", src.c_str());
+    if (!Global::diagnostics.empty()) {
+        fatal("gen_parallel: failed to parse generated input");
+    }
+    resolve_package(decls);
+
+    u32 threads = Global::gen_threads;
+    std::string serial;
+    f64 serial_ns = 0;
+    for (u32 num_threads = 1; num_threads <= 8; num_threads *= 2) {
+        Global::gen_threads = num_threads;
+        f64 best_ns = 0;
+        for (int i = 0; i < iterations; i++) {
+            BenchTimer timer;
+            std::string c = gen_package();
+            f64 ns = timer.elapsed_ns();
+            best_ns = i == 0 || ns < best_ns ? ns : best_ns;
+            if (num_threads == 1) {
+                serial.swap(c);
+            }
+            else if (c != serial) {
+                fatal("gen_parallel: %u threads generate different C than one", num_threads);
+            }
+        }
+        serial_ns = num_threads == 1 ? best_ns : serial_ns;
+        printf("gen_parallel: %d funcs, %zu bytes of C, %u threads, best of %d: %.3f ms (%.2fx), %u cores\n", num_funcs,
+               serial.size(), num_threads, iterations, best_ns / 1e6, serial_ns / best_ns, std::thread::hardware_concurrency());
+    }
+    Global::gen_threads = threads;
+    reset_syms();
+}
+
+//*gen_package with the body cache: every body generated and stored, every body loaded, and a rebuild after one body
+//*changed, next to generating all of them without the cache. parsing and resolving are not timed
+Internal f64 bench_gen_cached(const std::string& src, std::string* c) {
+    reset_syms();
+    std::vector<Decl*> decls = parse_file("bench", src.c_str());
+    if (!Global::diagnostics.empty()) {
+        fatal("gen_cache: failed to parse generated input");
+    }
+    resolve_package(decls);
+    Global::gen_cache_hits = 0;
+    Global::gen_cache_misses = 0;
+    BenchTimer timer;
+    *c = gen_package();
+    return timer.elapsed_ns();
+}
+
+Internal void bench_gen_cache() {
+    const int num_funcs = 2000;
+    std::string src = bench_gen_arith(num_funcs, 16, 24);
+    std::string edited = src;
+    size_t edit = edited.find("return x;", edited.find("func f1000("));
+    edited.replace(edit, strlen("return x;"), "return x + 1;");
+
+    std::string uncached;
+    std::string c;
+    f64 uncached_ns = bench_gen_cached(src, &uncached);
+    Global::gen_cache_dir = AST_CACHE_DIR;
+    std::vector<u64> keys;
+    for (Sym* it : Global::syms) {
+        if (it->kind == SymKind::FUNC) {
+            keys.push_back(gen_func_hash(it));
+            remove(gen_cache_path(keys.back()).c_str());
+        }
+    }
+    f64 cold_ns = bench_gen_cached(src, &c);
+    u32 cold_misses = Global::gen_cache_misses;
+    f64 warm_ns = bench_gen_cached(src, &c);
+    u32 warm_hits = Global::gen_cache_hits;
+    f64 edit_ns = bench_gen_cached(edited, &c);
+    u32 edit_misses = Global::gen_cache_misses;
+    for (Sym* it : Global::syms) {
+        if (it->kind == SymKind::FUNC) {
+            keys.push_back(gen_func_hash(it));
+        }
+    }
+    for (u64 it : keys) {
+        remove(gen_cache_path(it).c_str());
+    }
+    Global::gen_cache_dir = nullptr;
+    reset_syms();
+
+    printf("gen_cache: %d funcs, %zu bytes of C, uncached %.3f ms, cold %.3f ms (%u generated), warm %.3f ms (%u loaded), "
+           "one body edited %.3f ms (%u generated)\n",
+           num_funcs, uncached.size(), uncached_ns / 1e6, cold_ns / 1e6, cold_misses, warm_ns / 1e6, warm_hits, edit_ns / 1e6, edit_misses);
+}
+
+//*host build time of the C of a large package as one translation unit and as several built by make -jN, the build
+//*includes the link
+Internal void bench_gen_units() {
+    const int num_funcs = 500;
+    std::string src = bench_gen_arith(num_funcs, 16, 24) + "func main(): int { return f0(1, 2.5, 3) < 0; }\n";
+    reset_syms();
+    std::vector<Decl*> decls = parse_file("bench", src.c_str());
+    if (!Global::diagnostics.empty()) {
+        fatal("gen_units: failed to parse generated input");
+    }
+    resolve_package(decls);
+
+    const char* cc = getenv("CC");
+    const char* name = "sorin_bench_units";
+    std::string c = gen_package();
+    std::string c_path = std::string(name) + ".c";
+    FILE* file = fopen(c_path.c_str(), "wb");
+    if (!file) {
+        fatal("gen_units: cannot write %s", c_path.c_str());
+    }
+    fwrite(c.data(), 1, c.size(), file);
+    fclose(file);
+    std::string compile = std::string(cc ? cc : "cc") + " -O1 -o " + name + " " + c_path;
+    BenchTimer single_timer;
+    bool built = system(compile.c_str()) == 0;
+    f64 single_ns = single_timer.elapsed_ns();
+    remove(c_path.c_str());
+    remove(name);
+    if (!built) {
+        printf("gen_units: skipped, the generated C could not be compiled with $CC -O1\n");
+        reset_syms();
+        return;
+    }
+    printf("gen_units: %d funcs, %zu bytes of C, 1 unit: %.1f ms, %u cores\n", num_funcs, c.size(), single_ns / 1e6,
+           std::thread::hardware_concurrency());
+
+    for (size_t num_units = 2; num_units <= 8; num_units *= 2) {
+        GenUnits units;
+        gen_package_units(name, num_units, &units);
+        std::vector<std::string> paths = { std::string(name) + ".h", std::string(name) + ".mk" };
+        for (size_t i = 0; i < units.units.size(); i++) {
+            paths.push_back(std::string(name) + "_" + std::to_string(i) + ".c");
+        }
+        size_t largest = 0;
+        for (size_t i = 0; i < paths.size(); i++) {
+            const std::string& text = i == 0 ? units.header : i == 1 ? units.makefile : units.units[i - 2];
+            largest = i >= 2 && text.size() > largest ? text.size() : largest;
+            file = fopen(paths[i].c_str(), "wb");
+            if (!file) {
+                fatal("gen_units: cannot write %s", paths[i].c_str());
+            }
+            fwrite(text.data(), 1, text.size(), file);
+            fclose(file);
+        }
+        std::string make = "make -s -j" + std::to_string(units.units.size()) + " -f " + name + ".mk CFLAGS=-O1";
+        BenchTimer timer;
+        built = system(make.c_str()) == 0;
+        f64 ns = timer.elapsed_ns();
+        for (size_t i = 0; i < units.units.size(); i++) {
+            remove((std::string(name) + "_" + std::to_string(i) + ".o").c_str());
+        }
+        for (std::string& it : paths) {
+            remove(it.c_str());
+        }
+        remove(name);
+        if (!built) {
+            printf("gen_units: %zu units skipped, make failed\n", units.units.size());
+            continue;
+        }
+        printf("gen_units: %zu units of at most %zu bytes, make -j%zu: %.1f ms (%.2fx)\n", units.units.size(), largest,
+               units.units.size(), ns / 1e6, single_ns / ns);
+    }
+    reset_syms();
+}
+
+Internal bool bench_write_file(const std::string& path, const std::string& text) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool written = fwrite(text.data(), 1, text.size(), file) == text.size();
+    return fclose(file) == 0 && written;
+}
+
+//*a C program calling a small library func in a hot loop, with the library's C compiled as a unit of its own and with
+//*the single header included static into the program, where the host compiler can inline it
+Internal void bench_gen_header() {
+    const char* lib_src =
+        "func mix(h: uint, x: uint): uint { return (h ^ x) * 16777619; }\n"
+        "func hash_step(h: uint, x: uint): uint { return mix(h, x) + (x >> 3); }\n";
+    const char* driver =
+        "unsigned hash_step(unsigned h, unsigned x);\n"
+        "int main(void) { unsigned s = 0; for (unsigned i = 0; i < 300000000u; i++) { s += hash_step(i, 2166136261u); } return s & 127; }\n";
+    const char* static_driver =
+        "#define HASH_STATIC\n#define HASH_IMPLEMENTATION\n#include \"sorin_bench_hash.h\"\n"
+        "int main(void) { unsigned s = 0; for (unsigned i = 0; i < 300000000u; i++) { s += hash_step(i, 2166136261u); } return s & 127; }\n";
+    reset_syms();
+    std::vector<Decl*> decls = parse_file("bench", lib_src);
+    if (!Global::diagnostics.empty()) {
+        fatal("gen_header: failed to parse the library");
+    }
+    resolve_package(decls);
+    std::string lib = gen_package();
+    std::string header = gen_package_single_header("hash");
+    reset_syms();
+
+    const char* cc = getenv("CC");
+    std::string compiler = std::string(cc ? cc : "cc") + " -O2 -o ";
+#ifdef _WIN32
+    std::string exe_path = "sorin_bench_hash.exe";
+#else
+    std::string exe_path = "./sorin_bench_hash";
+#endif
+    const char* builds[] = { "separate unit", "single header" };
+    f64 ns[2] = {};
+    int status[2] = {};
+    for (int i = 0; i < 2; i++) {
+        bool written = i == 0 ? bench_write_file("sorin_bench_hash_lib.c", lib) && bench_write_file("sorin_bench_hash.c", driver)
+                              : bench_write_file("sorin_bench_hash.h", header) && bench_write_file("sorin_bench_hash.c", static_driver);
+        std::string compile = compiler + exe_path + " sorin_bench_hash.c" + (i == 0 ? " sorin_bench_hash_lib.c" : "");
+        bool built = written && system(compile.c_str()) == 0;
+        remove("sorin_bench_hash_lib.c");
+        remove("sorin_bench_hash.h");
+        remove("sorin_bench_hash.c");
+        if (!built) {
+            printf("gen_header: skipped, the C could not be compiled with $CC -O2\n");
+            return;
+        }
+        for (int run = 0; run < 3; run++) {
+            BenchTimer timer;
+            status[i] = system(exe_path.c_str());
+            f64 run_ns = timer.elapsed_ns();
+            ns[i] = run == 0 || run_ns < ns[i] ? run_ns : ns[i];
+        }
+        remove(exe_path.c_str());
+    }
+    if (status[0] != status[1]) {
+        fatal("gen_header: the single header build gives a different result");
+    }
+    printf("gen_header: 300M calls, %s %.1f ms, %s %.1f ms (%.2fx)\n", builds[0], ns[0] / 1e6, builds[1], ns[1] / 1e6, ns[0] / ns[1]);
+}
+
+//*the time to build a static executable of each program in process, next to generating C and building it with
+//*$CC -O0, and the run time of both executables
+Internal void bench_elf() {
+#if defined(__linux__) && defined(__x86_64__)
+    for (BenchProgram& program : bench_vm_programs) {
+        reset_syms();
+        std::vector<Decl*> decls = parse_file("bench", program.src);
+        if (!Global::diagnostics.empty()) {
+            fatal("elf: failed to parse %s", program.name);
+        }
+        resolve_package(decls);
+
+        VmProgram vm = {};
+        vm_compile_package(&vm);
+        f64 vm_ns = 0;
+        int vm_status = 0;
+        if (!bench_vm_time(&vm, &vm_ns, &vm_status)) {
+            fatal("elf: %s failed in the VM: %s", program.name, vm.error.c_str());
+        }
+        vm_free(&vm);
+
+        BenchTimer build_timer;
+        ElfObject object = {};
+        elf_compile_package(&object);
+        std::vector<u8> image;
+        elf_write_executable(&object, &image);
+        const char* exe_path = "./sorin_bench_elf";
+        FILE* file = fopen(exe_path, "wb");
+        if (!file) {
+            fatal("elf: cannot write %s", exe_path);
+        }
+        fwrite(image.data(), 1, image.size(), file);
+        fclose(file);
+        chmod(exe_path, 0755);
+        f64 build_ns = build_timer.elapsed_ns();
+        BenchTimer run_timer;
+        int status = system(exe_path);
+        f64 run_ns = run_timer.elapsed_ns();
+        remove(exe_path);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != (vm_status & 0xFF)) {
+            fatal("elf: %s gives a different result than the VM", program.name);
+        }
+
+        BenchTimer c_timer;
+        std::string c = gen_package();
+        int c_status = 0;
+        f64 c_run_ns = bench_run_c(c, "sorin_bench_elf_c", "-O0", &c_status);
+        f64 c_build_ns = c_timer.elapsed_ns() - c_run_ns;
+        if (c_run_ns < 0) {
+            printf("elf: %-5s build %6.3f ms, %6zu bytes, run %8.2f ms, C skipped, the generated C could not be compiled with $CC -O0\n",
+                   program.name, build_ns / 1e6, image.size(), run_ns / 1e6);
+        }
+        else {
+            printf("elf: %-5s build %6.3f ms, %6zu bytes, run %8.2f ms; via C and $CC -O0 build %8.2f ms (%.0fx), run %8.2f ms\n",
+                   program.name, build_ns / 1e6, image.size(), run_ns / 1e6, c_build_ns / 1e6, c_build_ns / build_ns, c_run_ns / 1e6);
+        }
+        reset_syms();
+    }
+#else
+    printf("elf: skipped, the executables only run on x86-64 linux\n");
+#endif
+}
+
+GlobalVariable Bench benches[] = {
+    { "parse_expr", bench_parse_expr },
+    { "parse_lazy", bench_parse_lazy },
+    { "ast_cache", bench_ast_cache },
+    { "visit", bench_visit },
+    { "resolve_locals", bench_resolve_locals },
+    { "resolve_arith", bench_resolve_arith },
+    { "resolve_types", bench_resolve_types },
+    { "resolve_typespecs", bench_resolve_typespecs },
+    { "switch_dispatch", bench_switch_dispatch },
+    { "ir_lower", bench_ir_lower },
+    { "gen_parallel", bench_gen_parallel },
+    { "gen_cache", bench_gen_cache },
+    { "gen_units", bench_gen_units },
+    { "gen_header", bench_gen_header },
+    { "ir_opt", bench_ir_opt },
+    { "loop_opt", bench_loop_opt },
+    { "vectorize", bench_vectorize },
+    { "vm_dispatch", bench_vm_dispatch },
+    { "jit", bench_jit },
+    { "rv64", bench_rv64 },
+    { "regalloc", bench_regalloc },
+    { "elf", bench_elf },
+};
+
+void run_benchmarks(int argc, char** argv) {
+    for (Bench* it = benches; it != benches + sizeof(benches) / sizeof(*benches); it++) {
+        bool selected = argc == 0;
+        for (int i = 0; i < argc; i++) {
+            if (strcmp(argv[i], it->name) == 0) {
+                selected = true;
+            }
+        }
+
+        if (selected) {
+            it->func();
+        }
+    }
+}
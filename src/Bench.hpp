@@ -0,0 +1,4 @@
+#pragma once
+
+//*benchmarks are not part of the test run, they are selected by name from the command line: main bench [name...]
+void run_benchmarks(int argc, char** argv);
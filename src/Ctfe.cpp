@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include "Ctfe.hpp"
+#include "Vm.hpp"
+#include "Globals.hpp"
+#include "Gen.hpp"
+#include "Parse.hpp"
+
+//*a compile-time call runs in a sandbox much smaller than a program's stacks
+Internal constexpr u64 CTFE_MAX_STEPS = 10000000;
+Internal constexpr u32 CTFE_MAX_MEMORY = MEGABYTE(1);
+Internal constexpr u32 CTFE_MAX_REGS = 1 << 16;
+Internal constexpr u32 CTFE_MAX_DEPTH = 1 << 12;
+
+struct CtfeMemo {
+    Sym* func;
+    std::vector<u64> args;
+    std::vector<u8> val;
+};
+
+//*keyed by a hash of the func and its argument registers
+GlobalVariable std::unordered_multimap<u64, CtfeMemo> ctfe_memos;
+//*calls that ran instead of hitting the memo
+GlobalVariable u32 ctfe_runs;
+
+bool ctfe_is_computable(Type* type) {
+    switch (type->kind) {
+        case TypeKind::ARRAY: {
+            return ctfe_is_computable(type->array.base);
+        }
+        case TypeKind::STRUCT: {
+            for (size_t i = 0; i < type->aggregate.num_fields; i++) {
+                if (!ctfe_is_computable(type->aggregate.fields[i].type)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        default: {
+            return is_arithmetic_type(type);
+        }
+    }
+}
+
+//*bytes are in the host's order, like the VM's own loads and stores
+ResolvedExpr ctfe_scalar(Type* type, const u8* bytes) {
+    ResolvedExpr val = {};
+    val.type = type;
+    val.is_const = true;
+    if (type->kind == TypeKind::FLOAT) {
+        f32 f;
+        memcpy(&f, bytes, sizeof(f));
+        val.float_val = f;
+    }
+    else if (type->kind == TypeKind::DOUBLE) {
+        memcpy(&val.float_val, bytes, sizeof(val.float_val));
+    }
+    else {
+        u64 bits = 0;
+        memcpy(&bits, bytes, type->size);
+        u32 shift = 64 - (u32)type->size * 8;
+        val.int_val = shift && is_signed_type(type) ? (i64)(bits << shift) >> shift : (i64)bits;
+    }
+    return val;
+}
+
+//*the register the VM keeps a constant in, see Vm.hpp
+Internal u64 ctfe_register(ResolvedExpr val) {
+    u64 bits;
+    if (is_floating_type(val.type)) {
+        f64 f = val.type->kind == TypeKind::FLOAT ? (f32)val.float_val : val.float_val;
+        memcpy(&bits, &f, sizeof(bits));
+        return bits;
+    }
+
+    memcpy(&bits, &val.int_val, sizeof(bits));
+    return (u64)ctfe_scalar(val.type, (const u8*)&bits).int_val;
+}
+
+Internal void ctfe_store(Type* type, u64 reg, u8* bytes) {
+    if (type->kind == TypeKind::FLOAT) {
+        f64 d;
+        memcpy(&d, &reg, sizeof(d));
+        f32 f = (f32)d;
+        memcpy(bytes, &f, sizeof(f));
+    }
+    else {
+        memcpy(bytes, &reg, type->size);
+    }
+}
+
+Internal u64 ctfe_hash(Sym* func, const std::vector<u64>& args) {
+    u64 hash = (0xcbf29ce484222325ull ^ (u64)(uintptr_t)func) * 0x100000001b3ull;
+    for (u64 it : args) {
+        hash = (hash ^ it) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+//*compiles every func the call can reach into a program of its own and runs it. false with error set when the run fails
+Internal bool ctfe_run(Sym* func, const std::vector<u64>& args, u64 max_steps, std::vector<u8>* val, std::string* error) {
+    std::vector<Sym*> syms(1, func);
+    std::vector<IrFunc*> funcs;
+    for (size_t i = 0; i < syms.size(); i++) {
+        resolve_func_for_eval(syms[i]);
+        IrFunc* ir = vm_lower_func(syms[i]);
+        for (u32 v = 1; v < ir->num_insts; v++) {
+            IrInst* inst = ir->insts + v;
+            if (inst->op != IrOp::GLOBAL) {
+                continue;
+            }
+            //*a global var could change between runs and would make the memo unsound
+            if (inst->sym->kind == SymKind::VAR) {
+                fatal("Cannot call %s at compile time, %s uses the global var %s", func->name, syms[i]->name, inst->sym->name);
+            }
+            if (std::find(syms.begin(), syms.end(), inst->sym) == syms.end()) {
+                syms.push_back(inst->sym);
+            }
+        }
+        funcs.push_back(ir);
+    }
+
+    VmProgram program = {};
+    program.max_regs = CTFE_MAX_REGS;
+    program.max_memory = CTFE_MAX_MEMORY;
+    program.max_depth = CTFE_MAX_DEPTH;
+    program.max_steps = max_steps;
+    vm_compile_funcs(&program, funcs);
+    u64 result = 0;
+    bool ok = vm_call(&program, &program.funcs[0], args.data(), &result, true);
+    if (ok) {
+        Type* type = func->type->func.ret;
+        val->assign(type->size, 0);
+        if (type->kind == TypeKind::STRUCT || type->kind == TypeKind::ARRAY) {
+            memcpy(val->data(), (const void*)(uintptr_t)result, type->size);
+        }
+        else {
+            ctfe_store(type, result, val->data());
+        }
+    }
+    else {
+        *error = program.error;
+    }
+    vm_free(&program);
+    return ok;
+}
+
+void ctfe_call(Sym* func, const std::vector<ResolvedExpr>& args, std::vector<u8>* val) {
+    //*checking the body resolves the globals it needs, which may run this same call and memoize it
+    resolve_func_for_eval(func);
+    std::vector<u64> regs;
+    for (const ResolvedExpr& it : args) {
+        regs.push_back(ctfe_register(it));
+    }
+
+    u64 key = ctfe_hash(func, regs);
+    auto range = ctfe_memos.equal_range(key);
+    for (auto it = range.first; it != range.second; it++) {
+        if (it->second.func == func && it->second.args == regs) {
+            *val = it->second.val;
+            return;
+        }
+    }
+
+    std::string error;
+    if (!ctfe_run(func, regs, CTFE_MAX_STEPS, val, &error)) {
+        fatal("Compile-time call of %s failed: %s", func->name, error.c_str());
+    }
+    ctfe_runs++;
+    ctfe_memos.emplace(key, CtfeMemo{ func, regs, *val });
+}
+
+void ctfe_reset() {
+    ctfe_memos.clear();
+    ctfe_runs = 0;
+}
+
+Internal Sym* ctfe_test_sym(const char* name) {
+    Sym* sym = sym_get(Global::string_table.add(name));
+    assert(sym && sym->state == SymState::RESOLVED);
+    return sym;
+}
+
+void ctfe_test() {
+    //*big is computed from table_size before table_size is declared, and scaled's body is checked ahead of the others
+    const char* src =
+        "struct Table { squares: int[16]; total: int; }\n"
+        "func scaled(n: int): int { return n * table_size; }\n"
+        "const big = scaled(2)\n"
+        "func next_pow2(n: int): int { p := 1; while (p < n) { p *= 2; } return p; }\n"
+        "const table_size = next_pow2(1000)\n"
+        "const mask = next_pow2(1000) - 1\n"
+        "var buckets: int[next_pow2(20) / 4]\n"
+        "func make_table(n: int): Table { var t: Table\n t.total = 0;\n"
+        "    for (i := 0; i < 16; i++) { t.squares[i] = i * n; t.total += t.squares[i]; } return t; }\n"
+        "var table: Table = make_table(3)\n"
+        "func half(x: double): float { return x / 2; }\n"
+        "const ratio = half(3)\n"
+        "func local_size(): int { var xs: int[next_pow2(table_size + 1) / 256]\n return sizeof(xs); }\n"
+        "func spin(n: int): int { s := 0; while (n > 0) { s++; } return s; }\n"
+        "func divide(a: int, b: int): int { return a / b; }\n";
+
+    assert(load_package_src("ctfe_test.sorin", src));
+
+    assert(ctfe_test_sym("table_size")->int_val == 1024);
+    assert(ctfe_test_sym("mask")->int_val == 1023);
+    assert(ctfe_test_sym("big")->int_val == 2048);
+    assert(ctfe_test_sym("ratio")->type == Global::type_float && ctfe_test_sym("ratio")->float_val == 1.5);
+    assert(ctfe_test_sym("buckets")->type->array.size == 8);
+
+    //*the table is computed once at build time and its value kept for the backends
+    Sym* table = ctfe_test_sym("table");
+    auto it = Global::const_call_vals.find(table->decl->var.expr->id);
+    assert(it != Global::const_call_vals.end() && it->second.size() == table->type->size);
+    i32 total;
+    memcpy(&total, it->second.data() + 16 * sizeof(i32), sizeof(total));
+    assert(total == 3 * 120);
+    std::string c = gen_package();
+    assert(c.find("{0, 3, 6, 9, 12, 15, 18, 21, 24, 27, 30, 33, 36, 39, 42, 45}, 360}") != std::string::npos);
+    assert(c.find("make_table(3)") == std::string::npos);
+
+    //*next_pow2(1000) ran once for both table_size and mask
+    assert(ctfe_runs == 6 && ctfe_memos.size() == 6);
+
+    //*runs that would hang or trap the compiler fail with a message instead
+    std::vector<u8> val;
+    std::string error;
+    assert(!ctfe_run(ctfe_test_sym("spin"), std::vector<u64>(1, 1), 1000, &val, &error));
+    assert(error == "step limit exceeded in spin");
+    std::vector<u64> args = { 1, 0 };
+    assert(!ctfe_run(ctfe_test_sym("divide"), args, CTFE_MAX_STEPS, &val, &error));
+    assert(error == "division by zero or overflow in divide");
+
+    VmProgram program = {};
+    vm_compile_package(&program);
+    u64 result = 0;
+    assert(vm_call(&program, vm_find_func(&program, "local_size"), nullptr, &result, false) && result == 8 * sizeof(i32));
+    memcpy(&total, vm_global_addr(&program, table) + 16 * sizeof(i32), sizeof(total));
+    assert(total == 360);
+    vm_free(&program);
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <vector>
+#include "Resolve.hpp"
+
+//*compile-time function execution. a constant expression runs its direct calls with constant arguments on the VM in
+//*checked mode, with limits on steps and memory. the funcs such a call reaches may not use global vars, so its value
+//*only depends on the arguments and is memoized per func and argument values
+
+//*whether a call's value can be computed at compile time: arithmetic values, and structs and arrays of them
+bool ctfe_is_computable(Type* type);
+//*runs func on constant args converted to its params and stores its value in the layout of its result type. fatal when
+//*the func cannot run at compile time or the run fails
+void ctfe_call(Sym* func, const std::vector<ResolvedExpr>& args, std::vector<u8>* val);
+//*the constant held by a scalar of type at bytes
+ResolvedExpr ctfe_scalar(Type* type, const u8* bytes);
+//*drops the memoized values, their funcs belong to the dropped symbols
+void ctfe_reset();
+
+void ctfe_test();
@@ -0,0 +1,770 @@
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include "Elf.hpp"
+#include "Jit.hpp"
+#include "Opt.hpp"
+#include "Globals.hpp"
+#include "Parse.hpp"
+#include "Resolve.hpp"
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <sys/wait.h>
+#endif
+
+//*header constants of the ELF64 format and the x86-64 psABI
+Internal constexpr u32 ELF_HEADER_BYTES = 64;
+Internal constexpr u32 ELF_PHDR_BYTES = 56;
+Internal constexpr u32 ELF_SHDR_BYTES = 64;
+Internal constexpr u32 ELF_SYM_BYTES = 24;
+Internal constexpr u32 ELF_RELA_BYTES = 24;
+Internal constexpr u32 ELF_MACHINE_X86_64 = 62;
+Internal constexpr u32 ELF_R_X86_64_64 = 1;
+Internal constexpr u32 ELF_R_X86_64_PC32 = 2;
+//*where a static executable is mapped, the usual base of non-PIE x86-64 executables
+Internal constexpr u64 ELF_EXE_BASE = 0x400000;
+Internal constexpr u64 ELF_PAGE_BYTES = 0x1000;
+
+Internal constexpr u32 ELF_SHT_PROGBITS = 1;
+Internal constexpr u32 ELF_SHT_SYMTAB = 2;
+Internal constexpr u32 ELF_SHT_STRTAB = 3;
+Internal constexpr u32 ELF_SHT_RELA = 4;
+Internal constexpr u32 ELF_SHT_NOBITS = 8;
+Internal constexpr u32 ELF_SHT_INIT_ARRAY = 14;
+Internal constexpr u32 ELF_SHF_WRITE = 0x1;
+Internal constexpr u32 ELF_SHF_ALLOC = 0x2;
+Internal constexpr u32 ELF_SHF_EXECINSTR = 0x4;
+Internal constexpr u32 ELF_SHF_INFO_LINK = 0x40;
+
+GlobalVariable const char* const elf_section_names[] = { ".text", ".data", ".rodata", ".bss", ".init_array" };
+
+//*a section of the file being written
+struct ElfOutSection {
+    std::string name;
+    u32 type;
+    u64 flags;
+    const std::vector<u8>* bytes; //*null for .bss and the null section
+    u64 size;
+    u64 align;
+    u32 link;
+    u32 info;
+    u64 entsize;
+    u64 offset; //*in the file
+};
+
+enum class ElfValueKind : u8 {
+    UNKNOWN, //*only known when the initializers run
+    BITS,
+    ADDR,
+};
+
+//*a value of the initializers at compile time, its bits or an address bits bytes into a section, or into a func's code
+struct ElfValue {
+    ElfValueKind kind;
+    u64 bits;
+    ElfSection section;
+    Sym* func;
+};
+
+GlobalVariable ElfObject* elf_out;
+GlobalVariable std::unordered_map<Sym*, u64> elf_var_offsets; //*in .data or .bss
+GlobalVariable std::unordered_map<const char*, u64> elf_string_offsets;
+GlobalVariable std::vector<std::pair<size_t, Sym*>> elf_func_relocs; //*relocs whose addend is still from their func's entry
+
+bool elf_is_supported() {
+#ifdef _WIN32
+    return false;
+#else
+    return true;
+#endif
+}
+
+Internal u64 elf_align_up(u64 val, u64 align) {
+    return align ? (val + align - 1) / align * align : val;
+}
+
+//*little endian fields
+Internal void elf_put(std::vector<u8>* out, u64 val, u32 bytes) {
+    for (u32 i = 0; i < bytes; i++) {
+        out->push_back((u8)(val >> (i * 8)));
+    }
+}
+
+Internal void elf_write_at(u8* at, u64 val, u32 bytes) {
+    for (u32 i = 0; i < bytes; i++) {
+        at[i] = (u8)(val >> (i * 8));
+    }
+}
+
+Internal u64 elf_read_at(const u8* at, u32 bytes) {
+    u64 val = 0;
+    for (u32 i = 0; i < bytes; i++) {
+        val |= (u64)at[i] << (i * 8);
+    }
+    return val;
+}
+
+Internal void elf_pad(std::vector<u8>* out, u64 align) {
+    out->resize(elf_align_up(out->size(), align), 0);
+}
+
+Internal u64 elf_string(const char* str) {
+    auto it = elf_string_offsets.find(str);
+    if (it != elf_string_offsets.end()) {
+        return it->second;
+    }
+    std::vector<u8>* rodata = &elf_out->bytes[(int)ElfSection::RODATA];
+    u64 offset = rodata->size();
+    rodata->insert(rodata->end(), str, str + strlen(str) + 1);
+    elf_string_offsets[str] = offset;
+    return offset;
+}
+
+//*the initializers
+
+//*the bits a slot of an integer type holds, extended from the low size bytes
+Internal u64 elf_extend(u64 bits, Type* type) {
+    if (type->kind == TypeKind::BOOL) {
+        return bits != 0;
+    }
+    if (type->size >= 8) {
+        return bits;
+    }
+    u32 shift = (u32)(64 - type->size * 8);
+    return is_signed_type(type) ? (u64)((i64)(bits << shift) >> shift) : bits << shift >> shift;
+}
+
+Internal bool elf_is_scalar_bits(Type* type) {
+    return type->kind == TypeKind::BOOL || is_integer_type(type) || type->kind == TypeKind::PTR;
+}
+
+//*whether size bytes at offset of .data are free of relocations, which a constant store or load would tear
+Internal bool elf_data_plain(u64 offset, u64 size) {
+    for (ElfReloc& it : elf_out->relocs) {
+        if (it.section == ElfSection::DATA && it.offset < offset + size && offset < it.offset + 8) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//*applies the initializers to .data while they only store constants. false at the first instruction that has to run,
+//*then the object runs all of them
+Internal bool elf_eval_init(IrFunc* init) {
+    std::vector<ElfValue> values(init->num_insts, ElfValue{});
+    std::vector<u8>* data = &elf_out->bytes[(int)ElfSection::DATA];
+    IrBlock* entry = init->blocks;
+    for (IrValue v = entry->first; v < entry->first + entry->num_insts; v++) {
+        IrInst* inst = init->insts + v;
+        Type* type = Global::types[inst->type];
+        ElfValue* out = &values[v];
+        ElfValue left = inst->args[0] ? values[inst->args[0]] : ElfValue{};
+        ElfValue right = inst->args[1] ? values[inst->args[1]] : ElfValue{};
+        switch (inst->op) {
+            case IrOp::NOP: {
+                break;
+            }
+            case IrOp::CONST_INT: {
+                *out = { ElfValueKind::BITS, (u64)inst->int_val, ElfSection::TEXT, nullptr };
+                break;
+            }
+            case IrOp::CONST_FLOAT: {
+                u64 bits = 0;
+                if (type->kind == TypeKind::FLOAT) {
+                    f32 val = (f32)inst->float_val;
+                    memcpy(&bits, &val, sizeof(val));
+                }
+                else {
+                    memcpy(&bits, &inst->float_val, sizeof(bits));
+                }
+                *out = { ElfValueKind::BITS, bits, ElfSection::TEXT, nullptr };
+                break;
+            }
+            case IrOp::GLOBAL: {
+                if (inst->sym->kind == SymKind::FUNC) {
+                    *out = { ElfValueKind::ADDR, 0, ElfSection::TEXT, inst->sym };
+                }
+                else {
+                    bool in_data = inst->sym->decl && inst->sym->decl->var.expr;
+                    *out = { ElfValueKind::ADDR, elf_var_offsets[inst->sym], in_data ? ElfSection::DATA : ElfSection::BSS, nullptr };
+                }
+                break;
+            }
+            case IrOp::STR: {
+                *out = { ElfValueKind::ADDR, elf_string(inst->str), ElfSection::RODATA, nullptr };
+                break;
+            }
+            case IrOp::FIELD_ADDR: {
+                if (left.kind != ElfValueKind::ADDR) {
+                    return false;
+                }
+                *out = left;
+                out->bits += (u64)inst->int_val;
+                break;
+            }
+            case IrOp::ELEM_ADDR: {
+                if (left.kind != ElfValueKind::ADDR || right.kind != ElfValueKind::BITS) {
+                    return false;
+                }
+                *out = left;
+                out->bits += right.bits * type->ptr.base->size;
+                break;
+            }
+            case IrOp::CONVERT: {
+                Type* from = Global::types[init->insts[inst->args[0]].type];
+                if (left.kind == ElfValueKind::ADDR && type->kind == TypeKind::PTR) {
+                    *out = left;
+                }
+                else if (left.kind == ElfValueKind::BITS && elf_is_scalar_bits(from) && elf_is_scalar_bits(type)) {
+                    *out = { ElfValueKind::BITS, elf_extend(left.bits, type), ElfSection::TEXT, nullptr };
+                }
+                else {
+                    return false;
+                }
+                break;
+            }
+            case IrOp::LOAD: {
+                //*an initializer reading a var initialized before it, or a var in .bss which stays zero
+                if (left.kind != ElfValueKind::ADDR || !type->size || type->size > 8) {
+                    return false;
+                }
+                u64 bits = 0;
+                if (left.section == ElfSection::DATA) {
+                    if (!elf_data_plain(left.bits, type->size)) {
+                        return false;
+                    }
+                    bits = elf_read_at(data->data() + left.bits, (u32)type->size);
+                }
+                else if (left.section != ElfSection::BSS) {
+                    return false;
+                }
+                *out = { ElfValueKind::BITS, elf_is_scalar_bits(type) ? elf_extend(bits, type) : bits, ElfSection::TEXT, nullptr };
+                break;
+            }
+            case IrOp::STORE: {
+                Type* stored = Global::types[init->insts[inst->args[1]].type];
+                if (left.kind != ElfValueKind::ADDR || left.section != ElfSection::DATA || !stored->size || stored->size > 8
+                    || !elf_data_plain(left.bits, stored->size)) {
+                    return false;
+                }
+                if (right.kind == ElfValueKind::BITS) {
+                    elf_write_at(data->data() + left.bits, right.bits, (u32)stored->size);
+                }
+                else if (right.kind == ElfValueKind::ADDR && stored->size == 8) {
+                    elf_write_at(data->data() + left.bits, 0, 8);
+                    if (right.func) {
+                        elf_func_relocs.push_back({ elf_out->relocs.size(), right.func });
+                    }
+                    elf_out->relocs.push_back({ ElfSection::DATA, left.bits, ElfRelocKind::ABS64, right.section, (i64)right.bits });
+                }
+                else {
+                    return false;
+                }
+                break;
+            }
+            case IrOp::ZERO: {
+                if (left.kind != ElfValueKind::ADDR || left.section != ElfSection::DATA || !elf_data_plain(left.bits, (u64)inst->int_val)) {
+                    return false;
+                }
+                memset(data->data() + left.bits, 0, (size_t)inst->int_val);
+                break;
+            }
+            case IrOp::RETURN: {
+                return true;
+            }
+            default: {
+                return false;
+            }
+        }
+    }
+    return false;
+}
+
+//*compiling
+
+void elf_compile_package(ElfObject* object) {
+    if (!elf_is_supported()) {
+        fatal("ELF output needs the System V convention, the JIT compiles for the windows convention on this host");
+    }
+    elf_out = object;
+    for (int i = 0; i < (int)ElfSection::SIZE_OF_ENUM; i++) {
+        object->bytes[i].clear();
+        object->align[i] = 1;
+    }
+    object->align[(int)ElfSection::TEXT] = 16;
+    object->align[(int)ElfSection::INIT_ARRAY] = 8;
+    object->bss_bytes = 0;
+    object->symbols.clear();
+    object->relocs.clear();
+    elf_var_offsets.clear();
+    elf_string_offsets.clear();
+    elf_func_relocs.clear();
+
+    //*vars with an initializer are in .data even when it stores zeros, so that a C reader finds them initialized
+    std::vector<u8>* data = &object->bytes[(int)ElfSection::DATA];
+    for (Sym* it : Global::syms) {
+        if (it->kind != SymKind::VAR) {
+            continue;
+        }
+        ElfSection section = it->decl && it->decl->var.expr ? ElfSection::DATA : ElfSection::BSS;
+        u32 align = it->type->align ? (u32)it->type->align : 1;
+        u32* section_align = &object->align[(int)section];
+        *section_align = align > *section_align ? align : *section_align;
+        u64 offset = elf_align_up(section == ElfSection::DATA ? data->size() : object->bss_bytes, align);
+        if (section == ElfSection::DATA) {
+            data->resize(offset + it->type->size, 0);
+        }
+        else {
+            object->bss_bytes = offset + it->type->size;
+        }
+        elf_var_offsets[it] = offset;
+        object->symbols.push_back({ it->name, section, offset, it->type->size, false, false });
+    }
+
+    Sym init_sym = {};
+    init_sym.name = Global::string_table.add("global_init");
+    init_sym.kind = SymKind::FUNC;
+    init_sym.type = type_func(nullptr, 0, Global::type_void);
+    u32 passes = Global::ir_passes;
+    Global::ir_passes &= ~(1u << (int)IrPass::VECTORIZE);
+    IrFunc* init = ir_optimize(ir_lower_global_init(&init_sym));
+    Global::ir_passes = passes;
+    if (elf_eval_init(init)) {
+        object->has_init = false;
+        init = nullptr;
+    }
+    else {
+        //*the bytes stay, the initializers run again from the start
+        object->has_init = true;
+    }
+
+    JitCode code = {};
+    jit_compile_code(&code, init);
+    object->bytes[(int)ElfSection::TEXT] = code.code;
+    for (size_t i = 0; i < code.func_offsets.size(); i++) {
+        u64 entry = code.func_offsets[i].second;
+        u64 end = i + 1 < code.func_offsets.size() ? code.func_offsets[i + 1].second : init ? code.init_entry : code.code.size();
+        object->symbols.push_back({ code.func_offsets[i].first->name, ElfSection::TEXT, entry, end - entry, true, false });
+    }
+    if (init) {
+        object->init_offset = code.init_entry;
+        object->symbols.push_back({ init_sym.name, ElfSection::TEXT, code.init_entry, code.code.size() - code.init_entry, true, true });
+        object->bytes[(int)ElfSection::INIT_ARRAY].assign(8, 0);
+        object->relocs.push_back({ ElfSection::INIT_ARRAY, 0, ElfRelocKind::ABS64, ElfSection::TEXT, (i64)code.init_entry });
+    }
+
+    //*a rel32 is relative to its end
+    for (JitReloc& it : code.relocs) {
+        if (it.str) {
+            object->relocs.push_back({ ElfSection::TEXT, it.pos, ElfRelocKind::PC32, ElfSection::RODATA, (i64)elf_string(it.str) - 4 });
+        }
+        else {
+            bool in_data = it.sym->decl && it.sym->decl->var.expr;
+            object->relocs.push_back(
+                { ElfSection::TEXT, it.pos, ElfRelocKind::PC32, in_data ? ElfSection::DATA : ElfSection::BSS, (i64)elf_var_offsets[it.sym] - 4 });
+        }
+    }
+    for (std::pair<size_t, Sym*>& it : elf_func_relocs) {
+        for (std::pair<Sym*, u32>& func : code.func_offsets) {
+            if (func.first == it.second) {
+                object->relocs[it.first].addend += func.second;
+            }
+        }
+    }
+}
+
+//*writing
+
+Internal u32 elf_add_name(std::vector<u8>* table, const std::string& name) {
+    u32 offset = (u32)table->size();
+    table->insert(table->end(), name.begin(), name.end());
+    table->push_back(0);
+    return offset;
+}
+
+Internal void elf_put_header(std::vector<u8>* out, u32 type, u64 entry, u64 phoff, u32 phnum, u64 shoff, u32 shnum, u32 shstrndx) {
+    const u8 ident[16] = { 0x7F, 'E', 'L', 'F', 2, 1, 1 };
+    out->insert(out->end(), ident, ident + sizeof(ident));
+    elf_put(out, type, 2);
+    elf_put(out, ELF_MACHINE_X86_64, 2);
+    elf_put(out, 1, 4);
+    elf_put(out, entry, 8);
+    elf_put(out, phoff, 8);
+    elf_put(out, shoff, 8);
+    elf_put(out, 0, 4);
+    elf_put(out, ELF_HEADER_BYTES, 2);
+    elf_put(out, phnum ? ELF_PHDR_BYTES : 0, 2);
+    elf_put(out, phnum, 2);
+    elf_put(out, shnum ? ELF_SHDR_BYTES : 0, 2);
+    elf_put(out, shnum, 2);
+    elf_put(out, shstrndx, 2);
+}
+
+void elf_write_object(const ElfObject* object, std::vector<u8>* out) {
+    std::vector<ElfOutSection> sections;
+    sections.push_back({});
+    u32 index[(int)ElfSection::SIZE_OF_ENUM] = {};
+    for (int i = 0; i < (int)ElfSection::SIZE_OF_ENUM; i++) {
+        ElfSection section = (ElfSection)i;
+        if (section == ElfSection::INIT_ARRAY && !object->has_init) {
+            continue;
+        }
+        ElfOutSection it = {};
+        it.name = elf_section_names[i];
+        it.type = section == ElfSection::BSS ? ELF_SHT_NOBITS : section == ElfSection::INIT_ARRAY ? ELF_SHT_INIT_ARRAY : ELF_SHT_PROGBITS;
+        it.flags = ELF_SHF_ALLOC;
+        it.flags |= section == ElfSection::TEXT ? ELF_SHF_EXECINSTR : section == ElfSection::RODATA ? 0 : ELF_SHF_WRITE;
+        it.bytes = section == ElfSection::BSS ? nullptr : &object->bytes[i];
+        it.size = section == ElfSection::BSS ? object->bss_bytes : object->bytes[i].size();
+        it.align = object->align[i];
+        it.entsize = section == ElfSection::INIT_ARRAY ? 8 : 0;
+        index[i] = (u32)sections.size();
+        sections.push_back(it);
+    }
+
+    //*the symbols: the null symbol, one per section that relocations refer to, the locals and then the globals
+    std::vector<u8> strtab(1, 0);
+    std::vector<u8> symtab(ELF_SYM_BYTES, 0);
+    u32 section_symbols[(int)ElfSection::SIZE_OF_ENUM] = {};
+    for (int i = 0; i < (int)ElfSection::SIZE_OF_ENUM; i++) {
+        if (!index[i]) {
+            continue;
+        }
+        section_symbols[i] = (u32)(symtab.size() / ELF_SYM_BYTES);
+        elf_put(&symtab, 0, 4);
+        elf_put(&symtab, 3, 1); //*STB_LOCAL, STT_SECTION
+        elf_put(&symtab, 0, 1);
+        elf_put(&symtab, index[i], 2);
+        elf_put(&symtab, 0, 8);
+        elf_put(&symtab, 0, 8);
+    }
+    u32 first_global = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1) {
+            first_global = (u32)(symtab.size() / ELF_SYM_BYTES);
+        }
+        for (const ElfSymbol& it : object->symbols) {
+            if (it.is_local != (pass == 0)) {
+                continue;
+            }
+            elf_put(&symtab, elf_add_name(&strtab, it.name), 4);
+            elf_put(&symtab, (it.is_local ? 0 : 1) << 4 | (it.is_func ? 2 : 1), 1); //*STB_GLOBAL, STT_FUNC or STT_OBJECT
+            elf_put(&symtab, 0, 1);
+            elf_put(&symtab, index[(int)it.section], 2);
+            elf_put(&symtab, it.offset, 8);
+            elf_put(&symtab, it.size, 8);
+        }
+    }
+
+    std::vector<std::vector<u8>> relas((int)ElfSection::SIZE_OF_ENUM);
+    for (const ElfReloc& it : object->relocs) {
+        std::vector<u8>* rela = &relas[(int)it.section];
+        elf_put(rela, it.offset, 8);
+        elf_put(rela, (u64)section_symbols[(int)it.target] << 32 | (it.kind == ElfRelocKind::PC32 ? ELF_R_X86_64_PC32 : ELF_R_X86_64_64), 8);
+        elf_put(rela, (u64)it.addend, 8);
+    }
+    u32 num_relas = 0;
+    for (int i = 0; i < (int)ElfSection::SIZE_OF_ENUM; i++) {
+        num_relas += relas[i].empty() ? 0 : 1;
+    }
+    u32 symtab_index = (u32)sections.size() + num_relas;
+    for (int i = 0; i < (int)ElfSection::SIZE_OF_ENUM; i++) {
+        if (relas[i].empty()) {
+            continue;
+        }
+        ElfOutSection it = {};
+        it.name = std::string(".rela") + elf_section_names[i];
+        it.type = ELF_SHT_RELA;
+        it.flags = ELF_SHF_INFO_LINK;
+        it.bytes = &relas[i];
+        it.size = relas[i].size();
+        it.align = 8;
+        it.link = symtab_index;
+        it.info = index[i];
+        it.entsize = ELF_RELA_BYTES;
+        sections.push_back(it);
+    }
+    sections.push_back({ ".symtab", ELF_SHT_SYMTAB, 0, &symtab, symtab.size(), 8, symtab_index + 1, first_global, ELF_SYM_BYTES, 0 });
+    sections.push_back({ ".strtab", ELF_SHT_STRTAB, 0, &strtab, strtab.size(), 1, 0, 0, 0, 0 });
+    //*an empty note that asks for a stack that is not executable
+    std::vector<u8> empty;
+    sections.push_back({ ".note.GNU-stack", ELF_SHT_PROGBITS, 0, &empty, 0, 1, 0, 0, 0, 0 });
+    std::vector<u8> shstrtab(1, 0);
+    std::vector<u32> names(sections.size() + 1, 0);
+    for (size_t i = 1; i < sections.size(); i++) {
+        names[i] = elf_add_name(&shstrtab, sections[i].name);
+    }
+    names[sections.size()] = elf_add_name(&shstrtab, ".shstrtab");
+    sections.push_back({ ".shstrtab", ELF_SHT_STRTAB, 0, &shstrtab, shstrtab.size(), 1, 0, 0, 0, 0 });
+
+    out->clear();
+    elf_put_header(out, 1, 0, 0, 0, 0, (u32)sections.size(), (u32)sections.size() - 1);
+    for (ElfOutSection& it : sections) {
+        if (!it.bytes) {
+            it.offset = out->size();
+            continue;
+        }
+        elf_pad(out, it.align);
+        it.offset = out->size();
+        out->insert(out->end(), it.bytes->begin(), it.bytes->end());
+    }
+    elf_pad(out, 8);
+    u64 shoff = out->size();
+    for (size_t i = 0; i < sections.size(); i++) {
+        ElfOutSection* it = &sections[i];
+        elf_put(out, names[i], 4);
+        elf_put(out, it->type, 4);
+        elf_put(out, it->flags, 8);
+        elf_put(out, 0, 8);
+        elf_put(out, it->offset, 8);
+        elf_put(out, it->size, 8);
+        elf_put(out, it->link, 4);
+        elf_put(out, it->info, 4);
+        elf_put(out, it->align, 8);
+        elf_put(out, it->entsize, 8);
+    }
+    elf_write_at(out->data() + 40, shoff, 8);
+}
+
+Internal void elf_put_phdr(std::vector<u8>* out, u32 type, u32 flags, u64 offset, u64 addr, u64 file_bytes, u64 mem_bytes, u64 align) {
+    elf_put(out, type, 4);
+    elf_put(out, flags, 4);
+    elf_put(out, offset, 8);
+    elf_put(out, addr, 8);
+    elf_put(out, addr, 8);
+    elf_put(out, file_bytes, 8);
+    elf_put(out, mem_bytes, 8);
+    elf_put(out, align, 8);
+}
+
+//*the entry of a static executable: align the stack, run the initializers and main, and exit with main's result
+Internal void elf_emit_start(std::vector<u8>* text, i64 init, i64 main, bool main_returns) {
+    const u8 prologue[] = { 0x31, 0xED, 0x48, 0x83, 0xE4, 0xF0 }; //*xor ebp, ebp; and rsp, -16
+    text->insert(text->end(), prologue, prologue + sizeof(prologue));
+    if (init >= 0) {
+        text->push_back(0xE8);
+        elf_put(text, (u64)(init - (i64)(text->size() + 4)), 4);
+    }
+    text->push_back(0xE8);
+    elf_put(text, (u64)(main - (i64)(text->size() + 4)), 4);
+    //*mov edi, eax or xor edi, edi, then mov eax, 60 and syscall
+    const u8 status[] = { 0x89, 0xC7 };
+    const u8 zero[] = { 0x31, 0xFF };
+    text->insert(text->end(), main_returns ? status : zero, (main_returns ? status : zero) + 2);
+    const u8 exit[] = { 0xB8, 60, 0, 0, 0, 0x0F, 0x05 };
+    text->insert(text->end(), exit, exit + sizeof(exit));
+}
+
+void elf_write_executable(const ElfObject* object, std::vector<u8>* out) {
+    const ElfSymbol* main = nullptr;
+    for (const ElfSymbol& it : object->symbols) {
+        if (it.is_func && strcmp(it.name, "main") == 0) {
+            main = &it;
+        }
+    }
+    if (!main) {
+        fatal("a static executable needs a func main()");
+    }
+    Sym* main_sym = sym_get(Global::string_table.add("main"));
+    bool main_returns = !main_sym || main_sym->type->func.ret->kind != TypeKind::VOID;
+
+    //*one segment maps the headers, .text and .rodata, the next .data and .bss on a page of their own
+    u32 num_phdrs = 3;
+    u64 text_offset = elf_align_up(ELF_HEADER_BYTES + num_phdrs * ELF_PHDR_BYTES, 16);
+    std::vector<u8> text = object->bytes[(int)ElfSection::TEXT];
+    elf_pad(&text, 16);
+    u64 start = text.size();
+    elf_emit_start(&text, object->has_init ? (i64)object->init_offset : -1, (i64)main->offset, main_returns);
+    u64 rodata_offset = elf_align_up(text_offset + text.size(), 16);
+    const std::vector<u8>& rodata = object->bytes[(int)ElfSection::RODATA];
+    u64 code_end = rodata_offset + rodata.size();
+    u64 data_offset = elf_align_up(code_end, ELF_PAGE_BYTES);
+    std::vector<u8> data = object->bytes[(int)ElfSection::DATA];
+    u64 bss_offset = elf_align_up(data_offset + data.size(), object->align[(int)ElfSection::BSS]);
+    u64 data_end = bss_offset + object->bss_bytes;
+
+    u64 addrs[(int)ElfSection::SIZE_OF_ENUM] = {};
+    addrs[(int)ElfSection::TEXT] = ELF_EXE_BASE + text_offset;
+    addrs[(int)ElfSection::RODATA] = ELF_EXE_BASE + rodata_offset;
+    addrs[(int)ElfSection::DATA] = ELF_EXE_BASE + data_offset;
+    addrs[(int)ElfSection::BSS] = ELF_EXE_BASE + bss_offset;
+    //*the entry runs the initializers itself, .init_array is left out
+    for (const ElfReloc& it : object->relocs) {
+        if (it.section == ElfSection::INIT_ARRAY) {
+            continue;
+        }
+        u8* field = (it.section == ElfSection::TEXT ? text.data() : data.data()) + it.offset;
+        u64 target = addrs[(int)it.target] + (u64)it.addend;
+        if (it.kind == ElfRelocKind::PC32) {
+            elf_write_at(field, target - (addrs[(int)it.section] + it.offset), 4);
+        }
+        else {
+            elf_write_at(field, target, 8);
+        }
+    }
+
+    out->clear();
+    elf_put_header(out, 2, addrs[(int)ElfSection::TEXT] + start, ELF_HEADER_BYTES, num_phdrs, 0, 0, 0);
+    elf_put_phdr(out, 1, 5, 0, ELF_EXE_BASE, code_end, code_end, ELF_PAGE_BYTES); //*PT_LOAD, read and execute
+    elf_put_phdr(out, 1, 6, data_offset, ELF_EXE_BASE + data_offset, data.size(), data_end - data_offset, ELF_PAGE_BYTES);
+    elf_put_phdr(out, 0x6474E551, 6, 0, 0, 0, 0, 16); //*PT_GNU_STACK, read and write
+    elf_pad(out, 16);
+    out->resize(text_offset, 0);
+    out->insert(out->end(), text.begin(), text.end());
+    out->resize(rodata_offset, 0);
+    out->insert(out->end(), rodata.begin(), rodata.end());
+    out->resize(data_offset, 0);
+    out->insert(out->end(), data.begin(), data.end());
+}
+
+int elf_build_file(const char* path, const char* out_path, bool executable) {
+    if (!elf_is_supported()) {
+        printf("ELF output needs the System V convention, which the JIT does not compile for on windows\n");
+        return 1;
+    }
+    if (!load_package_file(path) || (executable && !package_main_func(path))) {
+        return 1;
+    }
+
+    ElfObject object = {};
+    elf_compile_package(&object);
+    std::vector<u8> image;
+    if (executable) {
+        elf_write_executable(&object, &image);
+    }
+    else {
+        elf_write_object(&object, &image);
+    }
+    FILE* out = fopen(out_path, "wb");
+    if (!out) {
+        printf("cannot write %s\n", out_path);
+        return 1;
+    }
+    bool written = fwrite(image.data(), 1, image.size(), out) == image.size();
+    written = fclose(out) == 0 && written;
+    if (!written) {
+        printf("cannot write %s\n", out_path);
+        return 1;
+    }
+#ifndef _WIN32
+    if (executable) {
+        chmod(out_path, 0755);
+    }
+#endif
+    return 0;
+}
+
+//*tests
+
+Internal const ElfSymbol* elf_test_symbol(const ElfObject* object, const char* name) {
+    for (const ElfSymbol& it : object->symbols) {
+        if (strcmp(it.name, name) == 0) {
+            return &it;
+        }
+    }
+    return nullptr;
+}
+
+//*the name of section i of an object file
+Internal const char* elf_test_section_name(const std::vector<u8>& image, u32 i) {
+    u64 shoff = elf_read_at(image.data() + 40, 8);
+    u32 shstrndx = (u32)elf_read_at(image.data() + 62, 2);
+    const u8* names = image.data() + elf_read_at(image.data() + shoff + shstrndx * ELF_SHDR_BYTES + 24, 8);
+    return (const char*)names + elf_read_at(image.data() + shoff + i * ELF_SHDR_BYTES, 4);
+}
+
+void elf_test() {
+    if (!elf_is_supported()) {
+        return;
+    }
+    const char* src =
+        "struct Vector { x, y: int; }\n"
+        "var origin: Vector = {3, 4}\n"
+        "var count: char = 7\n"
+        "var half: double = 0.5\n"
+        "var greeting: char* = \"hello\"\n"
+        "var squares: int[8]\n"
+        "var entry: func(int): int = twice\n"
+        "func twice(n: int): int { return n * 2; }\n"
+        "func length(s: char*): int { n := 0; while (s[n]) { n++; } return n; }\n"
+        "func main(): int { for (i := 0; i < 8; i++) { squares[i] = i * i; }\n"
+        "    return origin.x + origin.y * count + length(greeting) + length(\"abc\") + entry(squares[3]) + (half < 1); }\n";
+    int expected = 3 + 4 * 7 + 5 + 3 + 18 + 1;
+
+    assert(load_package_src("elf_test.sorin", src));
+    ElfObject object = {};
+    elf_compile_package(&object);
+    //*every initializer is constant, pointers to strings and funcs included
+    assert(!object.has_init);
+    const ElfSymbol* origin = elf_test_symbol(&object, "origin");
+    assert(origin && origin->section == ElfSection::DATA && origin->size == 8);
+    const std::vector<u8>& data = object.bytes[(int)ElfSection::DATA];
+    assert(elf_read_at(data.data() + origin->offset, 4) == 3 && elf_read_at(data.data() + origin->offset + 4, 4) == 4);
+    const ElfSymbol* half = elf_test_symbol(&object, "half");
+    assert(half->offset % 8 == 0 && elf_read_at(data.data() + half->offset, 8) == 0x3FE0000000000000ull);
+    assert(elf_test_symbol(&object, "squares")->section == ElfSection::BSS && object.bss_bytes == 32);
+    assert(elf_test_symbol(&object, "main")->is_func && elf_test_symbol(&object, "main")->section == ElfSection::TEXT);
+    u32 num_abs = 0;
+    for (ElfReloc& it : object.relocs) {
+        num_abs += it.kind == ElfRelocKind::ABS64 ? 1 : 0;
+    }
+    assert(num_abs == 2);
+    assert(memcmp(object.bytes[(int)ElfSection::RODATA].data(), "hello", 6) == 0);
+
+    std::vector<u8> image;
+    elf_write_object(&object, &image);
+    assert(memcmp(image.data(), "\x7F" "ELF", 4) == 0 && elf_read_at(image.data() + 16, 2) == 1);
+    assert(elf_read_at(image.data() + 18, 2) == ELF_MACHINE_X86_64);
+    u32 num_sections = (u32)elf_read_at(image.data() + 60, 2);
+    bool has_rela_text = false;
+    bool has_symtab = false;
+    for (u32 i = 1; i < num_sections; i++) {
+        has_rela_text |= strcmp(elf_test_section_name(image, i), ".rela.text") == 0;
+        has_symtab |= strcmp(elf_test_section_name(image, i), ".symtab") == 0;
+    }
+    assert(has_rela_text && has_symtab);
+
+    //*an initializer that reads another var's value after a call runs from .init_array, and first in an executable
+    const char* dynamic_src =
+        "var count: int = 7\n"
+        "var scale: int = twice(count)\n"
+        "func twice(n: int): int { return n * 2; }\n"
+        "func main(): int { return scale + count; }\n";
+    assert(load_package_src("elf_test.sorin", dynamic_src));
+    ElfObject dynamic = {};
+    elf_compile_package(&dynamic);
+    assert(dynamic.has_init && dynamic.bytes[(int)ElfSection::INIT_ARRAY].size() == 8);
+    assert(elf_read_at(dynamic.bytes[(int)ElfSection::DATA].data() + elf_test_symbol(&dynamic, "count")->offset, 4) == 7);
+    elf_write_object(&dynamic, &image);
+    bool has_init_array = false;
+    for (u32 i = 1; i < (u32)elf_read_at(image.data() + 60, 2); i++) {
+        has_init_array |= strcmp(elf_test_section_name(image, i), ".init_array") == 0;
+    }
+    assert(has_init_array);
+
+#if defined(__linux__) && defined(__x86_64__)
+    //*the executables run on this host
+    struct ElfTestRun {
+        ElfObject* object;
+        int status;
+    };
+    ElfTestRun runs[] = { { &object, expected }, { &dynamic, 14 + 7 } };
+    for (ElfTestRun& run : runs) {
+        elf_write_executable(run.object, &image);
+        const char* exe_path = "./sorin_elf_test";
+        FILE* file = fopen(exe_path, "wb");
+        assert(file);
+        fwrite(image.data(), 1, image.size(), file);
+        fclose(file);
+        chmod(exe_path, 0755);
+        int status = system(exe_path);
+        remove(exe_path);
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == run.status);
+    }
+#else
+    (void)expected;
+#endif
+}
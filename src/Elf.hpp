@@ -0,0 +1,68 @@
+#pragma once
+#include <vector>
+#include "Ir.hpp"
+
+//*ELF64 output of the x86-64 code the JIT compiles, without an assembler or a linker. a relocatable object holds the
+//*funcs in .text, global vars with an initializer in .data and the others in .bss, and string literals in .rodata.
+//*funcs and global vars are global symbols, so the object links with the system ld and C code calls Sorin funcs and
+//*sets the func vars through which Sorin calls C. initializers that only store constants become the bytes of .data,
+//*any other makes the object run the initializers from .init_array before main. a static executable needs no libc,
+//*its entry runs the initializers and main and exits with main's result through the exit system call
+
+enum class ElfSection : u8 {
+    TEXT,
+    DATA,
+    RODATA,
+    BSS,
+    INIT_ARRAY,
+    SIZE_OF_ENUM,
+};
+
+struct ElfSymbol {
+    const char* name;
+    ElfSection section;
+    u64 offset;
+    u64 size;
+    bool is_func;
+    bool is_local;
+};
+
+enum class ElfRelocKind : u8 {
+    PC32, //*a rel32 to the target, from the end of the field
+    ABS64, //*the address of the target
+};
+
+//*a field at offset in section that refers to offset addend in target
+struct ElfReloc {
+    ElfSection section;
+    u64 offset;
+    ElfRelocKind kind;
+    ElfSection target;
+    i64 addend;
+};
+
+struct ElfObject {
+    std::vector<u8> bytes[(int)ElfSection::SIZE_OF_ENUM]; //*empty for .bss
+    u64 bss_bytes;
+    u32 align[(int)ElfSection::SIZE_OF_ENUM];
+    std::vector<ElfSymbol> symbols;
+    std::vector<ElfReloc> relocs;
+    bool has_init; //*whether .text holds a func that runs the initializers
+    u64 init_offset;
+};
+
+//*whether the JIT's code follows the System V convention of ELF systems, not on windows hosts
+bool elf_is_supported();
+
+//*compiles the resolved package
+void elf_compile_package(ElfObject* object);
+
+void elf_write_object(const ElfObject* object, std::vector<u8>* out);
+
+//*a static executable for x86-64 linux whose entry runs the initializers and main, the object needs a func main()
+void elf_write_executable(const ElfObject* object, std::vector<u8>* out);
+
+//*parses, checks and compiles the file into an object file at out_path, or a static executable. 0 on success
+int elf_build_file(const char* path, const char* out_path, bool executable);
+
+void elf_test();
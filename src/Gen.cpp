@@ -0,0 +1,2281 @@
+#include <cassert>
+#include <cstdarg>
+#include <cinttypes>
+#include <cctype>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include "Gen.hpp"
+#include "Globals.hpp"
+#include "Parse.hpp"
+#include "Switch.hpp"
+#include "Ctfe.hpp"
+#include "Ir.hpp"
+#include "Opt.hpp"
+#include "Visit.hpp"
+#include "AstCache.hpp"
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <sys/wait.h>
+#endif
+
+//*the state of the generator is per thread, function bodies are generated on several, see gen_func_defs
+GlobalVariable thread_local std::string gen_buf;
+GlobalVariable thread_local int gen_indent;
+
+//*true while a global initializer is generated, C wants constant expressions there
+GlobalVariable thread_local bool gen_global_init;
+
+//*numbers the lowered switches of the current function, their labels are switchN_*
+GlobalVariable thread_local int gen_switch_count;
+
+//*innermost first, 0 for a loop and the switch number for a lowered switch, break jumps out of a switch by goto
+GlobalVariable thread_local std::vector<int> gen_break_targets;
+
+GlobalVariable const char* gen_preamble =
+    "// generated by sorin\n"
+    "#include <stdbool.h>\n"
+    "#include <stddef.h>\n"
+    "#include <string.h>\n"
+    "\n"
+    "//the scalar names, once for every generated file a unit includes\n"
+    "#ifndef SORIN_SCALAR_TYPES\n"
+    "#define SORIN_SCALAR_TYPES\n"
+    "typedef signed char schar;\n"
+    "typedef unsigned char uchar;\n"
+    "typedef unsigned short ushort;\n"
+    "typedef unsigned int uint;\n"
+    "typedef unsigned long ulong;\n"
+    "typedef long long llong;\n"
+    "typedef unsigned long long ullong;\n"
+    "#endif\n";
+
+Internal void genf(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    char buf[256];
+    int len = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (len < (int)sizeof(buf)) {
+        gen_buf.append(buf, len);
+        return;
+    }
+
+    size_t start = gen_buf.size();
+    gen_buf.resize(start + len + 1);
+    va_start(args, fmt);
+    vsnprintf(&gen_buf[start], len + 1, fmt, args);
+    va_end(args);
+    gen_buf.resize(start + len);
+}
+
+//*starts a new line at the current indent
+Internal void genln() {
+    gen_buf += '\n';
+    gen_buf.append(4 * gen_indent, ' ');
+}
+
+//*a pointer declarator binds looser than [] and (), it is parenthesized before either is applied
+Internal std::string cdecl_paren(const std::string& str) {
+    return !str.empty() && str[0] == '*' ? "(" + str + ")" : str;
+}
+
+Internal std::string cdecl_params(Type* type) {
+    if (type->func.num_params == 0) {
+        return "void";
+    }
+
+    std::string params;
+    for (size_t i = 0; i < type->func.num_params; i++) {
+        params += (i ? ", " : "") + type_to_cdecl(type->func.params[i], "");
+    }
+    return params;
+}
+
+std::string type_to_cdecl(Type* type, const std::string& name) {
+    switch (type->kind) {
+        case TypeKind::PTR: {
+            return type_to_cdecl(type->ptr.base, "*" + name);
+        }
+        case TypeKind::ARRAY: {
+            return type_to_cdecl(type->array.base, cdecl_paren(name) + "[" + std::to_string(type->array.size) + "]");
+        }
+        case TypeKind::FUNC: {
+            //*func values are function pointers
+            return type_to_cdecl(type->func.ret, "(*" + name + ")(" + cdecl_params(type) + ")");
+        }
+        default: {
+            //*the scalars and aggregates go by their sorin names, see the preamble and the forward declarations
+            std::string str = type_to_str(type);
+            return name.empty() ? str : str + " " + name;
+        }
+    }
+}
+
+Internal const char* int_suffix(Type* type) {
+    switch (type->kind) {
+        case TypeKind::UINT: {
+            return "u";
+        }
+        case TypeKind::LONG: {
+            return "l";
+        }
+        case TypeKind::ULONG: {
+            return "ul";
+        }
+        case TypeKind::LLONG: {
+            return "ll";
+        }
+        case TypeKind::ULLONG: {
+            return "ull";
+        }
+        default: {
+            return "";
+        }
+    }
+}
+
+Internal void gen_int_val(Type* type, i64 val) {
+    if (!is_signed_type(type)) {
+        genf("%" PRIu64 "%s", (u64)val, int_suffix(type));
+    }
+    else if (val == INT64_MIN) {
+        genf("(-9223372036854775807%s - 1)", int_suffix(type));
+    }
+    else {
+        genf("%" PRId64 "%s", val, int_suffix(type));
+    }
+}
+
+Internal void gen_float_val(Type* type, f64 val) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.17g", val);
+    genf("%s", buf);
+    if (!strpbrk(buf, ".en")) {
+        genf(".0");
+    }
+    if (type->kind == TypeKind::FLOAT) {
+        genf("f");
+    }
+}
+
+//*a value computed at compile time, held in the layout of its type
+Internal void gen_const_bytes(Type* type, const u8* bytes) {
+    switch (type->kind) {
+        case TypeKind::STRUCT: {
+            genf("{");
+            for (size_t i = 0; i < type->aggregate.num_fields; i++) {
+                genf(i ? ", " : "");
+                TypeField* field = type->aggregate.fields + i;
+                gen_const_bytes(field->type, bytes + field->offset);
+            }
+            genf("}");
+            break;
+        }
+        case TypeKind::ARRAY: {
+            genf("{");
+            for (size_t i = 0; i < type->array.size; i++) {
+                genf(i ? ", " : "");
+                gen_const_bytes(type->array.base, bytes + i * type->array.base->size);
+            }
+            genf("}");
+            break;
+        }
+        default: {
+            ResolvedExpr val = ctfe_scalar(type, bytes);
+            if (is_floating_type(type)) {
+                gen_float_val(type, val.float_val);
+            }
+            else {
+                gen_int_val(type, val.int_val);
+            }
+            break;
+        }
+    }
+}
+
+Internal void gen_str(const char* str) {
+    gen_buf += '"';
+    for (const char* it = str; *it; it++) {
+        switch (*it) {
+            case '"': {
+                gen_buf += "\\\"";
+                break;
+            }
+            case '\\': {
+                gen_buf += "\\\\";
+                break;
+            }
+            case '\n': {
+                gen_buf += "\\n";
+                break;
+            }
+            case '\t': {
+                gen_buf += "\\t";
+                break;
+            }
+            case '\r': {
+                gen_buf += "\\r";
+                break;
+            }
+            default: {
+                if ((u8)*it < 0x20 || (u8)*it >= 0x7F) {
+                    genf("\\%03o", (u8)*it);
+                }
+                else {
+                    gen_buf += *it;
+                }
+                break;
+            }
+        }
+    }
+    gen_buf += '"';
+}
+
+//*value of a resolved const symbol as a literal of its type
+Internal void gen_const_val(Sym* sym) {
+    if (is_floating_type(sym->type)) {
+        gen_float_val(sym->type, sym->float_val);
+    }
+    else {
+        gen_int_val(sym->type, sym->int_val);
+    }
+}
+
+Internal void gen_expr(Expr* expr);
+
+//*in an initializer a compound literal is just its braces, C would reject an array initialized from a compound literal
+Internal void gen_init_expr(Expr* expr) {
+    if (expr->kind != ExprKind::COMPOUND) {
+        gen_expr(expr);
+        return;
+    }
+
+    genf("{");
+    for (size_t i = 0; i < expr->compound.num_args; i++) {
+        genf(i ? ", " : "");
+        gen_init_expr(expr->compound.args[i]);
+    }
+    genf("}");
+}
+
+Internal void gen_expr(Expr* expr) {
+    switch (expr->kind) {
+        case ExprKind::INT: {
+            gen_int_val(expr_type(expr), expr->int_val);
+            break;
+        }
+        case ExprKind::FLOAT: {
+            gen_float_val(expr_type(expr), expr->float_val);
+            break;
+        }
+        case ExprKind::STR: {
+            gen_str(expr->str_val);
+            break;
+        }
+        case ExprKind::NAME: {
+            Sym* sym = expr_sym(expr);
+            if (gen_global_init && sym && sym->kind == SymKind::CONST && sym->type != Global::type_int) {
+                genf("((%s)", type_to_cdecl(sym->type, "").c_str());
+                gen_const_val(sym);
+                genf(")");
+            }
+            else {
+                genf("%s", expr->name);
+            }
+            break;
+        }
+        case ExprKind::CAST: {
+            genf("((%s)(", type_to_cdecl(typespec_type(expr->cast.type), "").c_str());
+            gen_expr(expr->cast.expr);
+            genf("))");
+            break;
+        }
+        case ExprKind::CALL: {
+            auto val = Global::const_call_vals.find(expr->id);
+            if (val != Global::const_call_vals.end()) {
+                gen_const_bytes(expr_type(expr), val->second.data());
+                break;
+            }
+            gen_expr(expr->call.expr);
+            genf("(");
+            for (size_t i = 0; i < expr->call.num_args; i++) {
+                genf(i ? ", " : "");
+                gen_expr(expr->call.args[i]);
+            }
+            genf(")");
+            break;
+        }
+        case ExprKind::INDEX: {
+            gen_expr(expr->index.expr);
+            genf("[");
+            gen_expr(expr->index.index);
+            genf("]");
+            break;
+        }
+        case ExprKind::FIELD: {
+            //*fields are reached through pointers with the same dot
+            gen_expr(expr->field.expr);
+            genf(expr_type(expr->field.expr)->kind == TypeKind::PTR ? "->%s" : ".%s", expr->field.name);
+            break;
+        }
+        case ExprKind::COMPOUND: {
+            genf("(%s)", type_to_cdecl(expr_type(expr), "").c_str());
+            gen_init_expr(expr);
+            break;
+        }
+        case ExprKind::UNARY: {
+            genf("%s(", Global::token_kind_names[(int)expr->unary.op]);
+            gen_expr(expr->unary.expr);
+            genf(")");
+            break;
+        }
+        case ExprKind::BINARY: {
+            //*sorin's precedence levels are not C's, every binary expression keeps its parentheses
+            genf("(");
+            gen_expr(expr->binary.left);
+            genf(" %s ", Global::token_kind_names[(int)expr->binary.op]);
+            gen_expr(expr->binary.right);
+            genf(")");
+            break;
+        }
+        case ExprKind::TERNARY: {
+            genf("(");
+            gen_expr(expr->ternary.cond);
+            genf(" ? ");
+            gen_expr(expr->ternary.then_expr);
+            genf(" : ");
+            gen_expr(expr->ternary.else_expr);
+            genf(")");
+            break;
+        }
+        case ExprKind::SIZEOF_EXPR: {
+            genf("sizeof(");
+            gen_expr(expr->sizeof_expr);
+            genf(")");
+            break;
+        }
+        case ExprKind::SIZEOF_TYPE: {
+            genf("sizeof(%s)", type_to_cdecl(typespec_type(expr->sizeof_type), "").c_str());
+            break;
+        }
+        default: {
+            assert(false);
+            break;
+        }
+    }
+}
+
+Internal void gen_aggregate(Decl* decl, Type* type) {
+    genln();
+    genf("%s %s {", decl->kind == DeclKind::STRUCT ? "struct" : "union", decl->name);
+    gen_indent++;
+    for (TypeField* it = type->aggregate.fields; it != type->aggregate.fields + type->aggregate.num_fields; it++) {
+        genln();
+        genf("%s;", type_to_cdecl(it->type, it->name).c_str());
+    }
+    gen_indent--;
+    genln();
+    genf("};");
+}
+
+Internal void gen_forward_decl(Decl* decl) {
+    const char* keyword = decl->kind == DeclKind::STRUCT ? "struct" : "union";
+    genln();
+    genf("typedef %s %s %s;", keyword, decl->name, decl->name);
+}
+
+//*local enums are emitted as written, C counts implicit items up the same way
+Internal void gen_local_enum(Decl* decl) {
+    genln();
+    genf("typedef int %s;", decl->name);
+    genln();
+    genf("enum {");
+    gen_indent++;
+    for (EnumItem* it = decl->enum_decl.items; it != decl->enum_decl.items + decl->enum_decl.num_items; it++) {
+        genln();
+        genf("%s", it->name);
+        if (it->init) {
+            genf(" = ");
+            gen_expr(it->init);
+        }
+        genf(",");
+    }
+    gen_indent--;
+    genln();
+    genf("};");
+}
+
+Internal void gen_stmt(Stmt* stmt);
+
+Internal void gen_stmt_block(StmtBlock block) {
+    genf("{");
+    gen_indent++;
+    for (size_t i = 0; i < block.num_stmts; i++) {
+        gen_stmt(block.stmts[i]);
+    }
+    gen_indent--;
+    genln();
+    genf("}");
+}
+
+//*a statement without its semicolon, for the init and next clauses of for
+Internal void gen_simple_stmt(Stmt* stmt) {
+    switch (stmt->kind) {
+        case StmtKind::ASSIGN: {
+            gen_expr(stmt->assign.left);
+            if (!stmt->assign.right) {
+                genf("%s", Global::token_kind_names[(int)stmt->assign.op]);
+                break;
+            }
+            genf(" %s ", Global::token_kind_names[(int)stmt->assign.op]);
+            gen_expr(stmt->assign.right);
+            break;
+        }
+        case StmtKind::INIT: {
+            //*the variable has the decayed type of its initializer, a compound array literal stays a C compound literal
+            Type* type = expr_type(stmt->init.expr);
+            if (type->kind == TypeKind::ARRAY) {
+                type = type_ptr(type->array.base);
+            }
+            genf("%s = ", type_to_cdecl(type, stmt->init.name).c_str());
+            gen_expr(stmt->init.expr);
+            break;
+        }
+        case StmtKind::EXPR: {
+            gen_expr(stmt->expr);
+            break;
+        }
+        default: {
+            assert(false);
+            break;
+        }
+    }
+}
+
+struct GenSwitch {
+    int id;
+    Type* type;
+    bool is_signed;
+    const SwitchPlan* plan;
+    u32 default_case; //*SWITCH_DEFAULT when the switch has no default and falls out of the end
+};
+
+Internal void gen_switch_goto(GenSwitch* sw, u32 target) {
+    if (target == SWITCH_DEFAULT) {
+        target = sw->default_case;
+    }
+
+    if (target == SWITCH_DEFAULT) {
+        genf("goto switch%d_end;", sw->id);
+    }
+    else {
+        genf("goto switch%d_case%u;", sw->id, target);
+    }
+}
+
+//*value minus the key, modulo 2^64, so one unsigned compare checks both bounds of a cluster
+Internal void gen_switch_offset(GenSwitch* sw, u64 key) {
+    genf("((ullong)switch%d_val - %" PRIu64 "ull)", sw->id, (u64)switch_key_val(key, sw->is_signed));
+}
+
+Internal void gen_switch_node(GenSwitch* sw, u32 index) {
+    if (index == SWITCH_DEFAULT) {
+        genln();
+        gen_switch_goto(sw, SWITCH_DEFAULT);
+        return;
+    }
+
+    const SwitchNode& node = sw->plan->nodes[index];
+    switch (node.kind) {
+        case SwitchNodeKind::LESS: {
+            genln();
+            genf("if (switch%d_val < ", sw->id);
+            gen_int_val(sw->type, switch_key_val(node.lo, sw->is_signed));
+            genf(") {");
+            gen_indent++;
+            gen_switch_node(sw, node.left);
+            gen_indent--;
+            genln();
+            genf("}");
+            gen_switch_node(sw, node.right);
+            return;
+        }
+        case SwitchNodeKind::RANGE: {
+            genln();
+            if (node.lo == node.hi) {
+                genf("if (switch%d_val == ", sw->id);
+                gen_int_val(sw->type, switch_key_val(node.lo, sw->is_signed));
+                genf(") ");
+            }
+            else {
+                genf("if (");
+                gen_switch_offset(sw, node.lo);
+                genf(" <= %" PRIu64 "ull) ", node.hi - node.lo);
+            }
+            gen_switch_goto(sw, node.target);
+            break;
+        }
+        case SwitchNodeKind::JUMP_TABLE: {
+            //*a dense zero based C switch, which the host compiler turns into its jump table. holes and keys outside
+            //*the table fall out of it to the next cluster
+            genln();
+            genf("switch (");
+            gen_switch_offset(sw, node.lo);
+            genf(") {");
+            for (u32 i = 0; i < node.count; i++) {
+                u32 target = sw->plan->table[node.first + i];
+                if (target != SWITCH_DEFAULT) {
+                    genln();
+                    genf("case %u: ", i);
+                    gen_switch_goto(sw, target);
+                }
+            }
+            genln();
+            genf("}");
+            break;
+        }
+        case SwitchNodeKind::BIT_TEST: {
+            genln();
+            genf("if (");
+            gen_switch_offset(sw, node.lo);
+            genf(" <= %" PRIu64 "ull) {", node.hi - node.lo);
+            gen_indent++;
+            genln();
+            genf("ullong switch%d_bit = 1ull << ", sw->id);
+            gen_switch_offset(sw, node.lo);
+            genf(";");
+            for (u32 i = node.first; i < node.first + node.count; i++) {
+                genln();
+                genf("if (switch%d_bit & 0x%" PRIx64 "ull) ", sw->id, sw->plan->tests[i].mask);
+                gen_switch_goto(sw, sw->plan->tests[i].target);
+            }
+            gen_indent--;
+            genln();
+            genf("}");
+            break;
+        }
+        default: {
+            assert(false);
+            break;
+        }
+    }
+
+    gen_switch_node(sw, node.next);
+}
+
+//*the switch value is evaluated once, dispatched by the plan from plan_switch, and every case is a labeled block
+//*that leaves by goto, so case bodies never fall through
+Internal void gen_stmt_switch(Stmt* stmt) {
+    GenSwitch sw = {};
+    sw.id = ++gen_switch_count;
+    sw.type = type_promote(expr_type(stmt->switch_stmt.expr));
+    sw.is_signed = is_signed_type(sw.type);
+    sw.default_case = SWITCH_DEFAULT;
+
+    std::vector<SwitchLabel> labels;
+    for (size_t i = 0; i < stmt->switch_stmt.num_cases; i++) {
+        SwitchCase* it = stmt->switch_stmt.cases + i;
+        if (it->is_default) {
+            sw.default_case = (u32)i;
+        }
+        for (size_t j = 0; j < it->num_exprs; j++) {
+            labels.push_back(SwitchLabel{ switch_key(case_val(it->exprs[j]), sw.is_signed), (u32)i });
+        }
+    }
+    SwitchPlan plan = plan_switch(labels, Global::gen_linear_switches);
+    sw.plan = &plan;
+
+    genln();
+    genf("{");
+    gen_indent++;
+    genln();
+    genf("%s = ", type_to_cdecl(sw.type, "switch" + std::to_string(sw.id) + "_val").c_str());
+    gen_expr(stmt->switch_stmt.expr);
+    genf(";");
+    gen_switch_node(&sw, plan.root);
+
+    gen_break_targets.push_back(sw.id);
+    for (size_t i = 0; i < stmt->switch_stmt.num_cases; i++) {
+        genln();
+        genf("switch%d_case%zu: ", sw.id, i);
+        gen_stmt_block(stmt->switch_stmt.cases[i].block);
+        if (i + 1 < stmt->switch_stmt.num_cases) {
+            genln();
+            genf("goto switch%d_end;", sw.id);
+        }
+    }
+    gen_break_targets.pop_back();
+
+    genln();
+    genf("switch%d_end:;", sw.id);
+    gen_indent--;
+    genln();
+    genf("}");
+}
+
+Internal void gen_loop_block(StmtBlock block) {
+    gen_break_targets.push_back(0);
+    gen_stmt_block(block);
+    gen_break_targets.pop_back();
+}
+
+Internal void gen_local_decl(Decl* decl) {
+    switch (decl->kind) {
+        case DeclKind::VAR: {
+            //*the declared type, or the decayed type of the initializer
+            Type* type = decl->var.type ? typespec_type(decl->var.type) : expr_type(decl->var.expr);
+            if (type->kind == TypeKind::ARRAY && !decl->var.type) {
+                type = type_ptr(type->array.base);
+            }
+            genln();
+            genf("%s = ", type_to_cdecl(type, decl->name).c_str());
+            if (decl->var.expr) {
+                gen_init_expr(decl->var.expr);
+            }
+            else {
+                genf("{0}");
+            }
+            genf(";");
+            break;
+        }
+        case DeclKind::CONST: {
+            genln();
+            genf("const %s = ", type_to_cdecl(expr_type(decl->const_decl.expr), decl->name).c_str());
+            gen_expr(decl->const_decl.expr);
+            genf(";");
+            break;
+        }
+        case DeclKind::TYPEDEF: {
+            genln();
+            genf("typedef %s;", type_to_cdecl(typespec_type(decl->typedef_decl.type), decl->name).c_str());
+            break;
+        }
+        case DeclKind::STRUCT:
+        case DeclKind::UNION: {
+            //*the fields come from the struct's own typespecs, it has no symbol left once its scope is checked
+            gen_forward_decl(decl);
+            genln();
+            genf("%s %s {", decl->kind == DeclKind::STRUCT ? "struct" : "union", decl->name);
+            gen_indent++;
+            for (AggregateItem* it = decl->aggregate.items; it != decl->aggregate.items + decl->aggregate.num_items; it++) {
+                for (size_t i = 0; i < it->num_names; i++) {
+                    genln();
+                    genf("%s;", type_to_cdecl(typespec_type(it->type), it->names[i]).c_str());
+                }
+            }
+            gen_indent--;
+            genln();
+            genf("};");
+            break;
+        }
+        case DeclKind::ENUM: {
+            gen_local_enum(decl);
+            break;
+        }
+        default: {
+            assert(false);
+            break;
+        }
+    }
+}
+
+Internal void gen_stmt(Stmt* stmt) {
+    switch (stmt->kind) {
+        case StmtKind::RETURN: {
+            genln();
+            genf("return");
+            if (stmt->expr) {
+                genf(" ");
+                gen_expr(stmt->expr);
+            }
+            genf(";");
+            break;
+        }
+        case StmtKind::BREAK: {
+            genln();
+            if (!gen_break_targets.empty() && gen_break_targets.back()) {
+                genf("goto switch%d_end;", gen_break_targets.back());
+            }
+            else {
+                genf("break;");
+            }
+            break;
+        }
+        case StmtKind::CONTINUE: {
+            genln();
+            genf("continue;");
+            break;
+        }
+        case StmtKind::BLOCK: {
+            genln();
+            gen_stmt_block(stmt->block);
+            break;
+        }
+        case StmtKind::IF: {
+            genln();
+            genf("if (");
+            gen_expr(stmt->if_stmt.cond);
+            genf(") ");
+            gen_stmt_block(stmt->if_stmt.then_block);
+            for (ElseIf* it = stmt->if_stmt.elseifs; it != stmt->if_stmt.elseifs + stmt->if_stmt.num_elseifs; it++) {
+                genf(" else if (");
+                gen_expr(it->cond);
+                genf(") ");
+                gen_stmt_block(it->block);
+            }
+            if (stmt->if_stmt.else_block.num_stmts) {
+                genf(" else ");
+                gen_stmt_block(stmt->if_stmt.else_block);
+            }
+            break;
+        }
+        case StmtKind::WHILE: {
+            genln();
+            genf("while (");
+            gen_expr(stmt->while_stmt.cond);
+            genf(") ");
+            gen_loop_block(stmt->while_stmt.block);
+            break;
+        }
+        case StmtKind::DO_WHILE: {
+            genln();
+            genf("do ");
+            gen_loop_block(stmt->while_stmt.block);
+            genf(" while (");
+            gen_expr(stmt->while_stmt.cond);
+            genf(");");
+            break;
+        }
+        case StmtKind::FOR: {
+            genln();
+            genf("for (");
+            if (stmt->for_stmt.init) {
+                gen_simple_stmt(stmt->for_stmt.init);
+            }
+            genf(";");
+            if (stmt->for_stmt.cond) {
+                genf(" ");
+                gen_expr(stmt->for_stmt.cond);
+            }
+            genf(";");
+            if (stmt->for_stmt.next) {
+                genf(" ");
+                gen_simple_stmt(stmt->for_stmt.next);
+            }
+            genf(") ");
+            gen_loop_block(stmt->for_stmt.block);
+            break;
+        }
+        case StmtKind::SWITCH: {
+            gen_stmt_switch(stmt);
+            break;
+        }
+        case StmtKind::ASSIGN:
+        case StmtKind::INIT:
+        case StmtKind::EXPR: {
+            genln();
+            gen_simple_stmt(stmt);
+            genf(";");
+            break;
+        }
+        case StmtKind::DECL: {
+            gen_local_decl(stmt->decl);
+            break;
+        }
+        default: {
+            assert(false);
+            break;
+        }
+    }
+}
+
+//*name(params) applied to the return type, so a function returning a func value declares correctly
+Internal std::string gen_func_decl(Sym* sym) {
+    Decl* decl = sym->decl;
+    Type* type = sym->type;
+    std::string params;
+    for (size_t i = 0; i < decl->func.num_params; i++) {
+        params += (i ? ", " : "") + type_to_cdecl(type->func.params[i], decl->func.params[i].name);
+    }
+
+    return type_to_cdecl(type->func.ret, std::string(decl->name) + "(" + (params.empty() ? "void" : params) + ")");
+}
+
+Internal void gen_func_def(Sym* sym) {
+    gen_switch_count = 0;
+    genln();
+    genln();
+    genf("%s ", gen_func_decl(sym).c_str());
+    gen_stmt_block(materialize_func_body(sym->decl));
+}
+
+//*bodies from the IR. every value is a local irN and every block a label bN. a phi is assigned through irN_in on each
+//*edge into its block, so the phis of a block all read their operands before any of them is written
+
+Internal const char* gen_ir_binary_op(IrOp op) {
+    LocalPersist const char* ops[] = { "+", "-", "*", "/", "%", "&", "|", "^", "<<", ">>" };
+    LocalPersist const char* cmp_ops[] = { "==", "!=", "<", "<=", ">", ">=" };
+    if (op >= IrOp::EQ && op <= IrOp::GE) {
+        return cmp_ops[(int)op - (int)IrOp::EQ];
+    }
+    assert(op >= IrOp::ADD && op <= IrOp::SHR);
+    return ops[(int)op - (int)IrOp::ADD];
+}
+
+//*vector values are GNU C vector extensions, named after their lane type and count, with an unaligned twin for the
+//*loads and stores that reach them through the address of their first lane
+Internal std::string gen_ir_vector_type(IrInst* inst) {
+    std::string name = "irvec_" + type_to_cdecl(Global::types[inst->type], "") + std::to_string(inst->lanes);
+    std::replace(name.begin(), name.end(), ' ', '_');
+    return name;
+}
+
+Internal void gen_ir_vector_types() {
+    std::unordered_set<std::string> seen;
+    for (IrFunc* func : Global::ir_funcs) {
+        for (IrValue v = 1; v < func->num_insts; v++) {
+            IrInst* inst = func->insts + v;
+            std::string name = inst->lanes ? gen_ir_vector_type(inst) : "";
+            if (name.empty() || !seen.insert(name).second) {
+                continue;
+            }
+            std::string lane = type_to_cdecl(Global::types[inst->type], "");
+            size_t size = Global::types[inst->type]->size * inst->lanes;
+            genln();
+            genf("typedef %s %s __attribute__((vector_size(%zu)));", lane.c_str(), name.c_str(), size);
+            genln();
+            genf("typedef %s %s_u __attribute__((vector_size(%zu), aligned(1), may_alias));", lane.c_str(), name.c_str(), size);
+        }
+    }
+}
+
+//*the phi assignments of the edge into block to, the nth one from block from
+Internal void gen_ir_edge(IrFunc* func, u32 from, u32 to, u32 nth) {
+    IrBlock* it = func->blocks + to;
+    u32 slot = 0;
+    while (func->preds[it->first_pred + slot] != from || nth--) {
+        slot++;
+    }
+
+    for (IrValue v = it->first; v < it->first + it->num_insts && func->insts[v].op == IrOp::PHI; v++) {
+        genln();
+        genf("ir%u_in = ir%u;", v, func->operands[func->insts[v].operands.first + slot]);
+    }
+    genln();
+    genf("goto b%u;", to);
+}
+
+Internal void gen_ir_inst(IrFunc* func, u32 block, IrValue v) {
+    IrInst* inst = func->insts + v;
+    Type* type = Global::types[inst->type];
+    if (ir_has_result(inst->op) && inst->op != IrOp::UNDEF && type->kind != TypeKind::VOID) {
+        genln();
+        genf("ir%u = ", v);
+    }
+    else if (inst->op == IrOp::CALL) {
+        genln();
+    }
+
+    switch (inst->op) {
+        case IrOp::UNDEF: {
+            break;
+        }
+        case IrOp::CONST_INT: {
+            if (is_integer_type(type)) {
+                gen_int_val(type, inst->int_val);
+            }
+            else {
+                genf("(%s)%" PRId64, type_to_cdecl(type, "").c_str(), inst->int_val);
+            }
+            genf(";");
+            break;
+        }
+        case IrOp::CONST_FLOAT: {
+            gen_float_val(type, inst->float_val);
+            genf(";");
+            break;
+        }
+        case IrOp::PARAM: {
+            genf("%s;", func->sym->decl->func.params[inst->int_val].name);
+            break;
+        }
+        case IrOp::GLOBAL: {
+            genf(inst->sym->kind == SymKind::FUNC ? "%s;" : "&%s;", inst->sym->name);
+            break;
+        }
+        case IrOp::STR: {
+            gen_str(inst->str);
+            genf(";");
+            break;
+        }
+        case IrOp::PHI: {
+            genf("ir%u_in;", v);
+            break;
+        }
+        case IrOp::NEG: {
+            genf("-ir%u;", inst->args[0]);
+            break;
+        }
+        case IrOp::CONVERT:
+        case IrOp::ALLOCA: {
+            if (inst->op == IrOp::ALLOCA) {
+                genf("&ir%u_slot;", v);
+            }
+            else {
+                genf("(%s)ir%u;", inst->lanes ? gen_ir_vector_type(inst).c_str() : type_to_cdecl(type, "").c_str(), inst->args[0]);
+            }
+            break;
+        }
+        case IrOp::LOAD: {
+            if (inst->lanes) {
+                genf("*(%s_u *)ir%u;", gen_ir_vector_type(inst).c_str(), inst->args[0]);
+            }
+            else {
+                genf("*ir%u;", inst->args[0]);
+            }
+            break;
+        }
+        case IrOp::STORE: {
+            genln();
+            IrInst* value = func->insts + inst->args[1];
+            if (value->lanes) {
+                genf("*(%s_u *)ir%u = ir%u;", gen_ir_vector_type(value).c_str(), inst->args[0], inst->args[1]);
+            }
+            else {
+                genf("*ir%u = ir%u;", inst->args[0], inst->args[1]);
+            }
+            break;
+        }
+        case IrOp::SPLAT: {
+            genf("(%s){", gen_ir_vector_type(inst).c_str());
+            for (u32 i = 0; i < inst->lanes; i++) {
+                genf(i ? ", ir%u" : "ir%u", inst->args[0]);
+            }
+            genf("};");
+            break;
+        }
+        case IrOp::REDUCE_ADD: {
+            for (u32 i = 0; i < func->insts[inst->args[0]].lanes; i++) {
+                genf(i ? " + ir%u[%u]" : "ir%u[%u]", inst->args[0], i);
+            }
+            genf(";");
+            break;
+        }
+        case IrOp::ZERO: {
+            genln();
+            genf("memset(ir%u, 0, %" PRId64 ");", inst->args[0], inst->int_val);
+            break;
+        }
+        case IrOp::ELEM_ADDR: {
+            genf("ir%u + ir%u;", inst->args[0], inst->args[1]);
+            break;
+        }
+        case IrOp::FIELD_ADDR: {
+            genf("(%s)((char *)ir%u + %" PRId64 ");", type_to_cdecl(type, "").c_str(), inst->args[0], inst->int_val);
+            break;
+        }
+        case IrOp::CALL: {
+            genf("ir%u(", inst->args[0]);
+            for (u32 i = 0; i < inst->operands.count; i++) {
+                genf(i ? ", ir%u" : "ir%u", func->operands[inst->operands.first + i]);
+            }
+            genf(");");
+            break;
+        }
+        case IrOp::JUMP: {
+            gen_ir_edge(func, block, inst->targets[0], 0);
+            break;
+        }
+        case IrOp::BRANCH: {
+            genln();
+            genf("if (ir%u) {", inst->args[0]);
+            gen_indent++;
+            gen_ir_edge(func, block, inst->targets[0], 0);
+            gen_indent--;
+            genln();
+            genf("}");
+            gen_ir_edge(func, block, inst->targets[1], inst->targets[0] == inst->targets[1]);
+            break;
+        }
+        case IrOp::RETURN: {
+            genln();
+            if (inst->args[0]) {
+                genf("return ir%u;", inst->args[0]);
+            }
+            else {
+                genf("return;");
+            }
+            break;
+        }
+        default: {
+            genf("ir%u %s ir%u;", inst->args[0], gen_ir_binary_op(inst->op), inst->args[1]);
+            break;
+        }
+    }
+}
+
+Internal void gen_ir_func_def(IrFunc* func) {
+    genln();
+    genln();
+    genf("%s {", gen_func_decl(func->sym).c_str());
+    gen_indent++;
+    for (IrValue v = 1; v < func->num_insts; v++) {
+        IrInst* inst = func->insts + v;
+        Type* type = Global::types[inst->type];
+        if (!ir_has_result(inst->op) || type->kind == TypeKind::VOID) {
+            continue;
+        }
+
+        genln();
+        if (inst->lanes) {
+            genf("%s ir%u;", gen_ir_vector_type(inst).c_str(), v);
+            if (inst->op == IrOp::PHI) {
+                genf(" %s ir%u_in;", gen_ir_vector_type(inst).c_str(), v);
+            }
+            continue;
+        }
+        genf("%s;", type_to_cdecl(type, "ir" + std::to_string(v)).c_str());
+        if (inst->op == IrOp::PHI) {
+            genf(" %s;", type_to_cdecl(type, "ir" + std::to_string(v) + "_in").c_str());
+        }
+        else if (inst->op == IrOp::ALLOCA) {
+            genf(" %s;", type_to_cdecl(type->ptr.base, "ir" + std::to_string(v) + "_slot").c_str());
+        }
+    }
+
+    for (u32 b = 0; b < func->num_blocks; b++) {
+        IrBlock* it = func->blocks + b;
+        gen_indent--;
+        genln();
+        genf("b%u:;", b);
+        gen_indent++;
+        for (IrValue v = it->first; v < it->first + it->num_insts; v++) {
+            gen_ir_inst(func, b, v);
+        }
+    }
+    gen_indent--;
+    genln();
+    genf("}");
+}
+
+//*storage is the storage class with its space, or empty
+Internal void gen_global_var(Sym* sym, const char* storage) {
+    genln();
+    genf("%s%s", storage, type_to_cdecl(sym->type, sym->name).c_str());
+    if (sym->decl->var.expr) {
+        genf(" = ");
+        gen_global_init = true;
+        gen_init_expr(sym->decl->var.expr);
+        gen_global_init = false;
+    }
+    genf(";");
+}
+
+//*enum items and int consts are C enum constants, so they stay constant expressions everywhere C needs one
+Internal void gen_global_def(Sym* sym) {
+    Decl* decl = sym->decl;
+    switch (sym->kind) {
+        case SymKind::TYPE: {
+            if (!decl) {
+                break;
+            }
+            if (decl->kind == DeclKind::STRUCT || decl->kind == DeclKind::UNION) {
+                gen_aggregate(decl, sym->type);
+            }
+            else if (decl->kind == DeclKind::ENUM) {
+                genln();
+                genf("typedef int %s;", sym->name);
+                genln();
+                genf("enum {");
+                gen_indent++;
+                for (EnumItem* it = decl->enum_decl.items; it != decl->enum_decl.items + decl->enum_decl.num_items; it++) {
+                    Sym* item = sym_get(it->name);
+                    genln();
+                    genf("%s = ", it->name);
+                    gen_int_val(item->type, item->int_val);
+                    genf(",");
+                }
+                gen_indent--;
+                genln();
+                genf("};");
+            }
+            else {
+                genln();
+                genf("typedef %s;", type_to_cdecl(sym->type, sym->name).c_str());
+            }
+            break;
+        }
+        case SymKind::CONST: {
+            genln();
+            if (sym->type == Global::type_int) {
+                genf("enum { %s = ", sym->name);
+                gen_const_val(sym);
+                genf(" };");
+            }
+            else {
+                genf("static const %s = ", type_to_cdecl(sym->type, sym->name).c_str());
+                gen_const_val(sym);
+                genf(";");
+            }
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+}
+
+//*TypeKind by value, the generated sorin_TYPE_* constants have the same values
+GlobalVariable const char* type_kind_names[] = {
+    "NONE", "INCOMPLETE", "COMPLETING", "VOID",
+    "BOOL", "CHAR", "SCHAR", "UCHAR", "SHORT", "USHORT", "INT", "UINT", "LONG", "ULONG", "LLONG", "ULLONG", "FLOAT", "DOUBLE",
+    "PTR", "ARRAY", "STRUCT", "UNION", "FUNC",
+};
+static_assert(sizeof(type_kind_names) / sizeof(*type_kind_names) == (size_t)TypeKind::FUNC + 1, "type_kind_names is out of date");
+
+GlobalVariable const char* gen_type_info_decls =
+    "\n"
+    "//run-time type info, indexed by type id. names are offsets into sorin_type_names\n"
+    "typedef struct sorin_TypeInfo {\n"
+    "    uint kind;\n"
+    "    uint name;\n"
+    "    size_t size;\n"
+    "    size_t align;\n"
+    "    uint base; //pointee, element or return type\n"
+    "    size_t count; //array length, number of fields or of params\n"
+    "    uint first; //first field in sorin_type_fields or first param in sorin_type_params\n"
+    "} sorin_TypeInfo;\n"
+    "\n"
+    "typedef struct sorin_TypeField {\n"
+    "    uint name;\n"
+    "    uint type;\n"
+    "    size_t offset;\n"
+    "} sorin_TypeField;\n";
+
+//*the lookups go through the tables, they are the only uses a C compiler sees. the field and param lookups take
+//*an index below the type's count
+GlobalVariable const char* gen_type_info_lookups =
+    "static inline const sorin_TypeInfo* sorin_type_info(uint id) {\n"
+    "    return id && id < %zu ? &sorin_type_infos[id] : NULL;\n"
+    "}\n"
+    "\n"
+    "static inline const char* sorin_type_name(const sorin_TypeInfo* info) {\n"
+    "    return sorin_type_names + info->name;\n"
+    "}\n"
+    "\n"
+    "static inline const sorin_TypeField* sorin_type_field(const sorin_TypeInfo* info, size_t i) {\n"
+    "    return &sorin_type_fields[info->first + i];\n"
+    "}\n"
+    "\n"
+    "static inline const char* sorin_type_field_name(const sorin_TypeField* field) {\n"
+    "    return sorin_type_names + field->name;\n"
+    "}\n"
+    "\n"
+    "static inline const sorin_TypeInfo* sorin_type_param(const sorin_TypeInfo* info, size_t i) {\n"
+    "    return &sorin_type_infos[sorin_type_params[info->first + i]];\n"
+    "}\n";
+
+//*offset of str in the name pool, each distinct name is stored once
+Internal u32 gen_type_name(std::string* pool, std::unordered_map<std::string, u32>* offsets, const std::string& str) {
+    auto it = offsets->find(str);
+    if (it != offsets->end()) {
+        return it->second;
+    }
+
+    u32 offset = (u32)pool->size();
+    offsets->emplace(str, offset);
+    *pool += str;
+    *pool += '\0';
+    return offset;
+}
+
+//*the number of entries of each type info table, sorin_type_infos, sorin_type_fields, sorin_type_params and the bytes of
+//*sorin_type_names
+struct GenTypeTableSizes {
+    size_t infos;
+    size_t fields;
+    size_t params;
+    size_t names;
+};
+
+//*the type info tables with storage in front of each definition
+Internal GenTypeTableSizes gen_type_tables(const char* storage) {
+    std::string names;
+    std::unordered_map<std::string, u32> name_offsets;
+    std::vector<TypeField> fields;
+    std::vector<u32> params;
+    gen_type_name(&names, &name_offsets, "");
+
+    genln();
+    genln();
+    genf("%s sorin_TypeInfo sorin_type_infos[%zu] = {", storage, Global::types.size());
+    gen_indent++;
+    for (Type* type : Global::types) {
+        genln();
+        if (!type) {
+            genf("{0},");
+            continue;
+        }
+
+        u32 base = 0;
+        size_t count = 0;
+        size_t first = 0;
+        switch (type->kind) {
+            case TypeKind::PTR: {
+                base = type->ptr.base->id;
+                break;
+            }
+            case TypeKind::ARRAY: {
+                base = type->array.base->id;
+                count = type->array.size;
+                break;
+            }
+            case TypeKind::STRUCT:
+            case TypeKind::UNION: {
+                first = fields.size();
+                count = type->aggregate.num_fields;
+                fields.insert(fields.end(), type->aggregate.fields, type->aggregate.fields + count);
+                break;
+            }
+            case TypeKind::FUNC: {
+                base = type->func.ret->id;
+                first = params.size();
+                count = type->func.num_params;
+                for (size_t i = 0; i < count; i++) {
+                    params.push_back(type->func.params[i]->id);
+                }
+                break;
+            }
+            default: {
+                break;
+            }
+        }
+
+        std::string name = type_to_str(type);
+        genf("{sorin_TYPE_%s, %u, %zu, %zu, %u, %zu, %zu}, // %u %s", type_kind_names[(int)type->kind], gen_type_name(&names, &name_offsets, name),
+             type->size, type->align, base, count, first, type->id, name.c_str());
+    }
+    gen_indent--;
+    genln();
+    genf("};");
+
+    //*C has no empty arrays, the tables end with a zero entry
+    genln();
+    genln();
+    genf("%s sorin_TypeField sorin_type_fields[%zu] = {", storage, fields.size() + 1);
+    gen_indent++;
+    for (TypeField& it : fields) {
+        genln();
+        genf("{%u, %u, %zu},", gen_type_name(&names, &name_offsets, it.name), it.type->id, it.offset);
+    }
+    genln();
+    genf("{0},");
+    gen_indent--;
+    genln();
+    genf("};");
+
+    genln();
+    genln();
+    genf("%s uint sorin_type_params[%zu] = {", storage, params.size() + 1);
+    for (u32 it : params) {
+        genf("%u, ", it);
+    }
+    genf("0};");
+
+    //*one string so the tables hold offsets, not pointers the loader would have to relocate
+    genln();
+    genln();
+    genf("%s char sorin_type_names[%zu] =", storage, names.size());
+    gen_indent++;
+    for (size_t start = 0; start < names.size(); start = names.find('\0', start) + 1) {
+        genln();
+        gen_str(names.c_str() + start);
+        genf(" \"\\0\"");
+    }
+    gen_indent--;
+    genf(";");
+    return { Global::types.size(), fields.size() + 1, params.size() + 1, names.size() };
+}
+
+//*every type the resolver has made, as static const arrays and one inline lookup. nothing runs at startup and
+//*a program that never calls sorin_type_info lets the C compiler drop all of it. with extern_tables the arrays are
+//*only declared, for a header whose units include one that defines them with gen_type_tables
+Internal void gen_type_info(bool extern_tables) {
+    gen_buf += gen_type_info_decls;
+    genln();
+    genf("enum {");
+    gen_indent++;
+    for (size_t kind = 0; kind < sizeof(type_kind_names) / sizeof(*type_kind_names); kind++) {
+        genln();
+        genf("sorin_TYPE_%s = %zu,", type_kind_names[kind], kind);
+    }
+    gen_indent--;
+    genln();
+    genf("};");
+
+    if (extern_tables) {
+        //*the definitions only size the declarations
+        std::string buf;
+        buf.swap(gen_buf);
+        GenTypeTableSizes sizes = gen_type_tables("const");
+        gen_buf.swap(buf);
+        genln();
+        genln();
+        genf("extern const sorin_TypeInfo sorin_type_infos[%zu];", sizes.infos);
+        genln();
+        genf("extern const sorin_TypeField sorin_type_fields[%zu];", sizes.fields);
+        genln();
+        genf("extern const uint sorin_type_params[%zu];", sizes.params);
+        genln();
+        genf("extern const char sorin_type_names[%zu];", sizes.names);
+    }
+    else {
+        gen_type_tables("static const");
+    }
+
+    genln();
+    genln();
+    genln();
+    genln();
+    genf(gen_type_info_lookups, Global::types.size());
+}
+
+//*the incremental cache of function bodies
+
+//*bumped whenever the C of a body changes for the same inputs, so older entries miss
+Internal constexpr u32 GEN_CACHE_VERSION = 1;
+
+//*FNV-1a, the same hash as the AST cache keys
+Internal u64 gen_hash_bytes(u64 hash, const void* bytes, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ ((const u8*)bytes)[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+//*a whole word per step, most of what a body hashes is kinds and counts
+Internal u64 gen_hash_u64(u64 hash, u64 val) {
+    hash = (hash ^ val) * 0x9E3779B97F4A7C15ull;
+    return hash ^ (hash >> 32);
+}
+
+//*a string with its terminator, so adjacent strings cannot run together
+Internal u64 gen_hash_str(u64 hash, const char* str) {
+    return str ? gen_hash_bytes(hash, str, strlen(str) + 1) : gen_hash_u64(hash, 0);
+}
+
+//*the shape of a type as the C of a body sees it. an aggregate is its name, a body reaches its fields by name and
+//*its layout lives in the struct definition
+Internal u64 gen_hash_type(u64 hash, Type* type) {
+    if (!type) {
+        return gen_hash_u64(hash, 0);
+    }
+    hash = gen_hash_u64(hash, (u64)type->kind + 1);
+    switch (type->kind) {
+        case TypeKind::PTR: {
+            return gen_hash_type(hash, type->ptr.base);
+        }
+        case TypeKind::ARRAY: {
+            return gen_hash_type(gen_hash_u64(hash, type->array.size), type->array.base);
+        }
+        case TypeKind::FUNC: {
+            hash = gen_hash_u64(hash, type->func.num_params);
+            for (size_t i = 0; i < type->func.num_params; i++) {
+                hash = gen_hash_type(hash, type->func.params[i]);
+            }
+            return gen_hash_type(hash, type->func.ret);
+        }
+        default: {
+            return gen_hash_str(hash, type->sym ? type->sym->name : nullptr);
+        }
+    }
+}
+
+Internal u64 gen_hash_block(u64 hash, StmtBlock block) {
+    return gen_hash_u64(hash, block.num_stmts);
+}
+
+Internal u64 gen_hash_expr(u64 hash, Expr* e) {
+    hash = gen_hash_u64(hash, (u64)e->kind);
+    switch (e->kind) {
+        case ExprKind::INT: {
+            hash = gen_hash_u64(hash, (u64)e->int_val);
+            break;
+        }
+        case ExprKind::FLOAT: {
+            hash = gen_hash_bytes(hash, &e->float_val, sizeof(e->float_val));
+            break;
+        }
+        case ExprKind::STR: {
+            hash = gen_hash_str(hash, e->str_val);
+            break;
+        }
+        case ExprKind::NAME: {
+            hash = gen_hash_str(hash, e->name);
+            break;
+        }
+        case ExprKind::FIELD: {
+            hash = gen_hash_str(hash, e->field.name);
+            break;
+        }
+        case ExprKind::UNARY: {
+            hash = gen_hash_u64(hash, (u64)e->unary.op);
+            break;
+        }
+        case ExprKind::BINARY: {
+            hash = gen_hash_u64(hash, (u64)e->binary.op);
+            break;
+        }
+        case ExprKind::CALL: {
+            hash = gen_hash_u64(hash, e->call.num_args);
+            break;
+        }
+        case ExprKind::COMPOUND: {
+            hash = gen_hash_u64(gen_hash_u64(hash, e->compound.num_args), e->compound.type != nullptr);
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+    hash = gen_hash_type(hash, expr_type(e));
+    //*a named func is its signature, a const its value
+    Sym* sym = expr_sym(e);
+    if (sym) {
+        hash = gen_hash_type(gen_hash_u64(hash, (u64)sym->kind), sym->type);
+        hash = sym->kind == SymKind::CONST ? gen_hash_u64(hash, (u64)sym->int_val) : hash;
+    }
+    if (e->kind == ExprKind::CALL) {
+        auto val = Global::const_call_vals.find(e->id);
+        if (val != Global::const_call_vals.end()) {
+            hash = gen_hash_bytes(gen_hash_u64(hash, val->second.size()), val->second.data(), val->second.size());
+        }
+    }
+    return hash;
+}
+
+Internal u64 gen_hash_stmt(u64 hash, Stmt* s) {
+    hash = gen_hash_u64(hash, (u64)s->kind);
+    switch (s->kind) {
+        case StmtKind::RETURN: {
+            return gen_hash_u64(hash, s->expr != nullptr);
+        }
+        case StmtKind::BLOCK: {
+            return gen_hash_block(hash, s->block);
+        }
+        case StmtKind::IF: {
+            hash = gen_hash_u64(gen_hash_block(hash, s->if_stmt.then_block), s->if_stmt.num_elseifs);
+            for (size_t i = 0; i < s->if_stmt.num_elseifs; i++) {
+                hash = gen_hash_block(hash, s->if_stmt.elseifs[i].block);
+            }
+            return gen_hash_block(hash, s->if_stmt.else_block);
+        }
+        case StmtKind::WHILE:
+        case StmtKind::DO_WHILE: {
+            return gen_hash_block(hash, s->while_stmt.block);
+        }
+        case StmtKind::FOR: {
+            u64 parts = (u64)(s->for_stmt.init != nullptr) | (u64)(s->for_stmt.cond != nullptr) << 1 | (u64)(s->for_stmt.next != nullptr) << 2;
+            return gen_hash_block(gen_hash_u64(hash, parts), s->for_stmt.block);
+        }
+        case StmtKind::SWITCH: {
+            hash = gen_hash_u64(hash, s->switch_stmt.num_cases);
+            for (size_t i = 0; i < s->switch_stmt.num_cases; i++) {
+                SwitchCase* it = s->switch_stmt.cases + i;
+                hash = gen_hash_block(gen_hash_u64(gen_hash_u64(hash, it->num_exprs), it->is_default), it->block);
+                for (size_t j = 0; j < it->num_exprs; j++) {
+                    hash = gen_hash_u64(hash, (u64)case_val(it->exprs[j]));
+                }
+            }
+            return hash;
+        }
+        case StmtKind::ASSIGN: {
+            return gen_hash_u64(hash, (u64)s->assign.op);
+        }
+        case StmtKind::INIT: {
+            return gen_hash_str(hash, s->init.name);
+        }
+        default: {
+            return hash;
+        }
+    }
+}
+
+Internal u64 gen_hash_decl(u64 hash, Decl* d) {
+    hash = gen_hash_str(gen_hash_u64(hash, (u64)d->kind), d->name);
+    switch (d->kind) {
+        case DeclKind::ENUM: {
+            for (EnumItem* it = d->enum_decl.items; it != d->enum_decl.items + d->enum_decl.num_items; it++) {
+                hash = gen_hash_u64(gen_hash_str(hash, it->name), it->init != nullptr);
+            }
+            return hash;
+        }
+        case DeclKind::STRUCT:
+        case DeclKind::UNION: {
+            for (AggregateItem* it = d->aggregate.items; it != d->aggregate.items + d->aggregate.num_items; it++) {
+                hash = gen_hash_u64(hash, it->num_names);
+                for (size_t i = 0; i < it->num_names; i++) {
+                    hash = gen_hash_str(hash, it->names[i]);
+                }
+            }
+            return hash;
+        }
+        case DeclKind::VAR: {
+            return gen_hash_u64(gen_hash_u64(hash, d->var.type != nullptr), d->var.expr != nullptr);
+        }
+        case DeclKind::FUNC: {
+            hash = gen_hash_u64(gen_hash_u64(hash, d->func.num_params), d->func.ret_type != nullptr);
+            for (size_t i = 0; i < d->func.num_params; i++) {
+                hash = gen_hash_str(hash, d->func.params[i].name);
+            }
+            return gen_hash_block(hash, d->func.block);
+        }
+        default: {
+            return hash;
+        }
+    }
+}
+
+//*every node adds its kind, the fields that are not child nodes with the counts that place its children, and what
+//*the resolver decided about it. gen_hash_node_end closes the node, so the shape of the tree is part of the hash
+Internal bool gen_hash_node(void* ctx, AstNode node) {
+    u64 hash = gen_hash_u64(*(u64*)ctx, (u64)node.kind + 1);
+    switch (node.kind) {
+        case AstNodeKind::TYPESPEC: {
+            Typespec* t = node.typespec;
+            hash = gen_hash_u64(hash, (u64)t->kind);
+            if (t->kind == TypespecKind::NAME) {
+                hash = gen_hash_str(hash, t->name);
+            }
+            else if (t->kind == TypespecKind::FUNC) {
+                hash = gen_hash_u64(gen_hash_u64(hash, t->func.num_args), t->func.ret != nullptr);
+            }
+            else if (t->kind == TypespecKind::ARRAY) {
+                hash = gen_hash_u64(hash, t->array.size != nullptr);
+            }
+            hash = gen_hash_type(hash, typespec_type(t));
+            break;
+        }
+        case AstNodeKind::EXPR: {
+            hash = gen_hash_expr(hash, node.expr);
+            break;
+        }
+        case AstNodeKind::STMT: {
+            hash = gen_hash_stmt(hash, node.stmt);
+            break;
+        }
+        case AstNodeKind::DECL: {
+            hash = gen_hash_decl(hash, node.decl);
+            break;
+        }
+    }
+    *(u64*)ctx = hash;
+    return true;
+}
+
+Internal void gen_hash_node_end(void* ctx, AstNode node) {
+    *(u64*)ctx = gen_hash_u64(*(u64*)ctx, (u64)node.kind + 0x100);
+}
+
+u64 gen_func_hash(Sym* sym) {
+    u64 hash = gen_hash_u64(0xcbf29ce484222325ull, GEN_CACHE_VERSION);
+    hash = gen_hash_u64(hash, Global::gen_linear_switches);
+    materialize_func_body(sym->decl);
+    AstVisitor visitor = { &hash, gen_hash_node, gen_hash_node_end };
+    ast_walk(&visitor, ast_node(sym->decl));
+    return hash;
+}
+
+std::string gen_cache_path(u64 key) {
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.c", (unsigned long long)key);
+    return std::string(Global::gen_cache_dir) + name;
+}
+
+Internal bool gen_cache_load(u64 key, std::string* out) {
+    FILE* file = fopen(gen_cache_path(key).c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    out->clear();
+    char buf[4096];
+    for (size_t n = fread(buf, 1, sizeof(buf), file); n; n = fread(buf, 1, sizeof(buf), file)) {
+        out->append(buf, n);
+    }
+    bool read = !ferror(file);
+    fclose(file);
+    return read;
+}
+
+//*written to a temporary and renamed, so a concurrent build never reads a partial body
+Internal void gen_cache_store(u64 key, const std::string& def) {
+    std::string path = gen_cache_path(key);
+    std::string tmp_path = path + ".tmp";
+    FILE* file = fopen(tmp_path.c_str(), "wb");
+    if (!file) {
+        return;
+    }
+    bool written = fwrite(def.data(), 1, def.size(), file) == def.size();
+    written = fclose(file) == 0 && written;
+    remove(path.c_str());
+    if (!written || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        remove(tmp_path.c_str());
+    }
+}
+
+Internal void gen_make_dir(const char* dir) {
+#ifdef _WIN32
+    _mkdir(dir);
+#else
+    mkdir(dir, 0755);
+#endif
+}
+
+//*the functions whose bodies gen_func_defs generates, each body goes to its own string
+struct GenFuncs {
+    std::vector<Sym*> syms;
+    std::vector<std::string> defs;
+    std::atomic<size_t> next;
+    bool cached; //*bodies are looked up in Global::gen_cache_dir first
+    std::atomic<u32> hits;
+};
+
+Internal void gen_func_defs_worker(GenFuncs* funcs) {
+    for (size_t i = funcs->next++; i < funcs->syms.size(); i = funcs->next++) {
+        u64 key = funcs->cached ? gen_func_hash(funcs->syms[i]) : 0;
+        if (funcs->cached && gen_cache_load(key, &funcs->defs[i])) {
+            funcs->hits++;
+            continue;
+        }
+        gen_buf.clear();
+        gen_indent = 0;
+        if (Global::gen_from_ir) {
+            assert(Global::ir_funcs[i]->sym == funcs->syms[i]);
+            gen_ir_func_def(Global::ir_funcs[i]);
+        }
+        else {
+            gen_func_def(funcs->syms[i]);
+        }
+        funcs->defs[i].swap(gen_buf);
+        if (funcs->cached) {
+            gen_cache_store(key, funcs->defs[i]);
+        }
+    }
+}
+
+//*the bodies only read the resolved package, so the threads take the next function in turn. defs gets the bodies in
+//*Global::syms order, the same output as one thread
+Internal void gen_func_defs(std::vector<std::string>* defs) {
+    GenFuncs funcs;
+    for (Sym* it : Global::syms) {
+        if (it->kind == SymKind::FUNC) {
+            funcs.syms.push_back(it);
+            //*lazy bodies are parsed with the parser's globals, before any thread starts
+            materialize_func_body(it->decl);
+        }
+    }
+    funcs.defs.resize(funcs.syms.size());
+    funcs.next = 0;
+    //*IR bodies depend on the bodies inlined into them, which the hash leaves out
+    funcs.cached = Global::gen_cache_dir && !Global::gen_from_ir;
+    funcs.hits = 0;
+    if (funcs.cached) {
+        gen_make_dir(Global::gen_cache_dir);
+    }
+
+    size_t num_threads = Global::gen_threads ? Global::gen_threads : std::thread::hardware_concurrency();
+    num_threads = std::min(std::max(num_threads, (size_t)1), funcs.syms.size());
+    std::string buf;
+    buf.swap(gen_buf);
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < num_threads; i++) {
+        threads.push_back(std::thread(gen_func_defs_worker, &funcs));
+    }
+    gen_func_defs_worker(&funcs);
+    for (std::thread& it : threads) {
+        it.join();
+    }
+
+    if (funcs.cached) {
+        Global::gen_cache_hits += funcs.hits;
+        Global::gen_cache_misses += (u32)funcs.syms.size() - funcs.hits;
+    }
+    gen_buf.swap(buf);
+    gen_indent = 0;
+    defs->swap(funcs.defs);
+}
+
+//*the aggregates, types and consts of the package, or with only those in it or only those not in it
+Internal void gen_global_defs(const std::unordered_set<Sym*>* only, bool in_only) {
+    //*aggregates can point at each other in any order
+    genln();
+    for (Sym* it : Global::syms) {
+        bool is_aggregate = it->decl && (it->decl->kind == DeclKind::STRUCT || it->decl->kind == DeclKind::UNION);
+        if (is_aggregate && (!only || (only->count(it) != 0) == in_only)) {
+            gen_forward_decl(it->decl);
+        }
+    }
+
+    genln();
+    for (Sym* it : Global::ordered_syms) {
+        if (!only || (only->count(it) != 0) == in_only) {
+            gen_global_def(it);
+        }
+    }
+    genln();
+}
+
+//*everything before the prototypes: aggregates, the global definitions and the type info, see gen_type_info
+Internal void gen_declarations(bool extern_tables) {
+    gen_buf = gen_preamble;
+    gen_indent = 0;
+    gen_global_defs(nullptr, false);
+    gen_type_info(extern_tables);
+    if (Global::gen_from_ir) {
+        gen_ir_vector_types();
+    }
+    genln();
+}
+
+Internal void gen_prototypes() {
+    for (Sym* it : Global::syms) {
+        if (it->kind == SymKind::FUNC) {
+            genln();
+            genf("%s;", gen_func_decl(it).c_str());
+        }
+    }
+    genln();
+}
+
+std::string gen_package() {
+    gen_declarations(false);
+    gen_prototypes();
+    for (Sym* it : Global::ordered_syms) {
+        if (it->kind == SymKind::VAR) {
+            gen_global_var(it, "");
+        }
+    }
+
+    std::vector<std::string> defs;
+    gen_func_defs(&defs);
+    for (std::string& it : defs) {
+        gen_buf += it;
+    }
+    genln();
+
+    return gen_buf;
+}
+
+void gen_package_units(const char* name, size_t num_units, GenUnits* out) {
+    gen_declarations(true);
+    gen_prototypes();
+    for (Sym* it : Global::ordered_syms) {
+        if (it->kind == SymKind::VAR) {
+            genln();
+            genf("extern %s;", type_to_cdecl(it->type, it->name).c_str());
+        }
+    }
+    genln();
+    out->header = "#pragma once\n" + gen_buf;
+
+    //*the type info tables and the variables are defined once, in the first unit
+    gen_buf.clear();
+    gen_type_tables("const");
+    genln();
+    for (Sym* it : Global::ordered_syms) {
+        if (it->kind == SymKind::VAR) {
+            gen_global_var(it, "");
+        }
+    }
+    std::string vars;
+    vars.swap(gen_buf);
+
+    //*bodies stay in Global::syms order, each unit takes the next run of them until it holds its share of the bytes
+    std::vector<std::string> defs;
+    gen_func_defs(&defs);
+    size_t total = vars.size();
+    for (std::string& it : defs) {
+        total += it.size();
+    }
+    num_units = std::max(std::min(num_units, defs.size()), (size_t)1);
+    out->units.assign(num_units, std::string());
+    std::string include = std::string("// generated by sorin\n#include \"") + name + ".h\"\n";
+    size_t unit = 0;
+    size_t done = vars.size();
+    out->units[0] = include + vars;
+    for (size_t i = 0; i < defs.size(); i++) {
+        if (unit + 1 < num_units && done >= total / num_units * (unit + 1) && out->units[unit].size() > include.size()) {
+            out->units[++unit] = include;
+        }
+        out->units[unit] += defs[i];
+        done += defs[i].size();
+    }
+    for (std::string& it : out->units) {
+        it += "\n";
+    }
+    out->units.resize(unit + 1);
+
+    //*make -jN compiles the units in parallel, a package with a main also links them
+    Sym* main_sym = sym_get(Global::string_table.add("main"));
+    bool has_main = main_sym && main_sym->kind == SymKind::FUNC;
+    std::string objs;
+    for (size_t i = 0; i < out->units.size(); i++) {
+        objs += std::string(i ? " " : "") + name + "_" + std::to_string(i) + ".o";
+    }
+    std::string& mk = out->makefile;
+    mk = "# generated by sorin, make -j compiles the units in parallel\n";
+    mk += "CC ?= cc\nCFLAGS ?= -O2\nOBJS = " + objs + "\n\n";
+    mk += std::string("all: ") + (has_main ? name : "$(OBJS)") + "\n\n";
+    if (has_main) {
+        mk += std::string(name) + ": $(OBJS)\n\t$(CC) $(CFLAGS) -o $@ $(OBJS)\n\n";
+    }
+    for (size_t i = 0; i < out->units.size(); i++) {
+        std::string unit_name = std::string(name) + "_" + std::to_string(i);
+        mk += unit_name + ".o: " + unit_name + ".c " + name + ".h\n\t$(CC) $(CFLAGS) -c -o $@ " + unit_name + ".c\n";
+    }
+}
+
+//*funcs and vars named with the library's prefix are its API, the rest are internal. a package without any
+//*prefixed name exports everything
+Internal bool gen_is_public(Sym* sym, const std::string& prefix, bool all_public) {
+    return all_public || strncmp(sym->name, prefix.c_str(), prefix.size()) == 0;
+}
+
+//*the named aggregates a value of type needs defined, and the ones their fields need
+Internal void gen_api_types(Type* type, std::unordered_set<Sym*>* api) {
+    switch (type->kind) {
+        case TypeKind::PTR: {
+            gen_api_types(type->ptr.base, api);
+            break;
+        }
+        case TypeKind::ARRAY: {
+            gen_api_types(type->array.base, api);
+            break;
+        }
+        case TypeKind::FUNC: {
+            gen_api_types(type->func.ret, api);
+            for (size_t i = 0; i < type->func.num_params; i++) {
+                gen_api_types(type->func.params[i], api);
+            }
+            break;
+        }
+        case TypeKind::STRUCT:
+        case TypeKind::UNION: {
+            if (type->sym && !api->insert(type->sym).second) {
+                break;
+            }
+            for (size_t i = 0; i < type->aggregate.num_fields; i++) {
+                gen_api_types(type->aggregate.fields[i].type, api);
+            }
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+}
+
+std::string gen_package_single_header(const char* name) {
+    std::string prefix = std::string(name) + "_";
+    std::string guard;
+    for (const char* it = name; *it; it++) {
+        guard += isalnum((u8)*it) ? (char)toupper((u8)*it) : '_';
+    }
+    bool all_public = true;
+    for (Sym* it : Global::syms) {
+        if ((it->kind == SymKind::FUNC || it->kind == SymKind::VAR) && gen_is_public(it, prefix, false)) {
+            all_public = false;
+        }
+    }
+
+    //*the API part has the prefixed types and consts and the aggregates the API's signatures and vars need, the rest
+    //*is defined in the implementation part
+    std::unordered_set<Sym*> api;
+    for (Sym* it : Global::syms) {
+        bool is_public = gen_is_public(it, prefix, all_public);
+        if (it->kind == SymKind::FUNC || it->kind == SymKind::VAR || it->kind == SymKind::TYPE) {
+            if (is_public) {
+                gen_api_types(it->type, &api);
+            }
+        }
+        if ((it->kind == SymKind::TYPE || it->kind == SymKind::CONST) && is_public) {
+            api.insert(it);
+        }
+    }
+
+    //*the declarations, once per translation unit. NAME_DEF is static when the including unit defines NAME_STATIC
+    gen_buf = gen_preamble;
+    gen_indent = 0;
+    gen_global_defs(&api, true);
+    std::string header = "#ifndef " + guard + "_H\n#define " + guard + "_H\n";
+    header += "#ifdef " + guard + "_STATIC\n#define " + guard + "_DEF static\n#define " + guard + "_VAR static\n";
+    header += "#else\n#define " + guard + "_DEF extern\n#define " + guard + "_VAR\n#endif\n\n";
+    std::string def = guard + "_DEF ";
+    for (Sym* it : Global::syms) {
+        if (it->kind == SymKind::FUNC && gen_is_public(it, prefix, all_public)) {
+            genln();
+            genf("%s%s;", def.c_str(), gen_func_decl(it).c_str());
+        }
+    }
+    genln();
+    for (Sym* it : Global::ordered_syms) {
+        if (it->kind == SymKind::VAR && gen_is_public(it, prefix, all_public)) {
+            genln();
+            genf("%s%s;", def.c_str(), type_to_cdecl(it->type, it->name).c_str());
+        }
+    }
+    genln();
+    header += gen_buf;
+    header += "\n#endif\n";
+
+    //*the definitions, in the one unit that defines NAME_IMPLEMENTATION. internal funcs are static inline, so the
+    //*host compiler sees every use of them and may inline or drop them as it likes
+    gen_buf.clear();
+    gen_indent = 0;
+    gen_global_defs(&api, false);
+    gen_type_info(false);
+    if (Global::gen_from_ir) {
+        gen_ir_vector_types();
+    }
+    genln();
+    for (Sym* it : Global::syms) {
+        if (it->kind == SymKind::FUNC && !gen_is_public(it, prefix, all_public)) {
+            genln();
+            genf("static inline %s;", gen_func_decl(it).c_str());
+        }
+    }
+    genln();
+    std::string var = guard + "_VAR ";
+    for (Sym* it : Global::ordered_syms) {
+        if (it->kind == SymKind::VAR) {
+            gen_global_var(it, gen_is_public(it, prefix, all_public) ? var.c_str() : "static ");
+        }
+    }
+    std::vector<std::string> defs;
+    gen_func_defs(&defs);
+    size_t i = 0;
+    for (Sym* it : Global::syms) {
+        if (it->kind != SymKind::FUNC) {
+            continue;
+        }
+        //*a body starts on a new line after a blank one
+        if (!gen_is_public(it, prefix, all_public)) {
+            defs[i].insert(2, "static inline ");
+        }
+        gen_buf += defs[i++];
+    }
+    genln();
+    header += "\n#ifdef " + guard + "_IMPLEMENTATION\n#ifndef " + guard + "_IMPLEMENTED\n#define " + guard + "_IMPLEMENTED\n";
+    header += gen_buf;
+    header += "\n#endif\n#endif\n";
+    return header;
+}
+
+Internal bool gen_write_file(const std::string& path, const std::string& text) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        printf("cannot write %s\n", path.c_str());
+        return false;
+    }
+    bool written = fwrite(text.data(), 1, text.size(), file) == text.size();
+    written = fclose(file) == 0 && written;
+    if (!written) {
+        printf("cannot write %s\n", path.c_str());
+    }
+    return written;
+}
+
+//*the directory part of out_path with its separator, and the file name after it
+Internal void gen_split_path(const char* out_path, std::string* dir, std::string* name) {
+    *dir = out_path;
+    size_t slash = dir->find_last_of("/\\");
+    *name = slash == std::string::npos ? *dir : dir->substr(slash + 1);
+    *dir = slash == std::string::npos ? "" : dir->substr(0, slash + 1);
+}
+
+//*load_package_file, then the optimized IR the bodies are generated from with Global::gen_from_ir
+Internal bool gen_load_package(const char* path) {
+    if (!load_package_file(path)) {
+        return false;
+    }
+    if (Global::gen_from_ir) {
+        ir_lower_package();
+        ir_optimize_package();
+    }
+    return true;
+}
+
+int gen_build_file(const char* path, const char* out_path, size_t num_units) {
+    if (!gen_load_package(path)) {
+        return 1;
+    }
+    if (num_units <= 1) {
+        return gen_write_file(std::string(out_path) + ".c", gen_package()) ? 0 : 1;
+    }
+    //*the units include the header by its name, next to them
+    std::string dir;
+    std::string name;
+    gen_split_path(out_path, &dir, &name);
+    GenUnits units;
+    gen_package_units(name.c_str(), num_units, &units);
+    bool written = gen_write_file(dir + name + ".h", units.header) && gen_write_file(dir + name + ".mk", units.makefile);
+    for (size_t i = 0; written && i < units.units.size(); i++) {
+        written = gen_write_file(dir + name + "_" + std::to_string(i) + ".c", units.units[i]);
+    }
+    return written ? 0 : 1;
+}
+
+int gen_build_header_file(const char* path, const char* out_path) {
+    if (!gen_load_package(path)) {
+        return 1;
+    }
+    std::string dir;
+    std::string name;
+    gen_split_path(out_path, &dir, &name);
+    return gen_write_file(dir + name + ".h", gen_package_single_header(name.c_str())) ? 0 : 1;
+}
+
+Internal bool gen_test_has(const std::string& c, const char* str) {
+    return c.find(str) != std::string::npos;
+}
+
+Internal std::string gen_test_package(const char* src) {
+    assert(load_package_src("gen_test.sorin", src));
+    return gen_package();
+}
+
+void gen_test() {
+    assert(type_to_cdecl(Global::type_int, "x") == "int x");
+    assert(type_to_cdecl(type_ptr(type_array(Global::type_char, 4)), "p") == "char (*p)[4]");
+    assert(type_to_cdecl(type_array(type_ptr(Global::type_char), 4), "a") == "char *a[4]");
+    Type* params[] = { Global::type_int };
+    Type* func = type_func(params, 1, Global::type_float);
+    assert(type_to_cdecl(func, "cb") == "float (*cb)(int)");
+    assert(type_to_cdecl(type_array(func, 2), "") == "float (*[2])(int)");
+    assert(type_to_cdecl(type_func(nullptr, 0, func), "f") == "float (*(*f)(void))(int)");
+
+    const char* src =
+        "enum Color { RED = 3, GREEN, BLUE = RED * 4, ALPHA }\n"
+        "const n = 1 << 4\n"
+        "const size = sizeof(:Vector)\n"
+        "struct Vector { x, y: float; }\n"
+        "var origin: Vector = {0.5, 1}\n"
+        "var cells: Vector[n]\n"
+        "var bytes = size + 1\n"
+        "func len2(v: Vector*): float { return v.x * v.x + v.y * v.y; }\n"
+        "func classify(c: int): int {\n"
+        "    switch (c) {\n"
+        "    case 'a' case 'e' case 'i' case 'o' case 'u': return 1;\n"
+        "    case ' ' case '\\t' case '\\n': return 2;\n"
+        "    case GREEN: break;\n"
+        "    default: return 0;\n"
+        "    }\n"
+        "    return 3;\n"
+        "}\n"
+        "func dense(x: uchar): int {\n"
+        "    for (i := 0; i < 2; i++) { switch (x) { case 0: break; case 1: return 1; case 2: return 4; case 3: return 9; case 4 case 5: continue; } }\n"
+        "    return -1;\n"
+        "}\n";
+
+    std::string c = gen_test_package(src);
+    //*enum items are folded, implicit ones count up from the item before them
+    assert(sym_get(Global::string_table.add("GREEN"))->int_val == 4 && sym_get(Global::string_table.add("ALPHA"))->int_val == 13);
+    assert(gen_test_has(c, "GREEN = 4,") && gen_test_has(c, "ALPHA = 13,"));
+    assert(gen_test_has(c, "enum { n = 16 };"));
+    assert(gen_test_has(c, "typedef struct Vector Vector;") && gen_test_has(c, "struct Vector {\n    float x;\n    float y;\n};"));
+    assert(gen_test_has(c, "Vector origin = {0.5f, 1};") && gen_test_has(c, "Vector cells[16];"));
+    assert(gen_test_has(c, "float len2(Vector *v) {") && gen_test_has(c, "v->x"));
+
+    //*every type has a row at its id, the struct's fields are listed with their offsets
+    Type* vector = sym_get(Global::string_table.add("Vector"))->type;
+    char row[64];
+    snprintf(row, sizeof(row), "// %u Vector\n", vector->id);
+    size_t row_end = c.find(row);
+    assert(row_end != std::string::npos);
+    size_t row_start = c.rfind('\n', row_end) + 1;
+    std::string info = c.substr(row_start, row_end - row_start);
+    assert(gen_test_has(info, "{sorin_TYPE_STRUCT, ") && gen_test_has(info, ", 8, 4, 0, 2, "));
+    snprintf(row, sizeof(row), "sorin_type_infos[%zu] = {", Global::types.size());
+    assert(gen_test_has(c, row) && gen_test_has(c, "\"Vector\" \"\\0\""));
+    snprintf(row, sizeof(row), ", %u, 4},", (u32)TypeKind::FLOAT);
+    assert(gen_test_has(c, row));
+
+    //*the vowels are one bit test, the dense cases a jump table, a break leaves the switch and not the loop
+    assert(gen_test_has(c, "switch1_bit"));
+    assert(gen_test_has(c, "switch (((ullong)switch1_val - 0ull)) {") && gen_test_has(c, "goto switch1_end;"));
+    assert(gen_test_has(c, "continue;"));
+
+    //*the baseline compares every label in turn
+    Global::gen_linear_switches = true;
+    c = gen_test_package(src);
+    Global::gen_linear_switches = false;
+    assert(gen_test_has(c, "if (switch1_val == 97) goto switch1_case0;") && !gen_test_has(c, "switch1_bit"));
+
+    //*bodies generated on several threads come out as on one
+    u32 threads = Global::gen_threads;
+    Global::gen_threads = 1;
+    std::string serial = gen_test_package(src);
+    Global::gen_threads = 4;
+    assert(gen_package() == serial);
+    Global::gen_threads = threads;
+
+    //*a rebuild takes every body whose hash is unchanged from the cache: an edited body, a callee's new signature and
+    //*a field's new type each regenerate only the bodies that see them
+    const char* versions[] = {
+        "struct Vector { x, y: int; }\nvar origin: Vector = {1, 2}\n"
+        "func len(v: Vector*): int { return v.x + v.y; }\nfunc twice(n: int): int { return n * 2; }\n"
+        "func main(): int { return twice(len(&origin)); }\n",
+        "struct Vector { x, y: int; }\nvar origin: Vector = {1, 2}\n"
+        "func len(v: Vector*): int { return v.x + v.y; }\nfunc twice(n: int): int { return n * 3; }\n"
+        "func main(): int { return twice(len(&origin)); }\n",
+        "struct Vector { x, y: int; }\nvar origin: Vector = {1, 2}\n"
+        "func len(v: Vector*): int { return v.x + v.y; }\nfunc twice(n: long): int { return n * 3; }\n"
+        "func main(): int { return twice(len(&origin)); }\n",
+        "struct Vector { x: int; y: long; }\nvar origin: Vector = {1, 2}\n"
+        "func len(v: Vector*): int { return v.x + v.y; }\nfunc twice(n: long): int { return n * 3; }\n"
+        "func main(): int { return twice(len(&origin)); }\n",
+    };
+    const u32 expected_hits[] = { 3, 2, 1, 2 };
+    std::vector<u64> keys;
+    for (int i = 0; i < 4; i++) {
+        //*the type info of an earlier package stays in Global::types, only the bodies are compared
+        Global::gen_cache_dir = nullptr;
+        std::string uncached = gen_test_package(versions[i]);
+        uncached = uncached.substr(uncached.find("int len(Vector *v) {"));
+        Global::gen_cache_dir = AST_CACHE_DIR;
+        if (i == 0) {
+            Global::gen_cache_hits = 0;
+            Global::gen_cache_misses = 0;
+            gen_test_package(versions[i]);
+            assert(Global::gen_cache_hits == 0 && Global::gen_cache_misses == 3);
+        }
+        Global::gen_cache_hits = 0;
+        Global::gen_cache_misses = 0;
+        c = gen_test_package(versions[i]);
+        assert(c.substr(c.find("int len(Vector *v) {")) == uncached);
+        assert(Global::gen_cache_hits == expected_hits[i] && Global::gen_cache_misses == 3 - expected_hits[i]);
+        for (Sym* it : Global::syms) {
+            if (it->kind == SymKind::FUNC) {
+                keys.push_back(gen_func_hash(it));
+            }
+        }
+    }
+    for (u64 it : keys) {
+        remove(gen_cache_path(it).c_str());
+    }
+    Global::gen_cache_dir = nullptr;
+
+    //*split builds: the header declares what the units share, every body is in one unit and the first defines the vars
+    gen_test_package(versions[0]);
+    GenUnits units;
+    gen_package_units("pkg", 2, &units);
+    assert(gen_test_has(units.header, "#pragma once\n") && gen_test_has(units.header, "typedef struct Vector Vector;"));
+    assert(gen_test_has(units.header, "int len(Vector *v);") && gen_test_has(units.header, "extern Vector origin;"));
+    assert(!gen_test_has(units.header, "int len(Vector *v) {") && units.units.size() == 2);
+    assert(gen_test_has(units.units[0], "#include \"pkg.h\"") && gen_test_has(units.units[1], "#include \"pkg.h\""));
+    assert(gen_test_has(units.units[0], "Vector origin = {1, 2};") && !gen_test_has(units.units[1], "Vector origin"));
+    //*so are the type info tables, the header only declares them
+    assert(gen_test_has(units.header, "extern const sorin_TypeInfo sorin_type_infos[") && !gen_test_has(units.header, "static const"));
+    assert(gen_test_has(units.header, "extern const char sorin_type_names[") && gen_test_has(units.header, "sorin_type_info(uint id)"));
+    assert(gen_test_has(units.units[0], "\nconst sorin_TypeInfo sorin_type_infos[") && !gen_test_has(units.units[1], "sorin_type_infos"));
+    const char* bodies[] = { "int len(Vector *v) {", "int twice(int n) {", "int main(void) {" };
+    for (const char* it : bodies) {
+        assert(gen_test_has(units.units[0], it) != gen_test_has(units.units[1], it));
+    }
+    assert(gen_test_has(units.makefile, "pkg: $(OBJS)") && gen_test_has(units.makefile, "pkg_1.o: pkg_1.c pkg.h"));
+    gen_package_units("pkg", 8, &units);
+    assert(units.units.size() <= 3);
+
+    //*one header library: the prefixed names are its API, the internal func is static inline and the internal var static
+    gen_test_package(
+        "struct Vector { x, y: int; }\nvar vec_origin: Vector = {1, 2}\nvar calls: int\nconst scale = 3\nconst vec_dims = 2\n"
+        "enum Mode { FAST, SLOW }\nstruct Hidden { h: int; }\nvar hidden: Hidden\n"
+        "func square(n: int): int { calls++; return n * n * (FAST == 0 ? 1 : scale); }\n"
+        "func vec_len2(v: Vector*): int { return square(v.x) + square(v.y); }\n");
+    c = gen_package_single_header("vec");
+    size_t impl = c.find("#ifdef VEC_IMPLEMENTATION");
+    assert(c.find("#ifndef VEC_H\n#define VEC_H\n") == 0 && impl != std::string::npos);
+    assert(gen_test_has(c, "#define VEC_DEF static") && gen_test_has(c, "#define VEC_DEF extern"));
+    std::string api = c.substr(0, impl);
+    assert(gen_test_has(api, "typedef struct Vector Vector;") && gen_test_has(api, "VEC_DEF int vec_len2(Vector *v);"));
+    assert(gen_test_has(api, "VEC_DEF Vector vec_origin;") && !gen_test_has(api, "square") && !gen_test_has(api, "calls"));
+    //*it only has the types and consts of the API, the internal ones and the type info are defined with the funcs
+    assert(gen_test_has(api, "struct Vector {") && gen_test_has(api, "enum { vec_dims = 2 };") && !gen_test_has(api, "scale"));
+    assert(!gen_test_has(api, "FAST") && !gen_test_has(api, "Hidden") && !gen_test_has(api, "sorin_type"));
+    assert(gen_test_has(api, "#ifndef SORIN_SCALAR_TYPES\n#define SORIN_SCALAR_TYPES\ntypedef signed char schar;"));
+    std::string impl_part = c.substr(impl);
+    assert(gen_test_has(impl_part, "static inline int square(int n);") && gen_test_has(impl_part, "\nstatic inline int square(int n) {"));
+    assert(gen_test_has(impl_part, "VEC_VAR Vector vec_origin = {1, 2};") && gen_test_has(impl_part, "\nstatic int calls;"));
+    assert(gen_test_has(impl_part, "\nint vec_len2(Vector *v) {"));
+    assert(gen_test_has(impl_part, "enum { scale = 3 };") && gen_test_has(impl_part, "FAST = 0,"));
+    assert(gen_test_has(impl_part, "struct Hidden {") && gen_test_has(impl_part, "static const sorin_TypeInfo sorin_type_infos["));
+    //*without any prefixed name the whole package is the API
+    assert(gen_test_has(gen_package_single_header("other"), "OTHER_DEF int square(int n);"));
+    //*a unit that includes the API may use the internal names for its own, built below
+    assert(gen_write_file("gen_test_vec.h", c));
+    assert(gen_write_file("gen_test_vec_impl.c", "#define VEC_IMPLEMENTATION\n#include \"gen_test_vec.h\"\n"));
+    assert(gen_write_file("gen_test_vec_user.c",
+        "#include \"gen_test_vec.h\"\n#include \"gen_test_vec.h\"\n"
+        "enum { scale = 7, FAST = 1 };\ntypedef struct Hidden { char other; } Hidden;\n"
+        "int main(void) { Vector v = {3, 4}; return vec_len2(&v) + scale + FAST; }\n"));
+
+    //*sorin c --ir: the file goes through the optimizer and the vectorized loop becomes GNU C vectors
+    const char* ir_src =
+        "var a: int[37]\nvar b: int[37]\n"
+        "func total(): int { s := 0; for (i := 0; i < 37; i++) { s += a[i]; } return s; }\n"
+        "func main(): int { for (i := 0; i < 37; i++) { b[i] = i; } for (i := 0; i < 37; i++) { a[i] = b[i] * 3 + 1; }\n"
+        "    return total() % 256; }\n";
+    FILE* file = fopen("gen_test_ir.sorin", "wb");
+    assert(file);
+    fputs(ir_src, file);
+    fclose(file);
+    Global::gen_from_ir = true;
+    assert(gen_build_file("gen_test_ir.sorin", "gen_test_ir", 1) == 0);
+    Global::gen_from_ir = false;
+    assert(gen_build_file("gen_test_ir.sorin", "gen_test_split", 2) == 0);
+    remove("gen_test_ir.sorin");
+    file = fopen("gen_test_ir.c", "rb");
+    assert(file);
+    c.clear();
+    char buf[4096];
+    for (size_t n = fread(buf, 1, sizeof(buf), file); n; n = fread(buf, 1, sizeof(buf), file)) {
+        c.append(buf, n);
+    }
+    fclose(file);
+    assert(gen_test_has(c, "typedef int irvec_int4 __attribute__((vector_size(16)));") && gen_test_has(c, "int ir1"));
+#if defined(__linux__)
+    //*all build with the host compiler, the split one linking its units, and compute what the source does: the package
+    //*above (37 * 36 / 2 * 3 + 37) % 256, the library user 3 * 3 + 4 * 4 + 7 + 1
+    struct GenTestBuild {
+        const char* exe;
+        const char* files;
+        int status;
+    };
+    const GenTestBuild builds[] = {
+        { "gen_test_ir", "gen_test_ir.c", (37 * 36 / 2 * 3 + 37) % 256 },
+        { "gen_test_split", "gen_test_split_0.c gen_test_split_1.c", (37 * 36 / 2 * 3 + 37) % 256 },
+        { "gen_test_vec", "gen_test_vec_impl.c gen_test_vec_user.c", 3 * 3 + 4 * 4 + 7 + 1 },
+    };
+    const char* cc = getenv("CC");
+    for (const GenTestBuild& it : builds) {
+        std::string compile = std::string(cc ? cc : "cc") + " -o ./" + it.exe + " " + it.files;
+        assert(system(compile.c_str()) == 0);
+        int status = system((std::string("./") + it.exe).c_str());
+        remove(it.exe);
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == it.status);
+    }
+#endif
+    const char* outputs[] = { "gen_test_ir.c", "gen_test_split.h", "gen_test_split.mk", "gen_test_split_0.c", "gen_test_split_1.c",
+                              "gen_test_vec.h", "gen_test_vec_impl.c", "gen_test_vec_user.c" };
+    for (const char* it : outputs) {
+        remove(it);
+    }
+
+    reset_syms();
+}
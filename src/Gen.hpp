@@ -0,0 +1,49 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Resolve.hpp"
+
+//*C source for the package resolved by resolve_package: aggregate forward declarations, then the global definitions
+//*in Global::ordered_syms order, the run-time type info of every type, then function prototypes, variables and function bodies
+std::string gen_package();
+
+//*the package split for a parallel host build. the header has everything up to the prototypes of gen_package, with
+//*the type info tables only declared, and extern declarations of the variables. the first unit defines the tables and
+//*the variables, and the bodies are split into runs of about the same size. the makefile compiles every unit and links them when the package has a main
+struct GenUnits {
+    std::string header; //*name.h
+    std::vector<std::string> units; //*name_0.c, name_1.c, ...
+    std::string makefile;
+};
+
+//*at most num_units units, never an empty one
+void gen_package_units(const char* name, size_t num_units, GenUnits* out);
+
+//*parses, checks and generates the file as out_path.c, or with more than one unit as out_path.h, out_path_N.c and
+//*the makefile out_path.mk. with Global::gen_from_ir the bodies come from the package lowered and optimized after the
+//*check. 0 on success
+int gen_build_file(const char* path, const char* out_path, size_t num_units);
+
+//*the package as one stb-style header library. the part under the NAME_H guard has the prototypes and extern
+//*declarations of the API, the funcs and vars named name_*, or of everything when none is, with the prefixed types and
+//*consts and the aggregates the API needs. the part under NAME_IMPLEMENTATION defines the other types and consts, the
+//*type info and everything else, with the internal funcs static inline and the internal vars static. a unit
+//*that defines NAME_STATIC gets the whole library static, for a host compiler that optimizes it as one unit
+std::string gen_package_single_header(const char* name);
+
+//*parses, checks and generates the file as the single header out_path.h. 0 on success
+int gen_build_header_file(const char* path, const char* out_path);
+
+//*C declarator for a name of the given type, an empty name gives the abstract declarator for casts and sizeof
+std::string type_to_cdecl(Type* type, const std::string& name);
+
+//*hash of everything the C body of a func is generated from: its AST, the resolved types of its expressions and
+//*typespecs, and the kinds, types and const values of the symbols it names. a callee's new signature or a field's new
+//*type changes it, an edit to another body does not. stable across processes, it keys the bodies cached in
+//*Global::gen_cache_dir
+u64 gen_func_hash(Sym* sym);
+
+//*the file of the body cached under key in Global::gen_cache_dir
+std::string gen_cache_path(u64 key);
+
+void gen_test();
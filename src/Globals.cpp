@@ -46,23 +46,78 @@ void fatal(const char* fmt, ...) {
     exit(1);
 }
 
+//*line and column of pos in the current stream, resumes from the last lookup since errors are reported in stream order
+Internal void stream_location(const char* pos, int* line, int* col) {
+    LocalPersist const char* last_start;
+    LocalPersist const char* last_pos;
+    LocalPersist const char* last_line_start;
+    LocalPersist int last_line;
+
+    if (last_start != Global::stream_start || pos < last_pos) {
+        last_start = Global::stream_start;
+        last_pos = Global::stream_start;
+        last_line_start = Global::stream_start;
+        last_line = 1;
+    }
+
+    for (const char* it = last_pos; it < pos; it++) {
+        if (*it == '\n') {
+            last_line++;
+            last_line_start = it + 1;
+        }
+    }
+
+    last_pos = pos;
+    *line = last_line;
+    *col = (int)(pos - last_line_start) + 1;
+}
+
+Internal void add_diagnostic(const char* fmt, va_list args) {
+    char buf[512];
+    vsnprintf(buf, sizeof(buf), fmt, args);
+
+    Diagnostic diag = {};
+    diag.file = Global::stream_name;
+    diag.msg = (const char*)memdup(buf, strlen(buf) + 1);
+    if (Global::stream_start && Global::token.start) {
+        stream_location(Global::token.start, &diag.line, &diag.col);
+    }
+
+    Global::diagnostics.push_back(diag);
+}
+
 void syntax_error(const char* fmt, ...) {
     va_list args;
     va_start(args, fmt);
-    printf("Syntax Error: ");
-    vprintf(fmt, args);
-    printf("\n");
+    add_diagnostic(fmt, args);
     va_end(args);
 }
 
-void fatal_syntax_error(const char* fmt, ...) {
+void parse_error(const char* fmt, ...) {
+    if (Global::panic_mode) {
+        return;
+    }
+
+    Global::panic_mode = true;
     va_list args;
     va_start(args, fmt);
-    printf("Syntax Error: ");
-    vprintf(fmt, args);
-    printf("\n");
+    add_diagnostic(fmt, args);
     va_end(args);
-    exit(1);
+}
+
+void print_diagnostics() {
+    for (Diagnostic& it : Global::diagnostics) {
+        printf("%s:%d:%d: Syntax Error: %s\n", it.file ? it.file : "<stream>", it.line, it.col, it.msg);
+    }
+}
+
+void clear_diagnostics() {
+    for (Diagnostic& it : Global::diagnostics) {
+        free((void*)it.msg);
+    }
+
+    Global::diagnostics.clear();
+    Global::panic_mode = false;
 }
 
 
@@ -75,19 +130,86 @@ Token token;
 std::vector<const char*> token_kind_names;
 
 const char* stream = nullptr;
+const char* stream_start = nullptr;
+const char* stream_name = nullptr;
+
+std::vector<Diagnostic> diagnostics;
+bool panic_mode = false;
+
+bool parse_descent_chain = false;
+u64 parse_binary_calls = 0;
+bool lazy_func_bodies = false;
+const char* ast_cache_dir = nullptr;
+bool gen_linear_switches = false;
+bool gen_from_ir = false;
+u32 gen_threads = 0;
+const char* gen_cache_dir = nullptr;
+u32 gen_cache_hits = 0;
+u32 gen_cache_misses = 0;
 
 Arena ast_arena;
-
-std::vector<Sym> syms;
-
-Type type_int_val = { TypeKind::INT };
-Type type_float_val = { TypeKind::FLOAT };
-
-Type* type_int = &type_int_val;
-Type* type_float = &type_float_val;
-
-std::vector<CachedPtrType> cached_ptr_types;
-std::vector<CachedArrayType> cached_array_types;
-std::vector<CachedFuncType> cached_func_types;
+Arena ir_arena;
+std::vector<IrFunc*> ir_funcs;
+u32 ir_passes = 0xFFFFFFFF;
+std::vector<f64> ir_pass_ns;
+bool vm_superinstructions = true;
+bool vm_switch_dispatch = false;
+bool native_regalloc = true;
+
+u32 next_expr_id = 0;
+u32 next_typespec_id = 0;
+
+std::vector<Sym*> syms;
+std::vector<Sym*> ordered_syms;
+std::vector<Sym*> local_syms;
+std::unordered_map<const char*, SymBinding> sym_bindings;
+
+std::vector<u32> expr_types;
+std::vector<Sym*> expr_syms;
+std::unordered_map<u32, i64> case_vals;
+std::unordered_map<const void*, Sym*> local_decl_syms;
+bool in_const_expr;
+std::unordered_map<u32, std::vector<u8>> const_call_vals;
+std::unordered_map<Sym*, SymState> body_states;
+
+std::vector<u32> typespec_types;
+std::unordered_multimap<u64, Typespec*> typespec_spellings;
+size_t local_type_floor = SIZE_MAX;
+
+//*builtin types have no declaring symbol and nothing in the kind specific union
+#define SCALAR_TYPE(name, kind, size) Type type_##name##_val = { TypeKind::kind, (u32)TypeKind::kind, size, size, nullptr, {} }; \
+    Type* type_##name = &type_##name##_val
+
+Type type_void_val = { TypeKind::VOID, (u32)TypeKind::VOID, 0, 1, nullptr, {} };
+Type* type_void = &type_void_val;
+SCALAR_TYPE(bool, BOOL, 1);
+SCALAR_TYPE(char, CHAR, 1);
+SCALAR_TYPE(schar, SCHAR, 1);
+SCALAR_TYPE(uchar, UCHAR, 1);
+SCALAR_TYPE(short, SHORT, sizeof(short));
+SCALAR_TYPE(ushort, USHORT, sizeof(short));
+SCALAR_TYPE(int, INT, sizeof(int));
+SCALAR_TYPE(uint, UINT, sizeof(int));
+SCALAR_TYPE(long, LONG, sizeof(long));
+SCALAR_TYPE(ulong, ULONG, sizeof(long));
+SCALAR_TYPE(llong, LLONG, sizeof(long long));
+SCALAR_TYPE(ullong, ULLONG, sizeof(long long));
+SCALAR_TYPE(float, FLOAT, sizeof(float));
+SCALAR_TYPE(double, DOUBLE, sizeof(double));
+
+#undef SCALAR_TYPE
+
+Type* type_usize = sizeof(size_t) == sizeof(long) ? &type_ulong_val : &type_ullong_val;
+Type* type_ssize = sizeof(size_t) == sizeof(long) ? &type_long_val : &type_llong_val;
+
+std::vector<Type*> types = {
+    nullptr, nullptr, nullptr, type_void,
+    type_bool, type_char, type_schar, type_uchar, type_short, type_ushort, type_int, type_uint,
+    type_long, type_ulong, type_llong, type_ullong, type_float, type_double,
+};
+
+std::unordered_map<u32, Type*> cached_ptr_types;
+std::unordered_multimap<u64, Type*> cached_array_types;
+std::unordered_multimap<u64, Type*> cached_func_types;
 
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include <vector>
+#include <unordered_map>
 #include "Lex.hpp"
 #include "StringIntern.hpp"
 #include "Resolve.hpp"
@@ -18,9 +19,24 @@ void* memdup(void* src, size_t size);
 
 void fatal(const char* fmt, ...);
 
+struct IrFunc;
+
+//*a syntax error recorded at a position in a source stream, printed in one batch by print_diagnostics
+struct Diagnostic {
+    const char* file;
+    int line;
+    int col;
+    const char* msg;
+};
+
+//*records an error at the current token, lexer errors never stop the lexer
 void syntax_error(const char* fmt, ...);
 
-void fatal_syntax_error(const char* fmt, ...);
+//*records an error at the current token and enters panic mode, errors raised while panicking are dropped until the parser syncs
+void parse_error(const char* fmt, ...);
+
+void print_diagnostics();
+void clear_diagnostics();
 
 namespace Global {
 
@@ -34,20 +50,115 @@ extern std::vector<const char*> token_kind_names;
 
 //*codefile stream
 extern const char* stream;
+extern const char* stream_start;
+extern const char* stream_name;
+
+extern std::vector<Diagnostic> diagnostics;
+extern bool panic_mode;
+
+//*parse binary operators with the old chain of one function per precedence level, the baseline for precedence climbing
+extern bool parse_descent_chain;
+//*calls of the binary operator parsers of either kind, bench parse_expr reports them per node
+extern u64 parse_binary_calls;
+
+//*parse only function signatures and record the body spans, bodies are parsed by materialize_func_body on first use
+extern bool lazy_func_bodies;
+//*directory of the AST cache load_package_file parses through, see parse_file_cached. null parses every file, the
+//*driver modes set it to AST_CACHE_DIR unless given --no-cache
+extern const char* ast_cache_dir;
+
+//*lower every switch to one compare per case label in source order, the baseline for the switch planner
+extern bool gen_linear_switches;
+//*emit function bodies from Global::ir_funcs instead of the AST
+extern bool gen_from_ir;
+//*threads that generate function bodies, 0 for one per core. the output is the same for every count
+extern u32 gen_threads;
+//*directory of the generated function bodies gen_package reuses, keyed by gen_func_hash. null generates every body,
+//*the c and lib modes of the driver set it to AST_CACHE_DIR next to the ASTs unless given --no-cache
+extern const char* gen_cache_dir;
+//*bodies gen_package took from and added to the cache, callers clear them
+extern u32 gen_cache_hits;
+extern u32 gen_cache_misses;
 
 //*memory for ast
 extern Arena ast_arena;
-
-extern std::vector<Sym> syms;
-
-extern Type type_int_val;
-extern Type type_float_val;
-
+//*memory for the IR of the lowered package, freed as a whole by the next ir_lower_package
+extern Arena ir_arena;
+//*IR of every func of the package in Global::syms order, see ir_lower_package
+extern std::vector<IrFunc*> ir_funcs;
+//*bit 1 << IrPass for every pass ir_optimize runs, all of them by default
+extern u32 ir_passes;
+//*time spent in each pass by ir_optimize, indexed by IrPass, callers clear it
+extern std::vector<f64> ir_pass_ns;
+//*fuse common pairs of instructions into one when compiling for the VM, off gives the baseline
+extern bool vm_superinstructions;
+//*run VM bytecode with one switch over the opcodes instead of threaded dispatch, the baseline
+extern bool vm_switch_dispatch;
+//*give the values of the native backends registers, off keeps every value in its stack slot, the baseline
+extern bool native_regalloc;
+
+//*ids handed out by expr_new, also the length the expression side tables grow to
+extern u32 next_expr_id;
+//*ids handed out by typespec_new, also the length Global::typespec_types grows to
+extern u32 next_typespec_id;
+
+//*globals in declaration order
+extern std::vector<Sym*> syms;
+//*globals in the order their definitions can be emitted, each after everything its definition needs.
+//*a struct or union is added when it is completed, everything else when it is resolved
+extern std::vector<Sym*> ordered_syms;
+//*scope stack of the function body being checked, innermost last
+extern std::vector<Sym*> local_syms;
+//*name lookup, keyed by interned name pointer
+extern std::unordered_map<const char*, SymBinding> sym_bindings;
+
+//*indexed by Expr::id
+extern std::vector<u32> expr_types;
+extern std::vector<Sym*> expr_syms;
+//*folded case labels keyed by Expr::id, see case_val
+extern std::unordered_map<u32, i64> case_vals;
+//*symbols of local declarations keyed by their declaring node, see local_decl_sym
+extern std::unordered_map<const void*, Sym*> local_decl_syms;
+//*whether the expression being checked must be constant, its calls with constant arguments then run at compile time
+extern bool in_const_expr;
+//*values of the calls run at compile time keyed by Expr::id, in the layout of the call's type
+extern std::unordered_map<u32, std::vector<u8>> const_call_vals;
+//*how far the body of each func has been checked, bodies that constant expressions call are checked early
+extern std::unordered_map<Sym*, SymState> body_states;
+
+//*resolved type id of each typespec, indexed by Typespec::id, 0 until it is first resolved
+extern std::vector<u32> typespec_types;
+//*first resolved typespec of each spelling, keyed by Typespec::hash. only holds spellings whose names are all globals
+extern std::unordered_multimap<u64, Typespec*> typespec_spellings;
+//*lowest local slot that declares a type or hides a global type, SIZE_MAX when none is live.
+//*while one is live the same spelling may name a different type, so spellings are not shared
+extern size_t local_type_floor;
+
+//*every type by id, the builtin scalars sit at the index of their TypeKind and id 0 is no type
+extern std::vector<Type*> types;
+
+extern Type* type_void;
+extern Type* type_bool;
+extern Type* type_char;
+extern Type* type_schar;
+extern Type* type_uchar;
+extern Type* type_short;
+extern Type* type_ushort;
 extern Type* type_int;
+extern Type* type_uint;
+extern Type* type_long;
+extern Type* type_ulong;
+extern Type* type_llong;
+extern Type* type_ullong;
 extern Type* type_float;
-
-extern std::vector<CachedPtrType> cached_ptr_types;
-extern std::vector<CachedArrayType> cached_array_types;
-extern std::vector<CachedFuncType> cached_func_types;
+extern Type* type_double;
+//*the scalars C's size_t and ptrdiff_t are on the host
+extern Type* type_usize;
+extern Type* type_ssize;
+
+//*derived types are unique, keyed by the ids of their parts
+extern std::unordered_map<u32, Type*> cached_ptr_types;
+extern std::unordered_multimap<u64, Type*> cached_array_types;
+extern std::unordered_multimap<u64, Type*> cached_func_types;
 
 }
\ No newline at end of file
@@ -0,0 +1,2147 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdarg>
+#include <unordered_map>
+#include <unordered_set>
+#include "Ir.hpp"
+#include "Globals.hpp"
+#include "Parse.hpp"
+#include "Visit.hpp"
+#include "Ctfe.hpp"
+
+GlobalVariable const char* ir_op_names[] = {
+    "nop", "undef", "const", "const", "param", "global", "str", "phi",
+    "add", "sub", "mul", "div", "mod", "and", "or", "xor", "shl", "shr", "neg",
+    "eq", "ne", "lt", "le", "gt", "ge",
+    "convert", "alloca", "load", "store", "zero", "elem_addr", "field_addr", "call", "splat", "reduce_add",
+    "jump", "branch", "return",
+};
+static_assert(sizeof(ir_op_names) / sizeof(*ir_op_names) == (size_t)IrOp::SIZE_OF_ENUM, "ir_op_names is out of date");
+
+//*a block while its function is lowered. phis and instructions are kept apart until the function is finished,
+//*phis are added to blocks that already have code
+struct IrBuildBlock {
+    std::vector<IrValue> phis;
+    std::vector<IrValue> insts;
+    std::vector<u32> preds;
+    std::vector<std::pair<IrValue, u32>> incomplete_phis; //*phis made before the block was sealed, with their variable
+    bool sealed; //*every predecessor is known
+    bool terminated;
+};
+
+struct IrJumpTargets {
+    u32 break_block;
+    u32 continue_block;
+};
+
+//*a phi whose operands are still being read, see ir_read_var
+struct IrReadFrame {
+    u32 block;
+    IrValue phi;
+    u32 next_pred;
+    u32 vals_start;
+};
+
+//*lowering state of the current function. the vectors keep their capacity from function to function
+GlobalVariable std::vector<IrInst> ir_insts;
+GlobalVariable std::vector<IrValue> ir_operands;
+GlobalVariable std::vector<IrBuildBlock> ir_blocks;
+GlobalVariable u32 ir_num_blocks;
+GlobalVariable u32 ir_current;
+GlobalVariable Type* ir_ret_type;
+//*allocas and undefs, they go first in the entry block so they dominate every use
+GlobalVariable std::vector<IrValue> ir_entry_front;
+//*value a deleted trivial phi stands for, indexed by value, 0 for values that were not replaced
+GlobalVariable std::vector<IrValue> ir_replaced;
+
+//*locals kept in SSA form are variables with a dense index, the others live in stack slots
+GlobalVariable std::unordered_map<Sym*, u32> ir_vars;
+GlobalVariable std::vector<u32> ir_var_types;
+GlobalVariable std::unordered_map<Sym*, IrValue> ir_slots;
+GlobalVariable std::unordered_set<Sym*> ir_addr_taken;
+//*value of each variable at the end of each block that wrote or read it, keyed block << 32 | var
+GlobalVariable std::unordered_map<u64, IrValue> ir_defs;
+
+GlobalVariable std::vector<IrJumpTargets> ir_jump_targets;
+GlobalVariable std::vector<IrReadFrame> ir_read_frames;
+GlobalVariable std::vector<IrValue> ir_read_vals;
+
+Internal Type* ir_type(IrValue value) {
+    return Global::types[ir_insts[value].type];
+}
+
+Internal IrValue ir_new_inst(IrOp op, Type* type, IrValue left, IrValue right) {
+    IrInst inst = {};
+    inst.op = op;
+    inst.type = type ? type->id : 0;
+    inst.args[0] = left;
+    inst.args[1] = right;
+    ir_insts.push_back(inst);
+    return (IrValue)ir_insts.size() - 1;
+}
+
+Internal IrValue ir_emit(IrOp op, Type* type, IrValue left, IrValue right) {
+    assert(!ir_blocks[ir_current].terminated);
+    IrValue value = ir_new_inst(op, type, left, right);
+    ir_blocks[ir_current].insts.push_back(value);
+    return value;
+}
+
+Internal IrValue ir_emit_front(IrOp op, Type* type) {
+    IrValue value = ir_new_inst(op, type, IR_NONE, IR_NONE);
+    ir_entry_front.push_back(value);
+    return value;
+}
+
+Internal IrValue ir_const_int(Type* type, i64 val) {
+    IrValue value = ir_emit(IrOp::CONST_INT, type, IR_NONE, IR_NONE);
+    ir_insts[value].int_val = val;
+    return value;
+}
+
+Internal IrValue ir_const_float(Type* type, f64 val) {
+    IrValue value = ir_emit(IrOp::CONST_FLOAT, type, IR_NONE, IR_NONE);
+    ir_insts[value].float_val = val;
+    return value;
+}
+
+Internal IrValue ir_zero(Type* type) {
+    return is_floating_type(type) ? ir_const_float(type, 0) : ir_const_int(type, 0);
+}
+
+Internal IrValue ir_convert(IrValue value, Type* type) {
+    return ir_insts[value].type == type->id ? value : ir_emit(IrOp::CONVERT, type, value, IR_NONE);
+}
+
+Internal IrValue ir_alloca(Type* type) {
+    return ir_emit_front(IrOp::ALLOCA, type_ptr(type));
+}
+
+Internal u32 ir_new_block() {
+    u32 block = ir_num_blocks++;
+    if (block == ir_blocks.size()) {
+        ir_blocks.emplace_back();
+    }
+
+    IrBuildBlock* it = &ir_blocks[block];
+    it->phis.clear();
+    it->insts.clear();
+    it->preds.clear();
+    it->incomplete_phis.clear();
+    it->sealed = false;
+    it->terminated = false;
+    return block;
+}
+
+Internal void ir_add_pred(u32 block, u32 pred) {
+    assert(!ir_blocks[block].sealed);
+    ir_blocks[block].preds.push_back(pred);
+}
+
+Internal void ir_jump(u32 target) {
+    IrValue jump = ir_emit(IrOp::JUMP, nullptr, IR_NONE, IR_NONE);
+    ir_insts[jump].targets[0] = target;
+    ir_add_pred(target, ir_current);
+    ir_blocks[ir_current].terminated = true;
+}
+
+Internal void ir_branch(IrValue cond, u32 then_block, u32 else_block) {
+    IrValue branch = ir_emit(IrOp::BRANCH, nullptr, cond, IR_NONE);
+    ir_insts[branch].targets[0] = then_block;
+    ir_insts[branch].targets[1] = else_block;
+    ir_add_pred(then_block, ir_current);
+    ir_add_pred(else_block, ir_current);
+    ir_blocks[ir_current].terminated = true;
+}
+
+Internal void ir_start_block(u32 block) {
+    assert(ir_blocks[ir_current].terminated);
+    ir_current = block;
+}
+
+//*variables. this is the construction of Braun et al., "Simple and Efficient Construction of Static Single
+//*Assignment Form": a read looks for the variable's last write in the block and otherwise asks the predecessors,
+//*placing a phi where they may disagree. blocks whose predecessors are not all known yet get placeholder phis
+//*that are filled in when the block is sealed.
+
+Internal u64 ir_def_key(u32 block, u32 var) {
+    return (u64)block << 32 | var;
+}
+
+Internal void ir_write_var(u32 var, u32 block, IrValue value) {
+    ir_defs[ir_def_key(block, var)] = value;
+}
+
+Internal IrValue ir_resolve(IrValue value) {
+    while (value < ir_replaced.size() && ir_replaced[value]) {
+        value = ir_replaced[value];
+    }
+    return value;
+}
+
+Internal void ir_replace(IrValue value, IrValue with) {
+    if (ir_replaced.size() < ir_insts.size()) {
+        ir_replaced.resize(ir_insts.size(), IR_NONE);
+    }
+    ir_replaced[value] = with;
+    ir_insts[value].op = IrOp::NOP;
+}
+
+Internal IrValue ir_new_phi(u32 block, Type* type) {
+    IrValue phi = ir_new_inst(IrOp::PHI, type, IR_NONE, IR_NONE);
+    ir_blocks[block].phis.push_back(phi);
+    return phi;
+}
+
+//*a phi whose operands are all one value, or itself, is that value
+Internal IrValue ir_try_remove_trivial_phi(IrValue phi) {
+    IrValue same = IR_NONE;
+    IrInst* inst = &ir_insts[phi];
+    for (u32 i = inst->operands.first; i < inst->operands.first + inst->operands.count; i++) {
+        IrValue operand = ir_resolve(ir_operands[i]);
+        if (operand == same || operand == phi) {
+            continue;
+        }
+        if (same) {
+            return phi;
+        }
+        same = operand;
+    }
+
+    if (!same) {
+        same = ir_emit_front(IrOp::UNDEF, ir_type(phi));
+    }
+    ir_replace(phi, same);
+    return same;
+}
+
+Internal IrValue ir_finish_phi(IrValue phi, const IrValue* vals, size_t num_vals) {
+    ir_insts[phi].operands.first = (u32)ir_operands.size();
+    ir_insts[phi].operands.count = (u32)num_vals;
+    ir_operands.insert(ir_operands.end(), vals, vals + num_vals);
+    return ir_try_remove_trivial_phi(phi);
+}
+
+//*undefs in the entry go with the allocas, those in unreachable blocks are dropped with them
+Internal IrValue ir_undef_in(u32 block, Type* type) {
+    if (block == 0) {
+        return ir_emit_front(IrOp::UNDEF, type);
+    }
+    IrValue value = ir_new_inst(IrOp::UNDEF, type, IR_NONE, IR_NONE);
+    std::vector<IrValue>* insts = &ir_blocks[block].insts;
+    insts->insert(insts->begin(), value);
+    return value;
+}
+
+//*the value of var at the end of block if it can be found without reading another block's predecessors, otherwise
+//*pushes a frame for a new phi and returns IR_NONE
+Internal IrValue ir_read_var_start(u32 var, u32 block) {
+    u32 start = block;
+    IrValue value = IR_NONE;
+    for (;;) {
+        auto it = ir_defs.find(ir_def_key(block, var));
+        if (it != ir_defs.end()) {
+            value = ir_resolve(it->second);
+            break;
+        }
+
+        IrBuildBlock* it_block = &ir_blocks[block];
+        if (!it_block->sealed) {
+            value = ir_new_phi(block, Global::types[ir_var_types[var]]);
+            it_block->incomplete_phis.push_back(std::make_pair(value, var));
+            ir_write_var(var, block, value);
+            break;
+        }
+        if (it_block->preds.empty()) {
+            value = ir_undef_in(block, Global::types[ir_var_types[var]]);
+            ir_write_var(var, block, value);
+            break;
+        }
+        if (it_block->preds.size() == 1) {
+            block = it_block->preds[0];
+            continue;
+        }
+
+        //*written first so a loop back into this block finds the phi
+        IrValue phi = ir_new_phi(block, Global::types[ir_var_types[var]]);
+        ir_write_var(var, block, phi);
+        ir_read_frames.push_back(IrReadFrame{ block, phi, 0, (u32)ir_read_vals.size() });
+        return IR_NONE;
+    }
+
+    if (start != block) {
+        ir_write_var(var, start, value);
+    }
+    return value;
+}
+
+//*reads through chains of joins on an explicit stack, long functions would otherwise recurse once per join
+Internal IrValue ir_read_var(u32 var, u32 block) {
+    size_t base = ir_read_frames.size();
+    IrValue value = ir_read_var_start(var, block);
+    for (;;) {
+        if (ir_read_frames.size() == base) {
+            assert(value);
+            return value;
+        }
+
+        IrReadFrame* frame = &ir_read_frames.back();
+        if (value) {
+            ir_read_vals.push_back(value);
+            frame->next_pred++;
+        }
+
+        const std::vector<u32>& preds = ir_blocks[frame->block].preds;
+        if (frame->next_pred < preds.size()) {
+            value = ir_read_var_start(var, preds[frame->next_pred]);
+            continue;
+        }
+
+        u32 vals_start = frame->vals_start;
+        value = ir_finish_phi(frame->phi, ir_read_vals.data() + vals_start, ir_read_vals.size() - vals_start);
+        ir_read_vals.resize(vals_start);
+        ir_read_frames.pop_back();
+    }
+}
+
+Internal void ir_seal_block(u32 block) {
+    assert(!ir_blocks[block].sealed);
+    ir_blocks[block].sealed = true;
+    for (size_t i = 0; i < ir_blocks[block].incomplete_phis.size(); i++) {
+        std::pair<IrValue, u32> it = ir_blocks[block].incomplete_phis[i];
+        size_t vals_start = ir_read_vals.size();
+        for (u32 pred : ir_blocks[block].preds) {
+            IrValue value = ir_read_var(it.second, pred);
+            ir_read_vals.push_back(value);
+        }
+        ir_finish_phi(it.first, ir_read_vals.data() + vals_start, ir_read_vals.size() - vals_start);
+        ir_read_vals.resize(vals_start);
+    }
+    ir_blocks[block].incomplete_phis.clear();
+}
+
+//*code after a jump goes to a block nothing reaches, it is dropped when the function is finished
+Internal void ir_start_unreachable() {
+    u32 block = ir_new_block();
+    ir_seal_block(block);
+    ir_start_block(block);
+}
+
+Internal bool ir_is_register_type(Type* type) {
+    return is_arithmetic_type(type) || type->kind == TypeKind::PTR || type->kind == TypeKind::FUNC;
+}
+
+//*expressions
+
+Internal IrValue ir_lower_rvalue(Expr* expr);
+Internal void ir_lower_cond(Expr* expr, u32 then_block, u32 else_block);
+
+Internal IrValue ir_lower_field_addr(Expr* expr);
+Internal void ir_lower_compound_into(IrValue addr, Expr* expr);
+
+Internal IrValue ir_lower_compound_slot(Expr* expr) {
+    IrValue slot = ir_alloca(expr_type(expr));
+    ir_lower_compound_into(slot, expr);
+    return slot;
+}
+
+//*address of an lvalue, or of a temporary holding an aggregate rvalue
+Internal IrValue ir_lower_addr(Expr* expr) {
+    switch (expr->kind) {
+        case ExprKind::NAME: {
+            Sym* sym = expr_sym(expr);
+            auto slot = ir_slots.find(sym);
+            if (slot != ir_slots.end()) {
+                return slot->second;
+            }
+
+            assert(sym->kind == SymKind::VAR && !ir_vars.count(sym));
+            IrValue global = ir_emit(IrOp::GLOBAL, type_ptr(sym->type), IR_NONE, IR_NONE);
+            ir_insts[global].sym = sym;
+            return global;
+        }
+        case ExprKind::INDEX: {
+            IrValue base = ir_lower_rvalue(expr->index.expr);
+            IrValue index = ir_lower_rvalue(expr->index.index);
+            return ir_emit(IrOp::ELEM_ADDR, ir_type(base), base, index);
+        }
+        case ExprKind::FIELD: {
+            return ir_lower_field_addr(expr);
+        }
+        case ExprKind::UNARY: {
+            if (expr->unary.op == TokenKind::MUL) {
+                return ir_lower_rvalue(expr->unary.expr);
+            }
+            break;
+        }
+        case ExprKind::COMPOUND: {
+            return ir_lower_compound_slot(expr);
+        }
+        default: {
+            break;
+        }
+    }
+
+    IrValue value = ir_lower_rvalue(expr);
+    IrValue slot = ir_alloca(ir_type(value));
+    ir_emit(IrOp::STORE, nullptr, slot, value);
+    return slot;
+}
+
+Internal IrValue ir_lower_field_addr(Expr* expr) {
+    Type* type = expr_type(expr->field.expr);
+    IrValue base = IR_NONE;
+    if (type->kind == TypeKind::PTR) {
+        base = ir_lower_rvalue(expr->field.expr);
+        type = type->ptr.base;
+    }
+    else {
+        base = ir_lower_addr(expr->field.expr);
+    }
+
+    for (TypeField* it = type->aggregate.fields; it != type->aggregate.fields + type->aggregate.num_fields; it++) {
+        if (it->name == expr->field.name) {
+            IrValue addr = ir_emit(IrOp::FIELD_ADDR, type_ptr(it->type), base, IR_NONE);
+            ir_insts[addr].int_val = (i64)it->offset;
+            return addr;
+        }
+    }
+
+    assert(false);
+    return IR_NONE;
+}
+
+//*arrays are not values, reading one gives the address of its first element
+Internal IrValue ir_load(IrValue addr, Type* type) {
+    if (type->kind == TypeKind::ARRAY) {
+        return ir_emit(IrOp::CONVERT, type_ptr(type->array.base), addr, IR_NONE);
+    }
+    return ir_emit(IrOp::LOAD, type, addr, IR_NONE);
+}
+
+Internal void ir_lower_init_into(IrValue addr, Type* type, Expr* init) {
+    if (init->kind == ExprKind::COMPOUND && !ir_is_register_type(type)) {
+        ir_lower_compound_into(addr, init);
+    }
+    else {
+        ir_emit(IrOp::STORE, nullptr, addr, ir_convert(ir_lower_rvalue(init), type));
+    }
+}
+
+//*elements without an initializer are zero, as in C
+Internal void ir_lower_compound_into(IrValue addr, Expr* expr) {
+    Type* type = expr_type(expr);
+    size_t num_args = expr->compound.num_args;
+    if (type->kind == TypeKind::STRUCT || type->kind == TypeKind::UNION) {
+        if (num_args < type->aggregate.num_fields || type->kind == TypeKind::UNION) {
+            IrValue zero = ir_emit(IrOp::ZERO, nullptr, addr, IR_NONE);
+            ir_insts[zero].int_val = (i64)type->size;
+        }
+        for (size_t i = 0; i < num_args; i++) {
+            TypeField* field = type->aggregate.fields + i;
+            IrValue field_addr = ir_emit(IrOp::FIELD_ADDR, type_ptr(field->type), addr, IR_NONE);
+            ir_insts[field_addr].int_val = (i64)field->offset;
+            ir_lower_init_into(field_addr, field->type, expr->compound.args[i]);
+        }
+    }
+    else if (type->kind == TypeKind::ARRAY) {
+        if (num_args < type->array.size) {
+            IrValue zero = ir_emit(IrOp::ZERO, nullptr, addr, IR_NONE);
+            ir_insts[zero].int_val = (i64)type->size;
+        }
+        IrValue base = ir_emit(IrOp::CONVERT, type_ptr(type->array.base), addr, IR_NONE);
+        for (size_t i = 0; i < num_args; i++) {
+            IrValue elem_addr = ir_emit(IrOp::ELEM_ADDR, ir_type(base), base, ir_const_int(Global::type_int, (i64)i));
+            ir_lower_init_into(elem_addr, type->array.base, expr->compound.args[i]);
+        }
+    }
+    else {
+        ir_lower_init_into(addr, type, expr->compound.args[0]);
+    }
+}
+
+Internal IrOp ir_binary_op(TokenKind op) {
+    switch (op) {
+        case TokenKind::ADD: {
+            return IrOp::ADD;
+        }
+        case TokenKind::SUB: {
+            return IrOp::SUB;
+        }
+        case TokenKind::MUL: {
+            return IrOp::MUL;
+        }
+        case TokenKind::DIV: {
+            return IrOp::DIV;
+        }
+        case TokenKind::MOD: {
+            return IrOp::MOD;
+        }
+        case TokenKind::AND: {
+            return IrOp::AND;
+        }
+        case TokenKind::OR: {
+            return IrOp::OR;
+        }
+        case TokenKind::XOR: {
+            return IrOp::XOR;
+        }
+        case TokenKind::LSHIFT: {
+            return IrOp::SHL;
+        }
+        case TokenKind::RSHIFT: {
+            return IrOp::SHR;
+        }
+        case TokenKind::EQ: {
+            return IrOp::EQ;
+        }
+        case TokenKind::NOTEQ: {
+            return IrOp::NE;
+        }
+        case TokenKind::LT: {
+            return IrOp::LT;
+        }
+        case TokenKind::LTEQ: {
+            return IrOp::LE;
+        }
+        case TokenKind::GT: {
+            return IrOp::GT;
+        }
+        case TokenKind::GTEQ: {
+            return IrOp::GE;
+        }
+        default: {
+            assert(false);
+            return IrOp::NOP;
+        }
+    }
+}
+
+//*the assignment operators map onto their binary operators
+Internal TokenKind ir_assign_binary_op(TokenKind op) {
+    switch (op) {
+        case TokenKind::ADD_ASSIGN: {
+            return TokenKind::ADD;
+        }
+        case TokenKind::SUB_ASSIGN: {
+            return TokenKind::SUB;
+        }
+        case TokenKind::OR_ASSIGN: {
+            return TokenKind::OR;
+        }
+        case TokenKind::AND_ASSIGN: {
+            return TokenKind::AND;
+        }
+        case TokenKind::XOR_ASSIGN: {
+            return TokenKind::XOR;
+        }
+        case TokenKind::LSHIFT_ASSIGN: {
+            return TokenKind::LSHIFT;
+        }
+        case TokenKind::RSHIFT_ASSIGN: {
+            return TokenKind::RSHIFT;
+        }
+        case TokenKind::MUL_ASSIGN: {
+            return TokenKind::MUL;
+        }
+        case TokenKind::DIV_ASSIGN: {
+            return TokenKind::DIV;
+        }
+        case TokenKind::MOD_ASSIGN: {
+            return TokenKind::MOD;
+        }
+        default: {
+            assert(false);
+            return TokenKind::ADD;
+        }
+    }
+}
+
+//*applies a binary operator to values of any operand types, with C's conversions. type is the result type for
+//*arithmetic and pointer operators
+Internal IrValue ir_lower_binary_op(TokenKind op, IrValue left, IrValue right, Type* type) {
+    Type* left_type = ir_type(left);
+    Type* right_type = ir_type(right);
+    bool is_arithmetic = is_arithmetic_type(left_type) && is_arithmetic_type(right_type);
+    switch (op) {
+        case TokenKind::LSHIFT:
+        case TokenKind::RSHIFT: {
+            right = ir_convert(right, type_promote(right_type));
+            return ir_emit(ir_binary_op(op), type, ir_convert(left, type), right);
+        }
+        case TokenKind::ADD:
+        case TokenKind::SUB: {
+            if (is_arithmetic) {
+                break;
+            }
+            if (op == TokenKind::SUB && right_type->kind == TypeKind::PTR) {
+                //*pointer difference in elements
+                IrValue diff = ir_emit(IrOp::SUB, type, ir_convert(left, type), ir_convert(right, type));
+                size_t size = left_type->ptr.base->size ? left_type->ptr.base->size : 1;
+                return ir_emit(IrOp::DIV, type, diff, ir_const_int(type, (i64)size));
+            }
+            if (left_type->kind != TypeKind::PTR) {
+                std::swap(left, right);
+                std::swap(left_type, right_type);
+            }
+            if (op == TokenKind::SUB) {
+                right = ir_emit(IrOp::NEG, Global::type_ssize, ir_convert(right, Global::type_ssize), IR_NONE);
+            }
+            return ir_emit(IrOp::ELEM_ADDR, left_type, left, right);
+        }
+        case TokenKind::EQ:
+        case TokenKind::NOTEQ:
+        case TokenKind::LT:
+        case TokenKind::GT:
+        case TokenKind::LTEQ:
+        case TokenKind::GTEQ: {
+            Type* operand_type = is_arithmetic ? type_unify(left_type, right_type) : left_type->kind == TypeKind::PTR ? left_type : right_type;
+            return ir_emit(ir_binary_op(op), Global::type_int, ir_convert(left, operand_type), ir_convert(right, operand_type));
+        }
+        default: {
+            break;
+        }
+    }
+
+    return ir_emit(ir_binary_op(op), type, ir_convert(left, type), ir_convert(right, type));
+}
+
+//*scalar to int 0 or 1
+Internal IrValue ir_lower_bool(IrValue value) {
+    return ir_emit(IrOp::NE, Global::type_int, value, ir_zero(ir_type(value)));
+}
+
+//*a phi over the preds of the current block, which must be sealed, taking value where the pred is from and other
+//*everywhere else
+Internal IrValue ir_join(Type* type, u32 from, IrValue value, IrValue other) {
+    const std::vector<u32>& preds = ir_blocks[ir_current].preds;
+    size_t vals_start = ir_read_vals.size();
+    for (u32 pred : preds) {
+        ir_read_vals.push_back(pred == from ? value : other);
+    }
+
+    IrValue phi = ir_new_phi(ir_current, type);
+    IrValue result = ir_finish_phi(phi, ir_read_vals.data() + vals_start, ir_read_vals.size() - vals_start);
+    ir_read_vals.resize(vals_start);
+    return result;
+}
+
+Internal IrValue ir_lower_logical(Expr* expr) {
+    bool is_and = expr->binary.op == TokenKind::AND_AND;
+    u32 right_block = ir_new_block();
+    u32 end = ir_new_block();
+
+    //*the short circuit result is known before the branch
+    IrValue short_circuit = ir_emit_front(IrOp::CONST_INT, Global::type_int);
+    ir_insts[short_circuit].int_val = is_and ? 0 : 1;
+    if (is_and) {
+        ir_lower_cond(expr->binary.left, right_block, end);
+    }
+    else {
+        ir_lower_cond(expr->binary.left, end, right_block);
+    }
+
+    ir_seal_block(right_block);
+    ir_start_block(right_block);
+    IrValue right = ir_lower_bool(ir_lower_rvalue(expr->binary.right));
+    u32 right_end = ir_current;
+    ir_jump(end);
+    ir_seal_block(end);
+    ir_start_block(end);
+    return ir_join(Global::type_int, right_end, right, short_circuit);
+}
+
+Internal IrValue ir_lower_ternary(Expr* expr) {
+    Type* type = expr_type(expr);
+    u32 then_block = ir_new_block();
+    u32 else_block = ir_new_block();
+    u32 end = ir_new_block();
+    ir_lower_cond(expr->ternary.cond, then_block, else_block);
+    ir_seal_block(then_block);
+    ir_seal_block(else_block);
+
+    ir_start_block(then_block);
+    IrValue then_value = ir_convert(ir_lower_rvalue(expr->ternary.then_expr), type);
+    u32 then_end = ir_current;
+    ir_jump(end);
+
+    ir_start_block(else_block);
+    IrValue else_value = ir_convert(ir_lower_rvalue(expr->ternary.else_expr), type);
+    ir_jump(end);
+
+    ir_seal_block(end);
+    ir_start_block(end);
+    return ir_join(type, then_end, then_value, else_value);
+}
+
+Internal IrValue ir_lower_call(Expr* expr) {
+    IrValue callee = ir_lower_rvalue(expr->call.expr);
+    Type* type = ir_type(callee);
+    if (type->kind == TypeKind::PTR) {
+        type = type->ptr.base;
+    }
+
+    std::vector<IrValue> args;
+    for (size_t i = 0; i < expr->call.num_args; i++) {
+        args.push_back(ir_convert(ir_lower_rvalue(expr->call.args[i]), type->func.params[i]));
+    }
+
+    IrValue call = ir_emit(IrOp::CALL, type->func.ret, callee, IR_NONE);
+    ir_insts[call].operands.first = (u32)ir_operands.size();
+    ir_insts[call].operands.count = (u32)args.size();
+    ir_operands.insert(ir_operands.end(), args.begin(), args.end());
+    return call;
+}
+
+Internal IrValue ir_lower_name(Expr* expr) {
+    Sym* sym = expr_sym(expr);
+    switch (sym->kind) {
+        case SymKind::CONST: {
+            return is_floating_type(sym->type) ? ir_const_float(sym->type, sym->float_val) : ir_const_int(sym->type, sym->int_val);
+        }
+        case SymKind::ENUM_CONST: {
+            return ir_const_int(sym->type, sym->int_val);
+        }
+        case SymKind::FUNC: {
+            IrValue func = ir_emit(IrOp::GLOBAL, sym->type, IR_NONE, IR_NONE);
+            ir_insts[func].sym = sym;
+            return func;
+        }
+        default: {
+            auto var = ir_vars.find(sym);
+            if (var != ir_vars.end()) {
+                return ir_read_var(var->second, ir_current);
+            }
+            return ir_load(ir_lower_addr(expr), sym->type);
+        }
+    }
+}
+
+//*value of an expression after array decay
+Internal IrValue ir_lower_rvalue(Expr* expr) {
+    Type* type = expr_type(expr);
+    switch (expr->kind) {
+        case ExprKind::INT: {
+            return ir_const_int(type, expr->int_val);
+        }
+        case ExprKind::FLOAT: {
+            return ir_const_float(type, expr->float_val);
+        }
+        case ExprKind::STR: {
+            IrValue str = ir_emit(IrOp::STR, type, IR_NONE, IR_NONE);
+            ir_insts[str].str = expr->str_val;
+            return str;
+        }
+        case ExprKind::NAME: {
+            return ir_lower_name(expr);
+        }
+        case ExprKind::CAST: {
+            return ir_convert(ir_lower_rvalue(expr->cast.expr), type);
+        }
+        case ExprKind::CALL: {
+            auto val = Global::const_call_vals.find(expr->id);
+            if (val != Global::const_call_vals.end() && is_arithmetic_type(type)) {
+                ResolvedExpr resolved = ctfe_scalar(type, val->second.data());
+                return is_floating_type(type) ? ir_const_float(type, resolved.float_val) : ir_const_int(type, resolved.int_val);
+            }
+            return ir_lower_call(expr);
+        }
+        case ExprKind::INDEX:
+        case ExprKind::FIELD: {
+            return ir_load(ir_lower_addr(expr), type);
+        }
+        case ExprKind::COMPOUND: {
+            if (ir_is_register_type(type)) {
+                return ir_convert(ir_lower_rvalue(expr->compound.args[0]), type);
+            }
+            return ir_load(ir_lower_compound_slot(expr), type);
+        }
+        case ExprKind::UNARY: {
+            switch (expr->unary.op) {
+                case TokenKind::AND: {
+                    return ir_lower_addr(expr->unary.expr);
+                }
+                case TokenKind::MUL: {
+                    return ir_load(ir_lower_rvalue(expr->unary.expr), type);
+                }
+                case TokenKind::SUB: {
+                    return ir_emit(IrOp::NEG, type, ir_convert(ir_lower_rvalue(expr->unary.expr), type), IR_NONE);
+                }
+                default: {
+                    return ir_convert(ir_lower_rvalue(expr->unary.expr), type);
+                }
+            }
+        }
+        case ExprKind::BINARY: {
+            if (expr->binary.op == TokenKind::AND_AND || expr->binary.op == TokenKind::OR_OR) {
+                return ir_lower_logical(expr);
+            }
+            IrValue left = ir_lower_rvalue(expr->binary.left);
+            IrValue right = ir_lower_rvalue(expr->binary.right);
+            return ir_lower_binary_op(expr->binary.op, left, right, type);
+        }
+        case ExprKind::TERNARY: {
+            return ir_lower_ternary(expr);
+        }
+        case ExprKind::SIZEOF_EXPR: {
+            return ir_const_int(type, (i64)expr_type(expr->sizeof_expr)->size);
+        }
+        case ExprKind::SIZEOF_TYPE: {
+            return ir_const_int(type, (i64)typespec_type(expr->sizeof_type)->size);
+        }
+        default: {
+            assert(false);
+            return IR_NONE;
+        }
+    }
+}
+
+//*&& and || in conditions are only branches
+Internal void ir_lower_cond(Expr* expr, u32 then_block, u32 else_block) {
+    if (expr->kind == ExprKind::BINARY && (expr->binary.op == TokenKind::AND_AND || expr->binary.op == TokenKind::OR_OR)) {
+        u32 right_block = ir_new_block();
+        if (expr->binary.op == TokenKind::AND_AND) {
+            ir_lower_cond(expr->binary.left, right_block, else_block);
+        }
+        else {
+            ir_lower_cond(expr->binary.left, then_block, right_block);
+        }
+        ir_seal_block(right_block);
+        ir_start_block(right_block);
+        ir_lower_cond(expr->binary.right, then_block, else_block);
+        return;
+    }
+
+    IrValue cond = ir_lower_rvalue(expr);
+    if (!is_integer_type(ir_type(cond))) {
+        cond = ir_lower_bool(cond);
+    }
+    ir_branch(cond, then_block, else_block);
+}
+
+//*statements
+
+//*where an assignment reads and writes, a variable or an address
+struct IrLvalue {
+    u32 var;
+    IrValue addr;
+    Type* type;
+};
+
+Internal IrLvalue ir_lower_lvalue(Expr* expr) {
+    IrLvalue lvalue = { IR_NO_BLOCK, IR_NONE, expr_type(expr) };
+    if (expr->kind == ExprKind::NAME) {
+        auto var = ir_vars.find(expr_sym(expr));
+        if (var != ir_vars.end()) {
+            lvalue.var = var->second;
+            return lvalue;
+        }
+    }
+
+    lvalue.addr = ir_lower_addr(expr);
+    return lvalue;
+}
+
+Internal IrValue ir_read_lvalue(IrLvalue lvalue) {
+    return lvalue.addr ? ir_emit(IrOp::LOAD, lvalue.type, lvalue.addr, IR_NONE) : ir_read_var(lvalue.var, ir_current);
+}
+
+Internal void ir_write_lvalue(IrLvalue lvalue, IrValue value) {
+    value = ir_convert(value, lvalue.type);
+    if (lvalue.addr) {
+        ir_emit(IrOp::STORE, nullptr, lvalue.addr, value);
+    }
+    else {
+        ir_write_var(lvalue.var, ir_current, value);
+    }
+}
+
+Internal void ir_lower_assign(Stmt* stmt) {
+    TokenKind op = stmt->assign.op;
+    IrLvalue left = ir_lower_lvalue(stmt->assign.left);
+    if (op == TokenKind::ASSIGN) {
+        ir_write_lvalue(left, ir_lower_rvalue(stmt->assign.right));
+        return;
+    }
+
+    IrValue value = ir_read_lvalue(left);
+    if (op == TokenKind::INC || op == TokenKind::DEC) {
+        TokenKind binary_op = op == TokenKind::INC ? TokenKind::ADD : TokenKind::SUB;
+        Type* type = left.type->kind == TypeKind::PTR ? left.type : type_promote(left.type);
+        IrValue one = is_floating_type(type) ? ir_const_float(type, 1) : ir_const_int(Global::type_int, 1);
+        ir_write_lvalue(left, ir_lower_binary_op(binary_op, value, one, type));
+        return;
+    }
+
+    TokenKind binary_op = ir_assign_binary_op(op);
+    IrValue right = ir_lower_rvalue(stmt->assign.right);
+    Type* right_type = ir_type(right);
+    Type* type = left.type;
+    if (binary_op == TokenKind::LSHIFT || binary_op == TokenKind::RSHIFT) {
+        type = type_promote(left.type);
+    }
+    else if (is_arithmetic_type(left.type)) {
+        type = type_unify(left.type, right_type);
+    }
+    ir_write_lvalue(left, ir_lower_binary_op(binary_op, value, right, type));
+}
+
+//*scalars whose address is never taken are SSA variables, everything else gets a stack slot
+Internal void ir_declare_local(Sym* sym, Expr* init) {
+    Type* type = sym->type;
+    if (ir_is_register_type(type) && !ir_addr_taken.count(sym)) {
+        IrValue value = init ? ir_convert(ir_lower_rvalue(init), type) : ir_zero(type);
+        u32 var = (u32)ir_var_types.size();
+        ir_var_types.push_back(type->id);
+        ir_vars[sym] = var;
+        ir_write_var(var, ir_current, value);
+        return;
+    }
+
+    IrValue slot = ir_alloca(type);
+    if (init) {
+        ir_lower_init_into(slot, type, init);
+    }
+    else {
+        IrValue zero = ir_emit(IrOp::ZERO, nullptr, slot, IR_NONE);
+        ir_insts[zero].int_val = (i64)type->size;
+    }
+    ir_slots[sym] = slot;
+}
+
+Internal void ir_lower_stmt(Stmt* stmt);
+
+Internal void ir_lower_block(StmtBlock block) {
+    for (size_t i = 0; i < block.num_stmts; i++) {
+        ir_lower_stmt(block.stmts[i]);
+    }
+}
+
+Internal void ir_lower_loop_body(StmtBlock block, u32 break_block, u32 continue_block) {
+    ir_jump_targets.push_back(IrJumpTargets{ break_block, continue_block });
+    ir_lower_block(block);
+    ir_jump_targets.pop_back();
+}
+
+Internal void ir_lower_if(Stmt* stmt) {
+    u32 end = ir_new_block();
+    for (size_t i = 0; i <= stmt->if_stmt.num_elseifs; i++) {
+        Expr* cond = i == 0 ? stmt->if_stmt.cond : stmt->if_stmt.elseifs[i - 1].cond;
+        StmtBlock block = i == 0 ? stmt->if_stmt.then_block : stmt->if_stmt.elseifs[i - 1].block;
+        u32 then_block = ir_new_block();
+        u32 next = ir_new_block();
+        ir_lower_cond(cond, then_block, next);
+        ir_seal_block(then_block);
+        ir_seal_block(next);
+
+        ir_start_block(then_block);
+        ir_lower_block(block);
+        ir_jump(end);
+        ir_start_block(next);
+    }
+
+    ir_lower_block(stmt->if_stmt.else_block);
+    ir_jump(end);
+    ir_seal_block(end);
+    ir_start_block(end);
+}
+
+//*case labels are tested in order, the C backend is where switches get planned
+Internal void ir_lower_switch(Stmt* stmt) {
+    Type* type = type_promote(expr_type(stmt->switch_stmt.expr));
+    IrValue value = ir_convert(ir_lower_rvalue(stmt->switch_stmt.expr), type);
+    u32 end = ir_new_block();
+    u32 default_block = end;
+    std::vector<u32> case_blocks;
+    for (size_t i = 0; i < stmt->switch_stmt.num_cases; i++) {
+        case_blocks.push_back(ir_new_block());
+        if (stmt->switch_stmt.cases[i].is_default) {
+            default_block = case_blocks.back();
+        }
+    }
+
+    for (size_t i = 0; i < stmt->switch_stmt.num_cases; i++) {
+        SwitchCase* it = stmt->switch_stmt.cases + i;
+        for (size_t j = 0; j < it->num_exprs; j++) {
+            IrValue label = ir_const_int(type, case_val(it->exprs[j]));
+            IrValue eq = ir_emit(IrOp::EQ, Global::type_int, value, label);
+            u32 next = ir_new_block();
+            ir_branch(eq, case_blocks[i], next);
+            ir_seal_block(next);
+            ir_start_block(next);
+        }
+    }
+    ir_jump(default_block);
+
+    u32 continue_block = ir_jump_targets.empty() ? IR_NO_BLOCK : ir_jump_targets.back().continue_block;
+    for (size_t i = 0; i < stmt->switch_stmt.num_cases; i++) {
+        ir_seal_block(case_blocks[i]);
+        ir_start_block(case_blocks[i]);
+        ir_lower_loop_body(stmt->switch_stmt.cases[i].block, end, continue_block);
+        ir_jump(end);
+    }
+
+    ir_seal_block(end);
+    ir_start_block(end);
+}
+
+Internal void ir_lower_stmt(Stmt* stmt) {
+    switch (stmt->kind) {
+        case StmtKind::RETURN: {
+            IrValue value = stmt->expr ? ir_convert(ir_lower_rvalue(stmt->expr), ir_ret_type) : IR_NONE;
+            ir_emit(IrOp::RETURN, nullptr, value, IR_NONE);
+            ir_blocks[ir_current].terminated = true;
+            ir_start_unreachable();
+            break;
+        }
+        case StmtKind::BREAK: {
+            ir_jump(ir_jump_targets.back().break_block);
+            ir_start_unreachable();
+            break;
+        }
+        case StmtKind::CONTINUE: {
+            ir_jump(ir_jump_targets.back().continue_block);
+            ir_start_unreachable();
+            break;
+        }
+        case StmtKind::BLOCK: {
+            ir_lower_block(stmt->block);
+            break;
+        }
+        case StmtKind::IF: {
+            ir_lower_if(stmt);
+            break;
+        }
+        case StmtKind::WHILE: {
+            u32 header = ir_new_block();
+            u32 body = ir_new_block();
+            u32 exit = ir_new_block();
+            ir_jump(header);
+            ir_start_block(header);
+            ir_lower_cond(stmt->while_stmt.cond, body, exit);
+            ir_seal_block(body);
+            ir_start_block(body);
+            ir_lower_loop_body(stmt->while_stmt.block, exit, header);
+            ir_jump(header);
+            ir_seal_block(header);
+            ir_seal_block(exit);
+            ir_start_block(exit);
+            break;
+        }
+        case StmtKind::DO_WHILE: {
+            u32 body = ir_new_block();
+            u32 cond = ir_new_block();
+            u32 exit = ir_new_block();
+            ir_jump(body);
+            ir_start_block(body);
+            ir_lower_loop_body(stmt->while_stmt.block, exit, cond);
+            ir_jump(cond);
+            ir_seal_block(cond);
+            ir_start_block(cond);
+            ir_lower_cond(stmt->while_stmt.cond, body, exit);
+            ir_seal_block(body);
+            ir_seal_block(exit);
+            ir_start_block(exit);
+            break;
+        }
+        case StmtKind::FOR: {
+            if (stmt->for_stmt.init) {
+                ir_lower_stmt(stmt->for_stmt.init);
+            }
+            u32 header = ir_new_block();
+            u32 body = ir_new_block();
+            u32 next = ir_new_block();
+            u32 exit = ir_new_block();
+            ir_jump(header);
+            ir_start_block(header);
+            if (stmt->for_stmt.cond) {
+                ir_lower_cond(stmt->for_stmt.cond, body, exit);
+            }
+            else {
+                ir_jump(body);
+            }
+            ir_seal_block(body);
+            ir_start_block(body);
+            ir_lower_loop_body(stmt->for_stmt.block, exit, next);
+            ir_jump(next);
+            ir_seal_block(next);
+            ir_start_block(next);
+            if (stmt->for_stmt.next) {
+                ir_lower_stmt(stmt->for_stmt.next);
+            }
+            ir_jump(header);
+            ir_seal_block(header);
+            ir_seal_block(exit);
+            ir_start_block(exit);
+            break;
+        }
+        case StmtKind::SWITCH: {
+            ir_lower_switch(stmt);
+            break;
+        }
+        case StmtKind::ASSIGN: {
+            ir_lower_assign(stmt);
+            break;
+        }
+        case StmtKind::INIT: {
+            ir_declare_local(local_decl_sym(stmt), stmt->init.expr);
+            break;
+        }
+        case StmtKind::DECL: {
+            if (stmt->decl->kind == DeclKind::VAR) {
+                ir_declare_local(local_decl_sym(stmt->decl), stmt->decl->var.expr);
+            }
+            break;
+        }
+        case StmtKind::EXPR: {
+            ir_lower_rvalue(stmt->expr);
+            break;
+        }
+        default: {
+            assert(false);
+            break;
+        }
+    }
+}
+
+Internal bool ir_find_addr_taken(void* ctx, AstNode node) {
+    if (node.kind == AstNodeKind::EXPR && node.expr->kind == ExprKind::UNARY && node.expr->unary.op == TokenKind::AND) {
+        Expr* operand = node.expr->unary.expr;
+        if (operand->kind == ExprKind::NAME && expr_sym(operand)->kind == SymKind::VAR) {
+            ir_addr_taken.insert(expr_sym(operand));
+        }
+    }
+    return true;
+}
+
+//*finishing. blocks nothing reaches are dropped with the phi operands that came from them, phis that turned out
+//*trivial are replaced, and what is left is renumbered block by block in reverse postorder
+
+GlobalVariable std::vector<u32> ir_block_order;
+GlobalVariable std::vector<u32> ir_block_index;
+GlobalVariable std::vector<IrValue> ir_value_index;
+
+Internal IrInst* ir_build_terminator(u32 block) {
+    assert(ir_blocks[block].terminated);
+    return &ir_insts[ir_blocks[block].insts.back()];
+}
+
+//*reverse postorder from the entry, a block's first successor comes first
+Internal void ir_order_blocks() {
+    ir_block_order.clear();
+    ir_block_index.assign(ir_num_blocks, IR_NO_BLOCK);
+    std::vector<std::pair<u32, u32>> stack;
+    stack.push_back(std::make_pair(0u, 0u));
+    ir_block_index[0] = 0;
+    while (!stack.empty()) {
+        u32 block = stack.back().first;
+        IrInst* term = ir_build_terminator(block);
+        u32 num_succs = term->op == IrOp::BRANCH ? 2 : term->op == IrOp::JUMP ? 1 : 0;
+        u32 next = stack.back().second++;
+        if (next == num_succs) {
+            ir_block_order.push_back(block);
+            stack.pop_back();
+            continue;
+        }
+
+        u32 succ = term->targets[num_succs - 1 - next];
+        if (ir_block_index[succ] == IR_NO_BLOCK) {
+            ir_block_index[succ] = 0;
+            stack.push_back(std::make_pair(succ, 0u));
+        }
+    }
+
+    std::reverse(ir_block_order.begin(), ir_block_order.end());
+    for (u32 i = 0; i < ir_block_order.size(); i++) {
+        ir_block_index[ir_block_order[i]] = i;
+    }
+}
+
+Internal void ir_drop_unreachable_preds() {
+    for (u32 block : ir_block_order) {
+        IrBuildBlock* it = &ir_blocks[block];
+        for (IrValue phi : it->phis) {
+            IrInst* inst = &ir_insts[phi];
+            if (inst->op != IrOp::PHI) {
+                continue;
+            }
+            u32 count = 0;
+            for (u32 i = 0; i < it->preds.size(); i++) {
+                if (ir_block_index[it->preds[i]] != IR_NO_BLOCK) {
+                    ir_operands[inst->operands.first + count++] = ir_operands[inst->operands.first + i];
+                }
+            }
+            inst->operands.count = count;
+        }
+
+        size_t count = 0;
+        for (u32 pred : it->preds) {
+            if (ir_block_index[pred] != IR_NO_BLOCK) {
+                it->preds[count++] = pred;
+            }
+        }
+        it->preds.resize(count);
+    }
+}
+
+Internal void ir_remove_trivial_phis() {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (u32 block : ir_block_order) {
+            for (IrValue phi : ir_blocks[block].phis) {
+                if (ir_insts[phi].op == IrOp::PHI && ir_try_remove_trivial_phi(phi) != phi) {
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+template <typename T>
+Internal T* ir_arena_array(const T* src, size_t count) {
+    T* dest = (T*)Global::ir_arena.alloc(count * sizeof(T));
+    if (count) {
+        memcpy(dest, src, count * sizeof(T));
+    }
+    return dest;
+}
+
+Internal IrFunc* ir_alloc_func(Sym* sym, const std::vector<IrInst>& insts, const std::vector<IrBlock>& blocks, const std::vector<u32>& preds,
+                               const std::vector<IrValue>& operands) {
+    IrFunc* func = (IrFunc*)Global::ir_arena.alloc(sizeof(IrFunc));
+    func->sym = sym;
+    func->insts = ir_arena_array(insts.data(), insts.size());
+    func->num_insts = (u32)insts.size();
+    func->blocks = ir_arena_array(blocks.data(), blocks.size());
+    func->num_blocks = (u32)blocks.size();
+    func->preds = ir_arena_array(preds.data(), preds.size());
+    func->num_preds = (u32)preds.size();
+    func->operands = ir_arena_array(operands.data(), operands.size());
+    func->num_operands = (u32)operands.size();
+    return func;
+}
+
+Internal void ir_number_value(IrValue value, std::vector<IrValue>* order) {
+    if (ir_insts[value].op != IrOp::NOP) {
+        ir_value_index[value] = (IrValue)order->size() + 1;
+        order->push_back(value);
+    }
+}
+
+Internal IrValue ir_renumber(IrValue value) {
+    if (!value) {
+        return IR_NONE;
+    }
+    IrValue index = ir_value_index[ir_resolve(value)];
+    assert(index);
+    return index;
+}
+
+Internal IrFunc* ir_finish_func(Sym* sym) {
+    ir_order_blocks();
+    ir_drop_unreachable_preds();
+    ir_remove_trivial_phis();
+
+    std::vector<IrValue> order;
+    ir_value_index.assign(ir_insts.size(), IR_NONE);
+    std::vector<IrBlock> blocks;
+    std::vector<u32> preds;
+    for (u32 block : ir_block_order) {
+        IrBuildBlock* it = &ir_blocks[block];
+        IrBlock out = {};
+        out.first = (u32)order.size() + 1;
+        out.first_pred = (u32)preds.size();
+        out.num_preds = (u32)it->preds.size();
+        for (u32 pred : it->preds) {
+            preds.push_back(ir_block_index[pred]);
+        }
+        for (IrValue phi : it->phis) {
+            ir_number_value(phi, &order);
+        }
+        if (block == 0) {
+            for (IrValue value : ir_entry_front) {
+                ir_number_value(value, &order);
+            }
+        }
+        for (IrValue value : it->insts) {
+            ir_number_value(value, &order);
+        }
+        out.num_insts = (u32)order.size() + 1 - out.first;
+        blocks.push_back(out);
+    }
+
+    std::vector<IrInst> insts(1, IrInst{});
+    std::vector<IrValue> operands;
+    for (IrValue value : order) {
+        IrInst inst = ir_insts[value];
+        inst.args[0] = ir_renumber(inst.args[0]);
+        inst.args[1] = ir_renumber(inst.args[1]);
+        if (inst.op == IrOp::PHI || inst.op == IrOp::CALL) {
+            u32 first = (u32)operands.size();
+            for (u32 i = inst.operands.first; i < inst.operands.first + inst.operands.count; i++) {
+                operands.push_back(ir_renumber(ir_operands[i]));
+            }
+            inst.operands.first = first;
+        }
+        else if (inst.op == IrOp::JUMP || inst.op == IrOp::BRANCH) {
+            inst.targets[0] = ir_block_index[inst.targets[0]];
+            if (inst.op == IrOp::BRANCH) {
+                inst.targets[1] = ir_block_index[inst.targets[1]];
+            }
+        }
+        insts.push_back(inst);
+    }
+
+    return ir_alloc_func(sym, insts, blocks, preds, operands);
+}
+
+Internal void ir_reset_func(Sym* sym) {
+    ir_insts.assign(1, IrInst{});
+    ir_operands.clear();
+    ir_num_blocks = 0;
+    ir_entry_front.clear();
+    ir_replaced.clear();
+    ir_vars.clear();
+    ir_var_types.clear();
+    ir_slots.clear();
+    ir_addr_taken.clear();
+    ir_defs.clear();
+    ir_ret_type = sym->type->func.ret;
+}
+
+IrFunc* ir_lower_func(Sym* sym) {
+    Decl* decl = sym->decl;
+    StmtBlock body = materialize_func_body(decl);
+    ir_reset_func(sym);
+
+    AstVisitor visitor = { nullptr, ir_find_addr_taken, nullptr };
+    for (size_t i = 0; i < body.num_stmts; i++) {
+        ast_walk(&visitor, ast_node(body.stmts[i]));
+    }
+
+    u32 entry = ir_new_block();
+    ir_seal_block(entry);
+    ir_current = entry;
+    for (size_t i = 0; i < decl->func.num_params; i++) {
+        IrValue param = ir_emit(IrOp::PARAM, sym->type->func.params[i], IR_NONE, IR_NONE);
+        ir_insts[param].int_val = (i64)i;
+        Sym* param_sym = local_decl_sym(decl->func.params + i);
+        if (!ir_is_register_type(param_sym->type) || ir_addr_taken.count(param_sym)) {
+            IrValue slot = ir_alloca(param_sym->type);
+            ir_emit(IrOp::STORE, nullptr, slot, param);
+            ir_slots[param_sym] = slot;
+        }
+        else {
+            u32 var = (u32)ir_var_types.size();
+            ir_var_types.push_back(param_sym->type->id);
+            ir_vars[param_sym] = var;
+            ir_write_var(var, entry, param);
+        }
+    }
+
+    ir_lower_block(body);
+    if (!ir_blocks[ir_current].terminated) {
+        IrValue value = ir_ret_type->kind == TypeKind::VOID ? IR_NONE : ir_emit(IrOp::UNDEF, ir_ret_type, IR_NONE, IR_NONE);
+        ir_emit(IrOp::RETURN, nullptr, value, IR_NONE);
+        ir_blocks[ir_current].terminated = true;
+    }
+
+    return ir_finish_func(sym);
+}
+
+IrFunc* ir_lower_global_init(Sym* sym) {
+    ir_reset_func(sym);
+    u32 entry = ir_new_block();
+    ir_seal_block(entry);
+    ir_current = entry;
+    for (Sym* it : Global::ordered_syms) {
+        if (it->kind == SymKind::VAR && it->decl && it->decl->var.expr) {
+            IrValue global = ir_emit(IrOp::GLOBAL, type_ptr(it->type), IR_NONE, IR_NONE);
+            ir_insts[global].sym = it;
+            ir_lower_init_into(global, it->type, it->decl->var.expr);
+        }
+    }
+    ir_emit(IrOp::RETURN, nullptr, IR_NONE, IR_NONE);
+    ir_blocks[ir_current].terminated = true;
+    return ir_finish_func(sym);
+}
+
+void ir_lower_package() {
+    Global::ir_arena.free_all();
+    Global::ir_funcs.clear();
+    for (Sym* it : Global::syms) {
+        if (it->kind == SymKind::FUNC) {
+            Global::ir_funcs.push_back(ir_lower_func(it));
+        }
+    }
+}
+
+void ir_edit_open(IrEdit* edit, IrFunc* func) {
+    edit->sym = func->sym;
+    edit->insts.assign(func->insts, func->insts + func->num_insts);
+    edit->operands.assign(func->operands, func->operands + func->num_operands);
+    edit->replace.assign(func->num_insts, IR_NONE);
+    edit->blocks.resize(func->num_blocks);
+    for (u32 b = 0; b < func->num_blocks; b++) {
+        IrBlock* it = func->blocks + b;
+        IrEditBlock* out = &edit->blocks[b];
+        out->insts.clear();
+        for (IrValue v = it->first; v < it->first + it->num_insts; v++) {
+            out->insts.push_back(v);
+        }
+        out->preds.assign(func->preds + it->first_pred, func->preds + it->first_pred + it->num_preds);
+    }
+}
+
+IrValue ir_edit_add(IrEdit* edit, const IrInst& inst) {
+    edit->insts.push_back(inst);
+    edit->replace.push_back(IR_NONE);
+    return (IrValue)edit->insts.size() - 1;
+}
+
+u32 ir_edit_add_block(IrEdit* edit) {
+    edit->blocks.push_back(IrEditBlock());
+    return (u32)edit->blocks.size() - 1;
+}
+
+void ir_edit_set_operands(IrEdit* edit, IrValue value, const std::vector<IrValue>& operands) {
+    IrInst* inst = &edit->insts[value];
+    inst->operands.first = (u32)edit->operands.size();
+    inst->operands.count = (u32)operands.size();
+    edit->operands.insert(edit->operands.end(), operands.begin(), operands.end());
+}
+
+u32 ir_edit_num_succs(const IrEdit* edit, u32 block) {
+    IrOp op = edit->insts[edit->blocks[block].insts.back()].op;
+    return op == IrOp::BRANCH ? 2 : op == IrOp::JUMP ? 1 : 0;
+}
+
+u32 ir_edit_succ(const IrEdit* edit, u32 block, u32 i) {
+    return edit->insts[edit->blocks[block].insts.back()].targets[i];
+}
+
+Internal IrValue ir_replacement(const std::vector<IrValue>& replace, IrValue value) {
+    while (replace[value]) {
+        value = replace[value];
+    }
+    return value;
+}
+
+IrFunc* ir_edit_finish(IrEdit* edit) {
+    u32 num_blocks = (u32)edit->blocks.size();
+
+    //*reverse postorder of what the terminators still reach, first successors first as in ir_order_blocks
+    std::vector<u32> order;
+    std::vector<u32> index(num_blocks, IR_NO_BLOCK);
+    std::vector<std::pair<u32, u32>> stack;
+    stack.push_back(std::make_pair(0u, 0u));
+    index[0] = 0;
+    while (!stack.empty()) {
+        u32 block = stack.back().first;
+        u32 num_succs = ir_edit_num_succs(edit, block);
+        u32 next = stack.back().second++;
+        if (next == num_succs) {
+            order.push_back(block);
+            stack.pop_back();
+            continue;
+        }
+
+        u32 succ = ir_edit_succ(edit, block, num_succs - 1 - next);
+        if (index[succ] == IR_NO_BLOCK) {
+            index[succ] = 0;
+            stack.push_back(std::make_pair(succ, 0u));
+        }
+    }
+    std::reverse(order.begin(), order.end());
+
+    //*an edge survives as often as the pred's terminator still names the block
+    std::vector<std::vector<u8>> kept_preds(num_blocks);
+    std::vector<u32> num_kept(num_blocks, 0);
+    for (u32 block : order) {
+        const std::vector<u32>& preds = edit->blocks[block].preds;
+        kept_preds[block].assign(preds.size(), 0);
+        for (u32 i = 0; i < preds.size(); i++) {
+            u32 pred = preds[i];
+            if (index[pred] == IR_NO_BLOCK) {
+                continue;
+            }
+            u32 edges = 0;
+            for (u32 j = 0; j < ir_edit_num_succs(edit, pred); j++) {
+                edges += ir_edit_succ(edit, pred, j) == block;
+            }
+            u32 seen = 0;
+            for (u32 j = 0; j < i; j++) {
+                seen += kept_preds[block][j] && preds[j] == pred;
+            }
+            if (seen < edges) {
+                kept_preds[block][i] = 1;
+                num_kept[block]++;
+            }
+        }
+    }
+
+    //*a block whose only pred jumps straight to it is appended to that pred, its phis are their one operand
+    std::vector<IrValue>& replaced = edit->replace;
+    replaced.resize(edit->insts.size(), IR_NONE);
+    std::vector<u8> merged(num_blocks, 0);
+    for (u32 block : order) {
+        IrEditBlock* it = &edit->blocks[block];
+        if (block == 0 || num_kept[block] != 1) {
+            continue;
+        }
+        u32 slot = 0;
+        while (!kept_preds[block][slot]) {
+            slot++;
+        }
+        if (ir_edit_num_succs(edit, it->preds[slot]) != 1) {
+            continue;
+        }
+
+        merged[block] = 1;
+        for (IrValue v : it->insts) {
+            IrInst* inst = &edit->insts[v];
+            if (inst->op == IrOp::PHI) {
+                replaced[v] = edit->operands[inst->operands.first + slot];
+            }
+        }
+    }
+
+    //*the blocks that start a chain are numbered, every block goes by the number of its chain
+    std::vector<u32> heads;
+    for (u32 block : order) {
+        if (!merged[block]) {
+            index[block] = (u32)heads.size();
+            heads.push_back(block);
+        }
+    }
+    for (u32 head : heads) {
+        for (u32 block = head; ir_edit_num_succs(edit, block) == 1 && merged[ir_edit_succ(edit, block, 0)];) {
+            block = ir_edit_succ(edit, block, 0);
+            index[block] = index[head];
+        }
+    }
+
+    std::vector<IrBlock> blocks;
+    std::vector<u32> preds;
+    std::vector<IrValue> values;
+    std::vector<IrValue> value_index(edit->insts.size(), IR_NONE);
+    for (u32 head : heads) {
+        IrEditBlock* it = &edit->blocks[head];
+        IrBlock out = {};
+        out.first_pred = (u32)preds.size();
+        for (u32 i = 0; i < it->preds.size(); i++) {
+            if (kept_preds[head][i]) {
+                preds.push_back(index[it->preds[i]]);
+            }
+        }
+        out.num_preds = (u32)preds.size() - out.first_pred;
+
+        out.first = (u32)values.size() + 1;
+        for (int phis = 1; phis >= 0; phis--) {
+            for (u32 block = head;;) {
+                bool has_next = ir_edit_num_succs(edit, block) == 1 && merged[ir_edit_succ(edit, block, 0)];
+                for (IrValue v : edit->blocks[block].insts) {
+                    IrOp op = edit->insts[v].op;
+                    bool skip = op == IrOp::NOP || (op == IrOp::PHI) != (phis == 1) || (op == IrOp::PHI && block != head) || (op == IrOp::JUMP && has_next);
+                    if (!skip) {
+                        values.push_back(v);
+                        value_index[v] = (IrValue)values.size();
+                    }
+                }
+                if (!has_next) {
+                    break;
+                }
+                block = ir_edit_succ(edit, block, 0);
+            }
+        }
+        out.num_insts = (u32)values.size() + 1 - out.first;
+        blocks.push_back(out);
+    }
+
+    std::vector<IrInst> insts(1, IrInst{});
+    std::vector<IrValue> operands;
+    for (u32 b = 0; b < heads.size(); b++) {
+        for (u32 i = blocks[b].first; i < blocks[b].first + blocks[b].num_insts; i++) {
+            IrInst inst = edit->insts[values[i - 1]];
+            for (u32 j = 0; j < 2; j++) {
+                if (inst.args[j]) {
+                    inst.args[j] = value_index[ir_replacement(replaced, inst.args[j])];
+                    assert(inst.args[j]);
+                }
+            }
+
+            if (inst.op == IrOp::PHI || inst.op == IrOp::CALL) {
+                u32 first = (u32)operands.size();
+                for (u32 j = 0; j < inst.operands.count; j++) {
+                    if (inst.op == IrOp::PHI && !kept_preds[heads[b]][j]) {
+                        continue;
+                    }
+                    IrValue operand = value_index[ir_replacement(replaced, edit->operands[inst.operands.first + j])];
+                    assert(operand);
+                    operands.push_back(operand);
+                }
+                inst.operands.first = first;
+                inst.operands.count = (u32)operands.size() - first;
+            }
+            else if (inst.op == IrOp::JUMP || inst.op == IrOp::BRANCH) {
+                inst.targets[0] = index[inst.targets[0]];
+                if (inst.op == IrOp::BRANCH) {
+                    inst.targets[1] = index[inst.targets[1]];
+                }
+            }
+            insts.push_back(inst);
+        }
+    }
+
+    return ir_alloc_func(edit->sym, insts, blocks, preds, operands);
+}
+
+IrFunc* ir_rebuild(IrFunc* func, const std::vector<IrValue>* replace) {
+    IrEdit edit;
+    ir_edit_open(&edit, func);
+    if (replace) {
+        std::copy(replace->begin(), replace->begin() + std::min(replace->size(), edit.replace.size()), edit.replace.begin());
+    }
+    return ir_edit_finish(&edit);
+}
+
+u32 ir_num_succs(IrFunc* func, u32 block) {
+    IrBlock* it = func->blocks + block;
+    IrOp op = func->insts[it->first + it->num_insts - 1].op;
+    return op == IrOp::BRANCH ? 2 : op == IrOp::JUMP ? 1 : 0;
+}
+
+u32 ir_succ(IrFunc* func, u32 block, u32 i) {
+    IrBlock* it = func->blocks + block;
+    return func->insts[it->first + it->num_insts - 1].targets[i];
+}
+
+//*verifier
+
+Internal bool ir_verify_error(std::string* error, const char* fmt, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    *error = buf;
+    return false;
+}
+
+//*nearest common dominator of two blocks, by walking up whichever is later in reverse postorder
+Internal u32 ir_intersect(const std::vector<u32>& idom, u32 left, u32 right) {
+    while (left != right) {
+        while (left > right) {
+            left = idom[left];
+        }
+        while (right > left) {
+            right = idom[right];
+        }
+    }
+    return left;
+}
+
+//*Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm". blocks are numbered in reverse postorder, so one
+//*forward sweep per round sees most preds before the blocks they reach
+void ir_dominators(IrFunc* func, std::vector<u32>* idom) {
+    idom->assign(func->num_blocks, IR_NO_BLOCK);
+    (*idom)[0] = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (u32 b = 1; b < func->num_blocks; b++) {
+            u32 new_idom = IR_NO_BLOCK;
+            for (u32 i = 0; i < func->blocks[b].num_preds; i++) {
+                u32 pred = func->preds[func->blocks[b].first_pred + i];
+                if ((*idom)[pred] == IR_NO_BLOCK) {
+                    continue;
+                }
+                new_idom = new_idom == IR_NO_BLOCK ? pred : ir_intersect(*idom, pred, new_idom);
+            }
+            if (new_idom != (*idom)[b]) {
+                (*idom)[b] = new_idom;
+                changed = true;
+            }
+        }
+    }
+}
+
+bool ir_dominates(const std::vector<u32>& idom, u32 dom, u32 block) {
+    while (block != dom && block != 0) {
+        block = idom[block];
+    }
+    return block == dom;
+}
+
+//*vectors only meet vectors of as many lanes, except where a splat or reduce_add turns one into the other and where a
+//*load or store reaches one through the scalar address of its first lane
+Internal bool ir_verify_lanes(IrFunc* func, IrValue value, std::string* error) {
+    IrInst* inst = func->insts + value;
+    u8 left = inst->args[0] ? func->insts[inst->args[0]].lanes : 0;
+    u8 right = inst->args[1] ? func->insts[inst->args[1]].lanes : 0;
+    bool ok = true;
+    switch (inst->op) {
+        case IrOp::SPLAT: {
+            ok = !left && inst->lanes > 1 && func->insts[inst->args[0]].type == inst->type;
+            break;
+        }
+        case IrOp::REDUCE_ADD: {
+            ok = left > 1 && !inst->lanes && func->insts[inst->args[0]].type == inst->type;
+            break;
+        }
+        case IrOp::PHI: {
+            for (u32 i = 0; ok && i < inst->operands.count; i++) {
+                ok = func->insts[func->operands[inst->operands.first + i]].lanes == inst->lanes;
+            }
+            break;
+        }
+        case IrOp::LOAD:
+        case IrOp::STORE: {
+            ok = !left;
+            break;
+        }
+        default: {
+            bool is_elementwise = (inst->op >= IrOp::ADD && inst->op <= IrOp::NEG) || inst->op == IrOp::CONVERT;
+            u8 lanes = is_elementwise ? inst->lanes : 0;
+            ok = inst->lanes == lanes && (!inst->args[0] || left == lanes) && (!inst->args[1] || right == lanes);
+            for (u32 i = 0; ok && inst->op == IrOp::CALL && i < inst->operands.count; i++) {
+                ok = !func->insts[func->operands[inst->operands.first + i]].lanes;
+            }
+            break;
+        }
+    }
+
+    if (!ok) {
+        return ir_verify_error(error, "%%%u: lanes of the operands do not fit %s", value, ir_op_names[(int)inst->op]);
+    }
+    return true;
+}
+
+Internal bool ir_verify_types(IrFunc* func, IrValue value, std::string* error) {
+    IrInst* inst = func->insts + value;
+    Type* type = Global::types[inst->type];
+    Type* left = inst->args[0] ? Global::types[func->insts[inst->args[0]].type] : nullptr;
+    Type* right = inst->args[1] ? Global::types[func->insts[inst->args[1]].type] : nullptr;
+    Type* func_type = func->sym->type;
+    bool ok = true;
+    switch (inst->op) {
+        case IrOp::ADD:
+        case IrOp::SUB:
+        case IrOp::MUL:
+        case IrOp::DIV: {
+            ok = is_arithmetic_type(type) && left == type && right == type;
+            break;
+        }
+        case IrOp::MOD:
+        case IrOp::AND:
+        case IrOp::OR:
+        case IrOp::XOR: {
+            ok = is_integer_type(type) && left == type && right == type;
+            break;
+        }
+        case IrOp::SHL:
+        case IrOp::SHR: {
+            ok = is_integer_type(type) && left == type && right && is_integer_type(right);
+            break;
+        }
+        case IrOp::NEG: {
+            ok = is_arithmetic_type(type) && left == type;
+            break;
+        }
+        case IrOp::EQ:
+        case IrOp::NE:
+        case IrOp::LT:
+        case IrOp::LE:
+        case IrOp::GT:
+        case IrOp::GE: {
+            ok = type == Global::type_int && left && left == right && ir_is_register_type(left);
+            break;
+        }
+        case IrOp::CONVERT: {
+            ok = left && ir_is_register_type(type) && (ir_is_register_type(left) || left->kind == TypeKind::PTR);
+            break;
+        }
+        case IrOp::ALLOCA:
+        case IrOp::GLOBAL:
+        case IrOp::STR: {
+            ok = type->kind == TypeKind::PTR || (inst->op == IrOp::GLOBAL && type->kind == TypeKind::FUNC);
+            break;
+        }
+        case IrOp::LOAD: {
+            ok = left && left->kind == TypeKind::PTR && left->ptr.base == type;
+            break;
+        }
+        case IrOp::STORE: {
+            ok = left && right && left->kind == TypeKind::PTR && left->ptr.base == right;
+            break;
+        }
+        case IrOp::ZERO: {
+            ok = left && left->kind == TypeKind::PTR;
+            break;
+        }
+        case IrOp::ELEM_ADDR: {
+            ok = left == type && type->kind == TypeKind::PTR && right && is_integer_type(right);
+            break;
+        }
+        case IrOp::FIELD_ADDR: {
+            ok = left && left->kind == TypeKind::PTR && (left->ptr.base->kind == TypeKind::STRUCT || left->ptr.base->kind == TypeKind::UNION) && type->kind == TypeKind::PTR;
+            break;
+        }
+        case IrOp::PARAM: {
+            ok = inst->int_val >= 0 && (size_t)inst->int_val < func_type->func.num_params && func_type->func.params[inst->int_val] == type;
+            break;
+        }
+        case IrOp::CALL: {
+            Type* callee = left && left->kind == TypeKind::PTR ? left->ptr.base : left;
+            ok = callee && callee->kind == TypeKind::FUNC && callee->func.ret == type && callee->func.num_params == inst->operands.count;
+            for (u32 i = 0; ok && i < inst->operands.count; i++) {
+                ok = Global::types[func->insts[func->operands[inst->operands.first + i]].type] == callee->func.params[i];
+            }
+            break;
+        }
+        case IrOp::PHI: {
+            for (u32 i = 0; ok && i < inst->operands.count; i++) {
+                ok = func->insts[func->operands[inst->operands.first + i]].type == inst->type;
+            }
+            break;
+        }
+        case IrOp::BRANCH: {
+            ok = left && is_integer_type(left);
+            break;
+        }
+        case IrOp::RETURN: {
+            ok = func_type->func.ret->kind == TypeKind::VOID ? !left : left == func_type->func.ret;
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+
+    if (!ok) {
+        return ir_verify_error(error, "%%%u: operand types do not fit %s", value, ir_op_names[(int)inst->op]);
+    }
+    return true;
+}
+
+bool ir_verify(IrFunc* func, std::string* error) {
+    if (func->num_blocks == 0 || func->num_insts == 0 || func->insts[0].op != IrOp::NOP) {
+        return ir_verify_error(error, "function has no entry block");
+    }
+    if (func->blocks[0].num_preds) {
+        return ir_verify_error(error, "entry block has predecessors");
+    }
+
+    //*blocks tile the instructions, phis first and exactly one terminator last
+    std::vector<u32> def_block(func->num_insts, IR_NO_BLOCK);
+    u32 next = 1;
+    for (u32 b = 0; b < func->num_blocks; b++) {
+        IrBlock* block = func->blocks + b;
+        if (block->first != next || block->num_insts == 0 || block->first + block->num_insts > func->num_insts) {
+            return ir_verify_error(error, "b%u: instructions are not contiguous", b);
+        }
+        if (block->first_pred + block->num_preds > func->num_preds) {
+            return ir_verify_error(error, "b%u: predecessors out of range", b);
+        }
+        next = block->first + block->num_insts;
+
+        bool past_phis = false;
+        for (IrValue v = block->first; v < next; v++) {
+            IrOp op = func->insts[v].op;
+            def_block[v] = b;
+            if (ir_is_terminator(op) != (v == next - 1)) {
+                return ir_verify_error(error, "b%u: must end in exactly one terminator", b);
+            }
+            if (op == IrOp::PHI && past_phis) {
+                return ir_verify_error(error, "%%%u: phi after other instructions", v);
+            }
+            past_phis = past_phis || (op != IrOp::PHI && op != IrOp::NOP);
+            if (op == IrOp::JUMP || op == IrOp::BRANCH) {
+                for (u32 i = 0; i < (op == IrOp::BRANCH ? 2u : 1u); i++) {
+                    if (func->insts[v].targets[i] >= func->num_blocks) {
+                        return ir_verify_error(error, "%%%u: jumps out of the function", v);
+                    }
+                }
+            }
+        }
+    }
+    if (next != func->num_insts) {
+        return ir_verify_error(error, "instructions after the last block");
+    }
+
+    //*every edge appears once in the successor's predecessors for each time the terminator names it
+    std::vector<u64> edges;
+    std::vector<u64> pred_edges;
+    for (u32 b = 0; b < func->num_blocks; b++) {
+        for (u32 i = 0; i < ir_num_succs(func, b); i++) {
+            edges.push_back((u64)ir_succ(func, b, i) << 32 | b);
+        }
+        for (u32 i = 0; i < func->blocks[b].num_preds; i++) {
+            pred_edges.push_back((u64)b << 32 | func->preds[func->blocks[b].first_pred + i]);
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    std::sort(pred_edges.begin(), pred_edges.end());
+    if (edges != pred_edges) {
+        return ir_verify_error(error, "predecessors do not match the terminators");
+    }
+
+    std::vector<u32> idom;
+    ir_dominators(func, &idom);
+    for (u32 b = 0; b < func->num_blocks; b++) {
+        if (idom[b] == IR_NO_BLOCK || (b && idom[b] >= b)) {
+            return ir_verify_error(error, "b%u: not reachable in reverse postorder", b);
+        }
+    }
+
+    for (u32 b = 0; b < func->num_blocks; b++) {
+        IrBlock* block = func->blocks + b;
+        for (IrValue v = block->first; v < block->first + block->num_insts; v++) {
+            IrInst* inst = func->insts + v;
+            if (inst->op == IrOp::NOP) {
+                continue;
+            }
+            if (inst->op >= IrOp::SIZE_OF_ENUM) {
+                return ir_verify_error(error, "%%%u: unknown op", v);
+            }
+
+            //*operands are values defined before the use, in a dominating block, or for a phi at the end of its pred
+            IrValue uses[2] = { inst->args[0], inst->args[1] };
+            bool has_list = inst->op == IrOp::PHI || inst->op == IrOp::CALL;
+            if (inst->op == IrOp::PHI && inst->operands.count != block->num_preds) {
+                return ir_verify_error(error, "%%%u: phi has %u operands for %u predecessors", v, inst->operands.count, block->num_preds);
+            }
+            if (has_list && inst->operands.first + inst->operands.count > func->num_operands) {
+                return ir_verify_error(error, "%%%u: operands out of range", v);
+            }
+            u32 num_list = has_list ? inst->operands.count : 0;
+            for (u32 i = 0; i < 2 + num_list; i++) {
+                IrValue use = i < 2 ? uses[i] : func->operands[inst->operands.first + i - 2];
+                if (!use) {
+                    continue;
+                }
+                if (use >= func->num_insts || !ir_has_result(func->insts[use].op)) {
+                    return ir_verify_error(error, "%%%u: uses %%%u, which is not a value", v, use);
+                }
+
+                u32 use_block = b;
+                if (inst->op == IrOp::PHI && i >= 2) {
+                    use_block = func->preds[block->first_pred + i - 2];
+                }
+                bool dominated = def_block[use] == use_block && !(inst->op == IrOp::PHI && i >= 2) ? use < v : ir_dominates(idom, def_block[use], use_block);
+                if (!dominated) {
+                    return ir_verify_error(error, "%%%u: uses %%%u, which does not dominate it", v, use);
+                }
+            }
+
+            if (!ir_verify_lanes(func, v, error) || !ir_verify_types(func, v, error)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+//*dump
+
+Internal void ir_dump_value(std::string* out, IrValue value) {
+    *out += "%" + std::to_string(value);
+}
+
+std::string ir_dump(IrFunc* func) {
+    std::string out = "func " + std::string(func->sym->name) + "\n";
+    char buf[64];
+    for (u32 b = 0; b < func->num_blocks; b++) {
+        IrBlock* block = func->blocks + b;
+        out += "b" + std::to_string(b) + ":";
+        for (u32 i = 0; i < block->num_preds; i++) {
+            out += (i ? ", b" : " ; preds b") + std::to_string(func->preds[block->first_pred + i]);
+        }
+        out += "\n";
+
+        for (IrValue v = block->first; v < block->first + block->num_insts; v++) {
+            IrInst* inst = func->insts + v;
+            if (inst->op == IrOp::NOP) {
+                continue;
+            }
+
+            out += "    ";
+            if (ir_has_result(inst->op)) {
+                ir_dump_value(&out, v);
+                out += " " + type_to_str(Global::types[inst->type]);
+                out += inst->lanes ? " x" + std::to_string(inst->lanes) + " = " : " = ";
+            }
+            out += ir_op_names[(int)inst->op];
+
+            switch (inst->op) {
+                case IrOp::CONST_INT:
+                case IrOp::PARAM: {
+                    out += " " + std::to_string(inst->int_val);
+                    break;
+                }
+                case IrOp::CONST_FLOAT: {
+                    snprintf(buf, sizeof(buf), " %.17g", inst->float_val);
+                    out += buf;
+                    break;
+                }
+                case IrOp::GLOBAL: {
+                    out += " " + std::string(inst->sym->name);
+                    break;
+                }
+                case IrOp::STR: {
+                    out += " \"";
+                    for (const char* it = inst->str; *it; it++) {
+                        if (*it == '"' || *it == '\\' || (u8)*it < 0x20) {
+                            snprintf(buf, sizeof(buf), "\\x%02x", (u8)*it);
+                            out += buf;
+                        }
+                        else {
+                            out += *it;
+                        }
+                    }
+                    out += "\"";
+                    break;
+                }
+                case IrOp::PHI:
+                case IrOp::CALL: {
+                    if (inst->op == IrOp::CALL) {
+                        out += " ";
+                        ir_dump_value(&out, inst->args[0]);
+                    }
+                    out += inst->op == IrOp::CALL ? "(" : " ";
+                    for (u32 i = 0; i < inst->operands.count; i++) {
+                        out += i ? ", " : "";
+                        ir_dump_value(&out, func->operands[inst->operands.first + i]);
+                    }
+                    out += inst->op == IrOp::CALL ? ")" : "";
+                    break;
+                }
+                case IrOp::JUMP: {
+                    out += " b" + std::to_string(inst->targets[0]);
+                    break;
+                }
+                case IrOp::BRANCH: {
+                    out += " ";
+                    ir_dump_value(&out, inst->args[0]);
+                    out += ", b" + std::to_string(inst->targets[0]) + ", b" + std::to_string(inst->targets[1]);
+                    break;
+                }
+                default: {
+                    for (u32 i = 0; i < 2 && inst->args[i]; i++) {
+                        out += i ? ", " : " ";
+                        ir_dump_value(&out, inst->args[i]);
+                    }
+                    if (inst->op == IrOp::ZERO || inst->op == IrOp::FIELD_ADDR) {
+                        out += ", " + std::to_string(inst->int_val);
+                    }
+                    break;
+                }
+            }
+            out += "\n";
+        }
+    }
+
+    return out;
+}
+
+Internal IrFunc* ir_test_func(const char* name) {
+    const char* interned = Global::string_table.add(name);
+    for (IrFunc* it : Global::ir_funcs) {
+        if (it->sym->name == interned) {
+            return it;
+        }
+    }
+    assert(false);
+    return nullptr;
+}
+
+Internal u32 ir_test_count(IrFunc* func, IrOp op) {
+    u32 count = 0;
+    for (IrValue v = 1; v < func->num_insts; v++) {
+        count += func->insts[v].op == op;
+    }
+    return count;
+}
+
+void ir_test() {
+    const char* src =
+        "struct Vector { x, y: float; }\n"
+        "var g: int\n"
+        "func fact(n: int): int { p := 1; for (i := 1; i <= n; i++) { p *= i; } return p; }\n"
+        "func len2(v: Vector*): float { return v.x * v.x + v.y * v.y; }\n"
+        "func pick(c: int, a: int, b: int): int { if (c > 0 && a < b) { return a; } else if (c < 0) { a = b; } return c ? a : b; }\n"
+        "func addr(n: int): int { p := &n; *p += 1; return n; }\n"
+        "func sum(xs: int*, n: int): int { s := 0; i := 0; while (i < n) { if (xs[i] < 0) { break; } s += xs[i]; i++; } return s; }\n"
+        "func classify(c: char): int { r := 0; switch (c) { case 1 case 2: r = 10; case 3: r = 20; break; default: r = 30; } return r; }\n"
+        "func local(): float { var v: Vector = {1} g++; return v.y + len2(&v); }\n"
+        "func loop(n: int): int { x := 0; do { x += 2; if (x > 100) { continue; } x++; } while (x < n); return x; }\n"
+        "func same(c: int): int { x := 5; if (c) { c = 1; } return x; }\n"
+        "func nothing() { return; }\n";
+
+    assert(load_package_src("ir_test.sorin", src));
+    ir_lower_package();
+
+    std::string error;
+    for (IrFunc* it : Global::ir_funcs) {
+        bool ok = ir_verify(it, &error);
+        if (!ok) {
+            printf("%s%s\n", ir_dump(it).c_str(), error.c_str());
+        }
+        assert(ok);
+    }
+
+    //*the loop carries p and i in two phis, n stays the parameter
+    IrFunc* fact = ir_test_func("fact");
+    assert(ir_test_count(fact, IrOp::PHI) == 2 && ir_test_count(fact, IrOp::ALLOCA) == 0);
+    assert(ir_dump(fact).find("= phi %") != std::string::npos);
+
+    //*fields through a pointer are loads from field addresses
+    IrFunc* len2 = ir_test_func("len2");
+    assert(len2->num_blocks == 1 && ir_test_count(len2, IrOp::FIELD_ADDR) == 4 && ir_test_count(len2, IrOp::LOAD) == 4);
+
+    //*&& in a condition is two branches, the ternary joins in a phi
+    IrFunc* pick = ir_test_func("pick");
+    assert(ir_test_count(pick, IrOp::BRANCH) == 4 && ir_test_count(pick, IrOp::PHI) >= 1);
+
+    //*a parameter whose address is taken lives in a slot
+    IrFunc* addr = ir_test_func("addr");
+    assert(ir_test_count(addr, IrOp::ALLOCA) == 1 && ir_test_count(addr, IrOp::PHI) == 0);
+
+    //*a struct local is a slot, zeroed before its one initialized field is stored
+    IrFunc* local = ir_test_func("local");
+    assert(ir_test_count(local, IrOp::ALLOCA) == 1 && ir_test_count(local, IrOp::ZERO) == 1 && ir_test_count(local, IrOp::GLOBAL) == 2);
+
+    //*unchanged x needs no phi at the join
+    IrFunc* same = ir_test_func("same");
+    assert(ir_test_count(same, IrOp::PHI) == 0);
+    assert(ir_test_count(ir_test_func("classify"), IrOp::EQ) == 3);
+
+    //*the verifier catches a use that its definition does not dominate, and a phi with the wrong arity
+    IrFunc* sum = ir_test_func("sum");
+    IrBlock* last = sum->blocks + sum->num_blocks - 1;
+    IrInst* ret = sum->insts + last->first + last->num_insts - 1;
+    assert(ret->op == IrOp::RETURN);
+    IrValue saved = ret->args[0];
+    for (IrValue v = sum->num_insts - 1; v > 0; v--) {
+        if (sum->insts[v].op == IrOp::LOAD && sum->insts[v].type == Global::type_int->id) {
+            ret->args[0] = v;
+            break;
+        }
+    }
+    assert(!ir_verify(sum, &error) && error.find("does not dominate") != std::string::npos);
+    ret->args[0] = saved;
+    assert(ir_verify(sum, &error));
+
+    IrInst* phi = nullptr;
+    for (IrValue v = 1; v < sum->num_insts && !phi; v++) {
+        phi = sum->insts[v].op == IrOp::PHI ? sum->insts + v : nullptr;
+    }
+    assert(phi);
+    phi->operands.count--;
+    assert(!ir_verify(sum, &error) && error.find("operands for") != std::string::npos);
+    phi->operands.count++;
+
+    reset_syms();
+}
@@ -0,0 +1,172 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Resolve.hpp"
+#include <types.hpp>
+
+//*SSA form of the checked function bodies, shared by the passes and the backends that do not print source.
+//*a function is one flat array of instructions, and the value an instruction defines is its index in that array.
+//*blocks are runs of the array, phis first and one terminator last, numbered in reverse postorder so the entry is
+//*block 0 and every block comes after its dominators.
+
+//*a value is a scalar or a vector of lanes scalars of its type. vectors come from the vectorizer, only elementwise
+//*arithmetic, phis, loads, stores, splat and reduce_add take them, and a backend without vectors never sees them
+
+//*index into IrFunc::insts, 0 is no value
+typedef u32 IrValue;
+constexpr IrValue IR_NONE = 0;
+constexpr u32 IR_NO_BLOCK = 0xFFFFFFFF;
+
+enum class IrOp : u8 {
+    NOP, //*deleted, skipped by everything until the function is rebuilt
+    UNDEF, //*read of a variable on a path where it was never written
+    CONST_INT,
+    CONST_FLOAT,
+    PARAM, //*int_val is the parameter index
+    GLOBAL, //*address of a global var or a func value, sym
+    STR, //*address of the string literal str
+    PHI, //*one operand per predecessor of its block, in the order of its preds
+    //*two operands of the result type, the right operand of a shift is any integer
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    MOD,
+    AND,
+    OR,
+    XOR,
+    SHL,
+    SHR,
+    NEG,
+    //*two operands of one type, the result is an int 0 or 1
+    EQ,
+    NE,
+    LT,
+    LE,
+    GT,
+    GE,
+    CONVERT, //*operand converted to the result type like a C cast
+    ALLOCA, //*address of a stack slot for the pointee of its type, all in the entry block
+    LOAD, //*args[0] address, of the first lane of a vector
+    STORE, //*args[0] address, args[1] value, no result
+    ZERO, //*args[0] address, int_val bytes cleared, no result
+    ELEM_ADDR, //*args[0] pointer, args[1] integer index, the address index elements further on
+    FIELD_ADDR, //*args[0] pointer to an aggregate, the address int_val bytes further on
+    CALL, //*args[0] callee, the arguments are operands
+    SPLAT, //*vector of lanes copies of the scalar args[0]
+    REDUCE_ADD, //*scalar sum of the lanes of args[0]
+    //*terminators
+    JUMP, //*to targets[0]
+    BRANCH, //*args[0] nonzero goes to targets[0], zero to targets[1]
+    RETURN, //*args[0] value, IR_NONE in a void func
+    SIZE_OF_ENUM,
+};
+
+struct IrInst {
+    IrOp op;
+    u8 lanes; //*of a vector result, 0 for a scalar
+    u32 type; //*Type::id of the result or of each lane, 0 for instructions without one
+    IrValue args[2];
+    union {
+        i64 int_val;
+        f64 float_val;
+        Sym* sym;
+        const char* str;
+        struct {
+            u32 first;
+            u32 count;
+        } operands; //*PHI and CALL, a run of IrFunc::operands
+        u32 targets[2]; //*JUMP and BRANCH, block indices
+    };
+};
+
+struct IrBlock {
+    u32 first; //*instructions first..first + num_insts
+    u32 num_insts;
+    u32 first_pred; //*predecessors first_pred..first_pred + num_preds in IrFunc::preds
+    u32 num_preds;
+};
+
+//*everything is allocated in Global::ir_arena and freed with it
+struct IrFunc {
+    Sym* sym;
+    IrInst* insts; //*insts[0] is a NOP so that no instruction defines IR_NONE
+    u32 num_insts;
+    IrBlock* blocks;
+    u32 num_blocks;
+    u32* preds;
+    u32 num_preds;
+    IrValue* operands;
+    u32 num_operands;
+};
+
+inline bool ir_is_terminator(IrOp op) {
+    return op >= IrOp::JUMP && op <= IrOp::RETURN;
+}
+
+//*false for the instructions that define no value
+inline bool ir_has_result(IrOp op) {
+    return op != IrOp::NOP && op != IrOp::STORE && op != IrOp::ZERO && !ir_is_terminator(op);
+}
+
+//*bytes in a vector, the width of SSE2 and NEON registers
+constexpr u32 IR_VECTOR_BYTES = 16;
+
+//*successors come from the terminator, a BRANCH has two
+u32 ir_num_succs(IrFunc* func, u32 block);
+u32 ir_succ(IrFunc* func, u32 block, u32 i);
+
+//*lowers the checked body of a func symbol
+IrFunc* ir_lower_func(Sym* sym);
+
+//*lowers the initializers of the global vars, in Global::ordered_syms order, into the body of sym, a func without
+//*params or result that no source declares. for backends that run the program instead of printing C initializers
+IrFunc* ir_lower_global_init(Sym* sym);
+
+//*frees the previous IR and lowers every func of the resolved package into Global::ir_funcs
+void ir_lower_package();
+
+//*immediate dominator of every block, the entry is its own and blocks no path reaches have IR_NO_BLOCK
+void ir_dominators(IrFunc* func, std::vector<u32>* idom);
+bool ir_dominates(const std::vector<u32>& idom, u32 dom, u32 block);
+
+//*lays a function out again after a pass edited it in place. uses of a value v with replace[v] set go to that value,
+//*following chains, NOP instructions are dropped, blocks that no terminator reaches any more are removed with the phi
+//*operands of their edges, a block whose one pred jumps to it is merged into that pred, and the rest is renumbered in
+//*reverse postorder into a new IrFunc. replace may be null
+IrFunc* ir_rebuild(IrFunc* func, const std::vector<IrValue>* replace);
+
+//*a function opened for passes that add or move instructions and blocks. values keep their numbers and new ones are
+//*appended, a block lists its instructions in order, phis first and the terminator last, and its preds in the order of
+//*its phi operands
+struct IrEditBlock {
+    std::vector<IrValue> insts;
+    std::vector<u32> preds;
+};
+
+struct IrEdit {
+    Sym* sym;
+    std::vector<IrInst> insts;
+    std::vector<IrValue> operands;
+    std::vector<IrEditBlock> blocks;
+    std::vector<IrValue> replace; //*as for ir_rebuild, one entry per instruction
+};
+
+void ir_edit_open(IrEdit* edit, IrFunc* func);
+//*appends an instruction that is in no block yet
+IrValue ir_edit_add(IrEdit* edit, const IrInst& inst);
+u32 ir_edit_add_block(IrEdit* edit);
+//*gives a phi or call a new run of operands
+void ir_edit_set_operands(IrEdit* edit, IrValue value, const std::vector<IrValue>& operands);
+u32 ir_edit_num_succs(const IrEdit* edit, u32 block);
+u32 ir_edit_succ(const IrEdit* edit, u32 block, u32 i);
+//*lays the edited function out like ir_rebuild
+IrFunc* ir_edit_finish(IrEdit* edit);
+
+//*checks the block structure, phi arity, operand types and that every use is dominated by its definition.
+//*returns false with a message naming the first problem
+bool ir_verify(IrFunc* func, std::string* error);
+
+std::string ir_dump(IrFunc* func);
+
+void ir_test();
@@ -0,0 +1,2069 @@
+#include <cassert>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include "Jit.hpp"
+#include "RegAlloc.hpp"
+#include "Opt.hpp"
+#include "Vm.hpp"
+#include "Globals.hpp"
+#include "Parse.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define JIT_HOST_X64 1
+#else
+#define JIT_HOST_X64 0
+#endif
+
+enum X64Reg : u8 {
+    X64_RAX,
+    X64_RCX,
+    X64_RDX,
+    X64_RBX,
+    X64_RSP,
+    X64_RBP,
+    X64_RSI,
+    X64_RDI,
+    X64_R8,
+    X64_R9,
+    X64_R10,
+    X64_R11,
+    X64_R12,
+    X64_R13,
+    X64_R14,
+    X64_R15,
+};
+
+//*condition codes, the low nibble of jcc and setcc
+enum X64Cond : u8 {
+    X64_B = 0x2,
+    X64_AE = 0x3,
+    X64_E = 0x4,
+    X64_NE = 0x5,
+    X64_BE = 0x6,
+    X64_A = 0x7,
+    X64_S = 0x8,
+    X64_P = 0xA,
+    X64_NP = 0xB,
+    X64_L = 0xC,
+    X64_GE = 0xD,
+    X64_LE = 0xE,
+    X64_G = 0xF,
+};
+
+//*the host convention. windows passes the first four arguments by position in either kind of register, behind 32
+//*bytes of shadow space the callee may write
+#ifdef _WIN32
+GlobalVariable const u8 jit_int_arg_regs[] = { X64_RCX, X64_RDX, X64_R8, X64_R9 };
+Internal constexpr u32 JIT_SSE_ARG_REGS = 4;
+Internal constexpr u32 JIT_SHADOW_BYTES = 32;
+#else
+GlobalVariable const u8 jit_int_arg_regs[] = { X64_RDI, X64_RSI, X64_RDX, X64_RCX, X64_R8, X64_R9 };
+Internal constexpr u32 JIT_SSE_ARG_REGS = 8;
+Internal constexpr u32 JIT_SHADOW_BYTES = 0;
+#endif
+Internal constexpr u32 JIT_INT_ARG_REGS = sizeof(jit_int_arg_regs);
+
+//*the registers values get. rbx and r12..r15 are callee saved in both conventions, r8, r9 and xmm2..xmm5 only
+//*carry arguments, which a value live across a call never takes. the instructions use the others as scratch
+GlobalVariable const RaReg jit_int_regs[] = {
+    { X64_RBX, true }, { X64_R12, true }, { X64_R13, true }, { X64_R14, true }, { X64_R15, true }, { X64_R8, false }, { X64_R9, false },
+};
+GlobalVariable const RaReg jit_sse_regs[] = { { 2, false }, { 3, false }, { 4, false }, { 5, false } };
+GlobalVariable const RaTarget jit_ra_target = { "x86-64", { jit_int_regs, jit_sse_regs }, { 7, 4 } };
+
+//*copies and clears longer than this use rep movsb and rep stosb
+Internal constexpr u32 JIT_INLINE_COPY_BYTES = 64;
+//*stack arguments start above the return address and the saved frame pointer
+Internal constexpr i32 JIT_ARGS_OFFSET = 16;
+
+struct JitFixup {
+    u32 pos; //*of a rel32
+    u32 label;
+};
+
+struct JitFuncFixup {
+    u32 pos; //*of a rel32
+    Sym* sym;
+};
+
+struct JitEdge {
+    u32 pred;
+    u32 succ;
+    u32 label;
+};
+
+//*how a value travels in the host convention: in one or two eightbytes of integer or sse registers, or in memory
+struct JitPass {
+    u32 num_parts; //*0 in memory
+    bool is_sse[2];
+    u32 part_bytes[2];
+    bool by_ref; //*a pointer to a copy takes its place (windows), else the bytes are copied into the stack (unix)
+};
+
+//*where an argument goes
+struct JitArg {
+    JitPass pass;
+    u8 regs[2]; //*an integer register or an xmm number per part, the pointer's register when by_ref
+    bool on_stack;
+    u32 stack_offset; //*from the stack pointer at the call
+};
+
+GlobalVariable std::vector<u8> jit_code;
+GlobalVariable IrFunc* jit_ir;
+GlobalVariable JitProgram* jit_program;
+//*offsets from the frame pointer
+GlobalVariable std::vector<i32> jit_slots; //*the 8 bytes of each value
+GlobalVariable std::vector<i32> jit_copies; //*the memory of an alloca, or the copy an aggregate value addresses
+GlobalVariable std::vector<i32> jit_in_slots; //*of a phi, where the value of its incoming edge is gathered
+GlobalVariable std::vector<i32> jit_arg_copies; //*per call operand, the copy a by_ref argument points to
+GlobalVariable std::vector<i32> jit_param_slots;
+GlobalVariable std::vector<i32> jit_param_copies;
+GlobalVariable i32 jit_ret_slot; //*the pointer to the caller's copy of an aggregate result
+GlobalVariable u32 jit_frame_bytes;
+GlobalVariable u32 jit_out_bytes; //*stack arguments and shadow space of the largest call
+GlobalVariable std::vector<u32> jit_labels; //*code offset of each block, then of each edge
+GlobalVariable std::vector<JitFixup> jit_fixups;
+GlobalVariable std::vector<JitEdge> jit_edges;
+GlobalVariable std::vector<JitFuncFixup> jit_func_fixups;
+GlobalVariable std::vector<JitReloc>* jit_relocs; //*when compiling for an object file, see jit_compile_code
+GlobalVariable const RaTarget* jit_target = &jit_ra_target; //*the tests swap in fewer registers
+GlobalVariable RaFunc jit_ra;
+GlobalVariable u32 jit_pos; //*of the instruction being compiled, see RaFunc
+GlobalVariable std::vector<i32> jit_saved_slots; //*of the callee saved registers in jit_ra.saved
+
+bool jit_is_supported() {
+    return JIT_HOST_X64 != 0;
+}
+
+Internal Type* jit_type(IrValue value) {
+    return Global::types[jit_ir->insts[value].type];
+}
+
+Internal bool jit_is_aggregate(Type* type) {
+    return type->kind == TypeKind::STRUCT || type->kind == TypeKind::UNION;
+}
+
+//*calling convention
+
+#ifndef _WIN32
+Internal void jit_mark_ints(Type* type, size_t offset, bool* has_int) {
+    switch (type->kind) {
+        case TypeKind::STRUCT:
+        case TypeKind::UNION: {
+            for (size_t i = 0; i < type->aggregate.num_fields; i++) {
+                jit_mark_ints(type->aggregate.fields[i].type, offset + type->aggregate.fields[i].offset, has_int);
+            }
+            break;
+        }
+        case TypeKind::ARRAY: {
+            for (size_t i = 0; i < type->array.size; i++) {
+                jit_mark_ints(type->array.base, offset + i * type->array.base->size, has_int);
+            }
+            break;
+        }
+        default: {
+            has_int[offset / 8] = has_int[offset / 8] || !is_floating_type(type);
+            break;
+        }
+    }
+}
+#endif
+
+Internal JitPass jit_classify(Type* type) {
+    JitPass pass = {};
+    u32 size = (u32)type->size;
+    if (!jit_is_aggregate(type)) {
+        pass.num_parts = 1;
+        pass.is_sse[0] = is_floating_type(type);
+        pass.part_bytes[0] = size;
+        return pass;
+    }
+#ifdef _WIN32
+    if (size == 1 || size == 2 || size == 4 || size == 8) {
+        pass.num_parts = 1;
+        pass.part_bytes[0] = size;
+    }
+    else {
+        pass.by_ref = true;
+    }
+#else
+    //*an eightbyte goes in an sse register when it only holds floats and doubles
+    if (size > 0 && size <= 16) {
+        bool has_int[2] = {};
+        jit_mark_ints(type, 0, has_int);
+        pass.num_parts = (size + 7) / 8;
+        for (u32 k = 0; k < pass.num_parts; k++) {
+            pass.is_sse[k] = !has_int[k];
+            pass.part_bytes[k] = size - k * 8 < 8 ? size - k * 8 : 8;
+        }
+    }
+#endif
+    return pass;
+}
+
+Internal bool jit_returns_in_memory(Type* type) {
+    return jit_is_aggregate(type) && jit_classify(type).num_parts == 0;
+}
+
+//*registers of the parts of a result: integer parts in rax then rdx, sse parts in xmm0 then xmm1
+Internal void jit_ret_regs(const JitPass& pass, u8* regs) {
+    u32 ints = 0;
+    u32 sses = 0;
+    for (u32 k = 0; k < pass.num_parts; k++) {
+        regs[k] = pass.is_sse[k] ? (u8)sses++ : (u8)(ints++ ? X64_RDX : X64_RAX);
+    }
+}
+
+//*places the arguments after the hidden pointer to an aggregate result, returns the bytes of stack arguments and
+//*shadow space the call needs
+Internal u32 jit_place_args(Type** types, size_t num_types, bool hidden_ret, std::vector<JitArg>* args) {
+    args->assign(num_types, JitArg{});
+    u32 stack = JIT_SHADOW_BYTES;
+#ifdef _WIN32
+    u32 pos = hidden_ret ? 1 : 0;
+    for (size_t i = 0; i < num_types; i++, pos++) {
+        JitArg* arg = &(*args)[i];
+        arg->pass = jit_classify(types[i]);
+        if (pos < JIT_INT_ARG_REGS) {
+            arg->regs[0] = arg->pass.num_parts && arg->pass.is_sse[0] ? (u8)pos : jit_int_arg_regs[pos];
+        }
+        else {
+            arg->on_stack = true;
+            arg->stack_offset = stack;
+            stack += 8;
+        }
+    }
+#else
+    u32 ints = hidden_ret ? 1 : 0;
+    u32 sses = 0;
+    for (size_t i = 0; i < num_types; i++) {
+        JitArg* arg = &(*args)[i];
+        arg->pass = jit_classify(types[i]);
+        u32 need_ints = 0;
+        u32 need_sses = 0;
+        for (u32 k = 0; k < arg->pass.num_parts; k++) {
+            need_sses += arg->pass.is_sse[k];
+            need_ints += !arg->pass.is_sse[k];
+        }
+        //*an argument goes in registers whole or not at all
+        if (arg->pass.num_parts && ints + need_ints <= JIT_INT_ARG_REGS && sses + need_sses <= JIT_SSE_ARG_REGS) {
+            for (u32 k = 0; k < arg->pass.num_parts; k++) {
+                arg->regs[k] = arg->pass.is_sse[k] ? (u8)sses++ : jit_int_arg_regs[ints++];
+            }
+        }
+        else {
+            arg->on_stack = true;
+            arg->stack_offset = stack;
+            stack += ((u32)types[i]->size + 7) / 8 * 8;
+        }
+    }
+#endif
+    return stack;
+}
+
+//*encoding
+
+Internal void jit_byte(u32 byte) {
+    jit_code.push_back((u8)byte);
+}
+
+Internal void jit_u32(u32 val) {
+    for (int i = 0; i < 4; i++) {
+        jit_byte(val >> (i * 8));
+    }
+}
+
+Internal void jit_patch_rel32(u32 pos, u32 target) {
+    u32 rel = target - (pos + 4);
+    memcpy(jit_code.data() + pos, &rel, sizeof(rel));
+}
+
+//*legacy prefix, REX and opcode, the high bytes of a multibyte opcode first
+Internal void jit_head(u32 prefix, bool wide, u32 opcode, u32 reg, u32 rm) {
+    if (prefix) {
+        jit_byte(prefix);
+    }
+    u32 rex = 0x40 | (wide ? 8 : 0) | ((reg >> 3) << 2) | (rm >> 3);
+    if (rex != 0x40) {
+        jit_byte(rex);
+    }
+    if (opcode > 0xFFFF) {
+        jit_byte(opcode >> 16);
+    }
+    if (opcode > 0xFF) {
+        jit_byte(opcode >> 8);
+    }
+    jit_byte(opcode);
+}
+
+//*an instruction on reg and the register rm. reg is an opcode extension for some opcodes
+Internal void jit_op_reg(u32 prefix, bool wide, u32 opcode, u32 reg, u32 rm) {
+    jit_head(prefix, wide, opcode, reg, rm);
+    jit_byte(0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+//*an instruction on reg and the memory at base + disp. byte operations only name al, cl, dl, bl and r8b..r15b, see jit_store
+Internal void jit_op_mem(u32 prefix, bool wide, u32 opcode, u32 reg, u32 base, i32 disp) {
+    jit_head(prefix, wide, opcode, reg, base);
+    jit_byte(0x80 | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == X64_RSP) {
+        jit_byte(0x24);
+    }
+    jit_u32((u32)disp);
+}
+
+Internal void jit_load64(u32 reg, u32 base, i32 disp) {
+    jit_op_mem(0, true, 0x8B, reg, base, disp);
+}
+
+Internal void jit_store64(u32 base, i32 disp, u32 reg) {
+    jit_op_mem(0, true, 0x89, reg, base, disp);
+}
+
+Internal void jit_lea(u32 reg, u32 base, i32 disp) {
+    jit_op_mem(0, true, 0x8D, reg, base, disp);
+}
+
+Internal void jit_mov(u32 dest, u32 src) {
+    jit_op_reg(0, true, 0x89, src, dest);
+}
+
+Internal void jit_mov_imm(u32 reg, u64 val) {
+    if (val <= UINT32_MAX) {
+        //*a 32-bit move clears the high half
+        if (reg >= 8) {
+            jit_byte(0x41);
+        }
+        jit_byte(0xB8 + (reg & 7));
+        jit_u32((u32)val);
+    }
+    else if ((i64)val >= INT32_MIN && (i64)val < 0) {
+        jit_op_reg(0, true, 0xC7, 0, reg);
+        jit_u32((u32)val);
+    }
+    else {
+        jit_byte(0x48 | (reg >> 3));
+        jit_byte(0xB8 + (reg & 7));
+        jit_u32((u32)val);
+        jit_u32((u32)(val >> 32));
+    }
+}
+
+//*shl, shr or sar of a register by an immediate
+Internal void jit_shift_imm(u32 ext, u32 reg, u32 count) {
+    jit_op_reg(0, true, 0xC1, ext, reg);
+    jit_byte(count);
+}
+
+Internal void jit_add_imm(u32 reg, i32 val) {
+    jit_op_reg(0, true, 0x81, 0, reg);
+    jit_u32((u32)val);
+}
+
+Internal void jit_setcc(u32 cond, u32 reg) {
+    jit_op_reg(0, false, 0x0F90 | cond, 0, reg);
+}
+
+//*movzx eax, al after a setcc
+Internal void jit_bool_result() {
+    jit_op_reg(0, false, 0x0FB6, X64_RAX, X64_RAX);
+}
+
+Internal u32 jit_sse_prefix(Type* type) {
+    return type->kind == TypeKind::FLOAT ? 0xF3 : 0xF2;
+}
+
+//*movss or movsd between an xmm register and memory
+Internal void jit_sse_load(Type* type, u32 xmm, u32 base, i32 disp) {
+    jit_op_mem(jit_sse_prefix(type), false, 0x0F10, xmm, base, disp);
+}
+
+Internal void jit_sse_store(Type* type, u32 base, i32 disp, u32 xmm) {
+    jit_op_mem(jit_sse_prefix(type), false, 0x0F11, xmm, base, disp);
+}
+
+//*lea rax, [rip + rel32], the rel32 follows
+Internal void jit_lea_rip() {
+    jit_byte(0x48);
+    jit_byte(0x8D);
+    jit_byte(0x05);
+}
+
+Internal void jit_push_label(u32 label) {
+    jit_fixups.push_back({ (u32)jit_code.size(), label });
+    jit_u32(0);
+}
+
+Internal void jit_jmp(u32 label) {
+    jit_byte(0xE9);
+    jit_push_label(label);
+}
+
+Internal void jit_jcc(u32 cond, u32 label) {
+    jit_byte(0x0F);
+    jit_byte(0x80 | cond);
+    jit_push_label(label);
+}
+
+//*jumps forward within the code of one instruction, jit_land patches them to the current position
+Internal u32 jit_jcc_forward(u32 cond) {
+    jit_byte(0x0F);
+    jit_byte(0x80 | cond);
+    jit_u32(0);
+    return (u32)jit_code.size() - 4;
+}
+
+Internal u32 jit_jmp_forward() {
+    jit_byte(0xE9);
+    jit_u32(0);
+    return (u32)jit_code.size() - 4;
+}
+
+Internal void jit_land(u32 pos) {
+    jit_patch_rel32(pos, (u32)jit_code.size());
+}
+
+//*re-extends the low bytes of a register to 64 bits like a slot of type holds them
+Internal void jit_extend(u32 reg, Type* type) {
+    if (!is_integer_type(type) || type->size == 8) {
+        return;
+    }
+    bool is_signed = is_signed_type(type);
+    switch (type->size) {
+        case 1: {
+            jit_op_reg(0, is_signed, is_signed ? 0x0FBE : 0x0FB6, reg, reg);
+            break;
+        }
+        case 2: {
+            jit_op_reg(0, is_signed, is_signed ? 0x0FBF : 0x0FB7, reg, reg);
+            break;
+        }
+        default: {
+            jit_op_reg(0, is_signed, is_signed ? 0x63 : 0x89, reg, reg);
+            break;
+        }
+    }
+}
+
+//*loads a scalar extended like a slot holds it, floats are loaded as their bits
+Internal void jit_load(u32 reg, Type* type, u32 base, i32 disp) {
+    bool is_signed = is_signed_type(type);
+    switch (type->size) {
+        case 1: {
+            jit_op_mem(0, is_signed, is_signed ? 0x0FBE : 0x0FB6, reg, base, disp);
+            break;
+        }
+        case 2: {
+            jit_op_mem(0, is_signed, is_signed ? 0x0FBF : 0x0FB7, reg, base, disp);
+            break;
+        }
+        case 4: {
+            jit_op_mem(0, is_signed, is_signed ? 0x63 : 0x8B, reg, base, disp);
+            break;
+        }
+        default: {
+            jit_load64(reg, base, disp);
+            break;
+        }
+    }
+}
+
+//*stores the low size bytes of a register
+Internal void jit_store(u32 base, i32 disp, u32 reg, u32 size) {
+    switch (size) {
+        case 1: {
+            //*without a REX prefix the low bytes of rsp, rbp, rsi and rdi encode ah, ch, dh and bh
+            if (reg >= X64_RSP && reg < X64_R8) {
+                jit_mov(X64_R10, reg);
+                reg = X64_R10;
+            }
+            jit_op_mem(0, false, 0x88, reg, base, disp);
+            break;
+        }
+        case 2: {
+            jit_op_mem(0x66, false, 0x89, reg, base, disp);
+            break;
+        }
+        case 4: {
+            jit_op_mem(0, false, 0x89, reg, base, disp);
+            break;
+        }
+        default: {
+            jit_store64(base, disp, reg);
+            break;
+        }
+    }
+}
+
+//*zero extending loads of 1, 2, 4 or 8 bytes
+Internal void jit_load_piece(u32 reg, u32 size, u32 base, i32 disp) {
+    jit_load(reg, size == 1 ? Global::type_uchar : size == 2 ? Global::type_ushort : size == 4 ? Global::type_uint : Global::type_ullong,
+             base, disp);
+}
+
+//*the n bytes of an eightbyte into the low bytes of reg, assembled in r10 when n is no power of two
+Internal void jit_load_bytes(u32 reg, u32 base, i32 disp, u32 n) {
+    u32 done = 0;
+    for (u32 piece = 8; piece; piece /= 2) {
+        if (n - done < piece) {
+            continue;
+        }
+        jit_load_piece(done ? (u32)X64_R10 : reg, piece, base, disp + (i32)done);
+        if (done) {
+            jit_shift_imm(4, X64_R10, done * 8);
+            jit_op_reg(0, true, 0x09, X64_R10, reg);
+        }
+        done += piece;
+    }
+}
+
+Internal void jit_store_bytes(u32 base, i32 disp, u32 reg, u32 n) {
+    if (n == 1 || n == 2 || n == 4 || n == 8) {
+        jit_store(base, disp, reg, n);
+        return;
+    }
+    jit_mov(X64_R10, reg);
+    u32 done = 0;
+    for (u32 piece = 4; piece; piece /= 2) {
+        if (n - done < piece) {
+            continue;
+        }
+        jit_store(base, disp + (i32)done, X64_R10, piece);
+        jit_shift_imm(5, X64_R10, piece * 8);
+        done += piece;
+    }
+}
+
+//*copies between the addresses in two base registers other than rax, rcx, rsi and rdi
+Internal void jit_copy(u32 dest, i32 dest_disp, u32 src, i32 src_disp, u32 size) {
+    if (size > JIT_INLINE_COPY_BYTES) {
+        jit_lea(X64_RDI, dest, dest_disp);
+        jit_lea(X64_RSI, src, src_disp);
+        jit_mov_imm(X64_RCX, size);
+        jit_byte(0xF3);
+        jit_byte(0xA4);
+        return;
+    }
+    for (u32 done = 0; done < size;) {
+        u32 left = size - done;
+        u32 piece = left >= 8 ? 8 : left >= 4 ? 4 : left >= 2 ? 2 : 1;
+        jit_load_piece(X64_RAX, piece, src, src_disp + (i32)done);
+        jit_store(dest, dest_disp + (i32)done, X64_RAX, piece);
+        done += piece;
+    }
+}
+
+Internal void jit_zero(u32 base, i32 disp, u32 size) {
+    jit_op_reg(0, false, 0x31, X64_RAX, X64_RAX);
+    if (size > JIT_INLINE_COPY_BYTES) {
+        jit_lea(X64_RDI, base, disp);
+        jit_mov_imm(X64_RCX, size);
+        jit_byte(0xF3);
+        jit_byte(0xAA);
+        return;
+    }
+    for (u32 done = 0; done < size;) {
+        u32 left = size - done;
+        u32 piece = left >= 8 ? 8 : left >= 4 ? 4 : left >= 2 ? 2 : 1;
+        jit_store(base, disp + (i32)done, X64_RAX, piece);
+        done += piece;
+    }
+}
+
+//*slots
+
+//*a value is in the register the allocator gave it at the current position or in its slot, a float or double in an
+//*xmm register moves to and from integer registers as its bits
+Internal bool jit_is_sse_value(IrValue value) {
+    return ra_class(jit_type(value)) == RaClass::FLOAT;
+}
+
+Internal void jit_get(u32 reg, IrValue value) {
+    i32 at = ra_reg_at(&jit_ra, value, jit_pos);
+    if (at < 0) {
+        jit_load64(reg, X64_RBP, jit_slots[value]);
+    }
+    else if (jit_is_sse_value(value)) {
+        jit_op_reg(0x66, true, 0x0F7E, (u32)at, reg);
+    }
+    else if ((u32)at != reg) {
+        jit_mov(reg, (u32)at);
+    }
+}
+
+Internal void jit_set(IrValue value, u32 reg) {
+    i32 at = ra_def_reg(&jit_ra, value);
+    if (at >= 0 && jit_is_sse_value(value)) {
+        jit_op_reg(0x66, true, 0x0F6E, (u32)at, reg);
+    }
+    else if (at >= 0) {
+        jit_mov((u32)at, reg);
+    }
+    if (at < 0 || jit_ra.in_slot[value]) {
+        jit_store64(X64_RBP, jit_slots[value], reg);
+    }
+}
+
+//*movss or movsd of a float value into an xmm register, and from one
+Internal void jit_sse_get(Type* type, u32 xmm, IrValue value) {
+    i32 at = ra_reg_at(&jit_ra, value, jit_pos);
+    if (at < 0) {
+        jit_sse_load(type, xmm, X64_RBP, jit_slots[value]);
+    }
+    else if ((u32)at != xmm) {
+        jit_op_reg(0, false, 0x0F28, xmm, (u32)at);
+    }
+}
+
+Internal void jit_sse_set(Type* type, IrValue value, u32 xmm) {
+    i32 at = ra_def_reg(&jit_ra, value);
+    if (at >= 0 && (u32)at != xmm) {
+        jit_op_reg(0, false, 0x0F28, (u32)at, xmm);
+    }
+    if (at < 0 || jit_ra.in_slot[value]) {
+        jit_sse_store(type, X64_RBP, jit_slots[value], xmm);
+    }
+}
+
+//*the register of an integer value the instruction only reads, or scratch loaded with it
+Internal u32 jit_use(u32 scratch, IrValue value) {
+    i32 at = ra_reg_at(&jit_ra, value, jit_pos);
+    if (at >= 0 && !jit_is_sse_value(value)) {
+        return (u32)at;
+    }
+    jit_get(scratch, value);
+    return scratch;
+}
+
+//*an instruction on reg and the register or the slot of value
+Internal void jit_op_value(u32 prefix, bool wide, u32 opcode, u32 reg, IrValue value) {
+    i32 at = ra_reg_at(&jit_ra, value, jit_pos);
+    if (at >= 0) {
+        jit_op_reg(prefix, wide, opcode, reg, (u32)at);
+    }
+    else {
+        jit_op_mem(prefix, wide, opcode, reg, X64_RBP, jit_slots[value]);
+    }
+}
+
+//*loads the register a value takes at a reload, or a param's at its definition, from the slot
+Internal void jit_load_reg(IrValue value, u32 reg) {
+    if (jit_is_sse_value(value)) {
+        jit_sse_load(jit_type(value), reg, X64_RBP, jit_slots[value]);
+    }
+    else {
+        jit_load64(reg, X64_RBP, jit_slots[value]);
+    }
+}
+
+Internal i32 jit_alloc(u32 size, u32 align) {
+    align = align < 8 ? 8 : align;
+    jit_frame_bytes = (jit_frame_bytes + size + align - 1) / align * align;
+    return -(i32)jit_frame_bytes;
+}
+
+Internal i32 jit_alloc_type(Type* type) {
+    return jit_alloc((u32)type->size, (u32)type->align);
+}
+
+//*bytes of the copy an aggregate or vector value is the address of, 0 for a value held in its slot
+Internal u32 jit_copy_bytes(IrValue value) {
+    IrInst* inst = jit_ir->insts + value;
+    Type* type = Global::types[inst->type];
+    return inst->lanes ? IR_VECTOR_BYTES : jit_is_aggregate(type) ? (u32)type->size : 0;
+}
+
+//*the types of a call's arguments
+Internal void jit_arg_types(IrInst* inst, std::vector<Type*>* types) {
+    types->clear();
+    for (u32 i = 0; i < inst->operands.count; i++) {
+        types->push_back(jit_type(jit_ir->operands[inst->operands.first + i]));
+    }
+}
+
+//*every slot and copy gets its place in the frame before any code, so the prologue knows the frame's size
+Internal void jit_layout_frame() {
+    Type* func_type = jit_ir->sym->type;
+    jit_frame_bytes = 16; //*the saved rsi and rdi
+    jit_saved_slots.resize(jit_ra.saved[(int)RaClass::INT].size());
+    for (i32& slot : jit_saved_slots) {
+        slot = jit_alloc(8, 8);
+    }
+    jit_out_bytes = JIT_SHADOW_BYTES;
+    jit_slots.assign(jit_ir->num_insts, 0);
+    jit_copies.assign(jit_ir->num_insts, 0);
+    jit_in_slots.assign(jit_ir->num_insts, 0);
+    jit_arg_copies.assign(jit_ir->num_operands, 0);
+    jit_param_slots.assign(func_type->func.num_params, 0);
+    jit_param_copies.assign(func_type->func.num_params, 0);
+    for (size_t i = 0; i < func_type->func.num_params; i++) {
+        Type* type = func_type->func.params[i];
+        jit_param_slots[i] = jit_alloc(8, 8);
+        if (jit_is_aggregate(type) && jit_classify(type).num_parts) {
+            jit_param_copies[i] = jit_alloc_type(type);
+        }
+    }
+    jit_ret_slot = jit_returns_in_memory(func_type->func.ret) ? jit_alloc(8, 8) : 0;
+
+    std::vector<Type*> types;
+    std::vector<JitArg> args;
+    for (IrValue v = 1; v < jit_ir->num_insts; v++) {
+        IrInst* inst = jit_ir->insts + v;
+        Type* type = Global::types[inst->type];
+        if (inst->op == IrOp::PARAM) {
+            jit_slots[v] = jit_param_slots[inst->int_val];
+        }
+        else if (ir_has_result(inst->op) && inst->type) {
+            jit_slots[v] = jit_alloc(8, 8);
+        }
+        if (inst->op == IrOp::ALLOCA) {
+            jit_copies[v] = jit_alloc_type(type->ptr.base);
+        }
+        else if (inst->lanes) {
+            jit_copies[v] = jit_alloc(IR_VECTOR_BYTES, IR_VECTOR_BYTES);
+            if (inst->op == IrOp::PHI) {
+                jit_in_slots[v] = jit_alloc(IR_VECTOR_BYTES, IR_VECTOR_BYTES);
+            }
+        }
+        else if (inst->op != IrOp::PARAM && inst->type && jit_is_aggregate(type)) {
+            jit_copies[v] = jit_alloc_type(type);
+            if (inst->op == IrOp::PHI) {
+                jit_in_slots[v] = jit_alloc_type(type);
+            }
+        }
+        else if (inst->op == IrOp::PHI) {
+            jit_in_slots[v] = jit_alloc(8, 8);
+        }
+        if (inst->op == IrOp::CALL) {
+            jit_arg_types(inst, &types);
+            u32 stack = jit_place_args(types.data(), types.size(), jit_returns_in_memory(type), &args);
+            jit_out_bytes = stack > jit_out_bytes ? stack : jit_out_bytes;
+            for (size_t i = 0; i < args.size(); i++) {
+                if (args[i].pass.by_ref) {
+                    jit_arg_copies[inst->operands.first + i] = jit_alloc_type(types[i]);
+                }
+            }
+        }
+    }
+}
+
+//*prologue and epilogue
+
+Internal void jit_emit_prologue() {
+    Type* func_type = jit_ir->sym->type;
+    u32 frame = (jit_frame_bytes + jit_out_bytes + 15) / 16 * 16;
+    jit_byte(0x55);
+    jit_mov(X64_RBP, X64_RSP);
+#ifdef _WIN32
+    //*windows commits the stack one guard page at a time, each page of a large frame is touched in order
+    for (u32 probe = 4096; probe < frame; probe += 4096) {
+        jit_op_mem(0, false, 0x8B, X64_RAX, X64_RSP, -(i32)probe);
+    }
+#endif
+    jit_op_reg(0, true, 0x81, 5, X64_RSP);
+    jit_u32(frame);
+    //*both are callee saved on windows and rep movsb and stosb use them
+    jit_store64(X64_RBP, -8, X64_RSI);
+    jit_store64(X64_RBP, -16, X64_RDI);
+    for (size_t i = 0; i < jit_saved_slots.size(); i++) {
+        jit_store64(X64_RBP, jit_saved_slots[i], jit_ra.saved[(int)RaClass::INT][i]);
+    }
+    bool hidden_ret = jit_ret_slot != 0;
+    if (hidden_ret) {
+        jit_store64(X64_RBP, jit_ret_slot, jit_int_arg_regs[0]);
+    }
+
+    std::vector<JitArg> args;
+    jit_place_args(func_type->func.params, func_type->func.num_params, hidden_ret, &args);
+    for (size_t i = 0; i < args.size(); i++) {
+        Type* type = func_type->func.params[i];
+        JitArg* arg = &args[i];
+        i32 slot = jit_param_slots[i];
+        i32 stack = JIT_ARGS_OFFSET + (i32)arg->stack_offset;
+        if (jit_is_aggregate(type)) {
+            if (arg->on_stack && arg->pass.by_ref) {
+                jit_load64(X64_RAX, X64_RBP, stack);
+            }
+            else if (arg->on_stack) {
+                jit_lea(X64_RAX, X64_RBP, stack);
+            }
+            else if (arg->pass.by_ref) {
+                jit_mov(X64_RAX, arg->regs[0]);
+            }
+            else {
+                i32 copy = jit_param_copies[i];
+                for (u32 k = 0; k < arg->pass.num_parts; k++) {
+                    i32 disp = copy + (i32)k * 8;
+                    if (arg->pass.is_sse[k]) {
+                        jit_sse_store(arg->pass.part_bytes[k] == 4 ? Global::type_float : Global::type_double, X64_RBP, disp, arg->regs[k]);
+                    }
+                    else {
+                        jit_store_bytes(X64_RBP, disp, arg->regs[k], arg->pass.part_bytes[k]);
+                    }
+                }
+                jit_lea(X64_RAX, X64_RBP, copy);
+            }
+            jit_store64(X64_RBP, slot, X64_RAX);
+        }
+        else if (arg->on_stack) {
+            jit_load64(X64_RAX, X64_RBP, stack);
+            jit_extend(X64_RAX, type);
+            jit_store64(X64_RBP, slot, X64_RAX);
+        }
+        else if (is_floating_type(type)) {
+            jit_sse_store(type, X64_RBP, slot, arg->regs[0]);
+        }
+        else {
+            //*the high bits of a narrow argument are unspecified
+            jit_mov(X64_RAX, arg->regs[0]);
+            jit_extend(X64_RAX, type);
+            jit_store64(X64_RBP, slot, X64_RAX);
+        }
+    }
+
+    //*aggregate and vector phis are written through the addresses of their copies, which never change
+    for (IrValue v = 1; v < jit_ir->num_insts; v++) {
+        if (jit_ir->insts[v].op == IrOp::PHI && jit_copy_bytes(v)) {
+            jit_lea(X64_RAX, X64_RBP, jit_copies[v]);
+            jit_set(v, X64_RAX);
+        }
+    }
+}
+
+Internal void jit_emit_epilogue() {
+    jit_load64(X64_RSI, X64_RBP, -8);
+    jit_load64(X64_RDI, X64_RBP, -16);
+    for (size_t i = 0; i < jit_saved_slots.size(); i++) {
+        jit_load64(jit_ra.saved[(int)RaClass::INT][i], X64_RBP, jit_saved_slots[i]);
+    }
+    jit_byte(0xC9);
+    jit_byte(0xC3);
+}
+
+//*edges
+
+//*every phi first gathers its operand and then takes it, so no phi reads another's new value
+Internal void jit_emit_phi_moves(u32 pred, u32 succ) {
+    IrBlock* block = jit_ir->blocks + succ;
+    jit_pos = jit_ra.block_ends[pred];
+    u32 slot = 0;
+    while (jit_ir->preds[block->first_pred + slot] != pred) {
+        slot++;
+    }
+    IrValue end = block->first;
+    while (jit_ir->insts[end].op == IrOp::PHI) {
+        end++;
+    }
+    for (IrValue phi = block->first; phi < end; phi++) {
+        IrValue operand = jit_ir->operands[jit_ir->insts[phi].operands.first + slot];
+        u32 bytes = jit_copy_bytes(phi);
+        if (end - block->first == 1 && !bytes) {
+            jit_get(X64_RAX, operand);
+            jit_set(phi, X64_RAX);
+            return;
+        }
+        if (bytes) {
+            jit_get(X64_R11, operand);
+            jit_copy(X64_RBP, jit_in_slots[phi], X64_R11, 0, bytes);
+        }
+        else {
+            jit_get(X64_RAX, operand);
+            jit_store64(X64_RBP, jit_in_slots[phi], X64_RAX);
+        }
+    }
+    for (IrValue phi = block->first; phi < end; phi++) {
+        u32 bytes = jit_copy_bytes(phi);
+        if (bytes) {
+            jit_copy(X64_RBP, jit_copies[phi], X64_RBP, jit_in_slots[phi], bytes);
+        }
+        else {
+            jit_load64(X64_RAX, X64_RBP, jit_in_slots[phi]);
+            jit_set(phi, X64_RAX);
+        }
+    }
+}
+
+Internal bool jit_has_phis(u32 block) {
+    IrBlock* it = jit_ir->blocks + block;
+    return it->num_insts && jit_ir->insts[it->first].op == IrOp::PHI;
+}
+
+//*label to jump to for an edge out of a branch, a block of its own when the edge has moves
+Internal u32 jit_edge_label(u32 pred, u32 succ) {
+    if (!jit_has_phis(succ)) {
+        return succ;
+    }
+    u32 label = (u32)jit_labels.size();
+    jit_labels.push_back(0);
+    jit_edges.push_back({ pred, succ, label });
+    return label;
+}
+
+//*instructions
+
+//*the two-operand ALU opcode with the destination in reg, 0 for the ops that need fixed registers
+Internal u32 jit_int_opcode(IrOp op) {
+    switch (op) {
+        case IrOp::ADD: {
+            return 0x03;
+        }
+        case IrOp::SUB: {
+            return 0x2B;
+        }
+        case IrOp::MUL: {
+            return 0x0FAF;
+        }
+        case IrOp::AND: {
+            return 0x23;
+        }
+        case IrOp::OR: {
+            return 0x0B;
+        }
+        case IrOp::XOR: {
+            return 0x33;
+        }
+        default: {
+            return 0;
+        }
+    }
+}
+
+//*rax op= rcx for a negation, shift, division or remainder, clobbers rdx
+Internal void jit_int_op_rcx(IrOp op, bool is_signed) {
+    switch (op) {
+        case IrOp::NEG: {
+            jit_op_reg(0, true, 0xF7, 3, X64_RAX);
+            break;
+        }
+        case IrOp::SHL:
+        case IrOp::SHR: {
+            jit_op_reg(0, true, 0xD3, op == IrOp::SHL ? 4 : is_signed ? 7 : 5, X64_RAX);
+            break;
+        }
+        case IrOp::DIV:
+        case IrOp::MOD: {
+            //*operands are extended to 64 bits, so the 64-bit division gives the quotient and remainder of any width
+            if (is_signed) {
+                jit_byte(0x48);
+                jit_byte(0x99);
+            }
+            else {
+                jit_op_reg(0, false, 0x31, X64_RDX, X64_RDX);
+            }
+            jit_op_reg(0, true, 0xF7, is_signed ? 7 : 6, X64_RCX);
+            if (op == IrOp::MOD) {
+                jit_mov(X64_RAX, X64_RDX);
+            }
+            break;
+        }
+        default: {
+            assert(false);
+            break;
+        }
+    }
+}
+
+Internal void jit_compile_int_arith(IrValue value, IrInst* inst, Type* type) {
+    jit_get(X64_RAX, inst->args[0]);
+    u32 opcode = jit_int_opcode(inst->op);
+    if (opcode) {
+        jit_op_value(0, true, opcode, X64_RAX, inst->args[1]);
+    }
+    else {
+        if (inst->op != IrOp::NEG) {
+            jit_get(X64_RCX, inst->args[1]);
+        }
+        jit_int_op_rcx(inst->op, is_signed_type(type));
+    }
+    jit_extend(X64_RAX, type);
+    jit_set(value, X64_RAX);
+}
+
+Internal void jit_compile_arith(IrValue value, IrInst* inst) {
+    Type* type = Global::types[inst->type];
+    if (!is_floating_type(type)) {
+        jit_compile_int_arith(value, inst, type);
+        return;
+    }
+    if (inst->op == IrOp::NEG) {
+        jit_get(X64_RAX, inst->args[0]);
+        jit_mov_imm(X64_RCX, type->kind == TypeKind::FLOAT ? 0x80000000ull : 0x8000000000000000ull);
+        jit_op_reg(0, true, 0x31, X64_RCX, X64_RAX);
+        jit_set(value, X64_RAX);
+        return;
+    }
+    u32 opcode = 0;
+    switch (inst->op) {
+        case IrOp::ADD: {
+            opcode = 0x0F58;
+            break;
+        }
+        case IrOp::SUB: {
+            opcode = 0x0F5C;
+            break;
+        }
+        case IrOp::MUL: {
+            opcode = 0x0F59;
+            break;
+        }
+        case IrOp::DIV: {
+            opcode = 0x0F5E;
+            break;
+        }
+        default: {
+            assert(false);
+            break;
+        }
+    }
+    jit_sse_get(type, 0, inst->args[0]);
+    jit_op_value(jit_sse_prefix(type), false, opcode, 0, inst->args[1]);
+    jit_sse_set(type, value, 0);
+}
+
+//*ucomiss or ucomisd of two xmm registers
+Internal void jit_ucomi(Type* type, u32 left, u32 right) {
+    jit_op_reg(type->kind == TypeKind::FLOAT ? 0 : 0x66, false, 0x0F2E, left, right);
+}
+
+Internal void jit_compile_compare(IrValue value, IrInst* inst) {
+    Type* type = jit_type(inst->args[0]);
+    IrOp op = inst->op;
+    if (is_floating_type(type)) {
+        //*an unordered compare sets zf, pf and cf, so only ne holds for a nan
+        bool swap = op == IrOp::LT || op == IrOp::LE;
+        jit_sse_get(type, 0, inst->args[swap ? 1 : 0]);
+        jit_sse_get(type, 1, inst->args[swap ? 0 : 1]);
+        jit_ucomi(type, 0, 1);
+        if (op == IrOp::EQ || op == IrOp::NE) {
+            jit_setcc(op == IrOp::EQ ? X64_E : X64_NE, X64_RAX);
+            jit_setcc(op == IrOp::EQ ? X64_NP : X64_P, X64_RCX);
+            jit_op_reg(0, false, op == IrOp::EQ ? 0x20 : 0x08, X64_RCX, X64_RAX);
+        }
+        else {
+            jit_setcc(op == IrOp::LT || op == IrOp::GT ? X64_A : X64_AE, X64_RAX);
+        }
+    }
+    else {
+        bool is_signed = is_signed_type(type);
+        u32 cond = X64_E;
+        switch (op) {
+            case IrOp::NE: {
+                cond = X64_NE;
+                break;
+            }
+            case IrOp::LT: {
+                cond = is_signed ? X64_L : X64_B;
+                break;
+            }
+            case IrOp::LE: {
+                cond = is_signed ? X64_LE : X64_BE;
+                break;
+            }
+            case IrOp::GT: {
+                cond = is_signed ? X64_G : X64_A;
+                break;
+            }
+            case IrOp::GE: {
+                cond = is_signed ? X64_GE : X64_AE;
+                break;
+            }
+            default: {
+                break;
+            }
+        }
+        jit_get(X64_RAX, inst->args[0]);
+        jit_op_value(0, true, 0x3B, X64_RAX, inst->args[1]);
+        jit_setcc(cond, X64_RAX);
+    }
+    jit_bool_result();
+    jit_set(value, X64_RAX);
+}
+
+Internal void jit_compile_convert(IrValue value, IrInst* inst) {
+    Type* to = Global::types[inst->type];
+    Type* from = jit_type(inst->args[0]);
+    if (to->kind == TypeKind::BOOL && is_floating_type(from)) {
+        jit_sse_get(from, 0, inst->args[0]);
+        jit_op_reg(0, false, 0x0F57, 1, 1);
+        jit_ucomi(from, 0, 1);
+        jit_setcc(X64_NE, X64_RAX);
+        jit_setcc(X64_P, X64_RCX);
+        jit_op_reg(0, false, 0x08, X64_RCX, X64_RAX);
+        jit_bool_result();
+        jit_set(value, X64_RAX);
+    }
+    else if (to->kind == TypeKind::BOOL) {
+        jit_get(X64_RAX, inst->args[0]);
+        jit_op_reg(0, true, 0x85, X64_RAX, X64_RAX);
+        jit_setcc(X64_NE, X64_RAX);
+        jit_bool_result();
+        jit_set(value, X64_RAX);
+    }
+    else if (is_floating_type(to) && is_floating_type(from)) {
+        jit_sse_get(from, 0, inst->args[0]);
+        if (to->kind != from->kind) {
+            jit_op_reg(jit_sse_prefix(from), false, 0x0F5A, 0, 0);
+        }
+        jit_sse_set(to, value, 0);
+    }
+    else if (is_floating_type(to)) {
+        jit_get(X64_RAX, inst->args[0]);
+        u32 prefix = jit_sse_prefix(to);
+        if (is_signed_type(from) || from->size < 8) {
+            jit_op_reg(prefix, true, 0x0F2A, 0, X64_RAX);
+        }
+        else {
+            //*an unsigned 64-bit value past the signed range is halved, keeping its low bit for the rounding, and doubled
+            jit_op_reg(0, true, 0x85, X64_RAX, X64_RAX);
+            u32 big = jit_jcc_forward(X64_S);
+            jit_op_reg(prefix, true, 0x0F2A, 0, X64_RAX);
+            u32 done = jit_jmp_forward();
+            jit_land(big);
+            jit_mov(X64_RCX, X64_RAX);
+            jit_shift_imm(5, X64_RCX, 1);
+            jit_op_reg(0, false, 0x83, 4, X64_RAX);
+            jit_byte(1);
+            jit_op_reg(0, true, 0x09, X64_RAX, X64_RCX);
+            jit_op_reg(prefix, true, 0x0F2A, 0, X64_RCX);
+            jit_op_reg(prefix, false, 0x0F58, 0, 0);
+            jit_land(done);
+        }
+        jit_sse_set(to, value, 0);
+    }
+    else if (is_floating_type(from)) {
+        u32 prefix = jit_sse_prefix(from);
+        jit_sse_get(from, 0, inst->args[0]);
+        if (!is_signed_type(to) && to->size == 8) {
+            //*values from 2^63 up are truncated less 2^63, which the top bit adds back
+            jit_mov_imm(X64_RAX, from->kind == TypeKind::FLOAT ? 0x5F000000ull : 0x43E0000000000000ull);
+            jit_op_reg(0x66, from->kind != TypeKind::FLOAT, 0x0F6E, 1, X64_RAX);
+            jit_ucomi(from, 0, 1);
+            u32 big = jit_jcc_forward(X64_AE);
+            jit_op_reg(prefix, true, 0x0F2C, X64_RAX, 0);
+            u32 done = jit_jmp_forward();
+            jit_land(big);
+            jit_op_reg(prefix, false, 0x0F5C, 0, 1);
+            jit_op_reg(prefix, true, 0x0F2C, X64_RAX, 0);
+            jit_op_reg(0, true, 0x0FBA, 7, X64_RAX);
+            jit_byte(63);
+            jit_land(done);
+        }
+        else {
+            jit_op_reg(prefix, true, 0x0F2C, X64_RAX, 0);
+            jit_extend(X64_RAX, to);
+        }
+        jit_set(value, X64_RAX);
+    }
+    else {
+        jit_get(X64_RAX, inst->args[0]);
+        jit_extend(X64_RAX, to);
+        jit_set(value, X64_RAX);
+    }
+}
+
+Internal void jit_compile_access(IrValue value, IrInst* inst) {
+    bool is_load = inst->op == IrOp::LOAD;
+    Type* type = is_load ? Global::types[inst->type] : jit_type(inst->args[1]);
+    if (jit_is_aggregate(type)) {
+        jit_get(X64_R11, inst->args[0]);
+        if (is_load) {
+            jit_copy(X64_RBP, jit_copies[value], X64_R11, 0, (u32)type->size);
+            jit_lea(X64_RAX, X64_RBP, jit_copies[value]);
+            jit_set(value, X64_RAX);
+        }
+        else {
+            jit_get(X64_RDX, inst->args[1]);
+            jit_copy(X64_R11, 0, X64_RDX, 0, (u32)type->size);
+        }
+        return;
+    }
+    u32 base = jit_use(X64_RCX, inst->args[0]);
+    if (is_load) {
+        jit_load(X64_RAX, type, base, 0);
+        jit_set(value, X64_RAX);
+    }
+    else {
+        jit_store(base, 0, jit_use(X64_RAX, inst->args[1]), (u32)type->size);
+    }
+}
+
+//*a float part of an aggregate moves as a float, two floats or a double as a double
+Internal Type* jit_part_type(u32 bytes) {
+    return bytes == 4 ? Global::type_float : Global::type_double;
+}
+
+Internal void jit_compile_call(IrValue value, IrInst* inst) {
+    Type* ret = Global::types[inst->type];
+    std::vector<Type*> types;
+    std::vector<JitArg> args;
+    jit_arg_types(inst, &types);
+    bool hidden_ret = jit_returns_in_memory(ret);
+    jit_place_args(types.data(), types.size(), hidden_ret, &args);
+
+    //*copies first, they take rcx, rsi and rdi which may carry arguments
+    for (size_t i = 0; i < args.size(); i++) {
+        JitArg* arg = &args[i];
+        IrValue operand = jit_ir->operands[inst->operands.first + i];
+        u32 size = (u32)types[i]->size;
+        i32 copy = jit_arg_copies[inst->operands.first + i];
+        if (arg->pass.by_ref) {
+            jit_get(X64_R11, operand);
+            jit_copy(X64_RBP, copy, X64_R11, 0, size);
+        }
+        if (!arg->on_stack) {
+            continue;
+        }
+        i32 disp = (i32)arg->stack_offset;
+        if (arg->pass.by_ref) {
+            jit_lea(X64_RAX, X64_RBP, copy);
+            jit_store64(X64_RSP, disp, X64_RAX);
+        }
+        else if (jit_is_aggregate(types[i])) {
+            jit_get(X64_R11, operand);
+            jit_copy(X64_RSP, disp, X64_R11, 0, size);
+        }
+        else {
+            jit_get(X64_RAX, operand);
+            jit_store64(X64_RSP, disp, X64_RAX);
+        }
+    }
+
+    u32 num_sse = 0;
+    for (size_t i = 0; i < args.size(); i++) {
+        JitArg* arg = &args[i];
+        IrValue operand = jit_ir->operands[inst->operands.first + i];
+        if (arg->on_stack) {
+            continue;
+        }
+        if (arg->pass.by_ref) {
+            jit_lea(arg->regs[0], X64_RBP, jit_arg_copies[inst->operands.first + i]);
+        }
+        else if (jit_is_aggregate(types[i])) {
+            jit_get(X64_R11, operand);
+            for (u32 k = 0; k < arg->pass.num_parts; k++) {
+                if (arg->pass.is_sse[k]) {
+                    jit_sse_load(jit_part_type(arg->pass.part_bytes[k]), arg->regs[k], X64_R11, (i32)k * 8);
+                    num_sse++;
+                }
+                else {
+                    jit_load_bytes(arg->regs[k], X64_R11, (i32)k * 8, arg->pass.part_bytes[k]);
+                }
+            }
+        }
+        else if (is_floating_type(types[i])) {
+            jit_sse_get(types[i], arg->regs[0], operand);
+            num_sse++;
+        }
+        else {
+            jit_get(arg->regs[0], operand);
+        }
+    }
+    if (hidden_ret) {
+        jit_lea(jit_int_arg_regs[0], X64_RBP, jit_copies[value]);
+    }
+
+    IrInst* callee = jit_ir->insts + inst->args[0];
+    if (callee->op == IrOp::GLOBAL && callee->sym->kind == SymKind::FUNC) {
+        //*a variadic C callee learns from al how many vector registers carry arguments
+#ifndef _WIN32
+        jit_mov_imm(X64_RAX, num_sse);
+#endif
+        jit_byte(0xE8);
+        jit_func_fixups.push_back({ (u32)jit_code.size(), callee->sym });
+        jit_u32(0);
+    }
+    else {
+        jit_get(X64_R11, inst->args[0]);
+#ifndef _WIN32
+        jit_mov_imm(X64_RAX, num_sse);
+#endif
+        jit_op_reg(0, false, 0xFF, 2, X64_R11);
+    }
+
+    if (ret->kind == TypeKind::VOID) {
+        return;
+    }
+    if (jit_is_aggregate(ret)) {
+        JitPass pass = jit_classify(ret);
+        u8 regs[2];
+        jit_ret_regs(pass, regs);
+        i32 copy = jit_copies[value];
+        for (u32 k = 0; k < pass.num_parts; k++) {
+            if (pass.is_sse[k]) {
+                jit_sse_store(jit_part_type(pass.part_bytes[k]), X64_RBP, copy + (i32)k * 8, regs[k]);
+            }
+            else {
+                jit_store_bytes(X64_RBP, copy + (i32)k * 8, regs[k], pass.part_bytes[k]);
+            }
+        }
+        jit_lea(X64_RAX, X64_RBP, copy);
+        jit_set(value, X64_RAX);
+    }
+    else if (is_floating_type(ret)) {
+        jit_sse_set(ret, value, 0);
+    }
+    else {
+        //*C leaves the high bits of a narrow result unspecified
+        jit_extend(X64_RAX, ret);
+        jit_set(value, X64_RAX);
+    }
+}
+
+Internal void jit_compile_return(IrInst* inst) {
+    Type* ret = jit_ir->sym->type->func.ret;
+    IrValue value = inst->args[0];
+    if (!value) {
+        jit_emit_epilogue();
+        return;
+    }
+    if (jit_returns_in_memory(ret)) {
+        //*the caller's copy is written and its address returned
+        jit_load64(X64_R11, X64_RBP, jit_ret_slot);
+        jit_get(X64_RDX, value);
+        jit_copy(X64_R11, 0, X64_RDX, 0, (u32)ret->size);
+        jit_mov(X64_RAX, X64_R11);
+    }
+    else if (jit_is_aggregate(ret)) {
+        JitPass pass = jit_classify(ret);
+        u8 regs[2];
+        jit_ret_regs(pass, regs);
+        jit_get(X64_R11, value);
+        for (u32 k = 0; k < pass.num_parts; k++) {
+            if (pass.is_sse[k]) {
+                jit_sse_load(jit_part_type(pass.part_bytes[k]), regs[k], X64_R11, (i32)k * 8);
+            }
+            else {
+                jit_load_bytes(regs[k], X64_R11, (i32)k * 8, pass.part_bytes[k]);
+            }
+        }
+    }
+    else if (is_floating_type(ret)) {
+        jit_sse_get(ret, 0, value);
+    }
+    else {
+        jit_get(X64_RAX, value);
+    }
+    jit_emit_epilogue();
+}
+
+Internal void jit_compile_branch(u32 block, IrInst* inst) {
+    u32 then_label = jit_edge_label(block, inst->targets[0]);
+    u32 else_label = jit_edge_label(block, inst->targets[1]);
+    u32 cond = jit_use(X64_RAX, inst->args[0]);
+    jit_op_reg(0, true, 0x85, cond, cond);
+    if (then_label == block + 1) {
+        jit_jcc(X64_E, else_label);
+        return;
+    }
+    jit_jcc(X64_NE, then_label);
+    if (else_label != block + 1) {
+        jit_jmp(else_label);
+    }
+}
+
+//*vectors
+
+//*movdqu between an xmm register and memory, the copies of vectors need no alignment
+Internal void jit_vec_load(u32 xmm, u32 base, i32 disp) {
+    jit_op_mem(0xF3, false, 0x0F6F, xmm, base, disp);
+}
+
+Internal void jit_vec_store(u32 base, i32 disp, u32 xmm) {
+    jit_op_mem(0xF3, false, 0x0F7F, xmm, base, disp);
+}
+
+//*the SSE2 instruction of an elementwise op on lanes of type, false when SSE2 has none and the lanes go one by one
+Internal bool jit_vec_opcode(IrOp op, Type* type, u32* prefix, u32* opcode) {
+    *prefix = 0x66;
+    if (is_floating_type(type)) {
+        *prefix = type->kind == TypeKind::FLOAT ? 0 : 0x66;
+        *opcode = op == IrOp::ADD ? 0x0F58 : op == IrOp::SUB ? 0x0F5C : op == IrOp::MUL ? 0x0F59 : op == IrOp::DIV ? 0x0F5E : 0;
+        return *opcode != 0;
+    }
+    //*paddb/w/d/q and psubb/w/d/q by lane size, pmullw is the one multiply
+    u32 width = type->size == 1 ? 0 : type->size == 2 ? 1 : type->size == 4 ? 2 : 3;
+    GlobalVariable const u32 add[] = { 0x0FFC, 0x0FFD, 0x0FFE, 0x0FD4 };
+    GlobalVariable const u32 sub[] = { 0x0FF8, 0x0FF9, 0x0FFA, 0x0FFB };
+    switch (op) {
+        case IrOp::ADD: {
+            *opcode = add[width];
+            break;
+        }
+        case IrOp::SUB: {
+            *opcode = sub[width];
+            break;
+        }
+        case IrOp::MUL: {
+            *opcode = type->size == 2 ? 0x0FD5 : 0;
+            break;
+        }
+        case IrOp::AND: {
+            *opcode = 0x0FDB;
+            break;
+        }
+        case IrOp::OR: {
+            *opcode = 0x0FEB;
+            break;
+        }
+        case IrOp::XOR: {
+            *opcode = 0x0FEF;
+            break;
+        }
+        default: {
+            *opcode = 0;
+            break;
+        }
+    }
+    return *opcode != 0;
+}
+
+//*an elementwise op without an SSE2 instruction, lane by lane on rax and rcx from the copies addressed by r11 and r10
+Internal void jit_vec_lanes(IrValue value, IrInst* inst, Type* type) {
+    u32 size = (u32)type->size;
+    jit_get(X64_R11, inst->args[0]);
+    if (inst->args[1]) {
+        jit_get(X64_R10, inst->args[1]);
+    }
+    for (u32 i = 0; i < inst->lanes; i++) {
+        i32 disp = (i32)(i * size);
+        if (is_floating_type(type)) {
+            //*only negation is left for floats, it flips the sign bit
+            assert(inst->op == IrOp::NEG);
+            jit_load_piece(X64_RAX, size, X64_R11, disp);
+            jit_mov_imm(X64_RCX, size == 4 ? 0x80000000ull : 0x8000000000000000ull);
+            jit_op_reg(0, true, 0x31, X64_RCX, X64_RAX);
+        }
+        else {
+            jit_load(X64_RAX, type, X64_R11, disp);
+            if (inst->args[1]) {
+                jit_load(X64_RCX, type, X64_R10, disp);
+            }
+            //*a conversion between integers of one size keeps the bits
+            u32 opcode = jit_int_opcode(inst->op);
+            if (opcode) {
+                jit_op_reg(0, true, opcode, X64_RAX, X64_RCX);
+            }
+            else if (inst->op != IrOp::CONVERT) {
+                jit_int_op_rcx(inst->op, is_signed_type(type));
+            }
+        }
+        jit_store(X64_RBP, jit_copies[value] + disp, X64_RAX, size);
+    }
+    jit_lea(X64_RAX, X64_RBP, jit_copies[value]);
+    jit_set(value, X64_RAX);
+}
+
+//*a vector value is the address of its copy in the frame, like an aggregate, and never gets a register. arithmetic
+//*SSE2 has runs on xmm0 and xmm1, a splat and a reduction go through the lanes
+Internal void jit_compile_vector(IrValue value, IrInst* inst) {
+    Type* type = Global::types[inst->type];
+    switch (inst->op) {
+        case IrOp::PHI: {
+            return;
+        }
+        case IrOp::LOAD: {
+            jit_vec_load(0, jit_use(X64_R11, inst->args[0]), 0);
+            break;
+        }
+        case IrOp::STORE: {
+            u32 base = jit_use(X64_R11, inst->args[0]);
+            jit_get(X64_RDX, inst->args[1]);
+            jit_vec_load(0, X64_RDX, 0);
+            jit_vec_store(base, 0, 0);
+            return;
+        }
+        case IrOp::SPLAT: {
+            jit_get(X64_RAX, inst->args[0]);
+            for (u32 i = 0; i < inst->lanes; i++) {
+                jit_store(X64_RBP, jit_copies[value] + (i32)(i * type->size), X64_RAX, (u32)type->size);
+            }
+            jit_lea(X64_RAX, X64_RBP, jit_copies[value]);
+            jit_set(value, X64_RAX);
+            return;
+        }
+        case IrOp::REDUCE_ADD: {
+            IrInst* vec = jit_ir->insts + inst->args[0];
+            jit_get(X64_R11, inst->args[0]);
+            if (is_floating_type(type)) {
+                jit_sse_load(type, 0, X64_R11, 0);
+                for (u32 i = 1; i < vec->lanes; i++) {
+                    jit_op_mem(jit_sse_prefix(type), false, 0x0F58, 0, X64_R11, (i32)(i * type->size));
+                }
+                jit_sse_set(type, value, 0);
+                return;
+            }
+            jit_load(X64_RAX, type, X64_R11, 0);
+            for (u32 i = 1; i < vec->lanes; i++) {
+                jit_load(X64_RCX, type, X64_R11, (i32)(i * type->size));
+                jit_op_reg(0, true, 0x03, X64_RAX, X64_RCX);
+            }
+            jit_extend(X64_RAX, type);
+            jit_set(value, X64_RAX);
+            return;
+        }
+        default: {
+            u32 prefix = 0;
+            u32 opcode = 0;
+            if (inst->op == IrOp::NEG && !is_floating_type(type)) {
+                //*0 - x
+                jit_get(X64_R11, inst->args[0]);
+                jit_op_reg(0x66, false, 0x0FEF, 0, 0);
+                jit_vec_load(1, X64_R11, 0);
+                jit_vec_opcode(IrOp::SUB, type, &prefix, &opcode);
+                jit_op_reg(prefix, false, opcode, 0, 1);
+            }
+            else if (inst->op != IrOp::CONVERT && jit_vec_opcode(inst->op, type, &prefix, &opcode)) {
+                jit_get(X64_R11, inst->args[0]);
+                jit_get(X64_R10, inst->args[1]);
+                jit_vec_load(0, X64_R11, 0);
+                jit_vec_load(1, X64_R10, 0);
+                jit_op_reg(prefix, false, opcode, 0, 1);
+            }
+            else {
+                jit_vec_lanes(value, inst, type);
+                return;
+            }
+            break;
+        }
+    }
+    jit_vec_store(X64_RBP, jit_copies[value], 0);
+    jit_lea(X64_RAX, X64_RBP, jit_copies[value]);
+    jit_set(value, X64_RAX);
+}
+
+Internal void jit_compile_inst(u32 block, IrValue value) {
+    IrInst* inst = jit_ir->insts + value;
+    Type* type = Global::types[inst->type];
+    bool stores_vector = inst->op == IrOp::STORE && jit_ir->insts[inst->args[1]].lanes;
+    if (inst->lanes || stores_vector || inst->op == IrOp::REDUCE_ADD) {
+        jit_compile_vector(value, inst);
+        return;
+    }
+    switch (inst->op) {
+        case IrOp::NOP:
+        case IrOp::PHI: {
+            break;
+        }
+        case IrOp::PARAM: {
+            //*the prologue stored the argument in the slot
+            i32 reg = ra_def_reg(&jit_ra, value);
+            if (reg >= 0) {
+                jit_load_reg(value, (u32)reg);
+            }
+            break;
+        }
+        case IrOp::UNDEF: {
+            if (jit_is_aggregate(type)) {
+                jit_lea(X64_RAX, X64_RBP, jit_copies[value]);
+            }
+            else {
+                jit_op_reg(0, false, 0x31, X64_RAX, X64_RAX);
+            }
+            jit_set(value, X64_RAX);
+            break;
+        }
+        case IrOp::CONST_INT: {
+            jit_mov_imm(X64_RAX, (u64)inst->int_val);
+            jit_extend(X64_RAX, type);
+            jit_set(value, X64_RAX);
+            break;
+        }
+        case IrOp::CONST_FLOAT: {
+            u64 bits = 0;
+            if (type->kind == TypeKind::FLOAT) {
+                f32 val = (f32)inst->float_val;
+                memcpy(&bits, &val, sizeof(val));
+            }
+            else {
+                memcpy(&bits, &inst->float_val, sizeof(bits));
+            }
+            jit_mov_imm(X64_RAX, bits);
+            jit_set(value, X64_RAX);
+            break;
+        }
+        case IrOp::GLOBAL: {
+            if (inst->sym->kind == SymKind::FUNC) {
+                //*lea rax, [rip + rel32] to the entry of the func
+                jit_lea_rip();
+                jit_func_fixups.push_back({ (u32)jit_code.size(), inst->sym });
+                jit_u32(0);
+            }
+            else if (jit_relocs) {
+                jit_lea_rip();
+                jit_relocs->push_back({ (u32)jit_code.size(), inst->sym, nullptr });
+                jit_u32(0);
+            }
+            else {
+                u8* addr = jit_global_addr(jit_program, inst->sym);
+                if (!addr) {
+                    fatal("%s uses %s, which has no memory in the JIT", jit_ir->sym->name, inst->sym->name);
+                }
+                jit_mov_imm(X64_RAX, (u64)(uintptr_t)addr);
+            }
+            jit_set(value, X64_RAX);
+            break;
+        }
+        case IrOp::STR: {
+            if (jit_relocs) {
+                jit_lea_rip();
+                jit_relocs->push_back({ (u32)jit_code.size(), nullptr, inst->str });
+                jit_u32(0);
+            }
+            else {
+                jit_mov_imm(X64_RAX, (u64)(uintptr_t)inst->str);
+            }
+            jit_set(value, X64_RAX);
+            break;
+        }
+        case IrOp::ADD:
+        case IrOp::SUB:
+        case IrOp::MUL:
+        case IrOp::DIV:
+        case IrOp::MOD:
+        case IrOp::AND:
+        case IrOp::OR:
+        case IrOp::XOR:
+        case IrOp::SHL:
+        case IrOp::SHR:
+        case IrOp::NEG: {
+            jit_compile_arith(value, inst);
+            break;
+        }
+        case IrOp::EQ:
+        case IrOp::NE:
+        case IrOp::LT:
+        case IrOp::LE:
+        case IrOp::GT:
+        case IrOp::GE: {
+            jit_compile_compare(value, inst);
+            break;
+        }
+        case IrOp::CONVERT: {
+            jit_compile_convert(value, inst);
+            break;
+        }
+        case IrOp::ALLOCA: {
+            jit_lea(X64_RAX, X64_RBP, jit_copies[value]);
+            jit_set(value, X64_RAX);
+            break;
+        }
+        case IrOp::LOAD:
+        case IrOp::STORE: {
+            jit_compile_access(value, inst);
+            break;
+        }
+        case IrOp::ZERO: {
+            jit_zero(jit_use(X64_R11, inst->args[0]), 0, (u32)inst->int_val);
+            break;
+        }
+        case IrOp::ELEM_ADDR: {
+            jit_get(X64_RAX, inst->args[0]);
+            jit_get(X64_RCX, inst->args[1]);
+            jit_op_reg(0, true, 0x69, X64_RCX, X64_RCX);
+            jit_u32((u32)type->ptr.base->size);
+            jit_op_reg(0, true, 0x01, X64_RCX, X64_RAX);
+            jit_set(value, X64_RAX);
+            break;
+        }
+        case IrOp::FIELD_ADDR: {
+            jit_get(X64_RAX, inst->args[0]);
+            if (inst->int_val) {
+                jit_add_imm(X64_RAX, (i32)inst->int_val);
+            }
+            jit_set(value, X64_RAX);
+            break;
+        }
+        case IrOp::CALL: {
+            jit_compile_call(value, inst);
+            break;
+        }
+        case IrOp::JUMP: {
+            jit_emit_phi_moves(block, inst->targets[0]);
+            if (inst->targets[0] != block + 1) {
+                jit_jmp(inst->targets[0]);
+            }
+            break;
+        }
+        case IrOp::BRANCH: {
+            jit_compile_branch(block, inst);
+            break;
+        }
+        case IrOp::RETURN: {
+            jit_compile_return(inst);
+            break;
+        }
+        default: {
+            fatal("%s: the JIT does not compile %s", jit_ir->sym->name, ir_dump(jit_ir).c_str());
+            break;
+        }
+    }
+}
+
+Internal void jit_compile_func(IrFunc* func) {
+    jit_ir = func;
+    ra_allocate(func, jit_target, &jit_ra);
+    jit_layout_frame();
+    if (jit_frame_bytes + jit_out_bytes > INT32_MAX / 2) {
+        fatal("%s has too large a frame for the JIT", func->sym->name);
+    }
+    jit_labels.assign(func->num_blocks, 0);
+    jit_fixups.clear();
+    jit_edges.clear();
+    jit_emit_prologue();
+    size_t next_reload = 0;
+    for (u32 b = 0; b < func->num_blocks; b++) {
+        jit_labels[b] = (u32)jit_code.size();
+        IrBlock* block = func->blocks + b;
+        for (IrValue v = block->first; v < block->first + block->num_insts; v++) {
+            jit_pos = jit_ra.positions[v];
+            for (; next_reload < jit_ra.reloads.size() && jit_ra.reloads[next_reload].pos == jit_pos; next_reload++) {
+                jit_load_reg(jit_ra.reloads[next_reload].value, jit_ra.reloads[next_reload].reg);
+            }
+            jit_compile_inst(b, v);
+        }
+    }
+    assert(next_reload == jit_ra.reloads.size());
+    for (size_t i = 0; i < jit_edges.size(); i++) {
+        JitEdge edge = jit_edges[i];
+        jit_labels[edge.label] = (u32)jit_code.size();
+        jit_emit_phi_moves(edge.pred, edge.succ);
+        jit_jmp(edge.succ);
+    }
+    for (JitFixup& it : jit_fixups) {
+        jit_patch_rel32(it.pos, jit_labels[it.label]);
+    }
+}
+
+//*entries are 16-byte aligned, the padding traps
+Internal u32 jit_begin_func() {
+    while (jit_code.size() % 16) {
+        jit_byte(0xCC);
+    }
+    return (u32)jit_code.size();
+}
+
+Internal size_t jit_page_bytes() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+//*copies the code into fresh pages and only then makes them executable, they are never writable and executable at once
+Internal void jit_map_code(JitProgram* program) {
+    size_t page = jit_page_bytes();
+    program->code_bytes = (jit_code.size() + page - 1) / page * page;
+#ifdef _WIN32
+    u8* mem = (u8*)VirtualAlloc(nullptr, program->code_bytes, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (!mem) {
+        fatal("cannot allocate %zu bytes of code memory", program->code_bytes);
+    }
+    memcpy(mem, jit_code.data(), jit_code.size());
+    DWORD old_protect;
+    if (!VirtualProtect(mem, program->code_bytes, PAGE_EXECUTE_READ, &old_protect)) {
+        fatal("cannot make the code memory executable");
+    }
+    FlushInstructionCache(GetCurrentProcess(), mem, program->code_bytes);
+#else
+    void* mem = mmap(nullptr, program->code_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        fatal("cannot allocate %zu bytes of code memory", program->code_bytes);
+    }
+    memcpy(mem, jit_code.data(), jit_code.size());
+    if (mprotect(mem, program->code_bytes, PROT_READ | PROT_EXEC) != 0) {
+        fatal("cannot make the code memory executable");
+    }
+#endif
+    program->code = (u8*)mem;
+}
+
+//*compiles every func of the package and then init into jit_code, with the calls between them patched. returns the
+//*entry of init
+Internal u32 jit_compile_funcs(std::vector<std::pair<Sym*, u32>>* func_offsets, IrFunc* init) {
+    jit_code.clear();
+    jit_func_fixups.clear();
+    func_offsets->clear();
+    std::unordered_map<Sym*, u32> entries;
+    for (Sym* it : Global::syms) {
+        if (it->kind == SymKind::FUNC) {
+            IrFunc* func = ir_optimize(ir_lower_func(it));
+            u32 entry = jit_begin_func();
+            jit_compile_func(func);
+            func_offsets->push_back({ it, entry });
+            entries[it] = entry;
+        }
+    }
+    u32 init_entry = 0;
+    if (init) {
+        init_entry = jit_begin_func();
+        jit_compile_func(init);
+    }
+
+    for (JitFuncFixup& it : jit_func_fixups) {
+        auto entry = entries.find(it.sym);
+        if (entry == entries.end()) {
+            fatal("the JIT has no code for %s", it.sym->name);
+        }
+        jit_patch_rel32(it.pos, entry->second);
+    }
+    return init_entry;
+}
+
+void jit_compile_package(JitProgram* program) {
+    if (!jit_is_supported()) {
+        fatal("the JIT only compiles for x86-64 hosts");
+    }
+    jit_program = program;
+    program->global_offsets.clear();
+    u32 global_bytes = 0;
+    for (Sym* it : Global::syms) {
+        if (it->kind == SymKind::VAR) {
+            u32 align = it->type->align ? (u32)it->type->align : 1;
+            global_bytes = (global_bytes + align - 1) / align * align;
+            program->global_offsets.push_back({ it, global_bytes });
+            global_bytes += (u32)it->type->size;
+        }
+    }
+    program->globals = (u8*)xcalloc(1, global_bytes ? global_bytes : 1);
+
+    Sym init = {};
+    init.name = Global::string_table.add("global_init");
+    init.kind = SymKind::FUNC;
+    init.type = type_func(nullptr, 0, Global::type_void);
+    u32 init_entry = jit_compile_funcs(&program->func_offsets, ir_lower_global_init(&init));
+    jit_map_code(program);
+    jit_code.clear();
+    jit_code.shrink_to_fit();
+
+    void (*init_func)() = (void (*)())(uintptr_t)(program->code + init_entry);
+    init_func();
+}
+
+void jit_compile_code(JitCode* out, IrFunc* init) {
+    jit_program = nullptr;
+    jit_relocs = &out->relocs;
+    out->relocs.clear();
+    out->init_entry = jit_compile_funcs(&out->func_offsets, init);
+    out->code.swap(jit_code);
+    jit_code.clear();
+    jit_relocs = nullptr;
+}
+
+void jit_free(JitProgram* program) {
+    if (program->code) {
+#ifdef _WIN32
+        VirtualFree(program->code, 0, MEM_RELEASE);
+#else
+        munmap(program->code, program->code_bytes);
+#endif
+    }
+    free(program->globals);
+    program->code = nullptr;
+    program->code_bytes = 0;
+    program->globals = nullptr;
+    program->func_offsets.clear();
+    program->global_offsets.clear();
+}
+
+void* jit_find_func(JitProgram* program, const char* name) {
+    const char* interned = Global::string_table.add(name);
+    for (std::pair<Sym*, u32>& it : program->func_offsets) {
+        if (it.first->name == interned) {
+            return program->code + it.second;
+        }
+    }
+    return nullptr;
+}
+
+u8* jit_global_addr(JitProgram* program, Sym* sym) {
+    for (std::pair<Sym*, u32>& it : program->global_offsets) {
+        if (it.first == sym) {
+            return program->globals + it.second;
+        }
+    }
+    return nullptr;
+}
+
+int jit_run_file(const char* path) {
+    if (!jit_is_supported()) {
+        printf("the JIT only runs on x86-64 hosts\n");
+        return 1;
+    }
+    Sym* main_sym = load_package_file(path) ? package_main_func(path) : nullptr;
+    if (!main_sym) {
+        return 1;
+    }
+    JitProgram program = {};
+    jit_compile_package(&program);
+    void* entry = jit_find_func(&program, "main");
+    int result = 0;
+    if (main_sym->type->func.ret->kind == TypeKind::VOID) {
+        ((void (*)())(uintptr_t)entry)();
+    }
+    else {
+        result = (int)((u64 (*)())(uintptr_t)entry)();
+    }
+    jit_free(&program);
+    return result;
+}
+
+//*host functions the test program reaches through func values, in the layout of its structs
+struct JitTestVector {
+    i32 x, y;
+};
+
+struct JitTestPair {
+    f64 x;
+    i32 n;
+};
+
+struct JitTestTriple {
+    f64 x, y, z;
+};
+
+Internal i64 jit_test_sum8(i64 a, i64 b, i64 c, i64 d, i64 e, i64 f, i64 g, i64 h) {
+    return a + b * 2 + c * 3 + d * 4 + e * 5 + f * 6 + g * 7 + h * 8;
+}
+
+Internal f64 jit_test_mix(i32 a, f64 b, char c, f32 d) {
+    return a + b * 2 + c * 3 + d * 4;
+}
+
+Internal JitTestPair jit_test_swap(JitTestPair p) {
+    return { p.n + 0.5, (i32)p.x * 2 };
+}
+
+Internal JitTestTriple jit_test_scale(JitTestTriple t, f64 k) {
+    return { t.x * k, t.y * k, t.z * k };
+}
+
+Internal void jit_test_set(JitProgram* program, const char* name, void* func) {
+    Sym* sym = sym_get(Global::string_table.add(name));
+    assert(sym);
+    memcpy(jit_global_addr(program, sym), &func, sizeof(func));
+}
+
+Internal void* jit_test_func(JitProgram* program, const char* name) {
+    void* func = jit_find_func(program, name);
+    assert(func);
+    return func;
+}
+
+//*a corpus call through the signature of its func, its params are integers or a single double
+Internal u64 jit_test_corpus_call(JitProgram* program, const VmCorpusCall* call) {
+    Type* type = sym_get(Global::string_table.add(call->func))->type;
+    u64 args[2] = {};
+    for (size_t i = 0; i < type->func.num_params; i++) {
+        args[i] = vm_corpus_bits(type->func.params[i], call->args[i]);
+    }
+    void* func = jit_test_func(program, call->func);
+    bool double_arg = type->func.num_params == 1 && is_floating_type(type->func.params[0]);
+    u64 result = 0;
+    if (is_floating_type(type->func.ret)) {
+        f64 val = double_arg ? ((f64 (*)(f64))func)(call->args[0]) : ((f64 (*)(u64, u64))func)(args[0], args[1]);
+        memcpy(&result, &val, sizeof(result));
+    }
+    else {
+        result = double_arg ? ((u64 (*)(f64))func)(call->args[0]) : ((u64 (*)(u64, u64))func)(args[0], args[1]);
+    }
+    return vm_corpus_result(type->func.ret, result);
+}
+
+Internal void jit_test_package(const std::vector<u64>& expected) {
+    JitProgram program = {};
+    jit_compile_package(&program);
+    jit_test_set(&program, "sum8", (void*)&jit_test_sum8);
+    jit_test_set(&program, "mix", (void*)&jit_test_mix);
+    jit_test_set(&program, "swap", (void*)&jit_test_swap);
+    jit_test_set(&program, "scale3", (void*)&jit_test_scale);
+    jit_test_set(&program, "sort", (void*)&qsort);
+    jit_test_set(&program, "length", (void*)&strlen);
+
+    //*the corpus computes what the VM computes
+    for (size_t i = 0; i < vm_corpus_num_calls; i++) {
+        assert(jit_test_corpus_call(&program, vm_corpus_calls + i) == expected[i]);
+    }
+
+    //*comparisons of nan
+    assert(((i32 (*)(f64))jit_test_func(&program, "ordered"))(1.5) == 1 + 32 + 4 + 16);
+    assert(((i32 (*)(f64))jit_test_func(&program, "ordered"))(std::numeric_limits<f64>::quiet_NaN()) == 2);
+
+    //*structs by value both ways, in registers and in memory, and arguments past the registers
+    JitTestVector a = { 1, 2 };
+    JitTestVector b = { 30, 40 };
+    JitTestVector sum = ((JitTestVector (*)(JitTestVector, JitTestVector))jit_test_func(&program, "add"))(a, b);
+    assert(sum.x == 31 && sum.y == 42);
+    JitTestTriple t = { 1, 2, 3 };
+    JitTestTriple halved = ((JitTestTriple (*)(JitTestTriple, f64))jit_test_func(&program, "halve"))(t, 0.5);
+    assert(halved.x == 0.5 && halved.y == 1 && halved.z == 1.5);
+    assert(((f64 (*)())jit_test_func(&program, "call_pairs"))() == 2.5 + 4 + 100);
+
+    //*Sorin code calling C, and C calling back into Sorin
+    assert(((i64 (*)())jit_test_func(&program, "call_c"))() == 204 + 5);
+    assert(((f64 (*)(i32))jit_test_func(&program, "mixed_c"))(3) == 3 + 1 + 97 * 3 + 1);
+    assert(((f64 (*)(i32))jit_test_func(&program, "pair_c"))(7) == 7.5 + 4 * 10);
+    assert(((f64 (*)(f64))jit_test_func(&program, "triple_c"))(2) == 2 + 40 + 600);
+    assert(((i32 (*)())jit_test_func(&program, "sorted"))() == 13579);
+    jit_free(&program);
+}
+
+void jit_test() {
+    if (!jit_is_supported()) {
+        return;
+    }
+    //*structs by value and calls of C funcs, on top of the corpus
+    vm_corpus_load(
+        "struct Pair { x: double; n: int; }\n"
+        "var sum8: func(llong, llong, llong, llong, llong, llong, llong, llong): llong\n"
+        "var mix: func(int, double, char, float): double\n"
+        "var swap: func(Pair): Pair\n"
+        "var scale3: func(Triple, double): Triple\n"
+        "var sort: func(void*, ullong, ullong, func(void*, void*): int)\n"
+        "var length: func(char*): ullong\n"
+        "func ordered(x: double): int { r := 0; if (x > 1) { r += 1; } if (x == x) { r += 32; } else { r += 2; } if (x >= 1.5) { r += 4; }\n"
+        "    if (x < 1) { r += 8; } if (x == 1.5) { r += 16; } return r; }\n"
+        "func halve(t: Triple, k: double): Triple { t.x *= k; t.y *= k; t.z *= k; return t; }\n"
+        "func take_pairs(a: Pair, b: Pair, c: Pair, d: Pair, e: Pair, f: Pair, g: Pair, h: Pair, t: Triple): double {\n"
+        "    return a.x + h.n + t.z * 100; }\n"
+        "func call_pairs(): double { var p: Pair = {2.5, 4}\n var t: Triple = {0, 0, 1}\n return take_pairs(p, p, p, p, p, p, p, p, t); }\n"
+        "func call_c(): llong { return sum8(1, 2, 3, 4, 5, 6, 7, 8) + length(\"hello\"); }\n"
+        "func mixed_c(n: int): double { return mix(n, 0.5, 'a', 0.25); }\n"
+        "func pair_c(n: int): double { var p: Pair = {2.5, n}\n q := swap(p); return q.x + q.n * 10; }\n"
+        "func triple_c(k: double): double { var t: Triple = {1, 2, 3}\n u := scale3(t, k); return u.x + u.y * 10 + u.z * 100; }\n"
+        "func compare(a: void*, b: void*): int { var x: int* = a\n var y: int* = b\n return *x - *y; }\n"
+        "func sorted(): int { var xs: int[5]\n xs[0] = 5; xs[1] = 3; xs[2] = 9; xs[3] = 1; xs[4] = 7;\n"
+        "    sort(&xs[0], 5, sizeof(xs[0]), compare); return xs[0] * 10000 + xs[1] * 1000 + xs[2] * 100 + xs[3] * 10 + xs[4]; }\n");
+    std::vector<u64> expected = vm_corpus_results();
+    jit_test_package(expected);
+    //*and the IR as lowered, where params and loop variables feed phis directly
+    Global::ir_passes = 0;
+    jit_test_package(expected);
+    Global::ir_passes = 0xFFFFFFFF;
+
+    //*with two integer registers and one xmm register values are split and reloaded, and with none at all every value
+    //*stays in its slot
+    const RaReg int_regs[] = { { X64_RBX, true }, { X64_R8, false } };
+    const RaReg sse_regs[] = { { 2, false } };
+    const RaTarget narrow = { "narrow", { int_regs, sse_regs }, { 2, 1 } };
+    jit_target = &narrow;
+    jit_test_package(expected);
+    jit_target = &jit_ra_target;
+    Global::native_regalloc = false;
+    jit_test_package(expected);
+    Global::native_regalloc = true;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <vector>
+#include "Ir.hpp"
+
+//*x86-64 machine code compiled from the optimized IR into executable memory of the host process. the code keeps the
+//*host calling convention, System V on unix and the Microsoft x64 convention on windows, so the driver calls Sorin
+//*funcs through plain function pointers and Sorin code calls C functions through func values, and back.
+//*every IR value has a stack slot in its frame and is held in a register where the allocator of RegAlloc.hpp gives it one.
+//*the code memory is written while it is not executable and made executable once it is no longer writable
+
+//*the code and memory of a compiled package
+struct JitProgram {
+    u8* code; //*executable, never writable once compiled
+    size_t code_bytes; //*mapped, a multiple of the page size
+    std::vector<std::pair<Sym*, u32>> func_offsets; //*entry of each func in code
+    u8* globals; //*every global var, at the offsets in global_offsets
+    std::vector<std::pair<Sym*, u32>> global_offsets;
+};
+
+//*a rel32 of the code that the linker resolves, to a global var or to the string literal str
+struct JitReloc {
+    u32 pos;
+    Sym* sym;
+    const char* str;
+};
+
+//*the code of a package for an object file, which reaches global vars and string literals through relocations instead
+//*of the JIT's memory. calls within the package are resolved
+struct JitCode {
+    std::vector<u8> code;
+    std::vector<std::pair<Sym*, u32>> func_offsets; //*entry of each func in code
+    std::vector<JitReloc> relocs;
+    u32 init_entry;
+};
+
+//*whether the host runs x86-64 code, the JIT compiles nothing elsewhere
+bool jit_is_supported();
+
+//*compiles every func of the resolved package and runs the initializers of the global vars
+void jit_compile_package(JitProgram* program);
+void jit_free(JitProgram* program);
+
+//*compiles every func of the resolved package, and init after them when it is not null. runs on any host, the code
+//*follows the calling convention of the host's x86-64 ABI
+void jit_compile_code(JitCode* out, IrFunc* init);
+
+//*entry of a func to call with the signature its Sorin declaration has in C, null when there is none
+void* jit_find_func(JitProgram* program, const char* name);
+u8* jit_global_addr(JitProgram* program, Sym* sym);
+
+//*parses, checks, compiles and runs main of the file, its result is the exit status
+int jit_run_file(const char* path);
+
+void jit_test();
@@ -638,14 +638,17 @@ bool expect_token(TokenKind kind)
         return true;
     }
     else {
-        fatal("Expected token: %s, got: %s", token_kind_name(kind), token_info());
+        parse_error("Expected token: %s, got: %s", token_kind_name(kind), token_info());
         return false;
     }
 }
 
 
-void init_stream(const char* str) {
+void init_stream(const char* str, const char* name) {
     Global::stream = str;
+    Global::stream_start = str;
+    Global::stream_name = name;
+    Global::panic_mode = false;
     next_token();
 }
 
@@ -124,5 +124,5 @@ bool expect_token(TokenKind kind);
 const char* token_info();
 const char* token_kind_name(TokenKind kind);
 
-void init_stream(const char* str);
+void init_stream(const char* str, const char* name = nullptr);
 void lex_test();
\ No newline at end of file
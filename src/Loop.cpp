@@ -0,0 +1,955 @@
+#include <algorithm>
+#include <cassert>
+#include "Loop.hpp"
+#include "Globals.hpp"
+#include "Parse.hpp"
+
+//*unrolling stops at loops that run more often than this, or whose copies would add more instructions
+Internal constexpr u32 UNROLL_MAX_TRIPS = 16;
+Internal constexpr u32 UNROLL_MAX_INSTS = 256;
+
+Internal bool loop_is_smaller(const IrLoop& left, const IrLoop& right) {
+    return left.blocks.size() < right.blocks.size();
+}
+
+void ir_find_loops(IrFunc* func, std::vector<IrLoop>* loops) {
+    std::vector<u32> idom;
+    ir_dominators(func, &idom);
+    loops->clear();
+    std::vector<u32> work;
+    for (u32 header = 0; header < func->num_blocks; header++) {
+        IrBlock* it = func->blocks + header;
+        IrLoop loop = {};
+        loop.header = header;
+        loop.preheader = IR_NO_BLOCK;
+        loop.contains.assign(func->num_blocks, 0);
+        loop.contains[header] = 1;
+        work.clear();
+        for (u32 i = 0; i < it->num_preds; i++) {
+            u32 pred = func->preds[it->first_pred + i];
+            if (idom[pred] == IR_NO_BLOCK || !ir_dominates(idom, header, pred)) {
+                continue;
+            }
+            loop.num_latches++;
+            if (!loop.contains[pred]) {
+                loop.contains[pred] = 1;
+                work.push_back(pred);
+            }
+        }
+        if (!loop.num_latches) {
+            continue;
+        }
+
+        //*everything that reaches a latch without passing the header, which dominates all of it
+        while (!work.empty()) {
+            IrBlock* block = func->blocks + work.back();
+            work.pop_back();
+            for (u32 i = 0; i < block->num_preds; i++) {
+                u32 pred = func->preds[block->first_pred + i];
+                if (!loop.contains[pred] && idom[pred] != IR_NO_BLOCK) {
+                    loop.contains[pred] = 1;
+                    work.push_back(pred);
+                }
+            }
+        }
+        for (u32 b = 0; b < func->num_blocks; b++) {
+            if (loop.contains[b]) {
+                loop.blocks.push_back(b);
+            }
+        }
+
+        if (it->num_preds - loop.num_latches == 1) {
+            u32 slot = 0;
+            while (loop.contains[func->preds[it->first_pred + slot]]) {
+                slot++;
+            }
+            u32 pred = func->preds[it->first_pred + slot];
+            if (ir_num_succs(func, pred) == 1) {
+                loop.preheader = pred;
+            }
+        }
+        loops->push_back(loop);
+    }
+
+    //*a nested loop is a strict subset of the loop around it
+    std::stable_sort(loops->begin(), loops->end(), loop_is_smaller);
+    for (IrLoop& loop : *loops) {
+        loop.is_innermost = true;
+        for (IrLoop& other : *loops) {
+            if (other.header != loop.header && loop.contains[other.header]) {
+                loop.is_innermost = false;
+            }
+        }
+    }
+}
+
+Internal ResolvedExpr loop_const(Type* type, i64 val) {
+    ResolvedExpr result = {};
+    result.type = type;
+    result.is_const = true;
+    result.int_val = val;
+    return result;
+}
+
+bool ir_find_induction(IrFunc* func, const IrLoop& loop, IrValue phi, IrInduction* iv) {
+    IrBlock* it = func->blocks + loop.header;
+    IrInst* inst = func->insts + phi;
+    if (phi < it->first || phi >= it->first + it->num_insts || inst->op != IrOp::PHI || !is_integer_type(Global::types[inst->type])) {
+        return false;
+    }
+
+    iv->phi = phi;
+    iv->init = IR_NONE;
+    iv->next = IR_NONE;
+    for (u32 i = 0; i < it->num_preds; i++) {
+        IrValue operand = func->operands[inst->operands.first + i];
+        IrValue* slot = loop.contains[func->preds[it->first_pred + i]] ? &iv->next : &iv->init;
+        if (*slot && *slot != operand) {
+            return false;
+        }
+        *slot = operand;
+    }
+    if (!iv->init || !iv->next) {
+        return false;
+    }
+
+    IrInst* next = func->insts + iv->next;
+    bool is_add = next->op == IrOp::ADD && (next->args[0] == phi || next->args[1] == phi);
+    bool is_sub = next->op == IrOp::SUB && next->args[0] == phi;
+    IrInst* step = func->insts + (next->args[0] == phi ? next->args[1] : next->args[0]);
+    if (!(is_add || is_sub) || step->op != IrOp::CONST_INT) {
+        return false;
+    }
+    iv->step = loop_const(Global::types[inst->type], step->int_val);
+    if (is_sub) {
+        fold_binary(TokenKind::SUB, loop_const(iv->step.type, 0), loop_const(iv->step.type, step->int_val), &iv->step);
+    }
+    return true;
+}
+
+//*loop invariant code motion. the loops are visited innermost first, so what leaves an inner loop lands in a block of
+//*the loop around it and can leave that one too
+
+//*moving an instruction to the preheader runs it even when the loop does not, so it must not trap: no integer
+//*division by a divisor that may be 0 or -1, no shift by a count that may be out of range, no float to integer
+//*conversion of a value that may not fit
+Internal bool licm_can_speculate(IrFunc* func, IrInst* inst) {
+    Type* type = Global::types[inst->type];
+    IrInst* right = func->insts + inst->args[1];
+    switch (inst->op) {
+        case IrOp::DIV:
+        case IrOp::MOD: {
+            return !is_integer_type(type) || (right->op == IrOp::CONST_INT && right->int_val != 0 && right->int_val != -1);
+        }
+        case IrOp::SHL:
+        case IrOp::SHR: {
+            return right->op == IrOp::CONST_INT && right->int_val >= 0 && right->int_val < (i64)type->size * 8;
+        }
+        case IrOp::CONVERT: {
+            return !is_integer_type(type) || !is_floating_type(Global::types[func->insts[inst->args[0]].type]);
+        }
+        default: {
+            return ir_is_pure(inst->op);
+        }
+    }
+}
+
+IrFunc* ir_licm(IrFunc* func) {
+    std::vector<IrLoop> loops;
+    ir_find_loops(func, &loops);
+    std::vector<u32> def_block;
+    ir_def_blocks(func, &def_block);
+    IrEdit edit;
+    ir_edit_open(&edit, func);
+    for (IrLoop& loop : loops) {
+        if (loop.preheader == IR_NO_BLOCK) {
+            continue;
+        }
+        std::vector<IrValue>* preheader = &edit.blocks[loop.preheader].insts;
+        for (u32 block : loop.blocks) {
+            //*blocks come in reverse postorder, so an instruction is seen after the ones it uses
+            std::vector<IrValue>* insts = &edit.blocks[block].insts;
+            u32 kept = 0;
+            for (u32 i = 0; i < insts->size(); i++) {
+                IrValue v = (*insts)[i];
+                IrInst* inst = func->insts + v;
+                bool is_invariant = (!inst->args[0] || !loop.contains[def_block[inst->args[0]]]) && (!inst->args[1] || !loop.contains[def_block[inst->args[1]]]);
+                if (is_invariant && licm_can_speculate(func, inst)) {
+                    preheader->insert(preheader->end() - 1, v);
+                    def_block[v] = loop.preheader;
+                }
+                else {
+                    (*insts)[kept++] = v;
+                }
+            }
+            insts->resize(kept);
+        }
+    }
+    return ir_edit_finish(&edit);
+}
+
+//*strength reduction. i * k and base[i], for an induction variable i, a constant k and a base from outside the loop,
+//*become phis of their own that start at init * k or base[init] and move on by step * k or step elements each time i does
+
+Internal IrValue sr_emit(IrEdit* edit, std::vector<IrValue>* insts, u32 index, IrInst inst) {
+    IrValue value = ir_edit_add(edit, inst);
+    insts->insert(insts->begin() + index, value);
+    return value;
+}
+
+Internal IrValue sr_const(IrEdit* edit, u32 block, u32 type, i64 val) {
+    IrInst inst = {};
+    inst.op = IrOp::CONST_INT;
+    inst.type = type;
+    inst.int_val = val;
+    std::vector<IrValue>* insts = &edit->blocks[block].insts;
+    return sr_emit(edit, insts, (u32)insts->size() - 1, inst);
+}
+
+Internal void sr_reduce(IrEdit* edit, IrFunc* func, const IrLoop& loop, const IrInduction& iv, u32 next_block, IrValue user) {
+    IrInst inst = edit->insts[user];
+    bool is_mul = inst.op == IrOp::MUL;
+    std::vector<IrValue>* preheader = &edit->blocks[loop.preheader].insts;
+
+    ResolvedExpr scale = iv.step;
+    IrInst start = inst;
+    if (is_mul) {
+        IrInst* factor = func->insts + (inst.args[0] == iv.phi ? inst.args[1] : inst.args[0]);
+        fold_binary(TokenKind::MUL, iv.step, loop_const(iv.step.type, factor->int_val), &scale);
+        start.args[0] = iv.init;
+        start.args[1] = sr_const(edit, loop.preheader, inst.type, factor->int_val);
+    }
+    else {
+        start.args[1] = iv.init;
+    }
+    IrValue step = sr_const(edit, loop.preheader, iv.step.type->id, scale.int_val);
+    IrValue start_value = sr_emit(edit, preheader, (u32)preheader->size() - 1, start);
+
+    IrInst phi = {};
+    phi.op = IrOp::PHI;
+    phi.type = inst.type;
+    IrValue phi_value = sr_emit(edit, &edit->blocks[loop.header].insts, 0, phi);
+
+    IrInst next = inst;
+    next.op = is_mul ? IrOp::ADD : IrOp::ELEM_ADDR;
+    next.args[0] = phi_value;
+    next.args[1] = step;
+    std::vector<IrValue>* insts = &edit->blocks[next_block].insts;
+    u32 index = (u32)(std::find(insts->begin(), insts->end(), iv.next) - insts->begin());
+    IrValue next_value = sr_emit(edit, insts, index + 1, next);
+
+    std::vector<IrValue> operands;
+    for (u32 pred : edit->blocks[loop.header].preds) {
+        operands.push_back(loop.contains[pred] ? next_value : start_value);
+    }
+    ir_edit_set_operands(edit, phi_value, operands);
+    edit->replace[user] = phi_value;
+    edit->insts[user].op = IrOp::NOP;
+}
+
+IrFunc* ir_strength_reduce(IrFunc* func) {
+    std::vector<IrLoop> loops;
+    ir_find_loops(func, &loops);
+    std::vector<u32> def_block;
+    ir_def_blocks(func, &def_block);
+    IrUses uses;
+    ir_find_uses(func, &uses);
+    IrEdit edit;
+    ir_edit_open(&edit, func);
+    for (IrLoop& loop : loops) {
+        if (loop.preheader == IR_NO_BLOCK) {
+            continue;
+        }
+        IrBlock* header = func->blocks + loop.header;
+        for (IrValue phi = header->first; func->insts[phi].op == IrOp::PHI; phi++) {
+            IrInduction iv;
+            if (!ir_find_induction(func, loop, phi, &iv) || !loop.contains[def_block[iv.next]]) {
+                continue;
+            }
+            for (u32 i = uses.first[phi]; i < uses.first[phi + 1]; i++) {
+                IrValue user = uses.users[i];
+                IrInst* inst = &edit.insts[user];
+                if (!loop.contains[def_block[user]] || inst->op == IrOp::NOP) {
+                    continue;
+                }
+                IrValue other = inst->args[0] == phi ? inst->args[1] : inst->args[0];
+                bool is_multiple = inst->op == IrOp::MUL && func->insts[other].op == IrOp::CONST_INT;
+                bool is_address = inst->op == IrOp::ELEM_ADDR && inst->args[1] == phi && inst->args[0] != phi && !loop.contains[def_block[inst->args[0]]];
+                if (is_multiple || is_address) {
+                    sr_reduce(&edit, func, loop, iv, def_block[iv.next], user);
+                }
+            }
+        }
+    }
+    return ir_edit_finish(&edit);
+}
+
+//*full unrolling. an innermost loop whose header alone decides, from induction variables with constant starts and
+//*constants, that it runs a small number of times is replaced by a chain of that many copies of the loop followed by
+//*one copy of the header that goes on to the exit. the phis of each copy of the header are the values the previous
+//*copy passes back, and what follows the loop uses the values of the last copy
+
+Internal bool unroll_trip_count(IrFunc* func, const IrLoop& loop, u32* trips) {
+    IrBlock* header = func->blocks + loop.header;
+    IrInst* branch = func->insts + header->first + header->num_insts - 1;
+    if (branch->op != IrOp::BRANCH || loop.contains[branch->targets[0]] == loop.contains[branch->targets[1]]) {
+        return false;
+    }
+    IrInst* cond = func->insts + branch->args[0];
+    if (cond->op < IrOp::EQ || cond->op > IrOp::GE) {
+        return false;
+    }
+
+    //*each side is a constant, an induction variable, or its next value as a do-while compares it
+    IrInduction ivs[2];
+    ResolvedExpr vals[2];
+    for (u32 i = 0; i < 2; i++) {
+        bool is_iv = ir_find_induction(func, loop, cond->args[i], ivs + i);
+        bool is_next = false;
+        for (IrValue phi = header->first; !is_iv && func->insts[phi].op == IrOp::PHI; phi++) {
+            is_next = ir_find_induction(func, loop, phi, ivs + i) && ivs[i].next == cond->args[i];
+            is_iv = is_next;
+        }
+        IrInst* start = func->insts + (is_iv ? ivs[i].init : cond->args[i]);
+        if (start->op != IrOp::CONST_INT || !is_integer_type(Global::types[start->type])) {
+            return false;
+        }
+        vals[i] = loop_const(Global::types[start->type], start->int_val);
+        if (is_next) {
+            fold_binary(TokenKind::ADD, vals[i], ivs[i].step, vals + i);
+        }
+        if (!is_iv) {
+            ivs[i].phi = IR_NONE;
+        }
+    }
+
+    bool stays_if = loop.contains[branch->targets[0]] != 0;
+    for (u32 trip = 0; trip <= UNROLL_MAX_TRIPS; trip++) {
+        ResolvedExpr taken = {};
+        fold_binary(ir_fold_op(cond->op), vals[0], vals[1], &taken);
+        if ((taken.int_val != 0) != stays_if) {
+            *trips = trip;
+            return true;
+        }
+        for (u32 i = 0; i < 2; i++) {
+            if (ivs[i].phi) {
+                fold_binary(TokenKind::ADD, vals[i], ivs[i].step, vals + i);
+            }
+        }
+    }
+    return false;
+}
+
+Internal IrValue unroll_map(const std::vector<IrValue>& map, IrValue value) {
+    return value && map[value] ? map[value] : value;
+}
+
+Internal void unroll_loop(IrEdit* edit, IrFunc* func, const IrLoop& loop, u32 trips) {
+    IrBlock* header = func->blocks + loop.header;
+    IrValue terminator = header->first + header->num_insts - 1;
+    IrInst* branch = func->insts + terminator;
+    u32 body = loop.contains[branch->targets[0]] ? branch->targets[0] : branch->targets[1];
+    u32 exit = loop.contains[branch->targets[0]] ? branch->targets[1] : branch->targets[0];
+    u32 latch_slot = loop.contains[func->preds[header->first_pred]] ? 0 : 1;
+    u32 latch = func->preds[header->first_pred + latch_slot];
+
+    //*copy k of loop.blocks[i] is copies[k * num_blocks + i], the last copy is only the header
+    u32 num_blocks = (u32)loop.blocks.size();
+    std::vector<u32> position(func->num_blocks, IR_NO_BLOCK);
+    for (u32 i = 0; i < num_blocks; i++) {
+        position[loop.blocks[i]] = i;
+    }
+    std::vector<u32> copies((trips + 1) * num_blocks, IR_NO_BLOCK);
+    for (u32 k = 0; k <= trips; k++) {
+        for (u32 i = 0; i < (k < trips ? num_blocks : 1); i++) {
+            copies[k * num_blocks + i] = ir_edit_add_block(edit);
+        }
+    }
+
+    std::vector<IrValue> map(func->num_insts, IR_NONE);
+    std::vector<IrValue> entering;
+    std::vector<IrValue> operands;
+    for (u32 k = 0; k <= trips; k++) {
+        entering.clear();
+        for (IrValue v = header->first; func->insts[v].op == IrOp::PHI; v++) {
+            IrValue operand = func->operands[func->insts[v].operands.first + (k ? latch_slot : 1 - latch_slot)];
+            entering.push_back(k ? unroll_map(map, operand) : operand);
+        }
+        for (u32 i = 0; i < entering.size(); i++) {
+            map[header->first + i] = entering[i];
+        }
+
+        for (u32 i = 0; i < (k < trips ? num_blocks : 1); i++) {
+            u32 block = loop.blocks[i];
+            IrBlock* it = func->blocks + block;
+            IrEditBlock* out = &edit->blocks[copies[k * num_blocks + i]];
+            if (block == loop.header) {
+                out->preds.push_back(k ? copies[(k - 1) * num_blocks + position[latch]] : loop.preheader);
+            }
+            else {
+                for (u32 j = 0; j < it->num_preds; j++) {
+                    out->preds.push_back(copies[k * num_blocks + position[func->preds[it->first_pred + j]]]);
+                }
+            }
+
+            for (IrValue v = it->first; v < it->first + it->num_insts; v++) {
+                IrInst inst = func->insts[v];
+                if (block == loop.header && inst.op == IrOp::PHI) {
+                    continue;
+                }
+                inst.args[0] = unroll_map(map, inst.args[0]);
+                inst.args[1] = unroll_map(map, inst.args[1]);
+                if (v == terminator) {
+                    inst.op = IrOp::JUMP;
+                    inst.args[0] = IR_NONE;
+                    if (k == trips) {
+                        inst.targets[0] = exit;
+                    }
+                    else {
+                        inst.targets[0] = body == loop.header ? copies[(k + 1) * num_blocks] : copies[k * num_blocks + position[body]];
+                    }
+                }
+                else if (inst.op == IrOp::JUMP || inst.op == IrOp::BRANCH) {
+                    for (u32 j = 0; j < (inst.op == IrOp::BRANCH ? 2u : 1u); j++) {
+                        u32 target = inst.targets[j];
+                        inst.targets[j] = target == loop.header ? copies[(k + 1) * num_blocks] : copies[k * num_blocks + position[target]];
+                    }
+                }
+
+                IrValue copy = ir_edit_add(edit, inst);
+                if (inst.op == IrOp::PHI || inst.op == IrOp::CALL) {
+                    operands.clear();
+                    for (u32 j = 0; j < inst.operands.count; j++) {
+                        operands.push_back(unroll_map(map, func->operands[inst.operands.first + j]));
+                    }
+                    ir_edit_set_operands(edit, copy, operands);
+                }
+                map[v] = copy;
+                out->insts.push_back(copy);
+            }
+        }
+    }
+
+    //*the preheader enters the first copy and the exit is left from the last, which only the header values reach
+    edit->insts[edit->blocks[loop.preheader].insts.back()].targets[0] = copies[0];
+    std::replace(edit->blocks[exit].preds.begin(), edit->blocks[exit].preds.end(), loop.header, copies[trips * num_blocks]);
+    for (IrValue v = header->first; v < terminator; v++) {
+        edit->replace[v] = unroll_map(map, v);
+    }
+}
+
+IrFunc* ir_unroll(IrFunc* func) {
+    std::vector<IrLoop> loops;
+    ir_find_loops(func, &loops);
+    IrEdit edit;
+    ir_edit_open(&edit, func);
+    for (IrLoop& loop : loops) {
+        u32 trips = 0;
+        if (!loop.is_innermost || loop.preheader == IR_NO_BLOCK || loop.num_latches != 1 || !unroll_trip_count(func, loop, &trips)) {
+            continue;
+        }
+
+        //*only the header leaves the loop, so nothing after it sees values of the other blocks
+        u32 num_insts = 0;
+        bool has_one_exit = true;
+        for (u32 block : loop.blocks) {
+            num_insts += func->blocks[block].num_insts;
+            for (u32 i = 0; i < ir_num_succs(func, block); i++) {
+                has_one_exit = has_one_exit && (block == loop.header || loop.contains[ir_succ(func, block, i)]);
+            }
+        }
+        if (has_one_exit && (trips + 1) * num_insts <= UNROLL_MAX_INSTS) {
+            unroll_loop(&edit, func, loop, trips);
+        }
+    }
+    return ir_edit_finish(&edit);
+}
+
+//*vectorization. a loop whose header runs it while i < n, for an induction variable i counting up by 1 and an n from
+//*outside, and whose one body block only reads and writes base[i] for bases from outside, computes elementwise and
+//*adds into header phis, gets a vector twin in front of it. the twin does lanes iterations at a time while that many
+//*are left, then hands i and its partial sums to the scalar loop, which does the rest. when two of the arrays may lie
+//*less than a vector apart, the preheader checks their distance and goes straight to the scalar loop if it is too small
+
+enum class VecKind : u8 {
+    NONE,
+    UNIFORM, //*the same in every iteration
+    VECTOR, //*one lane per iteration
+    ADDR, //*base[i], only the address of loads and stores
+};
+
+struct VecLoop {
+    IrInduction iv;
+    IrValue limit;
+    u32 body;
+    u8 lanes;
+    std::vector<VecKind> kinds; //*by value, of the body and of the sums
+    std::vector<IrValue> sums; //*header phis that add one value of each iteration
+    std::vector<IrValue> bases; //*of the loads and stores, once each
+    std::vector<u8> is_stored; //*by position in bases
+};
+
+Internal VecKind vec_kind(const IrLoop& loop, const std::vector<u32>& def_block, const VecLoop& vec, IrValue value) {
+    return !value ? VecKind::NONE : loop.contains[def_block[value]] ? vec.kinds[value] : VecKind::UNIFORM;
+}
+
+//*every vector value has lanes of one size
+Internal bool vec_lane_type(Type* type, size_t* lane_size) {
+    if (!is_arithmetic_type(type) || (*lane_size && type->size != *lane_size)) {
+        return false;
+    }
+    *lane_size = type->size;
+    return true;
+}
+
+Internal void vec_add_base(VecLoop* vec, IrValue base, bool is_stored) {
+    size_t i = std::find(vec->bases.begin(), vec->bases.end(), base) - vec->bases.begin();
+    if (i == vec->bases.size()) {
+        vec->bases.push_back(base);
+        vec->is_stored.push_back(0);
+    }
+    vec->is_stored[i] = vec->is_stored[i] || is_stored;
+}
+
+Internal bool vec_analyze(IrFunc* func, const IrLoop& loop, const std::vector<u32>& def_block, const IrUses& uses, VecLoop* vec) {
+    if (!loop.is_innermost || loop.preheader == IR_NO_BLOCK || loop.num_latches != 1 || loop.blocks.size() != 2) {
+        return false;
+    }
+    IrBlock* header = func->blocks + loop.header;
+    IrValue terminator = header->first + header->num_insts - 1;
+    IrInst* branch = func->insts + terminator;
+    if (branch->op != IrOp::BRANCH || branch->targets[0] == loop.header || !loop.contains[branch->targets[0]] || loop.contains[branch->targets[1]]) {
+        return false;
+    }
+    vec->body = branch->targets[0];
+
+    //*i < n or n > i decides, and the header computes nothing else
+    IrInst* cond = func->insts + branch->args[0];
+    IrValue counter = cond->op == IrOp::LT ? cond->args[0] : cond->op == IrOp::GT ? cond->args[1] : IR_NONE;
+    vec->limit = cond->op == IrOp::LT ? cond->args[1] : cond->args[0];
+    if (!counter || !ir_find_induction(func, loop, counter, &vec->iv) || vec->iv.step.int_val != 1 || !is_integer_type(vec->iv.step.type) || loop.contains[def_block[vec->limit]]) {
+        return false;
+    }
+    if (def_block[vec->iv.next] != vec->body || uses.first[vec->iv.next + 1] - uses.first[vec->iv.next] != 1) {
+        return false;
+    }
+    for (IrValue v = header->first; v < terminator; v++) {
+        if (func->insts[v].op != IrOp::PHI && v != branch->args[0]) {
+            return false;
+        }
+    }
+
+    //*the other header phis are integer sums, phi + x on the back edge and used by nothing else in the loop
+    vec->kinds.assign(func->num_insts, VecKind::NONE);
+    vec->sums.clear();
+    u32 latch_slot = loop.contains[func->preds[header->first_pred]] ? 0 : 1;
+    for (IrValue phi = header->first; func->insts[phi].op == IrOp::PHI; phi++) {
+        if (phi == vec->iv.phi) {
+            continue;
+        }
+        IrValue back = func->operands[func->insts[phi].operands.first + latch_slot];
+        IrInst* add = func->insts + back;
+        u32 num_loop_uses = 0;
+        for (u32 i = uses.first[phi]; i < uses.first[phi + 1]; i++) {
+            num_loop_uses += loop.contains[def_block[uses.users[i]]];
+        }
+        bool is_sum = is_integer_type(Global::types[func->insts[phi].type]) && add->op == IrOp::ADD && (add->args[0] == phi) != (add->args[1] == phi)
+            && def_block[back] == vec->body && num_loop_uses == 1 && uses.first[back + 1] - uses.first[back] == 1;
+        if (!is_sum) {
+            return false;
+        }
+        vec->sums.push_back(phi);
+        vec->kinds[phi] = VecKind::VECTOR;
+    }
+
+    IrBlock* body = func->blocks + vec->body;
+    size_t lane_size = 0;
+    vec->bases.clear();
+    vec->is_stored.clear();
+    for (IrValue v = body->first; v < body->first + body->num_insts - 1; v++) {
+        IrInst* inst = func->insts + v;
+        VecKind left = vec_kind(loop, def_block, *vec, inst->args[0]);
+        VecKind right = vec_kind(loop, def_block, *vec, inst->args[1]);
+        bool uses_counter = inst->args[0] == vec->iv.phi || inst->args[1] == vec->iv.phi;
+        VecKind kind = VecKind::NONE;
+        if (v == vec->iv.next) {
+            continue;
+        }
+        else if (inst->op == IrOp::ELEM_ADDR && inst->args[1] == vec->iv.phi && !loop.contains[def_block[inst->args[0]]]) {
+            kind = VecKind::ADDR;
+        }
+        else if (uses_counter || (left == VecKind::ADDR && inst->op != IrOp::LOAD && inst->op != IrOp::STORE) || right == VecKind::ADDR) {
+            return false;
+        }
+        else if (inst->op == IrOp::LOAD || inst->op == IrOp::STORE) {
+            Type* lane = Global::types[inst->op == IrOp::LOAD ? inst->type : func->insts[inst->args[1]].type];
+            if (left != VecKind::ADDR || !vec_lane_type(lane, &lane_size)) {
+                return false;
+            }
+            vec_add_base(vec, func->insts[inst->args[0]].args[0], inst->op == IrOp::STORE);
+            kind = inst->op == IrOp::LOAD ? VecKind::VECTOR : VecKind::NONE;
+        }
+        else if ((inst->op >= IrOp::ADD && inst->op <= IrOp::NEG) || inst->op == IrOp::CONVERT) {
+            kind = left == VecKind::VECTOR || right == VecKind::VECTOR ? VecKind::VECTOR : VecKind::UNIFORM;
+            Type* type = Global::types[inst->type];
+            Type* from = Global::types[func->insts[inst->args[0]].type];
+            bool is_shift = inst->op == IrOp::SHL || inst->op == IrOp::SHR;
+            bool fits = !(is_shift && Global::types[func->insts[inst->args[1]].type] != type)
+                && !(inst->op == IrOp::CONVERT && (!is_integer_type(type) || !is_integer_type(from) || type->size != from->size));
+            if (kind == VecKind::VECTOR && (!fits || !vec_lane_type(type, &lane_size))) {
+                return false;
+            }
+        }
+        else if (ir_is_pure(inst->op) && left != VecKind::VECTOR && right != VecKind::VECTOR) {
+            kind = VecKind::UNIFORM;
+        }
+        else {
+            return false;
+        }
+        vec->kinds[v] = kind;
+    }
+
+    if (!lane_size || IR_VECTOR_BYTES % lane_size || IR_VECTOR_BYTES / lane_size < 2 || (vec->sums.empty() && std::find(vec->is_stored.begin(), vec->is_stored.end(), 1) == vec->is_stored.end())) {
+        return false;
+    }
+    vec->lanes = (u8)(IR_VECTOR_BYTES / lane_size);
+    return true;
+}
+
+//*appends to a block, in front of its terminator if it has one
+Internal IrValue vec_emit(IrEdit* edit, u32 block, IrOp op, u32 type, u8 lanes, IrValue left, IrValue right) {
+    IrInst inst = {};
+    inst.op = op;
+    inst.lanes = lanes;
+    inst.type = type;
+    inst.args[0] = left;
+    inst.args[1] = right;
+    IrValue value = ir_edit_add(edit, inst);
+    std::vector<IrValue>* insts = &edit->blocks[block].insts;
+    bool is_terminated = !insts->empty() && ir_is_terminator(edit->insts[insts->back()].op);
+    insts->insert(is_terminated ? insts->end() - 1 : insts->end(), value);
+    return value;
+}
+
+Internal IrValue vec_const(IrEdit* edit, u32 block, Type* type, i64 val) {
+    IrValue value = vec_emit(edit, block, IrOp::CONST_INT, type->id, 0, IR_NONE, IR_NONE);
+    edit->insts[value].int_val = val;
+    return value;
+}
+
+//*two global arrays are the same or do not overlap at all
+Internal bool vec_is_known(IrFunc* func, IrValue left, IrValue right) {
+    IrInst* roots[2] = { func->insts + left, func->insts + right };
+    for (IrInst*& it : roots) {
+        while (it->op == IrOp::CONVERT && Global::types[func->insts[it->args[0]].type]->kind == TypeKind::PTR) {
+            it = func->insts + it->args[0];
+        }
+    }
+    return roots[0]->op == IrOp::GLOBAL && roots[1]->op == IrOp::GLOBAL;
+}
+
+//*nonzero when every stored array is the same as each other array or a vector or more away from it. IR_NONE when
+//*that is known without looking
+Internal IrValue vec_alias_check(IrEdit* edit, IrFunc* func, u32 block, const VecLoop& vec) {
+    Type* addr = Global::type_ullong;
+    u32 type_int = Global::type_int->id;
+    IrValue ok = IR_NONE;
+    for (u32 i = 0; i < vec.bases.size(); i++) {
+        for (u32 j = i + 1; j < vec.bases.size(); j++) {
+            if (!(vec.is_stored[i] || vec.is_stored[j]) || vec_is_known(func, vec.bases[i], vec.bases[j])) {
+                continue;
+            }
+            //*the distance d is 0 or at least a vector exactly when d + (vector - 1) is 2 * (vector - 1) or more as unsigned,
+            //*or when d is 0
+            IrValue left = vec_emit(edit, block, IrOp::CONVERT, addr->id, 0, vec.bases[i], IR_NONE);
+            IrValue right = vec_emit(edit, block, IrOp::CONVERT, addr->id, 0, vec.bases[j], IR_NONE);
+            IrValue distance = vec_emit(edit, block, IrOp::SUB, addr->id, 0, left, right);
+            IrValue shifted = vec_emit(edit, block, IrOp::ADD, addr->id, 0, distance, vec_const(edit, block, addr, IR_VECTOR_BYTES - 1));
+            IrValue far = vec_emit(edit, block, IrOp::GT, type_int, 0, shifted, vec_const(edit, block, addr, 2 * (IR_VECTOR_BYTES - 1)));
+            IrValue same = vec_emit(edit, block, IrOp::EQ, type_int, 0, left, right);
+            IrValue pair = vec_emit(edit, block, IrOp::OR, type_int, 0, far, same);
+            ok = ok ? vec_emit(edit, block, IrOp::AND, type_int, 0, ok, pair) : pair;
+        }
+    }
+    return ok;
+}
+
+//*a value of the body as an operand of the vector body: its vector, or a splat of a uniform value made where it is known
+Internal IrValue vec_operand(IrEdit* edit, const IrLoop& loop, const std::vector<u32>& def_block, const VecLoop& vec, std::vector<IrValue>* map,
+                             std::vector<IrValue>* splats, u32 ventry, u32 vbody, IrValue value) {
+    bool is_outside = !loop.contains[def_block[value]];
+    if (!is_outside && vec.kinds[value] == VecKind::VECTOR) {
+        return (*map)[value];
+    }
+    if (!(*splats)[value]) {
+        IrValue scalar = is_outside ? value : (*map)[value];
+        (*splats)[value] = vec_emit(edit, is_outside ? ventry : vbody, IrOp::SPLAT, edit->insts[scalar].type, vec.lanes, scalar, IR_NONE);
+    }
+    return (*splats)[value];
+}
+
+Internal void vec_transform(IrEdit* edit, IrFunc* func, const IrLoop& loop, const std::vector<u32>& def_block, const VecLoop& vec) {
+    u32 ventry = ir_edit_add_block(edit);
+    u32 vheader = ir_edit_add_block(edit);
+    u32 vbody = ir_edit_add_block(edit);
+    u32 vexit = ir_edit_add_block(edit);
+    Type* counter = vec.iv.step.type;
+    u32 type_int = Global::type_int->id;
+
+    //*the preheader enters the vector loop, or the scalar one when the arrays are too close. the vector loop gets a
+    //*preheader of its own for the splats and for the passes that follow
+    IrValue ok = vec_alias_check(edit, func, loop.preheader, vec);
+    IrInst* jump = &edit->insts[edit->blocks[loop.preheader].insts.back()];
+    jump->targets[0] = ventry;
+    if (ok) {
+        jump->op = IrOp::BRANCH;
+        jump->args[0] = ok;
+        jump->targets[1] = loop.header;
+    }
+    IrValue enter_vector = vec_emit(edit, ventry, IrOp::JUMP, 0, 0, IR_NONE, IR_NONE);
+    edit->insts[enter_vector].targets[0] = vheader;
+
+    //*i and a vector of partial sums for each sum, starting at 0
+    std::vector<IrValue> map(func->num_insts, IR_NONE);
+    std::vector<IrValue> splats(func->num_insts, IR_NONE);
+    IrValue index = vec_emit(edit, vheader, IrOp::PHI, counter->id, 0, IR_NONE, IR_NONE);
+    for (IrValue sum : vec.sums) {
+        IrInst* phi = &edit->insts[sum];
+        IrValue zero = vec_emit(edit, ventry, IrOp::SPLAT, phi->type, vec.lanes, vec_const(edit, ventry, Global::types[phi->type], 0), IR_NONE);
+        map[sum] = vec_emit(edit, vheader, IrOp::PHI, edit->insts[sum].type, vec.lanes, IR_NONE, IR_NONE);
+        splats[sum] = zero;
+    }
+    //*n - i as unsigned long long is exact and does not overflow once i < n
+    Type* distance = Global::type_ullong;
+    IrValue wide_limit = vec_emit(edit, vheader, IrOp::CONVERT, distance->id, 0, vec.limit, IR_NONE);
+    IrValue wide_index = vec_emit(edit, vheader, IrOp::CONVERT, distance->id, 0, index, IR_NONE);
+    IrValue left = vec_emit(edit, vheader, IrOp::SUB, distance->id, 0, wide_limit, wide_index);
+    IrValue enough = vec_emit(edit, vheader, IrOp::GE, type_int, 0, left, vec_const(edit, vheader, distance, vec.lanes));
+    IrValue inside = vec_emit(edit, vheader, IrOp::LT, type_int, 0, index, vec.limit);
+    IrValue taken = vec_emit(edit, vheader, IrOp::AND, type_int, 0, inside, enough);
+    IrValue branch = vec_emit(edit, vheader, IrOp::BRANCH, 0, 0, taken, IR_NONE);
+    edit->insts[branch].targets[0] = vbody;
+    edit->insts[branch].targets[1] = vexit;
+
+    IrBlock* body = func->blocks + vec.body;
+    for (IrValue v = body->first; v < body->first + body->num_insts - 1; v++) {
+        IrInst inst = func->insts[v];
+        if (v == vec.iv.next) {
+            continue;
+        }
+        switch (vec.kinds[v]) {
+            case VecKind::UNIFORM: {
+                for (IrValue& arg : inst.args) {
+                    arg = arg && loop.contains[def_block[arg]] ? map[arg] : arg;
+                }
+                map[v] = ir_edit_add(edit, inst);
+                edit->blocks[vbody].insts.push_back(map[v]);
+                break;
+            }
+            case VecKind::ADDR: {
+                map[v] = vec_emit(edit, vbody, IrOp::ELEM_ADDR, inst.type, 0, inst.args[0], index);
+                break;
+            }
+            default: {
+                if (inst.op == IrOp::STORE) {
+                    vec_emit(edit, vbody, IrOp::STORE, 0, 0, map[inst.args[0]], vec_operand(edit, loop, def_block, vec, &map, &splats, ventry, vbody, inst.args[1]));
+                }
+                else if (inst.op == IrOp::LOAD) {
+                    map[v] = vec_emit(edit, vbody, IrOp::LOAD, inst.type, vec.lanes, map[inst.args[0]], IR_NONE);
+                }
+                else {
+                    IrValue args[2] = {};
+                    for (u32 i = 0; i < 2; i++) {
+                        args[i] = inst.args[i] ? vec_operand(edit, loop, def_block, vec, &map, &splats, ventry, vbody, inst.args[i]) : IR_NONE;
+                    }
+                    map[v] = vec_emit(edit, vbody, inst.op, inst.type, vec.lanes, args[0], args[1]);
+                }
+                break;
+            }
+        }
+    }
+    IrValue next = vec_emit(edit, vbody, IrOp::ADD, counter->id, 0, index, vec_const(edit, vbody, counter, vec.lanes));
+    IrValue back = vec_emit(edit, vbody, IrOp::JUMP, 0, 0, IR_NONE, IR_NONE);
+    edit->insts[back].targets[0] = vheader;
+
+    //*the vector loop hands i and the partial sums, added up and to the start of each sum, to the scalar loop
+    IrBlock* header = func->blocks + loop.header;
+    u32 latch_slot = loop.contains[func->preds[header->first_pred]] ? 0 : 1;
+    std::vector<IrValue> handed(func->num_insts, IR_NONE);
+    handed[vec.iv.phi] = index;
+    for (IrValue sum : vec.sums) {
+        IrInst* phi = &edit->insts[sum];
+        IrValue start = edit->operands[phi->operands.first + 1 - latch_slot];
+        IrValue total = vec_emit(edit, vexit, IrOp::REDUCE_ADD, phi->type, 0, map[sum], IR_NONE);
+        handed[sum] = vec_emit(edit, vexit, IrOp::ADD, phi->type, 0, start, total);
+        ir_edit_set_operands(edit, map[sum], { splats[sum], map[edit->operands[phi->operands.first + latch_slot]] });
+    }
+    IrValue enter = vec_emit(edit, vexit, IrOp::JUMP, 0, 0, IR_NONE, IR_NONE);
+    edit->insts[enter].targets[0] = loop.header;
+    ir_edit_set_operands(edit, index, { vec.iv.init, next });
+
+    edit->blocks[ventry].preds = { loop.preheader };
+    edit->blocks[vheader].preds = { ventry, vbody };
+    edit->blocks[vbody].preds = { vheader };
+    edit->blocks[vexit].preds = { vheader };
+    edit->blocks[loop.header].preds.push_back(vexit);
+    std::vector<IrValue> operands;
+    for (IrValue phi = header->first; func->insts[phi].op == IrOp::PHI; phi++) {
+        IrInst* inst = &edit->insts[phi];
+        operands.assign(edit->operands.begin() + inst->operands.first, edit->operands.begin() + inst->operands.first + inst->operands.count);
+        operands.push_back(handed[phi]);
+        ir_edit_set_operands(edit, phi, operands);
+    }
+}
+
+IrFunc* ir_vectorize(IrFunc* func) {
+    std::vector<IrLoop> loops;
+    ir_find_loops(func, &loops);
+    std::vector<u32> def_block;
+    ir_def_blocks(func, &def_block);
+    IrUses uses;
+    ir_find_uses(func, &uses);
+    IrEdit edit;
+    ir_edit_open(&edit, func);
+    VecLoop vec;
+    for (IrLoop& loop : loops) {
+        if (vec_analyze(func, loop, def_block, uses, &vec)) {
+            vec_transform(&edit, func, loop, def_block, vec);
+        }
+    }
+    return ir_edit_finish(&edit);
+}
+
+Internal IrFunc* loop_test_func(const char* name) {
+    const char* interned = Global::string_table.add(name);
+    for (IrFunc* it : Global::ir_funcs) {
+        if (it->sym->name == interned) {
+            return it;
+        }
+    }
+    assert(false);
+    return nullptr;
+}
+
+Internal IrFunc* loop_test_verified(IrFunc* func) {
+    std::string error;
+    bool ok = ir_verify(func, &error);
+    if (!ok) {
+        printf("%s%s\n", ir_dump(func).c_str(), error.c_str());
+    }
+    assert(ok);
+    return func;
+}
+
+//*instructions with op inside any loop, and in the whole function
+Internal u32 loop_test_count(IrFunc* func, IrOp op, bool in_loops) {
+    std::vector<IrLoop> loops;
+    ir_find_loops(func, &loops);
+    std::vector<u32> def_block;
+    ir_def_blocks(func, &def_block);
+    u32 count = 0;
+    for (IrValue v = 1; v < func->num_insts; v++) {
+        bool in_loop = false;
+        for (IrLoop& loop : loops) {
+            in_loop = in_loop || loop.contains[def_block[v]];
+        }
+        count += func->insts[v].op == op && (in_loop || !in_loops);
+    }
+    return count;
+}
+
+//*lanes of the vector instructions with op, all the same, 0 when there are none
+Internal u32 loop_test_lanes(IrFunc* func, IrOp op) {
+    u32 lanes = 0;
+    for (IrValue v = 1; v < func->num_insts; v++) {
+        IrInst* inst = func->insts + v;
+        bool is_vector = inst->op == op && (inst->lanes || (op == IrOp::STORE && func->insts[inst->args[1]].lanes));
+        assert(!is_vector || !lanes || lanes == (inst->lanes ? inst->lanes : func->insts[inst->args[1]].lanes));
+        lanes = is_vector ? (inst->lanes ? inst->lanes : func->insts[inst->args[1]].lanes) : lanes;
+    }
+    return lanes;
+}
+
+void loop_test() {
+    const char* src =
+        "var data: int[64]\n"
+        "func invariant(p: int*, n: int, a: int, b: int): int { s := 0; for (i := 0; i < n; i++) { s += a * b + p[i]; } return s; }\n"
+        "func divide(n: int, d: int): int { s := 0; for (i := 0; i < n; i++) { s += 100 / d + 100 / 7 + (i << 40); } return s; }\n"
+        "func scaled(n: int): int { s := 0; for (i := n; i > 0; i--) { s += i * 12 + data[i]; } return s; }\n"
+        "func fixed(p: int*): int { s := 0; for (i := 0; i < 4; i++) { if (p[i] > 0) { s += p[i]; } } return s; }\n"
+        "func counted(): int { s := 0; i := 0; do { s += i; i += 2; } while (i < 9); return s; }\n"
+        "func many(p: int*): int { s := 0; for (i := 0; i < 1000; i++) { s += p[i]; } return s; }\n"
+        "func exits(p: int*): int { s := 0; for (i := 0; i < 4; i++) { if (p[i] == 0) { break; } s += p[i]; } return s; }\n"
+        "func nested(n: int): int { s := 0; for (i := 0; i < n; i++) { j := 0; while (j < n) { s += i * j; j++; } } return s; }\n"
+        "func scale(n: int, k: int) { for (i := 0; i < n; i++) { data[i] = data[i] * k + 1; } }\n"
+        "func total(p: llong*, n: int): llong { var s: llong = 0\n for (i := 0; i < n; i++) { s += p[i]; } return s; }\n"
+        "func copy(p: int*, q: int*, n: int) { for (i := 0; i < n; i++) { p[i] = q[i]; } }\n"
+        "func find(p: int*, n: int): int { for (i := 0; i < n; i++) { if (p[i] == 0) { return i; } } return n; }\n";
+
+    assert(load_package_src("loop_test.sorin", src));
+    ir_lower_package();
+
+    //*the inner loop comes first and both are entered from a preheader, i and j count up by 1
+    std::vector<IrLoop> loops;
+    IrFunc* nested = loop_test_func("nested");
+    ir_find_loops(nested, &loops);
+    assert(loops.size() == 2 && loops[0].is_innermost && !loops[1].is_innermost);
+    assert(loops[1].contains[loops[0].header] && !loops[0].contains[loops[1].header]);
+    for (IrLoop& loop : loops) {
+        IrInduction iv;
+        assert(loop.preheader != IR_NO_BLOCK && loop.num_latches == 1);
+        assert(ir_find_induction(nested, loop, nested->blocks[loop.header].first, &iv) || ir_find_induction(nested, loop, nested->blocks[loop.header].first + 1, &iv));
+        assert(iv.step.int_val == 1);
+    }
+
+    //*each loop pass alone keeps every function valid
+    for (IrFunc* it : Global::ir_funcs) {
+        loop_test_verified(ir_licm(ir_lower_func(it->sym)));
+        loop_test_verified(ir_strength_reduce(ir_lower_func(it->sym)));
+        loop_test_verified(ir_unroll(ir_lower_func(it->sym)));
+        loop_test_verified(ir_vectorize(ir_lower_func(it->sym)));
+    }
+
+    //*a * b leaves the loop, a division that may trap and a shift that is too wide stay
+    IrFunc* invariant = loop_test_verified(ir_licm(ir_lower_func(loop_test_func("invariant")->sym)));
+    assert(loop_test_count(invariant, IrOp::MUL, true) == 0 && loop_test_count(invariant, IrOp::MUL, false) == 1);
+    IrFunc* divide = loop_test_verified(ir_licm(ir_lower_func(loop_test_func("divide")->sym)));
+    assert(loop_test_count(divide, IrOp::DIV, true) == 1 && loop_test_count(divide, IrOp::DIV, false) == 2);
+    assert(loop_test_count(divide, IrOp::SHL, true) == 1);
+
+    //*four ints or two llongs at a time, and a check for overlap only where the arrays come from pointers. the loops
+    //*are first cleaned up as in the pipeline, with the block of i++ merged into the body and the array bases moved out
+    IrFunc* scale = loop_test_verified(ir_vectorize(ir_licm(ir_copy_prop(ir_lower_func(loop_test_func("scale")->sym)))));
+    assert(loop_test_lanes(scale, IrOp::LOAD) == 4 && loop_test_lanes(scale, IrOp::MUL) == 4 && loop_test_lanes(scale, IrOp::STORE) == 4);
+    assert(loop_test_lanes(scale, IrOp::SPLAT) == 4 && loop_test_count(scale, IrOp::EQ, false) == 0);
+    IrFunc* total = loop_test_verified(ir_vectorize(ir_licm(ir_copy_prop(ir_lower_func(loop_test_func("total")->sym)))));
+    assert(loop_test_lanes(total, IrOp::ADD) == 2 && loop_test_count(total, IrOp::REDUCE_ADD, false) == 1);
+    IrFunc* copy = loop_test_verified(ir_vectorize(ir_licm(ir_copy_prop(ir_lower_func(loop_test_func("copy")->sym)))));
+    assert(loop_test_lanes(copy, IrOp::STORE) == 4 && loop_test_count(copy, IrOp::EQ, false) == 1);
+    IrFunc* find = loop_test_verified(ir_vectorize(ir_licm(ir_copy_prop(ir_lower_func(loop_test_func("find")->sym)))));
+    assert(loop_test_lanes(find, IrOp::LOAD) == 0 && loop_test_lanes(loop_test_verified(ir_vectorize(ir_licm(ir_copy_prop(ir_lower_func(nested->sym))))), IrOp::ADD) == 0);
+
+    Global::ir_pass_ns.clear();
+    ir_optimize_package();
+    for (IrFunc* it : Global::ir_funcs) {
+        loop_test_verified(it);
+    }
+
+    //*i * 12 and data[i] are phis of their own, counted down with i from n * 12 and data[n]
+    IrFunc* scaled = loop_test_func("scaled");
+    assert(loop_test_count(scaled, IrOp::MUL, true) == 0 && loop_test_count(scaled, IrOp::ELEM_ADDR, true) == 1);
+    assert(loop_test_count(scaled, IrOp::PHI, false) == 4);
+
+    //*four copies of the body with its branch, and no loop left
+    IrFunc* fixed = loop_test_func("fixed");
+    assert(loop_test_count(fixed, IrOp::PHI, true) == 0 && loop_test_count(fixed, IrOp::LOAD, false) == 8 && loop_test_count(fixed, IrOp::BRANCH, false) == 4);
+
+    IrFunc* counted = loop_test_func("counted");
+    assert(counted->num_insts == 3 && counted->insts[1].op == IrOp::CONST_INT && counted->insts[1].int_val == 20);
+
+    //*too many trips, and a loop left from the middle
+    assert(loop_test_count(loop_test_func("many"), IrOp::PHI, true) > 0);
+    assert(loop_test_count(loop_test_func("exits"), IrOp::PHI, true) > 0);
+
+    reset_syms();
+}
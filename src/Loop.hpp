@@ -0,0 +1,30 @@
+#pragma once
+#include "Opt.hpp"
+
+//*natural loops of the control flow graph and the loop passes declared in Opt.hpp. a back edge goes to a block that
+//*dominates its source, and all back edges into one header form one loop: the header and every block that reaches a
+//*back edge without passing through the header
+
+struct IrLoop {
+    u32 header;
+    u32 preheader; //*the one block outside the loop that enters it, ending in a jump, IR_NO_BLOCK when there is none
+    u32 num_latches; //*edges from inside the loop back to the header
+    bool is_innermost;
+    std::vector<u32> blocks; //*ascending, so the header comes first and the rest follow in reverse postorder
+    std::vector<u8> contains; //*indexed by block
+};
+
+//*every loop of a function, each one after the loops nested in it
+void ir_find_loops(IrFunc* func, std::vector<IrLoop>* loops);
+
+//*a basic induction variable, a header phi that enters with init and adds the constant step on every back edge
+struct IrInduction {
+    IrValue phi;
+    IrValue init;
+    IrValue next; //*phi plus step, the operand of every back edge
+    ResolvedExpr step; //*of the phi's type, negative for a phi that is counted down
+};
+
+bool ir_find_induction(IrFunc* func, const IrLoop& loop, IrValue phi, IrInduction* iv);
+
+void loop_test();
@@ -47,4 +47,8 @@ void Arena::free_all() {
     for (u8* it : blocks) {
         free(it);
     }
+
+    blocks.clear();
+    ptr = nullptr;
+    end = nullptr;
 }
\ No newline at end of file
@@ -0,0 +1,855 @@
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <unordered_map>
+#include "Opt.hpp"
+#include "Globals.hpp"
+#include "Parse.hpp"
+
+GlobalVariable const char* ir_pass_names[] = { "sccp", "copy_prop", "gvn", "licm", "strength_reduce", "unroll", "vectorize", "dce" };
+static_assert(sizeof(ir_pass_names) / sizeof(*ir_pass_names) == (size_t)IrPass::SIZE_OF_ENUM, "ir_pass_names is out of date");
+
+const char* ir_pass_name(IrPass pass) {
+    return ir_pass_names[(int)pass];
+}
+
+u32 ir_num_list(IrInst* inst) {
+    return inst->op == IrOp::PHI || inst->op == IrOp::CALL ? inst->operands.count : 0;
+}
+
+IrValue ir_use(IrFunc* func, IrInst* inst, u32 i) {
+    return i < 2 ? inst->args[i] : func->operands[inst->operands.first + i - 2];
+}
+
+void ir_find_uses(IrFunc* func, IrUses* uses) {
+    uses->first.assign(func->num_insts + 1, 0);
+    for (IrValue v = 1; v < func->num_insts; v++) {
+        IrInst* inst = func->insts + v;
+        for (u32 i = 0; i < 2 + ir_num_list(inst); i++) {
+            uses->first[ir_use(func, inst, i)]++;
+        }
+    }
+
+    u32 sum = 0;
+    for (u32& it : uses->first) {
+        u32 count = it;
+        it = sum;
+        sum += count;
+    }
+    uses->users.resize(sum);
+    std::vector<u32> next(uses->first.begin(), uses->first.end() - 1);
+    for (IrValue v = 1; v < func->num_insts; v++) {
+        IrInst* inst = func->insts + v;
+        for (u32 i = 0; i < 2 + ir_num_list(inst); i++) {
+            uses->users[next[ir_use(func, inst, i)]++] = v;
+        }
+    }
+}
+
+void ir_def_blocks(IrFunc* func, std::vector<u32>* def_block) {
+    def_block->assign(func->num_insts, IR_NO_BLOCK);
+    for (u32 b = 0; b < func->num_blocks; b++) {
+        for (IrValue v = func->blocks[b].first; v < func->blocks[b].first + func->blocks[b].num_insts; v++) {
+            (*def_block)[v] = b;
+        }
+    }
+}
+
+bool ir_is_pure(IrOp op) {
+    return (op >= IrOp::CONST_INT && op <= IrOp::STR) || (op >= IrOp::ADD && op <= IrOp::CONVERT) || op == IrOp::ELEM_ADDR || op == IrOp::FIELD_ADDR;
+}
+
+Internal bool ir_is_const(IrFunc* func, IrValue value, i64 val) {
+    IrInst* inst = func->insts + value;
+    return inst->op == IrOp::CONST_INT && inst->int_val == val;
+}
+
+TokenKind ir_fold_op(IrOp op) {
+    switch (op) {
+        case IrOp::ADD: {
+            return TokenKind::ADD;
+        }
+        case IrOp::SUB: {
+            return TokenKind::SUB;
+        }
+        case IrOp::MUL: {
+            return TokenKind::MUL;
+        }
+        case IrOp::DIV: {
+            return TokenKind::DIV;
+        }
+        case IrOp::MOD: {
+            return TokenKind::MOD;
+        }
+        case IrOp::AND: {
+            return TokenKind::AND;
+        }
+        case IrOp::OR: {
+            return TokenKind::OR;
+        }
+        case IrOp::XOR: {
+            return TokenKind::XOR;
+        }
+        case IrOp::SHL: {
+            return TokenKind::LSHIFT;
+        }
+        case IrOp::SHR: {
+            return TokenKind::RSHIFT;
+        }
+        case IrOp::EQ: {
+            return TokenKind::EQ;
+        }
+        case IrOp::NE: {
+            return TokenKind::NOTEQ;
+        }
+        case IrOp::LT: {
+            return TokenKind::LT;
+        }
+        case IrOp::LE: {
+            return TokenKind::LTEQ;
+        }
+        case IrOp::GT: {
+            return TokenKind::GT;
+        }
+        case IrOp::GE: {
+            return TokenKind::GTEQ;
+        }
+        default: {
+            assert(false);
+            return TokenKind::ADD;
+        }
+    }
+}
+
+//*sparse conditional constant propagation, Wegman and Zadeck. values start unknown and only move down to one constant
+//*and then to varying, edges start dead and become executable when a branch that can take them is reached. a
+//*constant branch condition leaves the other edge dead, and what only dead edges reach is removed
+
+enum class SccpState : u8 {
+    UNKNOWN,
+    CONST,
+    VARYING,
+};
+
+struct SccpValue {
+    SccpState state;
+    ResolvedExpr val;
+};
+
+GlobalVariable std::vector<SccpValue> sccp_values;
+GlobalVariable std::vector<u8> sccp_edges; //*indexed like IrFunc::preds
+GlobalVariable std::vector<u8> sccp_taken; //*block * 2 + i, the terminator of block has made target i executable
+GlobalVariable std::vector<u8> sccp_blocks;
+GlobalVariable std::vector<u32> sccp_edge_work;
+GlobalVariable std::vector<IrValue> sccp_value_work;
+
+Internal bool sccp_same(ResolvedExpr left, ResolvedExpr right) {
+    return left.type == right.type && memcmp(&left.int_val, &right.int_val, sizeof(left.int_val)) == 0;
+}
+
+Internal SccpValue sccp_const(ResolvedExpr val) {
+    SccpValue value = { SccpState::CONST, val };
+    return value;
+}
+
+Internal SccpValue sccp_varying() {
+    SccpValue value = {};
+    value.state = SccpState::VARYING;
+    return value;
+}
+
+//*the meet of two lattice values
+Internal SccpValue sccp_meet(SccpValue left, SccpValue right) {
+    if (left.state == SccpState::UNKNOWN) {
+        return right;
+    }
+    if (right.state == SccpState::UNKNOWN) {
+        return left;
+    }
+    if (left.state == SccpState::CONST && right.state == SccpState::CONST && sccp_same(left.val, right.val)) {
+        return left;
+    }
+    return sccp_varying();
+}
+
+Internal void sccp_take(IrFunc* func, u32 block, u32 i) {
+    if (sccp_taken[block * 2 + i]) {
+        return;
+    }
+    sccp_taken[block * 2 + i] = 1;
+
+    //*a branch with both targets in one block has two edges there, each target takes the first that is still dead
+    u32 succ = ir_succ(func, block, i);
+    IrBlock* it = func->blocks + succ;
+    for (u32 slot = it->first_pred; slot < it->first_pred + it->num_preds; slot++) {
+        if (func->preds[slot] == block && !sccp_edges[slot]) {
+            sccp_edges[slot] = 1;
+            sccp_edge_work.push_back(slot);
+            return;
+        }
+    }
+    assert(false);
+}
+
+Internal SccpValue sccp_eval(IrFunc* func, IrValue v, u32 block) {
+    IrInst* inst = func->insts + v;
+    Type* type = Global::types[inst->type];
+    SccpValue left = inst->args[0] ? sccp_values[inst->args[0]] : SccpValue{};
+    SccpValue right = inst->args[1] ? sccp_values[inst->args[1]] : SccpValue{};
+    switch (inst->op) {
+        case IrOp::CONST_INT: {
+            ResolvedExpr val = {};
+            val.type = type;
+            val.is_const = true;
+            val.int_val = inst->int_val;
+            return is_arithmetic_type(type) ? sccp_const(val) : sccp_varying();
+        }
+        case IrOp::CONST_FLOAT: {
+            ResolvedExpr val = {};
+            val.type = type;
+            val.is_const = true;
+            val.float_val = inst->float_val;
+            return sccp_const(val);
+        }
+        case IrOp::PHI: {
+            SccpValue value = {};
+            IrBlock* it = func->blocks + block;
+            for (u32 i = 0; i < inst->operands.count; i++) {
+                if (sccp_edges[it->first_pred + i]) {
+                    value = sccp_meet(value, sccp_values[func->operands[inst->operands.first + i]]);
+                }
+            }
+            return value;
+        }
+        case IrOp::ADD:
+        case IrOp::SUB:
+        case IrOp::MUL:
+        case IrOp::DIV:
+        case IrOp::MOD:
+        case IrOp::AND:
+        case IrOp::OR:
+        case IrOp::XOR:
+        case IrOp::SHL:
+        case IrOp::SHR:
+        case IrOp::EQ:
+        case IrOp::NE:
+        case IrOp::LT:
+        case IrOp::LE:
+        case IrOp::GT:
+        case IrOp::GE: {
+            if (left.state == SccpState::VARYING || right.state == SccpState::VARYING) {
+                return sccp_varying();
+            }
+            if (left.state == SccpState::UNKNOWN || right.state == SccpState::UNKNOWN) {
+                return SccpValue{};
+            }
+            ResolvedExpr val = {};
+            return fold_binary(ir_fold_op(inst->op), left.val, right.val, &val) ? sccp_const(val) : sccp_varying();
+        }
+        case IrOp::NEG:
+        case IrOp::CONVERT: {
+            if (left.state != SccpState::CONST || !is_arithmetic_type(type)) {
+                return left.state == SccpState::UNKNOWN ? SccpValue{} : sccp_varying();
+            }
+            ResolvedExpr val = left.val;
+            if (inst->op == IrOp::CONVERT) {
+                return sccp_const(fold_convert(val, type));
+            }
+            if (is_floating_type(type)) {
+                val.float_val = -val.float_val;
+                return sccp_const(val);
+            }
+            ResolvedExpr zero = val;
+            zero.int_val = 0;
+            fold_binary(TokenKind::SUB, zero, left.val, &val);
+            return sccp_const(val);
+        }
+        case IrOp::JUMP: {
+            sccp_take(func, block, 0);
+            return SccpValue{};
+        }
+        case IrOp::BRANCH: {
+            if (left.state == SccpState::CONST) {
+                sccp_take(func, block, left.val.int_val ? 0 : 1);
+            }
+            else if (left.state == SccpState::VARYING) {
+                sccp_take(func, block, 0);
+                sccp_take(func, block, 1);
+            }
+            return SccpValue{};
+        }
+        default: {
+            return ir_has_result(inst->op) ? sccp_varying() : SccpValue{};
+        }
+    }
+}
+
+Internal void sccp_visit(IrFunc* func, IrValue v, u32 block, const IrUses& uses) {
+    SccpValue old = sccp_values[v];
+    if (old.state == SccpState::VARYING) {
+        return;
+    }
+
+    SccpValue value = sccp_eval(func, v, block);
+    if (value.state == SccpState::UNKNOWN || (old.state == SccpState::CONST && value.state == SccpState::CONST && sccp_same(old.val, value.val))) {
+        return;
+    }
+    if (old.state == SccpState::CONST) {
+        value = sccp_varying();
+    }
+    sccp_values[v] = value;
+    for (u32 i = uses.first[v]; i < uses.first[v + 1]; i++) {
+        sccp_value_work.push_back(uses.users[i]);
+    }
+}
+
+IrFunc* ir_sccp(IrFunc* func) {
+    IrUses uses;
+    ir_find_uses(func, &uses);
+    std::vector<u32> def_block;
+    ir_def_blocks(func, &def_block);
+    std::vector<u32> slot_block(func->num_preds);
+    for (u32 b = 0; b < func->num_blocks; b++) {
+        for (u32 i = 0; i < func->blocks[b].num_preds; i++) {
+            slot_block[func->blocks[b].first_pred + i] = b;
+        }
+    }
+
+    sccp_values.assign(func->num_insts, SccpValue{});
+    sccp_edges.assign(func->num_preds, 0);
+    sccp_taken.assign(func->num_blocks * 2, 0);
+    sccp_blocks.assign(func->num_blocks, 0);
+    sccp_edge_work.clear();
+    sccp_value_work.clear();
+
+    //*the entry has no edge into it, it is visited as if one had just become executable
+    u32 entry_pending = 1;
+    while (entry_pending || !sccp_edge_work.empty() || !sccp_value_work.empty()) {
+        if (entry_pending || !sccp_edge_work.empty()) {
+            u32 block = 0;
+            if (entry_pending) {
+                entry_pending = 0;
+            }
+            else {
+                block = slot_block[sccp_edge_work.back()];
+                sccp_edge_work.pop_back();
+            }
+
+            //*a block seen before only has new phi operands
+            IrBlock* it = func->blocks + block;
+            bool first_visit = !sccp_blocks[block];
+            sccp_blocks[block] = 1;
+            for (IrValue v = it->first; v < it->first + it->num_insts; v++) {
+                if (!first_visit && func->insts[v].op != IrOp::PHI) {
+                    break;
+                }
+                sccp_visit(func, v, block, uses);
+            }
+            continue;
+        }
+
+        IrValue v = sccp_value_work.back();
+        sccp_value_work.pop_back();
+        if (sccp_blocks[def_block[v]]) {
+            sccp_visit(func, v, def_block[v], uses);
+        }
+    }
+
+    //*constants are rewritten where they are defined, decided branches become jumps
+    for (IrValue v = 1; v < func->num_insts; v++) {
+        IrInst* inst = func->insts + v;
+        SccpValue value = sccp_values[v];
+        if (inst->op == IrOp::BRANCH && sccp_blocks[def_block[v]]) {
+            SccpValue cond = sccp_values[inst->args[0]];
+            if (cond.state == SccpState::CONST) {
+                inst->op = IrOp::JUMP;
+                inst->targets[0] = inst->targets[cond.val.int_val ? 0 : 1];
+                inst->args[0] = IR_NONE;
+            }
+        }
+        else if (value.state == SccpState::CONST && inst->op != IrOp::CONST_INT && inst->op != IrOp::CONST_FLOAT) {
+            assert(value.val.type->id == inst->type);
+            inst->op = is_floating_type(value.val.type) ? IrOp::CONST_FLOAT : IrOp::CONST_INT;
+            inst->args[0] = IR_NONE;
+            inst->args[1] = IR_NONE;
+            inst->int_val = value.val.int_val;
+        }
+    }
+
+    return ir_rebuild(func, nullptr);
+}
+
+//*copy propagation. SSA has no copy instruction, values are passed on by phis whose operands agree and by operations
+//*that give back an operand unchanged. their uses are pointed at the value, and they are deleted
+
+Internal IrValue ir_find_copy(IrFunc* func, IrValue v, const std::vector<IrValue>& replace) {
+    IrInst* inst = func->insts + v;
+    IrValue left = inst->args[0];
+    IrValue right = inst->args[1];
+    while (left && replace[left]) {
+        left = replace[left];
+    }
+    while (right && replace[right]) {
+        right = replace[right];
+    }
+
+    Type* type = Global::types[inst->type];
+    bool is_int = inst->type && is_integer_type(type);
+    switch (inst->op) {
+        case IrOp::PHI: {
+            IrValue same = IR_NONE;
+            for (u32 i = 0; i < inst->operands.count; i++) {
+                IrValue operand = func->operands[inst->operands.first + i];
+                while (replace[operand]) {
+                    operand = replace[operand];
+                }
+                if (operand == v || operand == same) {
+                    continue;
+                }
+                if (same) {
+                    return IR_NONE;
+                }
+                same = operand;
+            }
+            return same;
+        }
+        case IrOp::ADD:
+        case IrOp::OR:
+        case IrOp::XOR: {
+            if (is_int && ir_is_const(func, left, 0)) {
+                return right;
+            }
+            return is_int && ir_is_const(func, right, 0) ? left : IR_NONE;
+        }
+        case IrOp::MUL: {
+            if (is_int && ir_is_const(func, left, 1)) {
+                return right;
+            }
+            return is_int && ir_is_const(func, right, 1) ? left : IR_NONE;
+        }
+        case IrOp::SUB:
+        case IrOp::SHL:
+        case IrOp::SHR: {
+            return is_int && ir_is_const(func, right, 0) ? left : IR_NONE;
+        }
+        case IrOp::DIV: {
+            return is_int && ir_is_const(func, right, 1) ? left : IR_NONE;
+        }
+        case IrOp::AND: {
+            if (!is_int) {
+                return IR_NONE;
+            }
+            ResolvedExpr ones = {};
+            ones.type = Global::type_llong;
+            ones.is_const = true;
+            ones.int_val = -1;
+            i64 mask = fold_convert(ones, type).int_val;
+            if (ir_is_const(func, left, mask)) {
+                return right;
+            }
+            return ir_is_const(func, right, mask) ? left : IR_NONE;
+        }
+        case IrOp::CONVERT: {
+            //*an integer widened and narrowed back to its own type
+            IrInst* inner = func->insts + left;
+            if (!is_int || inner->op != IrOp::CONVERT) {
+                return IR_NONE;
+            }
+            IrValue source = inner->args[0];
+            while (replace[source]) {
+                source = replace[source];
+            }
+            Type* middle = Global::types[inner->type];
+            bool widened = is_integer_type(middle) && middle->size >= type->size && type->kind != TypeKind::BOOL;
+            return widened && func->insts[source].type == inst->type ? source : IR_NONE;
+        }
+        default: {
+            return IR_NONE;
+        }
+    }
+}
+
+IrFunc* ir_copy_prop(IrFunc* func) {
+    std::vector<IrValue> replace(func->num_insts, IR_NONE);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (IrValue v = 1; v < func->num_insts; v++) {
+            if (replace[v] || func->insts[v].op == IrOp::NOP) {
+                continue;
+            }
+            IrValue copy = ir_find_copy(func, v, replace);
+            if (copy) {
+                replace[v] = copy;
+                changed = true;
+            }
+        }
+    }
+
+    for (IrValue v = 1; v < func->num_insts; v++) {
+        if (replace[v]) {
+            func->insts[v].op = IrOp::NOP;
+        }
+    }
+    return ir_rebuild(func, &replace);
+}
+
+//*dominator based value numbering. pure instructions are keyed by what they compute, walking the dominator tree
+//*with a scoped table so that only definitions in dominating blocks are found
+
+struct GvnKey {
+    IrOp op;
+    u32 type;
+    IrValue args[2];
+    i64 imm;
+
+    bool operator==(const GvnKey& other) const {
+        return op == other.op && type == other.type && args[0] == other.args[0] && args[1] == other.args[1] && imm == other.imm;
+    }
+};
+
+struct GvnKeyHash {
+    size_t operator()(const GvnKey& key) const {
+        u64 hash = 0xcbf29ce484222325ull;
+        u64 parts[] = { (u64)key.op << 32 | key.type, (u64)key.args[0] << 32 | key.args[1], (u64)key.imm };
+        for (u64 it : parts) {
+            hash = (hash ^ it) * 0x100000001b3ull;
+            hash ^= hash >> 29;
+        }
+        return (size_t)hash;
+    }
+};
+
+Internal GvnKey gvn_key(IrInst* inst, const std::vector<IrValue>& replace) {
+    GvnKey key = { inst->op, inst->type, { inst->args[0], inst->args[1] }, 0 };
+    for (IrValue& it : key.args) {
+        while (it && replace[it]) {
+            it = replace[it];
+        }
+    }
+
+    switch (inst->op) {
+        case IrOp::CONST_INT:
+        case IrOp::CONST_FLOAT:
+        case IrOp::PARAM:
+        case IrOp::FIELD_ADDR: {
+            key.imm = inst->int_val;
+            break;
+        }
+        case IrOp::GLOBAL: {
+            key.imm = (i64)(uintptr_t)inst->sym;
+            break;
+        }
+        case IrOp::STR: {
+            key.imm = (i64)(uintptr_t)inst->str;
+            break;
+        }
+        case IrOp::ADD:
+        case IrOp::MUL:
+        case IrOp::AND:
+        case IrOp::OR:
+        case IrOp::XOR:
+        case IrOp::EQ:
+        case IrOp::NE: {
+            if (key.args[0] > key.args[1]) {
+                std::swap(key.args[0], key.args[1]);
+            }
+            break;
+        }
+        case IrOp::GT:
+        case IrOp::GE: {
+            //*a > b is b < a
+            key.op = inst->op == IrOp::GT ? IrOp::LT : IrOp::LE;
+            std::swap(key.args[0], key.args[1]);
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+    return key;
+}
+
+struct GvnFrame {
+    u32 block;
+    u32 next_child;
+    size_t undo_start;
+};
+
+IrFunc* ir_gvn(IrFunc* func) {
+    std::vector<u32> idom;
+    ir_dominators(func, &idom);
+    std::vector<u32> first_child(func->num_blocks + 1, 0);
+    std::vector<u32> children(func->num_blocks);
+    for (u32 b = 1; b < func->num_blocks; b++) {
+        first_child[idom[b]]++;
+    }
+    u32 sum = 0;
+    for (u32& it : first_child) {
+        u32 count = it;
+        it = sum;
+        sum += count;
+    }
+    std::vector<u32> next(first_child.begin(), first_child.end() - 1);
+    for (u32 b = 1; b < func->num_blocks; b++) {
+        children[next[idom[b]]++] = b;
+    }
+
+    std::vector<IrValue> replace(func->num_insts, IR_NONE);
+    std::unordered_map<GvnKey, IrValue, GvnKeyHash> table;
+    std::vector<GvnKey> undo;
+    std::vector<GvnFrame> stack;
+    stack.push_back(GvnFrame{ 0, 0, 0 });
+    bool entered = false;
+    while (!stack.empty()) {
+        GvnFrame* frame = &stack.back();
+        if (!entered) {
+            IrBlock* it = func->blocks + frame->block;
+            for (IrValue v = it->first; v < it->first + it->num_insts; v++) {
+                IrInst* inst = func->insts + v;
+                if (!ir_is_pure(inst->op)) {
+                    continue;
+                }
+                GvnKey key = gvn_key(inst, replace);
+                auto found = table.find(key);
+                if (found != table.end()) {
+                    replace[v] = found->second;
+                    inst->op = IrOp::NOP;
+                }
+                else {
+                    table[key] = v;
+                    undo.push_back(key);
+                }
+            }
+        }
+
+        u32 child = first_child[frame->block] + frame->next_child;
+        if (child < first_child[frame->block + 1]) {
+            frame->next_child++;
+            stack.push_back(GvnFrame{ children[child], 0, undo.size() });
+            entered = false;
+            continue;
+        }
+
+        while (undo.size() > frame->undo_start) {
+            table.erase(undo.back());
+            undo.pop_back();
+        }
+        stack.pop_back();
+        entered = true;
+    }
+
+    return ir_rebuild(func, &replace);
+}
+
+//*dead code elimination. instructions are live when a store, call or terminator needs them, directly or through
+//*other live instructions. a slot whose address only ever receives stores is never read, those stores are dead too
+
+Internal bool dce_is_addr_op(IrInst* inst, IrValue addr) {
+    return (inst->op == IrOp::FIELD_ADDR || inst->op == IrOp::ELEM_ADDR || inst->op == IrOp::CONVERT) && inst->args[0] == addr && inst->args[1] != addr
+        && Global::types[inst->type]->kind == TypeKind::PTR;
+}
+
+//*every live use of the alloca, and of addresses derived from it, stores into it
+Internal bool dce_is_write_only(IrFunc* func, IrValue slot, const IrUses& uses, const std::vector<u8>& live, std::vector<IrValue>* stack) {
+    stack->clear();
+    stack->push_back(slot);
+    while (!stack->empty()) {
+        IrValue addr = stack->back();
+        stack->pop_back();
+        for (u32 i = uses.first[addr]; i < uses.first[addr + 1]; i++) {
+            IrInst* user = func->insts + uses.users[i];
+            if (!live[uses.users[i]]) {
+                continue;
+            }
+            if (dce_is_addr_op(user, addr)) {
+                stack->push_back(uses.users[i]);
+            }
+            else if (!((user->op == IrOp::STORE || user->op == IrOp::ZERO) && user->args[0] == addr && user->args[1] != addr)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+IrFunc* ir_dce(IrFunc* func) {
+    IrUses uses;
+    ir_find_uses(func, &uses);
+    std::vector<u8> dead_slot(func->num_insts, 0);
+    std::vector<u8> live;
+    std::vector<IrValue> work;
+
+    //*a slot read only by dead loads is write-only once they are known to be dead, so liveness is found again
+    //*until no more slots die
+    for (;;) {
+        //*the address of a store or zero leads back to its slot through address arithmetic
+        live.assign(func->num_insts, 0);
+        for (IrValue v = 1; v < func->num_insts; v++) {
+            IrInst* inst = func->insts + v;
+            bool is_root = inst->op == IrOp::CALL || inst->op == IrOp::STORE || inst->op == IrOp::ZERO || ir_is_terminator(inst->op);
+            if (inst->op == IrOp::STORE || inst->op == IrOp::ZERO) {
+                IrValue addr = inst->args[0];
+                while (func->insts[addr].op != IrOp::ALLOCA && dce_is_addr_op(func->insts + addr, func->insts[addr].args[0])) {
+                    addr = func->insts[addr].args[0];
+                }
+                is_root = !dead_slot[addr];
+            }
+            if (is_root) {
+                live[v] = 1;
+                work.push_back(v);
+            }
+        }
+
+        while (!work.empty()) {
+            IrInst* inst = func->insts + work.back();
+            work.pop_back();
+            for (u32 i = 0; i < 2 + ir_num_list(inst); i++) {
+                IrValue use = ir_use(func, inst, i);
+                if (use && !live[use]) {
+                    live[use] = 1;
+                    work.push_back(use);
+                }
+            }
+        }
+
+        bool changed = false;
+        for (IrValue v = 1; v < func->num_insts; v++) {
+            if (func->insts[v].op == IrOp::ALLOCA && !dead_slot[v] && dce_is_write_only(func, v, uses, live, &work)) {
+                dead_slot[v] = 1;
+                changed = true;
+            }
+        }
+        if (!changed) {
+            break;
+        }
+    }
+
+    for (IrValue v = 1; v < func->num_insts; v++) {
+        if (!live[v]) {
+            func->insts[v].op = IrOp::NOP;
+        }
+    }
+    return ir_rebuild(func, nullptr);
+}
+
+GlobalVariable IrFunc* (*ir_pass_funcs[])(IrFunc*) = { ir_sccp, ir_copy_prop, ir_gvn, ir_licm, ir_strength_reduce, ir_unroll, ir_vectorize, ir_dce };
+static_assert(sizeof(ir_pass_funcs) / sizeof(*ir_pass_funcs) == (size_t)IrPass::SIZE_OF_ENUM, "ir_pass_funcs is out of date");
+
+GlobalVariable IrPass ir_pipeline[] = {
+    IrPass::SCCP, IrPass::COPY_PROP, IrPass::GVN, IrPass::LICM, IrPass::UNROLL, IrPass::VECTORIZE, IrPass::STRENGTH_REDUCE,
+    IrPass::SCCP, IrPass::COPY_PROP, IrPass::GVN, IrPass::DCE,
+};
+
+IrFunc* ir_optimize(IrFunc* func) {
+    Global::ir_pass_ns.resize((size_t)IrPass::SIZE_OF_ENUM, 0);
+    for (IrPass pass : ir_pipeline) {
+        if (!(Global::ir_passes & (1u << (int)pass))) {
+            continue;
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        func = ir_pass_funcs[(int)pass](func);
+        Global::ir_pass_ns[(int)pass] += (f64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+    return func;
+}
+
+void ir_optimize_package() {
+    for (IrFunc*& it : Global::ir_funcs) {
+        it = ir_optimize(it);
+    }
+}
+
+Internal IrFunc* opt_test_func(const char* name) {
+    const char* interned = Global::string_table.add(name);
+    for (IrFunc* it : Global::ir_funcs) {
+        if (it->sym->name == interned) {
+            return it;
+        }
+    }
+    assert(false);
+    return nullptr;
+}
+
+Internal u32 opt_test_count(IrFunc* func, IrOp op) {
+    u32 count = 0;
+    for (IrValue v = 1; v < func->num_insts; v++) {
+        count += func->insts[v].op == op;
+    }
+    return count;
+}
+
+Internal IrFunc* opt_test_verified(IrFunc* func) {
+    std::string error;
+    bool ok = ir_verify(func, &error);
+    if (!ok) {
+        printf("%s%s\n", ir_dump(func).c_str(), error.c_str());
+    }
+    assert(ok);
+    return func;
+}
+
+void opt_test() {
+    const char* src =
+        "struct Vector { x, y: float; }\n"
+        "var g: int\n"
+        "func folded(): int { n := 4; m := n * 8 + 1; if (m > 30) { return m; } return 0; }\n"
+        "func loop(n: int): int { k := 3; s := 0; for (i := 0; i < n; i++) { if (k == 3) { s += i; } else { s -= i; } } return s; }\n"
+        "func copies(a: int): int { b := a + 0; c := b * 1; return (c | 0) - 0; }\n"
+        "func common(a: int, b: int, p: int*): int { x := a * b + p[a]; if (b > a) { x += a * b + p[a]; } return x + (a < b); }\n"
+        "func dead(a: int): int { unused := a * 7; var v: Vector = {1, 2} var w: Vector v.x = 3.0; w = v; return a; }\n"
+        "func keep(p: int*): int { var v: Vector = {1, 2} g = a_call(); *p = 1; return g; }\n"
+        "func a_call(): int { return g + 1; }\n"
+        "func widen(c: char): char { var x: int = c return x; }\n";
+
+    assert(load_package_src("opt_test.sorin", src));
+    ir_lower_package();
+
+    //*each pass alone keeps every function valid. passes edit their input, so each gets a fresh one
+    for (IrFunc* it : Global::ir_funcs) {
+        for (int pass = 0; pass < (int)IrPass::SIZE_OF_ENUM; pass++) {
+            opt_test_verified(ir_pass_funcs[pass](ir_lower_func(it->sym)));
+        }
+    }
+
+    Global::ir_pass_ns.clear();
+    ir_optimize_package();
+    for (IrFunc* it : Global::ir_funcs) {
+        opt_test_verified(it);
+    }
+    assert(Global::ir_pass_ns.size() == (size_t)IrPass::SIZE_OF_ENUM);
+
+    //*the condition is known, only the return of 33 is left
+    IrFunc* folded = opt_test_func("folded");
+    assert(folded->num_blocks == 1 && folded->num_insts == 3);
+    assert(folded->insts[1].op == IrOp::CONST_INT && folded->insts[1].int_val == 33);
+
+    //*k == 3 always holds, so the else branch and its phi are gone
+    IrFunc* loop = opt_test_func("loop");
+    assert(opt_test_count(loop, IrOp::EQ) == 0 && opt_test_count(loop, IrOp::SUB) == 0 && opt_test_count(loop, IrOp::PHI) == 2);
+
+    IrFunc* copies = opt_test_func("copies");
+    assert(copies->num_insts == 3 && copies->insts[1].op == IrOp::PARAM && copies->insts[2].args[0] == 1);
+
+    //*a * b and p[a] are computed once, the load after the branch is not merged with the one before
+    IrFunc* common = opt_test_func("common");
+    assert(opt_test_count(common, IrOp::MUL) == 1 && opt_test_count(common, IrOp::ELEM_ADDR) == 1 && opt_test_count(common, IrOp::LOAD) == 2);
+    assert(opt_test_count(common, IrOp::GT) == 1 && opt_test_count(common, IrOp::LT) == 0);
+
+    //*slots that are only written go with their stores
+    IrFunc* dead = opt_test_func("dead");
+    assert(dead->num_insts == 3 && opt_test_count(dead, IrOp::ALLOCA) == 0);
+
+    IrFunc* keep = opt_test_func("keep");
+    assert(opt_test_count(keep, IrOp::CALL) == 1 && opt_test_count(keep, IrOp::STORE) == 2 && opt_test_count(keep, IrOp::ALLOCA) == 0);
+    assert(opt_test_count(opt_test_func("widen"), IrOp::CONVERT) == 0);
+
+    //*disabled passes do not run
+    ir_lower_package();
+    Global::ir_passes = 1u << (int)IrPass::DCE;
+    IrFunc* unfolded = opt_test_verified(ir_optimize(opt_test_func("folded")));
+    assert(opt_test_count(unfolded, IrOp::BRANCH) == 1);
+    Global::ir_passes = 0xFFFFFFFF;
+
+    reset_syms();
+}
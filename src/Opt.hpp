@@ -0,0 +1,56 @@
+#pragma once
+#include "Ir.hpp"
+
+//*optimizations on the SSA IR. every pass edits a function in place, or through an IrEdit when it adds instructions
+//*and blocks, and lays it out again, so each one returns the function that replaces its input
+
+enum class IrPass : u8 {
+    SCCP, //*sparse conditional constant propagation, folds constants and the branches they decide
+    COPY_PROP, //*uses of phis and identities that only pass a value on go to that value
+    GVN, //*a pure instruction equal to one in a dominating block is replaced by it
+    LICM, //*pure instructions of a loop whose operands come from outside it move to its preheader
+    STRENGTH_REDUCE, //*multiples of an induction variable and addresses indexed by one become induction variables
+    UNROLL, //*innermost loops with a small constant trip count are replaced by that many copies of their body
+    VECTORIZE, //*counted loops over arrays run a vector loop over most of their range and the scalar loop over the rest
+    DCE, //*instructions nothing observable uses, and stores into slots that are never read
+    SIZE_OF_ENUM,
+};
+
+const char* ir_pass_name(IrPass pass);
+
+IrFunc* ir_sccp(IrFunc* func);
+IrFunc* ir_copy_prop(IrFunc* func);
+IrFunc* ir_gvn(IrFunc* func);
+IrFunc* ir_licm(IrFunc* func);
+IrFunc* ir_strength_reduce(IrFunc* func);
+IrFunc* ir_unroll(IrFunc* func);
+IrFunc* ir_vectorize(IrFunc* func);
+IrFunc* ir_dce(IrFunc* func);
+
+//*runs the passes enabled in Global::ir_passes in pipeline order, adding the time of each to Global::ir_pass_ns.
+//*the scalar passes run again after the loop passes, which leave constants and copies behind
+IrFunc* ir_optimize(IrFunc* func);
+
+//*optimizes every function in Global::ir_funcs in place
+void ir_optimize_package();
+
+//*shared by the passes
+
+//*users of every value, users[first[v]..first[v + 1]) use v. a value used twice by one instruction is listed twice
+struct IrUses {
+    std::vector<u32> first;
+    std::vector<IrValue> users;
+};
+
+void ir_find_uses(IrFunc* func, IrUses* uses);
+//*block of every instruction
+void ir_def_blocks(IrFunc* func, std::vector<u32>* def_block);
+u32 ir_num_list(IrInst* inst);
+//*i < 2 are the args, the rest the operand list
+IrValue ir_use(IrFunc* func, IrInst* inst, u32 i);
+//*instructions without side effects whose result only depends on their operands
+bool ir_is_pure(IrOp op);
+//*the token of the resolver's folding for each arithmetic op
+TokenKind ir_fold_op(IrOp op);
+
+void opt_test();
@@ -6,6 +6,8 @@
 #include <cassert>
 #include <vector>
 
+const char* parse_name();
+
 Internal Typespec* parse_type_func() {
     std::vector<Typespec*> args;
     expect_token(TokenKind::LPAREN);
@@ -41,8 +43,8 @@ Internal Typespec* parse_type_base() {
         return type;
     }
 
-    fatal_syntax_error("Unexpected token %s in type", token_info());
-    return nullptr;
+    parse_error("Unexpected token %s in type", token_info());
+    return typespec_error();
 }
 
 Typespec* parse_type() {
@@ -139,8 +141,8 @@ Internal Expr* parse_expr_operand() {
         }
     }
 
-    fatal_syntax_error("Unexpected token %s in expression", token_info());
-    return nullptr;
+    parse_error("Unexpected token %s in expression", token_info());
+    return expr_error();
 }
 
 Internal Expr* parse_expr_base() {
@@ -166,9 +168,7 @@ Internal Expr* parse_expr_base() {
         else {
             assert(is_token(TokenKind::DOT));
             next_token();
-            const char* field = Global::token.name;
-            expect_token(TokenKind::NAME);
-            expr = expr_field(expr, field);
+            expr = expr_field(expr, parse_name());
         }
     }
 
@@ -189,11 +189,66 @@ Internal Expr* parse_expr_unary() {
     return parse_expr_base();
 }
 
+//*binding power of each binary operator token, 0 for tokens that are not binary operators.
+//*higher binds tighter, built from the FIRST_*/LAST_* precedence ranges in TokenKind.
+enum BinaryPrec : u8 {
+    PREC_NONE,
+    PREC_OR,
+    PREC_AND,
+    PREC_CMP,
+    PREC_ADD,
+    PREC_MUL,
+};
+
+struct BinaryPrecTable {
+    u8 prec[(int)TokenKind::SIZE_OF_ENUM];
+};
+
+Internal constexpr BinaryPrecTable make_binary_prec_table() {
+    BinaryPrecTable table = {};
+    for (int kind = (int)TokenKind::FIRST_MUL; kind <= (int)TokenKind::LAST_MUL; kind++) {
+        table.prec[kind] = PREC_MUL;
+    }
+    for (int kind = (int)TokenKind::FIRST_ADD; kind <= (int)TokenKind::LAST_ADD; kind++) {
+        table.prec[kind] = PREC_ADD;
+    }
+    for (int kind = (int)TokenKind::FIRST_CMP; kind <= (int)TokenKind::LAST_CMP; kind++) {
+        table.prec[kind] = PREC_CMP;
+    }
+    table.prec[(int)TokenKind::AND_AND] = PREC_AND;
+    table.prec[(int)TokenKind::OR_OR] = PREC_OR;
+    return table;
+}
+
+GlobalVariable constexpr BinaryPrecTable binary_prec = make_binary_prec_table();
+
+//*precedence climbing: parses a chain of binary operators whose binding power is at least min_prec.
+//*every operator level is handled by the same loop, so an operand costs one call here instead of one per level.
+Internal Expr* parse_expr_binary(int min_prec) {
+    Global::parse_binary_calls++;
+    Expr* expr = parse_expr_unary();
+    while (true) {
+        TokenKind op = Global::token.kind;
+        int prec = binary_prec.prec[(int)op];
+        if (prec < min_prec) {
+            break;
+        }
+
+        next_token();
+        expr = expr_binary(op, expr, parse_expr_binary(prec + 1));
+    }
+
+    return expr;
+}
+
+//*the descent chain precedence climbing replaced, one function per level, kept as the baseline of bench parse_expr
+
 Internal bool is_mul_op() {
     return TokenKind::FIRST_MUL <= Global::token.kind && Global::token.kind <= TokenKind::LAST_MUL;
 }
 
 Internal Expr* parse_expr_mul() {
+    Global::parse_binary_calls++;
     Expr* expr = parse_expr_unary();
     while (is_mul_op()) {
         TokenKind op = Global::token.kind;
@@ -209,6 +264,7 @@ Internal bool is_add_op() {
 }
 
 Internal Expr* parse_expr_add() {
+    Global::parse_binary_calls++;
     Expr* expr = parse_expr_mul();
     while (is_add_op()) {
         TokenKind op = Global::token.kind;
@@ -224,17 +280,19 @@ Internal bool is_cmp_op() {
 }
 
 Internal Expr* parse_expr_cmp() {
+    Global::parse_binary_calls++;
     Expr* expr = parse_expr_add();
     while (is_cmp_op()) {
         TokenKind op = Global::token.kind;
         next_token();
-        expr =  expr_binary(op, expr, parse_expr_add());
+        expr = expr_binary(op, expr, parse_expr_add());
     }
 
     return expr;
 }
 
 Internal Expr* parse_expr_and() {
+    Global::parse_binary_calls++;
     Expr* expr = parse_expr_cmp();
     while (match_token(TokenKind::AND_AND)) {
         expr = expr_binary(TokenKind::AND_AND, expr, parse_expr_cmp());
@@ -243,6 +301,7 @@ Internal Expr* parse_expr_and() {
 }
 
 Internal Expr* parse_expr_or() {
+    Global::parse_binary_calls++;
     Expr* expr = parse_expr_and();
     while (match_token(TokenKind::OR_OR)) {
         expr = expr_binary(TokenKind::OR_OR, expr, parse_expr_and());
@@ -251,7 +310,7 @@ Internal Expr* parse_expr_or() {
 }
 
 Internal Expr* parse_expr_ternary() {
-    Expr* expr = parse_expr_or();
+    Expr* expr = Global::parse_descent_chain ? parse_expr_or() : parse_expr_binary(PREC_OR);
     if (match_token(TokenKind::QUESTION)) {
         Expr* then_expr = parse_expr_ternary();
         expect_token(TokenKind::COLON);
@@ -274,8 +333,13 @@ Internal Expr* parse_paren_expr() {
 }
 
 const char* parse_name() {
+    if (!is_token(TokenKind::NAME)) {
+        expect_token(TokenKind::NAME);
+        return Global::string_table.add("<error>");
+    }
+
     const char* name = Global::token.name;
-    expect_token(TokenKind::NAME);
+    next_token();
     return name;
 }
 
@@ -307,6 +371,87 @@ Internal Decl* parse_decl_enum() {
     return decl_enum(name, items.data(), items.size());
 }
 
+//*start of the token after the last statement-ending ';', a broken statement that got this far needs no skipping
+GlobalVariable const char* stmt_end;
+
+Internal void expect_stmt_end() {
+    if (expect_token(TokenKind::SEMICOLON)) {
+        stmt_end = Global::token.start;
+    }
+}
+
+//*keywords that can only start a statement or declaration, the parser resyncs on them after an error
+Internal bool is_sync_keyword() {
+    using namespace Keywords;
+    return is_token(TokenKind::KEYWORD) && Global::token.name != sizeof_keyword && Global::token.name != else_keyword;
+}
+
+Internal void skip_braces() {
+    assert(is_token(TokenKind::LBRACE));
+    int depth = 0;
+    do {
+        if (is_token(TokenKind::LBRACE)) {
+            depth++;
+        }
+        else if (is_token(TokenKind::RBRACE)) {
+            depth--;
+        }
+        next_token();
+    } while (depth > 0 && !is_token_eof());
+}
+
+//*skips past the ';' that ends the broken statement, or up to the '}' of the enclosing block or the next statement keyword
+Internal void sync_stmt(const char* start) {
+    if (Global::token.start == stmt_end && Global::token.start != start) {
+        Global::panic_mode = false;
+        return;
+    }
+
+    //*guarantee progress when the error was raised on the statement's first token
+    if (Global::token.start == start && !is_token_eof() && !is_token(TokenKind::RBRACE)) {
+        next_token();
+    }
+
+    while (!is_token_eof() && !is_token(TokenKind::RBRACE) && !is_sync_keyword()) {
+        if (match_token(TokenKind::SEMICOLON)) {
+            break;
+        }
+        else if (is_token(TokenKind::LBRACE)) {
+            skip_braces();
+        }
+        else {
+            next_token();
+        }
+    }
+
+    Global::panic_mode = false;
+}
+
+Internal bool is_decl_keyword() {
+    using namespace Keywords;
+    const char* name = Global::token.name;
+    return is_token(TokenKind::KEYWORD) && (name == enum_keyword || name == struct_keyword || name == union_keyword || name == var_keyword
+        || name == const_keyword || name == typedef_keyword || name == func_keyword);
+}
+
+//*skips to the next top level declaration keyword, stepping over whole brace blocks so keywords of local declarations are ignored
+Internal void sync_decl(const char* start) {
+    if (Global::token.start == start && !is_token_eof()) {
+        next_token();
+    }
+
+    while (!is_token_eof() && !is_decl_keyword()) {
+        if (is_token(TokenKind::LBRACE)) {
+            skip_braces();
+        }
+        else {
+            next_token();
+        }
+    }
+
+    Global::panic_mode = false;
+}
+
 Internal AggregateItem parse_decl_aggregate_item() {
     std::vector<const char*> names;
     names.push_back(parse_name());
@@ -318,7 +463,7 @@ Internal AggregateItem parse_decl_aggregate_item() {
     expect_token(TokenKind::COLON);
     Typespec* type = parse_type();
     
-    expect_token(TokenKind::SEMICOLON);
+    expect_stmt_end();
     return AggregateItem{ (const char**)ast_dup(names.data(), names.size() * sizeof(const char*)), names.size(), type }; //?see if this ast_dup call can be pulled out into a func
 }
 
@@ -329,7 +474,11 @@ Internal Decl* parse_decl_aggregate(DeclKind kind) {
 
     std::vector<AggregateItem> items;
     while (!is_token_eof() && !is_token(TokenKind::RBRACE)) {
+        const char* start = Global::token.start;
         items.push_back(parse_decl_aggregate_item());
+        if (Global::panic_mode) {
+            sync_stmt(start);
+        }
     }
     expect_token(TokenKind::RBRACE);
 
@@ -351,8 +500,8 @@ Internal Decl* parse_decl_var() {
         return decl_var(name, type, expr);
     }
 
-    fatal_syntax_error("Expected TokenKind::COLON or '=' after var, got %s", token_info());
-    return nullptr;
+    parse_error("Expected TokenKind::COLON or '=' after var, got %s", token_info());
+    return decl_error();
 }
 
 Internal Decl* parse_decl_const() {
@@ -394,13 +543,13 @@ Stmt* parse_stmt_while() {
 Stmt* parse_stmt_do_while() {
     StmtBlock block = parse_stmt_block();
     if (!match_keyword(Keywords::while_keyword)) {
-        fatal_syntax_error("Expected 'while' after 'do' block");
-        return nullptr;
+        parse_error("Expected 'while' after 'do' block");
+        return stmt_error();
     }
 
     Expr* cond = parse_paren_expr();
     Stmt* stmt = stmt_do_while(cond, block);
-    expect_token(TokenKind::SEMICOLON);
+    expect_stmt_end();
     return stmt;
 }
 
@@ -414,8 +563,8 @@ Internal Stmt* parse_simple_stmt() {
 
     if (match_token(TokenKind::COLON_ASSIGN)) {
         if (expr->kind != ExprKind::NAME) {
-            fatal_syntax_error("Colon Assign must be preceded by name");
-            return nullptr;
+            parse_error("Colon Assign must be preceded by name");
+            return stmt_error();
         }
         stmt = stmt_init(expr->name, parse_expr());
     }
@@ -507,7 +656,7 @@ Internal Stmt* parse_stmt_switch() {
 }
 
 
-Stmt* parse_stmt() {
+Internal Stmt* parse_stmt_unsynced() {
     using namespace Keywords;
     if (match_keyword(if_keyword)) {
         return parse_stmt_if();
@@ -528,11 +677,11 @@ Stmt* parse_stmt() {
         return stmt_block(parse_stmt_block());
     }
     else if (match_keyword(break_keyword)) {
-        expect_token(TokenKind::SEMICOLON);
+        expect_stmt_end();
         return stmt_break();
     }
     else if (match_keyword(continue_keyword)) {
-        expect_token(TokenKind::SEMICOLON);
+        expect_stmt_end();
         return stmt_continue();
     }
     else if (match_keyword(return_keyword)) {
@@ -541,7 +690,7 @@ Stmt* parse_stmt() {
             expr = parse_expr();
         }
 
-        expect_token(TokenKind::SEMICOLON);
+        expect_stmt_end();
         return stmt_return(expr);
     }
 
@@ -551,11 +700,27 @@ Stmt* parse_stmt() {
     }
 
     Stmt* stmt = parse_simple_stmt();
-    expect_token(TokenKind::SEMICOLON);
+    expect_stmt_end();
+    return stmt;
+}
+
+Stmt* parse_stmt() {
+    const char* start = Global::token.start;
+    Stmt* stmt = parse_stmt_unsynced();
+    if (Global::panic_mode) {
+        sync_stmt(start);
+        return stmt_error();
+    }
+
     return stmt;
 }
 
 StmtBlock parse_stmt_block() {
+    //*the statement header is already broken, leave the block for the caller's sync to skip
+    if (Global::panic_mode) {
+        return StmtBlock{};
+    }
+
     expect_token(TokenKind::LBRACE);
     std::vector<Stmt*> stmts;
     while (!is_token_eof() && !is_token(TokenKind::RBRACE)) {
@@ -572,6 +737,62 @@ Internal FuncParam parse_decl_func_param() {
     return FuncParam{name, parse_type()};
 }
 
+//*skips a string or char literal in raw source, escapes are stepped over but not checked, that is left to the lexer
+Internal const char* skip_raw_literal(const char* it) {
+    char quote = *it++;
+    while (*it && *it != quote && *it != '\n') {
+        if (*it == '\\' && it[1]) {
+            it++;
+        }
+        it++;
+    }
+
+    return *it == quote ? it + 1 : it;
+}
+
+//*matches the braces of the body that starts at the current '{' by scanning characters instead of lexing tokens.
+//*on success the lexer continues after the closing '}', on an unterminated body nothing is consumed and
+//*the caller falls back to a full parse so the error is reported where it happens.
+Internal bool skip_func_body(LazyBody* body) {
+    if (!is_token(TokenKind::LBRACE)) {
+        return false;
+    }
+
+    const char* it = Global::stream;
+    int depth = 1;
+    while (*it) {
+        char c = *it;
+        if (c == '"' || c == '\'') {
+            it = skip_raw_literal(it);
+            continue;
+        }
+
+        it++;
+        if (c == '{') {
+            depth++;
+        }
+        else if (c == '}') {
+            depth--;
+            if (depth == 0) {
+                break;
+            }
+        }
+    }
+
+    if (depth != 0) {
+        return false;
+    }
+
+    body->start = Global::token.start;
+    body->end = it;
+    body->stream_start = Global::stream_start;
+    body->stream_name = Global::stream_name;
+
+    Global::stream = it;
+    next_token();
+    return true;
+}
+
 Internal Decl* parse_decl_func() {
     const char* name = parse_name();
     expect_token(TokenKind::LPAREN);
@@ -590,11 +811,50 @@ Internal Decl* parse_decl_func() {
         ret_type = parse_type();
     }
 
+    if (Global::lazy_func_bodies && !Global::panic_mode) {
+        LazyBody body = {};
+        if (skip_func_body(&body)) {
+            return decl_func_lazy(name, params.data(), params.size(), ret_type, body);
+        }
+    }
+
     StmtBlock block = parse_stmt_block();
     return decl_func(name, params.data(), params.size(), ret_type, block);
 
 }
 
+//*parses a lazily recorded function body on first request, the lexer state of the caller is preserved
+StmtBlock materialize_func_body(Decl* decl) {
+    assert(decl->kind == DeclKind::FUNC);
+    LazyBody* body = decl->func.lazy_body;
+    if (!body) {
+        return decl->func.block;
+    }
+
+    Token token = Global::token;
+    const char* stream = Global::stream;
+    const char* stream_start = Global::stream_start;
+    const char* stream_name = Global::stream_name;
+    bool panic_mode = Global::panic_mode;
+
+    Global::stream = body->start;
+    Global::stream_start = body->stream_start;
+    Global::stream_name = body->stream_name;
+    Global::panic_mode = false;
+    next_token();
+
+    decl->func.block = parse_stmt_block();
+    decl->func.lazy_body = nullptr;
+
+    Global::token = token;
+    Global::stream = stream;
+    Global::stream_start = stream_start;
+    Global::stream_name = stream_name;
+    Global::panic_mode = panic_mode;
+
+    return decl->func.block;
+}
+
 Decl* parse_decl_opt() {
     using namespace Keywords;
     if (match_keyword(enum_keyword)) {
@@ -625,11 +885,29 @@ Decl* parse_decl_opt() {
 Decl* parse_decl() {
     Decl* decl = parse_decl_opt();
     if (!decl) {
-        fatal_syntax_error("Expected declaration keyword, got %s", token_info());
+        parse_error("Expected declaration keyword, got %s", token_info());
+        return decl_error();
     }
     return decl;
 }
 
+std::vector<Decl*> parse_file(const char* name, const char* str) {
+    init_stream(str, name);
+    std::vector<Decl*> decls;
+
+    while (!is_token_eof()) {
+        const char* start = Global::token.start;
+        Decl* decl = parse_decl();
+        if (Global::panic_mode) {
+            sync_decl(start);
+            decl = decl_error();
+        }
+        decls.push_back(decl);
+    }
+
+    return decls;
+}
+
 void parse_and_print_decl(const char* str) {
     init_stream(str);
     Decl* decl = parse_decl();
@@ -637,7 +915,140 @@ void parse_and_print_decl(const char* str) {
     printf("\n\n");
 }
 
+Internal Expr* parse_expr_str(const char* str) {
+    init_stream(str);
+    Expr* expr = parse_expr();
+    assert(is_token_eof());
+    return expr;
+}
+
+Internal bool is_binary(Expr* expr, TokenKind op) {
+    return expr->kind == ExprKind::BINARY && expr->binary.op == op;
+}
+
+Internal void parse_expr_test() {
+    //*precedence climbing and the old descent chain build the same trees
+    for (int chain = 0; chain < 2; chain++) {
+        Global::parse_descent_chain = chain != 0;
+        //*mul binds tighter than add
+        Expr* e = parse_expr_str("1 + 2 * 3");
+        assert(is_binary(e, TokenKind::ADD));
+        assert(e->binary.left->kind == ExprKind::INT && is_binary(e->binary.right, TokenKind::MUL));
+
+        //*operators of one level are left associative
+        e = parse_expr_str("a - b - c");
+        assert(is_binary(e, TokenKind::SUB) && is_binary(e->binary.left, TokenKind::SUB));
+        assert(e->binary.right->kind == ExprKind::NAME);
+
+        //*cmp below add, && below cmp
+        e = parse_expr_str("a < b + c && d == e << f");
+        assert(is_binary(e, TokenKind::AND_AND));
+        assert(is_binary(e->binary.left, TokenKind::LT) && is_binary(e->binary.left->binary.right, TokenKind::ADD));
+        assert(is_binary(e->binary.right, TokenKind::EQ) && is_binary(e->binary.right->binary.right, TokenKind::LSHIFT));
+
+        //*unary binds tighter than any binary operator, ternary is the loosest
+        e = parse_expr_str("-a * b ? c : d & e");
+        assert(e->kind == ExprKind::TERNARY);
+        assert(is_binary(e->ternary.cond, TokenKind::MUL) && e->ternary.cond->binary.left->kind == ExprKind::UNARY);
+        assert(is_binary(e->ternary.else_expr, TokenKind::AND));
+
+        //*parens reset precedence
+        e = parse_expr_str("(a + b) * c");
+        assert(is_binary(e, TokenKind::MUL) && is_binary(e->binary.left, TokenKind::ADD));
+    }
+    Global::parse_descent_chain = false;
+
+    //*an operand costs one call instead of one per level
+    u64 calls[2];
+    for (int chain = 0; chain < 2; chain++) {
+        Global::parse_descent_chain = chain != 0;
+        Global::parse_binary_calls = 0;
+        parse_expr_str("a * b + c");
+        calls[chain] = Global::parse_binary_calls;
+    }
+    Global::parse_descent_chain = false;
+    assert(calls[0] == 3 && calls[1] == 6);
+}
+
+Internal void parse_error_test() {
+    const char* src =
+        "func f(x: int): int {\n"
+        "    y := x +; z := 2;\n"
+        "    if (x) { return 1 }\n"
+        "    return y;\n"
+        "}\n"
+        "var v: = 1\n"
+        "struct S { a: int; b int; c: float; }\n"
+        "const c = 42\n";
+
+    std::vector<Decl*> decls = parse_file("error_test.sorin", src);
+    assert(decls.size() == 4);
+
+    //*the function survives with its broken statements replaced by error nodes
+    StmtBlock block = decls[0]->func.block;
+    assert(decls[0]->kind == DeclKind::FUNC && block.num_stmts == 4);
+    assert(block.stmts[0]->kind == StmtKind::ERR);
+    assert(block.stmts[1]->kind == StmtKind::INIT);
+    assert(block.stmts[2]->kind == StmtKind::IF && block.stmts[2]->if_stmt.then_block.stmts[0]->kind == StmtKind::ERR);
+    assert(block.stmts[3]->kind == StmtKind::RETURN);
+    assert(decls[1]->kind == DeclKind::ERR);
+    assert(decls[2]->kind == DeclKind::STRUCT && decls[2]->aggregate.num_items == 3);
+    assert(decls[3]->kind == DeclKind::CONST);
+
+    assert(Global::diagnostics.size() == 4);
+    assert(Global::diagnostics[0].line == 2 && Global::diagnostics[0].col == 13);
+    assert(Global::diagnostics[1].line == 3);
+    assert(Global::diagnostics[2].line == 6);
+    assert(Global::diagnostics[3].line == 7);
+    assert(strcmp(Global::diagnostics[3].file, "error_test.sorin") == 0);
+
+    print_diagnostics();
+    clear_diagnostics();
+}
+
+Internal void parse_lazy_test() {
+    const char* src =
+        "func f(x: int): int { s := \"}{\"; c := '}'; if (x) { return 1; } return 0; }\n"
+        "struct S { a: int; }\n"
+        "func g() {\n"
+        "    f(1);\n"
+        "    f(2) f(3);\n"
+        "}\n"
+        "func h() { {} }\n";
+
+    Global::lazy_func_bodies = true;
+    std::vector<Decl*> decls = parse_file("lazy_test.sorin", src);
+    Global::lazy_func_bodies = false;
+
+    //*only signatures are parsed, body errors are not seen yet
+    assert(decls.size() == 4 && Global::diagnostics.empty());
+    assert(decls[0]->kind == DeclKind::FUNC && decls[0]->func.lazy_body && decls[0]->func.num_params == 1);
+    assert(decls[1]->kind == DeclKind::STRUCT);
+    assert(decls[2]->func.lazy_body && decls[3]->func.lazy_body);
+
+    StmtBlock f = materialize_func_body(decls[0]);
+    assert(!decls[0]->func.lazy_body && f.num_stmts == 4);
+    assert(f.stmts[0]->kind == StmtKind::INIT && f.stmts[0]->init.expr->kind == ExprKind::STR);
+    assert(f.stmts[2]->kind == StmtKind::IF && f.stmts[3]->kind == StmtKind::RETURN);
+    assert(materialize_func_body(decls[0]).stmts == f.stmts);
+
+    //*errors inside a body are reported when it is materialized, at their real location
+    StmtBlock g = materialize_func_body(decls[2]);
+    assert(g.num_stmts == 2 && g.stmts[1]->kind == StmtKind::ERR);
+    assert(Global::diagnostics.size() == 1 && Global::diagnostics[0].line == 5 && Global::diagnostics[0].col == 10);
+
+    StmtBlock h = materialize_func_body(decls[3]);
+    assert(h.num_stmts == 1 && h.stmts[0]->kind == StmtKind::BLOCK);
+
+    print_diagnostics();
+    clear_diagnostics();
+}
+
 void parse_test() {
+    parse_expr_test();
+    parse_error_test();
+    parse_lazy_test();
+
     const char* tests[] = {
         "const n = sizeof(:int*[16])",
         "const n = sizeof(1+2)",
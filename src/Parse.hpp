@@ -1,11 +1,16 @@
 #pragma once
 #include "Ast.hpp"
+#include <vector>
 
 Decl* parse_decl_opt();
 Decl* parse_decl();
 Typespec* parse_type();
 Stmt* parse_stmt();
 StmtBlock parse_stmt_block();
+StmtBlock materialize_func_body(Decl* decl);
 Expr* parse_expr();
 
+//*parses every declaration in str, syntax errors are collected in Global::diagnostics and the bad declarations come back as DeclKind::ERR nodes
+std::vector<Decl*> parse_file(const char* name, const char* str);
+
 void parse_test();
\ No newline at end of file
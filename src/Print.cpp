@@ -1,4 +1,5 @@
 #include "Print.hpp"
+#include "Parse.hpp"
 #include <cassert>
 
 GlobalVariable int indent;
@@ -11,6 +12,10 @@ Internal void print_newline() {
 void print_typespec(Typespec* type) {
     Typespec* t = type;
     switch (t->kind) {
+        case TypespecKind::ERR: {
+            printf("(error)");
+            break;
+        }
         case TypespecKind::NAME: {
             printf("%s", t->name);
             break;
@@ -52,6 +57,10 @@ void print_typespec(Typespec* type) {
 void print_expr(Expr* expr) {
     Expr* e = expr;
     switch (e->kind) {
+        case ExprKind::ERR: {
+            printf("(error)");
+            break;
+        }
         case ExprKind::INT: {
             printf("%llu", e->int_val);
             break;
@@ -177,6 +186,10 @@ void print_stmt_block(StmtBlock block) {
 void print_stmt(Stmt* stmt) {
     Stmt* s = stmt;
     switch (s->kind) {
+        case StmtKind::ERR: {
+            printf("(error)");
+            break;
+        }
         case StmtKind::DECL: {
             print_decl(s->decl);
             break;
@@ -327,6 +340,9 @@ void print_aggregate_decl(Decl* decl) {
 void print_decl(Decl* decl) {
     Decl* d = decl;
     switch (d->kind) {
+        case DeclKind::ERR:
+            printf("(error)");
+            break;
         case DeclKind::ENUM:
             printf("(enum %s", d->name);
             indent++;
@@ -396,7 +412,7 @@ void print_decl(Decl* decl) {
             }
             indent++;
             print_newline();
-            print_stmt_block(d->func.block);
+            print_stmt_block(materialize_func_body(d));
             indent--;
             printf(")");
             break;
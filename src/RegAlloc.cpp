@@ -0,0 +1,598 @@
+#include <algorithm>
+#include <cassert>
+#include <queue>
+#include "RegAlloc.hpp"
+#include "Loop.hpp"
+#include "Globals.hpp"
+#include "Parse.hpp"
+#include "Vm.hpp"
+
+//*uses in deeper loops than this weigh the same
+Internal constexpr u32 RA_MAX_DEPTH = 5;
+
+//*a part of an interval waiting for a register, in the order of its start
+struct RaWork {
+    u32 start;
+    u32 end;
+    IrValue value;
+    bool reload;
+};
+
+struct RaLater {
+    bool operator()(const RaWork& a, const RaWork& b) const {
+        return a.start > b.start || (a.start == b.start && a.value > b.value);
+    }
+};
+
+struct RaUse {
+    u32 pos;
+    u32 block;
+};
+
+GlobalVariable IrFunc* ra_ir;
+GlobalVariable RaFunc* ra_out;
+GlobalVariable const RaTarget* ra_target;
+GlobalVariable u32 ra_words; //*of a set of values
+GlobalVariable std::vector<u64> ra_live_in; //*ra_words per block
+GlobalVariable std::vector<u64> ra_live_out;
+GlobalVariable std::vector<u32> ra_block_starts;
+GlobalVariable std::vector<u32> ra_depths; //*loop depth of each block
+GlobalVariable std::vector<u32> ra_calls; //*positions, ascending
+GlobalVariable std::vector<u32> ra_use_first; //*of each value in ra_uses, which are ascending per value
+GlobalVariable std::vector<RaUse> ra_uses;
+GlobalVariable std::vector<u32> ra_ends; //*of each value's interval
+GlobalVariable std::vector<IrValue> ra_piece_values;
+GlobalVariable std::vector<u8> ra_removed; //*pieces that lost their register before their first position
+
+RaClass ra_class(Type* type) {
+    return is_floating_type(type) ? RaClass::FLOAT : RaClass::INT;
+}
+
+Internal bool ra_is_live(const std::vector<u64>& sets, u32 block, IrValue v) {
+    return (sets[block * ra_words + v / 64] >> (v % 64)) & 1;
+}
+
+Internal u64 ra_weight(u32 block) {
+    u64 weight = 1;
+    for (u32 i = 0; i < ra_depths[block] && i < RA_MAX_DEPTH; i++) {
+        weight *= 10;
+    }
+    return weight;
+}
+
+//*whether values get registers at all, phis of aggregates are written through the fixed addresses of their copies
+Internal bool ra_is_candidate(IrValue v) {
+    IrInst* inst = ra_ir->insts + v;
+    if (!ir_has_result(inst->op) || !inst->type || inst->lanes) {
+        return false;
+    }
+    Type* type = Global::types[inst->type];
+    return type->kind != TypeKind::VOID && !(inst->op == IrOp::PHI && (type->kind == TypeKind::STRUCT || type->kind == TypeKind::UNION));
+}
+
+//*whether block b starts inside the piece with the value live into it and is entered from outside the piece, where
+//*the register does not hold the value
+Internal bool ra_breaks_piece(IrValue v, u32 b, u32 start, u32 end) {
+    if (ra_block_starts[b] <= start || ra_block_starts[b] > end || !ra_is_live(ra_live_in, b, v)) {
+        return false;
+    }
+    IrBlock* block = ra_ir->blocks + b;
+    for (u32 i = 0; i < block->num_preds; i++) {
+        u32 pred_end = ra_out->block_ends[ra_ir->preds[block->first_pred + i]];
+        if (pred_end < start || pred_end > end) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//*a register may hold the value at start..end when no path reaches a use in there without passing start, where the
+//*definition or a reload writes it
+Internal bool ra_piece_ok(IrValue v, u32 start, u32 end) {
+    for (u32 b = 0; b < ra_ir->num_blocks; b++) {
+        if (ra_breaks_piece(v, b, start, end)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//*the last position before limit a piece from start may keep its register to, false when it cannot keep it at all.
+//*a piece ends before every block that would break it
+Internal bool ra_split_end(IrValue v, u32 start, u32 limit, u32* end) {
+    u32 last = limit - 1;
+    while (last >= start) {
+        u32 cut = last + 1;
+        for (u32 b = 0; b < ra_ir->num_blocks; b++) {
+            if (ra_block_starts[b] < cut && ra_breaks_piece(v, b, start, last)) {
+                cut = ra_block_starts[b];
+            }
+        }
+        if (cut == last + 1) {
+            *end = last;
+            return true;
+        }
+        //*cut is past start, so this stays in range
+        last = cut - 1;
+    }
+    return false;
+}
+
+Internal u64 ra_cost(IrValue v, u32 from, u32 to) {
+    u64 cost = 0;
+    for (u32 i = ra_use_first[v]; i < ra_use_first[v + 1]; i++) {
+        if (ra_uses[i].pos >= from && ra_uses[i].pos <= to) {
+            cost += ra_weight(ra_uses[i].block);
+        }
+    }
+    return cost;
+}
+
+//*where the value may take a register again after losing it at pos: before its next use or at a block boundary
+//*in between, the shallowest in loops and the latest of those. false when its uses after pos all read the slot
+Internal bool ra_find_reload(IrValue v, u32 pos, u32* reload) {
+    const RaUse* next = nullptr;
+    for (u32 i = ra_use_first[v]; i < ra_use_first[v + 1]; i++) {
+        if (ra_uses[i].pos > pos) {
+            next = &ra_uses[i];
+            break;
+        }
+    }
+    if (!next) {
+        return false;
+    }
+    u32 end = ra_ends[v];
+    bool found = false;
+    u32 best_depth = 0;
+    if (ra_piece_ok(v, next->pos, end)) {
+        found = true;
+        *reload = next->pos;
+        best_depth = ra_depths[next->block];
+    }
+    for (u32 b = ra_ir->num_blocks; b-- > 0;) {
+        u32 candidates[2] = { ra_out->block_ends[b], ra_block_starts[b] };
+        for (u32 it : candidates) {
+            if (it <= pos || it > next->pos || (found && (ra_depths[b] > best_depth || (ra_depths[b] == best_depth && it <= *reload)))) {
+                continue;
+            }
+            if (ra_piece_ok(v, it, end)) {
+                found = true;
+                *reload = it;
+                best_depth = ra_depths[b];
+            }
+        }
+    }
+    return found;
+}
+
+Internal void ra_compute_liveness() {
+    u32 num_blocks = ra_ir->num_blocks;
+    ra_words = (ra_ir->num_insts + 63) / 64;
+    std::vector<u64> gen(num_blocks * ra_words, 0);
+    std::vector<u64> kill(num_blocks * ra_words, 0);
+    std::vector<u64> phi_out(num_blocks * ra_words, 0);
+    std::vector<u32> def_block;
+    ir_def_blocks(ra_ir, &def_block);
+    for (u32 b = 0; b < num_blocks; b++) {
+        IrBlock* block = ra_ir->blocks + b;
+        for (IrValue v = block->first; v < block->first + block->num_insts; v++) {
+            IrInst* inst = ra_ir->insts + v;
+            kill[b * ra_words + v / 64] |= 1ull << (v % 64);
+            if (inst->op == IrOp::PHI) {
+                for (u32 i = 0; i < block->num_preds; i++) {
+                    IrValue operand = ra_ir->operands[inst->operands.first + i];
+                    u32 pred = ra_ir->preds[block->first_pred + i];
+                    if (operand) {
+                        phi_out[pred * ra_words + operand / 64] |= 1ull << (operand % 64);
+                    }
+                }
+                continue;
+            }
+            for (u32 i = 0; i < 2 + ir_num_list(inst); i++) {
+                IrValue use = ir_use(ra_ir, inst, i);
+                if (use && def_block[use] != b) {
+                    gen[b * ra_words + use / 64] |= 1ull << (use % 64);
+                }
+            }
+        }
+    }
+
+    ra_live_in.assign(num_blocks * ra_words, 0);
+    ra_live_out.assign(num_blocks * ra_words, 0);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (u32 b = num_blocks; b-- > 0;) {
+            for (u32 w = 0; w < ra_words; w++) {
+                u64 out = phi_out[b * ra_words + w];
+                for (u32 i = 0; i < ir_num_succs(ra_ir, b); i++) {
+                    out |= ra_live_in[ir_succ(ra_ir, b, i) * ra_words + w];
+                }
+                u64 in = gen[b * ra_words + w] | (out & ~kill[b * ra_words + w]);
+                changed = changed || out != ra_live_out[b * ra_words + w] || in != ra_live_in[b * ra_words + w];
+                ra_live_out[b * ra_words + w] = out;
+                ra_live_in[b * ra_words + w] = in;
+            }
+        }
+    }
+}
+
+Internal bool ra_use_before(const RaUse& a, const RaUse& b) {
+    return a.pos < b.pos;
+}
+
+Internal void ra_collect_uses() {
+    u32 num_insts = ra_ir->num_insts;
+    std::vector<std::vector<RaUse>> uses(num_insts);
+    for (u32 b = 0; b < ra_ir->num_blocks; b++) {
+        IrBlock* block = ra_ir->blocks + b;
+        for (IrValue v = block->first; v < block->first + block->num_insts; v++) {
+            IrInst* inst = ra_ir->insts + v;
+            if (inst->op == IrOp::PHI) {
+                for (u32 i = 0; i < block->num_preds; i++) {
+                    IrValue operand = ra_ir->operands[inst->operands.first + i];
+                    u32 pred = ra_ir->preds[block->first_pred + i];
+                    uses[operand].push_back({ ra_out->block_ends[pred], pred });
+                }
+                continue;
+            }
+            for (u32 i = 0; i < 2 + ir_num_list(inst); i++) {
+                uses[ir_use(ra_ir, inst, i)].push_back({ ra_out->positions[v], b });
+            }
+        }
+    }
+    ra_use_first.assign(num_insts + 1, 0);
+    ra_uses.clear();
+    for (IrValue v = 0; v < num_insts; v++) {
+        ra_use_first[v] = (u32)ra_uses.size();
+        if (v == IR_NONE) {
+            continue;
+        }
+        //*a value used twice at one position is read once there
+        std::vector<RaUse>& it = uses[v];
+        std::sort(it.begin(), it.end(), ra_use_before);
+        for (size_t i = 0; i < it.size(); i++) {
+            if (i == 0 || it[i].pos != it[i - 1].pos) {
+                ra_uses.push_back(it[i]);
+            }
+        }
+    }
+    ra_use_first[num_insts] = (u32)ra_uses.size();
+}
+
+Internal void ra_number(IrFunc* func) {
+    ra_out->positions.assign(func->num_insts, 0);
+    ra_out->block_ends.assign(func->num_blocks, 0);
+    ra_block_starts.assign(func->num_blocks, 0);
+    ra_calls.clear();
+    u32 pos = 0;
+    for (u32 b = 0; b < func->num_blocks; b++) {
+        IrBlock* block = func->blocks + b;
+        ra_block_starts[b] = pos;
+        for (IrValue v = block->first; v < block->first + block->num_insts; v++) {
+            ra_out->positions[v] = pos;
+            if (func->insts[v].op == IrOp::CALL) {
+                ra_calls.push_back(pos);
+            }
+            pos += 2;
+        }
+        ra_out->block_ends[b] = pos - 2;
+    }
+}
+
+Internal bool ra_crosses_call(u32 start, u32 end) {
+    auto it = std::lower_bound(ra_calls.begin(), ra_calls.end(), start);
+    return it != ra_calls.end() && *it <= end;
+}
+
+Internal void ra_give(const RaWork& work, RaClass cls, u32 reg, std::vector<u32>* active, std::vector<u32>* occupants) {
+    u32 piece = (u32)ra_out->pieces.size();
+    ra_out->pieces.push_back({ work.start, work.end, ra_target->regs[(int)cls][reg].num, work.reload });
+    ra_piece_values.push_back(work.value);
+    ra_removed.push_back(0);
+    active->push_back(piece);
+    (*occupants)[reg] = piece;
+}
+
+Internal u32 ra_reg_index(RaClass cls, u8 num) {
+    u32 i = 0;
+    while (ra_target->regs[(int)cls][i].num != num) {
+        i++;
+    }
+    return i;
+}
+
+struct RaPieceBefore {
+    bool operator()(u32 a, u32 b) const {
+        IrValue va = ra_piece_values[a];
+        IrValue vb = ra_piece_values[b];
+        return va < vb || (va == vb && ra_out->pieces[a].start < ra_out->pieces[b].start);
+    }
+};
+
+Internal bool ra_reload_before(const RaReload& a, const RaReload& b) {
+    return a.pos < b.pos;
+}
+
+//*orders the pieces by value and lists the reloads and saved registers they need
+Internal void ra_finish(const std::vector<u8>& lost) {
+    std::vector<u32> order;
+    for (u32 i = 0; i < ra_out->pieces.size(); i++) {
+        if (!ra_removed[i]) {
+            order.push_back(i);
+        }
+    }
+    std::sort(order.begin(), order.end(), RaPieceBefore());
+    std::vector<RaPiece> pieces;
+    for (u32 i : order) {
+        IrValue v = ra_piece_values[i];
+        RaPiece piece = ra_out->pieces[i];
+        if (!ra_out->num_pieces[v]) {
+            ra_out->first_piece[v] = (u32)pieces.size();
+        }
+        ra_out->num_pieces[v]++;
+        pieces.push_back(piece);
+        if (piece.reload) {
+            ra_out->reloads.push_back({ piece.start, v, piece.reg });
+        }
+        RaClass cls = ra_class(Global::types[ra_ir->insts[v].type]);
+        const RaReg* reg = ra_target->regs[(int)cls] + ra_reg_index(cls, piece.reg);
+        std::vector<u8>* saved = &ra_out->saved[(int)cls];
+        if (reg->callee_saved && std::find(saved->begin(), saved->end(), reg->num) == saved->end()) {
+            saved->push_back(reg->num);
+        }
+    }
+    ra_out->pieces = pieces;
+    std::sort(ra_out->reloads.begin(), ra_out->reloads.end(), ra_reload_before);
+    for (IrValue v = 1; v < ra_ir->num_insts; v++) {
+        if (lost[v]) {
+            ra_out->in_slot[v] = 1;
+            ra_out->num_split += ra_out->num_pieces[v] != 0;
+            ra_out->num_spilled += ra_out->num_pieces[v] == 0;
+        }
+    }
+}
+
+void ra_allocate(IrFunc* func, const RaTarget* target, RaFunc* ra) {
+    ra_ir = func;
+    ra_out = ra;
+    ra_target = target;
+    u32 num_insts = func->num_insts;
+    ra_number(func);
+    ra->first_piece.assign(num_insts, 0);
+    ra->num_pieces.assign(num_insts, 0);
+    ra->pieces.clear();
+    ra->in_slot.assign(num_insts, 1);
+    ra->reloads.clear();
+    for (std::vector<u8>& it : ra->saved) {
+        it.clear();
+    }
+    ra->num_values = 0;
+    ra->num_split = 0;
+    ra->num_spilled = 0;
+    if (!Global::native_regalloc) {
+        return;
+    }
+
+    ra_compute_liveness();
+    ra_collect_uses();
+    std::vector<IrLoop> loops;
+    ir_find_loops(func, &loops);
+    ra_depths.assign(func->num_blocks, 0);
+    for (IrLoop& loop : loops) {
+        for (u32 b : loop.blocks) {
+            ra_depths[b]++;
+        }
+    }
+
+    //*an interval spans the definition, the uses and every block boundary the value is live across
+    std::priority_queue<RaWork, std::vector<RaWork>, RaLater> work;
+    ra_ends.assign(num_insts, 0);
+    for (u32 b = 0; b < func->num_blocks; b++) {
+        IrBlock* block = func->blocks + b;
+        for (IrValue v = block->first; v < block->first + block->num_insts; v++) {
+            if (!ra_is_candidate(v) || ra_use_first[v] == ra_use_first[v + 1]) {
+                continue;
+            }
+            u32 start = func->insts[v].op == IrOp::PHI ? ra_block_starts[b] : ra->positions[v] + 1;
+            u32 end = ra_uses[ra_use_first[v + 1] - 1].pos;
+            for (u32 c = 0; c < func->num_blocks; c++) {
+                if (ra_is_live(ra_live_in, c, v)) {
+                    start = std::min(start, ra_block_starts[c]);
+                    end = std::max(end, ra_block_starts[c]);
+                }
+                if (ra_is_live(ra_live_out, c, v)) {
+                    end = std::max(end, ra->block_ends[c]);
+                }
+            }
+            ra_ends[v] = end;
+            ra->in_slot[v] = 0;
+            ra->num_values++;
+            work.push({ start, end, v, false });
+        }
+    }
+
+    ra_piece_values.clear();
+    ra_removed.clear();
+    std::vector<u8> lost(num_insts, 0);
+    std::vector<u32> active[(int)RaClass::SIZE_OF_ENUM];
+    std::vector<u32> occupants[(int)RaClass::SIZE_OF_ENUM];
+    for (int c = 0; c < (int)RaClass::SIZE_OF_ENUM; c++) {
+        occupants[c].assign(target->num_regs[c], UINT32_MAX);
+    }
+    while (!work.empty()) {
+        RaWork cur = work.top();
+        work.pop();
+        RaClass cls = ra_class(Global::types[func->insts[cur.value].type]);
+        const RaReg* regs = target->regs[(int)cls];
+        u32 num_regs = target->num_regs[(int)cls];
+        std::vector<u32>* cls_active = &active[(int)cls];
+        std::vector<u32>* cls_occupants = &occupants[(int)cls];
+        for (size_t i = 0; i < cls_active->size();) {
+            RaPiece* piece = &ra->pieces[(*cls_active)[i]];
+            if (piece->end < cur.start) {
+                (*cls_occupants)[ra_reg_index(cls, piece->reg)] = UINT32_MAX;
+                (*cls_active)[i] = cls_active->back();
+                cls_active->pop_back();
+            }
+            else {
+                i++;
+            }
+        }
+
+        //*a free register, one the calls clobber when the value is live across none
+        bool crosses = ra_crosses_call(cur.start, cur.end);
+        u32 choice = UINT32_MAX;
+        for (u32 r = 0; r < num_regs; r++) {
+            if ((*cls_occupants)[r] != UINT32_MAX || (crosses && !regs[r].callee_saved)) {
+                continue;
+            }
+            if (choice == UINT32_MAX || (regs[choice].callee_saved && !regs[r].callee_saved)) {
+                choice = r;
+            }
+        }
+        if (choice != UINT32_MAX) {
+            ra_give(cur, cls, choice, cls_active, cls_occupants);
+            continue;
+        }
+
+        //*else the piece with the cheapest uses left gives up its register
+        u64 cur_cost = ra_cost(cur.value, cur.start, cur.end);
+        u32 victim = UINT32_MAX;
+        u64 victim_cost = UINT64_MAX;
+        for (u32 piece : *cls_active) {
+            if (crosses && !regs[ra_reg_index(cls, ra->pieces[piece].reg)].callee_saved) {
+                continue;
+            }
+            u64 cost = ra_cost(ra_piece_values[piece], cur.start, ra->pieces[piece].end);
+            if (cost < victim_cost) {
+                victim = piece;
+                victim_cost = cost;
+            }
+        }
+        u32 reload = 0;
+        if (victim == UINT32_MAX || victim_cost >= cur_cost) {
+            lost[cur.value] = 1;
+            if (ra_find_reload(cur.value, cur.start, &reload)) {
+                work.push({ reload, cur.end, cur.value, true });
+            }
+            continue;
+        }
+        IrValue split = ra_piece_values[victim];
+        u32 reg = ra_reg_index(cls, ra->pieces[victim].reg);
+        u32 end = 0;
+        if (ra_split_end(split, ra->pieces[victim].start, cur.start, &end)) {
+            ra->pieces[victim].end = end;
+        }
+        else {
+            ra_removed[victim] = 1;
+        }
+        lost[split] = 1;
+        cls_active->erase(std::find(cls_active->begin(), cls_active->end(), victim));
+        if (ra_find_reload(split, cur.start, &reload)) {
+            work.push({ reload, ra_ends[split], split, true });
+        }
+        ra_give(cur, cls, reg, cls_active, cls_occupants);
+    }
+    ra_finish(lost);
+}
+
+i32 ra_reg_at(const RaFunc* ra, IrValue v, u32 pos) {
+    for (u32 i = ra->first_piece[v]; i < ra->first_piece[v] + ra->num_pieces[v]; i++) {
+        if (ra->pieces[i].start <= pos && pos <= ra->pieces[i].end) {
+            return ra->pieces[i].reg;
+        }
+    }
+    return -1;
+}
+
+i32 ra_def_reg(const RaFunc* ra, IrValue v) {
+    if (!ra->num_pieces[v] || ra->pieces[ra->first_piece[v]].reload) {
+        return -1;
+    }
+    return ra->pieces[ra->first_piece[v]].reg;
+}
+
+//*no two values share a register at a position, values live across a call keep theirs and every reload has its piece
+Internal void ra_test_check(IrFunc* func, const RaFunc* ra, const RaTarget* target) {
+    for (IrValue v = 1; v < func->num_insts; v++) {
+        if (!ra->num_pieces[v]) {
+            continue;
+        }
+        RaClass cls = ra_class(Global::types[func->insts[v].type]);
+        for (u32 i = ra->first_piece[v]; i < ra->first_piece[v] + ra->num_pieces[v]; i++) {
+            const RaPiece* piece = &ra->pieces[i];
+            assert(piece->start <= piece->end && (i == ra->first_piece[v] || ra->pieces[i - 1].end < piece->start));
+            assert(!piece->reload || ra_piece_ok(v, piece->start, piece->end));
+            if (ra_crosses_call(piece->start, piece->end)) {
+                assert(target->regs[(int)cls][ra_reg_index(cls, piece->reg)].callee_saved);
+            }
+            for (IrValue w = v + 1; w < func->num_insts; w++) {
+                if (!ra->num_pieces[w] || ra_class(Global::types[func->insts[w].type]) != cls) {
+                    continue;
+                }
+                for (u32 k = ra->first_piece[w]; k < ra->first_piece[w] + ra->num_pieces[w]; k++) {
+                    const RaPiece* other = &ra->pieces[k];
+                    assert(other->reg != piece->reg || other->end < piece->start || piece->end < other->start);
+                }
+            }
+        }
+    }
+    for (const RaReload& it : ra->reloads) {
+        assert(ra_reg_at(ra, it.value, it.pos) == it.reg);
+    }
+}
+
+void ra_test() {
+    const char* src =
+        "func helper(x: int): int { return x + 1; }\n"
+        "func nested(n: int): int { s := 0; for (i := 0; i < n; i++) { for (j := 0; j < n; j++) { s += i * j + helper(j); } }\n"
+        "    return s; }\n"
+        "func pressure(a: int, b: int, c: int, d: int): int { s := 0; for (i := 0; i < a; i++) { s += b * i + c * d; }\n"
+        "    return s + a + b + c + d + helper(s) + a * b; }\n"
+        "func poly(a: double, b: double, n: int): double { t := 0.0; for (i := 0; i < n; i++) { t += a * i + b; } return t; }\n";
+
+    assert(load_package_src("ra_test.sorin", src));
+
+    const RaReg int_regs[] = { { 1, true }, { 2, true }, { 3, true }, { 4, true }, { 5, true }, { 6, true }, { 7, true }, { 8, true },
+                               { 9, true }, { 10, true }, { 11, true }, { 12, true }, { 13, false }, { 14, false } };
+    const RaReg float_regs[] = { { 1, false }, { 2, false }, { 3, false }, { 4, false }, { 5, false }, { 6, false } };
+    RaTarget wide = { "wide", { int_regs, float_regs }, { 14, 6 } };
+    //*one register a call keeps and one it clobbers, and none for floats
+    const RaReg narrow_regs[] = { { 1, true }, { 4, false } };
+    RaTarget narrow = { "narrow", { narrow_regs, nullptr }, { 2, 0 } };
+
+    const char* names[] = { "nested", "pressure", "poly" };
+    u32 split = 0;
+    for (const char* name : names) {
+        IrFunc* func = vm_lower_func(sym_get(Global::string_table.add(name)));
+        RaFunc ra;
+        ra_allocate(func, &wide, &ra);
+        ra_test_check(func, &ra, &wide);
+        assert(ra.num_values && ra.num_split == 0 && ra.num_spilled == 0);
+        ra_allocate(func, &narrow, &ra);
+        ra_test_check(func, &ra, &narrow);
+        split += ra.num_split + ra.num_spilled;
+
+        //*the loop counter of the innermost loop is in a register where the loop reads it
+        std::vector<IrLoop> loops;
+        ir_find_loops(func, &loops);
+        const IrLoop* inner = &loops[0];
+        IrBlock* header = func->blocks + inner->header;
+        IrValue counter = header->first;
+        while (func->insts[counter].op == IrOp::PHI && ra_class(Global::types[func->insts[counter].type]) != RaClass::INT) {
+            counter++;
+        }
+        assert(func->insts[counter].op == IrOp::PHI);
+        if (ra_use_first[counter] != ra_use_first[counter + 1]) {
+            u32 pos = ra_uses[ra_use_first[counter]].pos;
+            assert(ra_reg_at(&ra, counter, pos) >= 0);
+        }
+
+        Global::native_regalloc = false;
+        ra_allocate(func, &wide, &ra);
+        assert(ra.pieces.empty() && ra.reloads.empty());
+        Global::native_regalloc = true;
+    }
+    assert(split > 0);
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <vector>
+#include "Ir.hpp"
+
+//*linear-scan register allocation for the native backends. every value keeps the stack slot the backends give it,
+//*and the allocator hands registers to parts of its live interval: the interval runs from the definition to the
+//*last position the value is live at in block order, holes included. when a class runs out of registers the part
+//*with the cheapest uses left loses its register, weighted by the loop depth of each use, and the value is split:
+//*it stays in the register up to the split, reads its slot after it, and may take a register again later with a
+//*reload placed at the shallowest loop depth before its next use. a value with any part out of a register is also
+//*written to its slot where it is defined, so the slot is always current wherever a register part ends
+
+enum class RaClass : u8 {
+    INT, //*integers, pointers, func values and the addresses of aggregates
+    FLOAT, //*floats and doubles
+    SIZE_OF_ENUM,
+};
+
+//*a register the allocator may hand out, by its number in the target's encoding
+struct RaReg {
+    u8 num;
+    bool callee_saved; //*kept across calls, a func that uses it saves it in its prologue
+};
+
+//*the registers of a target the allocator hands out. the backend keeps the others for the scratch values of its
+//*instructions, argument passing and the frame. a value live across a call only gets a callee saved register
+struct RaTarget {
+    const char* name;
+    const RaReg* regs[(int)RaClass::SIZE_OF_ENUM];
+    u32 num_regs[(int)RaClass::SIZE_OF_ENUM];
+};
+
+//*a part of a value's interval that is in a register, at positions start..end
+struct RaPiece {
+    u32 start;
+    u32 end;
+    u8 reg;
+    bool reload; //*the register is loaded from the slot before the instruction at start, else start is the definition
+};
+
+struct RaReload {
+    u32 pos;
+    IrValue value;
+    u8 reg;
+};
+
+//*where the values of one func live. an instruction at position p reads its operands at p and defines its value at
+//*p + 1, a phi is defined at the position of the first instruction of its block and the moves into the phis of a
+//*successor read their operands at the position of the pred's terminator
+struct RaFunc {
+    std::vector<u32> positions; //*of each instruction, 2 apart in block order
+    std::vector<u32> block_ends; //*position of each block's terminator
+    std::vector<u32> first_piece; //*of each value, pieces of one value are ascending and disjoint
+    std::vector<u32> num_pieces;
+    std::vector<RaPiece> pieces;
+    std::vector<u8> in_slot; //*whether some use reads the slot, so the definition also writes it
+    std::vector<RaReload> reloads; //*ascending by position
+    std::vector<u8> saved[(int)RaClass::SIZE_OF_ENUM]; //*the callee saved registers the func uses, by number
+    u32 num_values; //*that have uses
+    u32 num_split; //*in a register for only part of their interval
+    u32 num_spilled; //*never in a register
+};
+
+RaClass ra_class(Type* type);
+
+//*allocates registers for every value of func with the registers of target, or none at all when
+//*Global::native_regalloc is off
+void ra_allocate(IrFunc* func, const RaTarget* target, RaFunc* ra);
+
+//*the register that holds v at pos, -1 when the value is read from its slot there
+i32 ra_reg_at(const RaFunc* ra, IrValue v, u32 pos);
+
+//*the register the definition of v writes, -1 when it only writes the slot
+i32 ra_def_reg(const RaFunc* ra, IrValue v);
+
+void ra_test();
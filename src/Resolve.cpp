@@ -1,49 +1,1569 @@
 #include <cassert>
+#include <algorithm>
+#include <string>
+#include <climits>
+#include <cstdio>
 #include "Resolve.hpp"
 #include "Globals.hpp"
 #include "StringIntern.hpp"
+#include "Parse.hpp"
+#include "AstCache.hpp"
+#include "Ctfe.hpp"
 
+//*host pointers, the C backend targets the machine the compiler runs on
+GlobalVariable constexpr size_t PTR_SIZE = sizeof(void*);
+
+GlobalVariable const char* scalar_type_names[(int)TypeKind::LAST_ARITHMETIC + 1] = {
+    nullptr, nullptr, nullptr, "void",
+    "bool", "char", "schar", "uchar", "short", "ushort", "int", "uint", "long", "ulong", "llong", "ullong", "float", "double",
+};
+
+//*conversion rules of the arithmetic types as tables indexed by TypeKind, which is also the id of each scalar type
+struct ArithmeticTable {
+    u8 rank[(int)TypeKind::LAST_ARITHMETIC + 1];
+    bool is_signed[(int)TypeKind::LAST_ARITHMETIC + 1];
+    u8 size[(int)TypeKind::LAST_ARITHMETIC + 1];
+    u8 promote[(int)TypeKind::LAST_ARITHMETIC + 1];
+    u8 unify[(int)TypeKind::LAST_ARITHMETIC + 1][(int)TypeKind::LAST_ARITHMETIC + 1];
+};
+
+//*C's usual arithmetic conversions for two promoted operand kinds
+Internal constexpr int unify_kinds(const ArithmeticTable& table, int left, int right) {
+    if (left == (int)TypeKind::DOUBLE || right == (int)TypeKind::DOUBLE) {
+        return (int)TypeKind::DOUBLE;
+    }
+    if (left == (int)TypeKind::FLOAT || right == (int)TypeKind::FLOAT) {
+        return (int)TypeKind::FLOAT;
+    }
+    if (left == right) {
+        return left;
+    }
+    if (table.is_signed[left] == table.is_signed[right]) {
+        return table.rank[left] > table.rank[right] ? left : right;
+    }
+
+    int unsigned_kind = table.is_signed[left] ? right : left;
+    int signed_kind = table.is_signed[left] ? left : right;
+    if (table.rank[unsigned_kind] >= table.rank[signed_kind]) {
+        return unsigned_kind;
+    }
+    if (table.size[signed_kind] > table.size[unsigned_kind]) {
+        return signed_kind;
+    }
+
+    return signed_kind + 1;
+}
+
+Internal constexpr ArithmeticTable make_arithmetic_table() {
+    ArithmeticTable table = {};
+    const int first = (int)TypeKind::FIRST_ARITHMETIC;
+    const int last = (int)TypeKind::LAST_ARITHMETIC;
+    const u8 ranks[] = { 1, 2, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 8 };
+    const bool is_signed[] = { false, true, true, false, true, false, true, false, true, false, true, false, true, true };
+    const u8 sizes[] = { 1, 1, 1, 1, sizeof(short), sizeof(short), sizeof(int), sizeof(int),
+        sizeof(long), sizeof(long), sizeof(long long), sizeof(long long), sizeof(float), sizeof(double) };
+    for (int kind = first; kind <= last; kind++) {
+        table.rank[kind] = ranks[kind - first];
+        table.is_signed[kind] = is_signed[kind - first];
+        table.size[kind] = sizes[kind - first];
+    }
+
+    //*everything ranked below int fits in an int
+    for (int kind = first; kind <= last; kind++) {
+        table.promote[kind] = (u8)(table.rank[kind] < table.rank[(int)TypeKind::INT] ? (int)TypeKind::INT : kind);
+    }
+    for (int left = first; left <= last; left++) {
+        for (int right = first; right <= last; right++) {
+            table.unify[left][right] = (u8)unify_kinds(table, table.promote[left], table.promote[right]);
+        }
+    }
+
+    return table;
+}
+
+GlobalVariable constexpr ArithmeticTable arithmetic = make_arithmetic_table();
+
+Internal Sym* sym_new(SymKind kind, const char* name, Decl* decl) {
+    Sym* sym = (Sym*)xcalloc(1, sizeof(Sym));
+    sym->kind = kind;
+    sym->name = name;
+    sym->decl = decl;
+    return sym;
+}
+
+//*a local is live while its slot below the watermark still holds it, popped locals are dropped from the binding
+//*chains lazily on the next lookup of their name
+Internal bool is_live_local(Sym* sym) {
+    return sym->local_index < Global::local_syms.size() && Global::local_syms[sym->local_index] == sym;
+}
+
+Internal Sym* live_local(SymBinding* binding) {
+    Sym* sym = binding->local;
+    while (sym && !is_live_local(sym)) {
+        sym = sym->shadowed;
+    }
+
+    binding->local = sym;
+    return sym;
+}
+
+//*locals shadow globals, the innermost local wins
 Sym* sym_get(const char* name) {
-    for (Sym& it : Global::syms) {
-        if (it.name == name) {
-            return &it;
+    auto it = Global::sym_bindings.find(name);
+    if (it == Global::sym_bindings.end()) {
+        return nullptr;
+    }
+
+    Sym* local = live_local(&it->second);
+    return local ? local : it->second.global;
+}
+
+//*a scope is just the local stack height at entry, leaving it pops every local declared since in one resize
+Internal size_t sym_enter() {
+    return Global::local_syms.size();
+}
+
+Internal void sym_leave(size_t scope) {
+    Global::local_syms.resize(scope);
+    if (Global::local_type_floor >= scope) {
+        Global::local_type_floor = SIZE_MAX;
+    }
+}
+
+Internal void sym_push_local(Sym* sym) {
+    SymBinding* binding = &Global::sym_bindings[sym->name];
+    bool hides_type = binding->global && binding->global->kind == SymKind::TYPE;
+    if ((sym->kind == SymKind::TYPE || hides_type) && Global::local_type_floor == SIZE_MAX) {
+        Global::local_type_floor = Global::local_syms.size();
+    }
+
+    sym->shadowed = live_local(binding);
+    sym->local_index = (u32)Global::local_syms.size();
+    Global::local_syms.push_back(sym);
+    binding->local = sym;
+}
+
+Internal void sym_put_global(Sym* sym) {
+    SymBinding* binding = &Global::sym_bindings[sym->name];
+    if (binding->global) {
+        fatal("Duplicate definition of %s", sym->name);
+    }
+
+    binding->global = sym;
+    Global::syms.push_back(sym);
+}
+
+Internal Sym* sym_push_var(const char* name, Type* type) {
+    Sym* sym = sym_new(SymKind::VAR, name, nullptr);
+    sym->state = SymState::RESOLVED;
+    sym->type = type;
+    sym_push_local(sym);
+    return sym;
+}
+
+Internal Sym* sym_decl(Decl* decl) {
+    SymKind kind = SymKind::NONE;
+    switch (decl->kind) {
+        case DeclKind::STRUCT:
+        case DeclKind::UNION:
+        case DeclKind::TYPEDEF:
+        case DeclKind::ENUM: {
+            kind = SymKind::TYPE;
+            break;
+        }
+        case DeclKind::VAR: {
+            kind = SymKind::VAR;
+            break;
+        }
+        case DeclKind::CONST: {
+            kind = SymKind::CONST;
+            break;
+        }
+        case DeclKind::FUNC: {
+            kind = SymKind::FUNC;
+            break;
+        }
+        default: {
+            assert(0);
+            break;
+        }
+    }
+
+    Sym* sym = sym_new(kind, decl->name, decl);
+    if (decl->kind == DeclKind::STRUCT || decl->kind == DeclKind::UNION) {
+        //*aggregates exist as incomplete types up front so they can point at each other
+        sym->state = SymState::RESOLVED;
+        sym->type = type_incomplete(sym);
+    }
+
+    return sym;
+}
+
+//*enum items are entered next to their enum, in the same scope. they are allocated as one array so an item
+//*without an initializer finds the item it counts on from at sym - 1
+Internal void sym_put_enum_items(Decl* decl, void (*put)(Sym*)) {
+    if (decl->enum_decl.num_items == 0) {
+        return;
+    }
+
+    Sym* items = (Sym*)xcalloc(decl->enum_decl.num_items, sizeof(Sym));
+    for (size_t i = 0; i < decl->enum_decl.num_items; i++) {
+        Sym* sym = items + i;
+        sym->kind = SymKind::ENUM_CONST;
+        sym->name = decl->enum_decl.items[i].name;
+        sym->decl = decl;
+        sym->enum_item = decl->enum_decl.items + i;
+        put(sym);
+    }
+}
+
+void sym_put(Decl* decl) {
+    assert(decl->name);
+    sym_put_global(sym_decl(decl));
+    if (decl->kind == DeclKind::ENUM) {
+        sym_put_enum_items(decl, sym_put_global);
+    }
+}
+
+void sym_put_type(const char* name, Type* type) {
+    Sym* sym = sym_new(SymKind::TYPE, Global::string_table.add(name), nullptr);
+    sym->state = SymState::RESOLVED;
+    sym->type = type;
+    sym_put_global(sym);
+}
+
+void reset_syms() {
+    Global::syms.clear();
+    Global::ordered_syms.clear();
+    Global::local_syms.clear();
+    Global::case_vals.clear();
+    Global::local_decl_syms.clear();
+    Global::sym_bindings.clear();
+    Global::in_const_expr = false;
+    Global::const_call_vals.clear();
+    Global::body_states.clear();
+    ctfe_reset();
+    Global::local_type_floor = SIZE_MAX;
+    //*the memoized types belong to the dropped symbols
+    std::fill(Global::typespec_types.begin(), Global::typespec_types.end(), 0);
+    Global::typespec_spellings.clear();
+    for (int kind = (int)TypeKind::VOID; kind <= (int)TypeKind::LAST_ARITHMETIC; kind++) {
+        sym_put_type(scalar_type_names[kind], Global::types[kind]);
+    }
+
+    //*fixed width names for the scalars of that width on every host
+    sym_put_type("int8", Global::type_schar);
+    sym_put_type("uint8", Global::type_uchar);
+    sym_put_type("int16", Global::type_short);
+    sym_put_type("uint16", Global::type_ushort);
+    sym_put_type("int32", Global::type_int);
+    sym_put_type("uint32", Global::type_uint);
+    sym_put_type("int64", Global::type_llong);
+    sym_put_type("uint64", Global::type_ullong);
+    sym_put_type("float32", Global::type_float);
+    sym_put_type("float64", Global::type_double);
+}
+
+Type* type_alloc(TypeKind kind) {
+    Type* t = (Type*)xcalloc(1, sizeof(Type));
+    t->kind = kind;
+    t->id = (u32)Global::types.size();
+    Global::types.push_back(t);
+    return t;
+}
+
+Internal u64 type_key_mix(u64 key, u64 val) {
+    return (key ^ val) * 0x100000001b3ull;
+}
+
+Type* type_ptr(Type* base) {
+    auto it = Global::cached_ptr_types.find(base->id);
+    if (it != Global::cached_ptr_types.end()) {
+        return it->second;
+    }
+
+    Type* t = type_alloc(TypeKind::PTR);
+    t->size = PTR_SIZE;
+    t->align = PTR_SIZE;
+    t->ptr.base = base;
+    Global::cached_ptr_types[base->id] = t;
+    return t;
+}
+
+//*size 0 is an unsized array, only a compound literal can give it a length
+Type* type_array(Type* base, size_t size) {
+    u64 key = type_key_mix(type_key_mix(0xcbf29ce484222325ull, base->id), size);
+    auto range = Global::cached_array_types.equal_range(key);
+    for (auto it = range.first; it != range.second; it++) {
+        if (it->second->array.base == base && it->second->array.size == size) {
+            return it->second;
+        }
+    }
+
+    Type* t = type_alloc(TypeKind::ARRAY);
+    t->size = size * base->size;
+    t->align = base->align;
+    t->array.base = base;
+    t->array.size = size;
+    Global::cached_array_types.emplace(key, t);
+    return t;
+}
+
+Type* type_func(Type** params, size_t num_params, Type* ret) {
+    u64 key = type_key_mix(0xcbf29ce484222325ull, ret->id);
+    for (size_t i = 0; i < num_params; i++) {
+        key = type_key_mix(key, params[i]->id);
+    }
+
+    auto range = Global::cached_func_types.equal_range(key);
+    for (auto it = range.first; it != range.second; it++) {
+        Type* func = it->second;
+        if (func->func.ret == ret && func->func.num_params == num_params
+            && (num_params == 0 || memcmp(func->func.params, params, num_params * sizeof(Type*)) == 0)) {
+            return func;
+        }
+    }
+
+    Type* t = type_alloc(TypeKind::FUNC);
+    t->size = PTR_SIZE;
+    t->align = PTR_SIZE;
+    t->func.params = (Type**)xcalloc(num_params, sizeof(Type*));
+    if (num_params) {
+        memcpy(t->func.params, params, num_params * sizeof(Type*));
+    }
+    t->func.num_params = num_params;
+    t->func.ret = ret;
+
+    Global::cached_func_types.emplace(key, t);
+    return t;
+}
+
+Type* type_incomplete(Sym* sym) {
+    Type* t = type_alloc(TypeKind::INCOMPLETE);
+    t->sym = sym;
+    return t;
+}
+
+Internal size_t align_up(size_t n, size_t align) {
+    return (n + align - 1) / align * align;
+}
+
+Internal void type_set_fields(Type* type, TypeField* fields, size_t num_fields) {
+    type->aggregate.fields = (TypeField*)xcalloc(num_fields, sizeof(TypeField));
+    if (num_fields) {
+        memcpy(type->aggregate.fields, fields, num_fields * sizeof(TypeField));
+    }
+    type->aggregate.num_fields = num_fields;
+}
+
+void type_complete_struct(Type* type, TypeField* fields, size_t num_fields) {
+    type->kind = TypeKind::STRUCT;
+    type->size = 0;
+    type->align = 1;
+    type_set_fields(type, fields, num_fields);
+    for (TypeField* it = type->aggregate.fields; it != type->aggregate.fields + num_fields; it++) {
+        assert(it->type->kind > TypeKind::COMPLETING);
+        it->offset = align_up(type->size, it->type->align);
+        type->size = it->offset + it->type->size;
+        type->align = it->type->align > type->align ? it->type->align : type->align;
+    }
+    type->size = align_up(type->size, type->align);
+}
+
+void type_complete_union(Type* type, TypeField* fields, size_t num_fields) {
+    type->kind = TypeKind::UNION;
+    type->size = 0;
+    type->align = 1;
+    type_set_fields(type, fields, num_fields);
+    for (TypeField* it = type->aggregate.fields; it != type->aggregate.fields + num_fields; it++) {
+        assert(it->type->kind > TypeKind::COMPLETING);
+        it->offset = 0;
+        type->size = it->type->size > type->size ? it->type->size : type->size;
+        type->align = it->type->align > type->align ? it->type->align : type->align;
+    }
+    type->size = align_up(type->size, type->align);
+}
+
+Type* type_struct(TypeField* fields, size_t num_fields) {
+    Type* t = type_alloc(TypeKind::STRUCT);
+    type_complete_struct(t, fields, num_fields);
+    return t;
+}
+
+Type* type_union(TypeField* fields, size_t num_fields) {
+    Type* t = type_alloc(TypeKind::UNION);
+    type_complete_union(t, fields, num_fields);
+    return t;
+}
+
+std::string type_to_str(Type* type) {
+    if (TypeKind::VOID <= type->kind && type->kind <= TypeKind::LAST_ARITHMETIC) {
+        return scalar_type_names[(int)type->kind];
+    }
+
+    switch (type->kind) {
+        case TypeKind::PTR: {
+            return type_to_str(type->ptr.base) + "*";
+        }
+        case TypeKind::ARRAY: {
+            return type_to_str(type->array.base) + "[" + std::to_string(type->array.size) + "]";
+        }
+        case TypeKind::FUNC: {
+            std::string str = "func(";
+            for (size_t i = 0; i < type->func.num_params; i++) {
+                str += (i ? ", " : "") + type_to_str(type->func.params[i]);
+            }
+            return str + "):" + type_to_str(type->func.ret);
+        }
+        default: {
+            if (type->sym) {
+                return type->sym->name;
+            }
+            return type->kind == TypeKind::UNION ? "union" : "struct";
+        }
+    }
+}
+
+bool is_integer_type(Type* type) {
+    return TypeKind::FIRST_INTEGER <= type->kind && type->kind <= TypeKind::LAST_INTEGER;
+}
+
+bool is_floating_type(Type* type) {
+    return type->kind == TypeKind::FLOAT || type->kind == TypeKind::DOUBLE;
+}
+
+bool is_arithmetic_type(Type* type) {
+    return TypeKind::FIRST_ARITHMETIC <= type->kind && type->kind <= TypeKind::LAST_ARITHMETIC;
+}
+
+bool is_signed_type(Type* type) {
+    return is_arithmetic_type(type) && arithmetic.is_signed[(int)type->kind];
+}
+
+Internal bool is_scalar_type(Type* type) {
+    return is_arithmetic_type(type) || type->kind == TypeKind::PTR || type->kind == TypeKind::FUNC;
+}
+
+Internal bool is_void_ptr(Type* type) {
+    return type->kind == TypeKind::PTR && type->ptr.base->kind == TypeKind::VOID;
+}
+
+Internal ResolvedExpr resolved_rvalue(Type* type) {
+    ResolvedExpr resolved = {};
+    resolved.type = type;
+    return resolved;
+}
+
+Internal ResolvedExpr resolved_lvalue(Type* type) {
+    ResolvedExpr resolved = {};
+    resolved.type = type;
+    resolved.is_lvalue = true;
+    return resolved;
+}
+
+Internal ResolvedExpr resolved_const_int(Type* type, i64 val) {
+    ResolvedExpr resolved = {};
+    resolved.type = type;
+    resolved.is_const = true;
+    resolved.int_val = val;
+    return resolved;
+}
+
+Internal ResolvedExpr resolved_const_float(Type* type, f64 val) {
+    ResolvedExpr resolved = {};
+    resolved.type = type;
+    resolved.is_const = true;
+    resolved.float_val = val;
+    return resolved;
+}
+
+Internal bool is_null_ptr(ResolvedExpr operand) {
+    return operand.is_const && is_integer_type(operand.type) && operand.int_val == 0;
+}
+
+//*integer constants are folded in 64 bits and wrapped to their type, unsigned values are kept zero extended
+Internal i64 wrap_int(Type* type, i64 val) {
+    bool is_signed = arithmetic.is_signed[(int)type->kind];
+    switch (arithmetic.size[(int)type->kind]) {
+        case 1: {
+            if (type->kind == TypeKind::BOOL) {
+                return val != 0;
+            }
+            return is_signed ? (i64)(i8)val : (i64)(u8)val;
+        }
+        case 2: {
+            return is_signed ? (i64)(i16)val : (i64)(u16)val;
+        }
+        case 4: {
+            return is_signed ? (i64)(i32)val : (i64)(u32)val;
+        }
+        default: {
+            return val;
+        }
+    }
+}
+
+Internal f64 wrap_float(Type* type, f64 val) {
+    return type->kind == TypeKind::FLOAT ? (f64)(f32)val : val;
+}
+
+Internal void set_operand_type(ResolvedExpr* operand, Type* type) {
+    if (operand->is_const) {
+        Type* src = operand->type;
+        if (is_floating_type(type)) {
+            if (is_integer_type(src)) {
+                operand->float_val = is_signed_type(src) ? (f64)operand->int_val : (f64)(u64)operand->int_val;
+            }
+            else if (!is_floating_type(src)) {
+                operand->is_const = false;
+            }
+            operand->float_val = wrap_float(type, operand->float_val);
+        }
+        else if (is_integer_type(type)) {
+            if (is_floating_type(src)) {
+                f64 val = operand->float_val;
+                operand->int_val = type->kind == TypeKind::BOOL ? val != 0 : is_signed_type(type) ? (i64)val : (i64)(u64)val;
+            }
+            else if (!is_integer_type(src)) {
+                operand->is_const = false;
+            }
+            operand->int_val = wrap_int(type, operand->int_val);
+        }
+        else {
+            operand->is_const = false;
+        }
+    }
+
+    operand->type = type;
+    operand->is_lvalue = false;
+}
+
+//*implicit conversions, every arithmetic type converts to every other and void* to and from any pointer
+Internal bool is_convertible(ResolvedExpr operand, Type* type) {
+    Type* src = operand.type;
+    if (src == type) {
+        return true;
+    }
+    else if (is_arithmetic_type(src) && is_arithmetic_type(type)) {
+        return true;
+    }
+    else if (type->kind == TypeKind::PTR && src->kind == TypeKind::PTR) {
+        return is_void_ptr(type) || is_void_ptr(src);
+    }
+    else if (type->kind == TypeKind::BOOL) {
+        return src->kind == TypeKind::PTR;
+    }
+    else if (type->kind == TypeKind::PTR) {
+        return is_null_ptr(operand);
+    }
+
+    return false;
+}
+
+Internal void convert_operand(ResolvedExpr* operand, Type* type) {
+    if (!is_convertible(*operand, type)) {
+        fatal("Invalid type conversion from %s to %s", type_to_str(operand->type).c_str(), type_to_str(type).c_str());
+    }
+
+    set_operand_type(operand, type);
+}
+
+//*explicit conversions additionally allow any pointer to any pointer and pointers to and from integers
+Internal void cast_operand(ResolvedExpr* operand, Type* type) {
+    Type* src = operand->type;
+    bool castable = is_convertible(*operand, type)
+        || (type->kind == TypeKind::PTR && (src->kind == TypeKind::PTR || is_integer_type(src)))
+        || (is_integer_type(type) && src->kind == TypeKind::PTR);
+    if (!castable) {
+        fatal("Invalid type cast from %s to %s", type_to_str(src).c_str(), type_to_str(type).c_str());
+    }
+
+    set_operand_type(operand, type);
+}
+
+//*arrays are only arrays in sizeof, & and aggregate initializers, everywhere else they are pointers to their first element
+Internal ResolvedExpr pointer_decay(ResolvedExpr operand) {
+    if (operand.type->kind == TypeKind::ARRAY) {
+        return resolved_rvalue(type_ptr(operand.type->array.base));
+    }
+
+    return operand;
+}
+
+Type* type_promote(Type* type) {
+    assert(is_arithmetic_type(type));
+    return Global::types[arithmetic.promote[(int)type->kind]];
+}
+
+Internal void promote_operand(ResolvedExpr* operand) {
+    set_operand_type(operand, type_promote(operand->type));
+}
+
+Type* type_unify(Type* left, Type* right) {
+    assert(is_arithmetic_type(left) && is_arithmetic_type(right));
+    return Global::types[arithmetic.unify[(int)left->kind][(int)right->kind]];
+}
+
+//*usual arithmetic conversions, one table lookup on the two operand kinds
+Internal void unify_arithmetic(ResolvedExpr* left, ResolvedExpr* right) {
+    Type* type = type_unify(left->type, right->type);
+    set_operand_type(left, type);
+    set_operand_type(right, type);
+}
+
+Internal Sym* resolve_name(const char* name);
+Internal void resolve_sym(Sym* sym);
+Internal void complete_type(Type* type);
+Internal Type* resolve_typespec(Typespec* type);
+Internal ResolvedExpr resolve_expected_expr(Expr* expr, Type* expected_type);
+
+Internal ResolvedExpr resolve_expr(Expr* expr) {
+    return resolve_expected_expr(expr, nullptr);
+}
+
+Internal ResolvedExpr resolve_expr_rvalue(Expr* expr) {
+    return pointer_decay(resolve_expr(expr));
+}
+
+//*an initializer of an array stays an array, everything else is an rvalue
+Internal ResolvedExpr resolve_initializer(Expr* expr, Type* type) {
+    ResolvedExpr init = resolve_expected_expr(expr, type);
+    return type && type->kind == TypeKind::ARRAY ? init : pointer_decay(init);
+}
+
+//*checks a constant expression, calls in it run at compile time
+Internal ResolvedExpr resolve_const_expr(Expr* expr) {
+    bool in_const_expr = Global::in_const_expr;
+    Global::in_const_expr = true;
+    ResolvedExpr resolved = resolve_expr_rvalue(expr);
+    Global::in_const_expr = in_const_expr;
+    return resolved;
+}
+
+Internal i64 resolve_const_int_expr(Expr* expr) {
+    ResolvedExpr resolved = resolve_const_expr(expr);
+    if (!resolved.is_const || !is_integer_type(resolved.type)) {
+        fatal("Expected integer constant expression");
+    }
+
+    return resolved.int_val;
+}
+
+Internal ResolvedExpr resolve_expr_name(Expr* expr) {
+    Sym* sym = resolve_name(expr->name);
+    Global::expr_syms[expr->id] = sym;
+    switch (sym->kind) {
+        case SymKind::VAR: {
+            return resolved_lvalue(sym->type);
+        }
+        case SymKind::CONST: {
+            ResolvedExpr resolved = resolved_rvalue(sym->type);
+            resolved.is_const = true;
+            if (is_floating_type(sym->type)) {
+                resolved.float_val = sym->float_val;
+            }
+            else {
+                resolved.int_val = sym->int_val;
+            }
+            return resolved;
+        }
+        case SymKind::ENUM_CONST: {
+            return resolved_const_int(sym->type, sym->int_val);
+        }
+        case SymKind::FUNC: {
+            return resolved_rvalue(sym->type);
+        }
+        default: {
+            fatal("%s must denote a value", sym->name);
+            return resolved_rvalue(nullptr);
+        }
+    }
+}
+
+//*unsigned operands are zero extended, so unsigned division, shifts and comparisons can run on u64
+Internal i64 eval_int_binary(TokenKind op, i64 left, i64 right, bool is_signed) {
+    if (!is_signed) {
+        u64 l = (u64)left;
+        u64 r = (u64)right;
+        switch (op) {
+            case TokenKind::DIV: {
+                return (i64)(l / r);
+            }
+            case TokenKind::MOD: {
+                return (i64)(l % r);
+            }
+            case TokenKind::RSHIFT: {
+                return (i64)(l >> (r & 63));
+            }
+            case TokenKind::LT: {
+                return l < r;
+            }
+            case TokenKind::GT: {
+                return l > r;
+            }
+            case TokenKind::LTEQ: {
+                return l <= r;
+            }
+            case TokenKind::GTEQ: {
+                return l >= r;
+            }
+            default: {
+                break;
+            }
+        }
+    }
+
+    //*+ - * and << wrap in unsigned arithmetic, signed overflow would be undefined in the compiler itself
+    switch (op) {
+        case TokenKind::MUL: {
+            return (i64)((u64)left * (u64)right);
+        }
+        case TokenKind::DIV: {
+            return right == -1 ? (i64)(0 - (u64)left) : left / right;
+        }
+        case TokenKind::MOD: {
+            return right == -1 ? 0 : left % right;
+        }
+        case TokenKind::AND: {
+            return left & right;
+        }
+        case TokenKind::LSHIFT: {
+            return (i64)((u64)left << (right & 63));
+        }
+        case TokenKind::RSHIFT: {
+            return left >> (right & 63);
+        }
+        case TokenKind::ADD: {
+            return (i64)((u64)left + (u64)right);
+        }
+        case TokenKind::SUB: {
+            return (i64)((u64)left - (u64)right);
+        }
+        case TokenKind::XOR: {
+            return left ^ right;
+        }
+        case TokenKind::OR: {
+            return left | right;
+        }
+        case TokenKind::EQ: {
+            return left == right;
+        }
+        case TokenKind::NOTEQ: {
+            return left != right;
+        }
+        case TokenKind::LT: {
+            return left < right;
+        }
+        case TokenKind::GT: {
+            return left > right;
+        }
+        case TokenKind::LTEQ: {
+            return left <= right;
+        }
+        case TokenKind::GTEQ: {
+            return left >= right;
+        }
+        case TokenKind::AND_AND: {
+            return left && right;
+        }
+        case TokenKind::OR_OR: {
+            return left || right;
+        }
+        default: {
+            assert(0);
+            return 0;
+        }
+    }
+}
+
+Internal bool is_cmp_op(TokenKind op) {
+    return TokenKind::FIRST_CMP <= op && op <= TokenKind::LAST_CMP;
+}
+
+//*left and right already share an arithmetic type, except for shifts where each side is only promoted, comparisons produce int
+Internal ResolvedExpr resolve_binary_arithmetic(TokenKind op, ResolvedExpr left, ResolvedExpr right) {
+    Type* type = is_cmp_op(op) ? Global::type_int : left.type;
+    if (!left.is_const || !right.is_const) {
+        return resolved_rvalue(type);
+    }
+
+    if (is_floating_type(left.type)) {
+        f64 l = left.float_val;
+        f64 r = right.float_val;
+        switch (op) {
+            case TokenKind::MUL: {
+                return resolved_const_float(type, wrap_float(type, l * r));
+            }
+            case TokenKind::DIV: {
+                return resolved_const_float(type, wrap_float(type, l / r));
+            }
+            case TokenKind::ADD: {
+                return resolved_const_float(type, wrap_float(type, l + r));
+            }
+            case TokenKind::SUB: {
+                return resolved_const_float(type, wrap_float(type, l - r));
+            }
+            case TokenKind::EQ: {
+                return resolved_const_int(type, l == r);
+            }
+            case TokenKind::NOTEQ: {
+                return resolved_const_int(type, l != r);
+            }
+            case TokenKind::LT: {
+                return resolved_const_int(type, l < r);
+            }
+            case TokenKind::GT: {
+                return resolved_const_int(type, l > r);
+            }
+            case TokenKind::LTEQ: {
+                return resolved_const_int(type, l <= r);
+            }
+            case TokenKind::GTEQ: {
+                return resolved_const_int(type, l >= r);
+            }
+            default: {
+                assert(0);
+                return resolved_rvalue(type);
+            }
+        }
+    }
+
+    if ((op == TokenKind::DIV || op == TokenKind::MOD) && right.int_val == 0) {
+        fatal("Division by zero in constant expression");
+    }
+
+    return resolved_const_int(type, wrap_int(type, eval_int_binary(op, left.int_val, right.int_val, is_signed_type(left.type))));
+}
+
+bool fold_binary(TokenKind op, ResolvedExpr left, ResolvedExpr right, ResolvedExpr* result) {
+    assert(left.is_const && right.is_const);
+    if ((op == TokenKind::DIV || op == TokenKind::MOD) && is_integer_type(left.type) && right.int_val == 0) {
+        return false;
+    }
+
+    *result = resolve_binary_arithmetic(op, left, right);
+    return true;
+}
+
+ResolvedExpr fold_convert(ResolvedExpr operand, Type* type) {
+    assert(operand.is_const && is_arithmetic_type(operand.type) && is_arithmetic_type(type));
+    set_operand_type(&operand, type);
+    return operand;
+}
+
+Internal ResolvedExpr resolve_expr_binary(Expr* expr) {
+    TokenKind op = expr->binary.op;
+    ResolvedExpr left = resolve_expr_rvalue(expr->binary.left);
+    ResolvedExpr right = resolve_expr_rvalue(expr->binary.right);
+    const char* op_name = Global::token_kind_names[(int)op];
+    switch (op) {
+        case TokenKind::MUL:
+        case TokenKind::DIV: {
+            if (!is_arithmetic_type(left.type) || !is_arithmetic_type(right.type)) {
+                fatal("Operands of %s must have arithmetic types", op_name);
+            }
+            unify_arithmetic(&left, &right);
+            return resolve_binary_arithmetic(op, left, right);
+        }
+        case TokenKind::LSHIFT:
+        case TokenKind::RSHIFT: {
+            if (!is_integer_type(left.type) || !is_integer_type(right.type)) {
+                fatal("Operands of %s must have integer types", op_name);
+            }
+            promote_operand(&left);
+            promote_operand(&right);
+            return resolve_binary_arithmetic(op, left, right);
+        }
+        case TokenKind::MOD:
+        case TokenKind::AND:
+        case TokenKind::XOR:
+        case TokenKind::OR: {
+            if (!is_integer_type(left.type) || !is_integer_type(right.type)) {
+                fatal("Operands of %s must have integer types", op_name);
+            }
+            unify_arithmetic(&left, &right);
+            return resolve_binary_arithmetic(op, left, right);
+        }
+        case TokenKind::ADD: {
+            if (is_arithmetic_type(left.type) && is_arithmetic_type(right.type)) {
+                unify_arithmetic(&left, &right);
+                return resolve_binary_arithmetic(op, left, right);
+            }
+            else if (left.type->kind == TypeKind::PTR && is_integer_type(right.type)) {
+                return resolved_rvalue(left.type);
+            }
+            else if (is_integer_type(left.type) && right.type->kind == TypeKind::PTR) {
+                return resolved_rvalue(right.type);
+            }
+            fatal("Operands of + must both have arithmetic types, or one pointer and one integer type");
+            return resolved_rvalue(nullptr);
+        }
+        case TokenKind::SUB: {
+            if (is_arithmetic_type(left.type) && is_arithmetic_type(right.type)) {
+                unify_arithmetic(&left, &right);
+                return resolve_binary_arithmetic(op, left, right);
+            }
+            else if (left.type->kind == TypeKind::PTR && is_integer_type(right.type)) {
+                return resolved_rvalue(left.type);
+            }
+            else if (left.type->kind == TypeKind::PTR && left.type == right.type) {
+                return resolved_rvalue(Global::type_ssize);
+            }
+            fatal("Operands of - must both have arithmetic types, a pointer and an integer, or pointers of the same type");
+            return resolved_rvalue(nullptr);
+        }
+        case TokenKind::EQ:
+        case TokenKind::NOTEQ:
+        case TokenKind::LT:
+        case TokenKind::GT:
+        case TokenKind::LTEQ:
+        case TokenKind::GTEQ: {
+            if (is_arithmetic_type(left.type) && is_arithmetic_type(right.type)) {
+                unify_arithmetic(&left, &right);
+                return resolve_binary_arithmetic(op, left, right);
+            }
+            else if (left.type->kind == TypeKind::PTR && (is_convertible(right, left.type) || is_convertible(left, right.type))) {
+                return resolved_rvalue(Global::type_int);
+            }
+            else if (right.type->kind == TypeKind::PTR && is_null_ptr(left)) {
+                return resolved_rvalue(Global::type_int);
+            }
+            fatal("Operands of %s must both have arithmetic types or compatible pointer types", op_name);
+            return resolved_rvalue(nullptr);
+        }
+        case TokenKind::AND_AND:
+        case TokenKind::OR_OR: {
+            if (!is_scalar_type(left.type) || !is_scalar_type(right.type)) {
+                fatal("Operands of %s must have scalar types", op_name);
+            }
+            if (left.is_const && right.is_const && is_integer_type(left.type) && is_integer_type(right.type)) {
+                return resolved_const_int(Global::type_int, eval_int_binary(op, left.int_val, right.int_val, true));
+            }
+            return resolved_rvalue(Global::type_int);
+        }
+        default: {
+            fatal("Unexpected binary operator %s", op_name);
+            return resolved_rvalue(nullptr);
+        }
+    }
+}
+
+Internal ResolvedExpr resolve_expr_unary(Expr* expr) {
+    TokenKind op = expr->unary.op;
+    if (op == TokenKind::AND) {
+        ResolvedExpr operand = resolve_expr(expr->unary.expr);
+        if (!operand.is_lvalue) {
+            fatal("Cannot take address of non-lvalue");
+        }
+        return resolved_rvalue(type_ptr(operand.type));
+    }
+
+    ResolvedExpr operand = resolve_expr_rvalue(expr->unary.expr);
+    switch (op) {
+        case TokenKind::MUL: {
+            if (operand.type->kind != TypeKind::PTR) {
+                fatal("Cannot dereference non-pointer type %s", type_to_str(operand.type).c_str());
+            }
+            complete_type(operand.type->ptr.base);
+            if (operand.type->ptr.base->kind == TypeKind::VOID) {
+                fatal("Cannot dereference void pointer");
+            }
+            return resolved_lvalue(operand.type->ptr.base);
+        }
+        case TokenKind::ADD:
+        case TokenKind::SUB: {
+            if (!is_arithmetic_type(operand.type)) {
+                fatal("Can only use unary %s with arithmetic types", Global::token_kind_names[(int)op]);
+            }
+            promote_operand(&operand);
+            if (op == TokenKind::SUB && operand.is_const) {
+                if (is_floating_type(operand.type)) {
+                    operand.float_val = -operand.float_val;
+                }
+                else {
+                    operand.int_val = wrap_int(operand.type, (i64)(0 - (u64)operand.int_val));
+                }
+            }
+            return operand;
+        }
+        default: {
+            fatal("Unexpected unary operator %s", Global::token_kind_names[(int)op]);
+            return resolved_rvalue(nullptr);
+        }
+    }
+}
+
+Internal ResolvedExpr resolve_expr_ternary(Expr* expr) {
+    ResolvedExpr cond = resolve_expr_rvalue(expr->ternary.cond);
+    if (!is_scalar_type(cond.type)) {
+        fatal("Ternary condition must have scalar type");
+    }
+
+    ResolvedExpr then_expr = resolve_expr_rvalue(expr->ternary.then_expr);
+    ResolvedExpr else_expr = resolve_expr_rvalue(expr->ternary.else_expr);
+    if (is_arithmetic_type(then_expr.type) && is_arithmetic_type(else_expr.type)) {
+        unify_arithmetic(&then_expr, &else_expr);
+        if (cond.is_const && is_integer_type(cond.type) && then_expr.is_const && else_expr.is_const) {
+            return cond.int_val ? then_expr : else_expr;
+        }
+        return resolved_rvalue(then_expr.type);
+    }
+    else if (is_convertible(else_expr, then_expr.type)) {
+        return resolved_rvalue(then_expr.type);
+    }
+    else if (is_convertible(then_expr, else_expr.type)) {
+        return resolved_rvalue(else_expr.type);
+    }
+
+    fatal("Ternary branches have incompatible types %s and %s", type_to_str(then_expr.type).c_str(), type_to_str(else_expr.type).c_str());
+    return resolved_rvalue(nullptr);
+}
+
+Internal ResolvedExpr resolve_expr_call(Expr* expr) {
+    Type* type = resolve_expr_rvalue(expr->call.expr).type;
+    if (type->kind == TypeKind::PTR && type->ptr.base->kind == TypeKind::FUNC) {
+        type = type->ptr.base;
+    }
+    if (type->kind != TypeKind::FUNC) {
+        fatal("Cannot call non-function value of type %s", type_to_str(type).c_str());
+    }
+    if (expr->call.num_args != type->func.num_params) {
+        fatal("Calling function with %zu arguments, expected %zu", expr->call.num_args, type->func.num_params);
+    }
+
+    std::vector<ResolvedExpr> args;
+    bool const_args = true;
+    for (size_t i = 0; i < expr->call.num_args; i++) {
+        Type* param = type->func.params[i];
+        ResolvedExpr arg = pointer_decay(resolve_expected_expr(expr->call.args[i], param));
+        convert_operand(&arg, param);
+        args.push_back(arg);
+        const_args = const_args && arg.is_const;
+    }
+
+    //*a constant expression runs a direct call with constant arguments at compile time
+    Sym* func = expr->call.expr->kind == ExprKind::NAME ? expr_sym(expr->call.expr) : nullptr;
+    if (Global::in_const_expr && const_args && func && func->kind == SymKind::FUNC) {
+        complete_type(type->func.ret);
+        if (ctfe_is_computable(type->func.ret)) {
+            std::vector<u8>* val = &Global::const_call_vals[expr->id];
+            ctfe_call(func, args, val);
+            if (is_arithmetic_type(type->func.ret)) {
+                return ctfe_scalar(type->func.ret, val->data());
+            }
+        }
+    }
+
+    return resolved_rvalue(type->func.ret);
+}
+
+Internal ResolvedExpr resolve_expr_index(Expr* expr) {
+    ResolvedExpr operand = resolve_expr_rvalue(expr->index.expr);
+    if (operand.type->kind != TypeKind::PTR) {
+        fatal("Can only index arrays and pointers, not %s", type_to_str(operand.type).c_str());
+    }
+
+    ResolvedExpr index = resolve_expr_rvalue(expr->index.index);
+    if (!is_integer_type(index.type)) {
+        fatal("Index must have integer type");
+    }
+
+    complete_type(operand.type->ptr.base);
+    return resolved_lvalue(operand.type->ptr.base);
+}
+
+//*fields are reached through a pointer too, v.x on a Vector* reads (*v).x
+Internal ResolvedExpr resolve_expr_field(Expr* expr) {
+    ResolvedExpr operand = resolve_expr(expr->field.expr);
+    Type* type = operand.type;
+    bool is_lvalue = operand.is_lvalue;
+    if (type->kind == TypeKind::PTR) {
+        type = type->ptr.base;
+        is_lvalue = true;
+    }
+
+    complete_type(type);
+    if (type->kind != TypeKind::STRUCT && type->kind != TypeKind::UNION) {
+        fatal("Can only access fields on aggregates, not %s", type_to_str(type).c_str());
+    }
+
+    for (TypeField* it = type->aggregate.fields; it != type->aggregate.fields + type->aggregate.num_fields; it++) {
+        if (it->name == expr->field.name) {
+            return is_lvalue ? resolved_lvalue(it->type) : resolved_rvalue(it->type);
+        }
+    }
+
+    fatal("No field named %s in %s", expr->field.name, type_to_str(type).c_str());
+    return resolved_rvalue(nullptr);
+}
+
+Internal ResolvedExpr resolve_expr_compound(Expr* expr, Type* expected_type) {
+    Type* type = expected_type;
+    if (expr->compound.type) {
+        type = resolve_typespec(expr->compound.type);
+    }
+    if (!type) {
+        fatal("Implicitly typed compound literal in context without expected type");
+    }
+
+    complete_type(type);
+    size_t num_args = expr->compound.num_args;
+    if (type->kind == TypeKind::STRUCT || type->kind == TypeKind::UNION) {
+        if (num_args > type->aggregate.num_fields) {
+            fatal("Compound literal has too many fields for %s", type_to_str(type).c_str());
+        }
+        for (size_t i = 0; i < num_args; i++) {
+            Type* field = type->aggregate.fields[i].type;
+            ResolvedExpr arg = resolve_initializer(expr->compound.args[i], field);
+            convert_operand(&arg, field);
+        }
+    }
+    else if (type->kind == TypeKind::ARRAY) {
+        if (type->array.size == 0) {
+            type = type_array(type->array.base, num_args);
+        }
+        if (num_args > type->array.size) {
+            fatal("Compound literal has too many elements for %s", type_to_str(type).c_str());
+        }
+        for (size_t i = 0; i < num_args; i++) {
+            ResolvedExpr arg = resolve_initializer(expr->compound.args[i], type->array.base);
+            convert_operand(&arg, type->array.base);
+        }
+    }
+    else {
+        if (num_args != 1) {
+            fatal("Compound literal for scalar type %s must have exactly one element", type_to_str(type).c_str());
+        }
+        ResolvedExpr arg = pointer_decay(resolve_expected_expr(expr->compound.args[0], type));
+        convert_operand(&arg, type);
+    }
+
+    return resolved_lvalue(type);
+}
+
+Internal ResolvedExpr resolve_expr_cast(Expr* expr) {
+    Type* type = resolve_typespec(expr->cast.type);
+    ResolvedExpr operand = resolve_expr_rvalue(expr->cast.expr);
+    cast_operand(&operand, type);
+    return operand;
+}
+
+Internal ResolvedExpr resolve_sizeof(Type* type) {
+    complete_type(type);
+    if (type->kind == TypeKind::VOID || (type->kind == TypeKind::ARRAY && type->array.size == 0)) {
+        fatal("Cannot take sizeof %s", type_to_str(type).c_str());
+    }
+
+    return resolved_const_int(Global::type_usize, (i64)type->size);
+}
+
+//*the first of int, long, llong that holds the literal, ullong past that
+Internal Type* int_literal_type(u64 val) {
+    if (val <= INT32_MAX) {
+        return Global::type_int;
+    }
+    else if (val <= (u64)LONG_MAX) {
+        return Global::type_long;
+    }
+    else if (val <= INT64_MAX) {
+        return Global::type_llong;
+    }
+
+    return Global::type_ullong;
+}
+
+Internal ResolvedExpr resolve_expected_expr(Expr* expr, Type* expected_type) {
+    if (expr->id >= Global::expr_types.size()) {
+        Global::expr_types.resize(Global::next_expr_id);
+        Global::expr_syms.resize(Global::next_expr_id);
+    }
+
+    ResolvedExpr resolved = {};
+    switch (expr->kind) {
+        case ExprKind::INT: {
+            resolved = resolved_const_int(int_literal_type((u64)expr->int_val), expr->int_val);
+            break;
+        }
+        case ExprKind::FLOAT: {
+            resolved = resolved_const_float(Global::type_float, wrap_float(Global::type_float, expr->float_val));
+            break;
+        }
+        case ExprKind::STR: {
+            resolved = resolved_rvalue(type_ptr(Global::type_char));
+            break;
+        }
+        case ExprKind::NAME: {
+            resolved = resolve_expr_name(expr);
+            break;
+        }
+        case ExprKind::CAST: {
+            resolved = resolve_expr_cast(expr);
+            break;
+        }
+        case ExprKind::CALL: {
+            resolved = resolve_expr_call(expr);
+            break;
+        }
+        case ExprKind::INDEX: {
+            resolved = resolve_expr_index(expr);
+            break;
+        }
+        case ExprKind::FIELD: {
+            resolved = resolve_expr_field(expr);
+            break;
+        }
+        case ExprKind::COMPOUND: {
+            resolved = resolve_expr_compound(expr, expected_type);
+            break;
+        }
+        case ExprKind::UNARY: {
+            resolved = resolve_expr_unary(expr);
+            break;
+        }
+        case ExprKind::BINARY: {
+            resolved = resolve_expr_binary(expr);
+            break;
+        }
+        case ExprKind::TERNARY: {
+            resolved = resolve_expr_ternary(expr);
+            break;
+        }
+        case ExprKind::SIZEOF_EXPR: {
+            resolved = resolve_sizeof(resolve_expr(expr->sizeof_expr).type);
+            break;
+        }
+        case ExprKind::SIZEOF_TYPE: {
+            resolved = resolve_sizeof(resolve_typespec(expr->sizeof_type));
+            break;
+        }
+        default: {
+            fatal("Cannot type check erroneous expression");
+            break;
+        }
+    }
+
+    Global::expr_types[expr->id] = resolved.type->id;
+    return resolved;
+}
+
+Type* expr_type(Expr* expr) {
+    return expr->id < Global::expr_types.size() ? Global::types[Global::expr_types[expr->id]] : nullptr;
+}
+
+Type* typespec_type(Typespec* type) {
+    return type->id < Global::typespec_types.size() ? Global::types[Global::typespec_types[type->id]] : nullptr;
+}
+
+Sym* local_decl_sym(const void* node) {
+    auto it = Global::local_decl_syms.find(node);
+    return it != Global::local_decl_syms.end() ? it->second : nullptr;
+}
+
+i64 case_val(Expr* expr) {
+    auto it = Global::case_vals.find(expr->id);
+    assert(it != Global::case_vals.end());
+    return it->second;
+}
+
+Sym* expr_sym(Expr* expr) {
+    return expr->id < Global::expr_syms.size() ? Global::expr_syms[expr->id] : nullptr;
+}
+
+//*same shape and same names, the array sizes are literals whenever the hash is nonzero
+Internal bool typespec_same_spelling(Typespec* left, Typespec* right) {
+    if (left->hash != right->hash || left->kind != right->kind) {
+        return false;
+    }
+
+    switch (left->kind) {
+        case TypespecKind::NAME: {
+            return left->name == right->name;
+        }
+        case TypespecKind::PTR: {
+            return typespec_same_spelling(left->ptr.elem, right->ptr.elem);
+        }
+        case TypespecKind::ARRAY: {
+            if (!left->array.size || !right->array.size) {
+                return left->array.size == right->array.size && typespec_same_spelling(left->array.elem, right->array.elem);
+            }
+            return left->array.size->int_val == right->array.size->int_val && typespec_same_spelling(left->array.elem, right->array.elem);
+        }
+        case TypespecKind::FUNC: {
+            if (left->func.num_args != right->func.num_args || !left->func.ret != !right->func.ret) {
+                return false;
+            }
+            for (size_t i = 0; i < left->func.num_args; i++) {
+                if (!typespec_same_spelling(left->func.args[i], right->func.args[i])) {
+                    return false;
+                }
+            }
+            return !left->func.ret || typespec_same_spelling(left->func.ret, right->func.ret);
+        }
+        default: {
+            return false;
+        }
+    }
+}
+
+Internal Type* resolve_typespec_uncached(Typespec* type) {
+    switch (type->kind) {
+        case TypespecKind::NAME: {
+            Sym* sym = resolve_name(type->name);
+            if (sym->kind != SymKind::TYPE) {
+                fatal("%s must denote a type", type->name);
+            }
+            return sym->type;
+        }
+        case TypespecKind::PTR: {
+            return type_ptr(resolve_typespec(type->ptr.elem));
+        }
+        case TypespecKind::ARRAY: {
+            Type* base = resolve_typespec(type->array.elem);
+            complete_type(base);
+            if (base->kind == TypeKind::VOID) {
+                fatal("Array elements cannot have type %s", type_to_str(base).c_str());
+            }
+            if (!type->array.size) {
+                return type_array(base, 0);
+            }
+            i64 size = resolve_const_int_expr(type->array.size);
+            if (size <= 0) {
+                fatal("Array size must be positive");
+            }
+            return type_array(base, (size_t)size);
+        }
+        case TypespecKind::FUNC: {
+            std::vector<Type*> params;
+            for (size_t i = 0; i < type->func.num_args; i++) {
+                params.push_back(resolve_typespec(type->func.args[i]));
+            }
+            Type* ret = type->func.ret ? resolve_typespec(type->func.ret) : Global::type_void;
+            return type_func(params.data(), params.size(), ret);
         }
+        default: {
+            fatal("Cannot resolve erroneous type");
+            return nullptr;
+        }
+    }
+}
+
+//*memoized twice: per node by id, and per spelling by hash so every later "int*" or "Vector[16]" is one lookup.
+//*spellings are only shared while no local type can change what a name means, a spelling resolved then only
+//*names globals
+Internal Type* resolve_typespec(Typespec* type) {
+    if (type->id >= Global::typespec_types.size()) {
+        Global::typespec_types.resize(Global::next_typespec_id);
+    }
+
+    u32 id = Global::typespec_types[type->id];
+    if (id) {
+        return Global::types[id];
+    }
+
+    bool shared = type->hash && Global::local_type_floor == SIZE_MAX;
+    if (shared) {
+        auto range = Global::typespec_spellings.equal_range(type->hash);
+        for (auto it = range.first; it != range.second; it++) {
+            if (typespec_same_spelling(it->second, type)) {
+                id = Global::typespec_types[it->second->id];
+                Global::typespec_types[type->id] = id;
+                return Global::types[id];
+            }
+        }
+    }
+
+    Type* resolved = resolve_typespec_uncached(type);
+    Global::typespec_types[type->id] = resolved->id;
+    if (shared) {
+        Global::typespec_spellings.emplace(type->hash, type);
     }
 
-    return nullptr;
+    return resolved;
 }
 
-void sym_put(Decl* decl) {
-    assert(decl->name);
-    assert(!sym_get(decl->name));
-    Global::syms.push_back(Sym{decl->name, decl, SymState::UNRESOLVED});
+Internal void complete_type(Type* type) {
+    if (type->kind == TypeKind::COMPLETING) {
+        fatal("Type completion cycle in %s", type->sym->name);
+        return;
+    }
+    if (type->kind != TypeKind::INCOMPLETE) {
+        return;
+    }
+
+    type->kind = TypeKind::COMPLETING;
+    Decl* decl = type->sym->decl;
+    std::vector<TypeField> fields;
+    for (size_t i = 0; i < decl->aggregate.num_items; i++) {
+        AggregateItem* item = decl->aggregate.items + i;
+        Type* item_type = resolve_typespec(item->type);
+        complete_type(item_type);
+        if (item_type->kind == TypeKind::VOID || (item_type->kind == TypeKind::ARRAY && item_type->array.size == 0)) {
+            fatal("Field of %s cannot have type %s", decl->name, type_to_str(item_type).c_str());
+        }
+
+        for (size_t j = 0; j < item->num_names; j++) {
+            for (TypeField& it : fields) {
+                if (it.name == item->names[j]) {
+                    fatal("Duplicate field %s in %s", it.name, decl->name);
+                }
+            }
+            fields.push_back(TypeField{item->names[j], item_type, 0});
+        }
+    }
+
+    if (decl->kind == DeclKind::STRUCT) {
+        type_complete_struct(type, fields.data(), fields.size());
+    }
+    else {
+        type_complete_union(type, fields.data(), fields.size());
+    }
+    if (!is_live_local(type->sym)) {
+        Global::ordered_syms.push_back(type->sym);
+    }
+}
+
+Internal Type* resolve_decl_var(Decl* decl) {
+    Type* type = decl->var.type ? resolve_typespec(decl->var.type) : nullptr;
+    if (decl->var.expr) {
+        ResolvedExpr init = resolve_initializer(decl->var.expr, type);
+        if (type) {
+            convert_operand(&init, type);
+        }
+        else {
+            type = init.type;
+        }
+    }
+
+    if (!type) {
+        fatal("Variable %s needs a type or an initializer", decl->name);
+    }
+
+    complete_type(type);
+    if (type->kind == TypeKind::VOID || (type->kind == TypeKind::ARRAY && type->array.size == 0)) {
+        fatal("Variable %s cannot have type %s", decl->name, type_to_str(type).c_str());
+    }
+
+    return type;
+}
+
+Internal void resolve_decl_const(Sym* sym) {
+    ResolvedExpr resolved = resolve_const_expr(sym->decl->const_decl.expr);
+    if (!resolved.is_const) {
+        fatal("Initializer for const %s is not a constant expression", sym->name);
+    }
+
+    sym->type = resolved.type;
+    if (is_floating_type(resolved.type)) {
+        sym->float_val = resolved.float_val;
+    }
+    else {
+        sym->int_val = resolved.int_val;
+    }
+}
+
+Internal Type* resolve_decl_func(Decl* decl) {
+    std::vector<Type*> params;
+    for (size_t i = 0; i < decl->func.num_params; i++) {
+        params.push_back(resolve_typespec(decl->func.params[i].type));
+    }
+
+    Type* ret = decl->func.ret_type ? resolve_typespec(decl->func.ret_type) : Global::type_void;
+    return type_func(params.data(), params.size(), ret);
+}
+
+//*items count up from the one before them, the first from 0
+Internal void resolve_enum_const(Sym* sym) {
+    EnumItem* item = sym->enum_item;
+    i64 val = 0;
+    if (item->init) {
+        ResolvedExpr init = resolve_const_expr(item->init);
+        if (!init.is_const || !is_integer_type(init.type)) {
+            fatal("Enum item %s must be initialized with an integer constant expression", sym->name);
+        }
+        bool fits = is_signed_type(init.type) ? INT_MIN <= init.int_val && init.int_val <= INT_MAX : (u64)init.int_val <= INT_MAX;
+        if (!fits) {
+            fatal("Value of enum item %s does not fit in int", sym->name);
+        }
+        val = init.int_val;
+    }
+    else if (item != sym->decl->enum_decl.items) {
+        Sym* prev = sym - 1;
+        resolve_sym(prev);
+        if (prev->int_val == INT_MAX) {
+            fatal("Value of enum item %s does not fit in int", sym->name);
+        }
+        val = prev->int_val + 1;
+    }
+
+    sym->type = Global::type_int;
+    sym->int_val = val;
 }
 
-void resolve_decl(Decl* decl) {
+Internal Type* resolve_decl_type(Decl* decl) {
     switch (decl->kind) {
-        case DeclKind::CONST: {
-            //ConstEntity const_ent = resolve_const_expr(decl->const_decl.expr);
-            
-            break;
+        case DeclKind::TYPEDEF: {
+            return resolve_typespec(decl->typedef_decl.type);
+        }
+        case DeclKind::ENUM: {
+            return Global::type_int;
+        }
+        default: {
+            assert(0);
+            return nullptr;
         }
     }
 }
 
-void resolve_sym(Sym* sym) {
+Internal void resolve_sym(Sym* sym) {
     if (sym->state == SymState::RESOLVED) {
         return;
     }
     if (sym->state == SymState::RESOLVING) {
-        fatal("Cyclic dependency");
+        fatal("Cyclic dependency on %s", sym->name);
         return;
     }
-    resolve_decl(sym->decl);
+
+    sym->state = SymState::RESOLVING;
+    switch (sym->kind) {
+        case SymKind::TYPE: {
+            sym->type = resolve_decl_type(sym->decl);
+            break;
+        }
+        case SymKind::VAR: {
+            //*the initializer of a global is a constant expression, so the tables it computes are emitted as data
+            bool in_const_expr = Global::in_const_expr;
+            Global::in_const_expr = !is_live_local(sym);
+            sym->type = resolve_decl_var(sym->decl);
+            Global::in_const_expr = in_const_expr;
+            break;
+        }
+        case SymKind::CONST: {
+            resolve_decl_const(sym);
+            break;
+        }
+        case SymKind::FUNC: {
+            sym->type = resolve_decl_func(sym->decl);
+            break;
+        }
+        case SymKind::ENUM_CONST: {
+            resolve_enum_const(sym);
+            break;
+        }
+        default: {
+            assert(0);
+            break;
+        }
+    }
+    sym->state = SymState::RESOLVED;
+    if (!is_live_local(sym)) {
+        Global::ordered_syms.push_back(sym);
+    }
 }
 
-Sym* resolve_name(const char* name) {
+Internal Sym* resolve_name(const char* name) {
     Sym* sym = sym_get(name);
     if (!sym) {
-        fatal("Unknown name");
+        fatal("Unknown name %s", name);
         return nullptr;
     }
 
@@ -51,94 +1571,586 @@ Sym* resolve_name(const char* name) {
     return sym;
 }
 
-void resolve_syms() {
-    for (Sym& it : Global::syms) {
-        resolve_sym(&it);
+Internal void resolve_cond_expr(Expr* expr) {
+    ResolvedExpr cond = resolve_expr_rvalue(expr);
+    if (!is_scalar_type(cond.type)) {
+        fatal("Conditional expression must have scalar type, not %s", type_to_str(cond.type).c_str());
     }
 }
 
-Type* type_alloc(TypeKind kind) {
-    Type* t = (Type*)xcalloc(1, sizeof(Type));
-    t->kind = kind;
-    return t;
+Internal void resolve_stmt(Stmt* stmt, Type* ret_type);
+
+Internal void resolve_stmt_block(StmtBlock block, Type* ret_type) {
+    size_t scope = sym_enter();
+    for (size_t i = 0; i < block.num_stmts; i++) {
+        resolve_stmt(block.stmts[i], ret_type);
+    }
+    sym_leave(scope);
 }
 
-Type* type_ptr(Type* base) {
-    for (CachedPtrType& it : Global::cached_ptr_types) {
-        if (it.base == base) {
-            return it.ptr;
+Internal void resolve_stmt_assign(Stmt* stmt) {
+    TokenKind op = stmt->assign.op;
+    ResolvedExpr left = resolve_expr(stmt->assign.left);
+    if (!left.is_lvalue) {
+        fatal("Cannot assign to non-lvalue");
+    }
+    if (left.type->kind == TypeKind::ARRAY) {
+        fatal("Cannot assign to array");
+    }
+
+    if (op == TokenKind::INC || op == TokenKind::DEC) {
+        if (!is_arithmetic_type(left.type) && left.type->kind != TypeKind::PTR) {
+            fatal("Can only use %s with arithmetic and pointer types", Global::token_kind_names[(int)op]);
         }
+        return;
     }
 
-    Type* t = type_alloc(TypeKind::PTR);
-    t->ptr.base = base;
-    Global::cached_ptr_types.push_back({base, t});
-    return t;
+    ResolvedExpr right = pointer_decay(resolve_expected_expr(stmt->assign.right, left.type));
+    switch (op) {
+        case TokenKind::ASSIGN: {
+            convert_operand(&right, left.type);
+            break;
+        }
+        case TokenKind::ADD_ASSIGN:
+        case TokenKind::SUB_ASSIGN: {
+            if (left.type->kind == TypeKind::PTR && is_integer_type(right.type)) {
+                break;
+            }
+            if (!is_arithmetic_type(left.type) || !is_arithmetic_type(right.type)) {
+                fatal("Operands of %s must both have arithmetic types, or a pointer and an integer", Global::token_kind_names[(int)op]);
+            }
+            break;
+        }
+        case TokenKind::MUL_ASSIGN:
+        case TokenKind::DIV_ASSIGN: {
+            if (!is_arithmetic_type(left.type) || !is_arithmetic_type(right.type)) {
+                fatal("Operands of %s must have arithmetic types", Global::token_kind_names[(int)op]);
+            }
+            break;
+        }
+        default: {
+            if (!is_integer_type(left.type) || !is_integer_type(right.type)) {
+                fatal("Operands of %s must have integer types", Global::token_kind_names[(int)op]);
+            }
+            break;
+        }
+    }
 }
 
-Type* type_array(Type* base, size_t size) {
-    for (CachedArrayType& it : Global::cached_array_types) {
-        if (it.base == base && it.size == size) {
-            return it.array;
+//*local declarations are order dependent, they are visible from the next statement on
+Internal void resolve_stmt_decl(Decl* decl) {
+    if (decl->kind == DeclKind::FUNC) {
+        fatal("Nested function %s is not supported", decl->name);
+    }
+
+    Sym* sym = sym_decl(decl);
+    sym_push_local(sym);
+    Global::local_decl_syms[decl] = sym;
+    if (decl->kind == DeclKind::ENUM) {
+        sym_put_enum_items(decl, sym_push_local);
+    }
+
+    resolve_sym(sym);
+    if (sym->kind == SymKind::TYPE) {
+        complete_type(sym->type);
+    }
+}
+
+//*case labels are folded to the promoted type of the switch expression, as in C, so backends can order and
+//*bucket them without evaluating anything
+Internal void resolve_stmt_switch(Stmt* stmt, Type* ret_type) {
+    ResolvedExpr expr = resolve_expr_rvalue(stmt->switch_stmt.expr);
+    if (!is_integer_type(expr.type)) {
+        fatal("Switch expression must have integer type");
+    }
+    promote_operand(&expr);
+
+    std::vector<i64> vals;
+    bool has_default = false;
+    for (SwitchCase* it = stmt->switch_stmt.cases; it != stmt->switch_stmt.cases + stmt->switch_stmt.num_cases; it++) {
+        if (it->is_default) {
+            if (has_default) {
+                fatal("Switch has more than one default label");
+            }
+            has_default = true;
         }
+        for (size_t i = 0; i < it->num_exprs; i++) {
+            ResolvedExpr case_expr = resolve_expr_rvalue(it->exprs[i]);
+            if (!case_expr.is_const || !is_integer_type(case_expr.type)) {
+                fatal("Case label must be an integer constant expression");
+            }
+            convert_operand(&case_expr, expr.type);
+            Global::case_vals[it->exprs[i]->id] = case_expr.int_val;
+            vals.push_back(case_expr.int_val);
+        }
+        resolve_stmt_block(it->block, ret_type);
     }
 
-    Type* t = type_alloc(TypeKind::ARRAY);
-    t->array.base = base;
-    t->array.size = size;
-    Global::cached_array_types.push_back({base, size, t});
-    return t;
+    std::sort(vals.begin(), vals.end());
+    auto dup = std::adjacent_find(vals.begin(), vals.end());
+    if (dup != vals.end()) {
+        fatal("Duplicate case label %lld", (long long)*dup);
+    }
 }
 
-Type* type_func(Type** params, size_t num_params, Type* ret) {
-    for (CachedFuncType& it : Global::cached_func_types) {
-        if (it.num_params == num_params && it.ret == ret) {
-            bool match = true;
-            for (size_t i = 0; i < num_params; i++) {
-                if (it.params[i] != params[i]) {
-                    match = false;
-                    break;
+Internal void resolve_stmt(Stmt* stmt, Type* ret_type) {
+    switch (stmt->kind) {
+        case StmtKind::RETURN: {
+            if (stmt->expr) {
+                if (ret_type->kind == TypeKind::VOID) {
+                    fatal("Return with a value in function returning void");
                 }
+                ResolvedExpr result = pointer_decay(resolve_expected_expr(stmt->expr, ret_type));
+                convert_operand(&result, ret_type);
             }
-
-            if (match) {
-                return it.func;
+            else if (ret_type->kind != TypeKind::VOID) {
+                fatal("Empty return in function returning %s", type_to_str(ret_type).c_str());
+            }
+            break;
+        }
+        case StmtKind::BREAK:
+        case StmtKind::CONTINUE: {
+            break;
+        }
+        case StmtKind::BLOCK: {
+            resolve_stmt_block(stmt->block, ret_type);
+            break;
+        }
+        case StmtKind::IF: {
+            resolve_cond_expr(stmt->if_stmt.cond);
+            resolve_stmt_block(stmt->if_stmt.then_block, ret_type);
+            for (ElseIf* it = stmt->if_stmt.elseifs; it != stmt->if_stmt.elseifs + stmt->if_stmt.num_elseifs; it++) {
+                resolve_cond_expr(it->cond);
+                resolve_stmt_block(it->block, ret_type);
+            }
+            resolve_stmt_block(stmt->if_stmt.else_block, ret_type);
+            break;
+        }
+        case StmtKind::WHILE:
+        case StmtKind::DO_WHILE: {
+            resolve_cond_expr(stmt->while_stmt.cond);
+            resolve_stmt_block(stmt->while_stmt.block, ret_type);
+            break;
+        }
+        case StmtKind::FOR: {
+            size_t scope = sym_enter();
+            if (stmt->for_stmt.init) {
+                resolve_stmt(stmt->for_stmt.init, ret_type);
+            }
+            if (stmt->for_stmt.cond) {
+                resolve_cond_expr(stmt->for_stmt.cond);
+            }
+            if (stmt->for_stmt.next) {
+                resolve_stmt(stmt->for_stmt.next, ret_type);
+            }
+            resolve_stmt_block(stmt->for_stmt.block, ret_type);
+            sym_leave(scope);
+            break;
+        }
+        case StmtKind::SWITCH: {
+            resolve_stmt_switch(stmt, ret_type);
+            break;
+        }
+        case StmtKind::ASSIGN: {
+            resolve_stmt_assign(stmt);
+            break;
+        }
+        case StmtKind::INIT: {
+            Type* type = resolve_expr_rvalue(stmt->init.expr).type;
+            if (type->kind == TypeKind::VOID) {
+                fatal("Cannot initialize %s with a void expression", stmt->init.name);
             }
+            Global::local_decl_syms[stmt] = sym_push_var(stmt->init.name, type);
+            break;
+        }
+        case StmtKind::DECL: {
+            resolve_stmt_decl(stmt->decl);
+            break;
+        }
+        case StmtKind::EXPR: {
+            resolve_expr(stmt->expr);
+            break;
+        }
+        default: {
+            fatal("Cannot type check erroneous statement");
+            break;
         }
     }
+}
 
-    Type* t = type_alloc(TypeKind::FUNC);
-    t->func.params = (Type**)xcalloc(num_params, sizeof(Type*));
-    memcpy(t->func.params, params, num_params * sizeof(Type*));
-    t->func.num_params = num_params;
-    t->func.ret = ret;
+Internal void resolve_func_body(Sym* sym) {
+    SymState* state = &Global::body_states[sym];
+    if (*state == SymState::RESOLVED) {
+        return;
+    }
+    if (*state == SymState::RESOLVING) {
+        fatal("Cyclic dependency on the body of %s", sym->name);
+        return;
+    }
 
-    Global::cached_func_types.push_back({params, num_params, ret, t});
-    return t;
+    *state = SymState::RESOLVING;
+    Decl* decl = sym->decl;
+    StmtBlock block = materialize_func_body(decl);
+    Type* type = sym->type;
+
+    size_t scope = sym_enter();
+    for (size_t i = 0; i < decl->func.num_params; i++) {
+        Global::local_decl_syms[decl->func.params + i] = sym_push_var(decl->func.params[i].name, type->func.params[i]);
+    }
+    resolve_stmt_block(block, type->func.ret);
+    sym_leave(scope);
+    *state = SymState::RESOLVED;
 }
 
-Type* type_struct(TypeField* fields, size_t num_fields) {
-    Type* t = type_alloc(TypeKind::STRUCT);
-    t->aggregate.fields = (TypeField*)xcalloc(num_fields, sizeof(TypeField));
-    memcpy(t->aggregate.fields, fields, num_fields * sizeof(TypeField));
-    t->aggregate.num_fields = num_fields;
+void resolve_func_for_eval(Sym* sym) {
+    if (Global::body_states[sym] == SymState::RESOLVED) {
+        return;
+    }
 
-    return t;
+    bool in_const_expr = Global::in_const_expr;
+    Global::in_const_expr = false;
+    //*globals on the resolving stack stay as they are, the body fails as cyclic if it needs one of them
+    for (size_t i = 0; i < Global::syms.size(); i++) {
+        if (Global::syms[i]->state == SymState::UNRESOLVED) {
+            resolve_sym(Global::syms[i]);
+        }
+    }
+    for (size_t i = 0; i < Global::syms.size(); i++) {
+        Sym* it = Global::syms[i];
+        if (it->kind == SymKind::TYPE && it->type && it->type->kind == TypeKind::INCOMPLETE) {
+            complete_type(it->type);
+        }
+    }
+
+    //*the locals of a body being checked are hidden, the lookups of the evaluated body must only find globals
+    std::vector<std::pair<SymBinding*, Sym*>> hidden;
+    for (auto& it : Global::sym_bindings) {
+        if (live_local(&it.second)) {
+            hidden.push_back(std::make_pair(&it.second, it.second.local));
+            it.second.local = nullptr;
+        }
+    }
+    std::vector<Sym*> locals;
+    locals.swap(Global::local_syms);
+    size_t local_type_floor = Global::local_type_floor;
+    Global::local_type_floor = SIZE_MAX;
+
+    resolve_func_body(sym);
+
+    Global::local_type_floor = local_type_floor;
+    locals.swap(Global::local_syms);
+    for (std::pair<SymBinding*, Sym*>& it : hidden) {
+        it.first->local = it.second;
+    }
+    Global::in_const_expr = in_const_expr;
 }
 
-Type* type_union(TypeField* fields, size_t num_fields) {
-    Type* t = type_alloc(TypeKind::UNION);
-    t->aggregate.fields = (TypeField*)xcalloc(num_fields, sizeof(TypeField));
-    memcpy(t->aggregate.fields, fields, num_fields * sizeof(TypeField));
-    t->aggregate.num_fields = num_fields;
+void resolve_syms() {
+    //*resolving can only add local symbols, indices into the globals stay valid
+    for (size_t i = 0; i < Global::syms.size(); i++) {
+        resolve_sym(Global::syms[i]);
+    }
+}
 
-    return t;
+void resolve_package(const std::vector<Decl*>& decls) {
+    for (Decl* it : decls) {
+        if (it->name) {
+            sym_put(it);
+        }
+    }
+
+    resolve_syms();
+
+    //*every global type is complete before any body is checked, a body's locals must never leak into a struct's fields
+    for (Sym* it : Global::syms) {
+        if (it->kind == SymKind::TYPE) {
+            complete_type(it->type);
+        }
+    }
+    for (Sym* it : Global::syms) {
+        if (it->kind == SymKind::FUNC) {
+            resolve_func_body(it);
+        }
+    }
+}
+
+//*parses src, through the AST cache in cache_dir unless it is null, and resolves it as the package
+Internal bool load_package(const char* name, const char* src, const char* cache_dir) {
+    reset_syms();
+    std::vector<Decl*> decls = cache_dir ? parse_file_cached(cache_dir, name, src) : parse_file(name, src);
+    if (!Global::diagnostics.empty()) {
+        print_diagnostics();
+        return false;
+    }
+    resolve_package(decls);
+    return true;
+}
+
+bool load_package_src(const char* name, const char* src) {
+    return load_package(name, src, nullptr);
+}
+
+bool load_package_file(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        printf("cannot open %s\n", path);
+        return false;
+    }
+    std::string src;
+    char buf[4096];
+    for (size_t n = fread(buf, 1, sizeof(buf), file); n; n = fread(buf, 1, sizeof(buf), file)) {
+        src.append(buf, n);
+    }
+    fclose(file);
+    return load_package(path, src.c_str(), Global::ast_cache_dir);
+}
+
+Sym* package_main_func(const char* path) {
+    Sym* main_sym = sym_get(Global::string_table.add("main"));
+    if (!main_sym || main_sym->kind != SymKind::FUNC || main_sym->type->func.num_params) {
+        printf("%s has no func main()\n", path);
+        return nullptr;
+    }
+    return main_sym;
+}
+
+Internal Sym* resolve_test_sym(const char* name) {
+    Sym* sym = sym_get(Global::string_table.add(name));
+    assert(sym && sym->state == SymState::RESOLVED);
+    return sym;
+}
+
+//*type of the expression returned by the last statement of a function
+Internal Type* resolve_test_ret_type(const char* func) {
+    StmtBlock block = resolve_test_sym(func)->decl->func.block;
+    Stmt* stmt = block.stmts[block.num_stmts - 1];
+    assert(stmt->kind == StmtKind::RETURN);
+    return expr_type(stmt->expr);
+}
+
+Internal void resolve_scope_test() {
+    reset_syms();
+    const char* x = Global::string_table.add("x");
+    const char* y = Global::string_table.add("y");
+    sym_put(decl_var(x, typespec_name(Global::string_table.add("int")), nullptr));
+    Sym* global_x = sym_get(x);
+    assert(global_x && global_x->kind == SymKind::VAR);
+
+    size_t outer = sym_enter();
+    Sym* outer_x = sym_push_var(x, Global::type_float);
+    assert(sym_get(x) == outer_x);
+
+    size_t inner = sym_enter();
+    Sym* inner_x = sym_push_var(x, Global::type_char);
+    Sym* inner_y = sym_push_var(y, Global::type_int);
+    assert(sym_get(x) == inner_x && sym_get(y) == inner_y);
+    sym_leave(inner);
+    assert(sym_get(x) == outer_x && sym_get(y) == nullptr);
+
+    //*the popped x's slot is reused by a new y, the stale binding must not come back
+    Sym* reused_y = sym_push_var(y, Global::type_int);
+    assert(reused_y->local_index == inner_x->local_index);
+    assert(sym_get(x) == outer_x && sym_get(y) == reused_y);
+
+    sym_leave(outer);
+    assert(sym_get(x) == global_x && sym_get(y) == nullptr);
+    reset_syms();
+}
+
+//*name of a builtin type as an interned typespec
+Internal Typespec* resolve_test_typespec(const char* name) {
+    return typespec_name(Global::string_table.add(name));
+}
+
+Internal Sym* resolve_test_const(const char* name, Expr* expr) {
+    sym_put(decl_const(Global::string_table.add(name), expr));
+    resolve_syms();
+    return resolve_test_sym(name);
+}
+
+Internal Type* resolve_test_unify(Type* left, Type* right) {
+    return Global::types[arithmetic.unify[(int)left->kind][(int)right->kind]];
+}
+
+Internal void resolve_scalar_test() {
+    using namespace Global;
+    reset_syms();
+
+    //*builtin scalars are their own kinds in the type table
+    for (int kind = (int)TypeKind::VOID; kind <= (int)TypeKind::LAST_ARITHMETIC; kind++) {
+        assert(types[kind]->id == (u32)kind && types[kind]->kind == (TypeKind)kind);
+    }
+    Type* ptr = type_ptr(type_ushort);
+    assert(types[ptr->id] == ptr && ptr->id > (u32)TypeKind::LAST_ARITHMETIC);
+    assert(type_array(ptr, 3) == type_array(type_ptr(type_ushort), 3) && type_array(ptr, 3) != type_array(ptr, 4));
+    Type* params[] = { type_bool, ptr };
+    assert(type_func(params, 2, type_void) == type_func(params, 2, type_void) && type_func(params, 2, type_void) != type_func(params, 1, type_void));
+    assert(resolve_test_sym("int8")->type == type_schar && resolve_test_sym("uint64")->type == type_ullong);
+
+    //*usual arithmetic conversions
+    assert(resolve_test_unify(type_char, type_bool) == type_int && resolve_test_unify(type_ushort, type_short) == type_int);
+    assert(resolve_test_unify(type_uint, type_int) == type_uint && resolve_test_unify(type_llong, type_uint) == type_llong);
+    assert(resolve_test_unify(type_long, type_uint) == (sizeof(long) > sizeof(int) ? type_long : type_ulong));
+    assert(resolve_test_unify(type_llong, type_ulong) == (sizeof(long) == sizeof(long long) ? type_ullong : type_llong));
+    assert(resolve_test_unify(type_float, type_ullong) == type_float && resolve_test_unify(type_float, type_double) == type_double);
+
+    //*folding wraps to the operand type and follows its signedness
+    Expr* minus_one = expr_cast(resolve_test_typespec("uint"), expr_unary(TokenKind::SUB, expr_int(1)));
+    Sym* half = resolve_test_const("half", expr_binary(TokenKind::DIV, minus_one, expr_int(2)));
+    assert(half->type == type_uint && half->int_val == 0x7FFFFFFF);
+    Sym* wrapped = resolve_test_const("wrapped", expr_cast(resolve_test_typespec("char"), expr_int(300)));
+    assert(wrapped->type == type_char && wrapped->int_val == 44);
+    Sym* shifted = resolve_test_const("shifted", expr_binary(TokenKind::LSHIFT, expr_cast(resolve_test_typespec("uchar"), expr_int(1)), expr_int(9)));
+    assert(shifted->type == type_int && shifted->int_val == 512);
+    Sym* big = resolve_test_const("big", expr_int(4000000000));
+    assert(big->type->size == 8 && is_signed_type(big->type));
+    Sym* is_less = resolve_test_const("is_less", expr_binary(TokenKind::LT, expr_cast(resolve_test_typespec("uint"), expr_int(-1)), expr_int(0)));
+    assert(is_less->type == type_int && is_less->int_val == 0);
+    Sym* third = resolve_test_const("third", expr_binary(TokenKind::DIV, expr_float(1.0), expr_int(3)));
+    assert(third->type == type_float && third->float_val == (f64)(1.0f / 3.0f));
+
+    reset_syms();
+}
+
+Internal void resolve_check_test() {
+    using Global::type_int;
+    using Global::type_float;
+
+    const char* src =
+        "const n = 1 + sizeof(p)\n"
+        "var p: Vector*\n"
+        "struct Vector { x, y: float; }\n"
+        "var a: int[n]\n"
+        "const pi = 3.5 * 2\n"
+        "const mask = 1 << 4 | 3\n"
+        "const neg = -(n - 10) * 2 ? 7 : 8\n"
+        "func len2(v: Vector*): float { return v.x * v.x + v.y * v.y; }\n"
+        "func fact(n: int): int { p := 1; for (i := 1; i <= n; i++) { p *= i; } return p; }\n"
+        "struct Node { value: int; next: Node*; }\n"
+        "func sum(list: Node*): int { s := 0; for (it := list; it; it = it.next) { s += it.value; } return s; }\n"
+        "union IntOrFloat { i: int; f: float; c: char; }\n"
+        "var u: IntOrFloat = {42}\n"
+        "var v: Vector = {1.0, 2}\n"
+        "func idx(xs: int*, i: int): int { return xs[i] + a[i]; }\n"
+        "func mixed(i: int): float { f := i * 2.0; return i < 0 ? f : 1; }\n"
+        "func addr(): Vector* { return &v; }\n"
+        "func arr(): int { xs := (:int[]){1, 2, 3}; return sizeof(xs) + xs[0]; }\n"
+        "enum Color { RED, GREEN }\n"
+        "func shadow(a: float): float { { a := 1; a++; } return a; }\n"
+        "func local(): int { struct Pair { a, b: int; } var q: Pair = {1, 2} return q.b; }\n"
+        "func noret(c: Color) { if (c == GREEN) { return; } noret(RED); }\n"
+        "typedef Callback = func(int): float\n"
+        "func call(cb: Callback): float { return cb(1) + len2(&v); }\n"
+        "var primes: int[3] = {2, 3, 5}\n"
+        "struct Grid { n: int; cells: float[2]; }\n"
+        "var grid: Grid = {1, {2, 3.5}}\n"
+        "func cells(): int { var xs: int[2] = {1, 2} var gs: Grid[2] = {{1}, {2, {3, 4}}} return xs[1] + gs[1].n; }\n";
+
+    assert(load_package_src("resolve_test.sorin", src));
+
+    Type* vector = resolve_test_sym("Vector")->type;
+    assert(vector->kind == TypeKind::STRUCT && vector->size == 8 && vector->align == 4);
+    assert(vector->aggregate.fields[1].offset == 4);
+
+    Sym* n = resolve_test_sym("n");
+    assert(n->kind == SymKind::CONST && n->type == Global::type_usize && n->int_val == 1 + (i64)sizeof(void*));
+    assert(resolve_test_sym("a")->type == type_array(type_int, (size_t)n->int_val));
+    assert(resolve_test_sym("pi")->type == type_float && resolve_test_sym("pi")->float_val == 7.0);
+    assert(resolve_test_sym("mask")->int_val == 19);
+    assert(resolve_test_sym("neg")->int_val == 7);
+
+    Type* node = resolve_test_sym("Node")->type;
+    assert(node->kind == TypeKind::STRUCT && node->size == 2 * sizeof(void*));
+    assert(node->aggregate.fields[1].type == type_ptr(node));
+
+    Type* int_or_float = resolve_test_sym("IntOrFloat")->type;
+    assert(int_or_float->kind == TypeKind::UNION && int_or_float->size == 4 && int_or_float->aggregate.fields[2].offset == 0);
+
+    assert(resolve_test_ret_type("len2") == type_float);
+    assert(resolve_test_ret_type("fact") == type_int);
+    assert(resolve_test_ret_type("sum") == type_int);
+    assert(resolve_test_ret_type("idx") == type_int);
+    assert(resolve_test_ret_type("mixed") == type_float);
+    assert(resolve_test_ret_type("addr") == type_ptr(vector));
+    assert(resolve_test_ret_type("arr") == Global::type_usize);
+    assert(resolve_test_ret_type("shadow") == type_float);
+    assert(resolve_test_ret_type("local") == type_int);
+    assert(resolve_test_ret_type("call") == type_float);
+    assert(resolve_test_sym("noret")->type->func.ret == Global::type_void);
+
+    //*array initializers, also nested in struct and array initializers, do not decay to pointers
+    assert(resolve_test_sym("primes")->type == type_array(type_int, 3));
+    Type* grid = resolve_test_sym("grid")->type;
+    assert(grid->kind == TypeKind::STRUCT && grid->aggregate.fields[1].type == type_array(type_float, 2));
+    assert(resolve_test_ret_type("cells") == type_int);
+
+    //*the returned p in fact is the local from p := 1, not the global Vector*
+    StmtBlock fact = resolve_test_sym("fact")->decl->func.block;
+    Sym* p = expr_sym(fact.stmts[fact.num_stmts - 1]->expr);
+    assert(p && p->kind == SymKind::VAR && p->type == type_int && p != resolve_test_sym("p"));
+
+    //*the inner block's a is an int, the returned a is the float parameter
+    StmtBlock shadow = resolve_test_sym("shadow")->decl->func.block;
+    assert(expr_type(shadow.stmts[0]->block.stmts[1]->assign.left) == type_int);
+
+    //*unsized array literals take their length from the initializer
+    StmtBlock arr = resolve_test_sym("arr")->decl->func.block;
+    assert(expr_type(arr.stmts[0]->init.expr) == type_array(type_int, 3));
+    assert(expr_type(arr.stmts[1]->expr->binary.left) == Global::type_usize);
+
+    //*casts only come from the AST constructors for now
+    Expr* cast = expr_cast(typespec_ptr(typespec_name(Global::string_table.add("char"))), expr_name(Global::string_table.add("p")));
+    Decl* cast_decl = decl_var(Global::string_table.add("cast_test"), nullptr, cast);
+    sym_put(cast_decl);
+    resolve_syms();
+    assert(resolve_test_sym("cast_test")->type == type_ptr(Global::type_char));
+    assert(expr_type(cast->cast.expr) == type_ptr(vector));
+
+    reset_syms();
+}
+
+Internal void resolve_typespec_test() {
+    const char* src =
+        "struct Vector { x, y: float; }\n"
+        "var a: Vector*\n"
+        "var b: Vector*\n"
+        "var m: int[N]\n"
+        "const N = 4\n"
+        "func hidden(): int { struct Vector { z: int; } var c: Vector* = 0 return c.z; }\n"
+        "func visible(): float { var d: Vector* = &a[0] return d.x; }\n";
+
+    assert(load_package_src("typespec_test.sorin", src));
+
+    //*b's spelling is found through a's, one entry per spelling
+    Type* vector_ptr = type_ptr(resolve_test_sym("Vector")->type);
+    Typespec* a = resolve_test_sym("a")->decl->var.type;
+    Typespec* b = resolve_test_sym("b")->decl->var.type;
+    assert(a->hash == b->hash && a->id != b->id);
+    assert(Global::typespec_types[a->id] == vector_ptr->id && Global::typespec_types[b->id] == vector_ptr->id);
+    assert(Global::typespec_spellings.count(a->hash) == 1);
+
+    //*a named array size is memoized per node only
+    Typespec* m = resolve_test_sym("m")->decl->var.type;
+    assert(m->hash == 0 && Global::types[Global::typespec_types[m->id]] == type_array(Global::type_int, 4));
+
+    //*the local Vector* is not the global one, and it did not leak into the next function
+    StmtBlock hidden = resolve_test_sym("hidden")->decl->func.block;
+    Typespec* c = hidden.stmts[1]->decl->var.type;
+    assert(c->hash == a->hash && Global::typespec_types[c->id] != vector_ptr->id);
+    assert(resolve_test_ret_type("hidden") == Global::type_int);
+    StmtBlock visible = resolve_test_sym("visible")->decl->func.block;
+    assert(Global::typespec_types[visible.stmts[0]->decl->var.type->id] == vector_ptr->id);
+    assert(resolve_test_ret_type("visible") == Global::type_float);
+
+    reset_syms();
+    assert(Global::typespec_spellings.empty() && Global::typespec_types[a->id] == 0);
 }
 
 void resolve_test() {
     using Global::type_int;
     using Global::type_float;
 
+    reset_syms();
     const char* foo = Global::string_table.add("foo");
     assert(sym_get(foo) == nullptr);
     Decl* decl = decl_const(foo, expr_int(42));
@@ -163,4 +2175,9 @@ void resolve_test() {
     Type* int_func = type_func(NULL, 0, type_int);
     assert(int_int_func != int_func);
     assert(int_func == type_func(NULL, 0, type_int));
+
+    resolve_scope_test();
+    resolve_scalar_test();
+    resolve_check_test();
+    resolve_typespec_test();
 }
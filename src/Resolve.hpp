@@ -1,14 +1,34 @@
 #pragma once
+#include <string>
+#include <vector>
 #include "Ast.hpp"
 #include <types.hpp>
 
-// enum class EntityKind {
-
-// };
-
+//*the scalar kinds double as the ids of their builtin types, see Global::types
 enum class TypeKind {
+    NONE,
+    INCOMPLETE,
+    COMPLETING,
+    VOID,
+    //*arithmetic types, integers ordered by conversion rank with each unsigned right after its signed twin
+    FIRST_ARITHMETIC,
+    BOOL = FIRST_ARITHMETIC,
+    FIRST_INTEGER = BOOL,
+    CHAR,
+    SCHAR,
+    UCHAR,
+    SHORT,
+    USHORT,
     INT,
+    UINT,
+    LONG,
+    ULONG,
+    LLONG,
+    ULLONG,
+    LAST_INTEGER = ULLONG,
     FLOAT,
+    DOUBLE,
+    LAST_ARITHMETIC = DOUBLE,
     PTR,
     ARRAY,
     STRUCT,
@@ -17,14 +37,20 @@ enum class TypeKind {
 };
 
 struct Type;
+struct Sym;
 
 struct TypeField {
     const char* name;
     Type* type;
+    size_t offset;
 };
 
 struct Type {
     TypeKind kind;
+    u32 id; //*index in Global::types
+    size_t size;
+    size_t align;
+    Sym* sym; //*declaring symbol of a named struct or union, null for everything else
     union {
         struct {
             Type* base;
@@ -47,43 +73,50 @@ struct Type {
 
 Type* type_alloc(TypeKind kind);
 
-struct CachedPtrType {
-    Type* base;
-    Type* ptr;
-};
-
 Type* type_ptr(Type* base);
 
-struct CachedArrayType {
-    Type* base;
-    size_t size;
-    Type* array;
-};
-
 Type* type_array(Type* base, size_t size);
 
-struct CachedFuncType {
-    Type** params;
-    size_t num_params;
-    Type* ret;
-    Type* func;
-};
-
+//*func types are values the size of a pointer, like C function pointers
 Type* type_func(Type** params, size_t num_params, Type* ret);
 
+Type* type_incomplete(Sym* sym);
+void type_complete_struct(Type* type, TypeField* fields, size_t num_fields);
+void type_complete_union(Type* type, TypeField* fields, size_t num_fields);
+
 Type* type_struct(TypeField* fields, size_t num_fields);
 Type* type_union(TypeField* fields, size_t num_fields);
 
-struct ConstEntity {
+std::string type_to_str(Type* type);
+
+bool is_integer_type(Type* type);
+bool is_floating_type(Type* type);
+bool is_arithmetic_type(Type* type);
+bool is_signed_type(Type* type);
+
+//*C's integer promotion of an arithmetic type
+Type* type_promote(Type* type);
+//*C's usual arithmetic conversions of two arithmetic types
+Type* type_unify(Type* left, Type* right);
+
+//*result of checking an expression, only the type outlives the check, it is stored in Global::expr_types
+struct ResolvedExpr {
     Type* type;
+    bool is_lvalue;
+    bool is_const;
     union {
-        u64 int_val;
-        double float_val;
+        i64 int_val;
+        f64 float_val;
     };
 };
 
-struct Entity {
-    int foo;
+enum class SymKind {
+    NONE,
+    VAR,
+    CONST,
+    FUNC,
+    TYPE,
+    ENUM_CONST,
 };
 
 enum class SymState {
@@ -94,15 +127,70 @@ enum class SymState {
 
 struct Sym {
     const char* name;
-    Decl* decl;
+    SymKind kind;
     SymState state;
-    Entity* ent;
+    Decl* decl;
+    Type* type;
+    union {
+        i64 int_val;
+        f64 float_val;
+    };
+    u32 local_index; //*slot in Global::local_syms, locals only
+    Sym* shadowed; //*binding of the same name this local hides, locals only
+    EnumItem* enum_item; //*item an enum constant is declared by, enum constants only
+};
+
+//*everything bound to one interned name: its global, and its innermost local which may already be out of scope
+struct SymBinding {
+    Sym* global;
+    Sym* local;
 };
 
 Sym* sym_get(const char* name);
 
 void sym_put(Decl* decl);
 
+void sym_put_type(const char* name, Type* type);
+
+//*drops every global and local symbol and re-enters the builtin types
+void reset_syms();
+
 void resolve_syms();
 
-void resolve_test();
\ No newline at end of file
+//*enters the decls as globals, resolves them in dependency order, then completes every type and checks every function body
+void resolve_package(const std::vector<Decl*>& decls);
+
+//*parses and resolves src as the package, the one loader of the driver modes and the tests. false after printing the
+//*diagnostics
+bool load_package_src(const char* name, const char* src);
+//*reads the file and loads it like load_package_src, parsed through the AST cache in Global::ast_cache_dir. false after
+//*printing why not
+bool load_package_file(const char* path);
+
+//*the package's func main() without params, null after printing that path has none
+Sym* package_main_func(const char* path);
+
+//*checks the body of a func ahead of the other bodies so a constant expression can run it, after resolving every global
+//*and completing every global type
+void resolve_func_for_eval(Sym* sym);
+
+//*dense side tables indexed by Expr::id, filled while checking. types are stored by id, expr_type maps back
+Type* expr_type(Expr* expr);
+Sym* expr_sym(Expr* expr);
+//*type a typespec resolved to, null before it is resolved
+Type* typespec_type(Typespec* type);
+
+//*constant folding as the resolver does it, for the optimizer. the operands are constants of one arithmetic type, except
+//*for shifts whose sides are only promoted. false for an integer division by zero, which is left to run time
+bool fold_binary(TokenKind op, ResolvedExpr left, ResolvedExpr right, ResolvedExpr* result);
+//*an arithmetic constant converted to another arithmetic type like a cast
+ResolvedExpr fold_convert(ResolvedExpr operand, Type* type);
+
+//*symbol a local declaration in a checked body declared: the FuncParam of a parameter, the Stmt of an x := e,
+//*or the Decl of a local declaration. null for anything else
+Sym* local_decl_sym(const void* node);
+
+//*value of a case label, converted to the promoted type of its switch expression
+i64 case_val(Expr* expr);
+
+void resolve_test();
@@ -0,0 +1,2017 @@
+#include <cassert>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include "Riscv.hpp"
+#include "RegAlloc.hpp"
+#include "Vm.hpp"
+#include "Globals.hpp"
+#include "Parse.hpp"
+
+enum RvReg : u8 {
+    RV_ZERO = 0,
+    RV_RA = 1,
+    RV_SP = 2,
+    RV_T0 = 5,
+    RV_T1 = 6,
+    RV_T2 = 7,
+    RV_FP = 8,
+    RV_A0 = 10,
+    RV_A1 = 11,
+    RV_A7 = 17,
+    RV_T3 = 28,
+    RV_T4 = 29,
+    RV_T5 = 30,
+    RV_T6 = 31,
+};
+
+//*float registers
+enum RvFreg : u8 {
+    RV_FT0 = 0,
+    RV_FT1 = 1,
+    RV_FA0 = 10,
+};
+
+//*major opcodes
+enum RvOpcode : u8 {
+    RV_LOAD = 0x03,
+    RV_LOAD_FP = 0x07,
+    RV_OP_IMM = 0x13,
+    RV_AUIPC = 0x17,
+    RV_OP_IMM_32 = 0x1B,
+    RV_STORE = 0x23,
+    RV_STORE_FP = 0x27,
+    RV_OP = 0x33,
+    RV_LUI = 0x37,
+    RV_OP_32 = 0x3B,
+    RV_OP_FP = 0x53,
+    RV_BRANCH = 0x63,
+    RV_JALR = 0x67,
+    RV_JAL = 0x6F,
+    RV_SYSTEM = 0x73,
+};
+
+//*funct5 of the OP_FP instructions, funct7 is funct5 << 2 | fmt
+enum RvFpOp : u8 {
+    RV_FADD = 0x00,
+    RV_FSUB = 0x01,
+    RV_FMUL = 0x02,
+    RV_FDIV = 0x03,
+    RV_FSGNJ = 0x04,
+    RV_FMINMAX = 0x05,
+    RV_FCVT_FF = 0x08,
+    RV_FSQRT = 0x0B,
+    RV_FCMP = 0x14,
+    RV_FCVT_IF = 0x18, //*to an integer
+    RV_FCVT_FI = 0x1A, //*from an integer
+    RV_FMV_XF = 0x1C,
+    RV_FMV_FX = 0x1E,
+};
+
+//*the registers values get: the saved registers s1..s11 and fs0..fs11, and the argument registers and the float
+//*temporaries past ft0 and ft1, which a value live across a call never takes. t0..t6, ft0 and ft1 are the scratch
+//*registers of the instructions
+GlobalVariable const RaReg rv_int_regs[] = {
+    { 9, true }, { 18, true }, { 19, true }, { 20, true }, { 21, true }, { 22, true }, { 23, true }, { 24, true }, { 25, true }, { 26, true },
+    { 27, true }, { 10, false }, { 11, false }, { 12, false }, { 13, false }, { 14, false }, { 15, false }, { 16, false }, { 17, false },
+};
+GlobalVariable const RaReg rv_float_regs[] = {
+    { 8, true }, { 9, true }, { 18, true }, { 19, true }, { 20, true }, { 21, true }, { 22, true }, { 23, true }, { 24, true }, { 25, true },
+    { 26, true }, { 27, true }, { 2, false }, { 3, false }, { 4, false }, { 5, false }, { 6, false }, { 7, false }, { 28, false }, { 29, false },
+    { 30, false }, { 31, false }, { 10, false }, { 11, false }, { 12, false }, { 13, false }, { 14, false }, { 15, false }, { 16, false }, { 17, false },
+};
+GlobalVariable const RaTarget rv_ra_target = { "rv64", { rv_int_regs, rv_float_regs }, { 19, 30 } };
+
+Internal constexpr u32 RV_NUM_ARG_REGS = 8;
+Internal constexpr u32 RV_RM_RTZ = 1;
+Internal constexpr u32 RV_RM_DYN = 7;
+Internal constexpr u32 RV_ECALL_EXIT = 93;
+Internal constexpr u32 RV_STACK_BYTES = MEGABYTE(1);
+//*copies and clears longer than this run in a loop
+Internal constexpr u32 RV_INLINE_COPY_BYTES = 64;
+
+struct RvFixup {
+    u32 pos; //*of a jal, in words
+    u32 label;
+};
+
+enum class RvTarget : u8 {
+    FUNC,
+    STRING,
+    GLOBAL,
+};
+
+//*an auipc and the I-type instruction after it, patched to the address of a func, string or global var
+struct RvReloc {
+    u32 pos; //*of the auipc, in words
+    RvTarget target;
+    Sym* sym;
+    u32 offset; //*of a string in the strings
+};
+
+struct RvEdge {
+    u32 pred;
+    u32 succ;
+    u32 label;
+};
+
+//*where an argument goes, an aggregate is the address of its copy
+struct RvArg {
+    bool in_freg;
+    u8 reg;
+    bool on_stack;
+    u32 stack_offset; //*from the stack pointer at the call
+};
+
+GlobalVariable std::vector<u32> rv_code;
+GlobalVariable std::vector<RvReloc> rv_relocs;
+GlobalVariable std::vector<char> rv_strings;
+GlobalVariable std::unordered_map<const char*, u32> rv_string_offsets;
+GlobalVariable IrFunc* rv_ir;
+//*offsets from the frame pointer
+GlobalVariable std::vector<i32> rv_slots;
+GlobalVariable std::vector<i32> rv_copies;
+GlobalVariable std::vector<i32> rv_in_slots;
+GlobalVariable std::vector<i32> rv_arg_copies; //*per call operand, the copy an aggregate argument points to
+GlobalVariable i32 rv_ret_slot;
+GlobalVariable u32 rv_frame_bytes;
+GlobalVariable u32 rv_out_bytes;
+GlobalVariable std::vector<u32> rv_labels; //*word of each block, then of each edge
+GlobalVariable std::vector<RvFixup> rv_fixups;
+GlobalVariable std::vector<RvEdge> rv_edges;
+GlobalVariable const RaTarget* rv_target = &rv_ra_target; //*the tests swap in fewer registers
+GlobalVariable RaFunc rv_ra;
+GlobalVariable u32 rv_pos; //*of the instruction being compiled, see RaFunc
+GlobalVariable std::vector<i32> rv_saved_slots[(int)RaClass::SIZE_OF_ENUM]; //*of the callee saved registers in rv_ra.saved
+
+Internal Type* rv_type(IrValue value) {
+    return Global::types[rv_ir->insts[value].type];
+}
+
+Internal bool rv_is_aggregate(Type* type) {
+    return type->kind == TypeKind::STRUCT || type->kind == TypeKind::UNION;
+}
+
+Internal bool rv_fits12(i64 val) {
+    return val >= -2048 && val < 2048;
+}
+
+//*encoding
+
+u32 rv_encode_i(u32 opcode, u32 funct3, u32 rd, u32 rs1, i32 imm) {
+    return ((u32)imm & 0xFFF) << 20 | rs1 << 15 | funct3 << 12 | rd << 7 | opcode;
+}
+
+u32 rv_encode_r(u32 opcode, u32 funct3, u32 funct7, u32 rd, u32 rs1, u32 rs2) {
+    return funct7 << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12 | rd << 7 | opcode;
+}
+
+u32 rv_encode_s(u32 opcode, u32 funct3, u32 rs1, u32 rs2, i32 imm) {
+    u32 bits = (u32)imm;
+    return ((bits >> 5) & 0x7F) << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12 | (bits & 0x1F) << 7 | opcode;
+}
+
+u32 rv_encode_b(u32 funct3, u32 rs1, u32 rs2, i32 offset) {
+    u32 bits = (u32)offset;
+    return ((bits >> 12) & 1) << 31 | ((bits >> 5) & 0x3F) << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12
+        | ((bits >> 1) & 0xF) << 8 | ((bits >> 11) & 1) << 7 | RV_BRANCH;
+}
+
+u32 rv_encode_u(u32 opcode, u32 rd, i32 imm) {
+    return ((u32)imm & 0xFFFFF000) | rd << 7 | opcode;
+}
+
+u32 rv_encode_j(u32 rd, i32 offset) {
+    u32 bits = (u32)offset;
+    return ((bits >> 20) & 1) << 31 | ((bits >> 1) & 0x3FF) << 21 | ((bits >> 11) & 1) << 20 | ((bits >> 12) & 0xFF) << 12
+        | rd << 7 | RV_JAL;
+}
+
+Internal void rv_emit(u32 inst) {
+    rv_code.push_back(inst);
+}
+
+Internal void rv_op_imm(u32 funct3, u32 rd, u32 rs1, i32 imm) {
+    rv_emit(rv_encode_i(RV_OP_IMM, funct3, rd, rs1, imm));
+}
+
+Internal void rv_op(u32 funct3, u32 funct7, u32 rd, u32 rs1, u32 rs2) {
+    rv_emit(rv_encode_r(RV_OP, funct3, funct7, rd, rs1, rs2));
+}
+
+Internal void rv_addi(u32 rd, u32 rs1, i32 imm) {
+    rv_op_imm(0, rd, rs1, imm);
+}
+
+Internal void rv_mv(u32 rd, u32 rs1) {
+    rv_addi(rd, rs1, 0);
+}
+
+Internal void rv_add(u32 rd, u32 rs1, u32 rs2) {
+    rv_op(0, 0, rd, rs1, rs2);
+}
+
+Internal void rv_slli(u32 rd, u32 rs1, u32 shamt) {
+    rv_op_imm(1, rd, rs1, (i32)shamt);
+}
+
+Internal void rv_srli(u32 rd, u32 rs1, u32 shamt) {
+    rv_op_imm(5, rd, rs1, (i32)shamt);
+}
+
+Internal void rv_srai(u32 rd, u32 rs1, u32 shamt) {
+    rv_op_imm(5, rd, rs1, (i32)(0x400 | shamt));
+}
+
+//*loads any constant, in at most eight instructions
+Internal void rv_li(u32 rd, i64 val) {
+    if (rv_fits12(val)) {
+        rv_addi(rd, RV_ZERO, (i32)val);
+        return;
+    }
+    i64 lo = (i64)((u64)val << 52) >> 52;
+    if (val >= INT32_MIN && val <= INT32_MAX) {
+        //*addiw wraps in 32 bits, which undoes lui's sign extension when val is just below 2^31
+        rv_emit(rv_encode_u(RV_LUI, rd, (i32)(u32)((u64)val - (u64)lo)));
+        if (lo) {
+            rv_emit(rv_encode_i(RV_OP_IMM_32, 0, rd, rd, (i32)lo));
+        }
+        return;
+    }
+    i64 hi = (i64)((u64)val - (u64)lo) >> 12;
+    u32 shift = 12;
+    while ((hi & 1) == 0) {
+        hi >>= 1;
+        shift++;
+    }
+    rv_li(rd, hi);
+    rv_slli(rd, rd, shift);
+    if (lo) {
+        rv_addi(rd, rd, (i32)lo);
+    }
+}
+
+//*rd = rs1 + imm for any imm, through t6 when it is out of range
+Internal void rv_add_imm(u32 rd, u32 rs1, i64 imm) {
+    if (rv_fits12(imm)) {
+        rv_addi(rd, rs1, (i32)imm);
+        return;
+    }
+    rv_li(RV_T6, imm);
+    rv_add(rd, rs1, RV_T6);
+}
+
+//*the base register of an access at base + disp, t6 when disp needs more than 12 bits
+Internal u32 rv_addr(u32 base, i32* disp) {
+    if (rv_fits12(*disp)) {
+        return base;
+    }
+    rv_add_imm(RV_T6, base, *disp);
+    *disp = 0;
+    return RV_T6;
+}
+
+//*funct3 of a load of size bytes, lb lh lw ld and lbu lhu lwu
+Internal void rv_load_bytes(u32 rd, u32 size, bool is_signed, u32 base, i32 disp) {
+    u32 funct3 = size == 1 ? 0 : size == 2 ? 1 : size == 4 ? 2 : 3;
+    if (!is_signed && size < 8) {
+        funct3 += 4;
+    }
+    base = rv_addr(base, &disp);
+    rv_emit(rv_encode_i(RV_LOAD, funct3, rd, base, disp));
+}
+
+Internal void rv_store_bytes(u32 base, i32 disp, u32 rs, u32 size) {
+    u32 funct3 = size == 1 ? 0 : size == 2 ? 1 : size == 4 ? 2 : 3;
+    base = rv_addr(base, &disp);
+    rv_emit(rv_encode_s(RV_STORE, funct3, base, rs, disp));
+}
+
+Internal void rv_ld(u32 rd, u32 base, i32 disp) {
+    rv_load_bytes(rd, 8, true, base, disp);
+}
+
+Internal void rv_sd(u32 base, i32 disp, u32 rs) {
+    rv_store_bytes(base, disp, rs, 8);
+}
+
+//*loads a scalar extended like a slot holds it, floats as their bits
+Internal void rv_load(u32 rd, Type* type, u32 base, i32 disp) {
+    u32 size = (u32)type->size;
+    rv_load_bytes(rd, size ? size : 8, is_signed_type(type) || size == 8, base, disp);
+}
+
+//*fmt of the float instructions, 0 for float and 1 for double
+Internal u32 rv_fmt(Type* type) {
+    return type->kind == TypeKind::FLOAT ? 0 : 1;
+}
+
+Internal void rv_fload(Type* type, u32 rd, u32 base, i32 disp) {
+    base = rv_addr(base, &disp);
+    rv_emit(rv_encode_i(RV_LOAD_FP, 2 + rv_fmt(type), rd, base, disp));
+}
+
+Internal void rv_fstore(Type* type, u32 base, i32 disp, u32 rs) {
+    base = rv_addr(base, &disp);
+    rv_emit(rv_encode_s(RV_STORE_FP, 2 + rv_fmt(type), base, rs, disp));
+}
+
+Internal void rv_fp_op(u32 funct5, Type* type, u32 funct3, u32 rd, u32 rs1, u32 rs2) {
+    rv_emit(rv_encode_r(RV_OP_FP, funct3, funct5 << 2 | rv_fmt(type), rd, rs1, rs2));
+}
+
+//*extends the low bytes of a register to 64 bits like a slot of type holds them
+Internal void rv_extend(u32 reg, Type* type) {
+    if (!is_integer_type(type) || type->size == 8) {
+        return;
+    }
+    u32 shift = 64 - (u32)type->size * 8;
+    if (is_signed_type(type) && type->size == 4) {
+        rv_emit(rv_encode_i(RV_OP_IMM_32, 0, reg, reg, 0));
+    }
+    else if (is_signed_type(type)) {
+        rv_slli(reg, reg, shift);
+        rv_srai(reg, reg, shift);
+    }
+    else if (type->size == 1) {
+        rv_op_imm(7, reg, reg, 0xFF);
+    }
+    else {
+        rv_slli(reg, reg, shift);
+        rv_srli(reg, reg, shift);
+    }
+}
+
+Internal void rv_jal(u32 label) {
+    rv_fixups.push_back({ (u32)rv_code.size(), label });
+    rv_emit(0);
+}
+
+//*auipc and an I-type instruction on its result, patched once the image is laid out
+Internal void rv_reloc(RvTarget target, Sym* sym, u32 offset, u32 rd, u32 opcode) {
+    rv_relocs.push_back({ (u32)rv_code.size(), target, sym, offset });
+    rv_emit(rv_encode_u(RV_AUIPC, rd, 0));
+    rv_emit(rv_encode_i(opcode, 0, rd, rd, 0));
+}
+
+//*copies between the addresses in two base registers other than t0 and t3..t6, in pieces of the alignment
+Internal void rv_copy(u32 dest, i32 dest_disp, u32 src, i32 src_disp, u32 size, u32 align) {
+    u32 piece = align >= 8 ? 8 : align ? align : 1;
+    if (size <= RV_INLINE_COPY_BYTES) {
+        for (u32 done = 0; done < size; done += piece) {
+            rv_load_bytes(RV_T0, piece, false, src, src_disp + (i32)done);
+            rv_store_bytes(dest, dest_disp + (i32)done, RV_T0, piece);
+        }
+        return;
+    }
+    rv_add_imm(RV_T3, dest, dest_disp);
+    rv_add_imm(RV_T4, src, src_disp);
+    rv_li(RV_T5, size / piece);
+    rv_load_bytes(RV_T0, piece, false, RV_T4, 0);
+    rv_store_bytes(RV_T3, 0, RV_T0, piece);
+    rv_addi(RV_T3, RV_T3, (i32)piece);
+    rv_addi(RV_T4, RV_T4, (i32)piece);
+    rv_addi(RV_T5, RV_T5, -1);
+    rv_emit(rv_encode_b(1, RV_T5, RV_ZERO, -20));
+}
+
+Internal void rv_zero(u32 base, i32 disp, u32 size, u32 align) {
+    u32 piece = align >= 8 ? 8 : align ? align : 1;
+    while (size % piece) {
+        piece /= 2;
+    }
+    if (size <= RV_INLINE_COPY_BYTES) {
+        for (u32 done = 0; done < size; done += piece) {
+            rv_store_bytes(base, disp + (i32)done, RV_ZERO, piece);
+        }
+        return;
+    }
+    rv_add_imm(RV_T3, base, disp);
+    rv_li(RV_T5, size / piece);
+    rv_store_bytes(RV_T3, 0, RV_ZERO, piece);
+    rv_addi(RV_T3, RV_T3, (i32)piece);
+    rv_addi(RV_T5, RV_T5, -1);
+    rv_emit(rv_encode_b(1, RV_T5, RV_ZERO, -12));
+}
+
+//*slots
+
+//*a value is in the register the allocator gave it at the current position or in its slot, a float or double in a
+//*float register moves to and from integer registers as its bits
+Internal bool rv_is_freg_value(IrValue value) {
+    return ra_class(rv_type(value)) == RaClass::FLOAT;
+}
+
+Internal void rv_get(u32 reg, IrValue value) {
+    i32 at = ra_reg_at(&rv_ra, value, rv_pos);
+    if (at < 0) {
+        rv_ld(reg, RV_FP, rv_slots[value]);
+    }
+    else if (rv_is_freg_value(value)) {
+        rv_fp_op(RV_FMV_XF, rv_type(value), 0, reg, (u32)at, 0);
+    }
+    else if ((u32)at != reg) {
+        rv_mv(reg, (u32)at);
+    }
+}
+
+Internal void rv_set(IrValue value, u32 reg) {
+    i32 at = ra_def_reg(&rv_ra, value);
+    if (at >= 0 && rv_is_freg_value(value)) {
+        rv_fp_op(RV_FMV_FX, rv_type(value), 0, (u32)at, reg, 0);
+    }
+    else if (at >= 0 && (u32)at != reg) {
+        rv_mv((u32)at, reg);
+    }
+    if (at < 0 || rv_ra.in_slot[value]) {
+        rv_sd(RV_FP, rv_slots[value], reg);
+    }
+}
+
+//*the register of an integer value the instruction only reads, or scratch loaded with it
+Internal u32 rv_use(u32 scratch, IrValue value) {
+    i32 at = ra_reg_at(&rv_ra, value, rv_pos);
+    if (at >= 0 && !rv_is_freg_value(value)) {
+        return (u32)at;
+    }
+    rv_get(scratch, value);
+    return scratch;
+}
+
+//*the register the instruction computes an integer value in, its own or scratch, rv_set then keeps it
+Internal u32 rv_dest(IrValue value, u32 scratch) {
+    i32 at = ra_def_reg(&rv_ra, value);
+    return at >= 0 && !rv_is_freg_value(value) ? (u32)at : scratch;
+}
+
+//*the same for float values and float registers
+Internal void rv_fget(Type* type, u32 freg, IrValue value) {
+    i32 at = ra_reg_at(&rv_ra, value, rv_pos);
+    if (at < 0) {
+        rv_fload(type, freg, RV_FP, rv_slots[value]);
+    }
+    else if ((u32)at != freg) {
+        rv_fp_op(RV_FSGNJ, type, 0, freg, (u32)at, (u32)at);
+    }
+}
+
+Internal void rv_fset(Type* type, IrValue value, u32 freg) {
+    i32 at = ra_def_reg(&rv_ra, value);
+    if (at >= 0 && (u32)at != freg) {
+        rv_fp_op(RV_FSGNJ, type, 0, (u32)at, freg, freg);
+    }
+    if (at < 0 || rv_ra.in_slot[value]) {
+        rv_fstore(type, RV_FP, rv_slots[value], freg);
+    }
+}
+
+Internal u32 rv_fuse(Type* type, u32 scratch, IrValue value) {
+    i32 at = ra_reg_at(&rv_ra, value, rv_pos);
+    if (at >= 0) {
+        return (u32)at;
+    }
+    rv_fload(type, scratch, RV_FP, rv_slots[value]);
+    return scratch;
+}
+
+Internal u32 rv_fdest(IrValue value, u32 scratch) {
+    i32 at = ra_def_reg(&rv_ra, value);
+    return at >= 0 ? (u32)at : scratch;
+}
+
+//*loads the register a value takes at a reload, or a param's at its definition, from the slot
+Internal void rv_load_reg(IrValue value, u32 reg) {
+    if (rv_is_freg_value(value)) {
+        rv_fload(rv_type(value), reg, RV_FP, rv_slots[value]);
+    }
+    else {
+        rv_ld(reg, RV_FP, rv_slots[value]);
+    }
+}
+
+Internal i32 rv_alloc(u32 size, u32 align) {
+    align = align < 8 ? 8 : align;
+    rv_frame_bytes = (rv_frame_bytes + size + align - 1) / align * align;
+    return -(i32)rv_frame_bytes;
+}
+
+Internal i32 rv_alloc_type(Type* type) {
+    return rv_alloc((u32)type->size, (u32)type->align);
+}
+
+//*places the arguments after the hidden pointer to an aggregate result, returns the bytes of stack arguments
+Internal u32 rv_place_args(Type** types, size_t num_types, bool hidden_ret, std::vector<RvArg>* args) {
+    args->assign(num_types, RvArg{});
+    u32 ints = hidden_ret ? 1 : 0;
+    u32 floats = 0;
+    u32 stack = 0;
+    for (size_t i = 0; i < num_types; i++) {
+        RvArg* arg = &(*args)[i];
+        //*floats go in integer registers once the float registers run out
+        if (is_floating_type(types[i]) && floats < RV_NUM_ARG_REGS) {
+            arg->in_freg = true;
+            arg->reg = (u8)(RV_FA0 + floats++);
+        }
+        else if (ints < RV_NUM_ARG_REGS) {
+            arg->reg = (u8)(RV_A0 + ints++);
+        }
+        else {
+            arg->on_stack = true;
+            arg->stack_offset = stack;
+            stack += 8;
+        }
+    }
+    return (stack + 15) / 16 * 16;
+}
+
+Internal void rv_arg_types(IrInst* inst, std::vector<Type*>* types) {
+    types->clear();
+    for (u32 i = 0; i < inst->operands.count; i++) {
+        types->push_back(rv_type(rv_ir->operands[inst->operands.first + i]));
+    }
+}
+
+//*every slot and copy gets its place before any code, so the prologue knows the frame's size
+Internal void rv_layout_frame() {
+    Type* func_type = rv_ir->sym->type;
+    rv_frame_bytes = 0;
+    rv_out_bytes = 0;
+    rv_slots.assign(rv_ir->num_insts, 0);
+    rv_copies.assign(rv_ir->num_insts, 0);
+    rv_in_slots.assign(rv_ir->num_insts, 0);
+    rv_arg_copies.assign(rv_ir->num_operands, 0);
+    for (int c = 0; c < (int)RaClass::SIZE_OF_ENUM; c++) {
+        rv_saved_slots[c].resize(rv_ra.saved[c].size());
+        for (i32& slot : rv_saved_slots[c]) {
+            slot = rv_alloc(8, 8);
+        }
+    }
+    bool hidden_ret = rv_is_aggregate(func_type->func.ret);
+    rv_ret_slot = hidden_ret ? rv_alloc(8, 8) : 0;
+
+    //*params that come on the stack are read where the caller put them, above the saved ra and fp
+    std::vector<RvArg> params;
+    rv_place_args(func_type->func.params, func_type->func.num_params, hidden_ret, &params);
+    std::vector<Type*> types;
+    std::vector<RvArg> args;
+    for (IrValue v = 1; v < rv_ir->num_insts; v++) {
+        IrInst* inst = rv_ir->insts + v;
+        Type* type = Global::types[inst->type];
+        if (inst->op == IrOp::PARAM && params[inst->int_val].on_stack) {
+            rv_slots[v] = 16 + (i32)params[inst->int_val].stack_offset;
+        }
+        else if (ir_has_result(inst->op) && inst->type) {
+            rv_slots[v] = rv_alloc(8, 8);
+        }
+        if (inst->op == IrOp::ALLOCA) {
+            rv_copies[v] = rv_alloc_type(type->ptr.base);
+        }
+        else if (inst->op != IrOp::PARAM && inst->type && rv_is_aggregate(type)) {
+            rv_copies[v] = rv_alloc_type(type);
+            if (inst->op == IrOp::PHI) {
+                rv_in_slots[v] = rv_alloc_type(type);
+            }
+        }
+        else if (inst->op == IrOp::PHI) {
+            rv_in_slots[v] = rv_alloc(8, 8);
+        }
+        if (inst->op == IrOp::CALL) {
+            rv_arg_types(inst, &types);
+            u32 stack = rv_place_args(types.data(), types.size(), rv_is_aggregate(type), &args);
+            rv_out_bytes = stack > rv_out_bytes ? stack : rv_out_bytes;
+            for (size_t i = 0; i < types.size(); i++) {
+                if (rv_is_aggregate(types[i])) {
+                    rv_arg_copies[inst->operands.first + i] = rv_alloc_type(types[i]);
+                }
+            }
+        }
+    }
+}
+
+//*prologue and epilogue
+
+Internal void rv_emit_prologue() {
+    Type* func_type = rv_ir->sym->type;
+    rv_addi(RV_SP, RV_SP, -16);
+    rv_sd(RV_SP, 8, RV_RA);
+    rv_sd(RV_SP, 0, RV_FP);
+    rv_mv(RV_FP, RV_SP);
+    u32 frame = (rv_frame_bytes + rv_out_bytes + 15) / 16 * 16;
+    if (frame) {
+        rv_add_imm(RV_SP, RV_SP, -(i64)frame);
+    }
+    for (size_t i = 0; i < rv_saved_slots[(int)RaClass::INT].size(); i++) {
+        rv_sd(RV_FP, rv_saved_slots[(int)RaClass::INT][i], rv_ra.saved[(int)RaClass::INT][i]);
+    }
+    for (size_t i = 0; i < rv_saved_slots[(int)RaClass::FLOAT].size(); i++) {
+        rv_fstore(Global::type_double, RV_FP, rv_saved_slots[(int)RaClass::FLOAT][i], rv_ra.saved[(int)RaClass::FLOAT][i]);
+    }
+    bool hidden_ret = rv_ret_slot != 0;
+    if (hidden_ret) {
+        rv_sd(RV_FP, rv_ret_slot, RV_A0);
+    }
+
+    std::vector<RvArg> params;
+    rv_place_args(func_type->func.params, func_type->func.num_params, hidden_ret, &params);
+    for (IrValue v = 1; v < rv_ir->num_insts; v++) {
+        IrInst* inst = rv_ir->insts + v;
+        if (inst->op != IrOp::PARAM) {
+            continue;
+        }
+        RvArg* param = &params[inst->int_val];
+        if (param->on_stack) {
+            continue;
+        }
+        if (param->in_freg) {
+            rv_fstore(rv_type(v), RV_FP, rv_slots[v], param->reg);
+        }
+        else {
+            rv_sd(RV_FP, rv_slots[v], param->reg);
+        }
+    }
+
+    //*aggregate phis are written through the addresses of their copies, which never change
+    for (IrValue v = 1; v < rv_ir->num_insts; v++) {
+        if (rv_ir->insts[v].op == IrOp::PHI && rv_is_aggregate(rv_type(v))) {
+            rv_add_imm(RV_T0, RV_FP, rv_copies[v]);
+            rv_set(v, RV_T0);
+        }
+    }
+}
+
+Internal void rv_emit_epilogue() {
+    for (size_t i = 0; i < rv_saved_slots[(int)RaClass::INT].size(); i++) {
+        rv_ld(rv_ra.saved[(int)RaClass::INT][i], RV_FP, rv_saved_slots[(int)RaClass::INT][i]);
+    }
+    for (size_t i = 0; i < rv_saved_slots[(int)RaClass::FLOAT].size(); i++) {
+        rv_fload(Global::type_double, rv_ra.saved[(int)RaClass::FLOAT][i], RV_FP, rv_saved_slots[(int)RaClass::FLOAT][i]);
+    }
+    rv_mv(RV_SP, RV_FP);
+    rv_ld(RV_RA, RV_SP, 8);
+    rv_ld(RV_FP, RV_SP, 0);
+    rv_addi(RV_SP, RV_SP, 16);
+    rv_emit(rv_encode_i(RV_JALR, 0, RV_ZERO, RV_RA, 0));
+}
+
+//*edges
+
+//*every phi first gathers its operand and then takes it, so no phi reads another's new value
+Internal void rv_emit_phi_moves(u32 pred, u32 succ) {
+    IrBlock* block = rv_ir->blocks + succ;
+    rv_pos = rv_ra.block_ends[pred];
+    u32 slot = 0;
+    while (rv_ir->preds[block->first_pred + slot] != pred) {
+        slot++;
+    }
+    IrValue end = block->first;
+    while (rv_ir->insts[end].op == IrOp::PHI) {
+        end++;
+    }
+    for (IrValue phi = block->first; phi < end; phi++) {
+        IrValue operand = rv_ir->operands[rv_ir->insts[phi].operands.first + slot];
+        Type* type = rv_type(phi);
+        if (end - block->first == 1 && !rv_is_aggregate(type)) {
+            rv_get(RV_T0, operand);
+            rv_set(phi, RV_T0);
+            return;
+        }
+        if (rv_is_aggregate(type)) {
+            rv_get(RV_T1, operand);
+            rv_copy(RV_FP, rv_in_slots[phi], RV_T1, 0, (u32)type->size, (u32)type->align);
+        }
+        else {
+            rv_get(RV_T0, operand);
+            rv_sd(RV_FP, rv_in_slots[phi], RV_T0);
+        }
+    }
+    for (IrValue phi = block->first; phi < end; phi++) {
+        Type* type = rv_type(phi);
+        if (rv_is_aggregate(type)) {
+            rv_copy(RV_FP, rv_copies[phi], RV_FP, rv_in_slots[phi], (u32)type->size, (u32)type->align);
+        }
+        else {
+            rv_ld(RV_T0, RV_FP, rv_in_slots[phi]);
+            rv_set(phi, RV_T0);
+        }
+    }
+}
+
+Internal bool rv_has_phis(u32 block) {
+    IrBlock* it = rv_ir->blocks + block;
+    return it->num_insts && rv_ir->insts[it->first].op == IrOp::PHI;
+}
+
+Internal u32 rv_edge_label(u32 pred, u32 succ) {
+    if (!rv_has_phis(succ)) {
+        return succ;
+    }
+    u32 label = (u32)rv_labels.size();
+    rv_labels.push_back(0);
+    rv_edges.push_back({ pred, succ, label });
+    return label;
+}
+
+//*instructions
+
+Internal void rv_compile_int_arith(IrValue value, IrInst* inst, Type* type) {
+    u32 left = rv_use(RV_T0, inst->args[0]);
+    u32 right = inst->args[1] ? rv_use(RV_T1, inst->args[1]) : (u32)RV_ZERO;
+    u32 dest = rv_dest(value, RV_T0);
+    bool is_signed = is_signed_type(type);
+    switch (inst->op) {
+        case IrOp::ADD: {
+            rv_op(0, 0, dest, left, right);
+            break;
+        }
+        case IrOp::SUB: {
+            rv_op(0, 0x20, dest, left, right);
+            break;
+        }
+        case IrOp::MUL: {
+            rv_op(0, 1, dest, left, right);
+            break;
+        }
+        case IrOp::DIV: {
+            //*operands are extended to 64 bits, so the 64-bit division gives the quotient and remainder of any width
+            rv_op(is_signed ? 4 : 5, 1, dest, left, right);
+            break;
+        }
+        case IrOp::MOD: {
+            rv_op(is_signed ? 6 : 7, 1, dest, left, right);
+            break;
+        }
+        case IrOp::AND: {
+            rv_op(7, 0, dest, left, right);
+            break;
+        }
+        case IrOp::OR: {
+            rv_op(6, 0, dest, left, right);
+            break;
+        }
+        case IrOp::XOR: {
+            rv_op(4, 0, dest, left, right);
+            break;
+        }
+        case IrOp::SHL: {
+            rv_op(1, 0, dest, left, right);
+            break;
+        }
+        case IrOp::SHR: {
+            rv_op(5, is_signed ? 0x20 : 0, dest, left, right);
+            break;
+        }
+        case IrOp::NEG: {
+            rv_op(0, 0x20, dest, RV_ZERO, left);
+            break;
+        }
+        default: {
+            assert(false);
+            break;
+        }
+    }
+    rv_extend(dest, type);
+    rv_set(value, dest);
+}
+
+Internal void rv_compile_arith(IrValue value, IrInst* inst) {
+    Type* type = Global::types[inst->type];
+    if (!is_floating_type(type)) {
+        rv_compile_int_arith(value, inst, type);
+        return;
+    }
+    u32 left = rv_fuse(type, RV_FT0, inst->args[0]);
+    u32 dest = rv_fdest(value, RV_FT0);
+    if (inst->op == IrOp::NEG) {
+        rv_fp_op(RV_FSGNJ, type, 1, dest, left, left);
+    }
+    else {
+        u32 funct5 = inst->op == IrOp::ADD ? RV_FADD : inst->op == IrOp::SUB ? RV_FSUB : inst->op == IrOp::MUL ? RV_FMUL : RV_FDIV;
+        u32 right = rv_fuse(type, RV_FT1, inst->args[1]);
+        rv_fp_op(funct5, type, RV_RM_DYN, dest, left, right);
+    }
+    rv_fset(type, value, dest);
+}
+
+Internal void rv_compile_compare(IrValue value, IrInst* inst) {
+    Type* type = rv_type(inst->args[0]);
+    IrOp op = inst->op;
+    //*a > b is b < a and a >= b is b <= a
+    bool swap = op == IrOp::GT || op == IrOp::GE;
+    u32 dest = rv_dest(value, RV_T0);
+    if (is_floating_type(type)) {
+        u32 a = rv_fuse(type, RV_FT0, inst->args[0]);
+        u32 b = rv_fuse(type, RV_FT1, inst->args[1]);
+        //*feq is 2, flt 1 and fle 0, all false for a nan
+        u32 funct3 = op == IrOp::EQ || op == IrOp::NE ? 2 : op == IrOp::LT || op == IrOp::GT ? 1 : 0;
+        rv_fp_op(RV_FCMP, type, funct3, dest, swap ? b : a, swap ? a : b);
+        if (op == IrOp::NE) {
+            rv_op_imm(4, dest, dest, 1);
+        }
+        rv_set(value, dest);
+        return;
+    }
+    u32 a = rv_use(RV_T0, inst->args[0]);
+    u32 b = rv_use(RV_T1, inst->args[1]);
+    u32 left = swap ? b : a;
+    u32 right = swap ? a : b;
+    u32 slt = is_signed_type(type) ? 2 : 3;
+    switch (op) {
+        case IrOp::EQ:
+        case IrOp::NE: {
+            rv_op(0, 0x20, dest, a, b);
+            if (op == IrOp::EQ) {
+                rv_op_imm(3, dest, dest, 1);
+            }
+            else {
+                rv_op(3, 0, dest, RV_ZERO, dest);
+            }
+            break;
+        }
+        case IrOp::LT:
+        case IrOp::GT: {
+            rv_op(slt, 0, dest, left, right);
+            break;
+        }
+        default: {
+            //*a <= b is !(b < a)
+            rv_op(slt, 0, dest, right, left);
+            rv_op_imm(4, dest, dest, 1);
+            break;
+        }
+    }
+    rv_set(value, dest);
+}
+
+Internal void rv_compile_convert(IrValue value, IrInst* inst) {
+    Type* to = Global::types[inst->type];
+    Type* from = rv_type(inst->args[0]);
+    if (to->kind == TypeKind::BOOL && is_floating_type(from)) {
+        rv_fget(from, RV_FT0, inst->args[0]);
+        rv_fp_op(RV_FMV_FX, from, 0, RV_FT1, RV_ZERO, 0);
+        rv_fp_op(RV_FCMP, from, 2, RV_T0, RV_FT0, RV_FT1);
+        rv_op_imm(4, RV_T0, RV_T0, 1);
+        rv_set(value, RV_T0);
+    }
+    else if (to->kind == TypeKind::BOOL) {
+        rv_get(RV_T0, inst->args[0]);
+        rv_op(3, 0, RV_T0, RV_ZERO, RV_T0);
+        rv_set(value, RV_T0);
+    }
+    else if (is_floating_type(to) && is_floating_type(from)) {
+        rv_fget(from, RV_FT0, inst->args[0]);
+        if (to->kind != from->kind) {
+            rv_fp_op(RV_FCVT_FF, to, RV_RM_DYN, RV_FT0, RV_FT0, rv_fmt(from));
+        }
+        rv_fset(to, value, RV_FT0);
+    }
+    else if (is_floating_type(to)) {
+        //*from l, or from lu for a 64-bit unsigned value
+        rv_get(RV_T0, inst->args[0]);
+        u32 kind = is_signed_type(from) || from->size < 8 ? 2 : 3;
+        rv_fp_op(RV_FCVT_FI, to, RV_RM_DYN, RV_FT0, RV_T0, kind);
+        rv_fset(to, value, RV_FT0);
+    }
+    else if (is_floating_type(from)) {
+        rv_fget(from, RV_FT0, inst->args[0]);
+        u32 kind = !is_signed_type(to) && to->size == 8 ? 3 : 2;
+        rv_fp_op(RV_FCVT_IF, from, RV_RM_RTZ, RV_T0, RV_FT0, kind);
+        rv_extend(RV_T0, to);
+        rv_set(value, RV_T0);
+    }
+    else {
+        rv_get(RV_T0, inst->args[0]);
+        rv_extend(RV_T0, to);
+        rv_set(value, RV_T0);
+    }
+}
+
+Internal void rv_compile_access(IrValue value, IrInst* inst) {
+    bool is_load = inst->op == IrOp::LOAD;
+    Type* type = is_load ? Global::types[inst->type] : rv_type(inst->args[1]);
+    u32 base = rv_use(RV_T1, inst->args[0]);
+    if (rv_is_aggregate(type)) {
+        if (is_load) {
+            rv_copy(RV_FP, rv_copies[value], base, 0, (u32)type->size, (u32)type->align);
+            rv_add_imm(RV_T0, RV_FP, rv_copies[value]);
+            rv_set(value, RV_T0);
+        }
+        else {
+            rv_copy(base, 0, rv_use(RV_T2, inst->args[1]), 0, (u32)type->size, (u32)type->align);
+        }
+        return;
+    }
+    if (is_load) {
+        u32 dest = rv_dest(value, RV_T0);
+        rv_load(dest, type, base, 0);
+        rv_set(value, dest);
+    }
+    else {
+        rv_store_bytes(base, 0, rv_use(RV_T0, inst->args[1]), (u32)type->size);
+    }
+}
+
+Internal void rv_compile_call(IrValue value, IrInst* inst) {
+    Type* ret = Global::types[inst->type];
+    std::vector<Type*> types;
+    std::vector<RvArg> args;
+    rv_arg_types(inst, &types);
+    bool hidden_ret = rv_is_aggregate(ret);
+    rv_place_args(types.data(), types.size(), hidden_ret, &args);
+
+    for (size_t i = 0; i < args.size(); i++) {
+        RvArg* arg = &args[i];
+        IrValue operand = rv_ir->operands[inst->operands.first + i];
+        i32 copy = rv_arg_copies[inst->operands.first + i];
+        u32 reg = arg->on_stack ? (u32)RV_T0 : arg->reg;
+        if (rv_is_aggregate(types[i])) {
+            rv_get(RV_T1, operand);
+            rv_copy(RV_FP, copy, RV_T1, 0, (u32)types[i]->size, (u32)types[i]->align);
+            rv_add_imm(reg, RV_FP, copy);
+        }
+        else if (arg->in_freg) {
+            rv_fget(types[i], reg, operand);
+        }
+        else {
+            rv_get(reg, operand);
+        }
+        if (arg->on_stack) {
+            rv_sd(RV_SP, (i32)arg->stack_offset, RV_T0);
+        }
+    }
+    if (hidden_ret) {
+        rv_add_imm(RV_A0, RV_FP, rv_copies[value]);
+    }
+
+    IrInst* callee = rv_ir->insts + inst->args[0];
+    if (callee->op == IrOp::GLOBAL && callee->sym->kind == SymKind::FUNC) {
+        rv_reloc(RvTarget::FUNC, callee->sym, 0, RV_RA, RV_JALR);
+    }
+    else {
+        rv_get(RV_T1, inst->args[0]);
+        rv_emit(rv_encode_i(RV_JALR, 0, RV_RA, RV_T1, 0));
+    }
+
+    if (ret->kind == TypeKind::VOID) {
+        return;
+    }
+    if (hidden_ret) {
+        rv_add_imm(RV_T0, RV_FP, rv_copies[value]);
+        rv_set(value, RV_T0);
+    }
+    else if (is_floating_type(ret)) {
+        rv_fset(ret, value, RV_FA0);
+    }
+    else {
+        rv_set(value, RV_A0);
+    }
+}
+
+Internal void rv_compile_return(IrInst* inst) {
+    Type* ret = rv_ir->sym->type->func.ret;
+    IrValue value = inst->args[0];
+    if (value && rv_is_aggregate(ret)) {
+        //*the caller's copy is written and its address returned
+        rv_ld(RV_T1, RV_FP, rv_ret_slot);
+        rv_get(RV_T2, value);
+        rv_copy(RV_T1, 0, RV_T2, 0, (u32)ret->size, (u32)ret->align);
+        rv_mv(RV_A0, RV_T1);
+    }
+    else if (value && is_floating_type(ret)) {
+        rv_fget(ret, RV_FA0, value);
+    }
+    else if (value) {
+        rv_get(RV_A0, value);
+    }
+    rv_emit_epilogue();
+}
+
+//*branches reach 4KB, so a conditional branch skips over a jal that reaches the whole func
+Internal void rv_compile_branch(u32 block, IrInst* inst) {
+    u32 then_label = rv_edge_label(block, inst->targets[0]);
+    u32 else_label = rv_edge_label(block, inst->targets[1]);
+    u32 cond = rv_use(RV_T0, inst->args[0]);
+    if (then_label == block + 1) {
+        rv_emit(rv_encode_b(1, cond, RV_ZERO, 8));
+        rv_jal(else_label);
+        return;
+    }
+    rv_emit(rv_encode_b(0, cond, RV_ZERO, 8));
+    rv_jal(then_label);
+    if (else_label != block + 1) {
+        rv_jal(else_label);
+    }
+}
+
+Internal void rv_compile_inst(u32 block, IrValue value) {
+    IrInst* inst = rv_ir->insts + value;
+    Type* type = Global::types[inst->type];
+    if (inst->lanes) {
+        fatal("%s has vector instructions, the RV64 backend compiles IR without them", rv_ir->sym->name);
+    }
+    switch (inst->op) {
+        case IrOp::NOP:
+        case IrOp::PHI: {
+            break;
+        }
+        case IrOp::PARAM: {
+            //*the prologue stored the argument in the slot, or the caller did
+            i32 reg = ra_def_reg(&rv_ra, value);
+            if (reg >= 0) {
+                rv_load_reg(value, (u32)reg);
+            }
+            break;
+        }
+        case IrOp::UNDEF: {
+            if (rv_is_aggregate(type)) {
+                rv_add_imm(RV_T0, RV_FP, rv_copies[value]);
+                rv_set(value, RV_T0);
+            }
+            else {
+                rv_set(value, RV_ZERO);
+            }
+            break;
+        }
+        case IrOp::CONST_INT: {
+            u32 dest = rv_dest(value, RV_T0);
+            rv_li(dest, inst->int_val);
+            rv_extend(dest, type);
+            rv_set(value, dest);
+            break;
+        }
+        case IrOp::CONST_FLOAT: {
+            u64 bits = 0;
+            if (type->kind == TypeKind::FLOAT) {
+                f32 val = (f32)inst->float_val;
+                memcpy(&bits, &val, sizeof(val));
+            }
+            else {
+                memcpy(&bits, &inst->float_val, sizeof(bits));
+            }
+            rv_li(RV_T0, (i64)bits);
+            rv_set(value, RV_T0);
+            break;
+        }
+        case IrOp::GLOBAL: {
+            rv_reloc(inst->sym->kind == SymKind::FUNC ? RvTarget::FUNC : RvTarget::GLOBAL, inst->sym, 0, RV_T0, RV_OP_IMM);
+            rv_set(value, RV_T0);
+            break;
+        }
+        case IrOp::STR: {
+            auto it = rv_string_offsets.find(inst->str);
+            if (it == rv_string_offsets.end()) {
+                it = rv_string_offsets.emplace(inst->str, (u32)rv_strings.size()).first;
+                rv_strings.insert(rv_strings.end(), inst->str, inst->str + strlen(inst->str) + 1);
+            }
+            rv_reloc(RvTarget::STRING, nullptr, it->second, RV_T0, RV_OP_IMM);
+            rv_set(value, RV_T0);
+            break;
+        }
+        case IrOp::ADD:
+        case IrOp::SUB:
+        case IrOp::MUL:
+        case IrOp::DIV:
+        case IrOp::MOD:
+        case IrOp::AND:
+        case IrOp::OR:
+        case IrOp::XOR:
+        case IrOp::SHL:
+        case IrOp::SHR:
+        case IrOp::NEG: {
+            rv_compile_arith(value, inst);
+            break;
+        }
+        case IrOp::EQ:
+        case IrOp::NE:
+        case IrOp::LT:
+        case IrOp::LE:
+        case IrOp::GT:
+        case IrOp::GE: {
+            rv_compile_compare(value, inst);
+            break;
+        }
+        case IrOp::CONVERT: {
+            rv_compile_convert(value, inst);
+            break;
+        }
+        case IrOp::ALLOCA: {
+            rv_add_imm(RV_T0, RV_FP, rv_copies[value]);
+            rv_set(value, RV_T0);
+            break;
+        }
+        case IrOp::LOAD:
+        case IrOp::STORE: {
+            rv_compile_access(value, inst);
+            break;
+        }
+        case IrOp::ZERO: {
+            Type* ptr = rv_type(inst->args[0]);
+            rv_zero(rv_use(RV_T1, inst->args[0]), 0, (u32)inst->int_val, ptr->kind == TypeKind::PTR ? (u32)ptr->ptr.base->align : 1);
+            break;
+        }
+        case IrOp::ELEM_ADDR: {
+            u32 base = rv_use(RV_T0, inst->args[0]);
+            u32 index = rv_use(RV_T1, inst->args[1]);
+            u64 size = type->ptr.base->size;
+            if (size && (size & (size - 1)) == 0) {
+                u32 shift = 0;
+                while ((1ull << shift) < size) {
+                    shift++;
+                }
+                if (shift) {
+                    rv_slli(RV_T1, index, shift);
+                    index = RV_T1;
+                }
+            }
+            else {
+                rv_li(RV_T2, (i64)size);
+                rv_op(0, 1, RV_T1, index, RV_T2);
+                index = RV_T1;
+            }
+            u32 dest = rv_dest(value, RV_T0);
+            rv_add(dest, base, index);
+            rv_set(value, dest);
+            break;
+        }
+        case IrOp::FIELD_ADDR: {
+            u32 base = rv_use(RV_T0, inst->args[0]);
+            u32 dest = rv_dest(value, RV_T0);
+            if (inst->int_val || dest != base) {
+                rv_add_imm(dest, base, inst->int_val);
+            }
+            rv_set(value, dest);
+            break;
+        }
+        case IrOp::CALL: {
+            rv_compile_call(value, inst);
+            break;
+        }
+        case IrOp::JUMP: {
+            rv_emit_phi_moves(block, inst->targets[0]);
+            if (inst->targets[0] != block + 1) {
+                rv_jal(inst->targets[0]);
+            }
+            break;
+        }
+        case IrOp::BRANCH: {
+            rv_compile_branch(block, inst);
+            break;
+        }
+        case IrOp::RETURN: {
+            rv_compile_return(inst);
+            break;
+        }
+        default: {
+            fatal("%s: the RV64 backend does not compile %s", rv_ir->sym->name, ir_dump(rv_ir).c_str());
+            break;
+        }
+    }
+}
+
+Internal void rv_compile_func(IrFunc* func) {
+    rv_ir = func;
+    ra_allocate(func, rv_target, &rv_ra);
+    rv_layout_frame();
+    rv_labels.assign(func->num_blocks, 0);
+    rv_fixups.clear();
+    rv_edges.clear();
+    rv_emit_prologue();
+    size_t next_reload = 0;
+    for (u32 b = 0; b < func->num_blocks; b++) {
+        rv_labels[b] = (u32)rv_code.size();
+        IrBlock* block = func->blocks + b;
+        for (IrValue v = block->first; v < block->first + block->num_insts; v++) {
+            rv_pos = rv_ra.positions[v];
+            for (; next_reload < rv_ra.reloads.size() && rv_ra.reloads[next_reload].pos == rv_pos; next_reload++) {
+                rv_load_reg(rv_ra.reloads[next_reload].value, rv_ra.reloads[next_reload].reg);
+            }
+            rv_compile_inst(b, v);
+        }
+    }
+    assert(next_reload == rv_ra.reloads.size());
+    for (size_t i = 0; i < rv_edges.size(); i++) {
+        RvEdge edge = rv_edges[i];
+        rv_labels[edge.label] = (u32)rv_code.size();
+        rv_emit_phi_moves(edge.pred, edge.succ);
+        rv_jal(edge.succ);
+    }
+    for (RvFixup& it : rv_fixups) {
+        i64 offset = ((i64)rv_labels[it.label] - (i64)it.pos) * 4;
+        if (offset < -(1 << 20) || offset >= (1 << 20)) {
+            fatal("%s is too large for the jumps of the RV64 backend", func->sym->name);
+        }
+        rv_code[it.pos] = rv_encode_j(RV_ZERO, (i32)offset);
+    }
+}
+
+//*simulator
+
+Internal u8* rv_mem(RvProgram* program, u64 addr, u32 size, bool is_store, u64 pc) {
+    u64 offset = addr - RV_BASE;
+    if (addr < RV_BASE || offset > program->memory.size() || program->memory.size() - offset < size) {
+        char error[96];
+        snprintf(error, sizeof(error), "%s fault at 0x%llx, pc 0x%llx", is_store ? "store" : "load", (unsigned long long)addr,
+                 (unsigned long long)pc);
+        program->error = error;
+        return nullptr;
+    }
+    if (is_store && offset < program->stack_floor) {
+        char error[96];
+        snprintf(error, sizeof(error), "store to read-only memory at 0x%llx, pc 0x%llx", (unsigned long long)addr,
+                 (unsigned long long)pc);
+        program->error = error;
+        return nullptr;
+    }
+    return program->memory.data() + offset;
+}
+
+Internal f32 rv_get_f32(RvProgram* program, u32 reg) {
+    u32 bits = (u32)program->f[reg];
+    f32 val;
+    memcpy(&val, &bits, sizeof(val));
+    return val;
+}
+
+Internal f64 rv_get_f64(RvProgram* program, u32 reg) {
+    f64 val;
+    memcpy(&val, &program->f[reg], sizeof(val));
+    return val;
+}
+
+Internal void rv_set_f32(RvProgram* program, u32 reg, f32 val) {
+    u32 bits;
+    memcpy(&bits, &val, sizeof(bits));
+    program->f[reg] = 0xFFFFFFFF00000000ull | bits;
+}
+
+Internal void rv_set_f64(RvProgram* program, u32 reg, f64 val) {
+    memcpy(&program->f[reg], &val, sizeof(val));
+}
+
+//*high half of the 128-bit product
+Internal u64 rv_mulhu(u64 a, u64 b) {
+    u64 a_lo = a & 0xFFFFFFFF;
+    u64 a_hi = a >> 32;
+    u64 b_lo = b & 0xFFFFFFFF;
+    u64 b_hi = b >> 32;
+    u64 mid = (a_lo * b_lo >> 32) + (a_hi * b_lo & 0xFFFFFFFF) + a_lo * b_hi;
+    return a_hi * b_hi + (a_hi * b_lo >> 32) + (mid >> 32);
+}
+
+//*division never traps: by zero the quotient is all ones and the remainder the dividend, and the overflow of the
+//*most negative value by -1 gives that value and 0
+Internal u64 rv_divide(u32 funct3, u64 a, u64 b, bool word) {
+    if (word) {
+        bool is_signed = funct3 == 4 || funct3 == 6;
+        a = is_signed ? (u64)(i64)(i32)a : (u64)(u32)a;
+        b = is_signed ? (u64)(i64)(i32)b : (u64)(u32)b;
+    }
+    i64 min = word ? INT32_MIN : INT64_MIN;
+    u64 result = 0;
+    switch (funct3) {
+        case 4: {
+            result = b == 0 ? ~0ull : (i64)a == min && (i64)b == -1 ? a : (u64)((i64)a / (i64)b);
+            break;
+        }
+        case 5: {
+            result = b == 0 ? ~0ull : a / b;
+            break;
+        }
+        case 6: {
+            result = b == 0 ? a : (i64)a == min && (i64)b == -1 ? 0 : (u64)((i64)a % (i64)b);
+            break;
+        }
+        default: {
+            result = b == 0 ? a : a % b;
+            break;
+        }
+    }
+    return word ? (u64)(i64)(i32)result : result;
+}
+
+//*rounds by the rounding mode, the dynamic mode is round to nearest even like the host
+Internal f64 rv_round(f64 val, u32 rm) {
+    switch (rm) {
+        case 1: {
+            return std::trunc(val);
+        }
+        case 2: {
+            return std::floor(val);
+        }
+        case 3: {
+            return std::ceil(val);
+        }
+        case 4: {
+            return std::round(val);
+        }
+        default: {
+            return std::nearbyint(val);
+        }
+    }
+}
+
+//*out of range values and nans saturate, a 32-bit result is sign extended
+Internal u64 rv_float_to_int(f64 val, u32 rm, u32 kind) {
+    f64 r = rv_round(val, rm);
+    switch (kind) {
+        case 0: {
+            i32 out = r != r || r >= 2147483648.0 ? INT32_MAX : r < -2147483648.0 ? INT32_MIN : (i32)r;
+            return (u64)(i64)out;
+        }
+        case 1: {
+            u32 out = r != r || r >= 4294967296.0 ? UINT32_MAX : r <= 0 ? 0 : (u32)r;
+            return (u64)(i64)(i32)out;
+        }
+        case 2: {
+            return (u64)(r != r || r >= 9223372036854775808.0 ? INT64_MAX : r < -9223372036854775808.0 ? INT64_MIN : (i64)r);
+        }
+        default: {
+            return r != r || r >= 18446744073709551616.0 ? UINT64_MAX : r <= 0 ? 0 : (u64)r;
+        }
+    }
+}
+
+Internal bool rv_illegal(RvProgram* program, u64 pc, u32 inst) {
+    char error[64];
+    snprintf(error, sizeof(error), "illegal instruction 0x%08x at pc 0x%llx", inst, (unsigned long long)pc);
+    program->error = error;
+    return false;
+}
+
+Internal bool rv_exec_fp(RvProgram* program, u64 pc, u32 inst) {
+    u64* x = program->x;
+    u32 rd = (inst >> 7) & 31;
+    u32 funct3 = (inst >> 12) & 7;
+    u32 rs1 = (inst >> 15) & 31;
+    u32 rs2 = (inst >> 20) & 31;
+    u32 funct5 = inst >> 27;
+    bool is_double = ((inst >> 25) & 3) == 1;
+    f64 a = is_double ? rv_get_f64(program, rs1) : rv_get_f32(program, rs1);
+    f64 b = is_double ? rv_get_f64(program, rs2) : rv_get_f32(program, rs2);
+    bool has_result = true;
+    f64 result = 0;
+    switch (funct5) {
+        case RV_FADD: {
+            result = is_double ? a + b : (f32)a + (f32)b;
+            break;
+        }
+        case RV_FSUB: {
+            result = is_double ? a - b : (f32)a - (f32)b;
+            break;
+        }
+        case RV_FMUL: {
+            result = is_double ? a * b : (f32)a * (f32)b;
+            break;
+        }
+        case RV_FDIV: {
+            result = is_double ? a / b : (f32)a / (f32)b;
+            break;
+        }
+        case RV_FSQRT: {
+            result = is_double ? std::sqrt(a) : std::sqrt((f32)a);
+            break;
+        }
+        case RV_FSGNJ: {
+            bool sign = funct3 == 0 ? std::signbit(b) : funct3 == 1 ? !std::signbit(b) : std::signbit(a) != std::signbit(b);
+            result = std::copysign(a, sign ? -1.0 : 1.0);
+            break;
+        }
+        case RV_FMINMAX: {
+            result = a != a ? b : b != b ? a : funct3 == 0 ? (a < b ? a : b) : (a > b ? a : b);
+            break;
+        }
+        case RV_FCVT_FF: {
+            result = rs2 == 1 ? rv_get_f64(program, rs1) : rv_get_f32(program, rs1);
+            break;
+        }
+        case RV_FCMP: {
+            has_result = false;
+            x[rd] = funct3 == 2 ? a == b : funct3 == 1 ? a < b : funct3 == 0 ? a <= b : 0;
+            break;
+        }
+        case RV_FCVT_IF: {
+            has_result = false;
+            x[rd] = rv_float_to_int(a, funct3, rs2);
+            break;
+        }
+        case RV_FCVT_FI: {
+            u64 v = x[rs1];
+            switch (rs2) {
+                case 0: {
+                    result = is_double ? (f64)(i32)v : (f32)(i32)v;
+                    break;
+                }
+                case 1: {
+                    result = is_double ? (f64)(u32)v : (f32)(u32)v;
+                    break;
+                }
+                case 2: {
+                    result = is_double ? (f64)(i64)v : (f32)(i64)v;
+                    break;
+                }
+                default: {
+                    result = is_double ? (f64)v : (f32)v;
+                    break;
+                }
+            }
+            break;
+        }
+        case RV_FMV_XF: {
+            has_result = false;
+            x[rd] = is_double ? program->f[rs1] : (u64)(i64)(i32)(u32)program->f[rs1];
+            break;
+        }
+        case RV_FMV_FX: {
+            has_result = false;
+            program->f[rd] = is_double ? x[rs1] : 0xFFFFFFFF00000000ull | (u32)x[rs1];
+            break;
+        }
+        default: {
+            return rv_illegal(program, pc, inst);
+        }
+    }
+    if (has_result && is_double) {
+        rv_set_f64(program, rd, result);
+    }
+    else if (has_result) {
+        rv_set_f32(program, rd, (f32)result);
+    }
+    return true;
+}
+
+//*runs from pc until an exit ecall
+Internal bool rv_run(RvProgram* program, u64 pc) {
+    u64* x = program->x;
+    u64 max_steps = program->max_steps ? program->max_steps : UINT64_MAX;
+    for (;;) {
+        if (program->steps >= max_steps) {
+            program->error = "step limit exceeded";
+            return false;
+        }
+        program->steps++;
+        u64 offset = pc - RV_BASE;
+        if ((pc & 3) || pc < RV_BASE || offset >= program->code_bytes) {
+            char error[64];
+            snprintf(error, sizeof(error), "instruction fetch fault at 0x%llx", (unsigned long long)pc);
+            program->error = error;
+            return false;
+        }
+        u32 inst;
+        memcpy(&inst, program->memory.data() + offset, sizeof(inst));
+        u32 rd = (inst >> 7) & 31;
+        u32 funct3 = (inst >> 12) & 7;
+        u32 rs1 = (inst >> 15) & 31;
+        u32 rs2 = (inst >> 20) & 31;
+        u32 funct7 = inst >> 25;
+        i64 imm = (i64)(i32)inst >> 20;
+        u64 next = pc + 4;
+        switch (inst & 0x7F) {
+            case RV_LUI: {
+                x[rd] = (u64)(i64)(i32)(inst & 0xFFFFF000);
+                break;
+            }
+            case RV_AUIPC: {
+                x[rd] = pc + (u64)(i64)(i32)(inst & 0xFFFFF000);
+                break;
+            }
+            case RV_JAL: {
+                i64 offset_j = (i64)(((inst >> 31) & 1) << 20 | ((inst >> 21) & 0x3FF) << 1 | ((inst >> 20) & 1) << 11
+                                     | ((inst >> 12) & 0xFF) << 12);
+                offset_j = (i64)((u64)offset_j << 43) >> 43;
+                x[rd] = next;
+                next = pc + (u64)offset_j;
+                break;
+            }
+            case RV_JALR: {
+                u64 target = (x[rs1] + (u64)imm) & ~1ull;
+                x[rd] = next;
+                next = target;
+                break;
+            }
+            case RV_BRANCH: {
+                i64 offset_b = (i64)(((inst >> 31) & 1) << 12 | ((inst >> 25) & 0x3F) << 5 | ((inst >> 8) & 0xF) << 1
+                                     | ((inst >> 7) & 1) << 11);
+                offset_b = (i64)((u64)offset_b << 51) >> 51;
+                u64 a = x[rs1];
+                u64 b = x[rs2];
+                bool taken = false;
+                switch (funct3) {
+                    case 0: {
+                        taken = a == b;
+                        break;
+                    }
+                    case 1: {
+                        taken = a != b;
+                        break;
+                    }
+                    case 4: {
+                        taken = (i64)a < (i64)b;
+                        break;
+                    }
+                    case 5: {
+                        taken = (i64)a >= (i64)b;
+                        break;
+                    }
+                    case 6: {
+                        taken = a < b;
+                        break;
+                    }
+                    case 7: {
+                        taken = a >= b;
+                        break;
+                    }
+                    default: {
+                        return rv_illegal(program, pc, inst);
+                    }
+                }
+                if (taken) {
+                    next = pc + (u64)offset_b;
+                }
+                break;
+            }
+            case RV_LOAD: {
+                u32 size = 1u << (funct3 & 3);
+                u8* mem = rv_mem(program, x[rs1] + (u64)imm, size, false, pc);
+                if (!mem) {
+                    return false;
+                }
+                u64 val = 0;
+                memcpy(&val, mem, size);
+                u32 shift = 64 - size * 8;
+                x[rd] = funct3 < 4 && shift ? (u64)((i64)(val << shift) >> shift) : val;
+                break;
+            }
+            case RV_STORE: {
+                u32 size = 1u << (funct3 & 3);
+                i64 imm_s = (i64)(i32)((inst & 0xFE000000) | ((inst >> 7) & 0x1F) << 20) >> 20;
+                u8* mem = rv_mem(program, x[rs1] + (u64)imm_s, size, true, pc);
+                if (!mem) {
+                    return false;
+                }
+                memcpy(mem, &x[rs2], size);
+                break;
+            }
+            case RV_LOAD_FP: {
+                u32 size = funct3 == 2 ? 4 : 8;
+                u8* mem = rv_mem(program, x[rs1] + (u64)imm, size, false, pc);
+                if (!mem) {
+                    return false;
+                }
+                u64 val = 0;
+                memcpy(&val, mem, size);
+                program->f[rd] = size == 4 ? 0xFFFFFFFF00000000ull | val : val;
+                break;
+            }
+            case RV_STORE_FP: {
+                u32 size = funct3 == 2 ? 4 : 8;
+                i64 imm_s = (i64)(i32)((inst & 0xFE000000) | ((inst >> 7) & 0x1F) << 20) >> 20;
+                u8* mem = rv_mem(program, x[rs1] + (u64)imm_s, size, true, pc);
+                if (!mem) {
+                    return false;
+                }
+                memcpy(mem, &program->f[rs2], size);
+                break;
+            }
+            case RV_OP_IMM: {
+                u64 a = x[rs1];
+                u32 shamt = (u32)imm & 63;
+                switch (funct3) {
+                    case 0: {
+                        x[rd] = a + (u64)imm;
+                        break;
+                    }
+                    case 1: {
+                        x[rd] = a << shamt;
+                        break;
+                    }
+                    case 2: {
+                        x[rd] = (i64)a < imm;
+                        break;
+                    }
+                    case 3: {
+                        x[rd] = a < (u64)imm;
+                        break;
+                    }
+                    case 4: {
+                        x[rd] = a ^ (u64)imm;
+                        break;
+                    }
+                    case 5: {
+                        x[rd] = (imm & 0x400) ? (u64)((i64)a >> shamt) : a >> shamt;
+                        break;
+                    }
+                    case 6: {
+                        x[rd] = a | (u64)imm;
+                        break;
+                    }
+                    default: {
+                        x[rd] = a & (u64)imm;
+                        break;
+                    }
+                }
+                break;
+            }
+            case RV_OP_IMM_32: {
+                u32 a = (u32)x[rs1];
+                u32 shamt = (u32)imm & 31;
+                u32 result = 0;
+                switch (funct3) {
+                    case 0: {
+                        result = a + (u32)imm;
+                        break;
+                    }
+                    case 1: {
+                        result = a << shamt;
+                        break;
+                    }
+                    case 5: {
+                        result = (imm & 0x400) ? (u32)((i32)a >> shamt) : a >> shamt;
+                        break;
+                    }
+                    default: {
+                        return rv_illegal(program, pc, inst);
+                    }
+                }
+                x[rd] = (u64)(i64)(i32)result;
+                break;
+            }
+            case RV_OP: {
+                u64 a = x[rs1];
+                u64 b = x[rs2];
+                if (funct7 == 1) {
+                    switch (funct3) {
+                        case 0: {
+                            x[rd] = a * b;
+                            break;
+                        }
+                        case 1: {
+                            x[rd] = rv_mulhu(a, b) - ((i64)a < 0 ? b : 0) - ((i64)b < 0 ? a : 0);
+                            break;
+                        }
+                        case 2: {
+                            x[rd] = rv_mulhu(a, b) - ((i64)a < 0 ? b : 0);
+                            break;
+                        }
+                        case 3: {
+                            x[rd] = rv_mulhu(a, b);
+                            break;
+                        }
+                        default: {
+                            x[rd] = rv_divide(funct3, a, b, false);
+                            break;
+                        }
+                    }
+                    break;
+                }
+                bool alt = funct7 == 0x20;
+                switch (funct3) {
+                    case 0: {
+                        x[rd] = alt ? a - b : a + b;
+                        break;
+                    }
+                    case 1: {
+                        x[rd] = a << (b & 63);
+                        break;
+                    }
+                    case 2: {
+                        x[rd] = (i64)a < (i64)b;
+                        break;
+                    }
+                    case 3: {
+                        x[rd] = a < b;
+                        break;
+                    }
+                    case 4: {
+                        x[rd] = a ^ b;
+                        break;
+                    }
+                    case 5: {
+                        x[rd] = alt ? (u64)((i64)a >> (b & 63)) : a >> (b & 63);
+                        break;
+                    }
+                    case 6: {
+                        x[rd] = a | b;
+                        break;
+                    }
+                    default: {
+                        x[rd] = a & b;
+                        break;
+                    }
+                }
+                break;
+            }
+            case RV_OP_32: {
+                u32 a = (u32)x[rs1];
+                u32 b = (u32)x[rs2];
+                u32 result = 0;
+                if (funct7 == 1 && funct3 >= 4) {
+                    x[rd] = rv_divide(funct3, a, b, true);
+                    break;
+                }
+                switch (funct3) {
+                    case 0: {
+                        result = funct7 == 1 ? a * b : funct7 == 0x20 ? a - b : a + b;
+                        break;
+                    }
+                    case 1: {
+                        result = a << (b & 31);
+                        break;
+                    }
+                    case 5: {
+                        result = funct7 == 0x20 ? (u32)((i32)a >> (b & 31)) : a >> (b & 31);
+                        break;
+                    }
+                    default: {
+                        return rv_illegal(program, pc, inst);
+                    }
+                }
+                x[rd] = (u64)(i64)(i32)result;
+                break;
+            }
+            case RV_OP_FP: {
+                if (!rv_exec_fp(program, pc, inst)) {
+                    return false;
+                }
+                break;
+            }
+            case RV_SYSTEM: {
+                if (inst != 0x73 || x[RV_A7] != RV_ECALL_EXIT) {
+                    return rv_illegal(program, pc, inst);
+                }
+                return true;
+            }
+            default: {
+                return rv_illegal(program, pc, inst);
+            }
+        }
+        x[0] = 0;
+        pc = next;
+    }
+}
+
+//*the code at the start of the image, where calls from the host return to
+Internal void rv_emit_exit() {
+    rv_li(RV_A7, RV_ECALL_EXIT);
+    rv_emit(0x73);
+}
+
+//*runs the code at entry with the argument registers already set
+Internal bool rv_call_at(RvProgram* program, u32 entry) {
+    program->error.clear();
+    program->x[RV_RA] = RV_BASE;
+    program->x[RV_SP] = RV_BASE + program->stack_top;
+    program->x[RV_FP] = 0;
+    return rv_run(program, RV_BASE + entry);
+}
+
+Internal void rv_patch_reloc(std::vector<u8>* image, u32 pos, u32 target) {
+    i64 delta = (i64)target - (i64)pos * 4;
+    i64 hi = (delta + 0x800) >> 12;
+    i64 lo = delta - hi * 4096;
+    u32 auipc;
+    u32 inst;
+    memcpy(&auipc, image->data() + pos * 4, sizeof(auipc));
+    memcpy(&inst, image->data() + pos * 4 + 4, sizeof(inst));
+    auipc = (auipc & 0xFFF) | ((u32)hi << 12);
+    inst = (inst & 0xFFFFF) | ((u32)lo & 0xFFF) << 20;
+    memcpy(image->data() + pos * 4, &auipc, sizeof(auipc));
+    memcpy(image->data() + pos * 4 + 4, &inst, sizeof(inst));
+}
+
+void rv_compile_package(RvProgram* program) {
+    rv_code.clear();
+    rv_relocs.clear();
+    rv_strings.clear();
+    rv_string_offsets.clear();
+    program->func_offsets.clear();
+    rv_emit_exit();
+
+    std::unordered_map<Sym*, u32> entries;
+    for (Sym* it : Global::syms) {
+        if (it->kind == SymKind::FUNC) {
+            //*no RVV in RV64IMFD, the IR stays scalar
+            IrFunc* func = vm_lower_func(it);
+            u32 entry = (u32)rv_code.size() * 4;
+            rv_compile_func(func);
+            program->func_offsets.push_back({ it, entry });
+            entries[it] = entry;
+        }
+    }
+    Sym init = {};
+    init.name = Global::string_table.add("global_init");
+    init.kind = SymKind::FUNC;
+    init.type = type_func(nullptr, 0, Global::type_void);
+    u32 init_entry = (u32)rv_code.size() * 4;
+    rv_compile_func(ir_lower_global_init(&init));
+
+    //*the image: code, strings, the stack and then the global vars
+    program->code_bytes = (u32)rv_code.size() * 4;
+    u32 strings = program->code_bytes;
+    program->stack_floor = (strings + (u32)rv_strings.size() + 15) / 16 * 16;
+    program->stack_top = program->stack_floor + RV_STACK_BYTES;
+    program->globals = program->stack_top;
+    program->global_offsets.clear();
+    u32 global_bytes = 0;
+    for (Sym* it : Global::syms) {
+        if (it->kind == SymKind::VAR) {
+            u32 align = it->type->align ? (u32)it->type->align : 1;
+            global_bytes = (global_bytes + align - 1) / align * align;
+            program->global_offsets.push_back({ it, global_bytes });
+            global_bytes += (u32)it->type->size;
+        }
+    }
+    program->memory.assign(program->globals + global_bytes, 0);
+    memcpy(program->memory.data(), rv_code.data(), program->code_bytes);
+    if (!rv_strings.empty()) {
+        memcpy(program->memory.data() + strings, rv_strings.data(), rv_strings.size());
+    }
+    for (RvReloc& it : rv_relocs) {
+        u32 target = 0;
+        if (it.target == RvTarget::STRING) {
+            target = strings + it.offset;
+        }
+        else if (it.target == RvTarget::GLOBAL) {
+            u8* addr = rv_global_addr(program, it.sym);
+            if (!addr) {
+                fatal("%s has no memory in the RV64 image", it.sym->name);
+            }
+            target = (u32)(addr - program->memory.data());
+        }
+        else {
+            auto entry = entries.find(it.sym);
+            if (entry == entries.end()) {
+                fatal("the RV64 backend has no code for %s", it.sym->name);
+            }
+            target = entry->second;
+        }
+        rv_patch_reloc(&program->memory, it.pos, target);
+    }
+    rv_code.clear();
+
+    program->steps = 0;
+    if (!rv_call_at(program, init_entry)) {
+        fatal("the initializers of the global vars failed: %s", program->error.c_str());
+    }
+}
+
+u8* rv_global_addr(RvProgram* program, Sym* sym) {
+    for (std::pair<Sym*, u32>& it : program->global_offsets) {
+        if (it.first == sym) {
+            return program->memory.data() + program->globals + it.second;
+        }
+    }
+    return nullptr;
+}
+
+bool rv_call(RvProgram* program, const char* name, const u64* args, u64* result) {
+    const char* interned = Global::string_table.add(name);
+    for (std::pair<Sym*, u32>& it : program->func_offsets) {
+        if (it.first->name != interned) {
+            continue;
+        }
+        Type* type = it.first->type;
+        std::vector<RvArg> placed;
+        rv_place_args(type->func.params, type->func.num_params, false, &placed);
+        for (size_t i = 0; i < placed.size(); i++) {
+            Type* param = type->func.params[i];
+            if (rv_is_aggregate(param) || placed[i].on_stack) {
+                program->error = "rv_call only passes scalars in registers";
+                return false;
+            }
+            if (placed[i].in_freg && param->kind == TypeKind::FLOAT) {
+                f64 val;
+                memcpy(&val, &args[i], sizeof(val));
+                rv_set_f32(program, placed[i].reg, (f32)val);
+            }
+            else if (placed[i].in_freg) {
+                program->f[placed[i].reg] = args[i];
+            }
+            else {
+                program->x[placed[i].reg] = args[i];
+            }
+        }
+        Type* ret = type->func.ret;
+        if (rv_is_aggregate(ret)) {
+            program->error = "rv_call only returns scalars";
+            return false;
+        }
+        if (!rv_call_at(program, it.second)) {
+            return false;
+        }
+        if (ret->kind == TypeKind::FLOAT) {
+            f64 val = rv_get_f32(program, RV_FA0);
+            memcpy(result, &val, sizeof(val));
+        }
+        else {
+            *result = is_floating_type(ret) ? program->f[RV_FA0] : program->x[RV_A0];
+        }
+        return true;
+    }
+    program->error = std::string("no func ") + name;
+    return false;
+}
+
+int rv_run_file(const char* path) {
+    Sym* main_sym = load_package_file(path) ? package_main_func(path) : nullptr;
+    if (!main_sym) {
+        return 1;
+    }
+    RvProgram program = {};
+    rv_compile_package(&program);
+    u64 result = 0;
+    if (!rv_call(&program, "main", nullptr, &result)) {
+        printf("%s\n", program.error.c_str());
+        return 1;
+    }
+    return main_sym->type->func.ret->kind == TypeKind::VOID ? 0 : (int)result;
+}
+
+Internal i64 rv_test_call(RvProgram* program, const char* name, i64 arg0, i64 arg1) {
+    u64 args[2] = { (u64)arg0, (u64)arg1 };
+    u64 result = 0;
+    bool ok = rv_call(program, name, args, &result);
+    if (!ok) {
+        printf("%s: %s\n", name, program->error.c_str());
+    }
+    assert(ok);
+    return (i64)result;
+}
+
+Internal void rv_test_package(const std::vector<u64>& expected) {
+    RvProgram program = {};
+    rv_compile_package(&program);
+
+    //*the corpus computes what the VM computes
+    for (size_t i = 0; i < vm_corpus_num_calls; i++) {
+        const VmCorpusCall* call = vm_corpus_calls + i;
+        Type* type = sym_get(Global::string_table.add(call->func))->type;
+        u64 args[2] = {};
+        for (size_t j = 0; j < type->func.num_params; j++) {
+            args[j] = vm_corpus_bits(type->func.params[j], call->args[j]);
+        }
+        u64 result = 0;
+        bool ok = rv_call(&program, call->func, args, &result);
+        assert(ok && vm_corpus_result(type->func.ret, result) == expected[i]);
+    }
+
+    //*faults stop the run with a message, division by zero does not trap on RISC-V
+    u64 args[2] = { 1, 0 };
+    u64 result = 0;
+    assert(rv_call(&program, "divide", args, &result) && (i64)result == -1);
+    assert(!rv_call(&program, "deep", args, &result));
+    assert(program.error.find("store to read-only memory") == 0);
+    assert(!rv_call(&program, "null_load", args, &result));
+    assert(program.error.find("load fault at 0x0") == 0);
+    assert(rv_test_call(&program, "fib", 10, 0) == 55);
+}
+
+void rv_test() {
+    //*encodings from the ISA manual
+    assert(rv_encode_i(RV_OP_IMM, 0, RV_A0, RV_A0, 1) == 0x00150513);
+    assert(rv_encode_r(RV_OP, 0, 0x20, RV_A0, RV_A0, RV_A1) == 0x40b50533);
+    assert(rv_encode_s(RV_STORE, 3, RV_SP, RV_RA, 8) == 0x00113423);
+    assert(rv_encode_b(1, RV_A0, RV_ZERO, -8) == 0xfe051ce3);
+    assert(rv_encode_u(RV_LUI, RV_A0, 0x12345000) == 0x12345537);
+    assert(rv_encode_j(RV_RA, 2048) == 0x001000ef);
+    assert(rv_encode_i(RV_JALR, 0, RV_ZERO, RV_RA, 0) == 0x00008067);
+
+    //*constants of every width load back exactly
+    i64 consts[] = { 0, -1, 2047, -2048, 2048, 0x7FFFFFFF, -0x80000000ll, 0x7FFFF800, 0x123456789ll, INT64_MAX, INT64_MIN,
+                     (i64)0xDEADBEEFCAFEF00Dull, (i64)0x8000000080000000ull };
+    for (i64 it : consts) {
+        RvProgram program = {};
+        rv_code.clear();
+        rv_li(RV_A0, it);
+        rv_emit_exit();
+        program.code_bytes = (u32)rv_code.size() * 4;
+        program.stack_floor = program.code_bytes;
+        program.stack_top = program.code_bytes;
+        program.memory.assign(program.code_bytes, 0);
+        memcpy(program.memory.data(), rv_code.data(), program.code_bytes);
+        assert(rv_call_at(&program, 0) && (i64)program.x[RV_A0] == it);
+        assert(program.steps <= 10);
+    }
+    rv_code.clear();
+
+    //*loads through a null pointer fault, on top of the corpus
+    vm_corpus_load("func null_load(n: int): int { var p: int* = 0\n return *p; }\n");
+    std::vector<u64> expected = vm_corpus_results();
+    rv_test_package(expected);
+    //*and the IR as lowered, where params and loop variables feed phis directly
+    Global::ir_passes = 0;
+    rv_test_package(expected);
+    Global::ir_passes = 0xFFFFFFFF;
+
+    //*with two registers of each class values are split and reloaded, and with none at all every value stays in its slot
+    const RaReg int_regs[] = { { 9, true }, { 10, false } };
+    const RaReg float_regs[] = { { 8, true }, { 2, false } };
+    const RaTarget narrow = { "narrow", { int_regs, float_regs }, { 2, 2 } };
+    rv_target = &narrow;
+    rv_test_package(expected);
+    rv_target = &rv_ra_target;
+    Global::native_regalloc = false;
+    rv_test_package(expected);
+    Global::native_regalloc = true;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Ir.hpp"
+
+//*RV64IMFD machine code compiled from the optimized IR, and a simulator that runs it on any host. the code is a flat
+//*image mapped at RV_BASE: the funcs, then the string literals, then the stack, then the global vars. calls follow the
+//*LP64D convention for scalars, integers and pointers in a0..a7 and floats and doubles in fa0..fa7 with the rest on
+//*the stack, while aggregates always travel as the address of a copy the caller makes and are returned through a
+//*hidden pointer in a0. like the JIT, every IR value has a stack slot in its frame and is held in a register where the
+//*allocator of RegAlloc.hpp gives it one. the simulated hart has no V extension, so the IR is optimized without the
+//*vectorizer and loops compile to scalar code like the VM runs
+
+//*address of the first byte of the image, the pages below it stay unmapped so that null pointers fault
+constexpr u64 RV_BASE = 0x10000;
+
+//*a compiled package and the state of the hart that runs it
+struct RvProgram {
+    std::vector<u8> memory; //*the image
+    u32 code_bytes;
+    u32 stack_floor; //*offsets below this are read only, a store there is most likely a stack overflow
+    u32 stack_top;
+    u32 globals; //*offset of the first global var
+    std::vector<std::pair<Sym*, u32>> func_offsets; //*entry of each func in the image
+    std::vector<std::pair<Sym*, u32>> global_offsets; //*from globals
+    u64 x[32]; //*integer registers, x[0] is always zero
+    u64 f[32]; //*float registers, a float is NaN-boxed in the low half
+    u64 max_steps; //*instructions a call may run, 0 before compiling takes no limit
+    u64 steps; //*instructions run by every call so far
+    std::string error; //*why the last call failed
+};
+
+//*the 32-bit encodings of the instructions the compiler emits, exposed for the tests
+u32 rv_encode_i(u32 opcode, u32 funct3, u32 rd, u32 rs1, i32 imm);
+u32 rv_encode_r(u32 opcode, u32 funct3, u32 funct7, u32 rd, u32 rs1, u32 rs2);
+u32 rv_encode_s(u32 opcode, u32 funct3, u32 rs1, u32 rs2, i32 imm);
+u32 rv_encode_b(u32 funct3, u32 rs1, u32 rs2, i32 offset);
+u32 rv_encode_u(u32 opcode, u32 rd, i32 imm);
+u32 rv_encode_j(u32 rd, i32 offset);
+
+//*compiles every func of the resolved package and runs the initializers of the global vars in the simulator
+void rv_compile_package(RvProgram* program);
+
+u8* rv_global_addr(RvProgram* program, Sym* sym);
+
+//*runs the func on arguments held like VM registers, integers extended to 64 bits and floats as doubles, and stores
+//*its result the same way. the func may only take and return scalars. false with program->error set when the code
+//*faults, runs an illegal instruction or runs more than max_steps instructions
+bool rv_call(RvProgram* program, const char* name, const u64* args, u64* result);
+
+//*parses, checks, compiles and simulates main of the file, its result is the exit status
+int rv_run_file(const char* path);
+
+void rv_test();
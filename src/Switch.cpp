@@ -0,0 +1,302 @@
+#include <cassert>
+#include <algorithm>
+#include "Switch.hpp"
+
+//*a jump table needs at least this many clusters and this density of covered keys, and is capped in size
+Internal constexpr size_t SWITCH_MIN_TABLE_CLUSTERS = 4;
+Internal constexpr u64 SWITCH_MIN_TABLE_DENSITY = 40; //*percent
+Internal constexpr u64 SWITCH_MAX_TABLE_SIZE = 1 << 16;
+
+//*a bit test replaces this many cluster compares, indexed by its number of targets
+Internal constexpr size_t switch_min_bit_test_clusters[] = { 0, 3, 5, 6 };
+Internal constexpr size_t SWITCH_MAX_BIT_TEST_TARGETS = 3;
+
+//*chains at the leaves of the tree are at most this long
+Internal constexpr size_t SWITCH_MAX_CHAIN = 3;
+
+u64 switch_key(i64 val, bool is_signed) {
+    return is_signed ? (u64)val ^ 0x8000000000000000ull : (u64)val;
+}
+
+i64 switch_key_val(u64 key, bool is_signed) {
+    return (i64)(is_signed ? key ^ 0x8000000000000000ull : key);
+}
+
+Internal bool switch_label_less(const SwitchLabel& left, const SwitchLabel& right) {
+    return left.key < right.key;
+}
+
+Internal SwitchNode switch_node(SwitchNodeKind kind, u64 lo, u64 hi) {
+    SwitchNode node = {};
+    node.kind = kind;
+    node.lo = lo;
+    node.hi = hi;
+    node.target = SWITCH_DEFAULT;
+    node.next = SWITCH_DEFAULT;
+    node.left = SWITCH_DEFAULT;
+    node.right = SWITCH_DEFAULT;
+    return node;
+}
+
+//*end of the longest run of ranges from first that is dense enough for a table, first when there is none
+Internal size_t find_jump_table(const std::vector<SwitchNode>& ranges, size_t first) {
+    size_t best = first;
+    u64 covered = 0;
+    for (size_t last = first; last < ranges.size(); last++) {
+        u64 span = ranges[last].hi - ranges[first].lo;
+        if (span >= SWITCH_MAX_TABLE_SIZE) {
+            break;
+        }
+
+        covered += ranges[last].hi - ranges[last].lo + 1;
+        if (last + 1 - first >= SWITCH_MIN_TABLE_CLUSTERS && covered * 100 >= (span + 1) * SWITCH_MIN_TABLE_DENSITY) {
+            best = last + 1;
+        }
+    }
+
+    return best;
+}
+
+//*end of the longest run of ranges from first within one 64 bit window that is worth testing with masks
+Internal size_t find_bit_test(const std::vector<SwitchNode>& ranges, size_t first) {
+    size_t best = first;
+    u32 targets[SWITCH_MAX_BIT_TEST_TARGETS];
+    size_t num_targets = 0;
+    for (size_t last = first; last < ranges.size() && ranges[last].hi - ranges[first].lo < 64; last++) {
+        u32* end = targets + num_targets;
+        if (std::find(targets, end, ranges[last].target) == end) {
+            if (num_targets == SWITCH_MAX_BIT_TEST_TARGETS) {
+                break;
+            }
+            targets[num_targets++] = ranges[last].target;
+        }
+
+        if (last + 1 - first >= switch_min_bit_test_clusters[num_targets]) {
+            best = last + 1;
+        }
+    }
+
+    return best;
+}
+
+Internal SwitchNode plan_jump_table(SwitchPlan* plan, const std::vector<SwitchNode>& ranges, size_t first, size_t end) {
+    SwitchNode node = switch_node(SwitchNodeKind::JUMP_TABLE, ranges[first].lo, ranges[end - 1].hi);
+    node.first = (u32)plan->table.size();
+    node.count = (u32)(node.hi - node.lo + 1);
+    plan->table.resize(plan->table.size() + node.count, SWITCH_DEFAULT);
+    for (size_t i = first; i < end; i++) {
+        for (u64 key = ranges[i].lo - node.lo; key <= ranges[i].hi - node.lo; key++) {
+            plan->table[node.first + key] = ranges[i].target;
+        }
+    }
+
+    return node;
+}
+
+Internal SwitchNode plan_bit_test(SwitchPlan* plan, const std::vector<SwitchNode>& ranges, size_t first, size_t end) {
+    SwitchNode node = switch_node(SwitchNodeKind::BIT_TEST, ranges[first].lo, ranges[end - 1].hi);
+    node.first = (u32)plan->tests.size();
+    for (size_t i = first; i < end; i++) {
+        SwitchBitTest* test = nullptr;
+        for (size_t j = node.first; j < plan->tests.size(); j++) {
+            if (plan->tests[j].target == ranges[i].target) {
+                test = &plan->tests[j];
+            }
+        }
+        if (!test) {
+            plan->tests.push_back(SwitchBitTest{ 0, ranges[i].target });
+            test = &plan->tests.back();
+        }
+
+        for (u64 bit = ranges[i].lo - node.lo; bit <= ranges[i].hi - node.lo; bit++) {
+            test->mask |= 1ull << bit;
+        }
+    }
+    node.count = (u32)(plan->tests.size() - node.first);
+
+    return node;
+}
+
+//*balanced on the number of clusters, short runs are tested in a chain
+Internal u32 plan_tree(SwitchPlan* plan, const std::vector<SwitchNode>& clusters, size_t first, size_t end) {
+    if (end - first <= SWITCH_MAX_CHAIN) {
+        u32 next = SWITCH_DEFAULT;
+        for (size_t i = end; i > first; i--) {
+            plan->nodes.push_back(clusters[i - 1]);
+            plan->nodes.back().next = next;
+            next = (u32)plan->nodes.size() - 1;
+        }
+        return next;
+    }
+
+    size_t mid = first + (end - first) / 2;
+    u32 node = (u32)plan->nodes.size();
+    plan->nodes.push_back(switch_node(SwitchNodeKind::LESS, clusters[mid].lo, clusters[mid].lo));
+    u32 left = plan_tree(plan, clusters, first, mid);
+    u32 right = plan_tree(plan, clusters, mid, end);
+    plan->nodes[node].left = left;
+    plan->nodes[node].right = right;
+    return node;
+}
+
+SwitchPlan plan_switch(std::vector<SwitchLabel> labels, bool linear) {
+    SwitchPlan plan;
+    plan.root = SWITCH_DEFAULT;
+    if (linear) {
+        for (size_t i = 0; i < labels.size(); i++) {
+            plan.nodes.push_back(switch_node(SwitchNodeKind::RANGE, labels[i].key, labels[i].key));
+            plan.nodes.back().target = labels[i].target;
+            plan.nodes.back().next = i + 1 < labels.size() ? (u32)i + 1 : SWITCH_DEFAULT;
+        }
+        plan.root = labels.empty() ? SWITCH_DEFAULT : 0;
+        return plan;
+    }
+
+    std::sort(labels.begin(), labels.end(), switch_label_less);
+
+    //*consecutive keys with one target become one range
+    std::vector<SwitchNode> ranges;
+    for (SwitchLabel& it : labels) {
+        assert(ranges.empty() || ranges.back().hi < it.key);
+        if (!ranges.empty() && ranges.back().target == it.target && ranges.back().hi + 1 == it.key) {
+            ranges.back().hi = it.key;
+        }
+        else {
+            ranges.push_back(switch_node(SwitchNodeKind::RANGE, it.key, it.key));
+            ranges.back().target = it.target;
+        }
+    }
+
+    //*greedy from the lowest key, a table takes the longest dense run, a bit test the longest run in one window
+    std::vector<SwitchNode> clusters;
+    for (size_t i = 0; i < ranges.size();) {
+        size_t end = find_jump_table(ranges, i);
+        if (end > i) {
+            clusters.push_back(plan_jump_table(&plan, ranges, i, end));
+            i = end;
+            continue;
+        }
+
+        end = find_bit_test(ranges, i);
+        if (end > i) {
+            clusters.push_back(plan_bit_test(&plan, ranges, i, end));
+            i = end;
+            continue;
+        }
+
+        clusters.push_back(ranges[i]);
+        i++;
+    }
+
+    plan.root = clusters.empty() ? SWITCH_DEFAULT : plan_tree(&plan, clusters, 0, clusters.size());
+    return plan;
+}
+
+//*walks the plan like generated code would
+Internal u32 switch_test_dispatch(const SwitchPlan& plan, u64 key) {
+    u32 it = plan.root;
+    while (it != SWITCH_DEFAULT) {
+        const SwitchNode& node = plan.nodes[it];
+        if (node.kind == SwitchNodeKind::LESS) {
+            it = key < node.lo ? node.left : node.right;
+            continue;
+        }
+        if (key - node.lo <= node.hi - node.lo) {
+            switch (node.kind) {
+                case SwitchNodeKind::RANGE: {
+                    return node.target;
+                }
+                case SwitchNodeKind::JUMP_TABLE: {
+                    return plan.table[node.first + key - node.lo];
+                }
+                case SwitchNodeKind::BIT_TEST: {
+                    for (u32 i = node.first; i < node.first + node.count; i++) {
+                        if (plan.tests[i].mask & (1ull << (key - node.lo))) {
+                            return plan.tests[i].target;
+                        }
+                    }
+                    break;
+                }
+                default: {
+                    assert(false);
+                    break;
+                }
+            }
+        }
+        it = node.next;
+    }
+
+    return SWITCH_DEFAULT;
+}
+
+Internal void switch_test_check(const std::vector<SwitchLabel>& labels, u64 lo, u64 hi) {
+    SwitchPlan plans[] = { plan_switch(labels, false), plan_switch(labels, true) };
+    for (SwitchPlan& plan : plans) {
+        for (u64 key = lo; key != hi + 1; key++) {
+            u32 expected = SWITCH_DEFAULT;
+            for (const SwitchLabel& it : labels) {
+                if (it.key == key) {
+                    expected = it.target;
+                }
+            }
+            assert(switch_test_dispatch(plan, key) == expected);
+        }
+    }
+}
+
+void switch_test() {
+    //*keys keep the order of the values
+    assert(switch_key(-1, true) < switch_key(0, true) && switch_key(0, true) < switch_key(1, true));
+    assert(switch_key_val(switch_key(-5, true), true) == -5 && switch_key(-1, false) == ~0ull);
+
+    //*dense labels are one table
+    std::vector<SwitchLabel> dense;
+    for (u32 i = 0; i < 32; i++) {
+        dense.push_back(SwitchLabel{ 100 + i, i % 7 });
+    }
+    SwitchPlan plan = plan_switch(dense, false);
+    assert(plan.nodes.size() == 1 && plan.nodes[plan.root].kind == SwitchNodeKind::JUMP_TABLE && plan.table.size() == 32);
+    switch_test_check(dense, 90, 140);
+
+    //*a run of one target is one range, however long
+    std::vector<SwitchLabel> run;
+    for (u32 i = 0; i < 1000; i++) {
+        run.push_back(SwitchLabel{ i, 0 });
+    }
+    plan = plan_switch(run, false);
+    assert(plan.nodes.size() == 1 && plan.nodes[plan.root].kind == SwitchNodeKind::RANGE && plan.nodes[plan.root].hi == 999);
+
+    //*vowels to one target, digits to another
+    std::vector<SwitchLabel> chars;
+    for (const char* it = "aeiou"; *it; it++) {
+        chars.push_back(SwitchLabel{ (u64)*it, 0 });
+    }
+    chars.push_back(SwitchLabel{ 'y', 1 });
+    plan = plan_switch(chars, false);
+    assert(plan.nodes.size() == 1 && plan.nodes[plan.root].kind == SwitchNodeKind::BIT_TEST && plan.tests.size() == 2);
+    switch_test_check(chars, 0, 255);
+
+    //*sparse labels are a search tree
+    std::vector<SwitchLabel> sparse;
+    for (u32 i = 0; i < 64; i++) {
+        sparse.push_back(SwitchLabel{ switch_key((i64)i * 1000 - 30000, true), i });
+    }
+    plan = plan_switch(sparse, false);
+    assert(plan.nodes[plan.root].kind == SwitchNodeKind::LESS && plan.table.empty() && plan.tests.empty());
+    switch_test_check(sparse, switch_key(-31000, true), switch_key(34000, true));
+
+    //*the baseline is one compare per label in source order
+    plan = plan_switch(sparse, true);
+    assert(plan.nodes.size() == 64 && plan.root == 0 && plan.nodes[63].next == SWITCH_DEFAULT);
+
+    //*mixed, a table in the middle of sparse labels
+    std::vector<SwitchLabel> mixed = sparse;
+    for (u32 i = 0; i < 20; i++) {
+        mixed.push_back(SwitchLabel{ switch_key(500 + 2 * i, true), 100 + i });
+    }
+    plan = plan_switch(mixed, false);
+    assert(plan.table.size() == 39);
+    switch_test_check(mixed, switch_key(-100, true), switch_key(2100, true));
+
+    assert(plan_switch(std::vector<SwitchLabel>(), false).root == SWITCH_DEFAULT);
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <vector>
+#include <types.hpp>
+
+//*a switch is dispatched by a small decision tree over its case labels instead of a chain of compares. the labels
+//*are bucketed into clusters, runs of consecutive values with one target, dense jump tables, and bit tests that
+//*check a value against the label sets of up to three targets with one mask each. the clusters are then split into
+//*a balanced tree of less-than compares with short chains of clusters at the leaves.
+
+//*labels are ordered by key, the value reinterpreted so that unsigned order on keys is the order of the values
+struct SwitchLabel {
+    u64 key;
+    u32 target;
+};
+
+enum class SwitchNodeKind {
+    RANGE, //*keys lo..hi go to target
+    JUMP_TABLE, //*key lo + i goes to table[first + i], keys lo..hi
+    BIT_TEST, //*key lo + i goes to the target of the first test in tests[first..first + count) with bit i set, keys lo..hi
+    LESS, //*keys below lo continue at left, the others at right
+};
+
+//*node index of the default target, also the target of jump table holes
+constexpr u32 SWITCH_DEFAULT = 0xFFFFFFFF;
+
+struct SwitchNode {
+    SwitchNodeKind kind;
+    u64 lo;
+    u64 hi;
+    u32 target;
+    u32 first;
+    u32 count;
+    u32 next; //*leaves continue here when the key misses them
+    u32 left;
+    u32 right;
+};
+
+struct SwitchBitTest {
+    u64 mask;
+    u32 target;
+};
+
+struct SwitchPlan {
+    std::vector<SwitchNode> nodes;
+    std::vector<u32> table;
+    std::vector<SwitchBitTest> tests;
+    u32 root; //*SWITCH_DEFAULT for a switch without labels
+};
+
+u64 switch_key(i64 val, bool is_signed);
+i64 switch_key_val(u64 key, bool is_signed);
+
+//*keys must be unique. linear plans the baseline, one single-key RANGE per label in the order given
+SwitchPlan plan_switch(std::vector<SwitchLabel> labels, bool linear);
+
+void switch_test();
@@ -0,0 +1,408 @@
+#include "Visit.hpp"
+#include "MemArena.hpp"
+#include "Parse.hpp"
+#include "Globals.hpp"
+#include <cassert>
+#include <vector>
+#include <algorithm>
+
+AstNode ast_node(Typespec* typespec) {
+    AstNode node;
+    node.kind = AstNodeKind::TYPESPEC;
+    node.typespec = typespec;
+    return node;
+}
+
+AstNode ast_node(Expr* expr) {
+    AstNode node;
+    node.kind = AstNodeKind::EXPR;
+    node.expr = expr;
+    return node;
+}
+
+AstNode ast_node(Stmt* stmt) {
+    AstNode node;
+    node.kind = AstNodeKind::STMT;
+    node.stmt = stmt;
+    return node;
+}
+
+AstNode ast_node(Decl* decl) {
+    AstNode node;
+    node.kind = AstNodeKind::DECL;
+    node.decl = decl;
+    return node;
+}
+
+//*calls add(ctx, child) for every non-null child of node in source order, shared by both walks so they cannot disagree
+template<typename F>
+Internal void for_each_child(AstNode node, F add) {
+    auto add_block = [&](StmtBlock block) {
+        for (Stmt** it = block.stmts; it != block.stmts + block.num_stmts; it++) {
+            add(ast_node(*it));
+        }
+    };
+    auto add_exprs = [&](Expr** exprs, size_t num_exprs) {
+        for (Expr** it = exprs; it != exprs + num_exprs; it++) {
+            add(ast_node(*it));
+        }
+    };
+    auto add_opt = [&](AstNode child) {
+        if (child.expr) {
+            add(child);
+        }
+    };
+
+    switch (node.kind) {
+        case AstNodeKind::TYPESPEC: {
+            Typespec* t = node.typespec;
+            switch (t->kind) {
+                case TypespecKind::FUNC: {
+                    for (Typespec** it = t->func.args; it != t->func.args + t->func.num_args; it++) {
+                        add(ast_node(*it));
+                    }
+                    add_opt(ast_node(t->func.ret));
+                    break;
+                }
+                case TypespecKind::ARRAY: {
+                    add(ast_node(t->array.elem));
+                    add_opt(ast_node(t->array.size));
+                    break;
+                }
+                case TypespecKind::PTR: {
+                    add(ast_node(t->ptr.elem));
+                    break;
+                }
+                default: {
+                    break;
+                }
+            }
+            break;
+        }
+        case AstNodeKind::EXPR: {
+            Expr* e = node.expr;
+            switch (e->kind) {
+                case ExprKind::CAST: {
+                    add(ast_node(e->cast.type));
+                    add(ast_node(e->cast.expr));
+                    break;
+                }
+                case ExprKind::CALL: {
+                    add(ast_node(e->call.expr));
+                    add_exprs(e->call.args, e->call.num_args);
+                    break;
+                }
+                case ExprKind::INDEX: {
+                    add(ast_node(e->index.expr));
+                    add(ast_node(e->index.index));
+                    break;
+                }
+                case ExprKind::FIELD: {
+                    add(ast_node(e->field.expr));
+                    break;
+                }
+                case ExprKind::COMPOUND: {
+                    add_opt(ast_node(e->compound.type));
+                    add_exprs(e->compound.args, e->compound.num_args);
+                    break;
+                }
+                case ExprKind::UNARY: {
+                    add(ast_node(e->unary.expr));
+                    break;
+                }
+                case ExprKind::BINARY: {
+                    add(ast_node(e->binary.left));
+                    add(ast_node(e->binary.right));
+                    break;
+                }
+                case ExprKind::TERNARY: {
+                    add(ast_node(e->ternary.cond));
+                    add(ast_node(e->ternary.then_expr));
+                    add(ast_node(e->ternary.else_expr));
+                    break;
+                }
+                case ExprKind::SIZEOF_EXPR: {
+                    add(ast_node(e->sizeof_expr));
+                    break;
+                }
+                case ExprKind::SIZEOF_TYPE: {
+                    add(ast_node(e->sizeof_type));
+                    break;
+                }
+                default: {
+                    break;
+                }
+            }
+            break;
+        }
+        case AstNodeKind::STMT: {
+            Stmt* s = node.stmt;
+            switch (s->kind) {
+                case StmtKind::DECL: {
+                    add(ast_node(s->decl));
+                    break;
+                }
+                case StmtKind::RETURN:
+                case StmtKind::EXPR: {
+                    add_opt(ast_node(s->expr));
+                    break;
+                }
+                case StmtKind::BLOCK: {
+                    add_block(s->block);
+                    break;
+                }
+                case StmtKind::IF: {
+                    add(ast_node(s->if_stmt.cond));
+                    add_block(s->if_stmt.then_block);
+                    for (ElseIf* it = s->if_stmt.elseifs; it != s->if_stmt.elseifs + s->if_stmt.num_elseifs; it++) {
+                        add(ast_node(it->cond));
+                        add_block(it->block);
+                    }
+                    add_block(s->if_stmt.else_block);
+                    break;
+                }
+                case StmtKind::WHILE:
+                case StmtKind::DO_WHILE: {
+                    add(ast_node(s->while_stmt.cond));
+                    add_block(s->while_stmt.block);
+                    break;
+                }
+                case StmtKind::FOR: {
+                    add_opt(ast_node(s->for_stmt.init));
+                    add_opt(ast_node(s->for_stmt.cond));
+                    add_opt(ast_node(s->for_stmt.next));
+                    add_block(s->for_stmt.block);
+                    break;
+                }
+                case StmtKind::SWITCH: {
+                    add(ast_node(s->switch_stmt.expr));
+                    for (SwitchCase* it = s->switch_stmt.cases; it != s->switch_stmt.cases + s->switch_stmt.num_cases; it++) {
+                        add_exprs(it->exprs, it->num_exprs);
+                        add_block(it->block);
+                    }
+                    break;
+                }
+                case StmtKind::ASSIGN: {
+                    add(ast_node(s->assign.left));
+                    add_opt(ast_node(s->assign.right));
+                    break;
+                }
+                case StmtKind::INIT: {
+                    add(ast_node(s->init.expr));
+                    break;
+                }
+                default: {
+                    break;
+                }
+            }
+            break;
+        }
+        case AstNodeKind::DECL: {
+            Decl* d = node.decl;
+            switch (d->kind) {
+                case DeclKind::ENUM: {
+                    for (EnumItem* it = d->enum_decl.items; it != d->enum_decl.items + d->enum_decl.num_items; it++) {
+                        add_opt(ast_node(it->init));
+                    }
+                    break;
+                }
+                case DeclKind::STRUCT:
+                case DeclKind::UNION: {
+                    for (AggregateItem* it = d->aggregate.items; it != d->aggregate.items + d->aggregate.num_items; it++) {
+                        add(ast_node(it->type));
+                    }
+                    break;
+                }
+                case DeclKind::VAR: {
+                    add_opt(ast_node(d->var.type));
+                    add_opt(ast_node(d->var.expr));
+                    break;
+                }
+                case DeclKind::CONST: {
+                    add(ast_node(d->const_decl.expr));
+                    break;
+                }
+                case DeclKind::TYPEDEF: {
+                    add(ast_node(d->typedef_decl.type));
+                    break;
+                }
+                case DeclKind::FUNC: {
+                    for (FuncParam* it = d->func.params; it != d->func.params + d->func.num_params; it++) {
+                        add(ast_node(it->type));
+                    }
+                    add_opt(ast_node(d->func.ret_type));
+                    add_block(materialize_func_body(d));
+                    break;
+                }
+                default: {
+                    break;
+                }
+            }
+            break;
+        }
+    }
+}
+
+//*a frame is visited twice: entered (pre, then its children are pushed) and exited (post)
+struct VisitFrame {
+    AstNode node;
+    bool exit;
+};
+
+Internal constexpr size_t VISIT_STACK_MIN_FRAMES = 1024;
+
+//*contiguous stack grown by doubling into an arena. it is shared by all walks on a thread and never shrinks, so its pages
+//*stay warm across walks. a walk nested in a hook runs on top of the frames of the walk that called it.
+struct VisitStack {
+    Arena arena;
+    VisitFrame* frames;
+    size_t num_frames;
+    size_t max_frames;
+
+    void push(AstNode node, bool exit) {
+        if (num_frames == max_frames) {
+            size_t new_max_frames = max_frames ? 2 * max_frames : VISIT_STACK_MIN_FRAMES;
+            VisitFrame* new_frames = (VisitFrame*)arena.alloc(new_max_frames * sizeof(VisitFrame));
+            if (num_frames) {
+                memcpy(new_frames, frames, num_frames * sizeof(VisitFrame));
+            }
+            frames = new_frames;
+            max_frames = new_max_frames;
+        }
+
+        frames[num_frames++] = VisitFrame{node, exit};
+    }
+};
+
+GlobalVariable thread_local VisitStack visit_stack;
+
+void ast_walk(AstVisitor* visitor, AstNode root) {
+    VisitStack& stack = visit_stack;
+    size_t base = stack.num_frames;
+    stack.push(root, false);
+
+    while (stack.num_frames != base) {
+        VisitFrame frame = stack.frames[--stack.num_frames];
+        if (frame.exit) {
+            visitor->post(visitor->ctx, frame.node);
+            continue;
+        }
+
+        if (visitor->pre && !visitor->pre(visitor->ctx, frame.node)) {
+            continue;
+        }
+
+        if (visitor->post) {
+            stack.push(frame.node, true);
+        }
+
+        //*children are pushed in source order then flipped in place so they pop in source order
+        size_t first_child = stack.num_frames;
+        for_each_child(frame.node, [&](AstNode child) { stack.push(child, false); });
+        std::reverse(stack.frames + first_child, stack.frames + stack.num_frames);
+    }
+}
+
+void ast_walk_recursive(AstVisitor* visitor, AstNode root) {
+    if (visitor->pre && !visitor->pre(visitor->ctx, root)) {
+        return;
+    }
+
+    for_each_child(root, [&](AstNode child) { ast_walk_recursive(visitor, child); });
+
+    if (visitor->post) {
+        visitor->post(visitor->ctx, root);
+    }
+}
+
+struct VisitEvent {
+    bool post;
+    void* node;
+};
+
+struct VisitLog {
+    std::vector<VisitEvent> events;
+    bool skip_binary;
+};
+
+Internal bool log_pre(void* ctx, AstNode node) {
+    VisitLog* log = (VisitLog*)ctx;
+    log->events.push_back(VisitEvent{false, node.expr});
+    return !(log->skip_binary && node.kind == AstNodeKind::EXPR && node.expr->kind == ExprKind::BINARY);
+}
+
+Internal void log_post(void* ctx, AstNode node) {
+    VisitLog* log = (VisitLog*)ctx;
+    log->events.push_back(VisitEvent{true, node.expr});
+}
+
+//*differential check of the iterative walk against the recursive reference
+Internal void visit_check(AstNode root, bool skip_binary) {
+    VisitLog iterative = {};
+    VisitLog recursive = {};
+    iterative.skip_binary = skip_binary;
+    recursive.skip_binary = skip_binary;
+
+    AstVisitor iterative_visitor = { &iterative, log_pre, log_post };
+    AstVisitor recursive_visitor = { &recursive, log_pre, log_post };
+    ast_walk(&iterative_visitor, root);
+    ast_walk_recursive(&recursive_visitor, root);
+
+    assert(iterative.events.size() == recursive.events.size());
+    for (size_t i = 0; i < iterative.events.size(); i++) {
+        assert(iterative.events[i].post == recursive.events[i].post && iterative.events[i].node == recursive.events[i].node);
+    }
+}
+
+Internal bool count_pre(void* ctx, AstNode node) {
+    (*(size_t*)ctx)++;
+    return true;
+}
+
+//*counts the nodes under every binary expression with a nested walk
+Internal bool nested_pre(void* ctx, AstNode node) {
+    if (node.kind == AstNodeKind::EXPR && node.expr->kind == ExprKind::BINARY) {
+        AstVisitor counter = { ctx, count_pre, nullptr };
+        ast_walk(&counter, node);
+    }
+    return true;
+}
+
+void visit_test() {
+    const char* src =
+        "const n = sizeof(:int*[16])\n"
+        "var x = b == 1 ? 1+2 : 3-4\n"
+        "func fact(n: int): int { p := 1; for (i := 1; i <= n; i++) { p *= i; } return p; }\n"
+        "func f(x: int): bool { switch(x) { case 0: case 1: return true; case 2: default: return false; } }\n"
+        "func g(v: Vector*) { if (v.x) { print(\"x\", v[0]); } else if (2) { return; } else { do { v.y--; } while (1); } }\n"
+        "enum Color { RED = 3, GREEN, BLUE = 0 }\n"
+        "struct Vector { x, y: float; }\n"
+        "typedef T = (func(int, Vector):int)[16]\n"
+        "var v: Vector = (:Vector){1.0, -1.0}\n";
+
+    std::vector<Decl*> decls = parse_file("visit_test.sorin", src);
+    assert(Global::diagnostics.empty());
+    for (Decl* decl : decls) {
+        visit_check(ast_node(decl), false);
+        visit_check(ast_node(decl), true);
+    }
+
+    //*fact: decl, 2 typespecs, p := 1 (2), for (1) with i := 1 (2), i <= n (3), i++ (2), p *= i (3), return p (2)
+    size_t count = 0;
+    AstVisitor counter = { &count, count_pre, nullptr };
+    ast_walk(&counter, ast_node(decls[2]));
+    assert(count == 18);
+
+    //*walks nested in hooks share the stack with the walk that runs them
+    count = 0;
+    AstVisitor nested = { &count, nested_pre, nullptr };
+    ast_walk(&nested, ast_node(parse_file("visit_nested.sorin", "const n = (1 + 2) * 3")[0]));
+    assert(count == 5 + 3);
+
+    //*deep enough to grow the stack a few times
+    Expr* chain = expr_int(0);
+    for (int i = 0; i < 8 * (int)VISIT_STACK_MIN_FRAMES; i++) {
+        chain = expr_binary(TokenKind::ADD, chain, expr_int(i));
+    }
+    visit_check(ast_node(chain), false);
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "Ast.hpp"
+
+enum class AstNodeKind {
+    TYPESPEC,
+    EXPR,
+    STMT,
+    DECL,
+};
+
+struct AstNode {
+    AstNodeKind kind;
+    union {
+        Typespec* typespec;
+        Expr* expr;
+        Stmt* stmt;
+        Decl* decl;
+    };
+};
+
+AstNode ast_node(Typespec* typespec);
+AstNode ast_node(Expr* expr);
+AstNode ast_node(Stmt* stmt);
+AstNode ast_node(Decl* decl);
+
+//*pre runs before a node's children and returns false to skip them, post runs after them. either hook may be null.
+//*children are visited in source order, the order print_decl prints them.
+typedef bool (*VisitPreFunc)(void* ctx, AstNode node);
+typedef void (*VisitPostFunc)(void* ctx, AstNode node);
+
+struct AstVisitor {
+    void* ctx;
+    VisitPreFunc pre;
+    VisitPostFunc post;
+};
+
+//*walks the tree under root on an explicit arena-backed stack, nesting depth is bounded by memory instead of the call stack
+void ast_walk(AstVisitor* visitor, AstNode root);
+
+//*reference walk by plain recursion, same hook order as ast_walk
+void ast_walk_recursive(AstVisitor* visitor, AstNode root);
+
+void visit_test();
@@ -0,0 +1,1829 @@
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include "Vm.hpp"
+#include "Globals.hpp"
+#include "Opt.hpp"
+#include "Parse.hpp"
+
+//*GCC and Clang take the address of a label, other compilers run every program with the switch
+#if defined(__GNUC__)
+#define VM_THREADED_DISPATCH 1
+#else
+#define VM_THREADED_DISPATCH 0
+#endif
+
+GlobalVariable const char* vm_op_names[] = {
+    "mov", "loadi", "loadk",
+    "add", "sub", "mul", "div_s", "div_u", "mod_s", "mod_u", "and", "or", "xor", "shl", "shr_s", "shr_u", "neg", "addi",
+    "add32", "sub32", "mul32", "shl32", "neg32", "addi32",
+    "sext8", "sext16", "sext32", "zext8", "zext16", "zext32", "bool",
+    "eq", "ne", "lt_s", "le_s", "lt_u", "le_u",
+    "fadd", "fsub", "fmul", "fdiv", "fadd32", "fsub32", "fmul32", "fdiv32", "fneg", "feq", "fne", "flt", "fle", "fbool",
+    "i2f", "u2f", "f2i", "f2u", "f2f32",
+    "ld8s", "ld8u", "ld16s", "ld16u", "ld32s", "ld32u", "ld64", "ldf32", "st8", "st16", "st32", "st64", "stf32",
+    "ldx32s", "ldx32u", "ldx64", "stx32", "stx64", "lea", "frame", "copy", "zero",
+    "call", "call_ind", "ret", "ret_void", "ret_copy",
+    "jmp", "jz", "jnz", "jeq", "jne", "jlt_s", "jle_s", "jlt_u", "jle_u",
+};
+static_assert(sizeof(vm_op_names) / sizeof(*vm_op_names) == (size_t)VmOp::SIZE_OF_ENUM, "vm_op_names is out of date");
+
+const char* vm_op_name(VmOp op) {
+    return vm_op_names[(int)op];
+}
+
+Internal constexpr u32 VM_STACK_REGS = 1 << 20;
+Internal constexpr u32 VM_STACK_BYTES = 8 << 20;
+Internal constexpr u32 VM_MAX_DEPTH = 1 << 16;
+Internal constexpr u32 VM_MAX_REGS = 0xFFFF;
+
+struct VmFrame {
+    const VmFunc* func;
+    const VmInst* ret; //*next instruction of the caller
+    u64* regs;
+    u8* memory;
+    u16 dest; //*caller register of the result
+};
+
+//*a jump whose target is filled in once the label is placed
+struct VmFixup {
+    u32 pc;
+    u32 label;
+};
+
+//*moves into the phis of succ on the edge from pred, placed after the blocks behind label
+struct VmEdge {
+    u32 pred;
+    u32 succ;
+    u32 label;
+};
+
+//*compilation state of the current function. labels are the blocks, then the edges
+GlobalVariable VmProgram* vm_program;
+GlobalVariable IrFunc* vm_ir;
+GlobalVariable VmFunc* vm_out;
+GlobalVariable IrUses vm_uses;
+GlobalVariable std::vector<u32> vm_regs;
+GlobalVariable std::vector<u32> vm_in_regs; //*aggregate phis, the copy their operands go to before the phi is written
+GlobalVariable std::vector<u32> vm_slots; //*frame offset of allocas and aggregate values
+GlobalVariable std::vector<u32> vm_in_slots;
+GlobalVariable std::vector<u8> vm_fused; //*values computed by the one instruction that uses them
+GlobalVariable std::vector<u32> vm_labels;
+GlobalVariable std::vector<VmFixup> vm_fixups;
+GlobalVariable std::vector<VmEdge> vm_edges;
+GlobalVariable u32 vm_scratch;
+GlobalVariable std::unordered_map<Sym*, u32> vm_func_indices;
+
+Internal u32 vm_func_index(Sym* sym) {
+    auto it = vm_func_indices.find(sym);
+    if (it == vm_func_indices.end()) {
+        fatal("%s uses %s, which is not compiled for the VM", vm_ir->sym->name, sym->name);
+    }
+    return it->second;
+}
+
+Internal Type* vm_type(IrValue value) {
+    return Global::types[vm_ir->insts[value].type];
+}
+
+Internal bool vm_is_aggregate(Type* type) {
+    return type->kind == TypeKind::STRUCT || type->kind == TypeKind::UNION;
+}
+
+Internal bool vm_is_int32(Type* type) {
+    return is_integer_type(type) && type->size == 4 && is_signed_type(type);
+}
+
+Internal u32 vm_emit(VmOp op, u32 a, u32 b, u32 c, i64 imm) {
+    assert(imm >= INT32_MIN && imm <= INT32_MAX);
+    VmInst inst = { op, (u16)a, (u16)b, (u16)c, (i32)imm };
+    vm_out->code.push_back(inst);
+    return (u32)vm_out->code.size() - 1;
+}
+
+Internal void vm_emit_jump(VmOp op, u32 a, u32 b, u32 label) {
+    vm_fixups.push_back({ vm_emit(op, a, b, 0, 0), label });
+}
+
+Internal u32 vm_const(u64 bits) {
+    vm_out->consts.push_back(bits);
+    return (u32)vm_out->consts.size() - 1;
+}
+
+Internal u64 vm_bits(f64 val) {
+    u64 bits;
+    memcpy(&bits, &val, sizeof(bits));
+    return bits;
+}
+
+Internal f64 vm_f64(u64 bits) {
+    f64 val;
+    memcpy(&val, &bits, sizeof(val));
+    return val;
+}
+
+Internal void vm_load_const(u32 reg, i64 val) {
+    if (val >= INT32_MIN && val <= INT32_MAX) {
+        vm_emit(VmOp::LOADI, reg, 0, 0, val);
+    }
+    else {
+        vm_emit(VmOp::LOADK, reg, 0, 0, vm_const((u64)val));
+    }
+}
+
+//*an integer constant as its register holds it
+Internal i64 vm_normalize(Type* type, i64 val) {
+    if (!is_integer_type(type) || type->size >= 8) {
+        return val;
+    }
+    u32 bits = (u32)type->size * 8;
+    u64 mask = (1ull << bits) - 1;
+    u64 low = (u64)val & mask;
+    return is_signed_type(type) && (low >> (bits - 1)) ? (i64)(low | ~mask) : (i64)low;
+}
+
+//*op that extends a register to an integer type narrower than 64 bits, SIZE_OF_ENUM for none
+Internal VmOp vm_ext_op(Type* type) {
+    bool is_signed = is_signed_type(type);
+    switch (type->size) {
+        case 1: {
+            return is_signed ? VmOp::SEXT8 : VmOp::ZEXT8;
+        }
+        case 2: {
+            return is_signed ? VmOp::SEXT16 : VmOp::ZEXT16;
+        }
+        case 4: {
+            return is_signed ? VmOp::SEXT32 : VmOp::ZEXT32;
+        }
+        default: {
+            return VmOp::SIZE_OF_ENUM;
+        }
+    }
+}
+
+Internal void vm_extend(u32 reg, Type* type) {
+    VmOp op = is_integer_type(type) ? vm_ext_op(type) : VmOp::SIZE_OF_ENUM;
+    if (op != VmOp::SIZE_OF_ENUM) {
+        vm_emit(op, reg, reg, 0, 0);
+    }
+}
+
+Internal VmOp vm_load_op(Type* type) {
+    if (type->kind == TypeKind::FLOAT) {
+        return VmOp::LDF32;
+    }
+    bool is_signed = is_signed_type(type);
+    switch (type->size) {
+        case 1: {
+            return is_signed ? VmOp::LD8S : VmOp::LD8U;
+        }
+        case 2: {
+            return is_signed ? VmOp::LD16S : VmOp::LD16U;
+        }
+        case 4: {
+            return is_signed ? VmOp::LD32S : VmOp::LD32U;
+        }
+        default: {
+            return VmOp::LD64;
+        }
+    }
+}
+
+Internal VmOp vm_store_op(Type* type) {
+    if (type->kind == TypeKind::FLOAT) {
+        return VmOp::STF32;
+    }
+    switch (type->size) {
+        case 1: {
+            return VmOp::ST8;
+        }
+        case 2: {
+            return VmOp::ST16;
+        }
+        case 4: {
+            return VmOp::ST32;
+        }
+        default: {
+            return VmOp::ST64;
+        }
+    }
+}
+
+Internal u32 vm_alloc_slot(Type* type) {
+    u32 align = type->align ? (u32)type->align : 1;
+    u32 offset = (vm_out->frame_bytes + align - 1) / align * align;
+    vm_out->frame_bytes = offset + (u32)type->size;
+    return offset;
+}
+
+//*superinstructions
+
+//*an integer constant that fits an immediate
+Internal bool vm_imm(IrValue value, i32* imm) {
+    IrInst* inst = vm_ir->insts + value;
+    if (inst->op != IrOp::CONST_INT) {
+        return false;
+    }
+    i64 val = vm_normalize(vm_type(value), inst->int_val);
+    *imm = (i32)val;
+    return val > INT32_MIN && val <= INT32_MAX;
+}
+
+//*the operand of an integer add or subtract that becomes the immediate of an ADDI, 2 for none
+Internal u32 vm_imm_operand(IrInst* inst, i32* imm) {
+    if (!Global::vm_superinstructions || (inst->op != IrOp::ADD && inst->op != IrOp::SUB) || !is_integer_type(Global::types[inst->type])) {
+        return 2;
+    }
+    if (inst->op == IrOp::ADD && vm_imm(inst->args[1], imm)) {
+        return 1;
+    }
+    if (inst->op == IrOp::ADD && vm_imm(inst->args[0], imm)) {
+        return 0;
+    }
+    if (inst->op == IrOp::SUB && vm_imm(inst->args[1], imm)) {
+        *imm = -*imm;
+        return 1;
+    }
+    return 2;
+}
+
+//*a field address, or an element address at a constant index, as its base plus an immediate
+Internal bool vm_addr_offset(IrInst* inst, i32* offset) {
+    if (inst->op == IrOp::FIELD_ADDR) {
+        *offset = (i32)inst->int_val;
+        return inst->int_val <= INT32_MAX;
+    }
+    i32 index = 0;
+    if (!Global::vm_superinstructions || inst->op != IrOp::ELEM_ADDR || !vm_imm(inst->args[1], &index)) {
+        return false;
+    }
+    i64 val = (i64)index * (i64)Global::types[inst->type]->ptr.base->size;
+    *offset = (i32)val;
+    return val > INT32_MIN && val <= INT32_MAX;
+}
+
+Internal u32 vm_num_uses(IrValue value) {
+    return vm_uses.first[value + 1] - vm_uses.first[value];
+}
+
+Internal bool vm_is_int_compare(IrValue value) {
+    IrInst* inst = vm_ir->insts + value;
+    Type* type = vm_type(inst->args[0]);
+    return inst->op >= IrOp::EQ && inst->op <= IrOp::GE && !is_floating_type(type);
+}
+
+//*an indexed load or store of ints, longs, pointers or doubles
+Internal bool vm_is_indexed_access(IrValue addr, Type* type) {
+    IrInst* inst = vm_ir->insts + addr;
+    return inst->op == IrOp::ELEM_ADDR && vm_type(addr)->ptr.base->size == type->size && type->kind != TypeKind::FLOAT
+        && (type->size == 8 || (type->size == 4 && is_integer_type(type)));
+}
+
+//*values whose instruction is folded into their only user: compares into branches, address arithmetic into loads and
+//*stores, and constants and functions that only appear as immediates and callees
+Internal void vm_find_fused() {
+    vm_fused.assign(vm_ir->num_insts, 0);
+    if (!Global::vm_superinstructions) {
+        return;
+    }
+    std::vector<u32> num_folded(vm_ir->num_insts, 0);
+    for (IrValue v = 1; v < vm_ir->num_insts; v++) {
+        IrInst* inst = vm_ir->insts + v;
+        i32 imm = 0;
+        u32 operand = vm_imm_operand(inst, &imm);
+        if (operand < 2) {
+            num_folded[inst->args[operand]]++;
+        }
+        if (inst->op == IrOp::ELEM_ADDR && vm_addr_offset(inst, &imm)) {
+            num_folded[inst->args[1]]++;
+        }
+        if (inst->op == IrOp::CALL && vm_ir->insts[inst->args[0]].op == IrOp::GLOBAL) {
+            num_folded[inst->args[0]]++;
+        }
+        if (inst->op == IrOp::BRANCH && vm_is_int_compare(inst->args[0]) && vm_num_uses(inst->args[0]) == 1) {
+            vm_fused[inst->args[0]] = 1;
+        }
+        if (inst->op == IrOp::LOAD || inst->op == IrOp::STORE) {
+            IrValue addr = inst->args[0];
+            Type* type = inst->op == IrOp::LOAD ? Global::types[inst->type] : vm_type(inst->args[1]);
+            bool is_offset = vm_addr_offset(vm_ir->insts + addr, &imm);
+            if (!vm_is_aggregate(type) && vm_num_uses(addr) == 1 && (is_offset || vm_is_indexed_access(addr, type))) {
+                vm_fused[addr] = 1;
+            }
+        }
+    }
+    for (IrValue v = 1; v < vm_ir->num_insts; v++) {
+        IrOp op = vm_ir->insts[v].op;
+        if ((op == IrOp::CONST_INT || op == IrOp::GLOBAL) && num_folded[v] == vm_num_uses(v)) {
+            vm_fused[v] = 1;
+        }
+    }
+}
+
+//*edges
+
+//*moves that all read before any writes, in an order that never overwrites a register another one still reads
+Internal void vm_emit_moves(std::vector<std::pair<u32, u32>>* moves) {
+    for (size_t i = 0; i < moves->size();) {
+        if ((*moves)[i].first == (*moves)[i].second) {
+            moves->erase(moves->begin() + i);
+        }
+        else {
+            i++;
+        }
+    }
+    while (!moves->empty()) {
+        bool moved = false;
+        for (size_t i = 0; i < moves->size() && !moved; i++) {
+            u32 dest = (*moves)[i].first;
+            bool is_read = false;
+            for (std::pair<u32, u32>& other : *moves) {
+                is_read = is_read || other.second == dest;
+            }
+            if (!is_read) {
+                vm_emit(VmOp::MOV, dest, (*moves)[i].second, 0, 0);
+                moves->erase(moves->begin() + i);
+                moved = true;
+            }
+        }
+        if (!moved) {
+            //*only cycles are left, one destination is saved in the scratch register and read from there
+            u32 dest = moves->front().first;
+            vm_emit(VmOp::MOV, vm_scratch, dest, 0, 0);
+            for (std::pair<u32, u32>& it : *moves) {
+                it.second = it.second == dest ? vm_scratch : it.second;
+            }
+        }
+    }
+}
+
+Internal bool vm_has_phis(u32 block) {
+    IrBlock* it = vm_ir->blocks + block;
+    return it->num_insts && vm_ir->insts[it->first].op == IrOp::PHI;
+}
+
+Internal void vm_emit_phi_moves(u32 pred, u32 succ) {
+    IrBlock* block = vm_ir->blocks + succ;
+    u32 slot = 0;
+    while (vm_ir->preds[block->first_pred + slot] != pred) {
+        slot++;
+    }
+    std::vector<std::pair<u32, u32>> moves;
+    std::vector<IrValue> aggregates;
+    for (IrValue phi = block->first; vm_ir->insts[phi].op == IrOp::PHI; phi++) {
+        IrValue operand = vm_ir->operands[vm_ir->insts[phi].operands.first + slot];
+        Type* type = vm_type(phi);
+        if (vm_is_aggregate(type)) {
+            vm_emit(VmOp::COPY, vm_in_regs[phi], vm_regs[operand], 0, (i64)type->size);
+            aggregates.push_back(phi);
+        }
+        else {
+            moves.push_back({ vm_regs[phi], vm_regs[operand] });
+        }
+    }
+    for (IrValue phi : aggregates) {
+        vm_emit(VmOp::COPY, vm_regs[phi], vm_in_regs[phi], 0, (i64)vm_type(phi)->size);
+    }
+    vm_emit_moves(&moves);
+}
+
+//*label to jump to for an edge out of a branch, a block of its own when the edge has moves
+Internal u32 vm_edge_label(u32 pred, u32 succ) {
+    if (!vm_has_phis(succ)) {
+        return succ;
+    }
+    u32 label = (u32)vm_labels.size();
+    vm_labels.push_back(0);
+    vm_edges.push_back({ pred, succ, label });
+    return label;
+}
+
+//*whether the instruction w reads value, itself or through a value folded into it
+Internal bool vm_reads(IrValue w, IrValue value) {
+    IrInst* inst = vm_ir->insts + w;
+    for (u32 i = 0; i < 2 + ir_num_list(inst); i++) {
+        IrValue use = ir_use(vm_ir, inst, i);
+        if (use == value || (vm_fused[use] && (vm_ir->insts[use].args[0] == value || vm_ir->insts[use].args[1] == value))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//*a value other than a param whose only use is a phi on the jump out of its block takes the register of the phi when
+//*nothing reads the phi after the value is defined, which leaves no move on the edge. most are the next value of a loop
+//*variable
+Internal void vm_coalesce_phis() {
+    std::vector<u32> def_block;
+    ir_def_blocks(vm_ir, &def_block);
+    for (u32 b = 0; b < vm_ir->num_blocks; b++) {
+        IrBlock* block = vm_ir->blocks + b;
+        IrInst* terminator = vm_ir->insts + block->first + block->num_insts - 1;
+        if (terminator->op != IrOp::JUMP || !vm_has_phis(terminator->targets[0])) {
+            continue;
+        }
+        IrBlock* succ = vm_ir->blocks + terminator->targets[0];
+        u32 slot = 0;
+        while (vm_ir->preds[succ->first_pred + slot] != b) {
+            slot++;
+        }
+        for (IrValue phi = succ->first; vm_ir->insts[phi].op == IrOp::PHI; phi++) {
+            IrValue value = vm_ir->operands[vm_ir->insts[phi].operands.first + slot];
+            IrOp op = vm_ir->insts[value].op;
+            bool is_free = def_block[value] == b && op != IrOp::PHI && op != IrOp::PARAM && vm_num_uses(value) == 1 && !vm_fused[value];
+            if (!is_free || vm_is_aggregate(vm_type(phi))) {
+                continue;
+            }
+            bool is_read = false;
+            for (IrValue w = value + 1; w < block->first + block->num_insts; w++) {
+                is_read = is_read || vm_reads(w, phi);
+            }
+            for (IrValue other = succ->first; vm_ir->insts[other].op == IrOp::PHI; other++) {
+                is_read = is_read || vm_ir->operands[vm_ir->insts[other].operands.first + slot] == phi;
+            }
+            if (!is_read) {
+                vm_regs[value] = vm_regs[phi];
+            }
+        }
+    }
+}
+
+//*instructions
+
+Internal void vm_compile_compare_jump(IrValue cond, bool negate, u32 label) {
+    IrInst* inst = vm_ir->insts + cond;
+    bool is_signed = is_signed_type(vm_type(inst->args[0]));
+    u32 left = vm_regs[inst->args[0]];
+    u32 right = vm_regs[inst->args[1]];
+    IrOp op = inst->op;
+    if (op == IrOp::GT || op == IrOp::GE) {
+        std::swap(left, right);
+        op = op == IrOp::GT ? IrOp::LT : IrOp::LE;
+    }
+    if (negate) {
+        //*!(a < b) is b <= a and !(a <= b) is b < a
+        if (op == IrOp::LT || op == IrOp::LE) {
+            std::swap(left, right);
+        }
+        op = op == IrOp::EQ ? IrOp::NE : op == IrOp::NE ? IrOp::EQ : op == IrOp::LT ? IrOp::LE : IrOp::LT;
+    }
+    VmOp jump = op == IrOp::EQ ? VmOp::JEQ : op == IrOp::NE ? VmOp::JNE : op == IrOp::LT ? (is_signed ? VmOp::JLT_S : VmOp::JLT_U)
+        : (is_signed ? VmOp::JLE_S : VmOp::JLE_U);
+    vm_emit_jump(jump, left, right, label);
+}
+
+Internal void vm_compile_branch(u32 block, IrInst* inst) {
+    u32 then_label = vm_edge_label(block, inst->targets[0]);
+    u32 else_label = vm_edge_label(block, inst->targets[1]);
+    bool then_next = then_label == block + 1;
+    IrValue cond = inst->args[0];
+    if (vm_fused[cond]) {
+        vm_compile_compare_jump(cond, then_next, then_next ? else_label : then_label);
+    }
+    else {
+        vm_emit_jump(then_next ? VmOp::JZ : VmOp::JNZ, vm_regs[cond], 0, then_next ? else_label : then_label);
+    }
+    if (!then_next && else_label != block + 1) {
+        vm_emit_jump(VmOp::JMP, 0, 0, else_label);
+    }
+}
+
+Internal void vm_compile_convert(IrValue value, IrInst* inst) {
+    Type* to = Global::types[inst->type];
+    Type* from = vm_type(inst->args[0]);
+    u32 dest = vm_regs[value];
+    u32 src = vm_regs[inst->args[0]];
+    if (to->kind == TypeKind::BOOL) {
+        vm_emit(is_floating_type(from) ? VmOp::FBOOL : VmOp::BOOL, dest, src, 0, 0);
+    }
+    else if (is_floating_type(to)) {
+        if (is_floating_type(from)) {
+            vm_emit(to->kind == TypeKind::FLOAT && from->kind == TypeKind::DOUBLE ? VmOp::F2F32 : VmOp::MOV, dest, src, 0, 0);
+        }
+        else {
+            vm_emit(is_signed_type(from) || from->size < 8 ? VmOp::I2F : VmOp::U2F, dest, src, 0, 0);
+            if (to->kind == TypeKind::FLOAT) {
+                vm_emit(VmOp::F2F32, dest, dest, 0, 0);
+            }
+        }
+    }
+    else if (is_integer_type(to) && is_floating_type(from)) {
+        vm_emit(!is_signed_type(to) && to->size == 8 ? VmOp::F2U : VmOp::F2I, dest, src, 0, 0);
+        vm_extend(dest, to);
+    }
+    else {
+        //*an integer already in range keeps its register, as do pointers and the address of an array
+        bool keeps = !is_integer_type(to) || to->size == 8
+            || (is_integer_type(from) && from->size < to->size && (!is_signed_type(from) || is_signed_type(to)))
+            || (is_integer_type(from) && from->size == to->size && is_signed_type(from) == is_signed_type(to));
+        vm_emit(VmOp::MOV, dest, src, 0, 0);
+        if (!keeps) {
+            vm_extend(dest, to);
+        }
+    }
+}
+
+Internal void vm_compile_arith(IrValue value, IrInst* inst) {
+    Type* type = Global::types[inst->type];
+    u32 dest = vm_regs[value];
+    u32 left = vm_regs[inst->args[0]];
+    u32 right = inst->args[1] ? vm_regs[inst->args[1]] : 0;
+    if (is_floating_type(type)) {
+        bool is_float = type->kind == TypeKind::FLOAT;
+        VmOp op = VmOp::FNEG;
+        switch (inst->op) {
+            case IrOp::ADD: {
+                op = is_float ? VmOp::FADD32 : VmOp::FADD;
+                break;
+            }
+            case IrOp::SUB: {
+                op = is_float ? VmOp::FSUB32 : VmOp::FSUB;
+                break;
+            }
+            case IrOp::MUL: {
+                op = is_float ? VmOp::FMUL32 : VmOp::FMUL;
+                break;
+            }
+            case IrOp::DIV: {
+                op = is_float ? VmOp::FDIV32 : VmOp::FDIV;
+                break;
+            }
+            default: {
+                assert(inst->op == IrOp::NEG);
+                break;
+            }
+        }
+        vm_emit(op, dest, left, right, 0);
+        return;
+    }
+
+    bool is_int32 = vm_is_int32(type);
+    bool is_signed = is_signed_type(type);
+    i32 imm = 0;
+    u32 operand = vm_imm_operand(inst, &imm);
+    if (operand < 2) {
+        vm_emit(is_int32 ? VmOp::ADDI32 : VmOp::ADDI, dest, vm_regs[inst->args[1 - operand]], 0, imm);
+        if (!is_int32) {
+            vm_extend(dest, type);
+        }
+        return;
+    }
+
+    //*and, or, xor, division and right shifts of extended registers are extended already
+    VmOp op = VmOp::ADD;
+    bool wraps = true;
+    switch (inst->op) {
+        case IrOp::ADD: {
+            op = is_int32 ? VmOp::ADD32 : VmOp::ADD;
+            break;
+        }
+        case IrOp::SUB: {
+            op = is_int32 ? VmOp::SUB32 : VmOp::SUB;
+            break;
+        }
+        case IrOp::MUL: {
+            op = is_int32 ? VmOp::MUL32 : VmOp::MUL;
+            break;
+        }
+        case IrOp::SHL: {
+            op = is_int32 ? VmOp::SHL32 : VmOp::SHL;
+            break;
+        }
+        case IrOp::NEG: {
+            op = is_int32 ? VmOp::NEG32 : VmOp::NEG;
+            break;
+        }
+        case IrOp::DIV: {
+            op = is_signed ? VmOp::DIV_S : VmOp::DIV_U;
+            wraps = false;
+            break;
+        }
+        case IrOp::MOD: {
+            op = is_signed ? VmOp::MOD_S : VmOp::MOD_U;
+            wraps = false;
+            break;
+        }
+        case IrOp::AND: {
+            op = VmOp::AND;
+            wraps = false;
+            break;
+        }
+        case IrOp::OR: {
+            op = VmOp::OR;
+            wraps = false;
+            break;
+        }
+        case IrOp::XOR: {
+            op = VmOp::XOR;
+            wraps = false;
+            break;
+        }
+        case IrOp::SHR: {
+            op = is_signed ? VmOp::SHR_S : VmOp::SHR_U;
+            wraps = false;
+            break;
+        }
+        default: {
+            assert(false);
+            break;
+        }
+    }
+    vm_emit(op, dest, left, right, 0);
+    if (wraps && !is_int32) {
+        vm_extend(dest, type);
+    }
+}
+
+Internal void vm_compile_compare(IrValue value, IrInst* inst) {
+    Type* type = vm_type(inst->args[0]);
+    u32 left = vm_regs[inst->args[0]];
+    u32 right = vm_regs[inst->args[1]];
+    IrOp op = inst->op;
+    if (op == IrOp::GT || op == IrOp::GE) {
+        std::swap(left, right);
+        op = op == IrOp::GT ? IrOp::LT : IrOp::LE;
+    }
+    VmOp out = VmOp::EQ;
+    if (is_floating_type(type)) {
+        out = op == IrOp::EQ ? VmOp::FEQ : op == IrOp::NE ? VmOp::FNE : op == IrOp::LT ? VmOp::FLT : VmOp::FLE;
+    }
+    else {
+        bool is_signed = is_signed_type(type);
+        out = op == IrOp::EQ ? VmOp::EQ : op == IrOp::NE ? VmOp::NE : op == IrOp::LT ? (is_signed ? VmOp::LT_S : VmOp::LT_U)
+            : (is_signed ? VmOp::LE_S : VmOp::LE_U);
+    }
+    vm_emit(out, vm_regs[value], left, right, 0);
+}
+
+Internal void vm_compile_access(IrValue value, IrInst* inst) {
+    bool is_load = inst->op == IrOp::LOAD;
+    Type* type = is_load ? Global::types[inst->type] : vm_type(inst->args[1]);
+    IrValue addr = inst->args[0];
+    u32 data = is_load ? vm_regs[value] : vm_regs[inst->args[1]];
+    if (vm_is_aggregate(type)) {
+        if (is_load) {
+            vm_emit(VmOp::FRAME, data, 0, 0, vm_slots[value]);
+            vm_emit(VmOp::COPY, data, vm_regs[addr], 0, (i64)type->size);
+        }
+        else {
+            vm_emit(VmOp::COPY, vm_regs[addr], data, 0, (i64)type->size);
+        }
+        return;
+    }
+
+    IrInst* addr_inst = vm_ir->insts + addr;
+    i32 offset = 0;
+    if (vm_fused[addr] && !vm_addr_offset(addr_inst, &offset)) {
+        u32 base = vm_regs[addr_inst->args[0]];
+        u32 index = vm_regs[addr_inst->args[1]];
+        if (is_load) {
+            VmOp op = type->size == 8 ? VmOp::LDX64 : is_signed_type(type) ? VmOp::LDX32S : VmOp::LDX32U;
+            vm_emit(op, data, base, index, 0);
+        }
+        else {
+            vm_emit(type->size == 8 ? VmOp::STX64 : VmOp::STX32, base, index, data, 0);
+        }
+        return;
+    }
+
+    u32 base = vm_fused[addr] ? vm_regs[addr_inst->args[0]] : vm_regs[addr];
+    if (is_load) {
+        vm_emit(vm_load_op(type), data, base, 0, offset);
+    }
+    else {
+        vm_emit(vm_store_op(type), base, data, 0, offset);
+    }
+}
+
+Internal void vm_compile_call(IrValue value, IrInst* inst) {
+    Type* ret = Global::types[inst->type];
+    u32 dest = ret->kind == TypeKind::VOID ? vm_scratch : vm_regs[value];
+    if (vm_is_aggregate(ret)) {
+        vm_emit(VmOp::FRAME, dest, 0, 0, vm_slots[value]);
+    }
+    u32 first = (u32)vm_out->args.size();
+    for (u32 i = inst->operands.first; i < inst->operands.first + inst->operands.count; i++) {
+        vm_out->args.push_back((u16)vm_regs[vm_ir->operands[i]]);
+    }
+    if (vm_out->args.size() > 0xFFFF) {
+        fatal("%s has too many calls to run in the VM", vm_ir->sym->name);
+    }
+    IrInst* callee = vm_ir->insts + inst->args[0];
+    if (callee->op == IrOp::GLOBAL && callee->sym->kind == SymKind::FUNC) {
+        vm_emit(VmOp::CALL, dest, first, inst->operands.count, vm_func_index(callee->sym));
+    }
+    else {
+        vm_emit(VmOp::CALL_IND, dest, first, inst->operands.count, vm_regs[inst->args[0]]);
+    }
+}
+
+Internal void vm_compile_inst(u32 block, IrValue value) {
+    IrInst* inst = vm_ir->insts + value;
+    Type* type = Global::types[inst->type];
+    u32 dest = vm_regs[value];
+    if (inst->lanes) {
+        fatal("%s has vector instructions, the VM compiles IR without them", vm_ir->sym->name);
+    }
+    if (vm_fused[value]) {
+        return;
+    }
+    switch (inst->op) {
+        case IrOp::NOP:
+        case IrOp::PARAM:
+        case IrOp::PHI: {
+            break;
+        }
+        case IrOp::UNDEF: {
+            if (vm_is_aggregate(type)) {
+                vm_emit(VmOp::FRAME, dest, 0, 0, vm_slots[value]);
+            }
+            else {
+                vm_emit(VmOp::LOADI, dest, 0, 0, 0);
+            }
+            break;
+        }
+        case IrOp::CONST_INT: {
+            vm_load_const(dest, vm_normalize(type, inst->int_val));
+            break;
+        }
+        case IrOp::CONST_FLOAT: {
+            f64 val = type->kind == TypeKind::FLOAT ? (f64)(f32)inst->float_val : inst->float_val;
+            vm_emit(VmOp::LOADK, dest, 0, 0, vm_const(vm_bits(val)));
+            break;
+        }
+        case IrOp::GLOBAL: {
+            u64 addr = inst->sym->kind == SymKind::FUNC ? (u64)&vm_program->funcs[vm_func_index(inst->sym)]
+                                                        : (u64)vm_global_addr(vm_program, inst->sym);
+            if (!addr) {
+                fatal("%s uses %s, which has no memory in the VM", vm_ir->sym->name, inst->sym->name);
+            }
+            vm_emit(VmOp::LOADK, dest, 0, 0, vm_const(addr));
+            break;
+        }
+        case IrOp::STR: {
+            vm_program->strings.push_back({ inst->str, strlen(inst->str) + 1 });
+            vm_emit(VmOp::LOADK, dest, 0, 0, vm_const((u64)inst->str));
+            break;
+        }
+        case IrOp::ADD:
+        case IrOp::SUB:
+        case IrOp::MUL:
+        case IrOp::DIV:
+        case IrOp::MOD:
+        case IrOp::AND:
+        case IrOp::OR:
+        case IrOp::XOR:
+        case IrOp::SHL:
+        case IrOp::SHR:
+        case IrOp::NEG: {
+            vm_compile_arith(value, inst);
+            break;
+        }
+        case IrOp::EQ:
+        case IrOp::NE:
+        case IrOp::LT:
+        case IrOp::LE:
+        case IrOp::GT:
+        case IrOp::GE: {
+            vm_compile_compare(value, inst);
+            break;
+        }
+        case IrOp::CONVERT: {
+            vm_compile_convert(value, inst);
+            break;
+        }
+        case IrOp::ALLOCA: {
+            vm_emit(VmOp::FRAME, dest, 0, 0, vm_slots[value]);
+            break;
+        }
+        case IrOp::LOAD:
+        case IrOp::STORE: {
+            vm_compile_access(value, inst);
+            break;
+        }
+        case IrOp::ZERO: {
+            vm_emit(VmOp::ZERO, vm_regs[inst->args[0]], 0, 0, inst->int_val);
+            break;
+        }
+        case IrOp::ELEM_ADDR:
+        case IrOp::FIELD_ADDR: {
+            i32 offset = 0;
+            if (vm_addr_offset(inst, &offset)) {
+                vm_emit(offset ? VmOp::ADDI : VmOp::MOV, dest, vm_regs[inst->args[0]], 0, offset);
+            }
+            else {
+                vm_emit(VmOp::LEA, dest, vm_regs[inst->args[0]], vm_regs[inst->args[1]], (i64)type->ptr.base->size);
+            }
+            break;
+        }
+        case IrOp::CALL: {
+            vm_compile_call(value, inst);
+            break;
+        }
+        case IrOp::JUMP: {
+            vm_emit_phi_moves(block, inst->targets[0]);
+            if (inst->targets[0] != block + 1) {
+                vm_emit_jump(VmOp::JMP, 0, 0, inst->targets[0]);
+            }
+            break;
+        }
+        case IrOp::BRANCH: {
+            vm_compile_branch(block, inst);
+            break;
+        }
+        case IrOp::RETURN: {
+            Type* ret = vm_ir->sym->type->func.ret;
+            if (!inst->args[0]) {
+                vm_emit(VmOp::RET_VOID, 0, 0, 0, 0);
+            }
+            else if (vm_is_aggregate(ret)) {
+                vm_emit(VmOp::RET_COPY, vm_regs[inst->args[0]], 0, 0, (i64)ret->size);
+            }
+            else {
+                vm_emit(VmOp::RET, vm_regs[inst->args[0]], 0, 0, 0);
+            }
+            break;
+        }
+        default: {
+            fatal("%s: the VM does not run %s", vm_ir->sym->name, ir_dump(vm_ir).c_str());
+            break;
+        }
+    }
+}
+
+//*params take the first registers in order, every other value one after them, and the scratch register comes last
+Internal void vm_compile_func(IrFunc* func, VmFunc* out) {
+    vm_ir = func;
+    vm_out = out;
+    out->sym = func->sym;
+    out->num_params = (u32)func->sym->type->func.num_params;
+    out->frame_bytes = 0;
+    ir_find_uses(func, &vm_uses);
+    vm_find_fused();
+
+    vm_regs.assign(func->num_insts, 0);
+    vm_in_regs.assign(func->num_insts, 0);
+    vm_slots.assign(func->num_insts, 0);
+    vm_in_slots.assign(func->num_insts, 0);
+    u32 num_regs = out->num_params;
+    for (IrValue v = 1; v < func->num_insts; v++) {
+        IrInst* inst = func->insts + v;
+        Type* type = Global::types[inst->type];
+        if (inst->op == IrOp::PARAM) {
+            vm_regs[v] = (u32)inst->int_val;
+        }
+        else if (ir_has_result(inst->op) && inst->type) {
+            vm_regs[v] = num_regs++;
+        }
+        if (inst->op == IrOp::ALLOCA) {
+            vm_slots[v] = vm_alloc_slot(type->ptr.base);
+        }
+        else if (inst->op != IrOp::PARAM && inst->type && vm_is_aggregate(type)) {
+            vm_slots[v] = vm_alloc_slot(type);
+            if (inst->op == IrOp::PHI) {
+                vm_in_regs[v] = num_regs++;
+                vm_in_slots[v] = vm_alloc_slot(type);
+            }
+        }
+    }
+    vm_coalesce_phis();
+    vm_scratch = num_regs++;
+    if (num_regs > VM_MAX_REGS) {
+        fatal("%s has too many values to run in the VM", func->sym->name);
+    }
+    out->num_regs = num_regs;
+    out->frame_bytes = (out->frame_bytes + 15) / 16 * 16;
+
+    vm_labels.assign(func->num_blocks, 0);
+    vm_fixups.clear();
+    vm_edges.clear();
+    //*aggregate phis are written through the addresses of their copies, which never change
+    for (IrValue v = 1; v < func->num_insts; v++) {
+        if (func->insts[v].op == IrOp::PHI && vm_is_aggregate(vm_type(v))) {
+            vm_emit(VmOp::FRAME, vm_regs[v], 0, 0, vm_slots[v]);
+            vm_emit(VmOp::FRAME, vm_in_regs[v], 0, 0, vm_in_slots[v]);
+        }
+    }
+    for (u32 b = 0; b < func->num_blocks; b++) {
+        vm_labels[b] = (u32)out->code.size();
+        IrBlock* block = func->blocks + b;
+        for (IrValue v = block->first; v < block->first + block->num_insts; v++) {
+            vm_compile_inst(b, v);
+        }
+    }
+    for (size_t i = 0; i < vm_edges.size(); i++) {
+        VmEdge edge = vm_edges[i];
+        vm_labels[edge.label] = (u32)out->code.size();
+        vm_emit_phi_moves(edge.pred, edge.succ);
+        vm_emit_jump(VmOp::JMP, 0, 0, edge.succ);
+    }
+    for (VmFixup& it : vm_fixups) {
+        out->code[it.pc].imm = (i32)vm_labels[it.label];
+    }
+}
+
+IrFunc* vm_lower_func(Sym* sym) {
+    u32 passes = Global::ir_passes;
+    Global::ir_passes &= ~(1u << (int)IrPass::VECTORIZE);
+    IrFunc* func = ir_optimize(ir_lower_func(sym));
+    Global::ir_passes = passes;
+    return func;
+}
+
+void vm_compile_funcs(VmProgram* program, const std::vector<IrFunc*>& funcs) {
+    vm_program = program;
+    program->steps = 0;
+    program->max_regs = program->max_regs ? program->max_regs : VM_STACK_REGS;
+    program->max_memory = program->max_memory ? program->max_memory : VM_STACK_BYTES;
+    program->max_depth = program->max_depth ? program->max_depth : VM_MAX_DEPTH;
+    program->max_steps = program->max_steps ? program->max_steps : UINT64_MAX;
+    program->regs = (u64*)xcalloc(program->max_regs, sizeof(u64));
+    program->memory = (u8*)xcalloc(1, program->max_memory);
+    program->frames = (VmFrame*)xcalloc(program->max_depth, sizeof(VmFrame));
+
+    //*the funcs are numbered before any is compiled, calls and func values refer to them by index and address
+    vm_func_indices.clear();
+    program->funcs.assign(funcs.size(), VmFunc{});
+    for (size_t i = 0; i < funcs.size(); i++) {
+        vm_func_indices[funcs[i]->sym] = (u32)i;
+    }
+    for (size_t i = 0; i < funcs.size(); i++) {
+        vm_compile_func(funcs[i], &program->funcs[i]);
+    }
+}
+
+void vm_compile_package(VmProgram* program) {
+    program->global_offsets.clear();
+    u32 global_bytes = 0;
+    for (Sym* it : Global::syms) {
+        if (it->kind == SymKind::VAR) {
+            u32 align = it->type->align ? (u32)it->type->align : 1;
+            global_bytes = (global_bytes + align - 1) / align * align;
+            program->global_offsets.push_back({ it, global_bytes });
+            global_bytes += (u32)it->type->size;
+        }
+    }
+    program->globals = (u8*)xcalloc(1, global_bytes ? global_bytes : 1);
+    program->global_bytes = global_bytes;
+
+    std::vector<IrFunc*> funcs;
+    for (Sym* it : Global::syms) {
+        if (it->kind == SymKind::FUNC) {
+            funcs.push_back(vm_lower_func(it));
+        }
+    }
+    vm_compile_funcs(program, funcs);
+
+    Sym init = {};
+    init.name = Global::string_table.add("global_init");
+    init.kind = SymKind::FUNC;
+    init.type = type_func(nullptr, 0, Global::type_void);
+    VmFunc init_func;
+    vm_compile_func(ir_lower_global_init(&init), &init_func);
+    u64 unused = 0;
+    if (!vm_call(program, &init_func, nullptr, &unused, false)) {
+        fatal("the initializers of the global vars failed: %s", program->error.c_str());
+    }
+}
+
+void vm_free(VmProgram* program) {
+    free(program->globals);
+    free(program->regs);
+    free(program->memory);
+    free(program->frames);
+    program->strings.clear();
+    program->globals = nullptr;
+    program->regs = nullptr;
+    program->memory = nullptr;
+    program->frames = nullptr;
+    program->funcs.clear();
+}
+
+VmFunc* vm_find_func(VmProgram* program, const char* name) {
+    const char* interned = Global::string_table.add(name);
+    for (VmFunc& it : program->funcs) {
+        if (it.sym->name == interned) {
+            return &it;
+        }
+    }
+    return nullptr;
+}
+
+u8* vm_global_addr(VmProgram* program, Sym* sym) {
+    for (std::pair<Sym*, u32>& it : program->global_offsets) {
+        if (it.first == sym) {
+            return program->globals + it.second;
+        }
+    }
+    return nullptr;
+}
+
+//*interpreter
+
+template <typename T>
+Internal T vm_load(u64 addr) {
+    T val;
+    memcpy(&val, (const void*)(uintptr_t)addr, sizeof(T));
+    return val;
+}
+
+template <typename T>
+Internal void vm_store(u64 addr, T val) {
+    memcpy((void*)(uintptr_t)addr, &val, sizeof(T));
+}
+
+Internal u64 vm_sext32(u64 val) {
+    return (u64)(i64)(i32)(u32)val;
+}
+
+Internal u64 vm_round32(f64 val) {
+    return vm_bits((f64)(f32)val);
+}
+
+//*whether a checked run may touch the size bytes at addr: the stacks and the globals, and the string literals to read
+Internal bool vm_check_range(VmProgram* program, u64 addr, u64 size, bool writable) {
+    u64 memory = (u64)(uintptr_t)program->memory;
+    u64 globals = (u64)(uintptr_t)program->globals;
+    if ((addr >= memory && addr - memory <= program->max_memory && size <= program->max_memory - (addr - memory))
+        || (globals && addr >= globals && addr - globals <= program->global_bytes && size <= program->global_bytes - (addr - globals))) {
+        return true;
+    }
+    for (size_t i = 0; i < program->strings.size() && !writable; i++) {
+        u64 str = (u64)(uintptr_t)program->strings[i].first;
+        if (addr >= str && addr - str <= program->strings[i].second && size <= program->strings[i].second - (addr - str)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <bool checked>
+Internal bool vm_in_bounds(VmProgram* program, u64 addr, u64 size, bool writable) {
+    return !checked || vm_check_range(program, addr, size, writable);
+}
+
+//*a null func value always fails, a checked run also checks that it is one of the funcs of the program
+template <bool checked>
+Internal bool vm_is_func(VmProgram* program, const VmFunc* func) {
+    return func && (!checked || (func >= program->funcs.data() && func < program->funcs.data() + program->funcs.size()));
+}
+
+//*one handler per op. with threaded dispatch every handler jumps straight to the handler of the next instruction,
+//*otherwise they all go back to the switch
+#define VM_A r[inst->a]
+#define VM_B r[inst->b]
+#define VM_C r[inst->c]
+#define VM_FB vm_f64(r[inst->b])
+#define VM_FC vm_f64(r[inst->c])
+//*steps stays 0 and max_steps is the largest u64 in an unchecked run, so the limit folds away
+#define VM_STEP() do { steps += checked; if (steps > max_steps) { error = "step limit exceeded"; goto fail; } } while (0)
+#define VM_ACCESS(addr, size, writable) \
+    do { if (!vm_in_bounds<checked>(program, addr, size, writable)) { error = "memory access out of bounds"; goto fail; } } while (0)
+#if VM_THREADED_DISPATCH
+#define VM_OP(name) case VmOp::name: op_##name:
+#define VM_DISPATCH() do { VM_STEP(); if (threaded) { goto *vm_handlers[(int)inst->op]; } goto dispatch; } while (0)
+#else
+#define VM_OP(name) case VmOp::name:
+#define VM_DISPATCH() do { VM_STEP(); goto dispatch; } while (0)
+#endif
+#define VM_NEXT() do { inst++; VM_DISPATCH(); } while (0)
+#define VM_JUMP_IF(cond) do { inst = (cond) ? func->code.data() + inst->imm : inst + 1; VM_DISPATCH(); } while (0)
+
+template <bool threaded, bool checked>
+Internal bool vm_run(VmProgram* program, const VmFunc* func, u64* result) {
+#if VM_THREADED_DISPATCH
+    LocalPersist void* const vm_handlers[] = {
+        &&op_MOV, &&op_LOADI, &&op_LOADK,
+        &&op_ADD, &&op_SUB, &&op_MUL, &&op_DIV_S, &&op_DIV_U, &&op_MOD_S, &&op_MOD_U, &&op_AND, &&op_OR, &&op_XOR, &&op_SHL,
+        &&op_SHR_S, &&op_SHR_U, &&op_NEG, &&op_ADDI,
+        &&op_ADD32, &&op_SUB32, &&op_MUL32, &&op_SHL32, &&op_NEG32, &&op_ADDI32,
+        &&op_SEXT8, &&op_SEXT16, &&op_SEXT32, &&op_ZEXT8, &&op_ZEXT16, &&op_ZEXT32, &&op_BOOL,
+        &&op_EQ, &&op_NE, &&op_LT_S, &&op_LE_S, &&op_LT_U, &&op_LE_U,
+        &&op_FADD, &&op_FSUB, &&op_FMUL, &&op_FDIV, &&op_FADD32, &&op_FSUB32, &&op_FMUL32, &&op_FDIV32, &&op_FNEG,
+        &&op_FEQ, &&op_FNE, &&op_FLT, &&op_FLE, &&op_FBOOL,
+        &&op_I2F, &&op_U2F, &&op_F2I, &&op_F2U, &&op_F2F32,
+        &&op_LD8S, &&op_LD8U, &&op_LD16S, &&op_LD16U, &&op_LD32S, &&op_LD32U, &&op_LD64, &&op_LDF32,
+        &&op_ST8, &&op_ST16, &&op_ST32, &&op_ST64, &&op_STF32,
+        &&op_LDX32S, &&op_LDX32U, &&op_LDX64, &&op_STX32, &&op_STX64, &&op_LEA, &&op_FRAME, &&op_COPY, &&op_ZERO,
+        &&op_CALL, &&op_CALL_IND, &&op_RET, &&op_RET_VOID, &&op_RET_COPY,
+        &&op_JMP, &&op_JZ, &&op_JNZ, &&op_JEQ, &&op_JNE, &&op_JLT_S, &&op_JLE_S, &&op_JLT_U, &&op_JLE_U,
+    };
+    static_assert(sizeof(vm_handlers) / sizeof(*vm_handlers) == (size_t)VmOp::SIZE_OF_ENUM, "vm_handlers is out of date");
+#endif
+    VmFrame* frames = program->frames;
+    u32 depth = 0;
+    u64* r = program->regs;
+    u8* mem = program->memory;
+    const VmInst* inst = func->code.data();
+    const VmFunc* callee = nullptr;
+    const char* error = nullptr;
+    u64 value = 0;
+    u64 steps = 0;
+    u64 max_steps = checked ? program->max_steps : UINT64_MAX;
+
+    VM_DISPATCH();
+dispatch:
+    switch (inst->op) {
+        VM_OP(MOV) {
+            VM_A = VM_B;
+            VM_NEXT();
+        }
+        VM_OP(LOADI) {
+            VM_A = (u64)(i64)inst->imm;
+            VM_NEXT();
+        }
+        VM_OP(LOADK) {
+            VM_A = func->consts[inst->imm];
+            VM_NEXT();
+        }
+        VM_OP(ADD) {
+            VM_A = VM_B + VM_C;
+            VM_NEXT();
+        }
+        VM_OP(SUB) {
+            VM_A = VM_B - VM_C;
+            VM_NEXT();
+        }
+        VM_OP(MUL) {
+            VM_A = VM_B * VM_C;
+            VM_NEXT();
+        }
+        VM_OP(DIV_S) {
+            if (!VM_C || ((i64)VM_B == INT64_MIN && (i64)VM_C == -1)) {
+                error = "division by zero or overflow";
+                goto fail;
+            }
+            VM_A = (u64)((i64)VM_B / (i64)VM_C);
+            VM_NEXT();
+        }
+        VM_OP(DIV_U) {
+            if (!VM_C) {
+                error = "division by zero";
+                goto fail;
+            }
+            VM_A = VM_B / VM_C;
+            VM_NEXT();
+        }
+        VM_OP(MOD_S) {
+            if (!VM_C || ((i64)VM_B == INT64_MIN && (i64)VM_C == -1)) {
+                error = "division by zero or overflow";
+                goto fail;
+            }
+            VM_A = (u64)((i64)VM_B % (i64)VM_C);
+            VM_NEXT();
+        }
+        VM_OP(MOD_U) {
+            if (!VM_C) {
+                error = "division by zero";
+                goto fail;
+            }
+            VM_A = VM_B % VM_C;
+            VM_NEXT();
+        }
+        VM_OP(AND) {
+            VM_A = VM_B & VM_C;
+            VM_NEXT();
+        }
+        VM_OP(OR) {
+            VM_A = VM_B | VM_C;
+            VM_NEXT();
+        }
+        VM_OP(XOR) {
+            VM_A = VM_B ^ VM_C;
+            VM_NEXT();
+        }
+        VM_OP(SHL) {
+            VM_A = VM_B << (VM_C & 63);
+            VM_NEXT();
+        }
+        VM_OP(SHR_S) {
+            VM_A = (u64)((i64)VM_B >> (VM_C & 63));
+            VM_NEXT();
+        }
+        VM_OP(SHR_U) {
+            VM_A = VM_B >> (VM_C & 63);
+            VM_NEXT();
+        }
+        VM_OP(NEG) {
+            VM_A = 0 - VM_B;
+            VM_NEXT();
+        }
+        VM_OP(ADDI) {
+            VM_A = VM_B + (u64)(i64)inst->imm;
+            VM_NEXT();
+        }
+        VM_OP(ADD32) {
+            VM_A = vm_sext32(VM_B + VM_C);
+            VM_NEXT();
+        }
+        VM_OP(SUB32) {
+            VM_A = vm_sext32(VM_B - VM_C);
+            VM_NEXT();
+        }
+        VM_OP(MUL32) {
+            VM_A = vm_sext32(VM_B * VM_C);
+            VM_NEXT();
+        }
+        VM_OP(SHL32) {
+            VM_A = vm_sext32(VM_B << (VM_C & 63));
+            VM_NEXT();
+        }
+        VM_OP(NEG32) {
+            VM_A = vm_sext32(0 - VM_B);
+            VM_NEXT();
+        }
+        VM_OP(ADDI32) {
+            VM_A = vm_sext32(VM_B + (u64)(i64)inst->imm);
+            VM_NEXT();
+        }
+        VM_OP(SEXT8) {
+            VM_A = (u64)(i64)(i8)VM_B;
+            VM_NEXT();
+        }
+        VM_OP(SEXT16) {
+            VM_A = (u64)(i64)(i16)VM_B;
+            VM_NEXT();
+        }
+        VM_OP(SEXT32) {
+            VM_A = vm_sext32(VM_B);
+            VM_NEXT();
+        }
+        VM_OP(ZEXT8) {
+            VM_A = VM_B & 0xFF;
+            VM_NEXT();
+        }
+        VM_OP(ZEXT16) {
+            VM_A = VM_B & 0xFFFF;
+            VM_NEXT();
+        }
+        VM_OP(ZEXT32) {
+            VM_A = VM_B & 0xFFFFFFFF;
+            VM_NEXT();
+        }
+        VM_OP(BOOL) {
+            VM_A = VM_B != 0;
+            VM_NEXT();
+        }
+        VM_OP(EQ) {
+            VM_A = VM_B == VM_C;
+            VM_NEXT();
+        }
+        VM_OP(NE) {
+            VM_A = VM_B != VM_C;
+            VM_NEXT();
+        }
+        VM_OP(LT_S) {
+            VM_A = (i64)VM_B < (i64)VM_C;
+            VM_NEXT();
+        }
+        VM_OP(LE_S) {
+            VM_A = (i64)VM_B <= (i64)VM_C;
+            VM_NEXT();
+        }
+        VM_OP(LT_U) {
+            VM_A = VM_B < VM_C;
+            VM_NEXT();
+        }
+        VM_OP(LE_U) {
+            VM_A = VM_B <= VM_C;
+            VM_NEXT();
+        }
+        VM_OP(FADD) {
+            VM_A = vm_bits(VM_FB + VM_FC);
+            VM_NEXT();
+        }
+        VM_OP(FSUB) {
+            VM_A = vm_bits(VM_FB - VM_FC);
+            VM_NEXT();
+        }
+        VM_OP(FMUL) {
+            VM_A = vm_bits(VM_FB * VM_FC);
+            VM_NEXT();
+        }
+        VM_OP(FDIV) {
+            VM_A = vm_bits(VM_FB / VM_FC);
+            VM_NEXT();
+        }
+        VM_OP(FADD32) {
+            VM_A = vm_round32(VM_FB + VM_FC);
+            VM_NEXT();
+        }
+        VM_OP(FSUB32) {
+            VM_A = vm_round32(VM_FB - VM_FC);
+            VM_NEXT();
+        }
+        VM_OP(FMUL32) {
+            VM_A = vm_round32(VM_FB * VM_FC);
+            VM_NEXT();
+        }
+        VM_OP(FDIV32) {
+            VM_A = vm_round32(VM_FB / VM_FC);
+            VM_NEXT();
+        }
+        VM_OP(FNEG) {
+            VM_A = vm_bits(-VM_FB);
+            VM_NEXT();
+        }
+        VM_OP(FEQ) {
+            VM_A = VM_FB == VM_FC;
+            VM_NEXT();
+        }
+        VM_OP(FNE) {
+            VM_A = VM_FB != VM_FC;
+            VM_NEXT();
+        }
+        VM_OP(FLT) {
+            VM_A = VM_FB < VM_FC;
+            VM_NEXT();
+        }
+        VM_OP(FLE) {
+            VM_A = VM_FB <= VM_FC;
+            VM_NEXT();
+        }
+        VM_OP(FBOOL) {
+            VM_A = VM_FB != 0.0;
+            VM_NEXT();
+        }
+        VM_OP(I2F) {
+            VM_A = vm_bits((f64)(i64)VM_B);
+            VM_NEXT();
+        }
+        VM_OP(U2F) {
+            VM_A = vm_bits((f64)VM_B);
+            VM_NEXT();
+        }
+        VM_OP(F2I) {
+            VM_A = (u64)(i64)VM_FB;
+            VM_NEXT();
+        }
+        VM_OP(F2U) {
+            VM_A = (u64)VM_FB;
+            VM_NEXT();
+        }
+        VM_OP(F2F32) {
+            VM_A = vm_round32(VM_FB);
+            VM_NEXT();
+        }
+        VM_OP(LD8S) {
+            VM_ACCESS(VM_B + (u64)(i64)inst->imm, sizeof(i8), false);
+            VM_A = (u64)(i64)vm_load<i8>(VM_B + (u64)(i64)inst->imm);
+            VM_NEXT();
+        }
+        VM_OP(LD8U) {
+            VM_ACCESS(VM_B + (u64)(i64)inst->imm, sizeof(u8), false);
+            VM_A = vm_load<u8>(VM_B + (u64)(i64)inst->imm);
+            VM_NEXT();
+        }
+        VM_OP(LD16S) {
+            VM_ACCESS(VM_B + (u64)(i64)inst->imm, sizeof(i16), false);
+            VM_A = (u64)(i64)vm_load<i16>(VM_B + (u64)(i64)inst->imm);
+            VM_NEXT();
+        }
+        VM_OP(LD16U) {
+            VM_ACCESS(VM_B + (u64)(i64)inst->imm, sizeof(u16), false);
+            VM_A = vm_load<u16>(VM_B + (u64)(i64)inst->imm);
+            VM_NEXT();
+        }
+        VM_OP(LD32S) {
+            VM_ACCESS(VM_B + (u64)(i64)inst->imm, sizeof(i32), false);
+            VM_A = (u64)(i64)vm_load<i32>(VM_B + (u64)(i64)inst->imm);
+            VM_NEXT();
+        }
+        VM_OP(LD32U) {
+            VM_ACCESS(VM_B + (u64)(i64)inst->imm, sizeof(u32), false);
+            VM_A = vm_load<u32>(VM_B + (u64)(i64)inst->imm);
+            VM_NEXT();
+        }
+        VM_OP(LD64) {
+            VM_ACCESS(VM_B + (u64)(i64)inst->imm, sizeof(u64), false);
+            VM_A = vm_load<u64>(VM_B + (u64)(i64)inst->imm);
+            VM_NEXT();
+        }
+        VM_OP(LDF32) {
+            VM_ACCESS(VM_B + (u64)(i64)inst->imm, sizeof(f32), false);
+            VM_A = vm_bits((f64)vm_load<f32>(VM_B + (u64)(i64)inst->imm));
+            VM_NEXT();
+        }
+        VM_OP(ST8) {
+            VM_ACCESS(VM_A + (u64)(i64)inst->imm, sizeof(u8), true);
+            vm_store<u8>(VM_A + (u64)(i64)inst->imm, (u8)VM_B);
+            VM_NEXT();
+        }
+        VM_OP(ST16) {
+            VM_ACCESS(VM_A + (u64)(i64)inst->imm, sizeof(u16), true);
+            vm_store<u16>(VM_A + (u64)(i64)inst->imm, (u16)VM_B);
+            VM_NEXT();
+        }
+        VM_OP(ST32) {
+            VM_ACCESS(VM_A + (u64)(i64)inst->imm, sizeof(u32), true);
+            vm_store<u32>(VM_A + (u64)(i64)inst->imm, (u32)VM_B);
+            VM_NEXT();
+        }
+        VM_OP(ST64) {
+            VM_ACCESS(VM_A + (u64)(i64)inst->imm, sizeof(u64), true);
+            vm_store<u64>(VM_A + (u64)(i64)inst->imm, VM_B);
+            VM_NEXT();
+        }
+        VM_OP(STF32) {
+            VM_ACCESS(VM_A + (u64)(i64)inst->imm, sizeof(f32), true);
+            vm_store<f32>(VM_A + (u64)(i64)inst->imm, (f32)VM_FB);
+            VM_NEXT();
+        }
+        VM_OP(LDX32S) {
+            VM_ACCESS(VM_B + VM_C * 4, sizeof(i32), false);
+            VM_A = (u64)(i64)vm_load<i32>(VM_B + VM_C * 4);
+            VM_NEXT();
+        }
+        VM_OP(LDX32U) {
+            VM_ACCESS(VM_B + VM_C * 4, sizeof(u32), false);
+            VM_A = vm_load<u32>(VM_B + VM_C * 4);
+            VM_NEXT();
+        }
+        VM_OP(LDX64) {
+            VM_ACCESS(VM_B + VM_C * 8, sizeof(u64), false);
+            VM_A = vm_load<u64>(VM_B + VM_C * 8);
+            VM_NEXT();
+        }
+        VM_OP(STX32) {
+            VM_ACCESS(VM_A + VM_B * 4, sizeof(u32), true);
+            vm_store<u32>(VM_A + VM_B * 4, (u32)VM_C);
+            VM_NEXT();
+        }
+        VM_OP(STX64) {
+            VM_ACCESS(VM_A + VM_B * 8, sizeof(u64), true);
+            vm_store<u64>(VM_A + VM_B * 8, VM_C);
+            VM_NEXT();
+        }
+        VM_OP(LEA) {
+            VM_A = VM_B + VM_C * (u64)(i64)inst->imm;
+            VM_NEXT();
+        }
+        VM_OP(FRAME) {
+            VM_A = (u64)(uintptr_t)(mem + inst->imm);
+            VM_NEXT();
+        }
+        VM_OP(COPY) {
+            VM_ACCESS(VM_A, (u64)inst->imm, true);
+            VM_ACCESS(VM_B, (u64)inst->imm, false);
+            memmove((void*)(uintptr_t)VM_A, (const void*)(uintptr_t)VM_B, (size_t)inst->imm);
+            VM_NEXT();
+        }
+        VM_OP(ZERO) {
+            VM_ACCESS(VM_A, (u64)inst->imm, true);
+            memset((void*)(uintptr_t)VM_A, 0, (size_t)inst->imm);
+            VM_NEXT();
+        }
+        VM_OP(CALL) {
+            callee = program->funcs.data() + inst->imm;
+            goto call;
+        }
+        VM_OP(CALL_IND) {
+            callee = (const VmFunc*)(uintptr_t)r[inst->imm];
+            if (!vm_is_func<checked>(program, callee)) {
+                error = "call of an invalid func";
+                goto fail;
+            }
+            goto call;
+        }
+        VM_OP(RET) {
+            value = VM_A;
+            goto ret;
+        }
+        VM_OP(RET_VOID) {
+            value = 0;
+            goto ret;
+        }
+        VM_OP(RET_COPY) {
+            value = VM_A;
+            if (depth) {
+                VmFrame* frame = frames + depth - 1;
+                value = frame->regs[frame->dest];
+                VM_ACCESS(value, (u64)inst->imm, true);
+                memcpy((void*)(uintptr_t)value, (const void*)(uintptr_t)VM_A, (size_t)inst->imm);
+            }
+            goto ret;
+        }
+        VM_OP(JMP) {
+            VM_JUMP_IF(true);
+        }
+        VM_OP(JZ) {
+            VM_JUMP_IF(!VM_A);
+        }
+        VM_OP(JNZ) {
+            VM_JUMP_IF(VM_A);
+        }
+        VM_OP(JEQ) {
+            VM_JUMP_IF(VM_A == VM_B);
+        }
+        VM_OP(JNE) {
+            VM_JUMP_IF(VM_A != VM_B);
+        }
+        VM_OP(JLT_S) {
+            VM_JUMP_IF((i64)VM_A < (i64)VM_B);
+        }
+        VM_OP(JLE_S) {
+            VM_JUMP_IF((i64)VM_A <= (i64)VM_B);
+        }
+        VM_OP(JLT_U) {
+            VM_JUMP_IF(VM_A < VM_B);
+        }
+        VM_OP(JLE_U) {
+            VM_JUMP_IF(VM_A <= VM_B);
+        }
+        default: {
+            error = "invalid instruction";
+            goto fail;
+        }
+    }
+
+call: {
+        //*the callee's registers and frame memory follow the caller's, its params are the first registers
+        u64* regs = r + func->num_regs;
+        u8* memory = mem + func->frame_bytes;
+        bool fits = regs + callee->num_regs <= program->regs + program->max_regs && memory + callee->frame_bytes <= program->memory + program->max_memory;
+        if (depth == program->max_depth || !fits) {
+            error = "stack overflow";
+            goto fail;
+        }
+        const u16* args = func->args.data() + inst->b;
+        for (u32 i = 0; i < inst->c; i++) {
+            regs[i] = r[args[i]];
+        }
+        frames[depth++] = { func, inst + 1, r, mem, inst->a };
+        func = callee;
+        r = regs;
+        mem = memory;
+        inst = func->code.data();
+        VM_DISPATCH();
+    }
+
+ret: {
+        if (!depth) {
+            *result = value;
+            program->steps += steps;
+            return true;
+        }
+        VmFrame* frame = frames + --depth;
+        frame->regs[frame->dest] = value;
+        func = frame->func;
+        inst = frame->ret;
+        r = frame->regs;
+        mem = frame->memory;
+        VM_DISPATCH();
+    }
+
+fail:
+    program->error = std::string(error) + " in " + func->sym->name;
+    program->steps += steps;
+    return false;
+}
+
+#undef VM_A
+#undef VM_B
+#undef VM_C
+#undef VM_FB
+#undef VM_FC
+#undef VM_OP
+#undef VM_DISPATCH
+#undef VM_NEXT
+#undef VM_JUMP_IF
+#undef VM_STEP
+#undef VM_ACCESS
+
+bool vm_call(VmProgram* program, VmFunc* func, const u64* args, u64* result, bool checked) {
+    if (func->num_params) {
+        memcpy(program->regs, args, func->num_params * sizeof(u64));
+    }
+    program->error.clear();
+    if (Global::vm_switch_dispatch) {
+        return checked ? vm_run<false, true>(program, func, result) : vm_run<false, false>(program, func, result);
+    }
+    return checked ? vm_run<true, true>(program, func, result) : vm_run<true, false>(program, func, result);
+}
+
+std::string vm_dump(VmFunc* func) {
+    std::string out = "func " + std::string(func->sym->name) + "\n";
+    char line[96];
+    for (size_t pc = 0; pc < func->code.size(); pc++) {
+        VmInst* inst = &func->code[pc];
+        snprintf(line, sizeof(line), "%5zu %-8s %u, %u, %u, %d\n", pc, vm_op_name(inst->op), inst->a, inst->b, inst->c, inst->imm);
+        out += line;
+    }
+    return out;
+}
+
+int vm_run_file(const char* path) {
+    if (!load_package_file(path) || !package_main_func(path)) {
+        return 1;
+    }
+
+    VmProgram program = {};
+    vm_compile_package(&program);
+    VmFunc* main_func = vm_find_func(&program, "main");
+    u64 result = 0;
+    bool ok = vm_call(&program, main_func, nullptr, &result, false);
+    if (!ok) {
+        printf("%s\n", program.error.c_str());
+    }
+    vm_free(&program);
+    return ok ? (int)result : 1;
+}
+
+GlobalVariable const char* vm_corpus_src =
+    "struct Vector { x, y: int; }\n"
+    "struct Triple { x, y, z: double; }\n"
+    "var squares: int[8]\n"
+    "var origin: Vector = {3, 4}\n"
+    "var count: int = 7\n"
+    "var scale: int = count * 2\n"
+    "func fib(n: int): int { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }\n"
+    "func sum_to(n: int): llong { var s: llong = 0\n for (i := 0; i < n; i++) { s += i; } return s; }\n"
+    "func sum_array(p: int*, n: int): int { s := 0; for (i := 0; i < n; i++) { s += p[i]; } return s; }\n"
+    "func squared(n: int): int { for (i := 0; i < n; i++) { squares[i] = i * i; } return sum_array(&squares[0], n); }\n"
+    "func pick(i: int): int { squares[i & 7] = i; return squares[(i + 1) & 7] + squares[1]; }\n"
+    "func initialized(): int { return scale + count * 2; }\n"
+    "func add(a: Vector, b: Vector): Vector { a.x += b.x; a.y += b.y; return a; }\n"
+    "func length2(): int { v := add(origin, origin); return v.x * v.x + v.y * v.y; }\n"
+    "func swapped(n: int): int { var a: Vector = {1, 0}\n var b: Vector = {0, 1}\n"
+    "    for (i := 0; i < n; i++) { t := a; a = b; b = t; a.x += 100; } return a.x + a.y + b.x + b.y - 1; }\n"
+    "func average(n: int): double { var xs: float[4]\n for (i := 0; i < n; i++) { xs[i] = i * 0.125; } s := 0.0;\n"
+    "    for (i := 0; i < n; i++) { s += xs[i]; } return s / n * 2; }\n"
+    "func wrap(a: uchar): uchar { return a + 250; }\n"
+    "func narrow(a: int): ushort { var s: ushort = 0\n s += a; return s; }\n"
+    "func mixed(a: int, b: int): int { var big: uint = 0xFFFFFFFF\n return a / b + a % b + (a >> 1) + (big >> 1); }\n"
+    "func sub(a: int, b: int): int { return a - b; }\n"
+    "func mul(a: int, b: int): int { return a * b; }\n"
+    "func apply(f: func(int, int): int, a: int, b: int): int { return f(a, b); }\n"
+    "func applied(): int { return apply(sub, 10, 3) + apply(mul, 10, 3); }\n"
+    "func classify(n: int): int { switch (n) { case 1: return 10; case 2 case 3: return 20; default: return 30; } return 0; }\n"
+    "func divide(a: int, b: int): int { return a / b; }\n"
+    "func to_unsigned(x: double): ullong { return x; }\n"
+    "func from_unsigned(u: ullong): double { return u; }\n"
+    "func scale_triple(t: Triple, k: float): Triple { t.x *= k; t.y *= k; t.z *= k; return t; }\n"
+    "func halved(): int { var t: Triple = {2, 40, 600}\n u := scale_triple(t, 0.5); return u.x + u.y + u.z; }\n"
+    "func many(a: llong, b: llong, c: llong, d: llong, e: llong, f: llong, g: llong, h: llong, i: char): llong {\n"
+    "    return a + b * 2 + c * 3 + d * 4 + e * 5 + f * 6 + g * 7 + h * 8 + i * 9; }\n"
+    "func call_many(): llong { return many(1, 2, 3, 4, 5, 6, 7, 8, 9); }\n"
+    "func count_chars(): int { s := \"hello world\"; n := 0; while (s[n]) { n++; } return n; }\n"
+    "func big_frame(k: int): int { var xs: int[5000]\n for (i := 0; i < 5000; i++) { xs[i] = i * k; } return xs[4999]; }\n"
+    "func deep(n: int): int { return deep(n + 1) + 1; }\n"
+    "var ints: int[40]\n"
+    "var longs: llong[40]\n"
+    "var floats: float[40]\n"
+    "var doubles: double[40]\n"
+    "var bytes: uchar[40]\n"
+    "var byte_copy: uchar[40]\n"
+    "func fill(n: int) { for (i := 0; i < n; i++) { ints[i] = i * 100003 - 7; longs[i] = i * 3000000019; floats[i] = i * 0.5;\n"
+    "    doubles[i] = i * 0.25; bytes[i] = i * 7; } }\n"
+    "func int_lanes(n: int, k: int) { for (i := 0; i < n; i++) { ints[i] = (ints[i] * k + ints[i] / k - ints[i] % k) ^ -ints[i]; }\n"
+    "    for (i := 0; i < n; i++) { ints[i] = (ints[i] << k) + (ints[i] >> k) - ((ints[i] & 255) | k); } }\n"
+    "func long_lanes(n: int, k: llong) { for (i := 0; i < n; i++) { longs[i] = longs[i] * k + (longs[i] & 255) - (longs[i] | k) + longs[i] / k; } }\n"
+    "func float_lanes(n: int, k: float) { for (i := 0; i < n; i++) { floats[i] = -floats[i] * k + floats[i] / k - k; } }\n"
+    "func double_lanes(n: int, k: double) { for (i := 0; i < n; i++) { doubles[i] = -doubles[i] * k + doubles[i] / k - k; } }\n"
+    "func copy_bytes(n: int) { for (i := 0; i < n; i++) { byte_copy[i] = bytes[i]; } }\n"
+    "func sum_ints(n: int): int { s := 0; for (i := 0; i < n; i++) { s += ints[i]; } return s; }\n"
+    "func lanes(n: int): llong { fill(n); int_lanes(n, 3); long_lanes(n, 5); float_lanes(n, 1.5); double_lanes(n, 2.5); copy_bytes(n);\n"
+    "    var s: llong = sum_ints(n)\n for (i := 0; i < n; i++) { var f: llong = floats[i] * 8\n var d: llong = doubles[i] * 16\n"
+    "    s = s * 31 + longs[i] + f + d + byte_copy[i]; } return s % 1000000007; }\n";
+
+const VmCorpusCall vm_corpus_calls[] = {
+    { "fib", { 20 }, 6765 },
+    { "sum_to", { 100000 }, 4999950000.0 },
+    { "squared", { 8 }, 140 },
+    { "pick", { 13 }, 36 + 1 },
+    { "initialized", {}, 14 + 7 * 2 },
+    { "length2", {}, 36 + 64 },
+    { "swapped", { 10 }, 10 * 100 + 1 },
+    { "average", { 4 }, 0.375 },
+    { "wrap", { 10 }, 4 },
+    { "narrow", { -1 }, 0xFFFF },
+    { "mixed", { -7, 2 }, -3 + -1 + (-7 >> 1) + 0x7FFFFFFF },
+    { "applied", {}, 7 + 30 },
+    { "classify", { 1 }, 10 },
+    { "classify", { 3 }, 20 },
+    { "classify", { 9 }, 30 },
+    { "divide", { 7, 2 }, 3 },
+    { "to_unsigned", { 1e19 }, 1e19 },
+    { "to_unsigned", { 3.75 }, 3 },
+    { "from_unsigned", { 9223372036854775808.0 }, 9223372036854775808.0 },
+    { "from_unsigned", { 12345 }, 12345 },
+    { "halved", {}, 1 + 20 + 300 },
+    { "call_many", {}, 1 + 2 * 2 + 3 * 3 + 4 * 4 + 5 * 5 + 6 * 6 + 7 * 7 + 8 * 8 + 9 * 9 },
+    { "count_chars", {}, 11 },
+    { "big_frame", { 3 }, 3 * 4999 },
+    { "lanes", { 37 }, 199220906 },
+    { "lanes", { 40 }, 519226584 },
+};
+
+const size_t vm_corpus_num_calls = sizeof(vm_corpus_calls) / sizeof(vm_corpus_calls[0]);
+
+void vm_corpus_load(const char* extra_src) {
+    std::string src = std::string(vm_corpus_src) + extra_src;
+    assert(load_package_src("corpus_test.sorin", src.c_str()));
+}
+
+u64 vm_corpus_bits(Type* type, f64 value) {
+    if (is_floating_type(type)) {
+        u64 bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+    return vm_corpus_result(type, is_signed_type(type) ? (u64)(i64)value : (u64)value);
+}
+
+u64 vm_corpus_result(Type* type, u64 raw) {
+    if (is_floating_type(type) || type->size >= sizeof(u64)) {
+        return raw;
+    }
+    u32 shift = 64 - (u32)type->size * 8;
+    return is_signed_type(type) ? (u64)((i64)(raw << shift) >> shift) : raw << shift >> shift;
+}
+
+std::vector<u64> vm_corpus_results() {
+    VmProgram program = {};
+    vm_compile_package(&program);
+    std::vector<u64> results;
+    for (size_t i = 0; i < vm_corpus_num_calls; i++) {
+        const VmCorpusCall* call = vm_corpus_calls + i;
+        Type* type = sym_get(Global::string_table.add(call->func))->type;
+        u64 args[2] = {};
+        for (size_t j = 0; j < type->func.num_params; j++) {
+            args[j] = vm_corpus_bits(type->func.params[j], call->args[j]);
+        }
+        u64 result = 0;
+        bool ok = vm_call(&program, vm_find_func(&program, call->func), args, &result, false);
+        assert(ok);
+        results.push_back(vm_corpus_result(type->func.ret, result));
+    }
+    vm_free(&program);
+    return results;
+}
+
+Internal void vm_test_package() {
+    std::vector<u64> results = vm_corpus_results();
+    for (size_t i = 0; i < vm_corpus_num_calls; i++) {
+        Type* ret = sym_get(Global::string_table.add(vm_corpus_calls[i].func))->type->func.ret;
+        assert(results[i] == vm_corpus_bits(ret, vm_corpus_calls[i].expected));
+    }
+
+    //*errors stop the program with a message instead of crashing the host
+    VmProgram program = {};
+    vm_compile_package(&program);
+    u64 args[2] = { 1, 0 };
+    u64 result = 0;
+    assert(!vm_call(&program, vm_find_func(&program, "divide"), args, &result, false));
+    assert(program.error == "division by zero or overflow in divide");
+    assert(!vm_call(&program, vm_find_func(&program, "deep"), args, &result, false));
+    assert(program.error == "stack overflow in deep");
+    args[0] = 10;
+    assert(vm_call(&program, vm_find_func(&program, "fib"), args, &result, false) && result == 55);
+
+    //*checked runs count the instructions
+    u64 steps = program.steps;
+    args[0] = 15;
+    assert(vm_call(&program, vm_find_func(&program, "fib"), args, &result, true) && result == 610);
+    assert(program.steps > steps);
+    vm_free(&program);
+}
+
+void vm_test() {
+    vm_corpus_load("");
+
+    //*every combination of fusing and dispatch computes the same results
+    for (int i = 0; i < 4; i++) {
+        Global::vm_superinstructions = (i & 1) == 0;
+        Global::vm_switch_dispatch = (i & 2) != 0;
+        vm_test_package();
+    }
+    Global::vm_superinstructions = true;
+    Global::vm_switch_dispatch = false;
+    //*and so does the IR as lowered, where params and loop variables feed phis directly
+    Global::ir_passes = 0;
+    vm_test_package();
+    Global::ir_passes = 0xFFFFFFFF;
+
+    //*fib's compare and branch become one jump, and n - 1 an add of an immediate
+    VmProgram program = {};
+    vm_compile_package(&program);
+    VmFunc* fib = vm_find_func(&program, "fib");
+    bool has_fused_jump = false;
+    bool has_addi = false;
+    for (VmInst& it : fib->code) {
+        has_fused_jump = has_fused_jump || (it.op >= VmOp::JEQ && it.op <= VmOp::JLE_U);
+        has_addi = has_addi || it.op == VmOp::ADDI32;
+        assert(it.op != VmOp::LT_S);
+    }
+    assert(has_fused_jump && has_addi);
+    //*squares[i & 7] is an indexed store and squares[(i + 1) & 7] an indexed load, squares[1] a load at an offset
+    VmFunc* pick = vm_find_func(&program, "pick");
+    u32 num_indexed = 0;
+    for (VmInst& it : pick->code) {
+        num_indexed += it.op == VmOp::LDX32S || it.op == VmOp::STX32;
+        assert(it.op != VmOp::LEA);
+    }
+    assert(num_indexed == 2);
+    vm_free(&program);
+}
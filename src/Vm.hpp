@@ -0,0 +1,200 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Ir.hpp"
+
+//*register bytecode compiled from the optimized IR, and an interpreter that runs it in the host process without a C
+//*compiler. every IR value owns a 64-bit register of its frame: integers and pointers are kept sign or zero extended
+//*from the width of their type, floats and doubles as doubles, and an aggregate value is the address of its copy in
+//*frame memory. phis become moves on the edges into their block. memory is host memory, so pointers are host pointers
+
+enum class VmOp : u8 {
+    //*a destination, b and c sources, imm an immediate or jump target
+    MOV,
+    LOADI, //*imm sign extended
+    LOADK, //*consts[imm]
+    //*64-bit integer arithmetic, narrower types are extended again with an EXT op
+    ADD,
+    SUB,
+    MUL,
+    DIV_S,
+    DIV_U,
+    MOD_S,
+    MOD_U,
+    AND,
+    OR,
+    XOR,
+    SHL,
+    SHR_S,
+    SHR_U,
+    NEG,
+    ADDI, //*b + imm
+    //*arithmetic of int, the result is sign extended from 32 bits
+    ADD32,
+    SUB32,
+    MUL32,
+    SHL32,
+    NEG32,
+    ADDI32,
+    SEXT8,
+    SEXT16,
+    SEXT32,
+    ZEXT8,
+    ZEXT16,
+    ZEXT32,
+    BOOL, //*b != 0
+    EQ,
+    NE,
+    LT_S,
+    LE_S,
+    LT_U,
+    LE_U,
+    //*doubles, the 32 forms round the result to float
+    FADD,
+    FSUB,
+    FMUL,
+    FDIV,
+    FADD32,
+    FSUB32,
+    FMUL32,
+    FDIV32,
+    FNEG,
+    FEQ,
+    FNE,
+    FLT,
+    FLE,
+    FBOOL, //*b != 0.0
+    I2F, //*signed integer to double
+    U2F, //*64-bit unsigned integer to double
+    F2I,
+    F2U,
+    F2F32, //*rounds to float
+    //*loads from the address b + imm, stores b to the address a + imm
+    LD8S,
+    LD8U,
+    LD16S,
+    LD16U,
+    LD32S,
+    LD32U,
+    LD64,
+    LDF32,
+    ST8,
+    ST16,
+    ST32,
+    ST64,
+    STF32,
+    //*loads from b + c * size, stores c to a + b * size
+    LDX32S,
+    LDX32U,
+    LDX64,
+    STX32,
+    STX64,
+    LEA, //*b + c * imm
+    FRAME, //*address imm bytes into the frame memory
+    COPY, //*imm bytes from the address b to the address a
+    ZERO, //*imm bytes at the address a
+    //*args[b..b + c] of the function are the argument registers, the result goes to a
+    CALL, //*funcs[imm]
+    CALL_IND, //*the VmFunc at the address in register imm
+    RET,
+    RET_VOID,
+    RET_COPY, //*copies imm bytes at the address a to the caller's result
+    JMP,
+    JZ, //*a == 0
+    JNZ,
+    //*compare a with b and jump when it holds
+    JEQ,
+    JNE,
+    JLT_S,
+    JLE_S,
+    JLT_U,
+    JLE_U,
+    SIZE_OF_ENUM,
+};
+
+const char* vm_op_name(VmOp op);
+
+struct VmInst {
+    VmOp op;
+    u16 a;
+    u16 b;
+    u16 c;
+    i32 imm;
+};
+
+struct VmFunc {
+    Sym* sym;
+    std::vector<VmInst> code;
+    std::vector<u64> consts;
+    std::vector<u16> args; //*argument registers of the calls
+    u32 num_params; //*the first registers
+    u32 num_regs;
+    u32 frame_bytes; //*allocas and aggregate values, a multiple of 16
+};
+
+struct VmFrame;
+
+//*the bytecode of a package and the memory it runs in
+struct VmProgram {
+    std::vector<VmFunc> funcs; //*in compilation order, never resized once compiled
+    u8* globals; //*every global var, at the offsets in global_offsets
+    u32 global_bytes;
+    std::vector<std::pair<Sym*, u32>> global_offsets;
+    std::vector<std::pair<const char*, size_t>> strings; //*the string literals the code reads, with their terminators
+    //*limits of a run, 0 before compiling takes the defaults
+    u32 max_regs; //*size of the register stack
+    u32 max_memory; //*bytes of the frame memory stack
+    u32 max_depth; //*calls in progress
+    u64 max_steps; //*instructions a checked call runs
+    u64* regs; //*register stack
+    u8* memory; //*frame memory stack
+    VmFrame* frames; //*callers of the running func
+    std::string error; //*why the last call failed
+    u64 steps; //*instructions run by checked calls
+};
+
+//*lowers and optimizes a func for the VM, without the vectorizer
+IrFunc* vm_lower_func(Sym* sym);
+//*compiles the funcs into program and allocates its stacks. every func they call or take the address of must be one
+//*of them, and every global var they use must already have its memory in program
+void vm_compile_funcs(VmProgram* program, const std::vector<IrFunc*>& funcs);
+//*compiles every func of the resolved package and runs the initializers of the global vars
+void vm_compile_package(VmProgram* program);
+void vm_free(VmProgram* program);
+
+VmFunc* vm_find_func(VmProgram* program, const char* name);
+u8* vm_global_addr(VmProgram* program, Sym* sym);
+
+//*runs func on registers holding its arguments and stores the register of its result, the address of its copy in the
+//*frame memory for an aggregate. false with program->error set when the program divides by zero or runs out of stack.
+//*a checked call also fails when it runs more than max_steps instructions or touches memory outside the frames, the
+//*globals and the string literals, and adds the instructions it ran to program->steps
+bool vm_call(VmProgram* program, VmFunc* func, const u64* args, u64* result, bool checked);
+
+std::string vm_dump(VmFunc* func);
+
+//*parses, checks and runs main of the file, its result is the exit status
+int vm_run_file(const char* path);
+
+//*a call of the test corpus, its arguments and result as numbers the param and return types give their bits
+struct VmCorpusCall {
+    const char* func;
+    f64 args[2];
+    f64 expected;
+};
+
+//*the program every backend's test runs. the VM's results of the calls are checked against the expected ones, a native
+//*backend's against the VM's
+extern const VmCorpusCall vm_corpus_calls[];
+extern const size_t vm_corpus_num_calls;
+
+//*parses and resolves the corpus followed by a backend's own funcs as the package
+void vm_corpus_load(const char* extra_src);
+//*the bits of value as a param or result of type, integers extended from their width and doubles as their pattern
+u64 vm_corpus_bits(Type* type, f64 value);
+//*a result register cut to the return type, so the results of different backends compare
+u64 vm_corpus_result(Type* type, u64 raw);
+//*the VM's results of the corpus calls in the loaded package
+std::vector<u64> vm_corpus_results();
+
+void vm_test();
@@ -1,21 +1,106 @@
 #include <iostream>
 #include <types.hpp>
 #include <sstream>
+#include <cerrno>
 #include "StringIntern.hpp"
 #include "Globals.hpp"
 #include "Lex.hpp"
 #include "Print.hpp"
 #include "Parse.hpp"
 #include "Resolve.hpp"
+#include "Bench.hpp"
+#include "AstCache.hpp"
+#include "Visit.hpp"
+#include "Switch.hpp"
+#include "Gen.hpp"
+#include "Ir.hpp"
+#include "Opt.hpp"
+#include "Loop.hpp"
+#include "Vm.hpp"
+#include "Ctfe.hpp"
+#include "RegAlloc.hpp"
+#include "Jit.hpp"
+#include "Riscv.hpp"
+#include "Elf.hpp"
 
 //TODO:printf stream into buffer
 
-int main() {
+//*the options after the paths of the driver mode argv[1], from argv[first] on. false after printing one the mode does
+//*not take. every mode loads the package through the AST cache in AST_CACHE_DIR, and c and lib also reuse the bodies
+//*an earlier build cached there, --no-cache parses and generates everything. c and lib take --ir to generate the
+//*bodies from the optimized IR, vectorized loops included, which the body cache does not hold, and c takes the number
+//*of units to split the C into, at least 1
+Internal bool driver_options(int first, int argc, char** argv, size_t* num_units) {
+    bool is_c = strcmp(argv[1], "c") == 0;
+    bool is_gen = is_c || strcmp(argv[1], "lib") == 0;
+    Global::ast_cache_dir = AST_CACHE_DIR;
+    Global::gen_cache_dir = is_gen ? AST_CACHE_DIR : nullptr;
+    for (int i = first; i < argc; i++) {
+        if (strcmp(argv[i], "--no-cache") == 0) {
+            Global::ast_cache_dir = nullptr;
+            Global::gen_cache_dir = nullptr;
+        }
+        else if (is_gen && strcmp(argv[i], "--ir") == 0) {
+            Global::gen_from_ir = true;
+        }
+        else if (is_c && argv[i][0] >= '0' && argv[i][0] <= '9') {
+            char* end = nullptr;
+            errno = 0;
+            unsigned long units = strtoul(argv[i], &end, 10);
+            if (*end || errno == ERANGE || units < 1) {
+                printf("invalid unit count %s\n", argv[i]);
+                return false;
+            }
+            *num_units = (size_t)units;
+        }
+        else {
+            printf("unknown option %s\n", argv[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
     std::cout << "Running main\n";
     Global::string_table.intern_test();
 
     lex_test();
 
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        run_benchmarks(argc - 2, argv + 2);
+        return 0;
+    }
+
+    size_t num_units = 1;
+    if (argc > 2 && strcmp(argv[1], "run") == 0) {
+        return driver_options(3, argc, argv, &num_units) ? vm_run_file(argv[2]) : 1;
+    }
+
+    if (argc > 2 && strcmp(argv[1], "jit") == 0) {
+        return driver_options(3, argc, argv, &num_units) ? jit_run_file(argv[2]) : 1;
+    }
+
+    if (argc > 2 && strcmp(argv[1], "rv64") == 0) {
+        return driver_options(3, argc, argv, &num_units) ? rv_run_file(argv[2]) : 1;
+    }
+
+    if (argc > 3 && strcmp(argv[1], "c") == 0) {
+        return driver_options(4, argc, argv, &num_units) ? gen_build_file(argv[2], argv[3], num_units) : 1;
+    }
+
+    if (argc > 3 && strcmp(argv[1], "lib") == 0) {
+        return driver_options(4, argc, argv, &num_units) ? gen_build_header_file(argv[2], argv[3]) : 1;
+    }
+
+    if (argc > 3 && strcmp(argv[1], "elf") == 0) {
+        return driver_options(4, argc, argv, &num_units) ? elf_build_file(argv[2], argv[3], false) : 1;
+    }
+
+    if (argc > 3 && strcmp(argv[1], "exe") == 0) {
+        return driver_options(4, argc, argv, &num_units) ? elf_build_file(argv[2], argv[3], true) : 1;
+    }
+
     for (Intern const& intern : Global::string_table.interns) {
         std::cout << intern.str << std::endl;
     }
@@ -35,6 +120,32 @@ int main() {
 
     parse_test();
 
+    ast_cache_test();
+
+    visit_test();
+
     resolve_test();
 
+    switch_test();
+
+    gen_test();
+
+    ir_test();
+
+    opt_test();
+
+    loop_test();
+
+    vm_test();
+
+    ctfe_test();
+
+    ra_test();
+
+    jit_test();
+
+    rv_test();
+
+    elf_test();
+
 }
\ No newline at end of file